@@ -0,0 +1,380 @@
+"""Measure the end to end throughput of the extractors across caches.
+
+Runs dyldex_all_multiprocess on every image of each cache, and dyldex on a
+few images of each cache. Every run records the images per second, the MB
+per second, the peak RSS and the per stage times into a history file, and is
+compared against a stored baseline.
+"""
+
+import argparse
+import csv
+import json
+import os
+import pathlib
+import subprocess
+import sys
+import tempfile
+import time
+from datetime import datetime, timezone
+from typing import Generator, Optional
+
+DEFAULT_IMAGES = (
+    "/System/Library/PrivateFrameworks/PreferencesUI.framework/PreferencesUI",
+    "/System/Library/PrivateFrameworks/RunningBoard.framework/RunningBoard",
+    "/System/Library/PrivateFrameworks/DigitalAccess.framework/DigitalAccess",
+)
+
+# Metrics where a higher value is better, all others are better lower.
+HIGHER_IS_BETTER = ("imagesPerSec", "mbPerSec")
+METRICS = ("imagesPerSec", "mbPerSec", "peakRss", "wallTime")
+HISTORY_FIELDS = ("timestamp", "tool", "cache", "images", "bytes") + METRICS
+
+
+class Arguments:
+    multiprocess_path: Optional[pathlib.Path]
+    dyldex_path: Optional[pathlib.Path]
+    caches_path: pathlib.Path
+    cache_filters: Optional[list[str]]
+    images: tuple[str, ...]
+    jobs: Optional[int]
+    history: pathlib.Path
+    baseline: Optional[pathlib.Path]
+    update_baseline: bool
+    threshold: float
+    perf_counters: bool
+    pin: Optional[str]
+    pass
+
+
+def getArguments() -> Arguments:
+    parser = argparse.ArgumentParser("RunThroughput")
+    parser.add_argument("--multiprocess-path", type=pathlib.Path,
+                        default=os.environ.get(
+                            "TESTING_DYLDEX_ALL_MULTIPROCESS_PATH"),
+                        help="Path to dyldex_all_multiprocess, can be set "
+                        "with the environmental variable "
+                        "'TESTING_DYLDEX_ALL_MULTIPROCESS_PATH'.")
+    parser.add_argument("--dyldex-path", type=pathlib.Path,
+                        default=os.environ.get("TESTING_DYLDEX_PATH"),
+                        help="Path to dyldex, can be set with the "
+                        "environmental variable 'TESTING_DYLDEX_PATH'.")
+    parser.add_argument("--caches-path", type=pathlib.Path,
+                        default=os.environ.get("TESTING_CACHES_PATH"),
+                        help="The folder containing the caches to test, "
+                        "can be set with the environmental variable "
+                        "'TESTING_CACHES_PATH'.")
+    parser.add_argument("--cache-filters", nargs="+", type=str,
+                        help="A list of keywords to filter out caches that "
+                        "should not be processed.")
+    parser.add_argument("--images", nargs="+", type=str,
+                        default=DEFAULT_IMAGES,
+                        help="The images to extract with dyldex.")
+    parser.add_argument("-j", "--jobs", type=int,
+                        help="The number of jobs for dyldex_all_multiprocess.")
+    parser.add_argument("--history", type=pathlib.Path,
+                        default=pathlib.Path("throughput_history.csv"),
+                        help="The history file to append to, JSON if the "
+                        "extension is .json, otherwise CSV.")
+    parser.add_argument("--baseline", type=pathlib.Path,
+                        help="A JSON baseline to compare against.")
+    parser.add_argument("--update-baseline",
+                        action=argparse.BooleanOptionalAction, default=False,
+                        help="Replace the baseline with the results.")
+    parser.add_argument("--threshold", type=float, default=10.0,
+                        help="The percentage that a metric can get worse by "
+                        "before it is a regression.")
+    parser.add_argument("--perf-counters",
+                        action=argparse.BooleanOptionalAction, default=False,
+                        help="Record hardware counters in "
+                        "dyldex_all_multiprocess, and print the instructions "
+                        "per cycle and misses per KB of each stage. Linux "
+                        "only.")
+    parser.add_argument("--pin", choices=("core", "node"),
+                        help="Also run dyldex_all_multiprocess with its "
+                        "clients pinned with this policy and their caches "
+                        "prefaulted, and report the throughput gained. Linux "
+                        "only.")
+
+    args = parser.parse_args(namespace=Arguments())
+    if not args.multiprocess_path and not args.dyldex_path:
+        print("--multiprocess-path or --dyldex-path needs to be set.\n",
+              file=sys.stderr)
+        parser.print_help()
+        parser.exit()
+    if not args.caches_path:
+        print("--caches-path or TESTING_CACHES_PATH needs to be set.\n",
+              file=sys.stderr)
+        parser.print_help()
+        parser.exit()
+    return args
+
+
+def getCachePaths(
+    cachePath: pathlib.Path,
+    filters: Optional[list[str]]
+) -> Generator[pathlib.Path, None, None]:
+    for arch in cachePath.iterdir():
+        if not arch.is_dir():
+            continue
+
+        for cache in arch.iterdir():
+            if cache.is_dir():
+                path = next(c for c in cache.iterdir() if c.suffix == "")
+            else:
+                path = cache
+
+            if filters and next((f for f in filters if f in str(path)), None):
+                continue
+            yield path
+
+
+def runMeasured(params: tuple) -> tuple[bool, float, int]:
+    """Run a process and get if it succeeded, its wall time, and the peak RSS
+    in bytes of it and its children.
+    """
+
+    start = time.perf_counter()
+    proc = subprocess.Popen(params, stdout=subprocess.DEVNULL)
+    if hasattr(os, "wait4"):
+        _, status, usage = os.wait4(proc.pid, 0)
+        returnCode = os.waitstatus_to_exitcode(status)
+        # Kilobytes on Linux, bytes on macOS
+        peakRss = usage.ru_maxrss
+        if sys.platform != "darwin":
+            peakRss *= 1024
+    else:
+        returnCode = proc.wait()
+        peakRss = 0
+    wallTime = time.perf_counter() - start
+    return returnCode == 0, wallTime, peakRss
+
+
+def runMultiprocess(
+    exe: pathlib.Path,
+    cachePath: pathlib.Path,
+    jobs: Optional[int],
+    perfCounters: bool,
+    extraParams: tuple = ()
+) -> Optional[dict]:
+    with tempfile.TemporaryDirectory() as tempDir:
+        profilePath = pathlib.Path(tempDir) / "profile.json"
+        params = (exe, cachePath, "--disable-output", "--quiet",
+                  "--profile", profilePath)
+        if jobs:
+            params += ("-j", str(jobs))
+        if perfCounters:
+            params += ("--perf-counters",)
+        params += extraParams
+
+        succeeded, wallTime, peakRss = runMeasured(params)
+        if not succeeded or not profilePath.exists():
+            return None
+        with open(profilePath, encoding="utf-8") as f:
+            profile = json.load(f)
+
+    # The validate stage processes every image once with its full size
+    images = set()
+    totalBytes = 0
+    for record in profile["records"]:
+        images.add(record["image"])
+        if record["stage"] == "validate":
+            totalBytes += record["bytes"]
+
+    return {
+        "images": len(images),
+        "bytes": totalBytes,
+        "wallTime": wallTime,
+        "peakRss": peakRss,
+        "stages": {s["stage"]: s["wallTime"] for s in profile["stages"]},
+        "counters": {s["stage"]: s for s in profile["stages"] if "ipc" in s},
+    }
+
+
+def runDyldex(
+    exe: pathlib.Path,
+    cachePath: pathlib.Path,
+    images: tuple[str, ...]
+) -> Optional[dict]:
+    result = {"images": 0, "bytes": 0, "wallTime": 0.0, "peakRss": 0,
+              "stages": {}}
+    with tempfile.TemporaryDirectory() as tempDir:
+        for image in images:
+            outputPath = pathlib.Path(tempDir) / image.split("/")[-1]
+            succeeded, wallTime, peakRss = runMeasured(
+                (exe, cachePath, "-e", image, "-o", outputPath))
+            if not succeeded:
+                # The image might not be in this cache
+                continue
+
+            result["images"] += 1
+            result["bytes"] += outputPath.stat().st_size
+            result["wallTime"] += wallTime
+            result["peakRss"] = max(result["peakRss"], peakRss)
+
+    return result if result["images"] else None
+
+
+def printCounters(result: dict) -> None:
+    """Print the hardware counters of each stage, if they were recorded."""
+
+    for stage, counters in sorted(result.get("counters", {}).items()):
+        print(f"    {stage}: {counters['ipc']:.2f} IPC, per KB "
+              f"{counters['llcMissesPerKB']:.2f} LLC misses, "
+              f"{counters['branchMissesPerKB']:.2f} branch misses, "
+              f"{counters['dtlbMissesPerKB']:.2f} dTLB misses")
+
+
+def printPinningGain(results: list[dict], cache: str) -> None:
+    """Print the throughput gained by pinning on a cache, if it was run."""
+
+    byTool = {r["tool"]: r for r in results if r["cache"] == cache}
+    unpinned = byTool.get("dyldex_all_multiprocess")
+    for tool, pinned in byTool.items():
+        if not tool.startswith("dyldex_all_multiprocess:pin-") or not unpinned:
+            continue
+        if not unpinned["imagesPerSec"]:
+            continue
+        gain = (pinned["imagesPerSec"] / unpinned["imagesPerSec"] - 1) * 100
+        print(f"  {tool.split(':')[1]}: {gain:+.1f}% images/sec over "
+              "unpinned")
+
+
+def addRates(result: dict) -> dict:
+    wallTime = result["wallTime"]
+    result["imagesPerSec"] = result["images"] / wallTime if wallTime else 0
+    result["mbPerSec"] = (result["bytes"] / (1024 * 1024) / wallTime
+                          if wallTime else 0)
+    return result
+
+
+def writeHistory(path: pathlib.Path, results: list[dict]) -> None:
+    if path.suffix == ".json":
+        history = []
+        if path.exists():
+            with open(path, encoding="utf-8") as f:
+                history = json.load(f)
+        history.extend(results)
+        with open(path, "w", encoding="utf-8") as f:
+            json.dump(history, f, indent=2)
+        return
+
+    # One row per run, stage times are prefixed columns. The file is
+    # rewritten so new stages get a column.
+    rows = []
+    fields = list(HISTORY_FIELDS)
+    if path.exists():
+        with open(path, newline="", encoding="utf-8") as f:
+            reader = csv.DictReader(f)
+            fields += [f for f in reader.fieldnames or () if f not in fields]
+            rows = list(reader)
+
+    for result in results:
+        row = {k: result[k] for k in HISTORY_FIELDS}
+        row.update({f"stage.{s}": t for s, t in result["stages"].items()})
+        fields += [f for f in row if f not in fields]
+        rows.append(row)
+
+    with open(path, "w", newline="", encoding="utf-8") as f:
+        writer = csv.DictWriter(f, fieldnames=fields)
+        writer.writeheader()
+        writer.writerows(rows)
+
+
+def findRegressions(
+    baseline: dict,
+    results: list[dict],
+    threshold: float
+) -> list[str]:
+    regressions = []
+    for result in results:
+        key = f"{result['tool']}:{result['cache']}"
+        if key not in baseline:
+            continue
+
+        for metric in METRICS:
+            old = baseline[key].get(metric)
+            new = result[metric]
+            if not old:
+                continue
+
+            change = (new - old) / old * 100
+            if metric in HIGHER_IS_BETTER:
+                change = -change
+            if change > threshold:
+                regressions.append(
+                    f"{key} {metric}: {old:.4g} -> {new:.4g} "
+                    f"({change:.1f}% worse)")
+    return regressions
+
+
+def main():
+    args = getArguments()
+    timestamp = datetime.now(timezone.utc).isoformat()
+
+    results: list[dict] = []
+    for cachePath in getCachePaths(args.caches_path, args.cache_filters):
+        runs = []
+        if args.multiprocess_path:
+            print(f"Running dyldex_all_multiprocess on {cachePath}")
+            runs.append(("dyldex_all_multiprocess", runMultiprocess(
+                args.multiprocess_path, cachePath, args.jobs,
+                args.perf_counters)))
+        if args.dyldex_path:
+            print(f"Running dyldex on {cachePath}")
+            runs.append(("dyldex", runDyldex(
+                args.dyldex_path, cachePath, args.images)))
+
+        if args.multiprocess_path and args.pin:
+            print(f"Running dyldex_all_multiprocess pinned by {args.pin} on "
+                  f"{cachePath}")
+            runs.append((f"dyldex_all_multiprocess:pin-{args.pin}",
+                         runMultiprocess(
+                             args.multiprocess_path, cachePath, args.jobs,
+                             args.perf_counters,
+                             ("--pin", args.pin, "--prefault"))))
+
+        for tool, result in runs:
+            if result is None:
+                print(f"{tool} failed on {cachePath}", file=sys.stderr)
+                continue
+
+            result = addRates(result)
+            result.update({"timestamp": timestamp, "tool": tool,
+                           "cache": str(cachePath)})
+            print(f"  {tool}: {result['imagesPerSec']:.2f} images/sec, "
+                  f"{result['mbPerSec']:.2f} MB/sec, "
+                  f"{result['peakRss'] / (1024 * 1024):.1f} MB peak RSS")
+            printCounters(result)
+            results.append(result)
+
+        printPinningGain(results, str(cachePath))
+
+    if not results:
+        print("No results.", file=sys.stderr)
+        sys.exit(1)
+    writeHistory(args.history, results)
+
+    if not args.baseline:
+        return
+    if args.update_baseline or not args.baseline.exists():
+        baseline = {f"{r['tool']}:{r['cache']}":
+                    {m: r[m] for m in METRICS} for r in results}
+        with open(args.baseline, "w", encoding="utf-8") as f:
+            json.dump(baseline, f, indent=2)
+        print(f"Wrote baseline to {args.baseline}")
+        return
+
+    with open(args.baseline, encoding="utf-8") as f:
+        baseline = json.load(f)
+    regressions = findRegressions(baseline, results, args.threshold)
+    if regressions:
+        print(f"\n{len(regressions)} regressions beyond {args.threshold}%:")
+        for regression in regressions:
+            print(f"  {regression}")
+        sys.exit(1)
+    print("\nNo regressions.")
+    pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,274 @@
+#include <argparse/argparse.hpp>
+#include <chrono>
+#include <filesystem>
+#include <fmt/core.h>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+
+#include <Dyld/DyldContext.h>
+#include <Utils/Leb128.h>
+
+namespace fs = std::filesystem;
+using namespace DyldExtractor;
+
+/// The byte by byte decoders, for comparison.
+namespace Reference {
+
+uint64_t readUleb128(const uint8_t *&p, const uint8_t *end) {
+  uint64_t result = 0;
+  int bit = 0;
+  do {
+    if (p == end) {
+      throw std::invalid_argument("malformed uleb128.");
+    }
+    uint64_t slice = *p & 0x7f;
+
+    if (bit > 63) {
+      throw std::invalid_argument("uleb128 too big for uint64.");
+    } else {
+      result |= (slice << bit);
+      bit += 7;
+    }
+  } while (*p++ & 0x80);
+  return result;
+}
+
+int64_t readSleb128(const uint8_t *&p, const uint8_t *end) {
+  int64_t result = 0;
+  int bit = 0;
+  uint8_t byte = 0;
+  do {
+    if (p == end) {
+      throw std::invalid_argument("malformed sleb128.");
+    }
+    byte = *p++;
+    result |= (((int64_t)(byte & 0x7f)) << bit);
+    bit += 7;
+  } while (byte & 0x80);
+  // sign extend negative numbers
+  if (((byte & 0x40) != 0) && (bit < 64))
+    result |= (~0ULL) << bit;
+  return result;
+}
+
+} // namespace Reference
+
+struct ProgramArguments {
+  std::optional<fs::path> cachePath;
+  unsigned int iterations;
+  unsigned int count;
+};
+
+ProgramArguments parseArgs(int argc, char *argv[]) {
+  argparse::ArgumentParser program("bench_leb128");
+
+  program.add_argument("-c", "--cache")
+      .help("Also benchmark the function starts of the images in this 64 bit "
+            "shared cache.");
+
+  program.add_argument("-i", "--iterations")
+      .help("The number of times to decode each data set.")
+      .scan<'d', unsigned int>()
+      .default_value(20u);
+
+  program.add_argument("-n", "--count")
+      .help("The number of values in each synthetic data set.")
+      .scan<'d', unsigned int>()
+      .default_value(1000000u);
+
+  ProgramArguments args;
+  try {
+    program.parse_args(argc, argv);
+
+    if (auto path = program.present<std::string>("--cache"); path) {
+      args.cachePath = fs::path(*path);
+    }
+    args.iterations = program.get<unsigned int>("--iterations");
+    args.count = program.get<unsigned int>("--count");
+  } catch (const std::runtime_error &err) {
+    std::cerr << "Argument parsing error: " << err.what() << std::endl;
+    std::exit(1);
+  }
+
+  return args;
+}
+
+struct DataSet {
+  std::string name;
+  bool isSigned;
+  std::vector<uint8_t> data;
+  uint64_t values = 0;
+};
+
+/// @brief Encode values with a number of significant bits.
+/// @param maxBits The maximum number of significant bits, picked uniformly.
+DataSet generate(std::string name, bool isSigned, unsigned int count,
+                 unsigned int maxBits) {
+  std::mt19937_64 rng(count ^ maxBits);
+  std::uniform_int_distribution<unsigned int> bitsDist(1, maxBits);
+
+  DataSet set{name, isSigned, {}, count};
+  for (unsigned int i = 0; i < count; i++) {
+    const auto bits = bitsDist(rng);
+    uint64_t value = rng() & (bits == 64 ? ~0ULL : ((1ULL << bits) - 1));
+    // zero is the terminator in packed streams
+    value |= 1;
+    if (isSigned) {
+      Utils::appendSleb128(set.data, (rng() & 1) ? -(int64_t)(value >> 1)
+                                                 : (int64_t)(value >> 1));
+    } else {
+      Utils::appendUleb128(set.data, value);
+    }
+  }
+  return set;
+}
+
+/// @brief Collect the function starts of every image in the cache.
+DataSet collectFunctionStarts(const fs::path &cachePath) {
+  Dyld::Context dCtx(cachePath);
+
+  DataSet set{"function starts", false, {}, 0};
+  for (const auto imageInfo : dCtx.images) {
+    auto mCtx = dCtx.createMachoCtx<true, Utils::Arch::Pointer64>(imageInfo);
+    auto funcStarts =
+        mCtx.getFirstLC<Macho::Loader::linkedit_data_command>(
+            {LC_FUNCTION_STARTS});
+    auto leSeg = mCtx.getSegment(SEG_LINKEDIT);
+    if (!funcStarts || !leSeg) {
+      continue;
+    }
+
+    const uint8_t *leFile = mCtx.convertAddr(leSeg->command->vmaddr).second;
+    const uint8_t *p = leFile + funcStarts->dataoff;
+    const uint8_t *end = p + funcStarts->datasize;
+    while (p != end && *p) {
+      Reference::readUleb128(p, end);
+      set.values++;
+    }
+    set.data.insert(set.data.end(), leFile + funcStarts->dataoff, p);
+  }
+  return set;
+}
+
+struct Timing {
+  double seconds;
+  // The sum of the decoded values, which keeps the results alive and checks
+  // that the decoders agree
+  uint64_t checksum;
+};
+
+template <class Func>
+Timing timeIt(const DataSet &set, unsigned int iterations, Func func) {
+  uint64_t checksum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned int i = 0; i < iterations; i++) {
+    checksum += func(set);
+  }
+  auto end = std::chrono::steady_clock::now();
+  return {std::chrono::duration<double>(end - start).count(), checksum};
+}
+
+template <class Decode> uint64_t decodeAll(const DataSet &set, Decode decode) {
+  uint64_t checksum = 0;
+  const uint8_t *p = set.data.data();
+  const uint8_t *end = p + set.data.size();
+  while (p != end) {
+    checksum += (uint64_t)decode(p, end);
+  }
+  return checksum;
+}
+
+void benchmark(const DataSet &set, unsigned int iterations) {
+  const double mb = (double)set.data.size() * iterations / (1024 * 1024);
+  auto report = [&](const char *decoder, Timing timing, Timing baseline) {
+    const auto seconds = timing.seconds;
+    std::cout << fmt::format("{:<24} {:<10} {:>10.4f} {:>10.1f} {:>8.2f}x{}\n",
+                             set.name, decoder, seconds,
+                             seconds > 0 ? mb / seconds : 0.0,
+                             seconds > 0 ? baseline.seconds / seconds : 0.0,
+                             timing.checksum != baseline.checksum
+                                 ? " (different values)"
+                                 : "");
+  };
+
+  Timing reference;
+  if (set.isSigned) {
+    reference = timeIt(set, iterations, [](const DataSet &s) {
+      return decodeAll(s, Reference::readSleb128);
+    });
+    report("reference", reference, reference);
+    report("fast", timeIt(set, iterations, [](const DataSet &s) {
+             return decodeAll(s, Utils::readSleb128);
+           }),
+           reference);
+    return;
+  }
+
+  reference = timeIt(set, iterations, [](const DataSet &s) {
+    return decodeAll(s, Reference::readUleb128);
+  });
+  report("reference", reference, reference);
+  report("fast", timeIt(set, iterations, [](const DataSet &s) {
+           return decodeAll(s, Utils::readUleb128);
+         }),
+         reference);
+
+  std::vector<uint64_t> values;
+  values.reserve(set.values);
+  report("stream", timeIt(set, iterations, [&values](const DataSet &s) {
+           values.clear();
+           const uint8_t *p = s.data.data();
+           Utils::readUleb128Stream(p, p + s.data.size(), values);
+           uint64_t checksum = 0;
+           for (const auto v : values) {
+             checksum += v;
+           }
+           return checksum;
+         }),
+         reference);
+}
+
+int main(int argc, char *argv[]) {
+  auto args = parseArgs(argc, argv);
+
+  std::vector<DataSet> sets;
+  sets.push_back(generate("uleb 1 byte", false, args.count, 7));
+  sets.push_back(generate("uleb 1-2 bytes", false, args.count, 14));
+  sets.push_back(generate("uleb 1-4 bytes", false, args.count, 28));
+  sets.push_back(generate("uleb 1-10 bytes", false, args.count, 64));
+  sets.push_back(generate("sleb 1-4 bytes", true, args.count, 28));
+
+  try {
+    if (args.cachePath) {
+      sets.push_back(collectFunctionStarts(*args.cachePath));
+    }
+  } catch (const std::exception &e) {
+    std::cerr << fmt::format("An error has occurred: {}", e.what())
+              << std::endl;
+    return 1;
+  }
+
+  // Check that the decoders agree before timing them
+  for (const auto &set : sets) {
+    const bool matches =
+        set.isSigned ? decodeAll(set, Reference::readSleb128) ==
+                           decodeAll(set, Utils::readSleb128)
+                     : decodeAll(set, Reference::readUleb128) ==
+                           decodeAll(set, Utils::readUleb128);
+    if (!matches) {
+      std::cerr << fmt::format("Decoders disagree on '{}'", set.name)
+                << std::endl;
+      return 1;
+    }
+  }
+
+  std::cout << fmt::format("{} iterations\n", args.iterations);
+  std::cout << fmt::format("{:<24} {:<10} {:>10} {:>10} {:>9}\n", "data",
+                           "decoder", "seconds", "MB/s", "speedup");
+  for (const auto &set : sets) {
+    benchmark(set, args.iterations);
+  }
+
+  return 0;
+}
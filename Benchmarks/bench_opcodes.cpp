@@ -0,0 +1,215 @@
+#include <argparse/argparse.hpp>
+#include <chrono>
+#include <filesystem>
+#include <fmt/core.h>
+
+#include <Converter/Linkedit/Encoder/BindingV1.h>
+#include <Converter/Linkedit/Encoder/RebaseV1.h>
+#include <Converter/Slide.h>
+#include <Dyld/CacheOverlay.h>
+#include <Dyld/DyldContext.h>
+#include <Utils/ExtractionContext.h>
+
+namespace fs = std::filesystem;
+using namespace DyldExtractor;
+using namespace Converter::Linkedit;
+
+struct ProgramArguments {
+  fs::path cachePath;
+  std::optional<std::string> imageFilter;
+  unsigned int iterations;
+  unsigned int maxImages;
+};
+
+ProgramArguments parseArgs(int argc, char *argv[]) {
+  argparse::ArgumentParser program("bench_opcodes");
+
+  program.add_argument("cache_path")
+      .help("The path to the shared cache. If there are subcaches, give the "
+            "main one (typically without the file extension).");
+
+  program.add_argument("-e", "--image")
+      .help("Only benchmark images that contain this string in their path.");
+
+  program.add_argument("-i", "--iterations")
+      .help("The number of times to encode the opcodes of each image.")
+      .scan<'d', unsigned int>()
+      .default_value(5u);
+
+  program.add_argument("-n", "--max-images")
+      .help("The maximum number of images to benchmark, 0 for all.")
+      .scan<'d', unsigned int>()
+      .default_value(0u);
+
+  ProgramArguments args;
+  try {
+    program.parse_args(argc, argv);
+
+    args.cachePath = fs::path(program.get<std::string>("cache_path"));
+    args.imageFilter = program.present<std::string>("--image");
+    args.iterations = program.get<unsigned int>("--iterations");
+    args.maxImages = program.get<unsigned int>("--max-images");
+  } catch (const std::runtime_error &err) {
+    std::cerr << "Argument parsing error: " << err.what() << std::endl;
+    std::exit(1);
+  }
+
+  return args;
+}
+
+struct EncoderResult {
+  uint64_t records = 0;
+  uint64_t bytes = 0;
+  std::chrono::duration<double> time{0};
+};
+
+/// @brief Time an encoder, and record the size of its output.
+template <class Func>
+void timeIt(EncoderResult &result, uint64_t records, unsigned int iterations,
+            Func func) {
+  std::vector<uint8_t> encodedData;
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned int i = 0; i < iterations; i++) {
+    func(encodedData);
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  result.records += records;
+  result.bytes += encodedData.size();
+  result.time += (end - start) / iterations;
+}
+
+template <class A>
+void benchmark(Dyld::Context &dCtx, const ProgramArguments &args) {
+  using P = A::P;
+
+  std::ostringstream nullStream;
+  Provider::ActivityLogger activity("bench_opcodes", nullStream, false);
+  activity.getLogger()->set_level(spdlog::level::off);
+  Provider::Accelerator<P> accelerator;
+  Dyld::CacheOverlay overlay(dCtx);
+
+  // Indexed by if the opcodes are optimized
+  EncoderResult rebaseResults[2];
+  EncoderResult bindResults[2];
+  unsigned int imagesRun = 0;
+  for (const auto imageInfo : dCtx.images) {
+    std::string imagePath((char *)(dCtx.file + imageInfo->pathFileOffset));
+    if (args.imageFilter &&
+        imagePath.find(*args.imageFilter) == std::string::npos) {
+      continue;
+    }
+    if (args.maxImages && imagesRun >= args.maxImages) {
+      break;
+    }
+    imagesRun++;
+
+    auto mCtx = overlay.createMachoCtx<P>(imageInfo);
+    Utils::ExtractionContext<A> eCtx(dCtx, mCtx, accelerator, activity);
+    Converter::processSlideInfo(eCtx);
+    eCtx.ptrTracker.freeze();
+
+    auto inSegment = [&](uint64_t addr) {
+      for (const auto &seg : mCtx.segments) {
+        if (addr >= seg.command->vmaddr &&
+            addr < seg.command->vmaddr + seg.command->vmsize) {
+          return true;
+        }
+      }
+      return false;
+    };
+
+    // Records like the legacy generator makes, sorted by address
+    std::vector<Encoder::RebaseV1Info> rebaseInfo;
+    for (const auto &[addr, target] : eCtx.ptrTracker.getPointers()) {
+      if (inSegment(addr)) {
+        rebaseInfo.emplace_back(REBASE_TYPE_POINTER, addr);
+      }
+    }
+    std::sort(rebaseInfo.begin(), rebaseInfo.end(),
+              [](const auto &a, const auto &b) {
+                return a._address < b._address;
+              });
+
+    std::vector<Encoder::BindingV1Info> bindInfo;
+    for (const auto &[addr, bind] : eCtx.ptrTracker.getBinds()) {
+      if (inSegment(addr)) {
+        const auto &sym = eCtx.symbolStore.get(bind).preferredSymbol();
+        bindInfo.emplace_back(BIND_TYPE_POINTER, (int)sym.ordinal,
+                              sym.name.c_str(), false, addr, 0);
+      }
+    }
+
+    for (int optimize = 0; optimize < 2; optimize++) {
+      timeIt(rebaseResults[optimize], rebaseInfo.size(), args.iterations,
+             [&](std::vector<uint8_t> &encodedData) {
+               Encoder::encodeRebaseV1(rebaseInfo, mCtx, encodedData,
+                                       optimize);
+             });
+      timeIt(bindResults[optimize], bindInfo.size(), args.iterations,
+             [&](std::vector<uint8_t> &encodedData) {
+               Encoder::encodeBindingV1(bindInfo, mCtx, encodedData, 1,
+                                        optimize);
+             });
+    }
+
+    overlay.reset();
+  }
+
+  std::cout << fmt::format("{} images, {} iterations\n", imagesRun,
+                           args.iterations);
+  std::cout << fmt::format("{:<8} {:<10} {:>12} {:>12} {:>8} {:>10} {:>14}\n",
+                           "opcodes", "encoder", "records", "bytes", "saved",
+                           "seconds", "records/s");
+  auto report = [](const char *opcodes, const EncoderResult (&results)[2]) {
+    for (int optimize = 0; optimize < 2; optimize++) {
+      const auto &result = results[optimize];
+      const double seconds = result.time.count();
+      const double saved =
+          results[0].bytes
+              ? 100.0 * (1.0 - (double)result.bytes / results[0].bytes)
+              : 0.0;
+      std::cout << fmt::format(
+          "{:<8} {:<10} {:>12} {:>12} {:>7.2f}% {:>10.4f} {:>14.0f}\n",
+          opcodes, optimize ? "optimized" : "default", result.records,
+          result.bytes, saved, seconds,
+          seconds > 0 ? result.records / seconds : 0.0);
+    }
+  };
+  report("rebase", rebaseResults);
+  report("bind", bindResults);
+}
+
+int main(int argc, char *argv[]) {
+  auto args = parseArgs(argc, argv);
+
+  try {
+    Dyld::Context dCtx(args.cachePath);
+
+    // use dyld's magic to select arch
+    if (strcmp(dCtx.header->magic, "dyld_v1  x86_64") == 0)
+      benchmark<Utils::Arch::x86_64>(dCtx, args);
+    else if (strcmp(dCtx.header->magic, "dyld_v1 x86_64h") == 0)
+      benchmark<Utils::Arch::x86_64>(dCtx, args);
+    else if (strcmp(dCtx.header->magic, "dyld_v1   armv7") == 0)
+      benchmark<Utils::Arch::arm>(dCtx, args);
+    else if (strncmp(dCtx.header->magic, "dyld_v1  armv7", 14) == 0)
+      benchmark<Utils::Arch::arm>(dCtx, args);
+    else if (strcmp(dCtx.header->magic, "dyld_v1   arm64") == 0)
+      benchmark<Utils::Arch::arm64>(dCtx, args);
+    else if (strcmp(dCtx.header->magic, "dyld_v1  arm64e") == 0)
+      benchmark<Utils::Arch::arm64>(dCtx, args);
+    else if (strcmp(dCtx.header->magic, "dyld_v1arm64_32") == 0)
+      benchmark<Utils::Arch::arm64_32>(dCtx, args);
+    else {
+      std::cerr << "Unrecognized dyld shared cache magic." << std::endl;
+      return 1;
+    }
+  } catch (const std::exception &e) {
+    std::cerr << fmt::format("An error has occurred: {}", e.what())
+              << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
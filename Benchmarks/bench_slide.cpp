@@ -0,0 +1,180 @@
+#include <argparse/argparse.hpp>
+#include <chrono>
+#include <filesystem>
+#include <fmt/core.h>
+#include <map>
+
+#include <Converter/Slide.h>
+#include <Dyld/CacheOverlay.h>
+#include <Dyld/DyldContext.h>
+#include <Utils/ExtractionContext.h>
+#include <Utils/Utils.h>
+
+namespace fs = std::filesystem;
+using namespace DyldExtractor;
+
+struct ProgramArguments {
+  fs::path cachePath;
+  std::optional<std::string> imageFilter;
+  unsigned int iterations;
+  unsigned int maxImages;
+  unsigned int threads;
+};
+
+ProgramArguments parseArgs(int argc, char *argv[]) {
+  argparse::ArgumentParser program("bench_slide");
+
+  program.add_argument("cache_path")
+      .help("The path to the shared cache. If there are subcaches, give the "
+            "main one (typically without the file extension).");
+
+  program.add_argument("-e", "--image")
+      .help("Only benchmark images that contain this string in their path.");
+
+  program.add_argument("-i", "--iterations")
+      .help("The number of times to process each mapping.")
+      .scan<'d', unsigned int>()
+      .default_value(5u);
+
+  program.add_argument("-n", "--max-images")
+      .help("The maximum number of images to benchmark, 0 for all.")
+      .scan<'d', unsigned int>()
+      .default_value(0u);
+
+  program.add_argument("-t", "--threads")
+      .help("The number of threads the processors may use.")
+      .scan<'d', unsigned int>()
+      .default_value(1u);
+
+  ProgramArguments args;
+  try {
+    program.parse_args(argc, argv);
+
+    args.cachePath = fs::path(program.get<std::string>("cache_path"));
+    args.imageFilter = program.present<std::string>("--image");
+    args.iterations = program.get<unsigned int>("--iterations");
+    args.maxImages = program.get<unsigned int>("--max-images");
+    args.threads = program.get<unsigned int>("--threads");
+  } catch (const std::runtime_error &err) {
+    std::cerr << "Argument parsing error: " << err.what() << std::endl;
+    std::exit(1);
+  }
+
+  return args;
+}
+
+struct VersionResult {
+  uint64_t mappings = 0;
+  uint64_t pages = 0;
+  uint64_t pointers = 0;
+  std::chrono::duration<double> time{0};
+};
+
+template <class A>
+void benchmark(Dyld::Context &dCtx, const ProgramArguments &args) {
+  using P = A::P;
+
+  std::ostringstream nullStream;
+  Provider::ActivityLogger activity("bench_slide", nullStream, false);
+  activity.getLogger()->set_level(spdlog::level::off);
+  Provider::Accelerator<P> accelerator;
+  Dyld::CacheOverlay overlay(dCtx);
+
+  std::map<uint32_t, VersionResult> results;
+  unsigned int imagesRun = 0;
+  for (const auto imageInfo : dCtx.images) {
+    std::string imagePath((char *)(dCtx.file + imageInfo->pathFileOffset));
+    if (args.imageFilter &&
+        imagePath.find(*args.imageFilter) == std::string::npos) {
+      continue;
+    }
+    if (args.maxImages && imagesRun >= args.maxImages) {
+      break;
+    }
+    imagesRun++;
+
+    for (unsigned int i = 0; i < args.iterations; i++) {
+      // Some processors write slid values, so every iteration needs the
+      // original data
+      auto mCtx = overlay.createMachoCtx<P>(imageInfo);
+      Utils::ExtractionContext<A> eCtx(dCtx, mCtx, accelerator, activity);
+      eCtx.threads = args.threads;
+      const auto pageSize = eCtx.ptrTracker.getPageSize();
+
+      for (const auto map : eCtx.ptrTracker.getSlideMappings()) {
+        uint64_t pages = 0;
+        for (const auto &seg : mCtx.segments) {
+          if (map->containsAddr(seg.command->vmaddr)) {
+            pages += Utils::align(seg.command->vmsize, pageSize) / pageSize;
+          }
+        }
+        if (!pages) {
+          continue;
+        }
+
+        eCtx.ptrTracker.freeze();
+        const auto pointersBefore = eCtx.ptrTracker.getPointers().size();
+        auto start = std::chrono::steady_clock::now();
+        Converter::processSlideMapping(eCtx, *map);
+        auto end = std::chrono::steady_clock::now();
+        eCtx.ptrTracker.freeze();
+
+        auto &result = results[map->slideInfoVersion];
+        result.mappings++;
+        result.pages += pages;
+        result.pointers += eCtx.ptrTracker.getPointers().size() - pointersBefore;
+        result.time += end - start;
+      }
+
+      overlay.reset();
+    }
+  }
+
+  std::cout << fmt::format("{} images, {} iterations, {} threads\n",
+                           imagesRun, args.iterations, args.threads);
+  std::cout << fmt::format("{:>7} {:>9} {:>10} {:>12} {:>10} {:>12} {:>14}\n",
+                           "version", "mappings", "pages", "pointers",
+                           "seconds", "pages/s", "pointers/s");
+  for (const auto &[version, result] : results) {
+    const double seconds = result.time.count();
+    std::cout << fmt::format(
+        "{:>7} {:>9} {:>10} {:>12} {:>10.4f} {:>12.0f} {:>14.0f}\n", version,
+        result.mappings, result.pages, result.pointers, seconds,
+        seconds > 0 ? result.pages / seconds : 0.0,
+        seconds > 0 ? result.pointers / seconds : 0.0);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  auto args = parseArgs(argc, argv);
+
+  try {
+    Dyld::Context dCtx(args.cachePath);
+
+    // use dyld's magic to select arch
+    if (strcmp(dCtx.header->magic, "dyld_v1  x86_64") == 0)
+      benchmark<Utils::Arch::x86_64>(dCtx, args);
+    else if (strcmp(dCtx.header->magic, "dyld_v1 x86_64h") == 0)
+      benchmark<Utils::Arch::x86_64>(dCtx, args);
+    else if (strcmp(dCtx.header->magic, "dyld_v1   armv7") == 0)
+      benchmark<Utils::Arch::arm>(dCtx, args);
+    else if (strncmp(dCtx.header->magic, "dyld_v1  armv7", 14) == 0)
+      benchmark<Utils::Arch::arm>(dCtx, args);
+    else if (strcmp(dCtx.header->magic, "dyld_v1   arm64") == 0)
+      benchmark<Utils::Arch::arm64>(dCtx, args);
+    else if (strcmp(dCtx.header->magic, "dyld_v1  arm64e") == 0)
+      benchmark<Utils::Arch::arm64>(dCtx, args);
+    else if (strcmp(dCtx.header->magic, "dyld_v1arm64_32") == 0)
+      benchmark<Utils::Arch::arm64_32>(dCtx, args);
+    else {
+      std::cerr << "Unrecognized dyld shared cache magic." << std::endl;
+      return 1;
+    }
+  } catch (const std::exception &e) {
+    std::cerr << fmt::format("An error has occurred: {}", e.what())
+              << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
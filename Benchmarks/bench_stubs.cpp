@@ -0,0 +1,178 @@
+#include <argparse/argparse.hpp>
+#include <chrono>
+#include <filesystem>
+#include <fmt/core.h>
+#include <map>
+
+#include <Converter/Stubs/Arm64Utils.h>
+#include <Converter/Stubs/ArmUtils.h>
+#include <Dyld/DyldContext.h>
+#include <Provider/PointerTracker.h>
+#include <Utils/Utils.h>
+
+namespace fs = std::filesystem;
+using namespace DyldExtractor;
+
+struct ProgramArguments {
+  fs::path cachePath;
+  std::optional<std::string> imageFilter;
+  unsigned int iterations;
+  unsigned int maxImages;
+};
+
+ProgramArguments parseArgs(int argc, char *argv[]) {
+  argparse::ArgumentParser program("bench_stubs");
+
+  program.add_argument("cache_path")
+      .help("The path to the shared cache. If there are subcaches, give the "
+            "main one (typically without the file extension).");
+
+  program.add_argument("-e", "--image")
+      .help("Only benchmark images that contain this string in their path.");
+
+  program.add_argument("-i", "--iterations")
+      .help("The number of times to resolve the stubs of each image.")
+      .scan<'d', unsigned int>()
+      .default_value(5u);
+
+  program.add_argument("-n", "--max-images")
+      .help("The maximum number of images to benchmark, 0 for all.")
+      .scan<'d', unsigned int>()
+      .default_value(0u);
+
+  ProgramArguments args;
+  try {
+    program.parse_args(argc, argv);
+
+    args.cachePath = fs::path(program.get<std::string>("cache_path"));
+    args.imageFilter = program.present<std::string>("--image");
+    args.iterations = program.get<unsigned int>("--iterations");
+    args.maxImages = program.get<unsigned int>("--max-images");
+  } catch (const std::runtime_error &err) {
+    std::cerr << "Argument parsing error: " << err.what() << std::endl;
+    std::exit(1);
+  }
+
+  return args;
+}
+
+struct SectionResult {
+  uint64_t sections = 0;
+  uint64_t stubs = 0;
+  uint64_t resolved = 0;
+  std::chrono::duration<double> time{0};
+};
+
+template <class A>
+void benchmark(Dyld::Context &dCtx, const ProgramArguments &args) {
+  using P = A::P;
+  using PtrT = P::PtrT;
+
+  Provider::Accelerator<P> accelerator;
+  Provider::PointerTracker<P> ptrTracker(dCtx);
+  ptrTracker.enableLazySliding();
+
+  std::optional<Converter::Stubs::Arm64Utils<A>> arm64Utils;
+  std::optional<Converter::Stubs::ArmUtils> armUtils;
+  if constexpr (std::is_same_v<A, Utils::Arch::arm64> ||
+                std::is_same_v<A, Utils::Arch::arm64_32>) {
+    arm64Utils.emplace(dCtx, accelerator, ptrTracker);
+  } else {
+    armUtils.emplace(dCtx, accelerator, ptrTracker);
+  }
+
+  std::map<std::string, SectionResult> results;
+  unsigned int imagesRun = 0;
+  for (const auto imageInfo : dCtx.images) {
+    std::string imagePath((char *)(dCtx.file + imageInfo->pathFileOffset));
+    if (args.imageFilter &&
+        imagePath.find(*args.imageFilter) == std::string::npos) {
+      continue;
+    }
+    if (args.maxImages && imagesRun >= args.maxImages) {
+      break;
+    }
+    imagesRun++;
+
+    auto mCtx = dCtx.createMachoCtx<true, P>(imageInfo);
+    mCtx.enumerateSections(
+        [](auto seg, auto sect) {
+          return (sect->flags & SECTION_TYPE) == S_SYMBOL_STUBS;
+        },
+        [&](auto seg, auto sect) {
+          const uint32_t stubSize = sect->reserved2;
+          if (!stubSize) {
+            return true;
+          }
+
+          auto &result = results[std::string(sect->sectname,
+                                             strnlen(sect->sectname, 16))];
+          result.sections++;
+          for (unsigned int i = 0; i < args.iterations; i++) {
+            uint64_t resolved = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (PtrT addr = sect->addr; addr < sect->addr + sect->size;
+                 addr += stubSize) {
+              if constexpr (std::is_same_v<A, Utils::Arch::arm>) {
+                resolved += armUtils->resolveStub(addr).has_value();
+              } else {
+                resolved += arm64Utils->resolveStub(addr).has_value();
+              }
+            }
+            auto end = std::chrono::steady_clock::now();
+
+            result.stubs += sect->size / stubSize;
+            result.resolved += resolved;
+            result.time += end - start;
+          }
+          return true;
+        });
+  }
+
+  std::cout << fmt::format("{} images, {} iterations\n", imagesRun,
+                           args.iterations);
+  std::cout << fmt::format("{:>18} {:>9} {:>10} {:>10} {:>10} {:>12}\n",
+                           "section", "sections", "stubs", "resolved",
+                           "seconds", "stubs/s");
+  for (const auto &[name, result] : results) {
+    const double seconds = result.time.count();
+    std::cout << fmt::format("{:>18} {:>9} {:>10} {:>10} {:>10.4f} {:>12.0f}\n",
+                             name, result.sections, result.stubs,
+                             result.resolved, seconds,
+                             seconds > 0 ? result.stubs / seconds : 0.0);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  auto args = parseArgs(argc, argv);
+
+  try {
+    Dyld::Context dCtx(args.cachePath);
+
+    // use dyld's magic to select arch
+    if (strcmp(dCtx.header->magic, "dyld_v1   armv7") == 0)
+      benchmark<Utils::Arch::arm>(dCtx, args);
+    else if (strncmp(dCtx.header->magic, "dyld_v1  armv7", 14) == 0)
+      benchmark<Utils::Arch::arm>(dCtx, args);
+    else if (strcmp(dCtx.header->magic, "dyld_v1   arm64") == 0)
+      benchmark<Utils::Arch::arm64>(dCtx, args);
+    else if (strcmp(dCtx.header->magic, "dyld_v1  arm64e") == 0)
+      benchmark<Utils::Arch::arm64>(dCtx, args);
+    else if (strcmp(dCtx.header->magic, "dyld_v1arm64_32") == 0)
+      benchmark<Utils::Arch::arm64_32>(dCtx, args);
+    else if (strncmp(dCtx.header->magic, "dyld_v1 x86_64", 14) == 0 ||
+             strcmp(dCtx.header->magic, "dyld_v1  x86_64") == 0) {
+      std::cerr << "Stubs are only resolved for arm and arm64." << std::endl;
+      return 1;
+    } else {
+      std::cerr << "Unrecognized dyld shared cache magic." << std::endl;
+      return 1;
+    }
+  } catch (const std::exception &e) {
+    std::cerr << fmt::format("An error has occurred: {}", e.what())
+              << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -8,10 +8,12 @@
 #include <Converter/Linkedit/Linkedit.h>
 #include <Converter/Objc/Objc.h>
 #include <Converter/OffsetOptimizer.h>
+#include <Converter/OutputWriter.h>
 #include <Converter/Slide.h>
 #include <Converter/Stubs/Stubs.h>
 #include <Dyld/DyldContext.h>
 #include <Macho/MachoContext.h>
+#include <Provider/AcceleratorCache.h>
 #include <Provider/Validator.h>
 #include <Utils/ExtractionContext.h>
 
@@ -27,7 +29,13 @@ struct ProgramArguments {
   std::optional<std::string> listFilter;
   std::optional<std::string> extractImage;
   std::optional<fs::path> outputPath;
+  bool sparse;
+  std::optional<Converter::CompressionOptions> compression;
   bool imbedVersion;
+  std::optional<fs::path> acceleratorCacheDir;
+  unsigned int threads = 1;
+  bool lazySymbols;
+  bool optimizeOpcodes;
 
   union {
     uint32_t raw;
@@ -64,6 +72,17 @@ ProgramArguments parseArgs(int argc, char *argv[]) {
   program.add_argument("-o", "--output")
       .help("The output path for the extracted image. Required for extraction");
 
+  program.add_argument("--sparse")
+      .help("Leave pages of the output that are all zeros as holes in the "
+            "file, which saves writes and disk space.")
+      .default_value(false)
+      .implicit_value(true);
+
+  program.add_argument("--compress")
+      .help("Compress the output with zstd at this level while it is "
+            "written. Needs a build with DYLDEXTRACTORC_ZSTD.")
+      .scan<'d', int>();
+
   program.add_argument("-s", "--skip-modules")
       .help("Skip certain modules. Most modules depend on each other, so use "
             "with caution. Useful for development. 1=processSlideInfo, "
@@ -77,6 +96,27 @@ ProgramArguments parseArgs(int argc, char *argv[]) {
       .default_value(false)
       .implicit_value(true);
 
+  program.add_argument("-j", "--threads")
+      .help("The number of threads to use while processing the image.")
+      .scan<'d', unsigned int>()
+      .default_value(1u);
+
+  program.add_argument("--lazy-symbols")
+      .help("Only read the exports and symbols that are looked up, instead of "
+            "every dependency's up front.")
+      .default_value(false)
+      .implicit_value(true);
+
+  program.add_argument("--optimize-opcodes")
+      .help("Pick the smallest rebase and bind opcodes for images that use "
+            "them. Slower, but makes the dyld info smaller.")
+      .default_value(false)
+      .implicit_value(true);
+
+  program.add_argument("--accelerator-cache")
+      .help("A directory to store accelerator data, which speeds up later runs "
+            "on the same cache.");
+
   ProgramArguments args;
   try {
     program.parse_args(argc, argv);
@@ -87,8 +127,21 @@ ProgramArguments parseArgs(int argc, char *argv[]) {
     args.listFilter = program.present<std::string>("--filter");
     args.extractImage = program.present<std::string>("--extract");
     args.outputPath = program.present<std::string>("--output");
+    args.sparse = program.get<bool>("--sparse");
     args.modulesDisabled.raw = program.get<int>("--skip-modules");
     args.imbedVersion = program.get<bool>("--imbed-version");
+    args.threads = program.get<unsigned int>("--threads");
+    args.lazySymbols = program.get<bool>("--lazy-symbols");
+    args.optimizeOpcodes = program.get<bool>("--optimize-opcodes");
+    if (auto dir = program.present<std::string>("--accelerator-cache"); dir) {
+      args.acceleratorCacheDir = fs::path(*dir);
+    }
+    if (auto level = program.present<int>("--compress"); level) {
+      if (!Converter::compressionSupported()) {
+        throw std::runtime_error("This build does not support compression.");
+      }
+      args.compression = Converter::CompressionOptions{*level, args.threads};
+    }
   } catch (const std::runtime_error &err) {
     std::cerr << "Argument parsing error: " << err.what() << std::endl;
     std::exit(1);
@@ -170,7 +223,17 @@ void extractImage(Dyld::Context &dCtx, ProgramArguments args) {
   activity.update("DyldEx", "Starting up");
 
   Provider::Accelerator<P> accelerator;
+  std::optional<Provider::AcceleratorCache<P>> acceleratorCache;
+  if (args.acceleratorCacheDir) {
+    acceleratorCache.emplace(*args.acceleratorCacheDir, dCtx);
+    if (!acceleratorCache->load(accelerator)) {
+      SPDLOG_LOGGER_INFO(logger, "Accelerator cache not loaded.");
+    }
+  }
   Utils::ExtractionContext<A> eCtx(dCtx, mCtx, accelerator, activity);
+  eCtx.threads = args.threads;
+  eCtx.lazySymbols = args.lazySymbols;
+  eCtx.optimizeOpcodes = args.optimizeOpcodes;
 
   // Process
   if (!args.modulesDisabled.processSlideInfo) {
@@ -197,21 +260,24 @@ void extractImage(Dyld::Context &dCtx, ProgramArguments args) {
       mCtx.header->reserved = DYLDEXTRACTORC_VERSION_DATA;
     }
   }
-  auto writeProcedures = Converter::optimizeOffsets(eCtx);
+  auto plan = Converter::planOutput(eCtx);
 
   // Write
   fs::create_directories(args.outputPath->parent_path());
-  std::ofstream outFile(*args.outputPath, std::ios_base::binary);
-  if (!outFile.good()) {
-    SPDLOG_LOGGER_ERROR(logger, "Unable to open output file.");
+  const bool written =
+      args.compression
+          ? Converter::writeCompressedProcedures(
+                *args.outputPath, plan.procedures, *args.compression)
+          : Converter::writeProcedures(*args.outputPath, plan, args.sparse);
+  if (!written) {
+    SPDLOG_LOGGER_ERROR(logger, "Unable to write output file.");
     return;
   }
 
-  for (auto procedure : writeProcedures) {
-    outFile.seekp(procedure.writeOffset);
-    outFile.write((const char *)procedure.source, procedure.size);
+  if (acceleratorCache) {
+    fs::create_directories(*args.acceleratorCacheDir);
+    acceleratorCache->save(accelerator);
   }
-  outFile.close();
 
   activity.update("DyldEx", "Done");
   activity.stopActivity();
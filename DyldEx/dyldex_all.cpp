@@ -1,20 +1,42 @@
+#include <algorithm>
+#include <deque>
 #include <filesystem>
 #include <fstream>
+#include <future>
 #include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <regex>
+#include <mutex>
+#include <set>
+#include <thread>
 
 #include <argparse/argparse.hpp>
 #include <spdlog/spdlog.h>
 
+#include <Converter/ContentStore.h>
+#include <Converter/Extractor.h>
 #include <Converter/Linkedit/Linkedit.h>
 #include <Converter/Objc/Objc.h>
 #include <Converter/OffsetOptimizer.h>
+#include <Converter/OutputWriter.h>
 #include <Converter/Slide.h>
 #include <Converter/Stubs/Stubs.h>
+#include <Dyld/CacheOverlay.h>
 #include <Dyld/DyldContext.h>
 #include <Macho/MachoContext.h>
 #include <Provider/Accelerator.h>
+#include <Provider/AcceleratorCache.h>
+#include <Provider/ImageSelector.h>
+#include <Provider/MetricsExporter.h>
+#include <Provider/Profiler.h>
 #include <Provider/Validator.h>
+#include <Utils/AllocationCounter.h>
 #include <Utils/ExtractionContext.h>
+#include <Utils/PerfCounters.h>
+#include <Utils/Placement.h>
+#include <Utils/Threading.h>
 
 #include "config.h"
 
@@ -24,11 +46,43 @@ using namespace DyldExtractor;
 #pragma region Arguments
 struct ProgramArguments {
   fs::path cache_path;
+  // More caches to process after cache_path
+  std::vector<fs::path> batchCaches;
+  bool parallelCaches = false;
+  // The name of the cache in a batch
+  std::string cacheName;
+  // The index of the cache in a batch that is processed in parallel
+  unsigned int cacheIndex = 0;
   std::optional<fs::path> outputDir;
+  std::optional<fs::path> archivePath;
+  std::optional<fs::path> contentStoreDir;
+  bool sparse;
+  std::optional<Converter::CompressionOptions> compression;
   bool verbose;
+  bool quiet;
   bool disableOutput;
   bool onlyValidate;
   bool imbedVersion;
+  std::optional<fs::path> acceleratorCacheDir;
+  std::optional<fs::path> profileReport;
+  bool perfCounters = false;
+  std::optional<fs::path> metricsPath;
+  unsigned int metricsInterval = 5;
+  bool useOverlay;
+  unsigned int writeQueue;
+  std::vector<std::pair<std::string, unsigned int>> stageLimits;
+  bool prefetch;
+  bool releasePages;
+  bool preloadExports;
+  bool hugePages;
+  unsigned int jobs;
+  Utils::Placement::Policy pin = Utils::Placement::Policy::None;
+  unsigned int imageThreads = 1;
+  bool lazySymbols;
+  bool optimizeOpcodes;
+  std::vector<std::string> filters;
+  std::vector<std::string> regexes;
+  bool withDependencies;
 
   union {
     uint32_t raw;
@@ -46,22 +100,93 @@ ProgramArguments parseArgs(int argc, char *argv[]) {
       .help("The path to the shared cache. If there are subcaches, give the "
             "main one (typically without the file extension).");
 
+  program.add_argument("--cache-list")
+      .help("A file with the paths of more caches to process after "
+            "cache_path, one per line. Each cache is written to a directory "
+            "or file named after it, and the next cache is opened while the "
+            "current one is processed.");
+
+  program.add_argument("--parallel-caches")
+      .help("Process the caches of --cache-list at the same time instead of "
+            "in turn, like the x86_64, x86_64h, and arm64e caches of macOS. "
+            "The caches share --jobs images at a time, and one summary and "
+            "profile report covers them all.")
+      .default_value(false)
+      .implicit_value(true);
+
   program.add_argument("-o", "--output-dir")
       .help("The output directory for the extracted images. Required for "
             "extraction");
 
+  program.add_argument("--archive")
+      .help("Write the extracted images into a tar archive instead of the "
+            "output directory. With multiple jobs, each worker writes a shard "
+            "of the archive, like cache.0.tar.");
+
+  program.add_argument("--content-store")
+      .help("Write the extracted images into a content addressed store "
+            "instead of the output directory. Images that are identical to "
+            "ones from other caches are only stored once, and a manifest maps "
+            "the image paths of this cache to the stored files. Can't be used "
+            "with --archive.");
+
+  program.add_argument("--sparse")
+      .help("Leave pages that are all zeros as holes in the files in the "
+            "output directory, which saves writes and disk space.")
+      .default_value(false)
+      .implicit_value(true);
+
+  program.add_argument("--compress")
+      .help("Compress the images in the output directory with zstd at this "
+            "level while they are written, adding .zst to their names. Needs "
+            "a build with DYLDEXTRACTORC_ZSTD.")
+      .scan<'d', int>();
+
   program.add_argument("-v", "--verbose")
       .help("Enables debug logging messages.")
       .default_value(false)
       .implicit_value(true);
 
+  program.add_argument("-q", "--quiet")
+      .help("Omits the processed images messages unless there are logs.")
+      .default_value(false)
+      .implicit_value(true);
+
   program.add_argument("-d", "--disable-output")
       .help("Disables writing output. Useful for development.")
       .default_value(false)
       .implicit_value(true);
 
   program.add_argument("--only-validate")
-      .help("Only validate images.")
+      .help("Only validate images. Images are validated in parallel with "
+            "--jobs.")
+      .default_value(false)
+      .implicit_value(true);
+
+  program.add_argument("-j", "--jobs")
+      .help("The number of images to process in parallel.")
+      .scan<'d', unsigned int>()
+      .default_value(1u);
+
+  program.add_argument("--pin")
+      .help("Pin each worker thread to its own CPUs, one per image thread "
+            "(core), or to the CPUs of one NUMA node (node), spreading "
+            "workers over the nodes. Linux only.")
+      .default_value(std::string("none"));
+
+  program.add_argument("--filter")
+      .help("Only process images whose path matches this glob pattern, where "
+            "* also matches /. Can be given multiple times.")
+      .append();
+
+  program.add_argument("--regex")
+      .help("Only process images whose path contains a match of this regex. "
+            "Can be given multiple times.")
+      .append();
+
+  program.add_argument("--with-dependencies")
+      .help("Also process the dependencies of the filtered images, "
+            "following their dylib load commands.")
       .default_value(false)
       .implicit_value(true);
 
@@ -78,25 +203,227 @@ ProgramArguments parseArgs(int argc, char *argv[]) {
       .default_value(false)
       .implicit_value(true);
 
+  program.add_argument("--overlay")
+      .help("Share one copy on write mapping of the cache between all images "
+            "instead of remapping every subcache for each image.")
+      .default_value(false)
+      .implicit_value(true);
+
+  program.add_argument("--huge-pages")
+      .help("Copy the cache into huge page backed memory before processing, "
+            "which reduces TLB misses on large caches. Falls back to the file "
+            "mapping if huge pages are not available.")
+      .default_value(false)
+      .implicit_value(true);
+
+  program.add_argument("--write-queue")
+      .help("Write images to the output directory in the background, with up "
+            "to this many images queued. Workers go on to the next image while "
+            "the last one is written. Not used with --overlay.")
+      .scan<'d', unsigned int>()
+      .default_value(0u);
+
+  program.add_argument("--stage-limit")
+      .help("Limit the number of workers in a stage at once, like "
+            "fixObjc=2. Workers keep working on other stages, so images are "
+            "pipelined through the stages. The stages are validate, "
+            "processSlideInfo, optimizeLinkedit, fixStubs, fixObjc, "
+            "generateMetadata, optimizeOffsets and write. Can be given "
+            "multiple times.")
+      .append();
+
+  program.add_argument("--prefetch")
+      .help("Read in the segments of the images that workers take next while "
+            "the current images are processed.")
+      .default_value(false)
+      .implicit_value(true);
+
+  program.add_argument("--release-pages")
+      .help("Drop the cache's pages from memory after each image, which keeps "
+            "the resident size flat on large caches. Pages are read from disk "
+            "again when needed. Caches loaded with --huge-pages are kept.")
+      .default_value(false)
+      .implicit_value(true);
+
+  program.add_argument("--preload-exports")
+      .help("Read the exports of every image in parallel before extracting, "
+            "instead of each dependency when an image first needs it.")
+      .default_value(false)
+      .implicit_value(true);
+
+  program.add_argument("--image-threads")
+      .help("The number of threads to use within each image.")
+      .scan<'d', unsigned int>()
+      .default_value(1u);
+
+  program.add_argument("--lazy-symbols")
+      .help("Only read the exports and symbols that are looked up, instead of "
+            "every dependency's up front. Needs one image thread.")
+      .default_value(false)
+      .implicit_value(true);
+
+  program.add_argument("--optimize-opcodes")
+      .help("Pick the smallest rebase and bind opcodes for images that use "
+            "them. Slower, but makes the dyld info smaller.")
+      .default_value(false)
+      .implicit_value(true);
+
+  program.add_argument("--accelerator-cache")
+      .help("A directory to store accelerator data, which speeds up later runs "
+            "on the same cache.");
+
+  program.add_argument("--profile")
+      .help("Write a report of the time spent in each stage of each image. "
+            "JSON if the path ends with .json, otherwise CSV.");
+
+  program.add_argument("--perf-counters")
+      .help("Also record the cycles, instructions, cache, branch, and TLB "
+            "misses of each stage in the --profile report. Linux only.")
+      .default_value(false)
+      .implicit_value(true);
+
+  program.add_argument("--metrics")
+      .help("Periodically rewrite a status file with the images completed and "
+            "failed, stage latencies, bytes written, memory, and queue depth. "
+            "Prometheus text format if the path ends with .prom, otherwise "
+            "JSON.");
+
+  program.add_argument("--metrics-interval")
+      .help("The seconds between writes of the metrics file.")
+      .scan<'d', unsigned int>()
+      .default_value(5u);
+
   ProgramArguments args;
   try {
     program.parse_args(argc, argv);
 
     args.cache_path = fs::path(program.get<std::string>("cache_path"));
+    if (auto path = program.present<std::string>("--cache-list"); path) {
+      std::ifstream listFile(*path);
+      if (!listFile) {
+        throw std::runtime_error("Unable to read the cache list.");
+      }
+      for (std::string line; std::getline(listFile, line);) {
+        line.erase(line.find_last_not_of(" \t\r") + 1);
+        if (!line.empty()) {
+          args.batchCaches.emplace_back(line);
+        }
+      }
+    }
+    args.parallelCaches = program.get<bool>("--parallel-caches");
     args.outputDir = program.present<std::string>("--output-dir");
+    if (auto path = program.present<std::string>("--archive"); path) {
+      args.archivePath = fs::path(*path);
+    }
+    if (auto dir = program.present<std::string>("--content-store"); dir) {
+      args.contentStoreDir = fs::path(*dir);
+    }
+    if (args.archivePath && args.contentStoreDir) {
+      throw std::runtime_error(
+          "--archive and --content-store can't be used together.");
+    }
+    args.sparse = program.get<bool>("--sparse");
     args.verbose = program.get<bool>("--verbose");
+    args.quiet = program.get<bool>("--quiet");
     args.disableOutput = program.get<bool>("--disable-output");
     args.onlyValidate = program.get<bool>("--only-validate");
+    args.jobs = program.get<unsigned int>("--jobs");
+    if (auto policy =
+            Utils::Placement::parsePolicy(program.get<std::string>("--pin"))) {
+      args.pin = *policy;
+    } else {
+      throw std::runtime_error("--pin must be none, core, or node.");
+    }
+    args.imageThreads = program.get<unsigned int>("--image-threads");
+    args.lazySymbols = program.get<bool>("--lazy-symbols");
+    if (args.lazySymbols && args.imageThreads > 1) {
+      throw std::runtime_error(
+          "--lazy-symbols can't be used with more than one image thread.");
+    }
+    args.optimizeOpcodes = program.get<bool>("--optimize-opcodes");
+    if (auto level = program.present<int>("--compress"); level) {
+      if (!Converter::compressionSupported()) {
+        throw std::runtime_error("This build does not support compression.");
+      }
+      args.compression =
+          Converter::CompressionOptions{*level, args.imageThreads};
+    }
+    if (auto filters =
+            program.present<std::vector<std::string>>("--filter")) {
+      args.filters = *filters;
+    }
+    if (auto regexes = program.present<std::vector<std::string>>("--regex")) {
+      for (const auto &regex : *regexes) {
+        try {
+          (void)std::regex(regex, std::regex::ECMAScript);
+        } catch (const std::regex_error &e) {
+          throw std::runtime_error(
+              fmt::format("Invalid regex '{}': {}", regex, e.what()));
+        }
+      }
+      args.regexes = *regexes;
+    }
+    args.withDependencies = program.get<bool>("--with-dependencies");
     args.modulesDisabled.raw = program.get<int>("--skip-modules");
     args.imbedVersion = program.get<bool>("--imbed-version");
+    if (auto dir = program.present<std::string>("--accelerator-cache"); dir) {
+      args.acceleratorCacheDir = fs::path(*dir);
+    }
+    args.useOverlay = program.get<bool>("--overlay");
+    args.writeQueue = program.get<unsigned int>("--write-queue");
+    if (auto limits = program.present<std::vector<std::string>>(
+            "--stage-limit")) {
+      static const std::set<std::string> stages = {
+          "validate",         "processSlideInfo", "optimizeLinkedit",
+          "fixStubs",         "fixObjc",          "generateMetadata",
+          "optimizeOffsets",  "write"};
+      for (const auto &limit : *limits) {
+        const auto split = limit.find('=');
+        if (split == std::string::npos ||
+            !stages.contains(limit.substr(0, split))) {
+          throw std::runtime_error(
+              fmt::format("Invalid stage limit '{}'.", limit));
+        }
+        const auto countStr = limit.substr(split + 1);
+        unsigned long count;
+        try {
+          count = std::stoul(countStr);
+          if (countStr.find_first_not_of("0123456789") != std::string::npos ||
+              count > std::numeric_limits<unsigned int>::max()) {
+            throw std::invalid_argument(countStr);
+          }
+        } catch (const std::logic_error &) {
+          throw std::runtime_error(
+              fmt::format("Invalid stage limit '{}'.", limit));
+        }
+        args.stageLimits.emplace_back(limit.substr(0, split),
+                                      (unsigned int)count);
+      }
+    }
+    args.prefetch = program.get<bool>("--prefetch");
+    args.releasePages = program.get<bool>("--release-pages");
+    args.preloadExports = program.get<bool>("--preload-exports");
+    args.hugePages = program.get<bool>("--huge-pages");
+    if (auto path = program.present<std::string>("--profile"); path) {
+      args.profileReport = fs::path(*path);
+    }
+    args.perfCounters = program.get<bool>("--perf-counters");
+    if (auto path = program.present<std::string>("--metrics"); path) {
+      args.metricsPath = fs::path(*path);
+    }
+    args.metricsInterval =
+        std::max(program.get<unsigned int>("--metrics-interval"), 1u);
 
   } catch (const std::runtime_error &err) {
     std::cerr << "Argument parsing error: " << err.what() << std::endl;
     std::exit(1);
   }
 
-  if (!args.disableOutput && !args.outputDir) {
-    std::cerr << "Output directory is required for extraction" << std::endl;
+  if (!args.disableOutput && !args.outputDir && !args.archivePath &&
+      !args.contentStoreDir) {
+    std::cerr << "Output directory, archive, or content store is required "
+                 "for extraction"
+              << std::endl;
     std::exit(1);
   }
 
@@ -104,168 +431,673 @@ ProgramArguments parseArgs(int argc, char *argv[]) {
 }
 #pragma endregion Arguments
 
+/// @brief Get the stages to run from the arguments.
+Converter::ExtractionOptions
+getExtractionOptions(const ProgramArguments &args) {
+  Converter::ExtractionOptions options;
+  options.processSlideInfo = !args.modulesDisabled.processSlideInfo;
+  options.optimizeLinkedit = !args.modulesDisabled.optimizeLinkedit;
+  options.fixStubs = !args.modulesDisabled.fixStubs;
+  options.fixObjc = !args.modulesDisabled.fixObjc;
+  options.generateMetadata = !args.modulesDisabled.generateMetadata;
+  if (args.imbedVersion) {
+    options.imbedVersion = DYLDEXTRACTORC_VERSION_DATA;
+  }
+  options.threads = args.imageThreads;
+  options.lazySymbols = args.lazySymbols;
+  options.optimizeOpcodes = args.optimizeOpcodes;
+  options.verbose = args.verbose;
+  return options;
+}
+
+/// @brief Start reading in the segments of an image, except the linkedit.
+template <class P>
+void prefetchImage(const Dyld::Context &dCtx,
+                   const dyld_cache_image_info *imageInfo) {
+  auto mCtx = dCtx.createMachoCtx<true, P>(imageInfo);
+  for (const auto &seg : mCtx.segments) {
+    if (strncmp(seg.command->segname, SEG_LINKEDIT, 16) != 0) {
+      dCtx.advise(seg.command->vmaddr, seg.command->vmsize,
+                  Macho::Advice::WillNeed);
+    }
+  }
+}
+
+/// Captures the logs of a worker's images. The buffer keeps its space between
+/// images, so images without logs don't allocate.
+class LogCapture : public std::streambuf {
+public:
+  LogCapture() : stream(this) {}
+
+  std::ostream &getStream() { return stream; }
+
+  /// If nothing was logged since the last clear.
+  bool empty() const { return buffer.empty(); }
+  std::string_view view() const { return buffer; }
+
+  /// Move the logs out, leaving the capture empty.
+  std::string take() {
+    auto logs = std::move(buffer);
+    buffer.clear();
+    return logs;
+  }
+
+  void clear() { buffer.clear(); }
+
+private:
+  std::string buffer;
+  std::ostream stream;
+
+  int overflow(int c) override {
+    if (c != traits_type::eof()) {
+      buffer.push_back((char)c);
+    }
+    return c;
+  }
+
+  std::streamsize xsputn(const char *s, std::streamsize count) override {
+    buffer.append(s, count);
+    return count;
+  }
+};
+
+/// The context of an image. It is kept alive by the writer until the image is
+/// written, and then reused by the worker for its next image.
+template <class A> struct ImageState {
+  Macho::Context<false, typename A::P> mCtx;
+  std::optional<Provider::ActivityLogger> activity;
+  Utils::ExtractionContext<A> eCtx;
+  // The stream the activity logs to
+  std::ostream *logOutput;
+  // If the logger's pattern and level are set
+  bool loggerConfigured = false;
+
+  ImageState(const Dyld::Context &dCtx,
+             Macho::Context<false, typename A::P> &&mCtx,
+             Provider::Accelerator<typename A::P> &accelerator,
+             const std::string &name, std::ostream &logStream)
+      : mCtx(std::move(mCtx)), activity(std::in_place, name, logStream, false),
+        eCtx(dCtx, this->mCtx, accelerator, *activity), logOutput(&logStream) {
+  }
+
+  /// Switch to another image, keeping the providers' space. The logger is
+  /// kept if it logs to the same stream.
+  void reuse(Macho::Context<false, typename A::P> &&newMCtx,
+             const std::string &name, std::ostream &logStream) {
+    mCtx = std::move(newMCtx);
+    if (logOutput != &logStream) {
+      activity.emplace(name, logStream, false);
+      logOutput = &logStream;
+      loggerConfigured = false;
+    }
+    eCtx.reset(mCtx, *activity);
+  }
+};
+
+/// Shared by the caches of a batch that are processed at the same time.
+struct CacheBatch {
+  // Limits the images being processed by all caches to the jobs
+  Utils::StageLimiter budget;
+  std::mutex mutex;
+  // The title and logs of each summary entry, of all caches
+  std::vector<std::pair<std::string, std::string>> summary;
+  // The records of all caches
+  Provider::Profiler profiler;
+};
+
+/// @brief Process an image.
+/// @returns False if the image failed validation or could not be written.
 template <class A>
-void runImage(Dyld::Context &dCtx,
+bool runImage(Dyld::Context &dCtx, Dyld::CacheOverlay *overlay,
               Provider::Accelerator<typename A::P> &accelerator,
+              Provider::Profiler &profiler, Utils::StageLimiter &limiter,
+              Provider::MetricsExporter *metrics,
+              Converter::ArchiveWriter *archive,
+              Converter::ContentStore *contentStore,
+              Converter::AsyncWriter *writer,
               const dyld_cache_image_info *imageInfo,
               const std::string imagePath, const std::string imageName,
-              const ProgramArguments &args, std::ostream &logStream) {
+              const ProgramArguments &args, std::ostream &logStream,
+              std::shared_ptr<ImageState<A>> &reusableState) {
 
   // validate
-  auto mCtx = dCtx.createMachoCtx<false, typename A::P>(imageInfo);
+  auto mCtx =
+      overlay ? overlay->createMachoCtx<typename A::P>(imageInfo)
+              : dCtx.createMachoCtx<false, typename A::P>(imageInfo);
+  uint64_t imageSize = 0;
+  for (const auto &seg : mCtx.segments) {
+    imageSize += seg.command->filesize;
+  }
+  // Allocation counts are logged with the image once it's done
+  std::deque<Provider::Profiler::Record> allocationRecords;
+  const bool countAllocations = Utils::AllocationCounter::enabled();
+  auto measure = [&](const char *stage, auto func, uint64_t size) {
+    auto record =
+        countAllocations ? &allocationRecords.emplace_back() : nullptr;
+    return limiter.run(stage, [&]() {
+      return profiler.measure(imageName, stage, size, func, record);
+    });
+  };
+
   try {
-    Provider::Validator<typename A::P>(mCtx).validate();
+    measure("validate", [&]() {
+      Provider::Validator<typename A::P>(mCtx).validate();
+    }, imageSize);
   } catch (const std::exception &e) {
-    std::cout << std::format("Validation Error: {}", e.what());
-    return;
+    logStream << std::format("Validation Error: {}", e.what()) << std::endl;
+    return false;
   }
 
   if (args.onlyValidate) {
-    return;
+    return true;
   }
 
-  // Setup context
-  Provider::ActivityLogger activity("DyldEx_" + imageName, logStream, false);
-  auto logger = activity.getLogger();
-  logger->set_pattern("[%-8l %s:%#] %v");
-  if (args.verbose) {
-    logger->set_level(spdlog::level::trace);
+  // Setup context, reusing the worker's last one if the writer is done with it
+  std::shared_ptr<ImageState<A>> state;
+  if (reusableState && reusableState.use_count() == 1) {
+    state = std::move(reusableState);
+    state->reuse(std::move(mCtx), "DyldEx_" + imageName, logStream);
   } else {
-    logger->set_level(spdlog::level::info);
+    state = std::make_shared<ImageState<A>>(
+        dCtx, std::move(mCtx), accelerator, "DyldEx_" + imageName, logStream);
   }
-
-  Utils::ExtractionContext<A> eCtx(dCtx, mCtx, accelerator, activity);
-
-  if (!args.modulesDisabled.processSlideInfo) {
-    Converter::processSlideInfo(eCtx);
-  }
-  if (!args.modulesDisabled.optimizeLinkedit) {
-    Converter::optimizeLinkedit(eCtx);
-  }
-  if (!args.modulesDisabled.fixStubs) {
-    Converter::fixStubs(eCtx);
-  }
-  if (!args.modulesDisabled.fixObjc) {
-    Converter::fixObjc(eCtx);
-  }
-  if (!args.modulesDisabled.generateMetadata) {
-    Converter::generateMetadata(eCtx);
-  }
-  if (args.imbedVersion) {
-    if constexpr (!std::is_same_v<typename A::P, Utils::Arch::Pointer64>) {
-      SPDLOG_LOGGER_ERROR(
-          logger, "Unable to imbed version info in a non 64 bit image.");
+  reusableState = state;
+  auto &eCtx = state->eCtx;
+  auto logger = state->activity->getLogger();
+  if (!state->loggerConfigured) {
+    logger->set_pattern("[%-8l %s:%#] %v");
+    if (args.verbose) {
+      logger->set_level(spdlog::level::trace);
     } else {
-      mCtx.header->reserved = DYLDEXTRACTORC_VERSION_DATA;
+      logger->set_level(spdlog::level::info);
     }
+    state->loggerConfigured = true;
   }
+  eCtx.threads = args.imageThreads;
+  eCtx.lazySymbols = args.lazySymbols;
+  eCtx.optimizeOpcodes = args.optimizeOpcodes;
+
+  Converter::runStages(eCtx, getExtractionOptions(args),
+                       [&](const char *stage, const auto &run) {
+                         measure(stage, run, imageSize);
+                       });
 
+  bool written = true;
   if (!args.disableOutput) {
-    auto writeProcedures = Converter::optimizeOffsets(eCtx);
-
-    auto outputPath = *args.outputDir / imagePath.substr(1); // remove leading /
-    fs::create_directories(outputPath.parent_path());
-    std::ofstream outFile(outputPath, std::ios_base::binary);
-    if (!outFile.good()) {
-      SPDLOG_LOGGER_ERROR(logger, "Unable to open output file.");
-      return;
+    auto plan = measure(
+        "optimizeOffsets", [&]() { return Converter::planOutput(eCtx); },
+        imageSize);
+    const auto &writeProcedures = plan.procedures;
+
+    uint64_t outputSize = 0;
+    for (const auto &procedure : writeProcedures) {
+      outputSize += procedure.size;
     }
 
-    for (auto procedure : writeProcedures) {
-      outFile.seekp(procedure.writeOffset);
-      outFile.write((const char *)procedure.source, procedure.size);
+    auto write = [&]() {
+      if (contentStore) {
+        auto hash = contentStore->add(writeProcedures);
+        if (hash) {
+          contentStore->record(imagePath, *hash);
+        }
+        return hash.has_value();
+      }
+      if (archive) {
+        return archive->add(imagePath.substr(1), writeProcedures);
+      }
+
+      auto outputPath =
+          *args.outputDir / imagePath.substr(1); // remove leading /
+      if (args.compression) {
+        outputPath += ".zst";
+      }
+      if (writer) {
+        writer->write(outputPath, std::move(plan), state);
+        return true;
+      }
+      fs::create_directories(outputPath.parent_path());
+      if (args.compression) {
+        return Converter::writeCompressedProcedures(
+            outputPath, writeProcedures, *args.compression);
+      }
+      return Converter::writeProcedures(outputPath, plan, args.sparse);
+    };
+
+    if (!measure("write", write, outputSize)) {
+      SPDLOG_LOGGER_ERROR(logger, "Unable to write output file.");
+      written = false;
+    } else if (metrics) {
+      metrics->addBytesWritten(outputSize);
     }
-    outFile.close();
   }
+
+  for (const auto &record : allocationRecords) {
+    SPDLOG_LOGGER_INFO(logger,
+                       "{}: {} allocations, {} bytes allocated, {} bytes peak",
+                       record.stage, record.allocations, record.allocatedBytes,
+                       record.peakBytes);
+  }
+  return written;
 }
 
 template <class A>
-void runAllImages(Dyld::Context &dCtx, ProgramArguments &args) {
-  Provider::ActivityLogger activity("DyldEx_All", std::cout, true);
+void runAllImages(Dyld::Context &dCtx, ProgramArguments &args,
+                  Provider::MetricsExporter *metrics, CacheBatch *batch) {
+  // Caches processed at the same time share the output, so their lines are
+  // named instead of drawing an activity indicator.
+  Provider::ActivityLogger activity(batch ? args.cacheName : "DyldEx_All",
+                                    std::cout, !batch);
   auto logger = activity.getLogger();
-  logger->set_pattern("[%T:%e %-8l %s:%#] %v");
+  logger->set_pattern(batch ? "[%T:%e %-8l %n %s:%#] %v"
+                            : "[%T:%e %-8l %s:%#] %v");
   if (args.verbose) {
     logger->set_level(spdlog::level::trace);
   } else {
     logger->set_level(spdlog::level::info);
   }
   activity.update("DyldEx All", "Starting up");
+  if (args.hugePages) {
+    const auto loaded = dCtx.loadIntoHugePages();
+    SPDLOG_LOGGER_INFO(logger, "Loaded {} of {} cache files into huge pages.",
+                       loaded, dCtx.subcaches.size() + 1);
+  }
   int imagesProcessed = 0;
-  std::ostringstream summaryStream;
+  // The title and logs of each summary entry
+  std::vector<std::pair<std::string, std::string>> summary;
+
+  std::atomic_int nextImage = 0;
+  std::mutex activityMutex;
+  std::exception_ptr workerError;
 
+  // The cache and accelerator are shared, everything else is per worker.
   Provider::Accelerator<typename A::P> accelerator;
 
-  const int numberOfImages = (int)dCtx.images.size();
-  for (int i = 0; i < numberOfImages; i++) {
-    const auto imageInfo = dCtx.images[i];
-    std::string imagePath((char *)(dCtx.file + imageInfo->pathFileOffset));
-    std::string imageName = imagePath.substr(imagePath.rfind("/") + 1);
-
-    imagesProcessed++;
-    activity.update(std::nullopt, fmt::format("[{:4}/{}] {}", imagesProcessed,
-                                              numberOfImages, imageName));
-
-    std::ostringstream loggerStream;
-    runImage<A>(dCtx, accelerator, imageInfo, imagePath, imageName, args,
-                loggerStream);
-
-    // update summary and UI.
-    auto logs = loggerStream.str();
-    activity.getLoggerStream()
-        << fmt::format("processed {}", imageName) << std::endl
-        << logs << std::endl;
-    if (logs.length()) {
-      summaryStream << "* " << imageName << std::endl << logs << std::endl;
+  Provider::ImageSelector<typename A::P> selector(dCtx, accelerator);
+  for (const auto &filter : args.filters) {
+    selector.addGlob(filter);
+  }
+  for (const auto &regex : args.regexes) {
+    selector.addRegex(regex);
+  }
+  const auto selectedImages = selector.select(args.withDependencies);
+  const int numberOfImages = (int)selectedImages.size();
+  Provider::Profiler profiler;
+  if (args.perfCounters) {
+    Utils::PerfCounters::enable();
+  }
+  if (metrics) {
+    metrics->addImages(numberOfImages);
+    profiler.setMetrics(metrics);
+  }
+  Utils::StageLimiter limiter;
+  for (const auto &[stage, limit] : args.stageLimits) {
+    limiter.setLimit(stage, limit);
+  }
+  std::optional<Provider::AcceleratorCache<typename A::P>> acceleratorCache;
+  if (args.acceleratorCacheDir) {
+    acceleratorCache.emplace(*args.acceleratorCacheDir, dCtx);
+    if (!acceleratorCache->load(accelerator)) {
+      SPDLOG_LOGGER_INFO(logger, "Accelerator cache not loaded.");
+    }
+  }
+  if (args.preloadExports) {
+    activity.update(std::nullopt, "Preloading exports");
+    Provider::Symbolizer<A>::preloadExports(dCtx, accelerator, logger,
+                                            args.jobs);
+  }
+
+  std::optional<Converter::ContentStore> contentStore;
+  if (args.contentStoreDir && !args.disableOutput && !args.onlyValidate) {
+    contentStore.emplace(*args.contentStoreDir);
+  }
+  if (args.archivePath && args.archivePath->has_parent_path()) {
+    fs::create_directories(args.archivePath->parent_path());
+  }
+
+  // Overlay pages are reset after each image, so they can't be written later
+  std::optional<Converter::AsyncWriter> writer;
+  if (args.writeQueue && args.outputDir && !args.archivePath &&
+      !args.contentStoreDir && !args.disableOutput && !args.onlyValidate &&
+      !args.useOverlay) {
+    writer.emplace(args.jobs, args.writeQueue, args.sparse, args.compression);
+  }
+
+  const auto nodes = Utils::Placement::getNodes();
+  auto worker = [&](unsigned int workerI) {
+    try {
+      // Caches processed in parallel get their own CPUs
+      Utils::Placement::pinWorker(nodes, args.pin,
+                                  args.cacheIndex * args.jobs + workerI,
+                                  args.imageThreads);
+      std::optional<Dyld::CacheOverlay> overlay;
+      if (args.useOverlay) {
+        overlay.emplace(dCtx);
+      }
+      std::optional<Converter::ArchiveWriter> archive;
+      if (args.archivePath && !args.disableOutput && !args.onlyValidate) {
+        archive.emplace(args.jobs <= 1 ? *args.archivePath
+                                       : Converter::ArchiveWriter::getShardPath(
+                                             *args.archivePath, workerI));
+      }
+
+      LogCapture logCapture;
+      std::shared_ptr<ImageState<A>> reusableState;
+      for (int i = nextImage++; i < numberOfImages; i = nextImage++) {
+        const auto imageInfo = dCtx.images[selectedImages[i]];
+        std::string imagePath((char *)(dCtx.file + imageInfo->pathFileOffset));
+        std::string imageName = imagePath.substr(imagePath.rfind("/") + 1);
+
+        if (metrics) {
+          metrics->setQueueDepth(numberOfImages - i - 1, args.cacheIndex);
+        }
+        {
+          std::scoped_lock lock(activityMutex);
+          imagesProcessed++;
+          activity.update(std::nullopt,
+                          fmt::format("[{:4}/{}] {}", imagesProcessed,
+                                      numberOfImages, imageName));
+        }
+
+        // Read in the image that a worker takes after this round
+        if (args.prefetch && i + (int)args.jobs < numberOfImages) {
+          prefetchImage<typename A::P>(
+              dCtx, dCtx.images[selectedImages[i + args.jobs]]);
+        }
+
+        logCapture.clear();
+        auto process = [&]() {
+          return runImage<A>(
+              dCtx, overlay ? &*overlay : nullptr, accelerator, profiler,
+              limiter, metrics, archive ? &*archive : nullptr,
+              contentStore ? &*contentStore : nullptr,
+              writer ? &*writer : nullptr, imageInfo, imagePath, imageName,
+              args, logCapture.getStream(), reusableState);
+        };
+        const bool succeeded =
+            batch ? batch->budget.run("image", process) : process();
+        if (metrics) {
+          metrics->imageDone(!succeeded);
+        }
+        if (overlay) {
+          if (args.releasePages) {
+            overlay->releasePages();
+          } else {
+            overlay->reset();
+          }
+        }
+        if (args.releasePages) {
+          dCtx.releasePages();
+        }
+
+        // update summary and UI.
+        if (args.quiet && logCapture.empty()) {
+          continue;
+        }
+        std::scoped_lock lock(activityMutex);
+        activity.getLoggerStream()
+            << fmt::format("processed {}", imageName) << std::endl
+            << logCapture.view() << std::endl;
+        if (!logCapture.empty()) {
+          summary.emplace_back(std::move(imageName), logCapture.take());
+        }
+      }
+
+      if (archive && !archive->finish()) {
+        throw std::runtime_error("Unable to write the output archive.");
+      }
+    } catch (...) {
+      std::scoped_lock lock(activityMutex);
+      if (!workerError) {
+        workerError = std::current_exception();
+      }
+      nextImage = numberOfImages; // stop other workers
+    }
+  };
+
+  if (args.jobs <= 1) {
+    worker(0);
+  } else {
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < args.jobs; i++) {
+      workers.emplace_back(worker, i);
     }
+    for (auto &thread : workers) {
+      thread.join();
+    }
+  }
+  if (writer) {
+    activity.update(std::nullopt, "Writing images");
+    for (const auto &path : writer->finish()) {
+      summary.emplace_back(fmt::format("Unable to write {}", path.string()),
+                           std::string());
+    }
+  }
+  if (workerError) {
+    std::rethrow_exception(workerError);
+  }
+
+  if (acceleratorCache) {
+    fs::create_directories(*args.acceleratorCacheDir);
+    acceleratorCache->save(accelerator);
+  }
+
+  if (contentStore) {
+    std::string manifestName;
+    for (int i = 0; i < 16; i++) {
+      manifestName += fmt::format("{:02X}", dCtx.header->uuid[i]);
+    }
+    if (!contentStore->saveManifest(manifestName)) {
+      SPDLOG_LOGGER_ERROR(logger, "Unable to write content store manifest.");
+    }
+
+    const auto stats = contentStore->getStats();
+    SPDLOG_LOGGER_INFO(logger,
+                       "Content store: wrote {} files ({} bytes), reused {} "
+                       "files ({} bytes).",
+                       stats.filesWritten, stats.bytesWritten,
+                       stats.filesReused, stats.bytesReused);
+  }
+
+  if (args.profileReport && !profiler.writeReport(*args.profileReport)) {
+    SPDLOG_LOGGER_ERROR(logger, "Unable to write profile report.");
   }
 
   activity.update(std::nullopt, "Done");
   activity.stopActivity();
-  activity.getLoggerStream()
-      << std::endl
-      << "==== Summary ====" << std::endl
-      << summaryStream.str() << "=================" << std::endl;
-}
+  if (batch) {
+    for (auto record : profiler.getRecords()) {
+      record.image = fmt::format("{}/{}", args.cacheName, record.image);
+      batch->profiler.add(std::move(record));
+    }
 
-int main(int argc, char *argv[]) {
-//  ProgramArguments args = parseArgs(argc, argv);
-    ProgramArguments args = ProgramArguments();
-    args.cache_path = "/System/Volumes/Preboot/Cryptexes/OS/System/Library/dyld/dyld_shared_cache_x86_64";
-    args.verbose = true;
-//    args.listImages = true;
-    
-    args.outputDir = "/Users/JH/Desktop";
-  try {
-    Dyld::Context dCtx(args.cache_path);
-
-    // use dyld's magic to select arch
-    if (strcmp(dCtx.header->magic, "dyld_v1  x86_64") == 0)
-      runAllImages<Utils::Arch::x86_64>(dCtx, args);
-    else if (strcmp(dCtx.header->magic, "dyld_v1 x86_64h") == 0)
-      runAllImages<Utils::Arch::x86_64>(dCtx, args);
-    else if (strcmp(dCtx.header->magic, "dyld_v1   armv7") == 0)
-      runAllImages<Utils::Arch::arm>(dCtx, args);
-    else if (strncmp(dCtx.header->magic, "dyld_v1  armv7", 14) == 0)
-      runAllImages<Utils::Arch::arm>(dCtx, args);
-    else if (strcmp(dCtx.header->magic, "dyld_v1   arm64") == 0)
-      runAllImages<Utils::Arch::arm64>(dCtx, args);
-    else if (strcmp(dCtx.header->magic, "dyld_v1  arm64e") == 0)
-      runAllImages<Utils::Arch::arm64>(dCtx, args);
-    else if (strcmp(dCtx.header->magic, "dyld_v1arm64_32") == 0)
-      runAllImages<Utils::Arch::arm64_32>(dCtx, args);
-    else if (strcmp(dCtx.header->magic, "dyld_v1    i386") == 0 ||
-             strcmp(dCtx.header->magic, "dyld_v1   armv5") == 0 ||
-             strcmp(dCtx.header->magic, "dyld_v1   armv6") == 0) {
-      std::cerr << "Unsupported Architecture type.";
-      return 1;
-    } else {
-      std::cerr << "Unrecognized dyld shared cache magic.\n";
-      return 1;
+    std::scoped_lock lock(batch->mutex);
+    for (auto &[title, logs] : summary) {
+      batch->summary.emplace_back(
+          fmt::format("{}: {}", args.cacheName, title), std::move(logs));
     }
+    return;
+  }
 
-  } catch (const std::exception &e) {
-    std::cerr << "An error has occurred: " << e.what() << std::endl;
+  auto &summaryOutput = activity.getLoggerStream();
+  summaryOutput << std::endl << "==== Summary ====" << std::endl;
+  for (const auto &[title, logs] : summary) {
+    summaryOutput << "* " << title << std::endl << logs;
+    if (logs.length()) {
+      summaryOutput << std::endl;
+    }
+  }
+  summaryOutput << "=================" << std::endl;
+}
+
+/// @brief Run all images of a cache.
+/// @returns The exit code.
+int runCache(Dyld::Context &dCtx, ProgramArguments &args,
+             Provider::MetricsExporter *metrics, CacheBatch *batch = nullptr) {
+  // use dyld's magic to select arch
+  if (strcmp(dCtx.header->magic, "dyld_v1  x86_64") == 0)
+    runAllImages<Utils::Arch::x86_64>(dCtx, args, metrics, batch);
+  else if (strcmp(dCtx.header->magic, "dyld_v1 x86_64h") == 0)
+    runAllImages<Utils::Arch::x86_64>(dCtx, args, metrics, batch);
+  else if (strcmp(dCtx.header->magic, "dyld_v1   armv7") == 0)
+    runAllImages<Utils::Arch::arm>(dCtx, args, metrics, batch);
+  else if (strncmp(dCtx.header->magic, "dyld_v1  armv7", 14) == 0)
+    runAllImages<Utils::Arch::arm>(dCtx, args, metrics, batch);
+  else if (strcmp(dCtx.header->magic, "dyld_v1   arm64") == 0)
+    runAllImages<Utils::Arch::arm64>(dCtx, args, metrics, batch);
+  else if (strcmp(dCtx.header->magic, "dyld_v1  arm64e") == 0)
+    runAllImages<Utils::Arch::arm64>(dCtx, args, metrics, batch);
+  else if (strcmp(dCtx.header->magic, "dyld_v1arm64_32") == 0)
+    runAllImages<Utils::Arch::arm64_32>(dCtx, args, metrics, batch);
+  else if (strcmp(dCtx.header->magic, "dyld_v1    i386") == 0 ||
+           strcmp(dCtx.header->magic, "dyld_v1   armv5") == 0 ||
+           strcmp(dCtx.header->magic, "dyld_v1   armv6") == 0) {
+    std::cerr << "Unsupported Architecture type.";
+    return 1;
+  } else {
+    std::cerr << "Unrecognized dyld shared cache magic.\n";
     return 1;
   }
   return 0;
 }
+
+/// @brief Give a cache of a batch its own outputs.
+ProgramArguments getCacheArguments(const ProgramArguments &args,
+                                   const std::string &cacheName) {
+  auto addSuffix = [&cacheName](const fs::path &path) {
+    return path.parent_path() / fmt::format("{}.{}{}", path.stem().string(),
+                                            cacheName,
+                                            path.extension().string());
+  };
+
+  auto cacheArgs = args;
+  cacheArgs.cacheName = cacheName;
+  if (args.outputDir) {
+    cacheArgs.outputDir = *args.outputDir / cacheName;
+  }
+  if (args.archivePath) {
+    cacheArgs.archivePath = addSuffix(*args.archivePath);
+  }
+  if (args.profileReport) {
+    cacheArgs.profileReport = addSuffix(*args.profileReport);
+  }
+  return cacheArgs;
+}
+
+/// @brief Process the caches of a batch at the same time.
+///
+/// Every cache has the full number of workers, but only that many images are
+/// processed at once across all of them, so the workers of a cache that
+/// finishes early are taken up by the others.
+///
+/// @returns The exit code.
+int runParallelCaches(const std::vector<fs::path> &caches,
+                      const std::vector<std::string> &cacheNames,
+                      const ProgramArguments &args,
+                      Provider::MetricsExporter *metrics) {
+  CacheBatch batch;
+  batch.budget.setLimit("image", std::max(args.jobs, 1u));
+
+  std::vector<int> exitCodes(caches.size(), 0);
+  std::vector<std::thread> threads;
+  for (std::size_t i = 0; i < caches.size(); i++) {
+    threads.emplace_back([&, i]() {
+      try {
+        Dyld::Context dCtx(caches[i]);
+        auto cacheArgs = getCacheArguments(args, cacheNames[i]);
+        cacheArgs.cacheIndex = (unsigned int)i;
+        exitCodes[i] = runCache(dCtx, cacheArgs, metrics, &batch);
+      } catch (const std::exception &e) {
+        std::scoped_lock lock(batch.mutex);
+        batch.summary.emplace_back(
+            fmt::format("{}: An error has occurred: {}", cacheNames[i],
+                        e.what()),
+            std::string());
+        exitCodes[i] = 1;
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  if (args.profileReport && !batch.profiler.writeReport(*args.profileReport)) {
+    std::cerr << "Unable to write the combined profile report.\n";
+  }
+
+  std::cout << std::endl << "==== Summary ====" << std::endl;
+  for (std::size_t i = 0; i < caches.size(); i++) {
+    std::cout << fmt::format("{}: {}", cacheNames[i],
+                             exitCodes[i] ? "failed" : "done")
+              << std::endl;
+  }
+  for (const auto &[title, logs] : batch.summary) {
+    std::cout << "* " << title << std::endl << logs;
+    if (logs.length()) {
+      std::cout << std::endl;
+    }
+  }
+  std::cout << "=================" << std::endl;
+
+  return std::any_of(exitCodes.begin(), exitCodes.end(),
+                     [](int code) { return code != 0; });
+}
+
+int main(int argc, char *argv[]) {
+  ProgramArguments args = parseArgs(argc, argv);
+
+  std::vector<fs::path> caches{args.cache_path};
+  caches.insert(caches.end(), args.batchCaches.begin(), args.batchCaches.end());
+
+  // Caches in a batch are named by their file, and numbered if that repeats
+  std::vector<std::string> cacheNames;
+  std::map<std::string, int> nameCounts;
+  for (const auto &path : caches) {
+    const auto name = path.filename().string();
+    const auto count = nameCounts[name]++;
+    cacheNames.push_back(count ? fmt::format("{}-{}", name, count) : name);
+  }
+
+  // One metrics file covers all caches of a batch
+  std::optional<Provider::MetricsExporter> metrics;
+  if (args.metricsPath) {
+    metrics.emplace(*args.metricsPath,
+                    std::chrono::seconds(args.metricsInterval));
+  }
+
+  if (args.parallelCaches && caches.size() > 1) {
+    return runParallelCaches(caches, cacheNames, args,
+                             metrics ? &*metrics : nullptr);
+  }
+
+  auto openCache = [](fs::path path) {
+    return std::make_unique<Dyld::Context>(path);
+  };
+  auto nextCache = std::async(std::launch::async, openCache, caches[0]);
+
+  int exitCode = 0;
+  for (std::size_t i = 0; i < caches.size(); i++) {
+    try {
+      auto dCtx = nextCache.get();
+      if (i + 1 < caches.size()) {
+        // Map and preflight the next cache while this one is processed
+        nextCache = std::async(std::launch::async, openCache, caches[i + 1]);
+      }
+
+      if (caches.size() == 1) {
+        exitCode = runCache(*dCtx, args, metrics ? &*metrics : nullptr);
+      } else {
+        std::cout << fmt::format("==== {} ====", caches[i].string())
+                  << std::endl;
+        auto cacheArgs = getCacheArguments(args, cacheNames[i]);
+        exitCode |= runCache(*dCtx, cacheArgs, metrics ? &*metrics : nullptr);
+      }
+    } catch (const std::exception &e) {
+      std::cerr << "An error has occurred: " << e.what() << std::endl;
+      exitCode = 1;
+      if (i + 1 < caches.size() && !nextCache.valid()) {
+        nextCache = std::async(std::launch::async, openCache, caches[i + 1]);
+      }
+    }
+  }
+  return exitCode;
+}
@@ -1,27 +1,46 @@
+#include <algorithm>
 #include <argparse/argparse.hpp>
-#include <boost/interprocess/containers/string.hpp>
+#include <atomic>
+#include <boost/asio.hpp>
+#include <boost/interprocess/containers/vector.hpp>
 #include <boost/interprocess/managed_shared_memory.hpp>
-#include <boost/interprocess/sync/interprocess_condition.hpp>
+#include <boost/interprocess/sync/interprocess_mutex.hpp>
 #include <boost/process.hpp>
 #include <chrono>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <mutex>
+#include <regex>
 #include <signal.h>
 #include <spdlog/spdlog.h>
 #include <thread>
+#include <unordered_map>
 
+#include <Converter/Extractor.h>
 #include <Converter/Linkedit/Linkedit.h>
 #include <Converter/Objc/Objc.h>
 #include <Converter/OffsetOptimizer.h>
+#include <Converter/OutputWriter.h>
 #include <Converter/Slide.h>
 #include <Converter/Stubs/Stubs.h>
 #include <Dyld/Context.h>
 #include <Provider/Accelerator.h>
+#include <Provider/AcceleratorCache.h>
+#include <Provider/ImageManifest.h>
+#include <Provider/ImageScheduler.h>
+#include <Provider/ImageSelector.h>
+#include <Provider/MetricsExporter.h>
+#include <Provider/Profiler.h>
+#include <Provider/ProgressJournal.h>
 #include <Provider/Validator.h>
 #include <Utils/ExtractionContext.h>
+#include <Utils/PerfCounters.h>
+#include <Utils/Placement.h>
 
 #include "config.h"
 
+namespace asio = boost::asio;
 namespace bi = boost::interprocess;
 namespace bp = boost::process;
 namespace fs = std::filesystem;
@@ -34,12 +53,38 @@ struct ProgramArguments {
   fs::path programPath;
   fs::path cachePath;
   std::optional<fs::path> outputDir;
+  std::optional<fs::path> archivePath;
+  bool sparse;
+  std::optional<Converter::CompressionOptions> compression;
   bool disableOutput;
   bool verbose;
   bool quiet;
   bool onlyValidate;
   unsigned int jobs;
+  bool scheduleByDependencies = false;
+  Utils::Placement::Policy pin = Utils::Placement::Policy::None;
+  bool prefault = false;
+  uint64_t memoryBudget = 0;
+  bool releasePages;
+  bool preloadExports;
+  std::optional<fs::path> clientExportsDir;
   bool imbedVersion;
+  bool optimizeOpcodes;
+  std::vector<std::string> filters;
+  std::vector<std::string> regexes;
+  bool withDependencies;
+  std::optional<fs::path> profileReport;
+  bool perfCounters = false;
+  std::optional<fs::path> metricsPath;
+  unsigned int metricsInterval = 5;
+  std::optional<fs::path> manifestPath;
+  bool resume;
+  // The bind address is empty for all interfaces
+  std::optional<std::pair<std::string, unsigned short>> listenAddress;
+  std::optional<std::pair<std::string, std::string>> connectAddress;
+  std::string remoteToken;
+  unsigned int remoteTimeout = 600;
+  std::optional<std::string> nodeName;
 
   union {
     uint32_t raw;
@@ -55,13 +100,28 @@ struct ProgramArguments {
     bool inClientMode = false;
     std::string clientID;
     Arch arch;
-
-    unsigned int start;
-    unsigned int end;
-    unsigned int skip;
+    // How many times the client was restarted
+    unsigned int generation = 0;
   } clientSpec;
 };
 
+/// Parse a size in bytes with an optional K, M, or G suffix.
+uint64_t parseSize(const std::string &str) {
+  std::size_t end;
+  uint64_t size = std::stoull(str, &end);
+  const auto suffix = str.substr(end);
+  if (suffix == "K" || suffix == "k") {
+    size <<= 10;
+  } else if (suffix == "M" || suffix == "m") {
+    size <<= 20;
+  } else if (suffix == "G" || suffix == "g") {
+    size <<= 30;
+  } else if (!suffix.empty()) {
+    throw std::runtime_error(fmt::format("Invalid size '{}'.", str));
+  }
+  return size;
+}
+
 ProgramArguments parseArgs(int argc, char const *argv[]) {
   argparse::ArgumentParser program("dyldex_all_multiprocess",
                                    DYLDEXTRACTORC_VERSION);
@@ -74,6 +134,23 @@ ProgramArguments parseArgs(int argc, char const *argv[]) {
       .help("The output directory for the extracted images. Required for "
             "extraction");
 
+  program.add_argument("--archive")
+      .help("Write the extracted images into a tar archive instead of the "
+            "output directory. Each client writes a shard of the archive, "
+            "like cache.0.tar, and a restarted client writes a new shard.");
+
+  program.add_argument("--sparse")
+      .help("Leave pages that are all zeros as holes in the files in the "
+            "output directory, which saves writes and disk space.")
+      .default_value(false)
+      .implicit_value(true);
+
+  program.add_argument("--compress")
+      .help("Compress the images in the output directory with zstd at this "
+            "level while they are written, adding .zst to their names. Needs "
+            "a build with DYLDEXTRACTORC_ZSTD.")
+      .scan<'d', int>();
+
   program.add_argument("-d", "--disable-output")
       .help("Disables writing output. Useful for development.")
       .default_value(false)
@@ -99,6 +176,60 @@ ProgramArguments parseArgs(int argc, char const *argv[]) {
       .scan<'d', unsigned int>()
       .default_value(std::thread::hardware_concurrency());
 
+  program.add_argument("--schedule")
+      .help("How images are handed to clients. 'size' hands out the largest "
+            "images first. 'dependencies' also assigns images that load the "
+            "same dylibs to the same client, so its accelerator reads them "
+            "once. Clients take other clients' images when they run out.")
+      .default_value(std::string("size"));
+
+  program.add_argument("--pin")
+      .help("Pin each client to one CPU (core) or to the CPUs of one NUMA "
+            "node (node), spreading clients over the nodes. Linux only.")
+      .default_value(std::string("none"));
+
+  program.add_argument("--prefault")
+      .help("Copy the cache into memory of each client after pinning it, so "
+            "the cache is read from its own node. Uses huge pages when "
+            "available. Costs a copy of the cache for each client.")
+      .default_value(false)
+      .implicit_value(true);
+
+  program.add_argument("--filter")
+      .help("Only process images whose path matches this glob pattern, where "
+            "* also matches /. Can be given multiple times.")
+      .append();
+
+  program.add_argument("--regex")
+      .help("Only process images whose path contains a match of this regex. "
+            "Can be given multiple times.")
+      .append();
+
+  program.add_argument("--with-dependencies")
+      .help("Also process the dependencies of the filtered images, "
+            "following their dylib load commands.")
+      .default_value(false)
+      .implicit_value(true);
+
+  program.add_argument("--memory-budget")
+      .help("Only start images while their estimated total memory use is "
+            "under this size, like 8G or 512M. An image is always started if "
+            "no other image is running.");
+
+  program.add_argument("--release-pages")
+      .help("Drop the cache's pages from memory after each image, which keeps "
+            "the resident size of each client flat on large caches. Caches "
+            "copied with --prefault are kept.")
+      .default_value(false)
+      .implicit_value(true);
+
+  program.add_argument("--preload-exports")
+      .help("Read the exports of every image in parallel before starting the "
+            "clients, and share them with the clients, instead of each client "
+            "reading them again.")
+      .default_value(false)
+      .implicit_value(true);
+
   program.add_argument("-s", "--skip-modules")
       .help("Skip certain modules. Most modules depend on each other, so use "
             "with caution. Useful for development. 1=processSlideInfo, "
@@ -108,7 +239,10 @@ ProgramArguments parseArgs(int argc, char const *argv[]) {
 
   program.add_argument("--client-spec")
       .help("Do not use. This is used for multiprocess support.")
-      .nargs(5);
+      .nargs(3);
+
+  program.add_argument("--client-exports")
+      .help("Do not use. This is used for multiprocess support.");
 
   program.add_argument("--imbed-version")
       .help("Imbed this tool's version number into the mach_header_64's "
@@ -116,6 +250,73 @@ ProgramArguments parseArgs(int argc, char const *argv[]) {
       .default_value(false)
       .implicit_value(true);
 
+  program.add_argument("--optimize-opcodes")
+      .help("Pick the smallest rebase and bind opcodes for images that use "
+            "them. Slower, but makes the dyld info smaller.")
+      .default_value(false)
+      .implicit_value(true);
+
+  program.add_argument("--manifest")
+      .help("A file that records each extracted image with a fingerprint of "
+            "its input, the tool version, and the enabled modules. Images "
+            "that are unchanged since they were recorded are skipped, so an "
+            "interrupted run can be resumed.");
+
+  program.add_argument("--profile")
+      .help("Write a report of the time spent in each stage of each image. "
+            "JSON if the path ends with .json, otherwise CSV.");
+
+  program.add_argument("--perf-counters")
+      .help("Also record the cycles, instructions, cache, branch, and TLB "
+            "misses of each stage in the --profile report. Linux only.")
+      .default_value(false)
+      .implicit_value(true);
+
+  program.add_argument("--metrics")
+      .help("Periodically rewrite a status file with the images completed and "
+            "failed, stage latencies, bytes written, memory, and queue depth. "
+            "Prometheus text format if the path ends with .prom, otherwise "
+            "JSON.");
+
+  program.add_argument("--metrics-interval")
+      .help("The seconds between writes of the metrics file.")
+      .scan<'d', unsigned int>()
+      .default_value(5u);
+
+  program.add_argument("--resume")
+      .help("Skip the images that the journal in the output directory records "
+            "as completed, and process the failed ones first. Every run with "
+            "an output directory records each image in the journal as soon as "
+            "it is done.")
+      .default_value(false)
+      .implicit_value(true);
+
+  program.add_argument("--listen")
+      .help("Also hand out images to remote workers that connect on this TCP "
+            "port, as [ADDRESS:]PORT. Listens on all interfaces without an "
+            "address. Requires --token. Use with -j 0 to only coordinate.");
+
+  program.add_argument("--token")
+      .help("A shared secret that remote workers must send to the "
+            "coordinator. Set the same token on both sides, it is required "
+            "with --listen.")
+      .default_value(std::string(""));
+
+  program.add_argument("--remote-timeout")
+      .help("Seconds the coordinator waits for a remote worker's result "
+            "before giving up on its image, 0 to wait forever.")
+      .scan<'d', unsigned int>()
+      .default_value(600u);
+
+  program.add_argument("--connect")
+      .help("Run as a remote worker of the coordinator at HOST:PORT, with -j "
+            "connections. The cache path and output are local to this node, "
+            "and the cache must be the same as the coordinator's.");
+
+  program.add_argument("--node-name")
+      .help("The name a remote worker reports its results under. Defaults to "
+            "the host name.");
+
   ProgramArguments args;
   std::copy(argv + 1, argv + argc, std::back_inserter(args.rawArguments));
 
@@ -125,25 +326,121 @@ ProgramArguments parseArgs(int argc, char const *argv[]) {
     args.programPath = fs::path(argv[0]);
     args.cachePath = fs::path(program.get<std::string>("cache_path"));
     args.outputDir = program.present<std::string>("--output-dir");
+    if (auto path = program.present<std::string>("--archive"); path) {
+      args.archivePath = fs::path(*path);
+    }
+    args.sparse = program.get<bool>("--sparse");
+    if (auto level = program.present<int>("--compress"); level) {
+      if (!Converter::compressionSupported()) {
+        throw std::runtime_error("This build does not support compression.");
+      }
+      args.compression = Converter::CompressionOptions{*level, 0};
+    }
     args.disableOutput = program.get<bool>("--disable-output");
     args.verbose = program.get<bool>("--verbose");
     args.quiet = program.get<bool>("--quiet");
     args.onlyValidate = program.get<bool>("--only-validate");
     args.jobs = program.get<unsigned int>("--jobs");
+    if (const auto schedule = program.get<std::string>("--schedule");
+        schedule == "dependencies") {
+      args.scheduleByDependencies = true;
+    } else if (schedule != "size") {
+      throw std::runtime_error("--schedule must be size or dependencies.");
+    }
+    if (auto policy =
+            Utils::Placement::parsePolicy(program.get<std::string>("--pin"))) {
+      args.pin = *policy;
+    } else {
+      throw std::runtime_error("--pin must be none, core, or node.");
+    }
+    args.prefault = program.get<bool>("--prefault");
+    if (auto budget = program.present<std::string>("--memory-budget")) {
+      args.memoryBudget = parseSize(*budget);
+    }
+    args.releasePages = program.get<bool>("--release-pages");
+    args.preloadExports = program.get<bool>("--preload-exports");
+    if (auto filters =
+            program.present<std::vector<std::string>>("--filter")) {
+      args.filters = *filters;
+    }
+    if (auto regexes = program.present<std::vector<std::string>>("--regex")) {
+      for (const auto &regex : *regexes) {
+        try {
+          (void)std::regex(regex, std::regex::ECMAScript);
+        } catch (const std::regex_error &e) {
+          throw std::runtime_error(
+              fmt::format("Invalid regex '{}': {}", regex, e.what()));
+        }
+      }
+      args.regexes = *regexes;
+    }
+    args.withDependencies = program.get<bool>("--with-dependencies");
     args.modulesDisabled.raw = program.get<int>("--skip-modules");
     args.imbedVersion = program.get<bool>("--imbed-version");
+    args.optimizeOpcodes = program.get<bool>("--optimize-opcodes");
+    if (auto path = program.present<std::string>("--profile"); path) {
+      args.profileReport = fs::path(*path);
+    }
+    args.perfCounters = program.get<bool>("--perf-counters");
+    if (auto path = program.present<std::string>("--metrics"); path) {
+      args.metricsPath = fs::path(*path);
+    }
+    args.metricsInterval =
+        std::max(program.get<unsigned int>("--metrics-interval"), 1u);
+    if (auto path = program.present<std::string>("--manifest"); path) {
+      args.manifestPath = fs::path(*path);
+    }
+    args.resume = program.get<bool>("--resume");
+    if (auto address = program.present<std::string>("--listen"); address) {
+      const auto split = address->rfind(':');
+      auto host = split == std::string::npos ? std::string()
+                                             : address->substr(0, split);
+      // Strip the brackets of an IPv6 address
+      if (host.size() >= 2 && host.front() == '[' && host.back() == ']') {
+        host = host.substr(1, host.size() - 2);
+      }
+      try {
+        args.listenAddress.emplace(
+            std::move(host),
+            (unsigned short)std::stoul(split == std::string::npos
+                                           ? *address
+                                           : address->substr(split + 1)));
+      } catch (const std::logic_error &) {
+        throw std::runtime_error(
+            fmt::format("Invalid listen address '{}'.", *address));
+      }
+    }
+    args.remoteToken = program.get<std::string>("--token");
+    if (args.listenAddress && args.remoteToken.empty()) {
+      throw std::runtime_error("A token is required to listen for remote "
+                               "workers.");
+    }
+    args.remoteTimeout = program.get<unsigned int>("--remote-timeout");
+    if (auto address = program.present<std::string>("--connect"); address) {
+      const auto split = address->rfind(':');
+      if (split == std::string::npos || split == 0 ||
+          split == address->size() - 1) {
+        throw std::runtime_error(
+            fmt::format("Invalid coordinator address '{}'.", *address));
+      }
+      args.connectAddress.emplace(address->substr(0, split),
+                                  address->substr(split + 1));
+    }
+    args.nodeName = program.present<std::string>("--node-name");
+
+    if (auto dir = program.present<std::string>("--client-exports"); dir) {
+      args.clientExportsDir = fs::path(*dir);
+    }
 
     if (auto clientSpec =
             program.present<std::vector<std::string>>("--client-spec")) {
-      // Format: ClientID, Arch, start, end, skip
+      // Format: ClientID, Arch, Generation
       args.clientSpec.inClientMode = true;
       args.clientSpec.clientID = clientSpec->at(0);
       args.clientSpec.arch =
           static_cast<ProgramArguments::ClientSpecification::Arch>(
               std::stoi(clientSpec->at(1)));
-      args.clientSpec.start = std::stoul(clientSpec->at(2));
-      args.clientSpec.end = std::stoul(clientSpec->at(3));
-      args.clientSpec.skip = std::stoul(clientSpec->at(4));
+      args.clientSpec.generation = (unsigned int)std::stoul(clientSpec->at(2));
     };
   } catch (const std::runtime_error &e) {
     std::cerr << "Error while parsing arguments: " << e.what() << std::endl;
@@ -154,8 +451,8 @@ ProgramArguments parseArgs(int argc, char const *argv[]) {
 }
 #pragma endregion Arguments
 
-#pragma region MessageQueue
-#define SHARED_MESSAGE_QUEUE_NAME "SharedMessageQueue"
+#pragma region MessageRing
+#define SHARED_MESSAGE_RINGS_NAME "SharedMessageRings"
 
 // A local copy of the shared message
 struct LocalMessage {
@@ -167,91 +464,617 @@ struct LocalMessage {
   std::string logs;
   // The image to process next
   std::string nextImage;
+  // Serialized profiler records for the processed image
+  std::string profile;
+  // The path of the processed image
+  std::string currentImagePath;
+  // The input fingerprint in hex if the image was completed
+  std::string fingerprint;
+  // The node of a remote worker, empty for local clients
+  std::string node;
+  // Not empty if the image failed
+  std::string failed;
+  // The path of the image to process next
+  std::string nextImagePath;
 };
 
-struct MessageQueue {
-  using SharedString = typename bi::basic_string<
-      char, std::char_traits<char>,
-      bi::allocator<char, bi::managed_shared_memory::segment_manager>>;
+/// The serialized fields of a message, in order.
+constexpr std::string LocalMessage::*MESSAGE_FIELDS[] = {
+    &LocalMessage::clientID,         &LocalMessage::currentImage,
+    &LocalMessage::logs,             &LocalMessage::nextImage,
+    &LocalMessage::profile,          &LocalMessage::currentImagePath,
+    &LocalMessage::fingerprint,      &LocalMessage::node,
+    &LocalMessage::failed,           &LocalMessage::nextImagePath};
+
+/// Append a length prefixed string
+void appendField(std::string &data, const std::string &value) {
+  const auto size = (uint32_t)value.size();
+  data.append((const char *)&size, sizeof(size));
+  data.append(value);
+}
 
-  MessageQueue(bi::managed_shared_memory::segment_manager *segManager)
-      : queueFull(false), message(segManager) {}
+/// Read a length prefixed string, returns false if the data is truncated
+bool readField(std::string_view &data, std::string &value) {
+  uint32_t size;
+  if (data.size() < sizeof(size)) {
+    return false;
+  }
+  memcpy(&size, data.data(), sizeof(size));
+  data.remove_prefix(sizeof(size));
+  if (data.size() < size) {
+    return false;
+  }
+  value = data.substr(0, size);
+  data.remove_prefix(size);
+  return true;
+}
 
-  // Mutex to protect access to the queue
-  bi::interprocess_mutex mutex;
-  // Condition for when the queue is emptied.
-  bi::interprocess_condition queueEmptied;
-  // Condition for when the queue is filled;
-  bi::interprocess_condition queueFilled;
-  // Condition for when the message in the queue is handled;
-  bi::interprocess_condition messageAck;
-
-  bool queueFull;
-
-  struct Message {
-    Message(bi::managed_shared_memory::segment_manager *segManager)
-        : clientID(segManager), currentImage(segManager), logs(segManager),
-          nextImage(segManager) {}
-
-    Message &operator=(const LocalMessage &other) {
-      this->clientID = other.clientID.c_str();
-      this->currentImage = other.currentImage.c_str();
-      this->logs = other.logs.c_str();
-      this->nextImage = other.nextImage.c_str();
-      return *this;
-    }
-
-    operator LocalMessage() {
-      LocalMessage m;
-      m.clientID = std::string(clientID.begin(), clientID.end());
-      m.currentImage = std::string(currentImage.begin(), currentImage.end());
-      m.logs = std::string(logs.begin(), logs.end());
-      m.nextImage = std::string(nextImage.begin(), nextImage.end());
-      return m;
-    }
-
-    // The client id sending the message
-    SharedString clientID;
-    // The processed image that corresponds to the logs
-    SharedString currentImage;
-    // Logs for the process image
-    SharedString logs;
-    // The image to process next
-    SharedString nextImage;
-
-  } message;
+std::string serializeMessage(const LocalMessage &message) {
+  std::string data;
+  for (auto field : MESSAGE_FIELDS) {
+    appendField(data, message.*field);
+  }
+  return data;
+}
+
+/// Deserialize a message, returns false if the data is truncated
+bool deserializeMessage(std::string_view data, LocalMessage &message) {
+  for (auto field : MESSAGE_FIELDS) {
+    if (!readField(data, message.*field)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// @brief A single producer, single consumer ring of fixed size slots.
+///
+/// Every client has its own ring in the shared memory, so clients never
+/// contend with each other, and the server drains all rings in batches.
+/// Messages are serialized and split over as many slots as they need.
+struct MessageRing {
+  static constexpr uint64_t SLOT_COUNT = 64;
+  static constexpr uint32_t SLOT_DATA_SIZE = 4096 - 2 * sizeof(uint32_t);
+
+  struct Slot {
+    // The number of bytes used in data
+    uint32_t size;
+    // If the message continues in the next slot
+    uint32_t more;
+    char data[SLOT_DATA_SIZE];
+  };
+
+  static_assert(std::atomic<uint64_t>::is_always_lock_free,
+                "Message rings need address free atomics.");
+
+  // The number of slots published, only written by the client
+  alignas(64) std::atomic<uint64_t> head = 0;
+  // The number of slots consumed, only written by the server
+  alignas(64) std::atomic<uint64_t> tail = 0;
+  Slot slots[SLOT_COUNT];
 };
 
-/// Send a message through message queue
-void sendMessage(MessageQueue *messageQueue, LocalMessage message) {
-  bi::scoped_lock<bi::interprocess_mutex> lock(messageQueue->mutex);
-  while (messageQueue->queueFull) {
-    messageQueue->queueEmptied.wait(lock);
+/// Send a message through a client's ring
+void sendMessage(MessageRing *ring, const LocalMessage &message) {
+  const auto data = serializeMessage(message);
+
+  std::size_t offset = 0;
+  auto head = ring->head.load(std::memory_order_relaxed);
+  do {
+    // Wait for the server to free a slot
+    while (head - ring->tail.load(std::memory_order_acquire) ==
+           MessageRing::SLOT_COUNT) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    auto &slot = ring->slots[head % MessageRing::SLOT_COUNT];
+    const auto size = (uint32_t)std::min<std::size_t>(
+        data.size() - offset, MessageRing::SLOT_DATA_SIZE);
+    memcpy(slot.data, data.data() + offset, size);
+    offset += size;
+    slot.size = size;
+    slot.more = offset < data.size();
+    ring->head.store(++head, std::memory_order_release);
+  } while (offset < data.size());
+}
+
+/// Receive all messages that are available in a client's ring
+/// @param partial The start of a message that is still being sent.
+void receiveMessages(MessageRing *ring, std::string &partial,
+                     std::vector<LocalMessage> &messages) {
+  auto tail = ring->tail.load(std::memory_order_relaxed);
+  const auto head = ring->head.load(std::memory_order_acquire);
+  for (; tail != head; tail++) {
+    const auto &slot = ring->slots[tail % MessageRing::SLOT_COUNT];
+    partial.append(slot.data, slot.size);
+    if (slot.more) {
+      continue;
+    }
+
+    deserializeMessage(partial, messages.emplace_back());
+    partial.clear();
   }
+  ring->tail.store(tail, std::memory_order_release);
+}
+#pragma endregion MessageRing
+
+#pragma region WorkQueue
+#define SHARED_WORK_QUEUE_NAME "SharedWorkQueue"
+
+// The holder of an image that no client is processing
+constexpr uint32_t NO_HOLDER = UINT32_MAX;
+// How long to wait for the work queue's lock before giving up
+constexpr auto WORK_QUEUE_LOCK_TIMEOUT = std::chrono::seconds(30);
+// How often a client waiting for budget checks the work queue
+constexpr auto WORK_QUEUE_POLL_INTERVAL = std::chrono::milliseconds(10);
+
+/// Images waiting to be processed, clients take the next one when they are
+/// done with their current image.
+///
+/// With a memory budget, an image is only handed out while the estimated
+/// footprints of the running images fit in the budget. Images are taken in
+/// order, but a later image that fits is taken before an earlier one that
+/// doesn't.
+struct WorkQueue {
+  template <class T>
+  using SharedVector = typename bi::vector<
+      T, bi::allocator<T, bi::managed_shared_memory::segment_manager>>;
+
+  WorkQueue(bi::managed_shared_memory::segment_manager *segManager)
+      : images(segManager), footprints(segManager), taken(segManager),
+        holders(segManager), owners(segManager) {}
+
+  // Mutex to protect access to the queue, see lockWorkQueue
+  bi::interprocess_mutex mutex;
+
+  // Indices of the images in the order they should be processed
+  SharedVector<uint32_t> images;
+  // The estimated footprint of each image in bytes
+  SharedVector<uint64_t> footprints;
+  // If each image was handed out
+  SharedVector<uint8_t> taken;
+  // The client processing each image, or NO_HOLDER
+  SharedVector<uint32_t> holders;
+  // The client each image is assigned to, empty if images are not assigned
+  SharedVector<uint32_t> owners;
+  // The first image that was not handed out
+  std::size_t next = 0;
+
+  // The memory budget in bytes, or 0 for no budget
+  uint64_t budget = 0;
+  // The total footprint of the running images
+  uint64_t inUse = 0;
+};
 
-  messageQueue->message = message;
-  messageQueue->queueFull = true;
-  messageQueue->queueFilled.notify_one();
+/// Lock the work queue. A process that was killed while holding the lock
+/// never releases it, so this throws instead of waiting forever.
+bi::scoped_lock<bi::interprocess_mutex> lockWorkQueue(WorkQueue *workQueue) {
+  bi::scoped_lock<bi::interprocess_mutex> lock(
+      workQueue->mutex,
+      boost::posix_time::microsec_clock::universal_time() +
+          boost::posix_time::seconds(WORK_QUEUE_LOCK_TIMEOUT.count()));
+  if (!lock) {
+    throw std::runtime_error("Timed out waiting for the work queue, a process "
+                             "may have stopped while holding it.");
+  }
+  return lock;
 }
 
-/// Receive a message though the message queue
-std::optional<LocalMessage> receiveMessage(MessageQueue *messageQueue,
-                                           std::chrono::milliseconds timeout) {
-  bi::scoped_lock<bi::interprocess_mutex> lock(messageQueue->mutex);
-  while (!messageQueue->queueFull) {
-    auto stat = messageQueue->queueFilled.wait_for(lock, timeout);
-    if (stat == bi::cv_status::timeout) {
+/// Take the next image from the work queue, waiting for budget if needed.
+/// Images assigned to the client are taken first, then any other image.
+///
+/// The queue isn't locked while waiting, so other processes aren't held up,
+/// and a process that stops can't leave it locked.
+std::optional<uint32_t> takeWork(WorkQueue *workQueue, uint32_t client) {
+  while (true) {
+    auto lock = lockWorkQueue(workQueue);
+    while (workQueue->next < workQueue->images.size() &&
+           workQueue->taken[workQueue->next]) {
+      workQueue->next++;
+    }
+    if (workQueue->next >= workQueue->images.size()) {
       return std::nullopt;
     }
+
+    const bool assigned = !workQueue->owners.empty();
+    for (int pass = assigned ? 0 : 1; pass < 2; pass++) {
+      for (auto i = workQueue->next; i < workQueue->images.size(); i++) {
+        if (workQueue->taken[i] ||
+            (pass == 0 && workQueue->owners[i] != client)) {
+          continue;
+        }
+
+        const auto footprint = workQueue->footprints[i];
+        if (!workQueue->budget || !workQueue->inUse ||
+            workQueue->inUse + footprint <= workQueue->budget) {
+          workQueue->taken[i] = true;
+          workQueue->holders[i] = client;
+          workQueue->inUse += footprint;
+          return workQueue->images[i];
+        }
+      }
+    }
+
+    lock.unlock();
+    std::this_thread::sleep_for(WORK_QUEUE_POLL_INTERVAL);
   }
+}
 
-  LocalMessage message = messageQueue->message;
-  messageQueue->queueFull = false;
-  messageQueue->queueEmptied.notify_one();
+/// Release the footprint of an image the client took with takeWork. Does
+/// nothing if the client doesn't hold the image.
+void finishWork(WorkQueue *workQueue, uint32_t client, uint32_t image) {
+  auto lock = lockWorkQueue(workQueue);
+  for (std::size_t i = 0; i < workQueue->images.size(); i++) {
+    if (workQueue->images[i] == image) {
+      if (workQueue->holders[i] == client) {
+        workQueue->holders[i] = NO_HOLDER;
+        workQueue->inUse -= workQueue->footprints[i];
+      }
+      break;
+    }
+  }
+}
+
+/// Release the images held by a client that stopped unexpectedly. The image
+/// it was processing stays taken, so it's not retried, and any other image it
+/// took is handed out again.
+/// @param processing The image the client reported it was processing.
+/// @returns If the client held the image it was processing.
+bool releaseClient(WorkQueue *workQueue, uint32_t client,
+                   std::optional<uint32_t> processing) {
+  auto lock = lockWorkQueue(workQueue);
+  bool heldProcessing = false;
+  for (std::size_t i = 0; i < workQueue->images.size(); i++) {
+    if (workQueue->holders[i] != client) {
+      continue;
+    }
 
-  return message;
+    workQueue->holders[i] = NO_HOLDER;
+    workQueue->inUse -= workQueue->footprints[i];
+    if (workQueue->images[i] == processing) {
+      heldProcessing = true;
+    } else {
+      workQueue->taken[i] = false;
+      workQueue->next = std::min(workQueue->next, i);
+    }
+  }
+  return heldProcessing;
+}
+
+/// The number of images that were not handed out yet
+std::size_t remainingWork(WorkQueue *workQueue) {
+  auto lock = lockWorkQueue(workQueue);
+  return std::count(workQueue->taken.begin() + workQueue->next,
+                    workQueue->taken.end(), 0);
 }
-#pragma endregion MessageQueue
+
+/// Take the next image for a remote worker. Remote workers run on other
+/// nodes, so the image doesn't count against the memory budget.
+std::optional<uint32_t> takeRemoteWork(WorkQueue *workQueue) {
+  auto lock = lockWorkQueue(workQueue);
+  for (auto i = workQueue->next; i < workQueue->images.size(); i++) {
+    if (!workQueue->taken[i]) {
+      workQueue->taken[i] = true;
+      return workQueue->images[i];
+    }
+  }
+  return std::nullopt;
+}
+#pragma endregion WorkQueue
+
+#pragma region Coordinator
+using asio::ip::tcp;
+
+// The image index sent to a remote worker when there is no work left
+constexpr uint32_t REMOTE_NO_WORK = UINT32_MAX;
+// Frames larger than this are treated as a protocol error
+constexpr uint32_t REMOTE_MAX_FRAME_SIZE = 256 * 1024 * 1024;
+// The hello is small, so an unchecked peer can't make the coordinator
+// allocate much
+constexpr uint32_t REMOTE_MAX_HELLO_SIZE = 4096;
+
+std::pair<std::string, std::string>
+getImageName(Dyld::Context &dCtx, const dyld_cache_image_info *image);
+
+/// Get the UUID of a cache in hex, to check that nodes have the same cache
+std::string getCacheUUID(const Dyld::Context &dCtx) {
+  std::string uuid;
+  for (auto byte : dCtx.header->uuid) {
+    uuid += fmt::format("{:02x}", byte);
+  }
+  return uuid;
+}
+
+/// Compare a token in constant time, so the time taken doesn't reveal how
+/// much of it matched.
+bool tokenMatches(std::string_view token, std::string_view expected) {
+  if (token.size() != expected.size()) {
+    return false;
+  }
+
+  unsigned char diff = 0;
+  for (std::size_t i = 0; i < token.size(); i++) {
+    diff |= (unsigned char)(token[i] ^ expected[i]);
+  }
+  return diff == 0;
+}
+
+/// Frames are a 32 bit length followed by the payload.
+std::string makeFrame(std::string_view payload) {
+  const auto size = (uint32_t)payload.size();
+  std::string frame((const char *)&size, sizeof(size));
+  frame.append(payload);
+  return frame;
+}
+
+/// Read a frame from a blocking socket, throws on errors.
+std::string readFrame(tcp::socket &socket) {
+  uint32_t size;
+  asio::read(socket, asio::buffer(&size, sizeof(size)));
+  if (size > REMOTE_MAX_FRAME_SIZE) {
+    throw std::runtime_error("Received an invalid frame.");
+  }
+  std::string payload(size, '\0');
+  asio::read(socket, asio::buffer(payload));
+  return payload;
+}
+
+/// @brief Hands out images to remote workers over TCP.
+///
+/// A worker sends a hello with its node name, the UUID of its cache, and the
+/// shared token. It is then sent one image index at a time, and answers each
+/// with the message of the processed image, which takes the next one. Images
+/// are taken from the same work queue as the local clients. A worker that
+/// doesn't answer within the timeout is dropped and its image fails. The
+/// sockets are served on one thread, and the server loop collects the
+/// messages with drain.
+class RemoteCoordinator {
+public:
+  /// @param host The address to listen on, or empty for all interfaces.
+  /// @param timeout How long to wait for each frame, 0 waits forever.
+  RemoteCoordinator(const std::string &host, unsigned short port,
+                    std::string token, std::chrono::seconds timeout,
+                    WorkQueue *workQueue, Dyld::Context &dCtx)
+      : workQueue(workQueue), dCtx(dCtx), cacheUUID(getCacheUUID(dCtx)),
+        token(std::move(token)), timeout(timeout), acceptor(io) {
+    if (host.empty()) {
+      // Accept both IPv4 and IPv6 connections
+      const tcp::endpoint endpoint(tcp::v6(), port);
+      acceptor.open(endpoint.protocol());
+      acceptor.set_option(tcp::acceptor::reuse_address(true));
+      acceptor.set_option(asio::ip::v6_only(false));
+      acceptor.bind(endpoint);
+    } else {
+      const tcp::endpoint endpoint(asio::ip::make_address(host), port);
+      acceptor.open(endpoint.protocol());
+      acceptor.set_option(tcp::acceptor::reuse_address(true));
+      acceptor.bind(endpoint);
+    }
+    acceptor.listen();
+
+    accept();
+    thread = std::thread([this]() { io.run(); });
+  }
+  ~RemoteCoordinator() {
+    io.stop();
+    thread.join();
+  }
+  RemoteCoordinator(const RemoteCoordinator &) = delete;
+  RemoteCoordinator &operator=(const RemoteCoordinator &) = delete;
+
+  /// @brief Take the received messages and notices.
+  /// @param messages Messages of processed images are appended to this.
+  /// @param notices Workers connecting and disconnecting are appended to this.
+  void drain(std::vector<LocalMessage> &messages,
+             std::vector<std::string> &notices) {
+    std::scoped_lock lock(mutex);
+    std::move(receivedMessages.begin(), receivedMessages.end(),
+              std::back_inserter(messages));
+    std::move(receivedNotices.begin(), receivedNotices.end(),
+              std::back_inserter(notices));
+    receivedMessages.clear();
+    receivedNotices.clear();
+  }
+
+private:
+  /// A connection to a remote worker.
+  struct Session : std::enable_shared_from_this<Session> {
+    RemoteCoordinator &coordinator;
+    tcp::socket socket;
+    std::string workerID;
+    std::string node;
+
+    uint32_t frameSize;
+    std::string frame;
+    std::string outFrame;
+    // The image the worker is processing
+    std::optional<uint32_t> image;
+    // Closes the socket if the next frame doesn't arrive in time
+    asio::steady_timer deadline;
+    bool timedOut = false;
+
+    Session(RemoteCoordinator &coordinator, tcp::socket socket,
+            unsigned int index)
+        : coordinator(coordinator), socket(std::move(socket)),
+          workerID(std::to_string(index)), deadline(coordinator.io) {}
+
+    void start() { receive(&Session::onHello, REMOTE_MAX_HELLO_SIZE); }
+
+    void receive(void (Session::*handler)(), uint32_t maxSize) {
+      auto self = shared_from_this();
+      startDeadline();
+      asio::async_read(
+          socket, asio::buffer(&frameSize, sizeof(frameSize)),
+          [this, self, handler, maxSize](boost::system::error_code ec,
+                                         std::size_t) {
+            if (ec || frameSize > maxSize) {
+              return lost();
+            }
+
+            frame.resize(frameSize);
+            asio::async_read(socket, asio::buffer(frame),
+                             [this, self, handler](boost::system::error_code ec,
+                                                   std::size_t) {
+                               if (ec) {
+                                 return lost();
+                               }
+                               deadline.cancel();
+                               (this->*handler)();
+                             });
+          });
+    }
+
+    void startDeadline() {
+      if (!coordinator.timeout.count()) {
+        return;
+      }
+
+      auto self = shared_from_this();
+      deadline.expires_after(coordinator.timeout);
+      deadline.async_wait([this, self](boost::system::error_code ec) {
+        // The deadline may have been moved after this was queued
+        if (ec || deadline.expiry() > asio::steady_timer::clock_type::now()) {
+          return;
+        }
+        timedOut = true;
+        boost::system::error_code ignored;
+        socket.close(ignored);
+      });
+    }
+
+    void lost() { fail(timedOut ? "timed out" : "lost the connection"); }
+
+    void onHello() {
+      std::string_view data = frame;
+      std::string uuid;
+      std::string token;
+      if (!readField(data, node) || !readField(data, uuid) ||
+          !readField(data, token)) {
+        return fail("sent an invalid hello");
+      }
+      workerID = fmt::format("{}#{}", node, workerID);
+      if (!tokenMatches(token, coordinator.token)) {
+        return fail("sent the wrong token");
+      }
+      if (uuid != coordinator.cacheUUID) {
+        return fail("has a different cache");
+      }
+
+      coordinator.notice(fmt::format("Worker {} connected.", workerID));
+      sendWork();
+    }
+
+    void sendWork() {
+      image.reset();
+      try {
+        image = takeRemoteWork(coordinator.workQueue);
+      } catch (const std::exception &e) {
+        return fail(fmt::format("couldn't be given an image: {}", e.what()));
+      }
+      const uint32_t index = image ? *image : REMOTE_NO_WORK;
+      outFrame = makeFrame(
+          std::string_view((const char *)&index, sizeof(index)));
+
+      auto self = shared_from_this();
+      asio::async_write(
+          socket, asio::buffer(outFrame),
+          [this, self](boost::system::error_code ec, std::size_t) {
+            if (ec) {
+              return lost();
+            }
+            if (image) {
+              receive(&Session::onResult, REMOTE_MAX_FRAME_SIZE);
+            } else {
+              coordinator.notice(
+                  fmt::format("Worker {} finished.", workerID));
+            }
+          });
+    }
+
+    void onResult() {
+      LocalMessage message;
+      if (!deserializeMessage(frame, message)) {
+        return fail("sent an invalid result");
+      }
+      // The server loop parses these, check them here so a bad one only
+      // drops this worker
+      try {
+        if (message.fingerprint.length()) {
+          std::stoull(message.fingerprint, nullptr, 16);
+        }
+        Provider::Profiler().deserialize(message.profile);
+      } catch (const std::logic_error &) {
+        return fail("sent an invalid result");
+      }
+      message.clientID = workerID;
+      message.node = node;
+      coordinator.receive(std::move(message));
+      sendWork();
+    }
+
+    void fail(std::string_view reason) {
+      deadline.cancel();
+      coordinator.notice(fmt::format("Worker {} {}.", workerID, reason));
+      if (!image) {
+        return;
+      }
+
+      // The image is reported as processed so the server doesn't wait for it
+      auto [imagePath, imageName] =
+          getImageName(coordinator.dCtx, coordinator.dCtx.images[*image]);
+      LocalMessage message;
+      message.clientID = workerID;
+      message.node = node;
+      message.currentImage = imageName;
+      message.currentImagePath = imagePath;
+      message.failed = "1";
+      message.logs = fmt::format(
+          "Worker {} {} while processing the image.\n", workerID, reason);
+      coordinator.receive(std::move(message));
+      image.reset();
+    }
+  };
+
+  WorkQueue *workQueue;
+  Dyld::Context &dCtx;
+  const std::string cacheUUID;
+  const std::string token;
+  const std::chrono::seconds timeout;
+  unsigned int sessionCount = 0;
+
+  std::mutex mutex;
+  std::vector<LocalMessage> receivedMessages;
+  std::vector<std::string> receivedNotices;
+
+  asio::io_context io;
+  tcp::acceptor acceptor;
+  std::thread thread;
+
+  void accept() {
+    acceptor.async_accept(
+        [this](boost::system::error_code ec, tcp::socket socket) {
+          if (ec == asio::error::operation_aborted) {
+            return;
+          }
+          if (!ec) {
+            std::make_shared<Session>(*this, std::move(socket), sessionCount++)
+                ->start();
+          }
+          accept();
+        });
+  }
+
+  void receive(LocalMessage &&message) {
+    std::scoped_lock lock(mutex);
+    receivedMessages.push_back(std::move(message));
+  }
+
+  void notice(std::string &&notice) {
+    std::scoped_lock lock(mutex);
+    receivedNotices.push_back(std::move(notice));
+  }
+};
+#pragma endregion Coordinator
 
 #pragma region Server
 #define SHARED_MEMORY_NAME "dyldex_all_multiprocess"
@@ -264,8 +1087,82 @@ struct ClientProcess {
 
   // The name of the next image to be process
   std::string nextImage;
+  // The path of the next image, empty if the client has no image
+  std::string nextImagePath;
+  // How many times the client was restarted
+  unsigned int generation;
+};
+
+/// Estimate the peak memory used to process an image. This is its private
+/// copy of the segments, and its linkedit data, which is read and rebuilt.
+template <class P>
+uint64_t estimateFootprint(const Macho::Context<true, P> &mCtx) {
+  uint64_t footprint = 0;
+  for (const auto &seg : mCtx.segments) {
+    if (strncmp(seg.command->segname, SEG_LINKEDIT, 16) != 0) {
+      footprint += seg.command->vmsize;
+    }
+  }
+
+  uint64_t linkedit = 0;
+  if (auto symtab = mCtx.template getFirstLC<Macho::Loader::symtab_command>()) {
+    linkedit += (uint64_t)symtab->nsyms * sizeof(Macho::Loader::nlist<P>) +
+                symtab->strsize;
+  }
+  if (auto dysymtab =
+          mCtx.template getFirstLC<Macho::Loader::dysymtab_command>()) {
+    linkedit += (uint64_t)dysymtab->nindirectsyms * sizeof(uint32_t);
+  }
+  if (auto dyldInfo =
+          mCtx.template getFirstLC<Macho::Loader::dyld_info_command>()) {
+    linkedit += (uint64_t)dyldInfo->rebase_size + dyldInfo->bind_size +
+                dyldInfo->weak_bind_size + dyldInfo->lazy_bind_size +
+                dyldInfo->export_size;
+  }
+  mCtx.template forEachLC<Macho::Loader::linkedit_data_command>(
+      [&linkedit](const auto lc) { linkedit += lc->datasize; });
+  return footprint + linkedit * 2;
+}
+
+struct ScheduledImage {
+  uint32_t image;
+  uint64_t footprint;
+  uint64_t cost;
 };
 
+/// Order images by their estimated processing cost, largest first, so that a
+/// large image is not left running after the other clients have finished.
+template <class A>
+std::vector<ScheduledImage> orderImages(Dyld::Context &dCtx,
+                                        const std::vector<uint32_t> &images) {
+  using P = A::P;
+
+  std::vector<std::pair<uint64_t, ScheduledImage>> costs;
+  costs.reserve(images.size());
+  for (const auto i : images) {
+    // Use the size of the image's segments, excluding the shared linkedit
+    uint64_t cost = 0;
+    auto mCtx = dCtx.createMachoCtx<true, P>(dCtx.images[i]);
+    for (const auto &seg : mCtx.segments) {
+      if (strncmp(seg.command->segname, SEG_LINKEDIT, 16) != 0) {
+        cost += seg.command->vmsize;
+      }
+    }
+
+    costs.push_back({cost, {i, estimateFootprint(mCtx), cost}});
+  }
+
+  std::stable_sort(costs.begin(), costs.end(),
+                   [](const auto &a, const auto &b) { return a.first > b.first; });
+
+  std::vector<ScheduledImage> order;
+  order.reserve(costs.size());
+  for (const auto &[cost, image] : costs) {
+    order.push_back(image);
+  }
+  return order;
+}
+
 /// Default server that uses multiple processes
 template <class A> int server(ProgramArguments &args, Dyld::Context &dCtx) {
   signal(SIGINT, sigintHandler);
@@ -280,10 +1177,76 @@ template <class A> int server(ProgramArguments &args, Dyld::Context &dCtx) {
     }
   } sharedMemoryRemover;
 
-  bi::managed_shared_memory sharedMemory(bi::create_only, SHARED_MEMORY_NAME,
-                                         65536);
-  auto messageQueue = sharedMemory.construct<MessageQueue>(
-      SHARED_MESSAGE_QUEUE_NAME)(sharedMemory.get_segment_manager());
+  // Select images, the accelerator is only used for dependencies
+  std::vector<uint32_t> selectedImages;
+  {
+    Provider::Accelerator<typename A::P> accelerator;
+    Provider::ImageSelector<typename A::P> selector(dCtx, accelerator);
+    for (const auto &filter : args.filters) {
+      selector.addGlob(filter);
+    }
+    for (const auto &regex : args.regexes) {
+      selector.addRegex(regex);
+    }
+    selectedImages = selector.select(args.withDependencies);
+  }
+
+  // Record progress in the output directory
+  std::optional<Provider::ProgressJournal> journal;
+  std::size_t resumedImages = 0;
+  if (args.outputDir && !args.archivePath && !args.disableOutput &&
+      !args.onlyValidate) {
+    fs::create_directories(*args.outputDir);
+    journal.emplace(*args.outputDir / ".dyldex_journal", dCtx, args.resume);
+    std::erase_if(selectedImages, [&](uint32_t image) {
+      const bool completed = journal->getResult(image) ==
+                             Provider::ProgressJournal::Result::completed;
+      resumedImages += completed;
+      return completed;
+    });
+  }
+
+  auto imageOrder = orderImages<A>(dCtx, selectedImages);
+  if (journal) {
+    // Retry the images that failed first
+    std::stable_partition(
+        imageOrder.begin(), imageOrder.end(), [&](const auto &scheduled) {
+          return journal->getResult(scheduled.image) ==
+                 Provider::ProgressJournal::Result::failed;
+        });
+  }
+  bi::managed_shared_memory sharedMemory(
+      bi::create_only, SHARED_MEMORY_NAME,
+      65536 + args.jobs * sizeof(MessageRing) +
+          imageOrder.size() * (sizeof(uint32_t) + sizeof(uint64_t) +
+                               sizeof(uint8_t) + 2 * sizeof(uint32_t)));
+  auto messageRings = sharedMemory.construct<MessageRing>(
+      SHARED_MESSAGE_RINGS_NAME)[args.jobs]();
+  auto workQueue = sharedMemory.construct<WorkQueue>(SHARED_WORK_QUEUE_NAME)(
+      sharedMemory.get_segment_manager());
+  workQueue->images.reserve(imageOrder.size());
+  workQueue->footprints.reserve(imageOrder.size());
+  for (const auto &scheduled : imageOrder) {
+    workQueue->images.push_back(scheduled.image);
+    workQueue->footprints.push_back(scheduled.footprint);
+  }
+  workQueue->taken.assign(imageOrder.size(), false);
+  workQueue->holders.assign(imageOrder.size(), NO_HOLDER);
+  workQueue->budget = args.memoryBudget;
+  if (args.scheduleByDependencies && args.jobs > 1) {
+    std::vector<uint32_t> images;
+    std::vector<uint64_t> costs;
+    for (const auto &scheduled : imageOrder) {
+      images.push_back(scheduled.image);
+      costs.push_back(scheduled.cost);
+    }
+
+    Provider::Accelerator<typename A::P> accelerator;
+    const auto owners =
+        Provider::ImageScheduler<typename A::P>(dCtx, accelerator)
+            .assign(images, costs, args.jobs);
+    workQueue->owners.assign(owners.begin(), owners.end());
+  }
 
   // Server setup
   Provider::ActivityLogger activity("dyldex_all_multiprocess", std::cout, true);
@@ -295,11 +1258,55 @@ template <class A> int server(ProgramArguments &args, Dyld::Context &dCtx) {
     logger->set_level(spdlog::level::info);
   }
   activity.update("DyldEx All", "Starting up");
+  if (resumedImages) {
+    SPDLOG_LOGGER_INFO(logger, "Skipping {} images completed in the journal.",
+                       resumedImages);
+  }
+
+  // Build the exports once, clients load them from an accelerator cache
+  struct ExportsDirRemover {
+    std::optional<fs::path> dir;
+    ~ExportsDirRemover() {
+      if (dir) {
+        std::error_code ec;
+        fs::remove_all(*dir, ec);
+      }
+    }
+  } exportsDir;
+  auto saveExports = [&]() {
+    exportsDir.dir = fs::temp_directory_path() /
+                     fmt::format("dyldex_exports_{}",
+                                 boost::this_process::get_id());
+    fs::create_directories(*exportsDir.dir);
+
+    Provider::Accelerator<typename A::P> accelerator;
+    Provider::Symbolizer<A>::preloadExports(dCtx, accelerator, logger,
+                                            std::max(args.jobs, 1u));
+    Provider::AcceleratorCache<typename A::P>(*exportsDir.dir, dCtx)
+        .save(accelerator);
+  };
+  if (args.preloadExports) {
+    activity.update(std::nullopt, "Preloading exports");
+    saveExports();
+  }
 
   auto &loggerStream = activity.getLoggerStream();
   std::ostringstream summaryLog;
+  Provider::Profiler profiler;
+  Provider::ImageManifest manifest;
+  if (args.manifestPath && !manifest.load(*args.manifestPath)) {
+    SPDLOG_LOGGER_INFO(logger, "Manifest not loaded.");
+  }
   int imagesProcessed = 0;
-  const int totalImages = (int)dCtx.images.size();
+  const int totalImages = (int)imageOrder.size();
+  std::optional<Provider::MetricsExporter> metrics;
+  if (args.metricsPath) {
+    metrics.emplace(*args.metricsPath,
+                    std::chrono::seconds(args.metricsInterval));
+    metrics->addImages(totalImages);
+    metrics->setQueueDepth(totalImages);
+    profiler.setMetrics(&*metrics);
+  }
 
   // Launch clients
   std::vector<std::string> clientArgsBase = args.rawArguments;
@@ -321,25 +1328,123 @@ template <class A> int server(ProgramArguments &args, Dyld::Context &dCtx) {
     return 1;
 
   bp::group clientGroup;
-  std::map<std::string, ClientProcess> clients;
-  for (unsigned int i = 0; i < args.jobs; i++) {
-    std::string clientID = std::to_string(i);
-
+  auto launchClient = [&](const std::string &clientID,
+                          unsigned int generation) {
     auto clientArgs = clientArgsBase;
+    if (exportsDir.dir) {
+      clientArgs.emplace_back("--client-exports");
+      clientArgs.push_back(exportsDir.dir->string());
+    }
     clientArgs.emplace_back("--client-spec");
     clientArgs.push_back(clientID);
     clientArgs.push_back(clientArch);
-    clientArgs.push_back(std::to_string(i));
-    clientArgs.push_back(std::to_string(dCtx.images.size()));
-    clientArgs.push_back(std::to_string(args.jobs));
+    clientArgs.push_back(std::to_string(generation));
 
-    clients[clientID] = {
+    return ClientProcess{
         bp::child(args.programPath.string(), bp::args(clientArgs), clientGroup),
-        ""};
+        "", "", generation};
+  };
+
+  std::map<std::string, ClientProcess> clients;
+  for (unsigned int i = 0; i < args.jobs; i++) {
+    std::string clientID = std::to_string(i);
+    clients[clientID] = launchClient(clientID, 0);
   }
 
+  // Serve images to remote workers
+  std::optional<RemoteCoordinator> coordinator;
+  if (args.listenAddress) {
+    const auto &[host, port] = *args.listenAddress;
+    coordinator.emplace(host, port, args.remoteToken,
+                        std::chrono::seconds(args.remoteTimeout), workQueue,
+                        dCtx);
+    loggerStream << fmt::format("Listening for remote workers on {}:{}.",
+                                host.empty() ? "*" : host, port)
+                 << std::endl;
+  }
+  // Image indices by path
+  std::unordered_map<std::string, uint32_t> imageIndices;
+  for (const auto &scheduled : imageOrder) {
+    imageIndices[getImageName(dCtx, dCtx.images[scheduled.image]).first] =
+        scheduled.image;
+  }
+
+  // The number of images processed, and with logs, by each node
+  std::map<std::string, std::pair<int, int>> nodeResults;
+
+  auto handleMessage = [&](const LocalMessage &message) {
+    if (message.currentImage.length()) {
+      // update UI
+      imagesProcessed++;
+      activity.update(std::nullopt,
+                      fmt::format("[{:4}/{}]", imagesProcessed, totalImages));
+
+      if (!args.quiet || message.logs.length()) {
+        loggerStream << fmt::format("Processed {}\n{}", message.currentImage,
+                                    message.logs)
+                     << std::endl;
+      }
+
+      if (message.profile.length()) {
+        if (metrics) {
+          // Count the output of the image from its write stage
+          Provider::Profiler imageProfiler;
+          imageProfiler.deserialize(message.profile);
+          for (auto &record : imageProfiler.getRecords()) {
+            if (record.stage == "write" && message.failed.empty()) {
+              metrics->addBytesWritten(record.bytes);
+            }
+            profiler.add(std::move(record));
+          }
+        } else {
+          profiler.deserialize(message.profile);
+        }
+      }
+      if (metrics) {
+        metrics->imageDone(!message.failed.empty());
+      }
+
+      if (message.fingerprint.length()) {
+        manifest.record(message.currentImagePath,
+                        std::stoull(message.fingerprint, nullptr, 16));
+      }
+
+      if (journal) {
+        if (auto it = imageIndices.find(message.currentImagePath);
+            it != imageIndices.end() &&
+            !journal->record(it->second,
+                             message.failed.length()
+                                 ? Provider::ProgressJournal::Result::failed
+                                 : Provider::ProgressJournal::Result::
+                                       completed)) {
+          SPDLOG_LOGGER_ERROR(logger, "Unable to write the journal.");
+        }
+      }
+
+      auto &nodeResult =
+          nodeResults[message.node.empty() ? "local" : message.node];
+      nodeResult.first++;
+      nodeResult.second += message.logs.length() != 0;
+
+      // Update summary if needed
+      if (message.logs.length()) {
+        summaryLog << fmt::format("* {}\n{}", message.currentImage,
+                                  message.logs)
+                   << std::endl;
+      }
+    }
+
+    if (message.node.empty()) {
+      clients[message.clientID].nextImage = message.nextImage;
+      clients[message.clientID].nextImagePath = message.nextImagePath;
+    }
+  };
+
   // Server loop
   bool clientFailure = false;
+  std::vector<LocalMessage> messages;
+  std::vector<std::string> notices;
+  std::vector<std::string> partialMessages(args.jobs);
   while (true) {
     // Check signal
     if (interrupted) {
@@ -347,65 +1452,106 @@ template <class A> int server(ProgramArguments &args, Dyld::Context &dCtx) {
       break;
     }
 
-    bool stop = false;
-    for (auto &[clientID, clientProc] : clients) {
-      if (!clientProc.process.running()) {
-        clientProc.process.wait();
-
-        auto exitCode = clientProc.process.exit_code();
-        if (exitCode == 0 || exitCode == 259) {
-          // Client finished its work
-          clients.erase(clientID);
-        } else {
-          loggerStream
-              << fmt::format("Client {} has unexpectedly ended with exit code: "
-                             "{} while processing {}. Stopping all clients.",
-                             clientID, exitCode, clients[clientID].nextImage)
-              << std::endl;
-
-          clientFailure = true;
-          stop = true;
-        }
+    // drain the message rings
+    messages.clear();
+    for (unsigned int i = 0; i < args.jobs; i++) {
+      receiveMessages(&messageRings[i], partialMessages[i], messages);
+    }
+    if (coordinator) {
+      coordinator->drain(messages, notices);
+      for (const auto &notice : notices) {
+        loggerStream << notice << std::endl;
+      }
+      notices.clear();
+    }
+    if (messages.empty()) {
+      // Make sure that there are no messages because there are not any
+      // clients, remote workers can still connect
+      if (!clients.size() && !coordinator) {
+        loggerStream << "All clients have stopped, but there were still images "
+                        "left to be process. Stopping."
+                     << std::endl;
         break;
       }
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
     }
-    if (stop) {
-      break;
+
+    for (const auto &message : messages) {
+      handleMessage(message);
+    }
+    if (metrics && messages.size()) {
+      metrics->setQueueDepth(remainingWork(workQueue));
     }
 
-    // check message queue
-    if (auto message =
-            receiveMessage(messageQueue, std::chrono::milliseconds(100))) {
-      if (message->currentImage.length()) {
-        // update UI
-        imagesProcessed++;
-        activity.update(std::nullopt,
-                        fmt::format("[{:4}/{}]", imagesProcessed, totalImages));
+    bool stop = false;
+    for (auto &[clientID, clientProc] : clients) {
+      if (clientProc.process.running()) {
+        continue;
+      }
+      clientProc.process.wait();
 
-        if (!args.quiet || message->logs.length()) {
-          loggerStream << fmt::format("Processed {}\n{}", message->currentImage,
-                                      message->logs)
-                       << std::endl;
-        }
+      auto exitCode = clientProc.process.exit_code();
+      if (exitCode == 0 || exitCode == 259) {
+        // Client finished its work
+        clients.erase(clientID);
+        break;
+      }
 
-        // Update summary if needed
-        if (message->logs.length()) {
-          summaryLog << fmt::format("* {}\n{}", message->currentImage,
-                                    message->logs)
-                     << std::endl;
-        }
+      // Handle the messages the client sent before it ended, so its image
+      // is known. Nothing else writes to its ring now.
+      const auto ringI = std::stoul(clientID);
+      messages.clear();
+      receiveMessages(&messageRings[ringI], partialMessages[ringI], messages);
+      partialMessages[ringI].clear();
+      for (const auto &message : messages) {
+        handleMessage(message);
       }
 
-      clients[message->clientID].nextImage = message->nextImage;
-    } else {
-      // Make sure that it didn't timeout because there are not any
-      // clients
-      if (!clients.size()) {
-        loggerStream << "All clients have stopped, but there were still images "
-                        "left to be process. Stopping."
-                     << std::endl;
+      // Release everything the client held, an image it took but didn't
+      // report yet is handed out again
+      clientFailure = true;
+      std::optional<uint32_t> processing;
+      if (auto it = imageIndices.find(clientProc.nextImagePath);
+          it != imageIndices.end()) {
+        processing = it->second;
+      }
+      if (!releaseClient(workQueue, (uint32_t)ringI, processing)) {
+        // Not while processing an image, so a new client would fail too
+        loggerStream
+            << fmt::format("Client {} has unexpectedly ended with exit code: "
+                           "{}. Stopping all clients.",
+                           clientID, exitCode)
+            << std::endl;
+        stop = true;
         break;
       }
+
+      // Fail the image and hand the rest of the work to a new client
+      loggerStream << fmt::format("Client {} has unexpectedly ended with exit "
+                                  "code: {} while processing {}. Restarting "
+                                  "it.",
+                                  clientID, exitCode, clientProc.nextImage)
+                   << std::endl;
+      LocalMessage failure;
+      failure.clientID = clientID;
+      failure.currentImage = clientProc.nextImage;
+      failure.currentImagePath = clientProc.nextImagePath;
+      failure.logs = fmt::format(
+          "Client {} ended with exit code {} while processing the image.\n",
+          clientID, exitCode);
+      failure.failed = "1";
+      handleMessage(failure);
+
+      // Start the new client warm from the saved exports
+      if (!exportsDir.dir) {
+        activity.update(std::nullopt, "Saving exports for restarted clients");
+        saveExports();
+      }
+      clientProc = launchClient(clientID, clientProc.generation + 1);
+      break;
+    }
+    if (stop) {
+      break;
     }
 
     if (imagesProcessed == totalImages) {
@@ -420,6 +1566,15 @@ template <class A> int server(ProgramArguments &args, Dyld::Context &dCtx) {
     clientProc.process.wait();
   }
 
+  // Written even if a client failed, so the next run resumes
+  if (args.manifestPath && !manifest.save(*args.manifestPath)) {
+    SPDLOG_LOGGER_ERROR(logger, "Unable to write manifest.");
+  }
+
+  if (args.profileReport && !profiler.writeReport(*args.profileReport)) {
+    SPDLOG_LOGGER_ERROR(logger, "Unable to write profile report.");
+  }
+
   // Write summary
   activity.update(std::nullopt, "Done");
   activity.stopActivity();
@@ -430,6 +1585,16 @@ template <class A> int server(ProgramArguments &args, Dyld::Context &dCtx) {
                  << std::endl;
   }
 
+  if (coordinator) {
+    std::string nodes;
+    for (const auto &[node, result] : nodeResults) {
+      nodes += fmt::format("{}: {} images, {} with logs\n", node, result.first,
+                           result.second);
+    }
+    loggerStream << fmt::format("\n==== Nodes ====\n{}===============", nodes)
+                 << std::endl;
+  }
+
   if (clientFailure) {
     return 1;
   } else {
@@ -439,6 +1604,24 @@ template <class A> int server(ProgramArguments &args, Dyld::Context &dCtx) {
 #pragma endregion Server
 
 #pragma region Client
+/// @brief Get the stages to run from the arguments.
+Converter::ExtractionOptions
+getExtractionOptions(const ProgramArguments &args) {
+  Converter::ExtractionOptions options;
+  options.processSlideInfo = !args.modulesDisabled.processSlideInfo;
+  options.optimizeLinkedit = !args.modulesDisabled.optimizeLinkedit;
+  options.fixStubs = !args.modulesDisabled.fixStubs;
+  options.fixObjc = !args.modulesDisabled.fixObjc;
+  options.generateMetadata = !args.modulesDisabled.generateMetadata;
+  if (args.imbedVersion) {
+    options.imbedVersion = DYLDEXTRACTORC_VERSION_DATA;
+  }
+  options.threads = 1;
+  options.optimizeOpcodes = args.optimizeOpcodes;
+  options.verbose = args.verbose;
+  return options;
+}
+
 std::pair<std::string, std::string>
 getImageName(Dyld::Context &dCtx, const dyld_cache_image_info *image) {
   std::string imagePath((char *)(dCtx.file + image->pathFileOffset));
@@ -450,8 +1633,11 @@ template <class A>
 std::ostringstream
 processImage(ProgramArguments &args, Dyld::Context &dCtx,
              Provider::Accelerator<typename A::P> &accelerator,
+             Provider::Profiler &profiler, Converter::ArchiveWriter *archive,
+             const Provider::ImageManifest *manifest,
              const dyld_cache_image_info *imageInfo, std::string imagePath,
-             std::string imageName) {
+             std::string imageName, std::optional<uint64_t> &fingerprint,
+             bool &failed) {
   using P = A::P;
 
   // Setup context
@@ -468,11 +1654,54 @@ processImage(ProgramArguments &args, Dyld::Context &dCtx,
 
   auto mCtx = dCtx.createMachoCtx<false, P>(imageInfo);
 
+  uint64_t imageSize = 0;
+  for (const auto &seg : mCtx.segments) {
+    imageSize += seg.command->filesize;
+  }
+
+  // Where the image is written, unless it's added to the archive
+  fs::path outputPath;
+  if (args.outputDir) {
+    outputPath = *args.outputDir / imagePath.substr(1); // remove leading /
+    if (args.compression) {
+      outputPath += ".zst";
+    }
+  }
+
+  // Skip unchanged images
+  std::optional<uint64_t> inputFingerprint;
+  if (manifest && !args.onlyValidate && !args.disableOutput) {
+    auto configuration = fmt::format(
+        "{} {:x} {} {}", DYLDEXTRACTORC_VERSION, args.modulesDisabled.raw,
+        args.imbedVersion, fs::absolute(outputPath).string());
+    if (args.optimizeOpcodes) {
+      configuration += " optimize-opcodes";
+    }
+    if (args.compression) {
+      configuration += fmt::format(" compress {}", args.compression->level);
+    }
+    if (args.sparse) {
+      configuration += " sparse";
+    }
+    inputFingerprint =
+        profiler.measure(imageName, "fingerprint", imageSize, [&]() {
+          return Provider::ImageManifest::fingerprint(dCtx, mCtx,
+                                                      configuration);
+        });
+    if (manifest->matches(imagePath, *inputFingerprint) &&
+        fs::exists(outputPath)) {
+      fingerprint = inputFingerprint;
+      return loggerStream;
+    }
+  }
+
   // Validate
   try {
-    Provider::Validator<P>(mCtx).validate();
+    profiler.measure(imageName, "validate", imageSize,
+                     [&]() { Provider::Validator<P>(mCtx).validate(); });
   } catch (const std::exception &e) {
     SPDLOG_LOGGER_ERROR(logger, "Validation Error: {}.", e.what());
+    failed = true;
     return loggerStream;
   }
 
@@ -483,94 +1712,254 @@ processImage(ProgramArguments &args, Dyld::Context &dCtx,
   Utils::ExtractionContext<A> eCtx(dCtx, mCtx, accelerator, activity);
 
   // Process image
-  if (!args.modulesDisabled.processSlideInfo) {
-    Converter::processSlideInfo(eCtx);
-  }
-  if (!args.modulesDisabled.optimizeLinkedit) {
-    Converter::optimizeLinkedit(eCtx);
-  }
-  if (!args.modulesDisabled.fixStubs) {
-    Converter::fixStubs(eCtx);
-  }
-  if (!args.modulesDisabled.fixObjc) {
-    Converter::fixObjc(eCtx);
-  }
-  if (!args.modulesDisabled.generateMetadata) {
-    Converter::generateMetadata(eCtx);
-  }
-  if (args.imbedVersion) {
-    if constexpr (!std::is_same_v<P, Utils::Arch::Pointer64>) {
-      SPDLOG_LOGGER_ERROR(
-          logger, "Unable to imbed version info in a non 64 bit image.");
-    } else {
-      mCtx.header->reserved = DYLDEXTRACTORC_VERSION_DATA;
-    }
-  }
+  auto measure = [&](const char *stage, auto func) {
+    return profiler.measure(imageName, stage, imageSize, func);
+  };
+  Converter::runStages(eCtx, getExtractionOptions(args),
+                       [&](const char *stage, const auto &run) {
+                         measure(stage, run);
+                       });
 
   if (!args.disableOutput) {
-    auto writeProcedures = Converter::optimizeOffsets(eCtx);
+    auto plan = measure(
+        "optimizeOffsets", [&]() { return Converter::planOutput(eCtx); });
+    const auto &writeProcedures = plan.procedures;
 
-    auto outputPath = *args.outputDir / imagePath.substr(1); // remove leading /
-    fs::create_directories(outputPath.parent_path());
-    std::ofstream outFile(outputPath, std::ios_base::binary);
-    if (outFile.good()) {
-      for (auto procedure : writeProcedures) {
-        outFile.seekp(procedure.writeOffset);
-        outFile.write((const char *)procedure.source, procedure.size);
-      }
-      outFile.close();
-    } else {
-      SPDLOG_LOGGER_ERROR(logger, "Unable to open output file.");
+    uint64_t outputSize = 0;
+    for (const auto &procedure : writeProcedures) {
+      outputSize += procedure.size;
+    }
+
+    if (!profiler.measure(imageName, "write", outputSize, [&]() {
+          if (archive) {
+            return archive->add(imagePath.substr(1), writeProcedures);
+          }
+
+          fs::create_directories(outputPath.parent_path());
+          if (args.compression) {
+            return Converter::writeCompressedProcedures(
+                outputPath, writeProcedures, *args.compression);
+          }
+          return Converter::writeProcedures(outputPath, plan, args.sparse);
+        })) {
+      SPDLOG_LOGGER_ERROR(logger, "Unable to write output file.");
+      failed = true;
+      return loggerStream;
     }
   }
 
+  fingerprint = inputFingerprint;
   return loggerStream;
 }
 
 template <class A> int client(ProgramArguments &args) {
   using P = A::P;
 
-  // Get shared message queue
+  // Get the message ring and work queue
   bi::managed_shared_memory sharedMemory(bi::open_only, SHARED_MEMORY_NAME);
-  auto messageQueue =
-      sharedMemory.find<MessageQueue>(SHARED_MESSAGE_QUEUE_NAME).first;
+  auto [messageRings, ringCount] =
+      sharedMemory.find<MessageRing>(SHARED_MESSAGE_RINGS_NAME);
+  const auto clientIndex = (std::size_t)std::stoul(args.clientSpec.clientID);
+  if (!messageRings || clientIndex >= ringCount) {
+    throw std::runtime_error("Unable to find the client's message ring.");
+  }
+  auto messageRing = &messageRings[clientIndex];
+  auto workQueue = sharedMemory.find<WorkQueue>(SHARED_WORK_QUEUE_NAME).first;
+
+  // Pin before touching memory, so it's allocated on the client's node
+  Utils::Placement::pinWorker(Utils::Placement::getNodes(), args.pin,
+                              (unsigned int)clientIndex);
 
   // Setup processing
   Dyld::Context dCtx(args.cachePath);
+  if (args.prefault) {
+    dCtx.loadIntoHugePages();
+  }
   Provider::Accelerator<P> accelerator;
-
-  // tell server about first image
-  if (auto i = args.clientSpec.start; i < args.clientSpec.end) {
-    auto nextImageName =
-        getImageName(dCtx, dCtx.images[args.clientSpec.start]).second;
-    sendMessage(messageQueue,
-                {args.clientSpec.clientID, "", "", nextImageName});
+  if (args.clientExportsDir) {
+    Provider::AcceleratorCache<P>(*args.clientExportsDir, dCtx)
+        .load(accelerator);
+  }
+  std::optional<Provider::ImageManifest> manifest;
+  if (args.manifestPath) {
+    manifest.emplace();
+    manifest->load(*args.manifestPath);
+  }
+  std::optional<Converter::ArchiveWriter> archive;
+  if (args.archivePath && !args.disableOutput && !args.onlyValidate) {
+    // A restarted client writes a new shard, so the images its previous
+    // generation archived are kept
+    const auto shard =
+        args.clientSpec.generation * args.jobs + (unsigned int)clientIndex;
+    archive.emplace(
+        Converter::ArchiveWriter::getShardPath(*args.archivePath, shard));
   }
 
-  for (auto i = args.clientSpec.start; i < args.clientSpec.end;
-       i += args.clientSpec.skip) {
-    auto imageInfo = dCtx.images[i];
+  // Tell the server which image is processed next
+  auto announce = [&](std::optional<uint32_t> image) {
+    if (!image) {
+      return;
+    }
+    auto [nextImagePath, nextImageName] =
+        getImageName(dCtx, dCtx.images[*image]);
+    LocalMessage message;
+    message.clientID = args.clientSpec.clientID;
+    message.nextImage = nextImageName;
+    message.nextImagePath = nextImagePath;
+    sendMessage(messageRing, message);
+  };
+
+  auto next = takeWork(workQueue, (uint32_t)clientIndex);
+  announce(next);
+
+  while (next) {
+    auto imageInfo = dCtx.images[*next];
     auto [imagePath, imageName] = getImageName(dCtx, imageInfo);
-    auto loggerStream = processImage<A>(args, dCtx, accelerator, imageInfo,
-                                        imagePath, imageName);
-
-    // Peek ahead
-    std::string nextImageName = "";
-    if (auto nextI = i + args.clientSpec.skip; nextI < args.clientSpec.end) {
-      nextImageName = getImageName(dCtx, dCtx.images[nextI]).second;
+    Provider::Profiler profiler;
+    std::optional<uint64_t> fingerprint;
+    bool failed = false;
+    auto loggerStream = processImage<A>(
+        args, dCtx, accelerator, profiler, archive ? &*archive : nullptr,
+        manifest ? &*manifest : nullptr, imageInfo, imagePath, imageName,
+        fingerprint, failed);
+    if (args.releasePages) {
+      dCtx.releasePages();
     }
 
-    // Send logs
-    sendMessage(messageQueue, {args.clientSpec.clientID, imageName,
-                               loggerStream.str(), nextImageName});
+    // Report the image before taking the next one, which can wait for
+    // budget. The work queue knows what the client holds if it crashes.
+    finishWork(workQueue, (uint32_t)clientIndex, *next);
+    sendMessage(messageRing,
+                {args.clientSpec.clientID, imageName, loggerStream.str(), "",
+                 args.profileReport || args.metricsPath ? profiler.serialize()
+                                                        : std::string(),
+                 imagePath,
+                 fingerprint ? fmt::format("{:x}", *fingerprint)
+                             : std::string(),
+                 "", failed ? "1" : "", ""});
+
+    next = takeWork(workQueue, (uint32_t)clientIndex);
+    announce(next);
   }
 
+  if (archive && !archive->finish()) {
+    throw std::runtime_error("Unable to write the output archive.");
+  }
   return 0;
 }
 #pragma endregion Client
 
+#pragma region RemoteWorker
+/// Process images handed out by a coordinator, see RemoteCoordinator
+template <class A>
+int remoteWorker(ProgramArguments &args, Dyld::Context &dCtx) {
+  using P = A::P;
+
+  const auto &[host, port] = *args.connectAddress;
+  const auto node = args.nodeName ? *args.nodeName : asio::ip::host_name();
+
+  // The cache and accelerator are shared by the connections
+  Provider::Accelerator<P> accelerator;
+  if (args.preloadExports) {
+    Provider::ActivityLogger activity("dyldex_all_multiprocess", std::cout,
+                                      false);
+    Provider::Symbolizer<A>::preloadExports(dCtx, accelerator,
+                                            activity.getLogger(),
+                                            std::max(args.jobs, 1u));
+  }
+  std::optional<Provider::ImageManifest> manifest;
+  if (args.manifestPath) {
+    manifest.emplace();
+    manifest->load(*args.manifestPath);
+  }
+
+  std::mutex outputMutex;
+  std::atomic<bool> failed = false;
+  const auto nodes = Utils::Placement::getNodes();
+  auto connection = [&](unsigned int connectionI) {
+    try {
+      Utils::Placement::pinWorker(nodes, args.pin, connectionI);
+      asio::io_context io;
+      tcp::socket socket(io);
+      asio::connect(socket, tcp::resolver(io).resolve(host, port));
+
+      std::string hello;
+      appendField(hello, node);
+      appendField(hello, getCacheUUID(dCtx));
+      appendField(hello, args.remoteToken);
+      asio::write(socket, asio::buffer(makeFrame(hello)));
+
+      while (true) {
+        const auto frame = readFrame(socket);
+        uint32_t index;
+        if (frame.size() != sizeof(index)) {
+          throw std::runtime_error("Received an invalid image index.");
+        }
+        memcpy(&index, frame.data(), sizeof(index));
+        if (index == REMOTE_NO_WORK) {
+          break;
+        }
+        if (index >= dCtx.images.size()) {
+          throw std::runtime_error("Received an invalid image index.");
+        }
+
+        auto imageInfo = dCtx.images[index];
+        auto [imagePath, imageName] = getImageName(dCtx, imageInfo);
+        Provider::Profiler profiler;
+        std::optional<uint64_t> fingerprint;
+        bool imageFailed = false;
+        auto loggerStream = processImage<A>(
+            args, dCtx, accelerator, profiler, nullptr,
+            manifest ? &*manifest : nullptr, imageInfo, imagePath, imageName,
+            fingerprint, imageFailed);
+        if (args.releasePages) {
+          dCtx.releasePages();
+        }
+
+        LocalMessage message;
+        message.currentImage = imageName;
+        message.logs = loggerStream.str();
+        // Always sent, the coordinator may export metrics
+        message.profile = profiler.serialize();
+        message.currentImagePath = imagePath;
+        message.failed = imageFailed ? "1" : "";
+        message.fingerprint =
+            fingerprint ? fmt::format("{:x}", *fingerprint) : std::string();
+        asio::write(socket,
+                    asio::buffer(makeFrame(serializeMessage(message))));
+
+        if (!args.quiet || message.logs.length()) {
+          std::scoped_lock lock(outputMutex);
+          std::cout << fmt::format("Processed {}\n{}", imageName,
+                                   message.logs)
+                    << std::endl;
+        }
+      }
+    } catch (const std::exception &e) {
+      std::scoped_lock lock(outputMutex);
+      std::cerr << fmt::format("Connection {} to the coordinator failed: {}",
+                               connectionI, e.what())
+                << std::endl;
+      failed = true;
+    }
+  };
+
+  std::vector<std::thread> connections;
+  for (unsigned int i = 0; i < std::max(args.jobs, 1u); i++) {
+    connections.emplace_back(connection, i);
+  }
+  for (auto &thread : connections) {
+    thread.join();
+  }
+  return failed ? 1 : 0;
+}
+#pragma endregion RemoteWorker
+
 int main(int argc, char const *argv[]) {
   auto args = parseArgs(argc, argv);
+  if (args.perfCounters) {
+    Utils::PerfCounters::enable();
+  }
   if (args.clientSpec.inClientMode) {
     try {
       switch (args.clientSpec.arch) {
@@ -596,30 +1985,57 @@ int main(int argc, char const *argv[]) {
     }
   } else {
     // Check arguments
-    if (!args.disableOutput && !args.outputDir && !args.onlyValidate) {
-      std::cerr << "Output directory is required for extraction" << std::endl;
+    if (!args.disableOutput && !args.outputDir && !args.archivePath &&
+        !args.onlyValidate) {
+      std::cerr << "Output directory or archive is required for extraction"
+                << std::endl;
+      return 1;
+    }
+    if (args.manifestPath && args.archivePath) {
+      std::cerr << "A manifest can't be used with an archive, skipped images "
+                   "would be missing from it."
+                << std::endl;
       return 1;
     }
+    if (args.resume && (!args.outputDir || args.archivePath)) {
+      std::cerr << "Resuming needs the journal in the output directory, and "
+                   "can't be used with an archive."
+                << std::endl;
+      return 1;
+    }
+    if (args.connectAddress && args.archivePath) {
+      std::cerr << "An archive can't be used with a remote worker." << std::endl;
+      return 1;
+    }
+    if (args.archivePath && args.archivePath->has_parent_path()) {
+      fs::create_directories(args.archivePath->parent_path());
+    }
 
     try {
       Dyld::Context dCtx(args.cachePath);
 
+      // Run as the server, or as a remote worker of another one
+      auto run = [&]<class A>() {
+        return args.connectAddress ? remoteWorker<A>(args, dCtx)
+                                   : server<A>(args, dCtx);
+      };
+
       // use dyld's magic to select arch
       int retCode;
       if (strcmp(dCtx.header->magic, "dyld_v1  x86_64") == 0)
-        retCode = server<Utils::Arch::x86_64>(args, dCtx);
+        retCode = run.template operator()<Utils::Arch::x86_64>();
       else if (strcmp(dCtx.header->magic, "dyld_v1 x86_64h") == 0)
-        retCode = server<Utils::Arch::x86_64>(args, dCtx);
+        retCode = run.template operator()<Utils::Arch::x86_64>();
       else if (strcmp(dCtx.header->magic, "dyld_v1   armv7") == 0)
-        retCode = server<Utils::Arch::arm>(args, dCtx);
+        retCode = run.template operator()<Utils::Arch::arm>();
       else if (strncmp(dCtx.header->magic, "dyld_v1  armv7", 14) == 0)
-        retCode = server<Utils::Arch::arm>(args, dCtx);
+        retCode = run.template operator()<Utils::Arch::arm>();
       else if (strcmp(dCtx.header->magic, "dyld_v1   arm64") == 0)
-        retCode = server<Utils::Arch::arm64>(args, dCtx);
+        retCode = run.template operator()<Utils::Arch::arm64>();
       else if (strcmp(dCtx.header->magic, "dyld_v1  arm64e") == 0)
-        retCode = server<Utils::Arch::arm64>(args, dCtx);
+        retCode = run.template operator()<Utils::Arch::arm64>();
       else if (strcmp(dCtx.header->magic, "dyld_v1arm64_32") == 0)
-        retCode = server<Utils::Arch::arm64_32>(args, dCtx);
+        retCode = run.template operator()<Utils::Arch::arm64_32>();
       else if (strcmp(dCtx.header->magic, "dyld_v1    i386") == 0 ||
                strcmp(dCtx.header->magic, "dyld_v1   armv5") == 0 ||
                strcmp(dCtx.header->magic, "dyld_v1   armv6") == 0) {
@@ -1,14 +1,24 @@
 #include <Converter/Stubs/Arm64Utils.h>
+#include <Dyld/CacheSubset.h>
 #include <Dyld/Context.h>
+#include <Dyld/ImageIndex.h>
+#include <Provider/ActivityLogger.h>
+#include <Provider/ImageSelector.h>
 #include <Provider/PointerTracker.h>
+#include <Provider/SymbolIndex.h>
 #include <Utils/Utils.h>
 #include <argparse/argparse.hpp>
+#include <boost/asio.hpp>
+#include <cstring>
 #include <filesystem>
 #include <fmt/core.h>
+#include <sstream>
+#include <thread>
 
 #include "config.h"
 
 namespace fs = std::filesystem;
+namespace asio = boost::asio;
 using namespace DyldExtractor;
 
 struct ProgramArguments {
@@ -16,6 +26,12 @@ struct ProgramArguments {
   uint64_t address;
   bool findAddress;
   bool resolveChain;
+  bool symbolicate;
+  std::optional<fs::path> acceleratorCacheDir;
+  std::optional<fs::path> captureSubset;
+  std::vector<std::string> filters;
+  bool serve;
+  std::optional<fs::path> socketPath;
 };
 
 ProgramArguments parseArgs(int argc, char *argv[]) {
@@ -41,6 +57,39 @@ ProgramArguments parseArgs(int argc, char *argv[]) {
       .default_value(false)
       .implicit_value(true);
 
+  program.add_argument("--symbolicate")
+      .help("Read addresses from stdin and write the image and symbol that "
+            "contain each one.")
+      .default_value(false)
+      .implicit_value(true);
+
+  program.add_argument("--accelerator-cache")
+      .help("A directory to store the image address index used by "
+            "--find-address and the symbol index used by --symbolicate, "
+            "which speeds up later lookups on the same cache.");
+
+  program.add_argument("--capture-subset")
+      .help("Write a cache that only contains the images matched by --filter "
+            "and their dependencies, for benchmarking on the same input. "
+            "Subcaches are written next to it.");
+
+  program.add_argument("--filter")
+      .help("A glob pattern of image paths for --capture-subset, can be "
+            "given multiple times.")
+      .append();
+
+  program.add_argument("--serve")
+      .help("Keep the cache loaded and answer queries from stdin, one per "
+            "line, like 'find-address 0x1234', 'resolve-chain 0x1234', or "
+            "'symbolicate 0x1234 0x5678'. Each "
+            "answer ends with an empty line.")
+      .default_value(false)
+      .implicit_value(true);
+
+  program.add_argument("--socket")
+      .help("Like --serve, but answer queries from connections to a Unix "
+            "socket at this path. Connections are served one at a time.");
+
   ProgramArguments args;
   try {
     program.parse_args(argc, argv);
@@ -49,6 +98,24 @@ ProgramArguments parseArgs(int argc, char *argv[]) {
     args.address = program.get<uint64_t>("--address");
     args.findAddress = program.get<bool>("--find-address");
     args.resolveChain = program.get<bool>("--resolve-chain");
+    args.symbolicate = program.get<bool>("--symbolicate");
+    if (auto dir = program.present<std::string>("--accelerator-cache"); dir) {
+      args.acceleratorCacheDir = fs::path(*dir);
+    }
+    if (auto path = program.present<std::string>("--capture-subset"); path) {
+      args.captureSubset = fs::path(*path);
+    }
+    if (auto filters =
+            program.present<std::vector<std::string>>("--filter")) {
+      args.filters = *filters;
+    }
+    args.serve = program.get<bool>("--serve");
+    if (auto path = program.present<std::string>("--socket"); path) {
+#ifdef _WIN32
+      throw std::runtime_error("--socket is not supported on Windows.");
+#endif
+      args.socketPath = fs::path(*path);
+    }
 
   } catch (const std::runtime_error &err) {
     std::cerr << "Argument parsing error: " << err.what() << std::endl;
@@ -86,44 +153,60 @@ formatStubFormat(typename Converter::Stubs::Arm64Utils<A>::StubFormat format) {
   }
 }
 
-template <class A> void program(Dyld::Context &dCtx, ProgramArguments &args) {
-  if (args.findAddress) {
-    bool found = false;
-    for (auto imageInfo : dCtx.images) {
-      auto mCtx = dCtx.createMachoCtx<true, typename A::P>(imageInfo);
-      if (mCtx.containsAddr(args.address)) {
-        // Find the specific segment
-        for (const auto &seg : mCtx.segments) {
-          if (args.address >= seg.command->vmaddr &&
-              args.address < seg.command->vmaddr + seg.command->vmsize) {
-            found = true;
-            auto imagePath =
-                (const char *)(dCtx.file + imageInfo->pathFileOffset);
-            std::cout << fmt::format("{}: {}", imagePath, seg.command->segname)
-                      << std::endl;
-            break;
-          }
-        }
-        break;
-      }
+/// @brief Parse an address, hexadecimal numbers need the 0x prefix.
+uint64_t parseAddress(const std::string &str) {
+  std::size_t end = 0;
+  uint64_t address = 0;
+  try {
+    address = std::stoull(str, &end, 0);
+  } catch (const std::logic_error &) {
+    end = 0;
+  }
+  if (!end || end != str.size()) {
+    throw std::runtime_error(fmt::format("Invalid address '{}'.", str));
+  }
+  return address;
+}
+
+/// @brief Answers queries about a cache, keeping the lookup state between
+///   them.
+template <class A> class Queries {
+  using P = A::P;
+
+public:
+  Queries(Dyld::Context &dCtx, const ProgramArguments &args)
+      : dCtx(dCtx), args(args) {}
+
+  /// @brief Build the lookup state now instead of on the first query.
+  void prepare() {
+    getIndex();
+    if constexpr (std::is_same_v<A, Utils::Arch::arm64>) {
+      getStubResolver();
     }
+  }
 
-    if (!found) {
-      std::cerr
-          << fmt::format(
-                 "Unable to find an image that contains the address {:#x}",
-                 args.address)
-          << std::endl;
+  /// @brief Write the image and segment that contain an address, throws if
+  ///   there isn't one.
+  void findAddress(uint64_t address, std::ostream &out) {
+    auto seg = getIndex().find(address);
+    if (!seg) {
+      throw std::runtime_error(fmt::format(
+          "Unable to find an image that contains the address {:#x}", address));
     }
+
+    auto imageInfo = dCtx.images[seg->imageIndex];
+    auto imagePath = (const char *)(dCtx.file + imageInfo->pathFileOffset);
+    std::string_view segname(seg->segname, strnlen(seg->segname, 16));
+    out << fmt::format("{}: {}\n", imagePath, segname);
   }
 
-  if (args.resolveChain) {
+  /// @brief Write each step of a stub chain, throws if the architecture is
+  ///   not supported.
+  void resolveChain(uint64_t address, std::ostream &out) {
     if constexpr (std::is_same_v<A, Utils::Arch::arm64>) {
-      Provider::Accelerator<typename A::P> accelerator;
-      Provider::PointerTracker<typename A::P> ptrTracker(dCtx);
-      Converter::Stubs::Arm64Utils<A> arm64Utils(dCtx, accelerator, ptrTracker);
+      auto &arm64Utils = getStubResolver().arm64Utils;
 
-      auto currentAddr = args.address;
+      auto currentAddr = address;
       while (true) {
         auto data = arm64Utils.resolveStub(currentAddr);
         if (!data) {
@@ -131,10 +214,8 @@ template <class A> void program(Dyld::Context &dCtx, ProgramArguments &args) {
         }
 
         auto [newAddr, format] = *data;
-        std::cout << std::format("{}: {:#x} -> {:#x}",
-                                 formatStubFormat<A>(format), currentAddr,
-                                 newAddr)
-                  << std::endl;
+        out << fmt::format("{}: {:#x} -> {:#x}\n", formatStubFormat<A>(format),
+                           currentAddr, newAddr);
         if (currentAddr == newAddr) {
           break;
         } else {
@@ -142,10 +223,237 @@ template <class A> void program(Dyld::Context &dCtx, ProgramArguments &args) {
         }
       }
     } else {
-      std::cerr << "Not implemented for architectures other than arm64."
+      throw std::runtime_error(
+          "Not implemented for architectures other than arm64.");
+    }
+  }
+
+  /// @brief Write the image and symbol that contain each address, or that
+  ///   the address has no symbol.
+  void symbolicate(const std::vector<uint64_t> &addresses, std::ostream &out) {
+    auto &symbols = getSymbols();
+    std::vector<std::optional<Provider::SymbolIndex::Symbolication>> results;
+    symbols.lookup(addresses, results);
+
+    for (std::size_t i = 0; i < addresses.size(); i++) {
+      const auto &result = results[i];
+      if (!result) {
+        out << fmt::format("{:#x}: no symbol\n", addresses[i]);
+        continue;
+      }
+
+      auto imageInfo = dCtx.images[result->imageIndex];
+      auto imagePath = (const char *)(dCtx.file + imageInfo->pathFileOffset);
+      out << fmt::format("{:#x}: {}: {} + {:#x}\n", addresses[i], imagePath,
+                         result->name, result->offset);
+    }
+  }
+
+  /// @brief Answer queries, one per line, until the input ends or a quit.
+  ///
+  /// A query is a command and an address, or any number of addresses for
+  /// symbolicate. Each answer is the output of the
+  /// command, or a line starting with "error: ", followed by an empty line.
+  /// The output is flushed when there are no more buffered queries, so a
+  /// batch of queries is answered with few writes.
+  void serve(std::istream &in, std::ostream &out) {
+    std::string line;
+    while (std::getline(in, line)) {
+      std::istringstream lineStream(line);
+      std::string command;
+      std::string addressStr;
+      if (!(lineStream >> command)) {
+        continue;
+      }
+      if (command == "quit") {
+        break;
+      }
+
+      try {
+        std::vector<uint64_t> addresses;
+        while (lineStream >> addressStr) {
+          addresses.push_back(parseAddress(addressStr));
+        }
+        if (command == "symbolicate") {
+          symbolicate(addresses, out);
+        } else if (command == "find-address") {
+          findAddress(singleAddress(addresses), out);
+        } else if (command == "resolve-chain") {
+          resolveChain(singleAddress(addresses), out);
+        } else {
+          throw std::runtime_error(
+              fmt::format("Unknown query '{}'.", command));
+        }
+      } catch (const std::exception &e) {
+        out << "error: " << e.what() << "\n";
+      }
+
+      out << "\n";
+      if (in.rdbuf()->in_avail() <= 0) {
+        out.flush();
+      }
+    }
+    out.flush();
+  }
+
+private:
+  struct StubResolver {
+    Provider::Accelerator<P> accelerator;
+    Provider::PointerTracker<P> ptrTracker;
+    Converter::Stubs::Arm64Utils<A> arm64Utils;
+
+    StubResolver(Dyld::Context &dCtx)
+        : ptrTracker(dCtx), arm64Utils(dCtx, accelerator, ptrTracker) {
+      ptrTracker.enableLazySliding();
+    }
+  };
+
+  Dyld::Context &dCtx;
+  const ProgramArguments &args;
+  std::optional<Dyld::ImageIndex> index;
+  std::unique_ptr<StubResolver> stubResolver;
+  std::optional<Provider::SymbolIndex> symbols;
+
+  Dyld::ImageIndex &getIndex() {
+    if (index) {
+      return *index;
+    }
+
+    fs::path indexPath;
+    if (args.acceleratorCacheDir) {
+      indexPath = Dyld::ImageIndex::getPath(*args.acceleratorCacheDir, dCtx);
+      index = Dyld::ImageIndex::load(indexPath, dCtx);
+    }
+    if (!index) {
+      index = Dyld::ImageIndex::build<P>(dCtx);
+      if (args.acceleratorCacheDir) {
+        fs::create_directories(*args.acceleratorCacheDir);
+        index->save(indexPath, dCtx);
+      }
+    }
+    return *index;
+  }
+
+  Provider::SymbolIndex &getSymbols() {
+    if (symbols) {
+      return *symbols;
+    }
+
+    fs::path symbolsPath;
+    if (args.acceleratorCacheDir) {
+      symbolsPath =
+          Provider::SymbolIndex::getPath(*args.acceleratorCacheDir, dCtx);
+      symbols = Provider::SymbolIndex::load(symbolsPath, dCtx);
+    }
+    if (!symbols) {
+      // The exports are only needed while building
+      Provider::ActivityLogger activity("dyldex_info", std::cerr, false);
+      activity.getLogger()->set_level(spdlog::level::warn);
+      Provider::Accelerator<P> accelerator;
+      symbols = Provider::SymbolIndex::build<A>(
+          dCtx, accelerator, activity.getLogger(),
+          std::max(1u, std::thread::hardware_concurrency()));
+      if (args.acceleratorCacheDir) {
+        fs::create_directories(*args.acceleratorCacheDir);
+        symbols->save(symbolsPath, dCtx);
+      }
+    }
+    return *symbols;
+  }
+
+  StubResolver &getStubResolver() {
+    if (!stubResolver) {
+      stubResolver = std::make_unique<StubResolver>(dCtx);
+    }
+    return *stubResolver;
+  }
+
+  /// @brief Get the address of a query that takes one.
+  static uint64_t singleAddress(const std::vector<uint64_t> &addresses) {
+    if (addresses.size() != 1) {
+      throw std::runtime_error("Expected one address.");
+    }
+    return addresses[0];
+  }
+};
+
+template <class A> void program(Dyld::Context &dCtx, ProgramArguments &args) {
+  Queries<A> queries(dCtx, args);
+
+  if (args.serve) {
+    queries.prepare();
+    queries.serve(std::cin, std::cout);
+    return;
+  }
+
+#ifndef _WIN32
+  if (args.socketPath) {
+    queries.prepare();
+
+    using local = asio::local::stream_protocol;
+    if (fs::is_socket(*args.socketPath)) {
+      fs::remove(*args.socketPath);
+    }
+    asio::io_context io;
+    local::acceptor acceptor(io, local::endpoint(args.socketPath->string()));
+    std::cerr << fmt::format("Listening on {}", args.socketPath->string())
+              << std::endl;
+    while (true) {
+      local::iostream stream;
+      acceptor.accept(stream.socket());
+      queries.serve(stream, stream);
+    }
+  }
+#endif
+
+  if (args.findAddress) {
+    try {
+      queries.findAddress(args.address, std::cout);
+    } catch (const std::runtime_error &e) {
+      std::cerr << e.what() << std::endl;
+    }
+  }
+
+  if (args.symbolicate) {
+    std::vector<uint64_t> addresses;
+    std::string addressStr;
+    while (std::cin >> addressStr) {
+      try {
+        addresses.push_back(parseAddress(addressStr));
+      } catch (const std::runtime_error &e) {
+        std::cerr << e.what() << std::endl;
+      }
+    }
+    queries.symbolicate(addresses, std::cout);
+  }
+
+  if (args.captureSubset) {
+    Provider::Accelerator<typename A::P> accelerator;
+    Provider::ImageSelector<typename A::P> selector(dCtx, accelerator);
+    for (const auto &filter : args.filters) {
+      selector.addGlob(filter);
+    }
+    if (selector.empty()) {
+      std::cerr << "--capture-subset needs at least one --filter." << std::endl;
+    } else {
+      const auto imageIndices = selector.select(true);
+      auto subset =
+          Dyld::CacheSubset::build<typename A::P>(dCtx, imageIndices);
+      subset.write(*args.captureSubset);
+      std::cout << fmt::format("Captured {} images, {} bytes into {}",
+                               imageIndices.size(), subset.capturedSize(),
+                               args.captureSubset->string())
                 << std::endl;
     }
   }
+
+  if (args.resolveChain) {
+    try {
+      queries.resolveChain(args.address, std::cout);
+    } catch (const std::runtime_error &e) {
+      std::cerr << e.what() << std::endl;
+    }
+  }
 }
 
 int main(int argc, char *argv[]) {
@@ -0,0 +1,95 @@
+#include "ContentStore.h"
+#include "OutputWriter.h"
+
+#include <Utils/Sha256.h>
+#include <fmt/format.h>
+#include <fstream>
+#include <random>
+
+using namespace DyldExtractor;
+using namespace Converter;
+
+namespace fs = std::filesystem;
+
+ContentStore::ContentStore(const fs::path &dir) : dir(dir) {
+  fs::create_directories(dir / "objects");
+  fs::create_directories(dir / "manifests");
+}
+
+std::optional<std::string>
+ContentStore::add(const std::vector<OffsetWriteProcedure> &procedures) {
+  // Hash the final bytes of the file, without building it
+  std::vector<FileBuffer> buffers;
+  const auto fileSize = getFileBuffers(procedures, buffers);
+  Utils::Sha256 sha;
+  for (const auto &[data, size] : buffers) {
+    sha.update(data, size);
+  }
+  const auto hash = Utils::Sha256::toHex(sha.digest());
+
+  const auto objectPath = getObjectPath(hash);
+  if (fs::exists(objectPath)) {
+    filesReused++;
+    bytesReused += fileSize;
+    return hash;
+  }
+
+  // Write to a unique temporary file and move it into place, so readers and
+  // other writers never see a partial file.
+  fs::create_directories(objectPath.parent_path());
+  thread_local std::mt19937_64 rng(std::random_device{}());
+  auto tmpPath = objectPath;
+  tmpPath += fmt::format(".{:016x}.tmp", rng());
+  if (!writeProcedures(tmpPath, procedures)) {
+    std::error_code ec;
+    fs::remove(tmpPath, ec);
+    return std::nullopt;
+  }
+  fs::rename(tmpPath, objectPath);
+
+  filesWritten++;
+  bytesWritten += fileSize;
+  return hash;
+}
+
+void ContentStore::record(const std::string &imagePath,
+                          const std::string &hash) {
+  std::scoped_lock lock(manifestMutex);
+  manifest[imagePath] = hash;
+}
+
+bool ContentStore::saveManifest(const std::string &name) const {
+  const auto path = dir / "manifests" / (name + ".manifest");
+  // The name is unique so that processes saving the same manifest don't
+  // write to the same file.
+  auto tmpPath = path;
+  tmpPath += fmt::format(".{:08x}.tmp", std::random_device()());
+
+  std::ofstream file(tmpPath);
+  if (!file.good()) {
+    return false;
+  }
+  {
+    std::scoped_lock lock(manifestMutex);
+    for (const auto &[imagePath, hash] : manifest) {
+      file << hash << '\t' << imagePath << '\n';
+    }
+  }
+  file.close();
+  if (!file) {
+    std::error_code ec;
+    fs::remove(tmpPath, ec);
+    return false;
+  }
+
+  fs::rename(tmpPath, path);
+  return true;
+}
+
+fs::path ContentStore::getObjectPath(const std::string &hash) const {
+  return dir / "objects" / hash.substr(0, 2) / hash;
+}
+
+ContentStore::Stats ContentStore::getStats() const {
+  return {filesWritten, bytesWritten, filesReused, bytesReused};
+}
@@ -0,0 +1,71 @@
+#ifndef __CONVERTER_CONTENTSTORE__
+#define __CONVERTER_CONTENTSTORE__
+
+#include "OffsetOptimizer.h"
+#include <atomic>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+
+namespace DyldExtractor::Converter {
+
+/// @brief A content addressed store of output files.
+///
+/// Files are named with the SHA-256 of their contents, so images that are
+/// identical between caches are only written once. Manifests map the image
+/// paths of a cache to their files. The layout is
+///  * objects/ab/abcdef... The output files, by their hash.
+///  * manifests/<name>.manifest The hash and path of each image, per line.
+///
+/// Files can be added from multiple threads and processes.
+class ContentStore {
+public:
+  struct Stats {
+    uint64_t filesWritten;
+    uint64_t bytesWritten;
+    uint64_t filesReused;
+    uint64_t bytesReused;
+  };
+
+  /// @brief Open a store, the directories are created if needed.
+  ContentStore(const std::filesystem::path &dir);
+
+  /// @brief Add an output file, if it is not already in the store.
+  /// @param procedures The procedures from optimizeOffsets.
+  /// @returns The hash of the file in hex, or nullopt if it couldn't be
+  ///   written.
+  std::optional<std::string>
+  add(const std::vector<OffsetWriteProcedure> &procedures);
+
+  /// @brief Record an image for the manifest.
+  /// @param imagePath The path of the image in the cache.
+  /// @param hash The hash from add.
+  void record(const std::string &imagePath, const std::string &hash);
+
+  /// @brief Write the recorded images to a manifest, replacing it.
+  /// @param name The name of the manifest, like the UUID of the cache.
+  /// @returns If the manifest was written.
+  bool saveManifest(const std::string &name) const;
+
+  /// @brief Get the path of a file in the store.
+  std::filesystem::path getObjectPath(const std::string &hash) const;
+
+  Stats getStats() const;
+
+private:
+  std::filesystem::path dir;
+
+  mutable std::mutex manifestMutex;
+  std::map<std::string, std::string> manifest;
+
+  std::atomic_uint64_t filesWritten = 0;
+  std::atomic_uint64_t bytesWritten = 0;
+  std::atomic_uint64_t filesReused = 0;
+  std::atomic_uint64_t bytesReused = 0;
+};
+
+} // namespace DyldExtractor::Converter
+
+#endif // __CONVERTER_CONTENTSTORE__
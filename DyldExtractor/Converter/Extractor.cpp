@@ -0,0 +1,120 @@
+#include "Extractor.h"
+
+#include "Linkedit/Linkedit.h"
+#include "Objc/Objc.h"
+#include "OutputWriter.h"
+#include "Slide.h"
+#include "Stubs/Stubs.h"
+#include <Provider/Validator.h>
+#include <cstring>
+
+using namespace DyldExtractor;
+using namespace Converter;
+
+template <class A>
+void Converter::runStages(Utils::ExtractionContext<A> &eCtx,
+                          const ExtractionOptions &options,
+                          const StageRunner &runner) {
+  auto run = [&runner](const char *stage, const std::function<void()> &func) {
+    if (runner) {
+      runner(stage, func);
+    } else {
+      func();
+    }
+  };
+
+  if (options.processSlideInfo) {
+    run("processSlideInfo", [&]() { processSlideInfo(eCtx); });
+  }
+  if (options.optimizeLinkedit) {
+    run("optimizeLinkedit", [&]() { optimizeLinkedit(eCtx); });
+  }
+  if (options.fixStubs) {
+    run("fixStubs", [&]() { fixStubs(eCtx); });
+  }
+  if (options.fixObjc) {
+    run("fixObjc", [&]() { fixObjc(eCtx); });
+  }
+  if (options.generateMetadata) {
+    run("generateMetadata", [&]() { generateMetadata(eCtx); });
+  }
+
+  if (options.imbedVersion) {
+    if constexpr (!std::is_same_v<typename A::P, Utils::Arch::Pointer64>) {
+      SPDLOG_LOGGER_ERROR(
+          eCtx.logger, "Unable to imbed version info in a non 64 bit image.");
+    } else {
+      eCtx.mCtx->header->reserved = *options.imbedVersion;
+    }
+  }
+}
+
+template <class A>
+ExtractedImage<A>::ExtractedImage(const Dyld::Context &dCtx,
+                                  Provider::Accelerator<P> &accelerator,
+                                  const dyld_cache_image_info *imageInfo,
+                                  const ExtractionOptions &options,
+                                  std::ostream *logStream)
+    : nullStream(nullptr),
+      mCtx(dCtx.createMachoCtx<false, P>(imageInfo)),
+      activity(std::string("DyldEx_") +
+                   (const char *)(dCtx.file + imageInfo->pathFileOffset),
+               logStream ? *logStream : nullStream, false),
+      eCtx(dCtx, mCtx, accelerator, activity) {
+  Provider::Validator<P>(mCtx).validate();
+
+  auto logger = activity.getLogger();
+  logger->set_pattern("[%-8l %s:%#] %v");
+  logger->set_level(options.verbose ? spdlog::level::trace
+                                    : spdlog::level::info);
+  if (options.lazySymbols && options.threads > 1) {
+    throw std::runtime_error(
+        "Lazy symbols can't be used with more than one thread.");
+  }
+  eCtx.threads = options.threads;
+  eCtx.lazySymbols = options.lazySymbols;
+  eCtx.optimizeOpcodes = options.optimizeOpcodes;
+
+  runStages(eCtx, options);
+  plan = planOutput(eCtx);
+}
+
+template <class A>
+const std::vector<OffsetWriteProcedure> &
+ExtractedImage<A>::getProcedures() const {
+  return plan.procedures;
+}
+
+template <class A> const OutputPlan &ExtractedImage<A>::getPlan() const {
+  return plan;
+}
+
+template <class A> uint64_t ExtractedImage<A>::size() const {
+  return plan.fileSize;
+}
+
+template <class A> void ExtractedImage<A>::copyTo(uint8_t *dest) const {
+  std::vector<FileBuffer> buffers;
+  getFileBuffers(plan, buffers);
+  for (const auto &[data, size] : buffers) {
+    memcpy(dest, data, size);
+    dest += size;
+  }
+}
+
+template <class A> std::vector<uint8_t> ExtractedImage<A>::getBuffer() const {
+  std::vector<uint8_t> buffer(plan.fileSize);
+  copyTo(buffer.data());
+  return buffer;
+}
+
+#define X(T)                                                                   \
+  template void Converter::runStages<T>(Utils::ExtractionContext<T> & eCtx,   \
+                                        const ExtractionOptions &options,      \
+                                        const StageRunner &runner);            \
+  template class Converter::ExtractedImage<T>;
+X(Utils::Arch::x86_64)
+X(Utils::Arch::arm)
+X(Utils::Arch::arm64)
+X(Utils::Arch::arm64_32)
+#undef X
@@ -0,0 +1,97 @@
+#ifndef __CONVERTER_EXTRACTOR__
+#define __CONVERTER_EXTRACTOR__
+
+#include "OffsetOptimizer.h"
+#include <Utils/ExtractionContext.h>
+#include <functional>
+#include <optional>
+#include <ostream>
+
+namespace DyldExtractor::Converter {
+
+/// @brief The stages to run on an image, and how to run them.
+struct ExtractionOptions {
+  bool processSlideInfo = true;
+  bool optimizeLinkedit = true;
+  bool fixStubs = true;
+  bool fixObjc = true;
+  bool generateMetadata = true;
+
+  /// A value for the reserved field of the header, only for 64 bit images.
+  std::optional<uint32_t> imbedVersion;
+  /// The number of threads to use within the image.
+  unsigned int threads = 1;
+  /// Only read the symbols that the stages look up, needs one thread.
+  bool lazySymbols = false;
+  /// Pick the smallest rebase and bind opcodes, which is slower.
+  bool optimizeOpcodes = false;
+  /// Enables debug logging messages.
+  bool verbose = false;
+};
+
+/// @brief Wraps a stage, like for profiling it. It must call run once.
+using StageRunner =
+    std::function<void(const char *stage, const std::function<void()> &run)>;
+
+/// @brief Run the conversion stages on an image.
+///
+/// Runs every enabled stage up to optimizeOffsets, which makes the image
+/// ready to be laid out.
+///
+/// @param eCtx The extraction context of the image.
+/// @param options The stages to run.
+/// @param runner Called for each stage, or nullptr to run them directly.
+template <class A>
+void runStages(Utils::ExtractionContext<A> &eCtx,
+               const ExtractionOptions &options,
+               const StageRunner &runner = nullptr);
+
+/// @brief An image extracted into memory.
+///
+/// The image is validated and extracted on construction, without using the
+/// filesystem. It has its own writable macho context, and the procedures
+/// point into memory owned by the image, so they are valid for its lifetime.
+template <class A> class ExtractedImage {
+  using P = A::P;
+
+public:
+  /// @brief Extract an image, throws if it fails validation.
+  /// @param dCtx The cache containing the image.
+  /// @param accelerator Shared between images of the cache.
+  /// @param imageInfo The image to extract.
+  /// @param options The stages to run.
+  /// @param logStream Receives the logs of the image, discarded if nullptr.
+  ExtractedImage(const Dyld::Context &dCtx,
+                 Provider::Accelerator<P> &accelerator,
+                 const dyld_cache_image_info *imageInfo,
+                 const ExtractionOptions &options = {},
+                 std::ostream *logStream = nullptr);
+  ExtractedImage(const ExtractedImage &) = delete;
+  ExtractedImage &operator=(const ExtractedImage &) = delete;
+
+  /// @brief The parts of the image, like from optimizeOffsets.
+  const std::vector<OffsetWriteProcedure> &getProcedures() const;
+
+  /// @brief The layout of the image as a file.
+  const OutputPlan &getPlan() const;
+
+  /// @brief The size of the image as a file.
+  uint64_t size() const;
+
+  /// @brief Copy the image into a buffer of at least size bytes.
+  void copyTo(uint8_t *dest) const;
+
+  /// @brief Copy the image into a new buffer.
+  std::vector<uint8_t> getBuffer() const;
+
+private:
+  std::ostream nullStream;
+  Macho::Context<false, P> mCtx;
+  Provider::ActivityLogger activity;
+  Utils::ExtractionContext<A> eCtx;
+  OutputPlan plan;
+};
+
+} // namespace DyldExtractor::Converter
+
+#endif // __CONVERTER_EXTRACTOR__
@@ -1,8 +1,13 @@
 #include "BindingV1.h"
+#include "OpcodeRuns.h"
 
 #include <Utils/Leb128.h>
+#include <Utils/ScratchPool.h>
+#include <Utils/Threading.h>
 #include <Utils/Utils.h>
 
+#define BINDING_MIN_RECORDS_PER_THREAD 4096
+
 using namespace DyldExtractor;
 using namespace Converter;
 using namespace Linkedit;
@@ -50,17 +55,8 @@ struct binding_tmp {
   const char *name;
 };
 
-template <class P>
-std::vector<uint8_t>
-Encoder::encodeBindingV1(std::vector<BindingV1Info> &info,
-                         const Macho::Context<false, P> &mCtx) {
-  using PtrT = P::PtrT;
-
-  // sort by library, symbol, type, then address
-  std::sort(info.begin(), info.end());
-
-  // convert to temp encoding that can be more easily optimized
-  std::vector<binding_tmp> mid;
+/// The state of the intermediate encoding between records.
+struct EncoderState {
   uint64_t curSegStart = 0;
   uint64_t curSegEnd = 0;
   uint32_t curSegIndex = 0;
@@ -69,64 +65,189 @@ Encoder::encodeBindingV1(std::vector<BindingV1Info> &info,
   uint8_t type = 0;
   uint64_t address = (uint64_t)(-1);
   int64_t addend = 0;
-  for (auto it = info.begin(); it != info.end(); ++it) {
-    if (ordinal != it->_libraryOrdinal) {
+
+  /// @brief Set the current segment to the one containing the address.
+  template <class P>
+  bool findSegment(const Macho::Context<false, P> &mCtx, uint64_t addr) {
+    for (int segI = 0; segI < mCtx.segments.size(); segI++) {
+      const auto &seg = mCtx.segments.at(segI);
+
+      if ((addr >= seg.command->vmaddr) &&
+          (addr < (seg.command->vmaddr + seg.command->vmsize))) {
+        curSegStart = seg.command->vmaddr;
+        curSegEnd = seg.command->vmaddr + seg.command->vmsize;
+        curSegIndex = segI;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /// @brief Get the state left by encoding the records before an index.
+  ///
+  /// Everything but the segment is set by the previous record. The segment
+  /// is only looked up when the address changes, so it's the one containing
+  /// the last record that changed the address.
+  template <class P>
+  static EncoderState before(const Macho::Context<false, P> &mCtx,
+                             const std::vector<BindingV1Info> &info,
+                             std::size_t index) {
+    EncoderState state;
+    if (!index) {
+      return state;
+    }
+
+    const auto &prev = info[index - 1];
+    state.ordinal = prev._libraryOrdinal;
+    state.symbolName = prev._symbolName;
+    state.type = prev._type;
+    state.address = prev._address + sizeof(typename P::PtrT);
+    state.addend = prev._addend;
+
+    std::size_t changeI = index - 1;
+    while (changeI &&
+           info[changeI]._address ==
+               info[changeI - 1]._address + sizeof(typename P::PtrT)) {
+      changeI--;
+    }
+    state.findSegment(mCtx, info[changeI]._address);
+    return state;
+  }
+};
+
+/// @brief Convert records to the intermediate encoding.
+template <class P>
+void encodeIntermediate(const Macho::Context<false, P> &mCtx,
+                        std::vector<BindingV1Info>::const_iterator begin,
+                        std::vector<BindingV1Info>::const_iterator end,
+                        EncoderState state, std::vector<binding_tmp> &out) {
+  for (auto it = begin; it != end; ++it) {
+    if (state.ordinal != it->_libraryOrdinal) {
       if (it->_libraryOrdinal <= 0) {
         // special lookups are encoded as negative numbers in BindingInfo
-        mid.push_back(binding_tmp(BIND_OPCODE_SET_DYLIB_SPECIAL_IMM,
+        out.push_back(binding_tmp(BIND_OPCODE_SET_DYLIB_SPECIAL_IMM,
                                   it->_libraryOrdinal));
       } else {
-        mid.push_back(binding_tmp(BIND_OPCODE_SET_DYLIB_ORDINAL_ULEB,
+        out.push_back(binding_tmp(BIND_OPCODE_SET_DYLIB_ORDINAL_ULEB,
                                   it->_libraryOrdinal));
       }
-      ordinal = it->_libraryOrdinal;
+      state.ordinal = it->_libraryOrdinal;
     }
-    if (symbolName != it->_symbolName) {
-      mid.push_back(binding_tmp(BIND_OPCODE_SET_SYMBOL_TRAILING_FLAGS_IMM,
+    if (state.symbolName != it->_symbolName) {
+      out.push_back(binding_tmp(BIND_OPCODE_SET_SYMBOL_TRAILING_FLAGS_IMM,
                                 it->_flags, 0, it->_symbolName));
-      symbolName = it->_symbolName;
+      state.symbolName = it->_symbolName;
     }
-    if (type != it->_type) {
-      mid.push_back(binding_tmp(BIND_OPCODE_SET_TYPE_IMM, it->_type));
-      type = it->_type;
+    if (state.type != it->_type) {
+      out.push_back(binding_tmp(BIND_OPCODE_SET_TYPE_IMM, it->_type));
+      state.type = it->_type;
     }
-    if (address != it->_address) {
-      if ((it->_address < curSegStart) || (it->_address >= curSegEnd)) {
-
-        // Find segment containing address
-        bool found = false;
-        for (int segI = 0; segI < mCtx.segments.size(); segI++) {
-          const auto &seg = mCtx.segments.at(segI);
-
-          if ((it->_address >= seg.command->vmaddr) &&
-              (it->_address < (seg.command->vmaddr + seg.command->vmsize))) {
-            curSegStart = seg.command->vmaddr;
-            curSegEnd = seg.command->vmaddr + seg.command->vmsize;
-            curSegIndex = segI;
-            found = true;
-            break;
-          }
-        }
-        if (!found)
+    if (state.address != it->_address) {
+      if ((it->_address < state.curSegStart) ||
+          (it->_address >= state.curSegEnd)) {
+        if (!state.findSegment(mCtx, it->_address))
           throw "binding address outside range of any segment";
 
-        mid.push_back(binding_tmp(BIND_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB,
-                                  curSegIndex, it->_address - curSegStart));
+        out.push_back(binding_tmp(BIND_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB,
+                                  state.curSegIndex,
+                                  it->_address - state.curSegStart));
       } else {
-        mid.push_back(
-            binding_tmp(BIND_OPCODE_ADD_ADDR_ULEB, it->_address - address));
+        out.push_back(binding_tmp(BIND_OPCODE_ADD_ADDR_ULEB,
+                                  it->_address - state.address));
       }
-      address = it->_address;
+      state.address = it->_address;
     }
-    if (addend != it->_addend) {
-      mid.push_back(binding_tmp(BIND_OPCODE_SET_ADDEND_SLEB, it->_addend));
-      addend = it->_addend;
+    if (state.addend != it->_addend) {
+      out.push_back(binding_tmp(BIND_OPCODE_SET_ADDEND_SLEB, it->_addend));
+      state.addend = it->_addend;
     }
-    mid.push_back(binding_tmp(BIND_OPCODE_DO_BIND, 0));
-    address += sizeof(PtrT);
+    out.push_back(binding_tmp(BIND_OPCODE_DO_BIND, 0));
+    state.address += sizeof(typename P::PtrT);
   }
-  mid.push_back(binding_tmp(BIND_OPCODE_DONE, 0));
+}
+
+/// @brief Convert intermediate opcodes to the compressed encoding.
+void encodeOpcodes(std::vector<binding_tmp>::const_iterator begin,
+                   std::vector<binding_tmp>::const_iterator end,
+                   std::vector<uint8_t> &out) {
+  bool done = false;
+  for (auto it = begin; !done && it != end; ++it) {
+    switch (it->opcode) {
+    case BIND_OPCODE_DONE:
 
+      done = true;
+      break;
+    case BIND_OPCODE_SET_DYLIB_ORDINAL_IMM:
+
+      out.push_back(
+          (uint8_t)(BIND_OPCODE_SET_DYLIB_ORDINAL_IMM | it->operand1));
+      break;
+    case BIND_OPCODE_SET_DYLIB_ORDINAL_ULEB:
+
+      out.push_back(BIND_OPCODE_SET_DYLIB_ORDINAL_ULEB);
+      Utils::appendUleb128(out, it->operand1);
+      break;
+    case BIND_OPCODE_SET_DYLIB_SPECIAL_IMM:
+
+      out.push_back((uint8_t)(BIND_OPCODE_SET_DYLIB_SPECIAL_IMM |
+                              (it->operand1 & BIND_IMMEDIATE_MASK)));
+      break;
+    case BIND_OPCODE_SET_SYMBOL_TRAILING_FLAGS_IMM:
+
+      out.push_back(
+          (uint8_t)(BIND_OPCODE_SET_SYMBOL_TRAILING_FLAGS_IMM | it->operand1));
+      for (const char *s = it->name; *s != '\0'; ++s) {
+        out.push_back(*s);
+      }
+      out.push_back('\0');
+      break;
+    case BIND_OPCODE_SET_TYPE_IMM:
+
+      out.push_back((uint8_t)(BIND_OPCODE_SET_TYPE_IMM | it->operand1));
+      break;
+    case BIND_OPCODE_SET_ADDEND_SLEB:
+
+      out.push_back(BIND_OPCODE_SET_ADDEND_SLEB);
+      Utils::appendSleb128(out, it->operand1);
+      break;
+    case BIND_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB:
+
+      out.push_back(
+          (uint8_t)(BIND_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB | it->operand1));
+      Utils::appendUleb128(out, it->operand2);
+      break;
+    case BIND_OPCODE_ADD_ADDR_ULEB:
+
+      out.push_back(BIND_OPCODE_ADD_ADDR_ULEB);
+      Utils::appendUleb128(out, it->operand1);
+      break;
+    case BIND_OPCODE_DO_BIND:
+
+      out.push_back(BIND_OPCODE_DO_BIND);
+      break;
+    case BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB:
+
+      out.push_back(BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB);
+      Utils::appendUleb128(out, it->operand1);
+      break;
+    case BIND_OPCODE_DO_BIND_ADD_ADDR_IMM_SCALED:
+
+      out.push_back(
+          (uint8_t)(BIND_OPCODE_DO_BIND_ADD_ADDR_IMM_SCALED | it->operand1));
+      break;
+    case BIND_OPCODE_DO_BIND_ULEB_TIMES_SKIPPING_ULEB:
+
+      out.push_back(BIND_OPCODE_DO_BIND_ULEB_TIMES_SKIPPING_ULEB);
+      Utils::appendUleb128(out, it->operand1);
+      Utils::appendUleb128(out, it->operand2);
+      break;
+    }
+  }
+
+}
+
+/// @brief Compress the intermediate encoding with fixed patterns.
+void compressRuns(std::vector<binding_tmp> &mid) {
   // optimize phase 1, combine bind/add pairs
   binding_tmp *dst = &mid[0];
   for (const binding_tmp *src = &mid[0]; src->opcode != BIND_OPCODE_DONE;
@@ -169,107 +290,210 @@ Encoder::encodeBindingV1(std::vector<BindingV1Info> &info,
     }
   }
   dst->opcode = BIND_OPCODE_DONE;
+}
 
-  // optimize phase 3, use immediate encodings
-  for (binding_tmp *p = &mid[0]; p->opcode != REBASE_OPCODE_DONE; ++p) {
-    if ((p->opcode == BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB) &&
-        (p->operand1 < (15 * sizeof(PtrT))) &&
-        ((p->operand1 % sizeof(PtrT)) == 0)) {
-      p->opcode = BIND_OPCODE_DO_BIND_ADD_ADDR_IMM_SCALED;
-      p->operand1 = p->operand1 / sizeof(PtrT);
-    } else if ((p->opcode == BIND_OPCODE_SET_DYLIB_ORDINAL_ULEB) &&
-               (p->operand1 <= 15)) {
-      p->opcode = BIND_OPCODE_SET_DYLIB_ORDINAL_IMM;
-    }
-  }
-  dst->opcode = BIND_OPCODE_DONE;
-
-  // convert to compressed encoding
-  std::vector<uint8_t> encodedData;
-  encodedData.reserve(info.size() * 2);
-
-  bool done = false;
-  for (auto it = mid.begin(); !done && it != mid.end(); ++it) {
-    switch (it->opcode) {
-    case BIND_OPCODE_DONE:
-
-      done = true;
-      break;
-    case BIND_OPCODE_SET_DYLIB_ORDINAL_IMM:
+/// @brief Encode the addresses of each run with the cheapest opcodes.
+///
+/// A run is the binds between opcodes that set the symbol, ordinal, type,
+/// addend, or segment. Runs that can't be encoded, like with overlapping
+/// binds, are kept as they are.
+///
+/// @param mid The unoptimized intermediate encoding.
+/// @param out Receives the optimized intermediate encoding.
+template <class P>
+void optimizeRuns(const std::vector<binding_tmp> &mid,
+                  std::vector<binding_tmp> &out) {
+  using PtrT = P::PtrT;
 
-      encodedData.push_back(
-          (uint8_t)(BIND_OPCODE_SET_DYLIB_ORDINAL_IMM | it->operand1));
-      break;
-    case BIND_OPCODE_SET_DYLIB_ORDINAL_ULEB:
+  // The sizes after immediate encodings are used. There is no opcode for
+  // packed binds, they are a skipping run without a skip.
+  struct Costs {
+    uint64_t gap(uint64_t bytes) const {
+      return 1 + Utils::uleb128Size(bytes);
+    }
+    uint64_t single(uint64_t skip) const {
+      if (skip < (15 * sizeof(PtrT)) && (skip % sizeof(PtrT)) == 0) {
+        return 1;
+      }
+      return 1 + Utils::uleb128Size(skip);
+    }
+    uint64_t times(uint64_t) const { return RUN_UNREACHABLE; }
+    uint64_t skipping(uint64_t count, uint64_t skip) const {
+      return 1 + Utils::uleb128Size(count) + Utils::uleb128Size(skip);
+    }
+  };
 
-      encodedData.push_back(BIND_OPCODE_SET_DYLIB_ORDINAL_ULEB);
-      Utils::appendUleb128(encodedData, it->operand1);
-      break;
-    case BIND_OPCODE_SET_DYLIB_SPECIAL_IMM:
+  auto addrsLease = Utils::ScratchPool<uint64_t>::local().borrow();
+  auto stepsLease = Utils::ScratchPool<RunStep>::local().borrow();
+  auto &addrs = *addrsLease;
+  auto &steps = *stepsLease;
 
-      encodedData.push_back((uint8_t)(BIND_OPCODE_SET_DYLIB_SPECIAL_IMM |
-                                      (it->operand1 & BIND_IMMEDIATE_MASK)));
-      break;
-    case BIND_OPCODE_SET_SYMBOL_TRAILING_FLAGS_IMM:
+  std::size_t runStart = 0;
+  uint64_t address = 0;
+  auto flush = [&](std::size_t runEnd) {
+    if (addrs.empty()) {
+      out.insert(out.end(), mid.begin() + runStart, mid.begin() + runEnd);
+      address = 0;
+      return;
+    }
 
-      encodedData.push_back(
-          (uint8_t)(BIND_OPCODE_SET_SYMBOL_TRAILING_FLAGS_IMM | it->operand1));
-      for (const char *s = it->name; *s != '\0'; ++s) {
-        encodedData.push_back(*s);
+    // The first move can be back, the rest of the run is sorted
+    const auto first = addrs.front();
+    for (auto &addr : addrs) {
+      addr -= first;
+    }
+    if (cheapestRun(addrs, address - first, sizeof(PtrT), Costs(), steps) ==
+        RUN_UNREACHABLE) {
+      out.insert(out.end(), mid.begin() + runStart, mid.begin() + runEnd);
+    } else {
+      if (first) {
+        out.push_back(binding_tmp(BIND_OPCODE_ADD_ADDR_ULEB, first));
       }
-      encodedData.push_back('\0');
-      break;
-    case BIND_OPCODE_SET_TYPE_IMM:
+      for (const auto &step : steps) {
+        if (step.kind == RunStep::Kind::Skipping) {
+          out.push_back(
+              binding_tmp(BIND_OPCODE_DO_BIND_ULEB_TIMES_SKIPPING_ULEB,
+                          step.count, step.skip));
+        } else if (step.skip) {
+          out.push_back(
+              binding_tmp(BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB, step.skip));
+        } else {
+          out.push_back(binding_tmp(BIND_OPCODE_DO_BIND, 0));
+        }
+        if (step.gap) {
+          out.push_back(binding_tmp(BIND_OPCODE_ADD_ADDR_ULEB, step.gap));
+        }
+      }
+    }
 
-      encodedData.push_back((uint8_t)(BIND_OPCODE_SET_TYPE_IMM | it->operand1));
-      break;
-    case BIND_OPCODE_SET_ADDEND_SLEB:
+    addrs.clear();
+    address = 0;
+  };
 
-      encodedData.push_back(BIND_OPCODE_SET_ADDEND_SLEB);
-      Utils::appendSleb128(encodedData, it->operand1);
-      break;
-    case BIND_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB:
+  out.reserve(mid.size());
+  std::size_t i = 0;
+  for (; mid[i].opcode != BIND_OPCODE_DONE; i++) {
+    const auto &op = mid[i];
+    if (op.opcode == BIND_OPCODE_ADD_ADDR_ULEB) {
+      address += op.operand1;
+    } else if (op.opcode == BIND_OPCODE_DO_BIND) {
+      addrs.push_back(address);
+      address += sizeof(PtrT);
+    } else {
+      flush(i);
+      out.push_back(op);
+      runStart = i + 1;
+    }
+  }
+  flush(i);
+  out.push_back(binding_tmp(BIND_OPCODE_DONE, 0));
+}
 
-      encodedData.push_back(
-          (uint8_t)(BIND_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB | it->operand1));
-      Utils::appendUleb128(encodedData, it->operand2);
-      break;
-    case BIND_OPCODE_ADD_ADDR_ULEB:
+template <class P>
+void Encoder::encodeBindingV1(std::vector<BindingV1Info> &info,
+                              const Macho::Context<false, P> &mCtx,
+                              std::vector<uint8_t> &encodedData,
+                              unsigned int threads, bool optimize) {
+  using PtrT = P::PtrT;
 
-      encodedData.push_back(BIND_OPCODE_ADD_ADDR_ULEB);
-      Utils::appendUleb128(encodedData, it->operand1);
-      break;
-    case BIND_OPCODE_DO_BIND:
+  // sort by library, symbol, type, then address
+  std::sort(info.begin(), info.end());
 
-      encodedData.push_back(BIND_OPCODE_DO_BIND);
-      break;
-    case BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB:
+  // convert to temp encoding that can be more easily optimized. Each chunk
+  // starts with the state left by the records before it, so the result is
+  // the same as converting in one pass.
+  // Scratch buffers are borrowed and given back on this thread, the chunks
+  // only fill them.
+  auto &midPool = Utils::ScratchPool<binding_tmp>::local();
+  auto midLease = midPool.borrow();
+  auto &mid = *midLease;
+  {
+    const auto chunks = Utils::chunkCount(threads, info.size(),
+                                          BINDING_MIN_RECORDS_PER_THREAD);
+    std::vector<Utils::ScratchPool<binding_tmp>::Lease> chunkMids;
+    chunkMids.reserve(chunks);
+    for (std::size_t i = 0; i < chunks; i++) {
+      chunkMids.push_back(midPool.borrow());
+    }
+    Utils::parallelChunks(
+        chunks, info.size(),
+        [&](std::size_t chunkI, std::size_t begin, std::size_t end) {
+          auto &out = *chunkMids[chunkI];
+          out.reserve((end - begin) * 2);
+          encodeIntermediate(mCtx, info.cbegin() + begin, info.cbegin() + end,
+                             EncoderState::before(mCtx, info, begin), out);
+        });
 
-      encodedData.push_back(BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB);
-      Utils::appendUleb128(encodedData, it->operand1);
-      break;
-    case BIND_OPCODE_DO_BIND_ADD_ADDR_IMM_SCALED:
+    std::size_t midSize = 1;
+    for (auto &chunkMid : chunkMids) {
+      midSize += chunkMid->size();
+    }
+    mid.reserve(midSize);
+    for (auto &chunkMid : chunkMids) {
+      mid.insert(mid.end(), chunkMid->begin(), chunkMid->end());
+    }
+  }
+  mid.push_back(binding_tmp(BIND_OPCODE_DONE, 0));
 
-      encodedData.push_back(
-          (uint8_t)(BIND_OPCODE_DO_BIND_ADD_ADDR_IMM_SCALED | it->operand1));
-      break;
-    case BIND_OPCODE_DO_BIND_ULEB_TIMES_SKIPPING_ULEB:
+  if (optimize) {
+    auto optimizedLease = midPool.borrow();
+    optimizeRuns<P>(mid, *optimizedLease);
+    mid.swap(*optimizedLease);
+  } else {
+    compressRuns(mid);
+  }
 
-      encodedData.push_back(BIND_OPCODE_DO_BIND_ULEB_TIMES_SKIPPING_ULEB);
-      Utils::appendUleb128(encodedData, it->operand1);
-      Utils::appendUleb128(encodedData, it->operand2);
-      break;
+  // optimize phase 3, use immediate encodings
+  for (binding_tmp *p = &mid[0]; p->opcode != REBASE_OPCODE_DONE; ++p) {
+    if ((p->opcode == BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB) &&
+        (p->operand1 < (15 * sizeof(PtrT))) &&
+        ((p->operand1 % sizeof(PtrT)) == 0)) {
+      p->opcode = BIND_OPCODE_DO_BIND_ADD_ADDR_IMM_SCALED;
+      p->operand1 = p->operand1 / sizeof(PtrT);
+    } else if ((p->opcode == BIND_OPCODE_SET_DYLIB_ORDINAL_ULEB) &&
+               (p->operand1 <= 15)) {
+      p->opcode = BIND_OPCODE_SET_DYLIB_ORDINAL_IMM;
     }
   }
 
+  // convert to compressed encoding, each opcode is encoded on its own
+  const std::size_t midCount =
+      std::find_if(mid.cbegin(), mid.cend(),
+                   [](const binding_tmp &tmp) {
+                     return tmp.opcode == BIND_OPCODE_DONE;
+                   }) -
+      mid.cbegin();
+  const auto chunks =
+      Utils::chunkCount(threads, midCount, BINDING_MIN_RECORDS_PER_THREAD);
+  // The first chunk is encoded straight into the output
+  auto &dataPool = Utils::ScratchPool<uint8_t>::local();
+  std::vector<Utils::ScratchPool<uint8_t>::Lease> chunkData;
+  chunkData.reserve(chunks - 1);
+  for (std::size_t i = 1; i < chunks; i++) {
+    chunkData.push_back(dataPool.borrow());
+  }
+  encodedData.clear();
+  Utils::parallelChunks(
+      chunks, midCount,
+      [&](std::size_t chunkI, std::size_t begin, std::size_t end) {
+        auto &out = chunkI ? *chunkData[chunkI - 1] : encodedData;
+        out.reserve((end - begin) * 2);
+        encodeOpcodes(mid.cbegin() + begin, mid.cbegin() + end, out);
+      });
+
+  for (auto &data : chunkData) {
+    encodedData.insert(encodedData.end(), data->begin(), data->end());
+  }
+
   // align to pointer size
   encodedData.resize(Utils::align(encodedData.size(), sizeof(PtrT)));
-  return encodedData;
 }
 
-template std::vector<uint8_t> Encoder::encodeBindingV1<Utils::Arch::Pointer32>(
+template void Encoder::encodeBindingV1<Utils::Arch::Pointer32>(
     std::vector<BindingV1Info> &info,
-    const Macho::Context<false, Utils::Arch::Pointer32> &mCtx);
-template std::vector<uint8_t> Encoder::encodeBindingV1<Utils::Arch::Pointer64>(
+    const Macho::Context<false, Utils::Arch::Pointer32> &mCtx,
+    std::vector<uint8_t> &encodedData, unsigned int threads, bool optimize);
+template void Encoder::encodeBindingV1<Utils::Arch::Pointer64>(
     std::vector<BindingV1Info> &info,
-    const Macho::Context<false, Utils::Arch::Pointer64> &mCtx);
+    const Macho::Context<false, Utils::Arch::Pointer64> &mCtx,
+    std::vector<uint8_t> &encodedData, unsigned int threads, bool optimize);
@@ -26,9 +26,20 @@ struct BindingV1Info {
   int operator<(const BindingV1Info &rhs) const;
 };
 
+/// @brief Encode binds as bind opcodes.
+/// @param info The binds, sorted in place.
+/// @param mCtx The macho context.
+/// @param encodedData Receives the opcodes, pointer aligned. It is cleared
+///   first, so a scratch buffer can be reused.
+/// @param threads The number of threads to encode with. The output is the
+///   same regardless of the number of threads.
+/// @param optimize Pick the smallest opcodes for each run of binds, instead
+///   of compressing fixed patterns.
 template <class P>
-std::vector<uint8_t> encodeBindingV1(std::vector<BindingV1Info> &info,
-                                     const Macho::Context<false, P> &mCtx);
+void encodeBindingV1(std::vector<BindingV1Info> &info,
+                     const Macho::Context<false, P> &mCtx,
+                     std::vector<uint8_t> &encodedData,
+                     unsigned int threads = 1, bool optimize = false);
 
 } // namespace DyldExtractor::Converter::Linkedit::Encoder
 
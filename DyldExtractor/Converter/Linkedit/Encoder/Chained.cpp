@@ -1,8 +1,12 @@
 #include "Chained.h"
 
 #include <Objc/Abstraction.h>
+#include <Utils/ScratchPool.h>
+#include <Utils/Threading.h>
 #include <Utils/Utils.h>
 
+#define CHAINED_MIN_PAGES_PER_THREAD 32
+
 using namespace DyldExtractor;
 using namespace Converter;
 using namespace Linkedit;
@@ -89,8 +93,20 @@ void ChainedFixupBinds::forEachBind(EnumerationCallback callback) {
 
 ChainedEncoder::ChainedEncoder(Utils::ExtractionContext<A> &eCtx)
     : mCtx(*eCtx.mCtx), activity(*eCtx.activity), logger(eCtx.logger),
-      ptrTracker(eCtx.ptrTracker), exObjc(eCtx.exObjc),
-      leTracker(eCtx.leTracker.value()), stTracker(eCtx.stTracker.value()) {}
+      ptrTracker(eCtx.ptrTracker), leTracker(eCtx.leTracker.value()),
+      stTracker(eCtx.stTracker.value()), symbolStore(eCtx.symbolStore),
+      exObjc(eCtx.exObjc), threads(eCtx.threads) {}
+
+template <class F>
+void ChainedEncoder::parallelPages(std::size_t pageCount, F func) const {
+  const auto chunks =
+      Utils::chunkCount(threads, pageCount, CHAINED_MIN_PAGES_PER_THREAD);
+  Utils::parallelChunks(
+      chunks, pageCount,
+      [&func](std::size_t, std::size_t begin, std::size_t end) {
+        func(begin, end);
+      });
+}
 
 void ChainedEncoder::generateMetadata() {
   // Check Extra ObjC
@@ -99,11 +115,17 @@ void ChainedEncoder::generateMetadata() {
     return;
   }
 
-  // create the chained fixup info and Fixup pointers
+  // The maps are read from multiple threads
+  ptrTracker.freeze();
+
+  // create the chained fixup info, then fix up and chain pointers
   buildChainedFixupInfo();
   fixupPointers();
 
-  auto chainInfo = encodeChainedInfo();
+  // The data is copied into the linkedit, so a scratch buffer can hold it
+  auto chainInfoLease = Utils::ScratchPool<uint8_t>::local().borrow();
+  auto &chainInfo = *chainInfoLease;
+  encodeChainedInfo(chainInfo);
   auto chainInfoSize = (uint32_t)chainInfo.size();
 
   // Add lc to header, placed after the last segment
@@ -133,32 +155,13 @@ void ChainedEncoder::generateMetadata() {
         logger, "Not enough space in linkedit to insert chained fixup info.");
     return;
   }
-
-  // Chain pointers
-  applyChainedFixups();
-}
-
-void ChainedEncoder::fixupPointers() {
-  activity.update(std::nullopt, "Fixing pointers");
-
-  switch (chainedPointerFormat()) {
-  case DYLD_CHAINED_PTR_64_OFFSET:
-    fixup64();
-    break;
-
-  case DYLD_CHAINED_PTR_ARM64E:
-    fixup64e();
-    break;
-
-  default:
-    Utils::unreachable();
-  }
 }
 
 void ChainedEncoder::buildChainedFixupInfo() {
   const auto &ptrs = ptrTracker.getPointers();
   const auto &auths = ptrTracker.getAuths();
   const auto &binds = ptrTracker.getBinds();
+  const auto &addends = ptrTracker.getBindAddends();
 
   const auto pageSize = ptrTracker.getPageSize();
 
@@ -175,25 +178,21 @@ void ChainedEncoder::buildChainedFixupInfo() {
     seg.pageSize = pageSize;
     seg.pointerFormat = chainedPointerFormat();
 
-    // add all pointers
+    // add all pointers, pages end at the last page with a fixup
     auto beginPtrIt = ptrs.lower_bound((PtrT)segCmd->vmaddr);
     auto endPtrIt = ptrs.lower_bound((PtrT)segCmd->vmaddr + segCmd->vmsize);
-    for (auto it = beginPtrIt; it != endPtrIt; it++) {
-      if (!it->second && !binds.contains(it->first)) {
-        // Check if the target is null and there is no bind
-        continue;
-      }
-
-      uint64_t fixUpAddr = it->first;
-
-      uint64_t pageIndex = (fixUpAddr - seg.startAddr) / pageSize;
-      while (pageIndex >= seg.pages.size()) {
-        ChainedFixupPageInfo emptyPage;
-        seg.pages.push_back(emptyPage);
-      }
-      uint16_t pageOffset =
-          (uint16_t)(fixUpAddr - (seg.startAddr + pageIndex * pageSize));
-      seg.pages[pageIndex].fixupOffsets.push_back(pageOffset);
+    auto isFixup = [&binds](const auto &it) {
+      // Check if the target is null and there is no bind
+      return it->second || binds.contains(it->first);
+    };
+    auto lastPtrIt = endPtrIt;
+    while (lastPtrIt != beginPtrIt && !isFixup(lastPtrIt - 1)) {
+      lastPtrIt--;
+    }
+    if (lastPtrIt != beginPtrIt) {
+      // The starts of the chains are found when pointers are fixed up
+      seg.pages.resize(((lastPtrIt - 1)->first - seg.startAddr) / pageSize +
+                       1);
     }
 
     // Add all binds
@@ -210,18 +209,31 @@ void ChainedEncoder::buildChainedFixupInfo() {
         continue;
       }
 
-      const auto &sym = it->second->preferredSymbol();
+      const auto &sym = symbolStore.get(it->second).preferredSymbol();
       auto [atomIt, inserted] = atomMap.try_emplace(
           it->second, sym.name.c_str(), (uint32_t)sym.ordinal, false);
       bindToAtoms.try_emplace(bindAddr, &atomIt->second);
+
+      const bool isAuth = auths.contains((PtrT)bindAddr);
+      const auto addendIt = addends.find((PtrT)bindAddr);
+      const uint64_t addend =
+          addendIt != addends.end() ? (uint64_t)addendIt->second : 0;
+      if (addend) {
+        chainedFixupBinds.ensureTarget(&atomIt->second, isAuth, addend);
+        if (!isAuth) {
+          // Used if the addend can be stored in the pointer
+          chainedFixupBinds.ensureTarget(&atomIt->second, false, 0);
+        }
+      }
       if (inserted) {
-        chainedFixupBinds.ensureTarget(&atomIt->second,
-                                       auths.contains((PtrT)bindAddr), 0);
+        if (!addend) {
+          chainedFixupBinds.ensureTarget(&atomIt->second, isAuth, 0);
+        }
 
         /// Ghidra markup depends on there being an matching symbol in the
         /// symtab
         if (!stTracker.getStrings().contains(sym.name)) {
-          const auto &str = stTracker.addString(sym.name);
+          const auto str = stTracker.addString(sym.name);
           Macho::Loader::nlist<P> entry{};
           entry.n_type = 1;
           SET_LIBRARY_ORDINAL(entry.n_desc, (uint16_t)sym.ordinal);
@@ -235,13 +247,6 @@ void ChainedEncoder::buildChainedFixupInfo() {
     chainedFixupSegments.push_back(seg);
   }
 
-  // sort all fixups on each page, so chain can be built
-  for (ChainedFixupSegInfo &segInfo : chainedFixupSegments) {
-    for (ChainedFixupPageInfo &pageInfo : segInfo.pages) {
-      std::sort(pageInfo.fixupOffsets.begin(), pageInfo.fixupOffsets.end());
-    }
-  }
-
   // remember largest legal rebase target
   uint64_t baseAddress = 0;
   uint64_t maxRebaseAddress = 0;
@@ -266,9 +271,9 @@ void appendMem(std::vector<uint8_t> &data, void *mem, std::size_t size) {
   data.insert(data.end(), (uint8_t *)mem, (uint8_t *)mem + size);
 }
 
-std::vector<uint8_t> ChainedEncoder::encodeChainedInfo() {
+void ChainedEncoder::encodeChainedInfo(std::vector<uint8_t> &encodedData) {
   activity.update(std::nullopt, "Generating chained pointer info");
-  std::vector<uint8_t> encodedData;
+  encodedData.clear();
   encodedData.reserve(1024);
 
   uint16_t format = DYLD_CHAINED_IMPORT;
@@ -345,12 +350,9 @@ std::vector<uint8_t> ChainedEncoder::encodeChainedInfo() {
           (uint32_t)encodedData.size() - segsHeaderOffset;
       appendMem(encodedData, &aSeg,
                 offsetof(dyld_chained_starts_in_segment, page_start));
-      std::vector<uint16_t> segChainOverflows;
       for (ChainedFixupPageInfo &pageInfo : segInfo.pages) {
-        uint16_t startOffset = pageInfo.fixupOffsets.empty()
-                                   ? DYLD_CHAINED_PTR_START_NONE
-                                   : pageInfo.fixupOffsets.front();
-        appendMem(encodedData, &startOffset, sizeof(startOffset));
+        appendMem(encodedData, &pageInfo.startOffset,
+                  sizeof(pageInfo.startOffset));
       }
       if (segInfo.pointerFormat == DYLD_CHAINED_PTR_32) {
         // zero out chain overflow area
@@ -437,112 +439,36 @@ std::vector<uint8_t> ChainedEncoder::encodeChainedInfo() {
 
   // align to pointer size
   padToSize(encodedData, sizeof(PtrT));
-  return encodedData;
 }
 
-void ChainedEncoder::applyChainedFixups() {
-  activity.update(std::nullopt, "Chaining pointers");
-  // Firmware chains are not supported
-
-  // chain together fixups
-  uint32_t segIndex = 0;
-  for (ChainedFixupSegInfo &segInfo : chainedFixupSegments) {
-    activity.update();
-
-    uint8_t *segBufferStart;
-    if (strcmp(segInfo.name, SEG_OBJC_EXTRA) == 0) {
-      segBufferStart = exObjc->getData();
-    } else {
-      segBufferStart = mCtx.convertAddrP(segInfo.startAddr);
-    }
-
-    uint8_t *pageBufferStart = segBufferStart;
-    uint32_t pageIndex = 0;
-    uint32_t nextOverflowSlot = (uint32_t)segInfo.pages.size();
-    for (ChainedFixupPageInfo &pageInfo : segInfo.pages) {
-
-      uint8_t *prevLoc = nullptr;
-      for (uint16_t pageOffset : pageInfo.fixupOffsets) {
-        uint8_t *loc = (uint8_t *)pageBufferStart + pageOffset;
-
-        if (prevLoc != nullptr) {
-          uint64_t delta = (uint8_t *)loc - (uint8_t *)prevLoc;
-          switch (segInfo.pointerFormat) {
-          case DYLD_CHAINED_PTR_ARM64E:
-          case DYLD_CHAINED_PTR_ARM64E_USERLAND:
-          case DYLD_CHAINED_PTR_ARM64E_USERLAND24:
-            ((dyld_chained_ptr_arm64e_rebase *)prevLoc)->next = delta / 8;
-            assert((((dyld_chained_ptr_arm64e_rebase *)prevLoc)->next * 8) ==
-                       delta &&
-                   "next out of range");
-            break;
-          case DYLD_CHAINED_PTR_ARM64E_KERNEL:
-          case DYLD_CHAINED_PTR_ARM64E_FIRMWARE:
-            ((dyld_chained_ptr_arm64e_rebase *)prevLoc)->next = delta / 4;
-            assert((((dyld_chained_ptr_arm64e_rebase *)prevLoc)->next * 4) ==
-                       delta &&
-                   "next out of range");
-            break;
-          case DYLD_CHAINED_PTR_64:
-          case DYLD_CHAINED_PTR_64_OFFSET:
-            ((dyld_chained_ptr_64_rebase *)prevLoc)->next = delta / 4;
-            assert((((dyld_chained_ptr_64_rebase *)prevLoc)->next * 4) ==
-                       delta &&
-                   "next out of range");
-            break;
-          case DYLD_CHAINED_PTR_32:
-            // chain32bitPointers((dyld_chained_ptr_32_rebase *)prevLoc,
-            //                    (dyld_chained_ptr_32_rebase *)loc, segInfo,
-            //                    pageBufferStart, pageIndex);
-            assert(!"32bit pointers are not supported");
-            break;
-          default:
-            assert(0 && "unknown pointer format");
-          }
-        }
-        prevLoc = loc;
-      }
-      if (!pageInfo.chainOverflows.empty()) {
-        uint8_t *chainHeader = NULL;
-        if (auto metaIt = leTracker.findTag(LETrackerTag::chained);
-            metaIt != leTracker.metadataEnd()) {
-          chainHeader = metaIt->data;
-        } else {
-          assert(!"Chained data was not added to the linkedit.");
-        }
-
-        dyld_chained_fixups_header *header =
-            (dyld_chained_fixups_header *)chainHeader;
-        dyld_chained_starts_in_image *chains =
-            (dyld_chained_starts_in_image *)((uint8_t *)header +
-                                             header->starts_offset);
-        dyld_chained_starts_in_segment *segChains =
-            (dyld_chained_starts_in_segment
-                 *)((uint8_t *)chains + chains->seg_info_offset[segIndex]);
-        uint32_t maxOverFlowCount =
-            (segChains->size - offsetof(dyld_chained_starts_in_segment,
-                                        page_start[segChains->page_count])) /
-            sizeof(uint16_t);
-        for (uint16_t extraStart : pageInfo.chainOverflows) {
-          if ((segChains->page_start[pageIndex] &
-               DYLD_CHAINED_PTR_START_MULTI) == 0) {
-            uint16_t first = segChains->page_start[pageIndex];
-            segChains->page_start[pageIndex] =
-                DYLD_CHAINED_PTR_START_MULTI | nextOverflowSlot;
-            segChains->page_start[nextOverflowSlot++] = first;
-          }
-          if (extraStart == pageInfo.chainOverflows.back())
-            segChains->page_start[nextOverflowSlot++] =
-                extraStart | DYLD_CHAINED_PTR_START_LAST;
-          else
-            segChains->page_start[nextOverflowSlot++] = extraStart;
-        }
-        assert(nextOverflowSlot <= maxOverFlowCount);
-      }
-      pageBufferStart += segInfo.pageSize;
-      ++pageIndex;
-    }
-    ++segIndex;
+/// @brief Link a fixup to the next fixup on its page.
+static void chainTo(uint32_t pointerFormat, uint8_t *prevLoc, uint8_t *loc) {
+  uint64_t delta = (uint8_t *)loc - (uint8_t *)prevLoc;
+  switch (pointerFormat) {
+  case DYLD_CHAINED_PTR_ARM64E:
+  case DYLD_CHAINED_PTR_ARM64E_USERLAND:
+  case DYLD_CHAINED_PTR_ARM64E_USERLAND24:
+    ((dyld_chained_ptr_arm64e_rebase *)prevLoc)->next = delta / 8;
+    assert((((dyld_chained_ptr_arm64e_rebase *)prevLoc)->next * 8) == delta &&
+           "next out of range");
+    break;
+  case DYLD_CHAINED_PTR_ARM64E_KERNEL:
+  case DYLD_CHAINED_PTR_ARM64E_FIRMWARE:
+    ((dyld_chained_ptr_arm64e_rebase *)prevLoc)->next = delta / 4;
+    assert((((dyld_chained_ptr_arm64e_rebase *)prevLoc)->next * 4) == delta &&
+           "next out of range");
+    break;
+  case DYLD_CHAINED_PTR_64:
+  case DYLD_CHAINED_PTR_64_OFFSET:
+    ((dyld_chained_ptr_64_rebase *)prevLoc)->next = delta / 4;
+    assert((((dyld_chained_ptr_64_rebase *)prevLoc)->next * 4) == delta &&
+           "next out of range");
+    break;
+  case DYLD_CHAINED_PTR_32:
+    assert(!"32bit pointers are not supported");
+    break;
+  default:
+    assert(0 && "unknown pointer format");
   }
 }
 
@@ -559,199 +485,214 @@ uint16_t ChainedEncoder::chainedPointerFormat() const {
   }
 }
 
-void ChainedEncoder::fixup64() {
+void ChainedEncoder::fixupPointers() {
+  activity.update(std::nullopt, "Fixing pointers");
+
   const auto &ptrs = ptrTracker.getPointers();
   const auto &auths = ptrTracker.getAuths();
   const auto &binds = ptrTracker.getBinds();
+  const auto &addends = ptrTracker.getBindAddends();
+
+  const auto pageSize = ptrTracker.getPageSize();
+  const auto pointerFormat = chainedPointerFormat();
+
+  // Without addends in the imports table, binds store their addend
+  const bool inlineAddends = !chainedFixupBinds.hasLargeAddends() &&
+                             !chainedFixupBinds.hasHugeAddends();
 
   // get address of header
   uint64_t machHeaderAddr = mCtx.getSegment(SEG_TEXT)->command->vmaddr;
 
-  for (const auto &segCtx : mCtx.segments) {
+  std::mutex repointedMutex;
+  std::vector<std::pair<PtrT, PtrT>> repointed;
+
+  for (auto &seg : chainedFixupSegments) {
     activity.update();
-    const auto segCmd = segCtx.command;
 
-    // Get relevant pointers
-    uint64_t segAddr = segCmd->vmaddr;
     uint8_t *segData;
-    if (strcmp(segCmd->segname, SEG_OBJC_EXTRA) == 0) {
+    if (strcmp(seg.name, SEG_OBJC_EXTRA) == 0) {
       segData = exObjc->getData();
     } else {
-      segData = mCtx.convertAddrP(segCmd->vmaddr);
+      segData = mCtx.convertAddrP(seg.startAddr);
     }
 
-    auto beginIt = ptrs.lower_bound((PtrT)segAddr);
-    auto endIt = ptrs.lower_bound((PtrT)segAddr + segCmd->vmsize);
+    // Each pointer is encoded and linked to the previous fixup on its page in
+    // one pass. Chains never cross pages, so pages are done in parallel.
+    parallelPages(seg.pages.size(), [&](std::size_t beginPage,
+                                        std::size_t endPage) {
+      const uint64_t beginAddr = seg.startAddr + beginPage * pageSize;
+      const uint64_t endAddr =
+          std::min(seg.endAddr, seg.startAddr + endPage * pageSize);
+
+      // Auths and binds are subsets of the pointers, so they are walked along
+      // with them instead of being looked up.
+      auto authIt = auths.lower_bound((PtrT)beginAddr);
+      auto bindIt = binds.lower_bound((PtrT)beginAddr);
+      auto addendIt = addends.lower_bound((PtrT)beginAddr);
+      std::size_t pageIndex = beginPage;
+      uint8_t *prevLoc = nullptr;
+      for (auto it = ptrs.lower_bound((PtrT)beginAddr);
+           it != ptrs.end() && it->first < endAddr; it++) {
+        auto ptrAddr = it->first;
+        auto ptrTarget = it->second;
+        while (authIt != auths.end() && authIt->first < ptrAddr) {
+          authIt++;
+        }
+        while (bindIt != binds.end() && bindIt->first < ptrAddr) {
+          bindIt++;
+        }
+        const bool isAuth = authIt != auths.end() && authIt->first == ptrAddr;
+        const bool isBind = bindIt != binds.end() && bindIt->first == ptrAddr;
+        while (addendIt != addends.end() && addendIt->first < ptrAddr) {
+          addendIt++;
+        }
+        const uint64_t addend =
+            isBind && addendIt != addends.end() && addendIt->first == ptrAddr
+                ? (uint64_t)addendIt->second
+                : 0;
+        const bool inlineAddend = inlineAddends && !isAuth;
+
+        if (!ptrTarget && !isBind) {
+          continue;
+        }
+
+        // Check for out of bound pointer
+        if (ptrTarget &&                                     // Not nullptr
+            !isBind &&                                       // Not a bind
+            (!exObjc || ptrTarget < exObjc->getBaseAddr() || // Not in exObjc
+             ptrTarget >= exObjc->getEndAddr()) &&
+            !mCtx.containsAddr(ptrTarget)                    // Not in image
+        ) {
+          {
+            std::scoped_lock lock(repointedMutex);
+            repointed.emplace_back(ptrAddr, ptrTarget);
+          }
+          ptrTarget = (PtrT)machHeaderAddr;
+        }
 
-    for (auto it = beginIt; it != endIt; it++) {
-      auto ptrAddr = it->first;
-      auto ptrTarget = it->second;
+        auto fixUpLocation = segData + (ptrAddr - seg.startAddr);
+        const uint32_t bindOrdinal =
+            isBind ? chainedFixupBinds.ordinal(bindToAtoms.at(ptrAddr),
+                                               inlineAddend ? 0 : addend)
+                   : 0;
+        const uint64_t bindAddend = inlineAddend ? addend : 0;
+        if (pointerFormat == DYLD_CHAINED_PTR_ARM64E) {
+          fixup64e(fixUpLocation, ptrTarget, machHeaderAddr,
+                   isAuth ? &authIt->second : nullptr, isBind, bindOrdinal,
+                   bindAddend);
+        } else {
+          fixup64(fixUpLocation, ptrTarget, machHeaderAddr, isBind,
+                  bindOrdinal, bindAddend);
+        }
 
-      // Check for out of bound pointer
-      if (ptrTarget &&                                     // Not nullptr
-          !binds.contains(ptrAddr) &&                      // Not a bind
-          (!exObjc || ptrTarget < exObjc->getBaseAddr() || // Not in exObjc
-           ptrTarget >= exObjc->getEndAddr()) &&
-          !mCtx.containsAddr(ptrTarget)                    // Not in image
-      ) {
+        // Link to the previous fixup, or start the page's chain
+        const auto fixupPage = (ptrAddr - seg.startAddr) / pageSize;
+        if (prevLoc && fixupPage == pageIndex) {
+          chainTo(pointerFormat, prevLoc, fixUpLocation);
+        } else {
+          pageIndex = fixupPage;
+          seg.pages[pageIndex].startOffset =
+              (uint16_t)(ptrAddr - (seg.startAddr + pageIndex * pageSize));
+        }
+        prevLoc = fixUpLocation;
+      }
+    });
+
+    // Warnings are logged in order after the segment is done
+    /// TODO: Enable for arm64e
+    if (pointerFormat != DYLD_CHAINED_PTR_ARM64E) {
+      std::sort(repointed.begin(), repointed.end());
+      for (const auto &[ptrAddr, ptrTarget] : repointed) {
         SPDLOG_LOGGER_WARN(logger,
                            "Pointer target at {:#x} -> {:#x} is not within "
                            "MachO file, re-pointing to mach header.",
                            ptrAddr, ptrTarget);
-        ptrTarget = (PtrT)machHeaderAddr;
-      }
-
-      auto fixUpLocation = segData + (ptrAddr - segAddr);
-
-      if (binds.contains(ptrAddr)) {
-        auto bindOrdinal =
-            chainedFixupBinds.ordinal(bindToAtoms.at(ptrAddr), 0);
-
-        dyld_chained_ptr_64_bind *b = (dyld_chained_ptr_64_bind *)fixUpLocation;
-        b->bind = 1;
-        b->next =
-            0; // chained fixed up later once all fixup locations are known
-        b->reserved = 0;
-        b->addend = 0;
-        b->ordinal = bindOrdinal;
-        assert(b->ordinal == bindOrdinal);
-      } else {
-        if (!ptrTarget) {
-          continue;
-        }
-
-        uint64_t vmOffset = (ptrTarget - machHeaderAddr);
-        uint64_t high8 = vmOffset >> 56;
-        vmOffset &= 0x00FFFFFFFFFFFFFFULL;
-        dyld_chained_ptr_64_rebase *r =
-            (dyld_chained_ptr_64_rebase *)fixUpLocation;
-        r->bind = 0;
-        r->next =
-            0; // chained fixed up later once all fixup locations are known
-        r->reserved = 0;
-        r->high8 = high8;
-        r->target = vmOffset;
-        uint64_t reconstituted = (((uint64_t)(r->high8)) << 56) + r->target;
-        assert(reconstituted == (ptrTarget - machHeaderAddr));
       }
     }
+    repointed.clear();
   }
 }
 
-void ChainedEncoder::fixup64e() {
-  const auto &ptrs = ptrTracker.getPointers();
-  const auto &auths = ptrTracker.getAuths();
-  const auto &binds = ptrTracker.getBinds();
-
-  // get address of header
-  uint64_t machHeaderAddr = mCtx.getSegment(SEG_TEXT)->command->vmaddr;
-
-  for (const auto &segCtx : mCtx.segments) {
-    activity.update();
-    const auto segCmd = segCtx.command;
+void ChainedEncoder::fixup64(uint8_t *fixUpLocation, PtrT ptrTarget,
+                             uint64_t machHeaderAddr, bool isBind,
+                             uint32_t bindOrdinal, uint64_t bindAddend) {
+  if (isBind) {
+    dyld_chained_ptr_64_bind *b = (dyld_chained_ptr_64_bind *)fixUpLocation;
+    b->bind = 1;
+    b->next = 0; // chained to the next fixup when it is reached
+    b->reserved = 0;
+    b->addend = bindAddend;
+    assert(b->addend == bindAddend);
+    b->ordinal = bindOrdinal;
+    assert(b->ordinal == bindOrdinal);
+  } else {
+    uint64_t vmOffset = (ptrTarget - machHeaderAddr);
+    uint64_t high8 = vmOffset >> 56;
+    vmOffset &= 0x00FFFFFFFFFFFFFFULL;
+    dyld_chained_ptr_64_rebase *r =
+        (dyld_chained_ptr_64_rebase *)fixUpLocation;
+    r->bind = 0;
+    r->next = 0; // chained to the next fixup when it is reached
+    r->reserved = 0;
+    r->high8 = high8;
+    r->target = vmOffset;
+    uint64_t reconstituted = (((uint64_t)(r->high8)) << 56) + r->target;
+    assert(reconstituted == (ptrTarget - machHeaderAddr));
+  }
+}
 
-    // Get relevant pointers
-    uint64_t segAddr = segCmd->vmaddr;
-    uint8_t *segData;
-    if (strcmp(segCmd->segname, SEG_OBJC_EXTRA) == 0) {
-      segData = exObjc->getData();
+void ChainedEncoder::fixup64e(uint8_t *fixUpLocation, PtrT ptrTarget,
+                              uint64_t machHeaderAddr,
+                              const AuthData *authData, bool isBind,
+                              uint32_t bindOrdinal, uint64_t bindAddend) {
+  if (authData) {
+    if (isBind) {
+      dyld_chained_ptr_arm64e_auth_bind *b =
+          (dyld_chained_ptr_arm64e_auth_bind *)fixUpLocation;
+      b->auth = 1;
+      b->bind = 1;
+      b->next = 0;
+      b->key = authData->key;
+      b->addrDiv = authData->hasAddrDiv;
+      b->diversity = authData->diversity;
+      b->zero = 0;
+      b->ordinal = bindOrdinal;
+      assert(b->ordinal == bindOrdinal);
     } else {
-      segData = mCtx.convertAddrP(segCmd->vmaddr);
+      dyld_chained_ptr_arm64e_auth_rebase *r =
+          (dyld_chained_ptr_arm64e_auth_rebase *)fixUpLocation;
+      uint64_t vmOffset = (ptrTarget - machHeaderAddr);
+      r->auth = 1;
+      r->bind = 0;
+      r->next = 0;
+      r->key = authData->key;
+      r->addrDiv = authData->hasAddrDiv;
+      r->diversity = authData->diversity;
+      r->target = vmOffset & 0xFFFFFFFF;
+      assert(r->target == vmOffset);
     }
-
-    auto beginIt = ptrs.lower_bound((PtrT)segAddr);
-    auto endIt = ptrs.lower_bound((PtrT)segAddr + segCmd->vmsize);
-
-    for (auto it = beginIt; it != endIt; it++) {
-      auto ptrAddr = it->first;
-      auto ptrTarget = it->second;
-
-      // Check for out of bound pointer
-      if (ptrTarget &&                                     // Not nullptr
-          !binds.contains(ptrAddr) &&                      // Not a bind
-          (!exObjc || ptrTarget < exObjc->getBaseAddr() || // Not in exObjc
-           ptrTarget >= exObjc->getEndAddr()) &&
-          !mCtx.containsAddr(ptrTarget)                    // Not in image
-      ) {
-        /// TODO: Enable
-        // SPDLOG_LOGGER_WARN(logger,
-        //                    "Pointer target at {:#x} -> {:#x} is not within "
-        //                    "MachO file, re-pointing to mach header.",
-        //                    ptrAddr, ptrTarget);
-        ptrTarget = (PtrT)machHeaderAddr;
-      }
-
-      auto fixUpLocation = segData + (ptrAddr - segAddr);
-      bool isAuth = auths.contains(ptrAddr);
-      bool isBind = binds.contains(ptrAddr);
-
-      if (isAuth) {
-        auto authData = auths.at(ptrAddr);
-
-        if (isBind) {
-          auto bindOrdinal =
-              chainedFixupBinds.ordinal(bindToAtoms.at(ptrAddr), 0);
-
-          dyld_chained_ptr_arm64e_auth_bind *b =
-              (dyld_chained_ptr_arm64e_auth_bind *)fixUpLocation;
-          b->auth = 1;
-          b->bind = 1;
-          b->next = 0;
-          b->key = authData.key;
-          b->addrDiv = authData.hasAddrDiv;
-          b->diversity = authData.diversity;
-          b->zero = 0;
-          b->ordinal = bindOrdinal;
-          assert(b->ordinal == bindOrdinal);
-        } else {
-          if (!ptrTarget) {
-            continue;
-          }
-
-          dyld_chained_ptr_arm64e_auth_rebase *r =
-              (dyld_chained_ptr_arm64e_auth_rebase *)fixUpLocation;
-          uint64_t vmOffset = (ptrTarget - machHeaderAddr);
-          r->auth = 1;
-          r->bind = 0;
-          r->next = 0;
-          r->key = authData.key;
-          r->addrDiv = authData.hasAddrDiv;
-          r->diversity = authData.diversity;
-          r->target = vmOffset & 0xFFFFFFFF;
-          assert(r->target == vmOffset);
-        }
-      } else {
-        if (isBind) {
-          auto bindOrdinal =
-              chainedFixupBinds.ordinal(bindToAtoms.at(ptrAddr), 0);
-
-          dyld_chained_ptr_arm64e_bind *b =
-              (dyld_chained_ptr_arm64e_bind *)fixUpLocation;
-          b->auth = 0;
-          b->bind = 1;
-          b->next =
-              0; // chained fixed up later once all fixup locations are known
-          b->addend = 0;
-          b->zero = 0;
-          b->ordinal = bindOrdinal;
-          assert(b->ordinal == bindOrdinal);
-        } else {
-          if (!ptrTarget) {
-            continue;
-          }
-
-          dyld_chained_ptr_arm64e_rebase *r =
-              (dyld_chained_ptr_arm64e_rebase *)fixUpLocation;
-          r->auth = 0;
-          r->bind = 0;
-          r->next =
-              0; // chained fixed up later once all fixup locations are known
-          r->high8 = (ptrTarget >> 56);
-          r->target = ptrTarget;
-          uint64_t reconstituted = (((uint64_t)(r->high8)) << 56) + r->target;
-          assert(reconstituted == ptrTarget);
-        }
-      }
+  } else {
+    if (isBind) {
+      dyld_chained_ptr_arm64e_bind *b =
+          (dyld_chained_ptr_arm64e_bind *)fixUpLocation;
+      b->auth = 0;
+      b->bind = 1;
+      b->next = 0; // chained to the next fixup when it is reached
+      b->addend = bindAddend;
+      assert(b->addend == bindAddend);
+      b->zero = 0;
+      b->ordinal = bindOrdinal;
+      assert(b->ordinal == bindOrdinal);
+    } else {
+      dyld_chained_ptr_arm64e_rebase *r =
+          (dyld_chained_ptr_arm64e_rebase *)fixUpLocation;
+      r->auth = 0;
+      r->bind = 0;
+      r->next = 0; // chained to the next fixup when it is reached
+      r->high8 = (ptrTarget >> 56);
+      r->target = ptrTarget;
+      uint64_t reconstituted = (((uint64_t)(r->high8)) << 56) + r->target;
+      assert(reconstituted == ptrTarget);
     }
   }
 }
@@ -46,8 +46,9 @@ private:
 };
 
 struct ChainedFixupPageInfo {
-  std::vector<uint16_t> fixupOffsets;
-  std::vector<uint16_t> chainOverflows;
+  // Offset of the first fixup on the page. 64 bit chains reach across a whole
+  // page, so each page has one chain.
+  uint16_t startOffset = DYLD_CHAINED_PTR_START_NONE;
 };
 
 struct ChainedFixupSegInfo {
@@ -69,6 +70,7 @@ class ChainedEncoder {
   using PtrT = P::PtrT;
 
   using LETrackerTag = Provider::LinkeditTracker<P>::Tag;
+  using AuthData = Provider::PointerTracker<P>::AuthData;
 
 public:
   ChainedEncoder(Utils::ExtractionContext<A> &eCtx);
@@ -76,23 +78,31 @@ public:
   void generateMetadata();
 
 private:
-  /// @brief fixup pointers and set their targets
-  void fixupPointers();
-
-  /// @brief Builds chains info
+  /// @brief Builds the segment info and the bind targets.
   void buildChainedFixupInfo();
 
-  /// @brief Encodes linkedit data.
-  /// @return The linkedit data, pointer aligned
-  std::vector<uint8_t> encodeChainedInfo();
+  /// @brief Fixup pointers and chain them together, in one pass over each
+  ///   page. Sets the chain start of every page, must be ran after
+  ///   `buildChainedFixupInfo`.
+  void fixupPointers();
 
-  /// @brief applies and chains pointers together, must be ran after
-  /// `encodeChainedInfo` and linkedit data is added.
-  void applyChainedFixups();
+  /// @brief Encodes linkedit data, must be ran after `fixupPointers`.
+  /// @param encodedData Receives the linkedit data, pointer aligned. It is
+  ///   cleared first.
+  void encodeChainedInfo(std::vector<uint8_t> &encodedData);
 
   uint16_t chainedPointerFormat() const;
-  void fixup64();
-  void fixup64e();
+  void fixup64(uint8_t *fixUpLocation, PtrT ptrTarget, uint64_t machHeaderAddr,
+               bool isBind, uint32_t bindOrdinal, uint64_t bindAddend);
+  void fixup64e(uint8_t *fixUpLocation, PtrT ptrTarget,
+                uint64_t machHeaderAddr, const AuthData *authData,
+                bool isBind, uint32_t bindOrdinal, uint64_t bindAddend);
+
+  /// @brief Process the pages of a segment in parallel chunks.
+  /// @param pageCount The number of pages.
+  /// @param func Called with the first page index and the end page index of
+  ///   each chunk.
+  template <class F> void parallelPages(std::size_t pageCount, F func) const;
 
   Macho::Context<false, P> &mCtx;
   Provider::ActivityLogger &activity;
@@ -100,13 +110,15 @@ private:
   Provider::PointerTracker<P> &ptrTracker;
   Provider::LinkeditTracker<P> &leTracker;
   Provider::SymbolTableTracker<P> &stTracker;
+  const Provider::SymbolicInfoStore &symbolStore;
   std::optional<Provider::ExtraData<P>> &exObjc;
+  const unsigned int threads;
 
   ChainedFixupBinds chainedFixupBinds;
   std::vector<ChainedFixupSegInfo> chainedFixupSegments;
 
-  // Map of symbolic info to atoms
-  std::map<std::shared_ptr<Provider::SymbolicInfo>, Atom> atomMap;
+  // Map of symbolic info ids to atoms
+  std::map<Provider::SymbolicInfoStore::Id, Atom> atomMap;
   // Map of bind address to atoms
   std::map<PtrT, Atom *> bindToAtoms;
 };
@@ -3,6 +3,7 @@
 #include "BindingV1.h"
 #include "RebaseV1.h"
 #include <Objc/Abstraction.h>
+#include <Utils/ScratchPool.h>
 #include <Utils/Utils.h>
 
 using namespace DyldExtractor;
@@ -94,8 +95,8 @@ template <class A> void applyFixups(Utils::ExtractionContext<A> &eCtx) {
     }
 
     // process all pointers within the segment
-    auto beginIt = pointers.lower_bound(command->vmaddr);
-    auto endIt = pointers.lower_bound(command->vmaddr + command->vmsize);
+    auto beginIt = pointers.lower_bound((PtrT)command->vmaddr);
+    auto endIt = pointers.lower_bound((PtrT)(command->vmaddr + command->vmsize));
     for (auto it = beginIt; it != endIt; it++) {
       auto [addr, target] = *it;
       // Note: classic rebase does not have auth info
@@ -104,39 +105,48 @@ template <class A> void applyFixups(Utils::ExtractionContext<A> &eCtx) {
   }
 }
 
-/// @brief Returns a copy of all pointers within segments
+/// @brief Returns a sorted copy of all pointers within segments
 template <class P, class T>
-std::map<typename P::PtrT, T>
+std::vector<std::pair<typename P::PtrT, T>>
 filterPointers(const Macho::Context<false, P> &mCtx,
-               std::map<typename P::PtrT, T> pointers) {
-  std::map<typename P::PtrT, T> filtered;
+               const Utils::AddressMap<typename P::PtrT, T> &pointers) {
+  std::vector<std::pair<typename P::PtrT, T>> filtered;
   for (const auto &seg : mCtx.segments) {
-    auto beginIt = pointers.lower_bound(seg.command->vmaddr);
-    auto endIt =
-        pointers.lower_bound(seg.command->vmaddr + seg.command->vmsize);
-    filtered.insert(beginIt, endIt);
+    auto beginIt = pointers.lower_bound((typename P::PtrT)seg.command->vmaddr);
+    auto endIt = pointers.lower_bound(
+        (typename P::PtrT)(seg.command->vmaddr + seg.command->vmsize));
+    filtered.reserve(filtered.size() + (endIt - beginIt));
+    for (auto it = beginIt; it != endIt; it++) {
+      filtered.emplace_back(it->first, it->second);
+    }
   }
+
+  std::sort(filtered.begin(), filtered.end(),
+            [](const auto &a, const auto &b) { return a.first < b.first; });
   return filtered;
 }
 
 template <class A>
-std::vector<uint8_t> encodeRebaseInfo(Utils::ExtractionContext<A> &eCtx) {
+void encodeRebaseInfo(Utils::ExtractionContext<A> &eCtx,
+                      std::vector<uint8_t> &encodedData) {
   auto pointers = filterPointers(*eCtx.mCtx, eCtx.ptrTracker.getPointers());
-  std::vector<Encoder::RebaseV1Info> rebaseInfo;
+  auto rebaseLease = Utils::ScratchPool<Encoder::RebaseV1Info>::local().borrow();
+  auto &rebaseInfo = *rebaseLease;
   rebaseInfo.reserve(pointers.size());
   for (const auto pointer : pointers) {
     rebaseInfo.emplace_back(REBASE_TYPE_POINTER, pointer.first);
   }
 
-  auto encodedData = Encoder::encodeRebaseV1(rebaseInfo, *eCtx.mCtx);
+  Encoder::encodeRebaseV1(rebaseInfo, *eCtx.mCtx, encodedData,
+                          eCtx.optimizeOpcodes);
 
   // Pointer align
     encodedData.resize(Utils::align(encodedData.size(), sizeof(typename A::P::PtrT)));
-  return encodedData;
 }
 
 template <class A>
-std::vector<uint8_t> encodeBindInfo(Utils::ExtractionContext<A> &eCtx) {
+void encodeBindInfo(Utils::ExtractionContext<A> &eCtx,
+                    std::vector<uint8_t> &encodedData) {
   using PtrT = A::P::PtrT;
   const auto &mCtx = *eCtx.mCtx;
 
@@ -153,128 +163,94 @@ std::vector<uint8_t> encodeBindInfo(Utils::ExtractionContext<A> &eCtx) {
   }
 
   // Add binds from opcodes first, and allow them to be overwritten
-  for (const auto &bind : eCtx.bindInfo.getBinds()) {
+  for (const auto &[offset, bind] : eCtx.bindInfo.getBindStream()) {
     bindInfo.emplace((PtrT)bind.address,
                      Encoder::BindingV1Info(bind.type, bind.flags, 0,
                                             bind.libOrdinal, bind.symbolName,
                                             bind.address, bind.addend));
   }
 
+  const auto &addends = eCtx.ptrTracker.getBindAddends();
   for (const auto &[addr, bind] : binds) {
-    auto &sym = bind->preferredSymbol();
+    auto &sym = eCtx.symbolStore.get(bind).preferredSymbol();
+    const auto addendIt = addends.find(addr);
     bindInfo.insert_or_assign(
         addr, Encoder::BindingV1Info(
                   BIND_TYPE_POINTER, (int)sym.ordinal, sym.name.c_str(),
-                  weakDylibOrdinals.contains(sym.ordinal), addr, 0));
+                  weakDylibOrdinals.contains(sym.ordinal), addr,
+                  addendIt != addends.end() ? addendIt->second : 0));
   }
 
-  std::vector<Encoder::BindingV1Info> bindInfoVec;
+  auto bindLease = Utils::ScratchPool<Encoder::BindingV1Info>::local().borrow();
+  auto &bindInfoVec = *bindLease;
   bindInfoVec.reserve(bindInfo.size());
   for (const auto &b : bindInfo) {
     bindInfoVec.push_back(b.second);
   }
 
-  auto encodedData = Encoder::encodeBindingV1(bindInfoVec, mCtx);
+  Encoder::encodeBindingV1(bindInfoVec, mCtx, encodedData, eCtx.threads,
+                           eCtx.optimizeOpcodes);
 
   // Pointer align
     encodedData.resize(Utils::align(encodedData.size(), sizeof(typename A::P::PtrT)));
-  return encodedData;
 }
 
+/// @brief Plans a dyld info region, replacing or removing the old data
 template <class A>
-void addRebaseInfo(Utils::ExtractionContext<A> &eCtx,
-                   std::vector<uint8_t> data) {
-  using LETrackerTag = Provider::LinkeditTracker<typename A::P>::Tag;
-
-  uint32_t size = (uint32_t)data.size();
-  auto &leTracker = *eCtx.leTracker;
-    auto dyldInfo = eCtx.mCtx->template getFirstLC<Macho::Loader::dyld_info_command>();
-  auto rebaseMetaIt = leTracker.findTag(LETrackerTag::rebase);
-
-  if (!size) {
-    // remove any data if necessary
-    if (rebaseMetaIt != leTracker.metadataEnd()) {
-      leTracker.removeData(rebaseMetaIt);
-    }
-    dyldInfo->rebase_off = 0;
-    dyldInfo->rebase_size = 0;
+void planDyldInfoData(Utils::ExtractionContext<A> &eCtx,
+                      typename Provider::LinkeditTracker<typename A::P>::Builder
+                          &builder,
+                      typename Provider::LinkeditTracker<typename A::P>::Tag tag,
+                      const std::vector<uint8_t> &data) {
+  if (!data.size()) {
+    builder.removeData(tag);
     return;
   }
 
-  if (rebaseMetaIt != leTracker.metadataEnd()) {
-    // Resize data and overwrite
-    if (leTracker.resizeData(rebaseMetaIt, size)) {
-      memcpy(rebaseMetaIt->data, data.data(), size);
-    } else {
-      SPDLOG_LOGGER_ERROR(eCtx.logger,
-                          "Unable resize data region for new rebase info.");
-      return;
-    }
-
-  } else {
-    typename Provider::LinkeditTracker<typename A::P>::Metadata newRebaseMeta(
-        LETrackerTag::rebase, nullptr, size,
-        reinterpret_cast<Macho::Loader::load_command *>(dyldInfo));
-    if (!leTracker.addData(newRebaseMeta, data.data(), size).second) {
-      SPDLOG_LOGGER_ERROR(eCtx.logger, "Unable to insert new rebase info.");
-      return;
-    }
-  }
-
-  dyldInfo->rebase_size = size;
+  auto dyldInfo =
+      eCtx.mCtx->template getFirstLC<Macho::Loader::dyld_info_command>();
+  builder.addData(typename Provider::LinkeditTracker<typename A::P>::Metadata(
+                      tag, nullptr, (uint32_t)data.size(),
+                      reinterpret_cast<Macho::Loader::load_command *>(dyldInfo)),
+                  data.data(), (uint32_t)data.size());
 }
 
-template <class A>
-void addBindInfo(Utils::ExtractionContext<A> &eCtx, std::vector<uint8_t> data) {
+/// @brief Generates and adds linkedit metadata
+template <class A> void addMetadata(Utils::ExtractionContext<A> &eCtx) {
   using LETrackerTag = Provider::LinkeditTracker<typename A::P>::Tag;
 
-  uint32_t size = (uint32_t)data.size();
-  auto &leTracker = *eCtx.leTracker;
-    auto dyldInfo = eCtx.mCtx->template getFirstLC<Macho::Loader::dyld_info_command>();
-  auto bindingMetaIt = leTracker.findTag(LETrackerTag::binding);
+  // The data is copied into the linkedit, so scratch buffers can hold it
+  auto &dataPool = Utils::ScratchPool<uint8_t>::local();
+  auto rebaseLease = dataPool.borrow();
+  auto bindLease = dataPool.borrow();
+  auto &rebaseInfo = *rebaseLease;
+  auto &bindInfo = *bindLease;
 
-  if (!size) {
-    // remove any data if necessary
-    if (bindingMetaIt != leTracker.metadataEnd()) {
-      leTracker.removeData(bindingMetaIt);
-    }
-    dyldInfo->bind_off = 0;
-    dyldInfo->bind_size = 0;
+  eCtx.activity->update(std::nullopt, "Generating Rebase Info");
+  encodeRebaseInfo(eCtx, rebaseInfo);
+  eCtx.activity->update(std::nullopt, "Generating Bind Info");
+  encodeBindInfo(eCtx, bindInfo);
+
+  // Replace both regions in one pass over the linkedit
+  auto builder = eCtx.leTracker->builder();
+  planDyldInfoData(eCtx, builder, LETrackerTag::rebase, rebaseInfo);
+  planDyldInfoData(eCtx, builder, LETrackerTag::binding, bindInfo);
+  if (!builder.commit()) {
+    SPDLOG_LOGGER_ERROR(eCtx.logger,
+                        "Not enough space to add rebase and bind info.");
     return;
   }
 
-  if (bindingMetaIt != leTracker.metadataEnd()) {
-    // resize data and overwrite
-    if (leTracker.resizeData(bindingMetaIt, size)) {
-      memcpy(bindingMetaIt->data, data.data(), size);
-    } else {
-      SPDLOG_LOGGER_ERROR(eCtx.logger,
-                          "Unable resize data region for new bind info.");
-      return;
-    }
-  } else {
-    typename Provider::LinkeditTracker<typename A::P>::Metadata newBindingMeta(
-        LETrackerTag::binding, nullptr, size,
-        reinterpret_cast<Macho::Loader::load_command *>(dyldInfo));
-    if (!leTracker.addData(newBindingMeta, data.data(), size).second) {
-      SPDLOG_LOGGER_ERROR(eCtx.logger, "Unable to insert new rebase info.");
-      return;
-    }
+  auto dyldInfo =
+      eCtx.mCtx->template getFirstLC<Macho::Loader::dyld_info_command>();
+  if (!rebaseInfo.size()) {
+    dyldInfo->rebase_off = 0;
   }
-
-  dyldInfo->bind_size = size;
-  return;
-}
-
-/// @brief Generates and adds linkedit metadata
-template <class A> void addMetadata(Utils::ExtractionContext<A> &eCtx) {
-  eCtx.activity->update(std::nullopt, "Generating Rebase Info");
-  auto rebaseInfo = encodeRebaseInfo(eCtx);
-  eCtx.activity->update(std::nullopt, "Generating Bind Info");
-  auto bindInfo = encodeBindInfo(eCtx);
-
-  addRebaseInfo(eCtx, rebaseInfo);
-  addBindInfo(eCtx, bindInfo);
+  dyldInfo->rebase_size = (uint32_t)rebaseInfo.size();
+  if (!bindInfo.size()) {
+    dyldInfo->bind_off = 0;
+  }
+  dyldInfo->bind_size = (uint32_t)bindInfo.size();
 }
 
 template <class A>
@@ -285,6 +261,7 @@ void Encoder::generateLegacyMetadata(Utils::ExtractionContext<A> &eCtx) {
     }
   }
 
+  eCtx.ptrTracker.freeze();
   applyFixups(eCtx);
   addMetadata(eCtx);
 }
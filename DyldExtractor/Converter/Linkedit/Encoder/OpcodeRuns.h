@@ -0,0 +1,153 @@
+#ifndef __CONVERTER_LINKEDIT_ENCODER_OPCODERUNS__
+#define __CONVERTER_LINKEDIT_ENCODER_OPCODERUNS__
+
+#include <Utils/ScratchPool.h>
+#include <algorithm>
+#include <limits>
+#include <stdint.h>
+#include <vector>
+
+namespace DyldExtractor::Converter::Linkedit::Encoder {
+
+/// A cost for a step that the opcodes can't encode.
+constexpr uint64_t RUN_UNREACHABLE = std::numeric_limits<uint64_t>::max();
+
+/// @brief A step in the encoding of a run of fixups.
+struct RunStep {
+  enum class Kind : uint8_t {
+    /// One fixup, then the address moves by the pointer size and `skip`.
+    Single,
+    /// `count` consecutive fixups.
+    Times,
+    /// `count` fixups, each followed by moving `skip` bytes past the pointer.
+    Skipping,
+  };
+
+  /// The index of the first fixup of the step.
+  std::size_t from = 0;
+  Kind kind = Kind::Single;
+  uint64_t count = 0;
+  uint64_t skip = 0;
+  /// Bytes to move after the step, with its own opcode.
+  uint64_t gap = 0;
+  /// The total cost up to and including this step.
+  uint64_t cost = RUN_UNREACHABLE;
+};
+
+/// @brief Find the cheapest steps for a run of fixups.
+///
+/// A run is the fixups between opcodes that set other state, so only the
+/// address moves. Every fixup ends a step that covers the fixups from the end
+/// of the previous step, found by dynamic programming. Times covers a whole
+/// packed run and Skipping a whole run with the same stride, or one less so
+/// that the next fixup can be reached without moving back.
+///
+/// @param addrs The addresses of the fixups relative to the first, sorted
+///   without overlaps.
+/// @param end The address the run must leave, relative to the first fixup.
+/// @param ptrSize The size of a pointer.
+/// @param costs Provides the size in bytes of `single(skip)`, `times(count)`,
+///   `skipping(count, skip)`, and `gap(bytes)` for a non zero move. A step
+///   that can't be encoded costs RUN_UNREACHABLE.
+/// @param steps Receives the steps in order.
+/// @returns The size of the steps in bytes.
+template <class Costs>
+uint64_t cheapestRun(const std::vector<uint64_t> &addrs, uint64_t end,
+                     uint64_t ptrSize, const Costs &costs,
+                     std::vector<RunStep> &steps) {
+  const auto n = addrs.size();
+  auto target = [&](std::size_t i) { return i < n ? addrs[i] : end; };
+
+  // The number of packed fixups, and fixups with the same stride, starting
+  // at each index
+  auto packedLease = Utils::ScratchPool<uint64_t>::local().borrow();
+  auto stridedLease = Utils::ScratchPool<uint64_t>::local().borrow();
+  auto &packed = *packedLease;
+  auto &strided = *stridedLease;
+  packed.resize(n);
+  strided.resize(n);
+  for (std::size_t i = n; i-- > 0;) {
+    if (i + 1 < n && addrs[i + 1] - addrs[i] == ptrSize) {
+      packed[i] = packed[i + 1] + 1;
+    } else {
+      packed[i] = 1;
+    }
+
+    if (i + 2 < n && addrs[i + 2] - addrs[i + 1] == addrs[i + 1] - addrs[i]) {
+      strided[i] = strided[i + 1] + 1;
+    } else {
+      strided[i] = i + 1 < n ? 2 : 1;
+    }
+  }
+
+  // best[i] is the cheapest step that reaches the target of i
+  auto bestLease = Utils::ScratchPool<RunStep>::local().borrow();
+  auto &best = *bestLease;
+  best.resize(n + 1);
+  best[0].cost = 0;
+
+  // landing is the address after the step, before its gap
+  auto relax = [&](std::size_t from, std::size_t to, RunStep::Kind kind,
+                   uint64_t count, uint64_t skip, uint64_t landing,
+                   uint64_t cost) {
+    if (cost == RUN_UNREACHABLE || target(to) < landing) {
+      return;
+    }
+    const uint64_t gap = target(to) - landing;
+    const uint64_t gapCost = gap ? costs.gap(gap) : 0;
+    if (gapCost == RUN_UNREACHABLE) {
+      return;
+    }
+
+    const uint64_t total = best[from].cost + cost + gapCost;
+    if (total < best[to].cost) {
+      best[to] = {from, kind, count, skip, gap, total};
+    }
+  };
+
+  for (std::size_t i = 0; i < n; i++) {
+    if (best[i].cost == RUN_UNREACHABLE) {
+      continue;
+    }
+    const auto addr = addrs[i];
+
+    if (target(i + 1) >= addr + ptrSize) {
+      const auto skip = target(i + 1) - addr - ptrSize;
+      relax(i, i + 1, RunStep::Kind::Single, 1, skip, target(i + 1),
+            costs.single(skip));
+    }
+
+    if (const auto count = packed[i]; count > 1) {
+      relax(i, i + count, RunStep::Kind::Times, count, 0,
+            addrs[i + count - 1] + ptrSize, costs.times(count));
+    }
+
+    if (const auto count = strided[i]; count > 1) {
+      const auto stride = addrs[i + 1] - addr;
+      if (stride >= ptrSize) {
+        const auto skip = stride - ptrSize;
+        relax(i, i + count, RunStep::Kind::Skipping, count, skip,
+              addrs[i + count - 1] + stride, costs.skipping(count, skip));
+        if (count > 2) {
+          relax(i, i + count - 1, RunStep::Kind::Skipping, count - 1, skip,
+                addrs[i + count - 2] + stride,
+                costs.skipping(count - 1, skip));
+        }
+      }
+    }
+  }
+
+  steps.clear();
+  if (best[n].cost == RUN_UNREACHABLE) {
+    return RUN_UNREACHABLE;
+  }
+  for (std::size_t i = n; i > 0; i = best[i].from) {
+    steps.push_back(best[i]);
+  }
+  std::reverse(steps.begin(), steps.end());
+  return best[n].cost;
+}
+
+} // namespace DyldExtractor::Converter::Linkedit::Encoder
+
+#endif // __CONVERTER_LINKEDIT_ENCODER_OPCODERUNS__
@@ -1,6 +1,8 @@
 #include "RebaseV1.h"
+#include "OpcodeRuns.h"
 
 #include <Utils/Leb128.h>
+#include <Utils/ScratchPool.h>
 #include <Utils/Utils.h>
 
 using namespace DyldExtractor;
@@ -19,59 +21,8 @@ struct rebase_tmp {
   uint64_t operand2;
 };
 
-template <typename P>
-std::vector<uint8_t>
-Encoder::encodeRebaseV1(const std::vector<RebaseV1Info> &info,
-                        const Macho::Context<false, P> &mCtx) {
-  using PtrT = P::PtrT;
-
-  // convert to temp encoding that can be more easily optimized
-  std::vector<rebase_tmp> mid;
-  uint64_t curSegStart = 0;
-  uint64_t curSegEnd = 0;
-  uint32_t curSegIndex = 0;
-  uint8_t type = 0;
-  uint64_t address = (uint64_t)(-1);
-  for (auto it = info.begin(); it != info.end(); ++it) {
-    if (type != it->_type) {
-      mid.push_back(rebase_tmp(REBASE_OPCODE_SET_TYPE_IMM, it->_type));
-      type = it->_type;
-    }
-    if (address != it->_address) {
-      if ((it->_address < curSegStart) || (it->_address >= curSegEnd)) {
-
-        // Find segment containing address
-        bool found = false;
-        for (int segI = 0; segI < mCtx.segments.size(); segI++) {
-          const auto &seg = mCtx.segments.at(segI);
-
-          if ((it->_address < seg.command->vmaddr) ||
-              (it->_address >= (seg.command->vmaddr + seg.command->vmsize))) {
-            curSegStart = seg.command->vmaddr;
-            curSegEnd = seg.command->vmaddr + seg.command->vmsize;
-            curSegIndex = segI;
-            found = true;
-            break;
-          }
-        }
-        if (!found)
-          throw "binding address outside range of any segment";
-
-        mid.push_back(rebase_tmp(REBASE_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB,
-                                 curSegIndex, it->_address - curSegStart));
-      } else {
-        mid.push_back(
-            rebase_tmp(REBASE_OPCODE_ADD_ADDR_ULEB, it->_address - address));
-      }
-      address = it->_address;
-    }
-    mid.push_back(rebase_tmp(REBASE_OPCODE_DO_REBASE_ULEB_TIMES, 1));
-    address += sizeof(PtrT);
-    if (address >= curSegEnd)
-      address = 0;
-  }
-  mid.push_back(rebase_tmp(REBASE_OPCODE_DONE, 0));
-
+/// @brief Compress the intermediate encoding with fixed patterns.
+void compressRuns(std::vector<rebase_tmp> &mid) {
   // optimize phase 1, compress packed runs of pointers
   rebase_tmp *dst = &mid[0];
   for (const rebase_tmp *src = &mid[0]; src->opcode != REBASE_OPCODE_DONE;
@@ -136,6 +87,192 @@ Encoder::encodeRebaseV1(const std::vector<RebaseV1Info> &info,
     }
   }
   dst->opcode = REBASE_OPCODE_DONE;
+}
+
+/// @brief Encode the addresses of each run with the cheapest opcodes.
+///
+/// A run is the rebases between opcodes that set the type or segment. Runs
+/// that can't be encoded, like with overlapping pointers, are kept as they
+/// are.
+///
+/// @param mid The unoptimized intermediate encoding.
+/// @param out Receives the optimized intermediate encoding.
+template <class P>
+void optimizeRuns(const std::vector<rebase_tmp> &mid,
+                  std::vector<rebase_tmp> &out) {
+  using PtrT = P::PtrT;
+
+  // The sizes after immediate encodings are used
+  struct Costs {
+    static uint64_t immTimes(uint64_t count) { return (count + 13) / 14; }
+    uint64_t gap(uint64_t bytes) const {
+      if (bytes < (15 * sizeof(PtrT)) && (bytes % sizeof(PtrT)) == 0) {
+        return 1;
+      }
+      return 1 + Utils::uleb128Size(bytes);
+    }
+    uint64_t single(uint64_t skip) const {
+      return skip ? 1 + Utils::uleb128Size(skip) : 1;
+    }
+    uint64_t times(uint64_t count) const {
+      return std::min<uint64_t>(immTimes(count),
+                                1 + Utils::uleb128Size(count));
+    }
+    uint64_t skipping(uint64_t count, uint64_t skip) const {
+      return 1 + Utils::uleb128Size(count) + Utils::uleb128Size(skip);
+    }
+  };
+  const Costs costs;
+
+  auto addrsLease = Utils::ScratchPool<uint64_t>::local().borrow();
+  auto stepsLease = Utils::ScratchPool<RunStep>::local().borrow();
+  auto &addrs = *addrsLease;
+  auto &steps = *stepsLease;
+
+  auto emitTimes = [&](uint64_t count) {
+    if (Costs::immTimes(count) <= 1 + Utils::uleb128Size(count)) {
+      while (count) {
+        const auto chunk = std::min<uint64_t>(count, 14);
+        out.push_back(rebase_tmp(REBASE_OPCODE_DO_REBASE_ULEB_TIMES, chunk));
+        count -= chunk;
+      }
+    } else {
+      out.push_back(rebase_tmp(REBASE_OPCODE_DO_REBASE_ULEB_TIMES, count));
+    }
+  };
+
+  std::size_t runStart = 0;
+  uint64_t address = 0;
+  auto flush = [&](std::size_t runEnd) {
+    if (addrs.empty()) {
+      out.insert(out.end(), mid.begin() + runStart, mid.begin() + runEnd);
+      address = 0;
+      return;
+    }
+
+    const auto first = addrs.front();
+    for (auto &addr : addrs) {
+      addr -= first;
+    }
+    if (cheapestRun(addrs, address - first, sizeof(PtrT), costs, steps) ==
+        RUN_UNREACHABLE) {
+      out.insert(out.end(), mid.begin() + runStart, mid.begin() + runEnd);
+    } else {
+      if (first) {
+        out.push_back(rebase_tmp(REBASE_OPCODE_ADD_ADDR_ULEB, first));
+      }
+      for (const auto &step : steps) {
+        switch (step.kind) {
+        case RunStep::Kind::Single:
+          if (step.skip) {
+            out.push_back(
+                rebase_tmp(REBASE_OPCODE_DO_REBASE_ADD_ADDR_ULEB, step.skip));
+          } else {
+            out.push_back(rebase_tmp(REBASE_OPCODE_DO_REBASE_ULEB_TIMES, 1));
+          }
+          break;
+        case RunStep::Kind::Times:
+          emitTimes(step.count);
+          break;
+        case RunStep::Kind::Skipping:
+          out.push_back(
+              rebase_tmp(REBASE_OPCODE_DO_REBASE_ULEB_TIMES_SKIPPING_ULEB,
+                         step.count, step.skip));
+          break;
+        }
+        if (step.gap) {
+          out.push_back(rebase_tmp(REBASE_OPCODE_ADD_ADDR_ULEB, step.gap));
+        }
+      }
+    }
+
+    addrs.clear();
+    address = 0;
+  };
+
+  out.reserve(mid.size());
+  std::size_t i = 0;
+  for (; mid[i].opcode != REBASE_OPCODE_DONE; i++) {
+    const auto &op = mid[i];
+    if (op.opcode == REBASE_OPCODE_ADD_ADDR_ULEB) {
+      address += op.operand1;
+    } else if (op.opcode == REBASE_OPCODE_DO_REBASE_ULEB_TIMES) {
+      for (uint64_t j = 0; j < op.operand1; j++) {
+        addrs.push_back(address);
+        address += sizeof(PtrT);
+      }
+    } else {
+      flush(i);
+      out.push_back(op);
+      runStart = i + 1;
+    }
+  }
+  flush(i);
+  out.push_back(rebase_tmp(REBASE_OPCODE_DONE, 0));
+}
+
+template <typename P>
+void Encoder::encodeRebaseV1(const std::vector<RebaseV1Info> &info,
+                             const Macho::Context<false, P> &mCtx,
+                             std::vector<uint8_t> &encodedData,
+                             bool optimize) {
+  using PtrT = P::PtrT;
+
+  // convert to temp encoding that can be more easily optimized
+  auto midLease = Utils::ScratchPool<rebase_tmp>::local().borrow();
+  auto &mid = *midLease;
+  uint64_t curSegStart = 0;
+  uint64_t curSegEnd = 0;
+  uint32_t curSegIndex = 0;
+  uint8_t type = 0;
+  uint64_t address = (uint64_t)(-1);
+  for (auto it = info.begin(); it != info.end(); ++it) {
+    if (type != it->_type) {
+      mid.push_back(rebase_tmp(REBASE_OPCODE_SET_TYPE_IMM, it->_type));
+      type = it->_type;
+    }
+    if (address != it->_address) {
+      if ((it->_address < curSegStart) || (it->_address >= curSegEnd)) {
+
+        // Find segment containing address
+        bool found = false;
+        for (int segI = 0; segI < mCtx.segments.size(); segI++) {
+          const auto &seg = mCtx.segments.at(segI);
+
+          if ((it->_address >= seg.command->vmaddr) &&
+              (it->_address < (seg.command->vmaddr + seg.command->vmsize))) {
+            curSegStart = seg.command->vmaddr;
+            curSegEnd = seg.command->vmaddr + seg.command->vmsize;
+            curSegIndex = segI;
+            found = true;
+            break;
+          }
+        }
+        if (!found)
+          throw "binding address outside range of any segment";
+
+        mid.push_back(rebase_tmp(REBASE_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB,
+                                 curSegIndex, it->_address - curSegStart));
+      } else {
+        mid.push_back(
+            rebase_tmp(REBASE_OPCODE_ADD_ADDR_ULEB, it->_address - address));
+      }
+      address = it->_address;
+    }
+    mid.push_back(rebase_tmp(REBASE_OPCODE_DO_REBASE_ULEB_TIMES, 1));
+    address += sizeof(PtrT);
+    if (address >= curSegEnd)
+      address = 0;
+  }
+  mid.push_back(rebase_tmp(REBASE_OPCODE_DONE, 0));
+
+  if (optimize) {
+    auto optimizedLease = Utils::ScratchPool<rebase_tmp>::local().borrow();
+    optimizeRuns<P>(mid, *optimizedLease);
+    mid.swap(*optimizedLease);
+  } else {
+    compressRuns(mid);
+  }
 
   // optimize phase 4, use immediate encodings
   for (rebase_tmp *p = &mid[0]; p->opcode != REBASE_OPCODE_DONE; ++p) {
@@ -151,7 +288,7 @@ Encoder::encodeRebaseV1(const std::vector<RebaseV1Info> &info,
   }
 
   // convert to compressed encoding
-  std::vector<uint8_t> encodedData;
+  encodedData.clear();
   encodedData.reserve(info.size() * 2);
   bool done = false;
   for (auto it = mid.begin(); !done && it != mid.end(); ++it) {
@@ -207,12 +344,13 @@ Encoder::encodeRebaseV1(const std::vector<RebaseV1Info> &info,
 
   // align to pointer size
   encodedData.resize(Utils::align(encodedData.size(), sizeof(PtrT)));
-  return encodedData;
 }
 
-template std::vector<uint8_t> Encoder::encodeRebaseV1<Utils::Arch::Pointer32>(
+template void Encoder::encodeRebaseV1<Utils::Arch::Pointer32>(
     const std::vector<RebaseV1Info> &info,
-    const Macho::Context<false, Utils::Arch::Pointer32> &mCtx);
-template std::vector<uint8_t> Encoder::encodeRebaseV1<Utils::Arch::Pointer64>(
+    const Macho::Context<false, Utils::Arch::Pointer32> &mCtx,
+    std::vector<uint8_t> &encodedData, bool optimize);
+template void Encoder::encodeRebaseV1<Utils::Arch::Pointer64>(
     const std::vector<RebaseV1Info> &info,
-    const Macho::Context<false, Utils::Arch::Pointer64> &mCtx);
\ No newline at end of file
+    const Macho::Context<false, Utils::Arch::Pointer64> &mCtx,
+    std::vector<uint8_t> &encodedData, bool optimize);
\ No newline at end of file
@@ -11,9 +11,17 @@ struct RebaseV1Info {
   uint64_t _address;
 };
 
+/// @brief Encode rebases as rebase opcodes.
+/// @param info The rebases, sorted by address.
+/// @param mCtx The macho context.
+/// @param encodedData Receives the opcodes, pointer aligned. It is cleared
+///   first, so a scratch buffer can be reused.
+/// @param optimize Pick the smallest opcodes for each run of rebases,
+///   instead of compressing fixed patterns.
 template <class P>
-std::vector<uint8_t> encodeRebaseV1(const std::vector<RebaseV1Info> &info,
-                                    const Macho::Context<false, P> &mCtx);
+void encodeRebaseV1(const std::vector<RebaseV1Info> &info,
+                    const Macho::Context<false, P> &mCtx,
+                    std::vector<uint8_t> &encodedData, bool optimize = false);
 
 } // namespace DyldExtractor::Converter::Linkedit::Encoder
 
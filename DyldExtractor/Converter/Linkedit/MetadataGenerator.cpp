@@ -3,6 +3,7 @@
 #include "Encoder/Encoder.h"
 #include <Macho/MachoContext.h>
 #include <Objc/Abstraction.h>
+#include <Utils/ScratchPool.h>
 #include <Utils/Utils.h>
 
 using namespace DyldExtractor;
@@ -29,27 +30,27 @@ template <class A> void writeSymbols(Utils::ExtractionContext<A> &eCtx) {
     auto symtab = mCtx.template getFirstLC<Macho::Loader::symtab_command>();
     auto dysymtab = mCtx.template getFirstLC<Macho::Loader::dysymtab_command>();
 
-  // Create string pool
-  // Get size of pool and assign indicies
+  // Create string pool, strings are sorted so the output is deterministic
   auto &strings = stTracker.getStrings();
 
-  uint32_t strSize = 0;
-  uint32_t currentI = 1; // first string is \x00
-  std::map<const std::string *, uint32_t> strIndicies;
-  for (auto it = strings.cbegin(); it != strings.cend(); it++) {
-    strIndicies[&(*it)] = currentI;
-    strSize += (uint32_t)it->size();
-    currentI += (uint32_t)it->size() + 1; // include null terminator
-  }
-
   // add null terminator for each string, and 1 for the beginning \x00
-  strSize += (uint32_t)strings.size() + 1;
-  std::vector<uint8_t> strBuf(strSize, 0x0);
+  const uint32_t strSize =
+      (uint32_t)(strings.dataSize() + strings.size() + 1);
+  auto strBufLease = Utils::ScratchPool<uint8_t>::local().borrow();
+  auto &strBuf = *strBufLease;
+  strBuf.resize(strSize, 0x0);
   auto strBufData = strBuf.data();
 
-  // Copy strings
-  for (auto &[it, offset] : strIndicies) {
-    memcpy(strBufData + offset, it->c_str(), it->size());
+  // Assign indicies and copy strings
+  uint32_t currentI = 1; // first string is \x00
+  auto strIndiciesLease = Utils::ScratchPool<uint32_t>::local().borrow();
+  auto &strIndicies = *strIndiciesLease;
+  strIndicies.resize(strings.size());
+  for (const auto id : strings.sortedIds()) {
+    const auto str = strings.get(id);
+    strIndicies[id] = currentI;
+    memcpy(strBufData + currentI, str.data(), str.size());
+    currentI += (uint32_t)str.size() + 1; // include null terminator
   }
 
   // Create symbol table
@@ -73,14 +74,16 @@ template <class A> void writeSymbols(Utils::ExtractionContext<A> &eCtx) {
   const uint32_t nlistSize = (uint32_t)sizeof(Macho::Loader::nlist<P>);
   uint32_t nSyms = (uint32_t)(syms.other.size() + syms.local.size() +
                               syms.external.size() + syms.undefined.size());
-  std::vector<Macho::Loader::nlist<P>> symsBuf;
+  auto symsBufLease =
+      Utils::ScratchPool<Macho::Loader::nlist<P>>::local().borrow();
+  auto &symsBuf = *symsBufLease;
   symsBuf.reserve(nSyms);
 
   // Write symbols
   auto _writeSyms = [&](auto &syms) {
-    for (auto &[strIt, sym] : syms) {
+    for (auto &[strId, sym] : syms) {
       symsBuf.push_back(sym);
-      symsBuf.back().n_un.n_strx = strIndicies[&(*strIt)];
+      symsBuf.back().n_un.n_strx = strIndicies[strId];
     }
   };
   _writeSyms(syms.other);
@@ -90,50 +93,41 @@ template <class A> void writeSymbols(Utils::ExtractionContext<A> &eCtx) {
 
   // Create indirect symbol table
   auto &indirectSymtab = stTracker.indirectSyms;
-  std::vector<uint32_t> indirectSymtabBuf;
+  auto indirectSymtabLease = Utils::ScratchPool<uint32_t>::local().borrow();
+  auto &indirectSymtabBuf = *indirectSymtabLease;
   indirectSymtabBuf.reserve(indirectSymtab.size());
   for (const auto &sym : indirectSymtab) {
     indirectSymtabBuf.push_back(_symTypeOffset(sym.first) + sym.second);
   }
 
-  // Add new data to tracking
-  LETrackerMetadata stringPoolMeta(
-      LETrackerTag::stringPool, nullptr,
-      Utils::align(strSize, (uint32_t)sizeof(PtrT)),
-      reinterpret_cast<Macho::Loader::load_command *>(symtab));
-  if (!leTracker.addData(stringPoolMeta, strBufData, strSize).second) {
-    SPDLOG_LOGGER_ERROR(logger, "Not enough space to add string pool.");
+  // Add new data to tracking, in one pass over the linkedit
+  auto builder = leTracker.builder();
+  builder.addData(
+      LETrackerMetadata(
+          LETrackerTag::stringPool, nullptr,
+          Utils::align(strSize, (uint32_t)sizeof(PtrT)),
+          reinterpret_cast<Macho::Loader::load_command *>(symtab)),
+      strBufData, strSize);
+  builder.addData(
+      LETrackerMetadata(
+          LETrackerTag::symtab, nullptr,
+          Utils::align(nSyms * nlistSize, (uint32_t)sizeof(PtrT)),
+          reinterpret_cast<Macho::Loader::load_command *>(symtab)),
+      reinterpret_cast<uint8_t *>(symsBuf.data()), nSyms * nlistSize);
+  builder.addData(
+      LETrackerMetadata(
+          LETrackerTag::indirectSymtab, nullptr,
+          Utils::align((uint32_t)(indirectSymtabBuf.size() * sizeof(uint32_t)),
+                       (uint32_t)sizeof(PtrT)),
+          reinterpret_cast<Macho::Loader::load_command *>(dysymtab)),
+      reinterpret_cast<uint8_t *>(indirectSymtabBuf.data()),
+      (uint32_t)(indirectSymtabBuf.size() * sizeof(uint32_t)));
+  if (!builder.commit()) {
+    SPDLOG_LOGGER_ERROR(logger, "Not enough space to add symbol tables.");
     return;
   }
   symtab->strsize = strSize;
-
-  LETrackerMetadata symtabMeta(
-      LETrackerTag::symtab, nullptr,
-      Utils::align(nSyms * nlistSize, (uint32_t)sizeof(PtrT)),
-      reinterpret_cast<Macho::Loader::load_command *>(symtab));
-  if (!leTracker
-           .addData(symtabMeta, reinterpret_cast<uint8_t *>(symsBuf.data()),
-                    nSyms * nlistSize)
-           .second) {
-    SPDLOG_LOGGER_ERROR(logger, "Not enough space to add symbol table.");
-    return;
-  }
   symtab->nsyms = nSyms;
-
-  LETrackerMetadata indirectSymtabMeta(
-      LETrackerTag::indirectSymtab, nullptr,
-      Utils::align((uint32_t)(indirectSymtabBuf.size() * sizeof(uint32_t)),
-                   (uint32_t)sizeof(PtrT)),
-      reinterpret_cast<Macho::Loader::load_command *>(dysymtab));
-  if (!leTracker
-           .addData(indirectSymtabMeta,
-                    reinterpret_cast<uint8_t *>(indirectSymtabBuf.data()),
-                    (uint32_t)(indirectSymtabBuf.size() * sizeof(uint32_t)))
-           .second) {
-    SPDLOG_LOGGER_ERROR(logger,
-                        "Not enough space to add indirect symbol table.");
-    return;
-  }
   dysymtab->nindirectsyms = (uint32_t)indirectSymtabBuf.size();
 
   // Set symbol indicies
@@ -1,6 +1,7 @@
 #include "Optimizer.h"
 #include <Provider/LinkeditTracker.h>
 #include <Provider/SymbolTableTracker.h>
+#include <Utils/Threading.h>
 #include <Utils/Utils.h>
 
 #include <map>
@@ -22,8 +23,10 @@ public:
   void run();
 
 private:
+  /// Reserves space for data in the new linkedit, copied by writeData.
   void addData(uint8_t *data, uint32_t size, LETrackerTag tag,
                Macho::Loader::load_command *lc);
+  void writeData();
 
   void copyBindingInfo();
   void copyWeakBindingInfo();
@@ -37,6 +40,8 @@ private:
   void copyExportedSymbols();
   void copyImportedSymbols();
   void copyIndirectSymbolTable();
+  void copySymbols();
+  void prefetchSymbols();
 
   void commitData();
 
@@ -58,6 +63,13 @@ private:
   // map of old symbol indicies to new ones in the tracker
   std::map<uint32_t, std::pair<STSymbolType, uint32_t>> newSymbolIndicies;
 
+  struct PendingCopy {
+    uint32_t offset; // offset in the new linkedit data
+    const uint8_t *source;
+    uint32_t size;
+  };
+  std::vector<PendingCopy> pendingCopies;
+
   std::vector<uint8_t> newLeData; // data storage for new linkedit region
   uint32_t newLeSize = 0;         // current size of new linkedit data
   uint8_t *leFile;       // pointer to file containing old linkedit data
@@ -98,24 +110,67 @@ template <class A> void LinkeditOptimizer<A>::run() {
   copyFunctionStarts();
   copyDataInCode();
 
+  // The layout is known, so copying data and symbols are independent
+  prefetchSymbols();
+  newLeData.resize(newLeSize);
+  Utils::parallelChunks(
+      Utils::chunkCount(eCtx.threads, 2, 1), 2,
+      [this](std::size_t, std::size_t begin, std::size_t end) {
+        for (auto stage = begin; stage < end; stage++) {
+          if (stage == 0) {
+            copySymbols();
+          } else {
+            writeData();
+          }
+        }
+      });
+
+  commitData();
+}
+
+template <class A> void LinkeditOptimizer<A>::copySymbols() {
   copyLocalSymbols();
   copyExportedSymbols();
   copyImportedSymbols();
   copyIndirectSymbolTable();
+}
 
-  commitData();
+/// Start reading in the symbols of the image, they are a small part of the
+/// shared symbol table and are read while the other data is copied.
+template <class A> void LinkeditOptimizer<A>::prefetchSymbols() {
+  auto syms = (Macho::Loader::nlist<P> *)(leFile + symtab->symoff);
+  Macho::adviseMemory(syms + dysymtab->ilocalsym,
+                      dysymtab->nlocalsym * sizeof(*syms),
+                      Macho::Advice::WillNeed);
+  Macho::adviseMemory(syms + dysymtab->iextdefsym,
+                      dysymtab->nextdefsym * sizeof(*syms),
+                      Macho::Advice::WillNeed);
+  Macho::adviseMemory(syms + dysymtab->iundefsym,
+                      dysymtab->nundefsym * sizeof(*syms),
+                      Macho::Advice::WillNeed);
+  Macho::adviseMemory(leFile + dysymtab->indirectsymoff,
+                      dysymtab->nindirectsyms * sizeof(uint32_t),
+                      Macho::Advice::WillNeed);
 }
 
 template <class A>
 void LinkeditOptimizer<A>::addData(uint8_t *data, uint32_t size,
                                    LETrackerTag tag,
                                    Macho::Loader::load_command *lc) {
-  auto alignedSize = Utils::align(size, sizeof(PtrT));
+  auto alignedSize = (uint32_t)Utils::align(size, sizeof(PtrT));
   trackedData.emplace_back(tag, leData + newLeSize, alignedSize, lc);
 
-  newLeData.insert(newLeData.end(), data, data + size);
-  newLeData.resize(newLeSize + alignedSize);
-  newLeSize = (uint32_t)newLeData.size();
+  // Copied later by writeData
+  Macho::adviseMemory(data, size, Macho::Advice::WillNeed);
+  pendingCopies.push_back({newLeSize, data, size});
+  newLeSize += alignedSize;
+}
+
+template <class A> void LinkeditOptimizer<A>::writeData() {
+  // Padding is already zeroed
+  for (const auto &copy : pendingCopies) {
+    memcpy(newLeData.data() + copy.offset, copy.source, copy.size);
+  }
 }
 
 template <class A> void LinkeditOptimizer<A>::copyBindingInfo() {
@@ -232,7 +287,7 @@ template <class A> void LinkeditOptimizer<A>::copyExportedSymbols() {
     auto symEntry = syms + symIndex;
     const char *string = (const char *)stringsStart + symEntry->n_un.n_strx;
 
-    auto &str = stTracker.addString(string);
+    auto str = stTracker.addString(string);
     auto newSymIndex = stTracker.addSym(STSymbolType::external, str, *symEntry);
 
     newSymbolIndicies[symIndex] = newSymIndex;
@@ -252,7 +307,7 @@ template <class A> void LinkeditOptimizer<A>::copyImportedSymbols() {
     auto symEntry = syms + symIndex;
     const char *string = (const char *)stringsStart + symEntry->n_un.n_strx;
 
-    auto &str = stTracker.addString(string);
+    auto str = stTracker.addString(string);
     auto newSymIndex =
         stTracker.addSym(STSymbolType::undefined, str, *symEntry);
 
@@ -299,7 +354,7 @@ template <class A> void LinkeditOptimizer<A>::commitData() {
 
   eCtx.stTracker = std::move(stTracker);
   eCtx.symbolizer.emplace(*eCtx.dCtx, *eCtx.mCtx, *eCtx.accelerator, activity,
-                          logger, *eCtx.stTracker);
+                          logger, *eCtx.stTracker, eCtx.lazySymbols);
 }
 
 template <class A>
@@ -307,45 +362,24 @@ std::tuple<Macho::Loader::nlist<typename A::P> *,
            Macho::Loader::nlist<typename A::P> *>
 LinkeditOptimizer<A>::findLocalSymbolEntries(
     dyld_cache_local_symbols_info *symbolsInfo) {
-  // Search local symbol entries for the macho context.
-  auto searchEntries =
-      [&]<class T>(decltype(T::dylibOffset) machoOffset) -> T * {
-    T *entriesStart =
-        (T *)((uint8_t *)symbolsInfo + symbolsInfo->entriesOffset);
-    T *entriesEnd = entriesStart + symbolsInfo->entriesCount;
-    for (auto entry = entriesStart; entry < entriesEnd; entry++) {
-      if (entry->dylibOffset == machoOffset) {
-        return entry;
-      }
-    }
-
-    return nullptr;
-  };
-
-  uint8_t *nlistStart = nullptr;
-  uint32_t nlistCount = 0;
+  uint64_t machoOffset;
   if (dCtx.headerContainsMember(offsetof(dyld_cache_header, symbolFileUUID))) {
     // Newer caches, vm offset to mach header.
-    uint64_t machoOffset = mCtx.getSegment(SEG_TEXT)->command->vmaddr -
-                           dCtx.header->sharedRegionStart;
-      auto entry = searchEntries.template operator()<dyld_cache_local_symbols_entry_64>(
-        machoOffset);
-    if (entry) {
-      nlistStart = (uint8_t *)symbolsInfo + symbolsInfo->nlistOffset +
-                   sizeof(Macho::Loader::nlist<P>) * entry->nlistStartIndex;
-      nlistCount = entry->nlistCount;
-    }
+    machoOffset = mCtx.getSegment(SEG_TEXT)->command->vmaddr -
+                  dCtx.header->sharedRegionStart;
   } else {
     // Older caches, file offset to mach header.
-    uint64_t machoOffset =
-        mCtx.convertAddr(mCtx.getSegment(SEG_TEXT)->command->vmaddr).first;
-      auto entry = searchEntries.template operator()<dyld_cache_local_symbols_entry>(
-        (uint32_t)machoOffset);
-    if (entry) {
-      nlistStart = (uint8_t *)symbolsInfo + symbolsInfo->nlistOffset +
-                   sizeof(Macho::Loader::nlist<P>) * entry->nlistStartIndex;
-      nlistCount = entry->nlistCount;
-    }
+    machoOffset = (uint32_t)mCtx
+                      .convertAddr(mCtx.getSegment(SEG_TEXT)->command->vmaddr)
+                      .first;
+  }
+
+  uint8_t *nlistStart = nullptr;
+  uint32_t nlistCount = 0;
+  if (auto entry = dCtx.findLocalSymbolsEntry(machoOffset)) {
+    nlistStart = (uint8_t *)symbolsInfo + symbolsInfo->nlistOffset +
+                 sizeof(Macho::Loader::nlist<P>) * entry->nlistStartIndex;
+    nlistCount = entry->nlistCount;
   }
 
   if (!nlistStart) {
@@ -374,7 +408,7 @@ template <class A> void LinkeditOptimizer<A>::copyPublicLocalSymbols() {
     }
 
     // Local symbol indices are not tracked for indirect symbols
-    auto &str = stTracker.addString(string);
+    auto str = stTracker.addString(string);
     stTracker.addSym(STSymbolType::local, str, *entry);
 
     activity.update();
@@ -400,7 +434,7 @@ template <class A> void LinkeditOptimizer<A>::copyRedactedLocalSymbols() {
     const char *string = (const char *)stringsStart + symEntry->n_un.n_strx;
 
     // Local symbol indices are not tracked for indirect symbols
-    auto &str = stTracker.addString(string);
+    auto str = stTracker.addString(string);
     stTracker.addSym(STSymbolType::local, str, *symEntry);
 
     activity.update();
@@ -0,0 +1,244 @@
+#ifndef __CONVERTER_OBJC_ATOMSTORAGE__
+#define __CONVERTER_OBJC_ATOMSTORAGE__
+
+#include <Utils/AddressHashMap.h>
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+namespace DyldExtractor::Converter::ObjcFixer {
+
+/// @brief A fixed capacity array of atoms, constructed in place.
+///
+/// Atoms can't be moved, so the capacity is reserved once before adding any
+/// atoms, and all atoms are in one contiguous allocation.
+template <class T> class AtomArray {
+public:
+  AtomArray() = default;
+  AtomArray(const AtomArray &) = delete;
+  AtomArray &operator=(const AtomArray &) = delete;
+  ~AtomArray() { clear(); }
+
+  /// @brief Allocate space for atoms, must be empty.
+  void reserve(std::size_t count) {
+    if (_size) {
+      throw std::logic_error("Unable to reserve a non empty atom array.");
+    }
+    storage.reset(count ? new Storage[count] : nullptr);
+    capacity = count;
+  }
+
+  /// @brief Construct an atom at the end, there must be a reserved space.
+  template <class... Args> T &emplace_back(Args &&...args) {
+    if (_size == capacity) {
+      throw std::length_error("Atom array is at capacity.");
+    }
+    auto atom = new (&storage[_size]) T(std::forward<Args>(args)...);
+    _size++;
+    return *atom;
+  }
+
+  std::size_t size() const { return _size; }
+  bool empty() const { return !_size; }
+
+  T *begin() { return data(); }
+  T *end() { return data() + _size; }
+  const T *begin() const { return data(); }
+  const T *end() const { return data() + _size; }
+
+private:
+  struct alignas(T) Storage {
+    std::byte data[sizeof(T)];
+  };
+
+  T *data() const {
+    return std::launder(reinterpret_cast<T *>(storage.get()));
+  }
+
+  void clear() {
+    for (auto &atom : *this) {
+      atom.~T();
+    }
+    _size = 0;
+  }
+
+  std::unique_ptr<Storage[]> storage;
+  std::size_t capacity = 0;
+  std::size_t _size = 0;
+};
+
+/// @brief A map of addresses to atoms, backed by an arena.
+///
+/// Atoms are constructed in place in large blocks and never move, and are
+/// found with a Utils::AddressIndex. Iteration is ordered by key, like a
+/// std::map, so the placement of atoms is deterministic.
+///
+/// Lookups, insertions and removals can be done from multiple threads, but
+/// iteration must not be concurrent with them. An inserted atom is only
+/// constructed once, other threads get the same atom.
+template <class K, class T> class AtomMap {
+public:
+  struct Entry {
+    template <class... Args>
+    Entry(K key, Args &&...args)
+        : first(key), second(std::forward<Args>(args)...) {}
+
+    const K first;
+    T second;
+  };
+
+  using Iterator = std::vector<Entry *>::iterator;
+
+  /// @brief Dereferences entry pointers during iteration.
+  class EntryIt {
+  public:
+    EntryIt(Iterator it) : it(it) {}
+    Entry &operator*() const { return **it; }
+    Entry *operator->() const { return *it; }
+    EntryIt &operator++() {
+      ++it;
+      return *this;
+    }
+    bool operator==(const EntryIt &other) const { return it == other.it; }
+
+  private:
+    Iterator it;
+  };
+
+  AtomMap() = default;
+  AtomMap(const AtomMap &) = delete;
+  AtomMap &operator=(const AtomMap &) = delete;
+  ~AtomMap() {
+    for (auto entry : entries) {
+      entry->~Entry();
+    }
+  }
+
+  bool contains(K key) const {
+    std::lock_guard lock(mutex);
+    return find(key) != nullptr;
+  }
+
+  /// @brief Get an atom with one lookup.
+  /// @returns The atom, or nullptr if it doesn't exist.
+  T *get(K key) {
+    std::lock_guard lock(mutex);
+    auto entry = find(key);
+    return entry ? &entry->second : nullptr;
+  }
+
+  /// @brief Get an atom, throws if it doesn't exist.
+  T &at(K key) {
+    std::lock_guard lock(mutex);
+    if (auto entry = find(key); entry) {
+      return entry->second;
+    }
+    throw std::out_of_range("Atom does not exist.");
+  }
+
+  /// @brief Construct an atom if it doesn't exist.
+  /// @returns The entry and if it was constructed.
+  template <class... Args>
+  std::pair<Entry *, bool> try_emplace(K key, Args &&...args) {
+    std::lock_guard lock(mutex);
+    return emplace(key, std::forward<Args>(args)...);
+  }
+
+  /// @brief Default construct the atoms that don't exist, with one lock.
+  /// @param keys The keys, may contain duplicates.
+  /// @param count The number of keys.
+  /// @param results The entry for each key and if it was constructed.
+  void try_emplace_all(const K *keys, std::size_t count,
+                       std::pair<Entry *, bool> *results) {
+    std::lock_guard lock(mutex);
+    for (std::size_t i = 0; i < count; i++) {
+      results[i] = emplace(keys[i]);
+    }
+  }
+
+  /// @brief Destroy an atom, its space is not reused.
+  void erase(K key) {
+    std::lock_guard lock(mutex);
+    auto entry = find(key);
+    if (!entry) {
+      return;
+    }
+
+    index.erase(key);
+    entries.erase(std::find(entries.begin(), entries.end(), entry));
+    entry->~Entry();
+  }
+
+  std::size_t size() const {
+    std::lock_guard lock(mutex);
+    return entries.size();
+  }
+
+  EntryIt begin() {
+    if (!sorted) {
+      std::sort(entries.begin(), entries.end(),
+                [](const Entry *a, const Entry *b) {
+                  return a->first < b->first;
+                });
+      sorted = true;
+    }
+    return EntryIt(entries.begin());
+  }
+  EntryIt end() { return EntryIt(entries.end()); }
+
+private:
+  struct alignas(Entry) Storage {
+    std::byte data[sizeof(Entry)];
+  };
+
+  static constexpr std::size_t MIN_BLOCK_SIZE = 64;
+  static constexpr std::size_t MAX_BLOCK_SIZE = 4096;
+
+  template <class... Args>
+  std::pair<Entry *, bool> emplace(K key, Args &&...args) {
+    if (auto entry = find(key); entry) {
+      return std::make_pair(entry, false);
+    }
+
+    auto entry = new (allocate()) Entry(key, std::forward<Args>(args)...);
+    index.insert(entry);
+    entries.push_back(entry);
+    sorted = sorted && (entries.size() == 1 ||
+                        entries[entries.size() - 2]->first < key);
+    return std::make_pair(entry, true);
+  }
+
+  void *allocate() {
+    if (blockUsed == blockSize) {
+      blockSize = blocks.empty()
+                      ? MIN_BLOCK_SIZE
+                      : std::min(blockSize * 2, MAX_BLOCK_SIZE);
+      blocks.emplace_back(new Storage[blockSize]);
+      blockUsed = 0;
+    }
+    return &blocks.back()[blockUsed++];
+  }
+
+  Entry *find(K key) const { return index.find(key); }
+
+  std::vector<std::unique_ptr<Storage[]>> blocks;
+  std::size_t blockSize = 0;
+  std::size_t blockUsed = 0;
+
+  Utils::AddressIndex<K, Entry> index;
+
+  std::vector<Entry *> entries;
+  bool sorted = true;
+
+  mutable std::mutex mutex;
+};
+
+} // namespace DyldExtractor::Converter::ObjcFixer
+
+#endif // __CONVERTER_OBJC_ATOMSTORAGE__
@@ -1,11 +1,12 @@
 #ifndef __CONVERTER_OBJC_ATOMS__
 #define __CONVERTER_OBJC_ATOMS__
 
+#include "AtomStorage.h"
 #include <Objc/Abstraction.h>
 #include <Provider/Symbolizer.h>
 #include <Utils/Utils.h>
-#include <list>
 #include <optional>
+#include <type_traits>
 
 namespace DyldExtractor::Converter::ObjcFixer {
 
@@ -13,16 +14,39 @@ template <class A> class ClassAtom;
 template <class A> class ProtocolListAtom;
 
 #pragma region MetaAtoms
+template <class P> class AtomBase;
+
+/// @brief A non owning callback for child atoms, called with the atom and its
+///   relative offset. Must not outlive the callable.
+template <class P> class AtomVisitor {
+  using PtrT = P::PtrT;
+
+public:
+  template <class F>
+    requires(!std::is_same_v<std::remove_cvref_t<F>, AtomVisitor>)
+  AtomVisitor(F &&func)
+      : func((void *)&func),
+        callback([](void *func, AtomBase<P> *atom, PtrT offset) {
+          (*static_cast<std::remove_reference_t<F> *>(func))(atom, offset);
+        }) {}
+
+  void operator()(AtomBase<P> *atom, PtrT offset) const {
+    callback(func, atom, offset);
+  }
+
+private:
+  void *func;
+  void (*callback)(void *, AtomBase<P> *, PtrT);
+};
+
 /// @brief Base atom type
 template <class P> class AtomBase {
   using PtrT = P::PtrT;
 
 public:
-  /// @brief Get all child atoms.
-  /// @return A vector of pairs of the atom pointers and their relative offsets
-  virtual std::vector<std::pair<AtomBase<P> *, PtrT>> getAtoms() const {
-    return std::vector<std::pair<AtomBase<P> *, PtrT>>();
-  }
+  /// @brief Visit all child atoms, without allocating.
+  /// @param visit Called with each child atom and its relative offset
+  virtual void visitAtoms(AtomVisitor<P> visit) const {}
 
   /// @brief Gets the encoded size of the entire atom, including children
   virtual PtrT encodedSize() const { return 0; }
@@ -30,9 +54,7 @@ public:
   /// @brief Propagate any relationships to the data structure
   /// @details Must be called after finalAddr for dependencies are set.
   virtual void propagate() {
-    for (auto &[atom, offset] : getAtoms()) {
-      atom->propagate();
-    }
+    visitAtoms([](AtomBase<P> *atom, PtrT) { atom->propagate(); });
   }
 
   /// @brief Gets the finalAddr, must be set first
@@ -43,9 +65,9 @@ public:
     assert(!_finalAddr && "Final address was already set.");
     _finalAddr = addr;
 
-    for (auto &[atom, offset] : getAtoms()) {
+    visitAtoms([addr](AtomBase<P> *atom, PtrT offset) {
       atom->setFinalAddr(addr + offset);
-    }
+    });
   }
 
   /// @brief If the final placement is in the image
@@ -111,7 +133,7 @@ class BindRefAtom final : public ReferenceAtom<P, AtomT, typename P::PtrT *> {
 
 public:
   using ReferenceAtom<P, AtomT, PtrT *>::ReferenceAtom;
-  BindRefAtom(std::shared_ptr<Provider::SymbolicInfo> bind) : bind(bind) {}
+  BindRefAtom(const Provider::SymbolicInfo *bind) : bind(bind) {}
 
   virtual void propagate() override {
     ReferenceAtom<P, AtomT, PtrT *>::propagate();
@@ -125,7 +147,8 @@ public:
     }
   }
 
-  std::shared_ptr<Provider::SymbolicInfo> bind; // optional bind, takes priority
+  // optional bind, takes priority
+  const Provider::SymbolicInfo *bind = nullptr;
 };
 
 /// @brief Represents an atom relationship based on an offset, that's part of a
@@ -185,7 +208,8 @@ public:
     }
   }
 
-  std::shared_ptr<Provider::SymbolicInfo> bind; // optional bind, takes priority
+  // optional bind, takes priority
+  const Provider::SymbolicInfo *bind = nullptr;
 };
 #pragma endregion RelationalAtoms
 
@@ -207,10 +231,13 @@ template <class P> class StringAtom final : public Atom<P, const char *> {
   using PtrT = P::PtrT;
 
 public:
-  using Atom<P, const char *>::Atom;
-  virtual PtrT encodedSize() const override {
-    return (PtrT)strlen(this->data) + 1; // include null terminator
-  }
+  StringAtom(const char *data)
+      : Atom<P, const char *>(data),
+        size((PtrT)strlen(data) + 1) {} // include null terminator
+  virtual PtrT encodedSize() const override { return size; }
+
+private:
+  PtrT size;
 };
 
 /// @brief Represents a null terminated bitmap
@@ -219,12 +246,18 @@ class IvarLayoutAtom final : public Atom<P, const uint8_t *> {
   using PtrT = P::PtrT;
 
 public:
-  using Atom<P, const uint8_t *>::Atom;
-  virtual PtrT encodedSize() const override {
-    const uint8_t *end = this->data;
+  IvarLayoutAtom(const uint8_t *data)
+      : Atom<P, const uint8_t *>(data), size(layoutSize(data)) {}
+  virtual PtrT encodedSize() const override { return size; }
+
+private:
+  PtrT size;
+
+  static PtrT layoutSize(const uint8_t *data) {
+    const uint8_t *end = data;
     for (; *end != '\0'; ++end)
       ;
-    return (PtrT)(end - this->data + 1); // include null terminator
+    return (PtrT)(end - data + 1); // include null terminator
   }
 };
 
@@ -247,11 +280,10 @@ public:
       : Atom<P, DataT>(data), name(&this->data.name), types(&this->data.types),
         imp(&this->data.imp) {}
 
-  virtual std::vector<std::pair<AtomBase<P> *, PtrT>>
-  getAtoms() const override {
-    return {{(AtomBase<P> *)&name, (PtrT)offsetof(DataT, name)},
-            {(AtomBase<P> *)&types, (PtrT)offsetof(DataT, types)},
-            {(AtomBase<P> *)&imp, (PtrT)offsetof(DataT, imp)}};
+  virtual void visitAtoms(AtomVisitor<P> visit) const override {
+    visit((AtomBase<P> *)&name, (PtrT)offsetof(DataT, name));
+    visit((AtomBase<P> *)&types, (PtrT)offsetof(DataT, types));
+    visit((AtomBase<P> *)&imp, (PtrT)offsetof(DataT, imp));
   }
 
   RelativeRefAtom<P, PointerAtom<P, StringAtom<P>>> name;
@@ -270,11 +302,10 @@ public:
       : Atom<P, DataT>(data), name(&this->data.name), types(&this->data.types),
         imp(&this->data.imp) {}
 
-  virtual std::vector<std::pair<AtomBase<P> *, PtrT>>
-  getAtoms() const override {
-    return {{(AtomBase<P> *)&name, (PtrT)offsetof(DataT, name)},
-            {(AtomBase<P> *)&types, (PtrT)offsetof(DataT, types)},
-            {(AtomBase<P> *)&imp, (PtrT)offsetof(DataT, imp)}};
+  virtual void visitAtoms(AtomVisitor<P> visit) const override {
+    visit((AtomBase<P> *)&name, (PtrT)offsetof(DataT, name));
+    visit((AtomBase<P> *)&types, (PtrT)offsetof(DataT, types));
+    visit((AtomBase<P> *)&imp, (PtrT)offsetof(DataT, imp));
   }
 
   FieldRefAtom<P, StringAtom<P>> name;
@@ -298,18 +329,12 @@ template <class P> class SmallMethodListAtom final : public MethodListAtom<P> {
 
 public:
   using MethodListAtom<P>::MethodListAtom;
-  virtual std::vector<std::pair<AtomBase<P> *, PtrT>>
-  getAtoms() const override {
-    std::vector<std::pair<AtomBase<P> *, PtrT>> atoms;
-    atoms.reserve(entries.size());
-
+  virtual void visitAtoms(AtomVisitor<P> visit) const override {
     PtrT offset = sizeof(DataT);
     for (auto &method : entries) {
-      atoms.emplace_back((AtomBase<P> *)&method, offset);
+      visit((AtomBase<P> *)&method, offset);
       offset += this->data.getEntsize();
     }
-
-    return atoms;
   }
 
   virtual PtrT encodedSize() const override {
@@ -318,7 +343,7 @@ public:
     return Utils::align(size, sizeof(PtrT));
   }
 
-  std::list<SmallMethodAtom<P>> entries;
+  AtomArray<SmallMethodAtom<P>> entries;
 };
 
 /// @brief Represents a method_list_t with large methods
@@ -328,25 +353,19 @@ template <class P> class LargeMethodListAtom final : public MethodListAtom<P> {
 
 public:
   using MethodListAtom<P>::MethodListAtom;
-  virtual std::vector<std::pair<AtomBase<P> *, PtrT>>
-  getAtoms() const override {
-    std::vector<std::pair<AtomBase<P> *, PtrT>> atoms;
-    atoms.reserve(entries.size());
-
+  virtual void visitAtoms(AtomVisitor<P> visit) const override {
     PtrT offset = sizeof(DataT);
     for (auto &method : entries) {
-      atoms.emplace_back((AtomBase<P> *)&method, offset);
+      visit((AtomBase<P> *)&method, offset);
       offset += this->data.getEntsize();
     }
-
-    return atoms;
   }
 
   virtual PtrT encodedSize() const override {
     return (PtrT)sizeof(DataT) + (this->data.getEntsize() * this->data.count);
   }
 
-  std::list<LargeMethodAtom<P>> entries;
+  AtomArray<LargeMethodAtom<P>> entries;
 };
 
 template <class P>
@@ -359,10 +378,9 @@ public:
       : Atom<P, DataT>(data), name(&this->data.name),
         attributes(&this->data.attributes) {}
 
-  virtual std::vector<std::pair<AtomBase<P> *, PtrT>>
-  getAtoms() const override {
-    return {{(AtomBase<P> *)&name, (PtrT)offsetof(DataT, name)},
-            {(AtomBase<P> *)&attributes, (PtrT)offsetof(DataT, attributes)}};
+  virtual void visitAtoms(AtomVisitor<P> visit) const override {
+    visit((AtomBase<P> *)&name, (PtrT)offsetof(DataT, name));
+    visit((AtomBase<P> *)&attributes, (PtrT)offsetof(DataT, attributes));
   }
 
   FieldRefAtom<P, StringAtom<P>> name;
@@ -376,25 +394,19 @@ class PropertyListAtom final : public Atom<P, Objc::property_list_t> {
 
 public:
   using Atom<P, DataT>::Atom;
-  virtual std::vector<std::pair<AtomBase<P> *, PtrT>>
-  getAtoms() const override {
-    std::vector<std::pair<AtomBase<P> *, PtrT>> atoms;
-    atoms.reserve(entries.size());
-
+  virtual void visitAtoms(AtomVisitor<P> visit) const override {
     PtrT offset = sizeof(DataT);
     for (auto &property : entries) {
-      atoms.emplace_back((AtomBase<P> *)&property, offset);
+      visit((AtomBase<P> *)&property, offset);
       offset += this->data.entsize;
     }
-
-    return atoms;
   }
 
   virtual PtrT encodedSize() const override {
     return this->data.entsize * this->data.count;
   }
 
-  std::list<PropertyAtom<P>> entries;
+  AtomArray<PropertyAtom<P>> entries;
 };
 
 template <class P>
@@ -402,27 +414,25 @@ class ExtendedMethodTypesAtom final : public Atom<P, typename P::PtrT> {
   using PtrT = P::PtrT;
 
 public:
-  ExtendedMethodTypesAtom() : Atom<P, typename P::PtrT>(0) {}
-
-  virtual std::vector<std::pair<AtomBase<P> *, PtrT>>
-  getAtoms() const override {
-    std::vector<std::pair<AtomBase<P> *, PtrT>> atoms;
-    atoms.reserve(entries.size());
+  ExtendedMethodTypesAtom(uint32_t count)
+      : Atom<P, typename P::PtrT>(0), count(count) {}
 
+  virtual void visitAtoms(AtomVisitor<P> visit) const override {
     PtrT offset = 0;
     for (auto &type : entries) {
-      atoms.emplace_back((AtomBase<P> *)&type, offset);
+      visit((AtomBase<P> *)&type, offset);
       offset += sizeof(PtrT);
     }
-
-    return atoms;
   }
 
   virtual PtrT encodedSize() const override {
     return (PtrT)(sizeof(PtrT) * entries.size());
   }
 
-  std::list<PointerAtom<P, StringAtom<P>>> entries;
+  /// The number of types, set before another thread can find the atom,
+  /// unlike entries which the walking thread is still filling.
+  const uint32_t count;
+  AtomArray<PointerAtom<P, StringAtom<P>>> entries;
 };
 
 /// @brief Represents a protocol_t
@@ -446,26 +456,24 @@ public:
         demangledName(&this->data.demangledName),
         classProperties(&this->data.classProperties) {}
 
-  virtual std::vector<std::pair<AtomBase<P> *, PtrT>>
-  getAtoms() const override {
-    return {
-        {(AtomBase<P> *)&isa, (PtrT)offsetof(DataT, isa)},
-        {(AtomBase<P> *)&name, (PtrT)offsetof(DataT, name)},
-        {(AtomBase<P> *)&protocols, (PtrT)offsetof(DataT, protocols)},
-        {(AtomBase<P> *)&instanceMethods,
-         (PtrT)offsetof(DataT, instanceMethods)},
-        {(AtomBase<P> *)&classMethods, (PtrT)offsetof(DataT, classMethods)},
-        {(AtomBase<P> *)&optionalInstanceMethods,
-         (PtrT)offsetof(DataT, optionalInstanceMethods)},
-        {(AtomBase<P> *)&optionalClassMethods,
-         (PtrT)offsetof(DataT, optionalClassMethods)},
-        {(AtomBase<P> *)&instanceProperties,
-         (PtrT)offsetof(DataT, instanceProperties)},
-        {(AtomBase<P> *)&extendedMethodTypes,
-         (PtrT)offsetof(DataT, extendedMethodTypes)},
-        {(AtomBase<P> *)&demangledName, (PtrT)offsetof(DataT, demangledName)},
-        {(AtomBase<P> *)&classProperties,
-         (PtrT)offsetof(DataT, classProperties)}};
+  virtual void visitAtoms(AtomVisitor<P> visit) const override {
+    visit((AtomBase<P> *)&isa, (PtrT)offsetof(DataT, isa));
+    visit((AtomBase<P> *)&name, (PtrT)offsetof(DataT, name));
+    visit((AtomBase<P> *)&protocols, (PtrT)offsetof(DataT, protocols));
+    visit((AtomBase<P> *)&instanceMethods,
+          (PtrT)offsetof(DataT, instanceMethods));
+    visit((AtomBase<P> *)&classMethods, (PtrT)offsetof(DataT, classMethods));
+    visit((AtomBase<P> *)&optionalInstanceMethods,
+          (PtrT)offsetof(DataT, optionalInstanceMethods));
+    visit((AtomBase<P> *)&optionalClassMethods,
+          (PtrT)offsetof(DataT, optionalClassMethods));
+    visit((AtomBase<P> *)&instanceProperties,
+          (PtrT)offsetof(DataT, instanceProperties));
+    visit((AtomBase<P> *)&extendedMethodTypes,
+          (PtrT)offsetof(DataT, extendedMethodTypes));
+    visit((AtomBase<P> *)&demangledName, (PtrT)offsetof(DataT, demangledName));
+    visit((AtomBase<P> *)&classProperties,
+          (PtrT)offsetof(DataT, classProperties));
   }
 
   virtual PtrT encodedSize() const override { return this->data.size; }
@@ -494,18 +502,12 @@ class ProtocolListAtom final
 
 public:
   using Atom<P, DataT>::Atom;
-  virtual std::vector<std::pair<AtomBase<P> *, PtrT>>
-  getAtoms() const override {
-    std::vector<std::pair<AtomBase<P> *, PtrT>> atoms;
-    atoms.reserve(entries.size());
-
+  virtual void visitAtoms(AtomVisitor<P> visit) const override {
     PtrT offset = sizeof(DataT);
     for (auto &protocol : entries) {
-      atoms.emplace_back((AtomBase<P> *)&protocol, offset);
+      visit((AtomBase<P> *)&protocol, offset);
       offset += sizeof(PtrT);
     }
-
-    return atoms;
   }
 
   virtual PtrT encodedSize() const override {
@@ -513,7 +515,7 @@ public:
                   (sizeof(Objc::protocol_t<P>) * entries.size()));
   }
 
-  std::list<PointerAtom<P, ProtocolAtom<A>>> entries;
+  AtomArray<PointerAtom<P, ProtocolAtom<A>>> entries;
 };
 
 /// @brief Represents an ivar_t
@@ -528,11 +530,10 @@ public:
       : Atom<P, DataT>(data), offset(&this->data.offset),
         name(&this->data.name), type(&this->data.type) {}
 
-  virtual std::vector<std::pair<AtomBase<P> *, PtrT>>
-  getAtoms() const override {
-    return {{(AtomBase<P> *)&offset, (PtrT)offsetof(DataT, offset)},
-            {(AtomBase<P> *)&name, (PtrT)offsetof(DataT, name)},
-            {(AtomBase<P> *)&type, (PtrT)offsetof(DataT, type)}};
+  virtual void visitAtoms(AtomVisitor<P> visit) const override {
+    visit((AtomBase<P> *)&offset, (PtrT)offsetof(DataT, offset));
+    visit((AtomBase<P> *)&name, (PtrT)offsetof(DataT, name));
+    visit((AtomBase<P> *)&type, (PtrT)offsetof(DataT, type));
   }
 
   FieldRefAtom<P, IvarOffsetAtom<A>> offset;
@@ -549,25 +550,19 @@ class IvarListAtom final : public Atom<typename A::P, Objc::ivar_list_t> {
 
 public:
   using Atom<P, DataT>::Atom;
-  virtual std::vector<std::pair<AtomBase<P> *, PtrT>>
-  getAtoms() const override {
-    std::vector<std::pair<AtomBase<P> *, PtrT>> atoms;
-    atoms.reserve(entries.size());
-
+  virtual void visitAtoms(AtomVisitor<P> visit) const override {
     PtrT offset = sizeof(DataT);
     for (auto &ivar : entries) {
-      atoms.emplace_back((AtomBase<P> *)&ivar, offset);
+      visit((AtomBase<P> *)&ivar, offset);
       offset += this->data.entsize;
     }
-
-    return atoms;
   }
 
   virtual PtrT encodedSize() const override {
     return this->data.count * this->data.entsize;
   }
 
-  std::list<IvarAtom<A>> entries;
+  AtomArray<IvarAtom<A>> entries;
 };
 
 /// @brief Represents a class_data_t
@@ -586,17 +581,16 @@ public:
         weakIvarLayout(&this->data.weakIvarLayout),
         baseProperties(&this->data.baseProperties) {}
 
-  virtual std::vector<std::pair<AtomBase<P> *, PtrT>>
-  getAtoms() const override {
-    return {
-        {(AtomBase<P> *)&ivarLayout, (PtrT)offsetof(DataT, ivarLayout)},
-        {(AtomBase<P> *)&name, (PtrT)offsetof(DataT, name)},
-        {(AtomBase<P> *)&baseMethods, (PtrT)offsetof(DataT, baseMethods)},
-        {(AtomBase<P> *)&baseProtocols, (PtrT)offsetof(DataT, baseProtocols)},
-        {(AtomBase<P> *)&ivars, (PtrT)offsetof(DataT, ivars)},
-        {(AtomBase<P> *)&weakIvarLayout, (PtrT)offsetof(DataT, weakIvarLayout)},
-        {(AtomBase<P> *)&baseProperties,
-         (PtrT)offsetof(DataT, baseProperties)}};
+  virtual void visitAtoms(AtomVisitor<P> visit) const override {
+    visit((AtomBase<P> *)&ivarLayout, (PtrT)offsetof(DataT, ivarLayout));
+    visit((AtomBase<P> *)&name, (PtrT)offsetof(DataT, name));
+    visit((AtomBase<P> *)&baseMethods, (PtrT)offsetof(DataT, baseMethods));
+    visit((AtomBase<P> *)&baseProtocols, (PtrT)offsetof(DataT, baseProtocols));
+    visit((AtomBase<P> *)&ivars, (PtrT)offsetof(DataT, ivars));
+    visit((AtomBase<P> *)&weakIvarLayout,
+          (PtrT)offsetof(DataT, weakIvarLayout));
+    visit((AtomBase<P> *)&baseProperties,
+          (PtrT)offsetof(DataT, baseProperties));
   }
 
   FieldRefAtom<P, IvarLayoutAtom<P>> ivarLayout;
@@ -621,11 +615,10 @@ public:
       : Atom<P, DataT>(data), isa(&this->data.isa),
         superclass(&this->data.superclass), classData(&this->data.data) {}
 
-  virtual std::vector<std::pair<AtomBase<P> *, PtrT>>
-  getAtoms() const override {
-    return {{(AtomBase<P> *)&isa, (PtrT)offsetof(DataT, isa)},
-            {(AtomBase<P> *)&superclass, (PtrT)offsetof(DataT, superclass)},
-            {(AtomBase<P> *)&classData, (PtrT)offsetof(DataT, data)}};
+  virtual void visitAtoms(AtomVisitor<P> visit) const override {
+    visit((AtomBase<P> *)&isa, (PtrT)offsetof(DataT, isa));
+    visit((AtomBase<P> *)&superclass, (PtrT)offsetof(DataT, superclass));
+    visit((AtomBase<P> *)&classData, (PtrT)offsetof(DataT, data));
   }
 
   virtual void propagate() override {
@@ -658,18 +651,17 @@ public:
         instanceProperties(&this->data.instanceProperties),
         _classProperties(&this->data._classProperties) {}
 
-  virtual std::vector<std::pair<AtomBase<P> *, PtrT>>
-  getAtoms() const override {
-    return {{(AtomBase<P> *)&name, (PtrT)offsetof(DataT, name)},
-            {(AtomBase<P> *)&cls, (PtrT)offsetof(DataT, cls)},
-            {(AtomBase<P> *)&instanceMethods,
-             (PtrT)offsetof(DataT, instanceMethods)},
-            {(AtomBase<P> *)&classMethods, (PtrT)offsetof(DataT, classMethods)},
-            {(AtomBase<P> *)&protocols, (PtrT)offsetof(DataT, protocols)},
-            {(AtomBase<P> *)&instanceProperties,
-             (PtrT)offsetof(DataT, instanceProperties)},
-            {(AtomBase<P> *)&_classProperties,
-             (PtrT)offsetof(DataT, _classProperties)}};
+  virtual void visitAtoms(AtomVisitor<P> visit) const override {
+    visit((AtomBase<P> *)&name, (PtrT)offsetof(DataT, name));
+    visit((AtomBase<P> *)&cls, (PtrT)offsetof(DataT, cls));
+    visit((AtomBase<P> *)&instanceMethods,
+          (PtrT)offsetof(DataT, instanceMethods));
+    visit((AtomBase<P> *)&classMethods, (PtrT)offsetof(DataT, classMethods));
+    visit((AtomBase<P> *)&protocols, (PtrT)offsetof(DataT, protocols));
+    visit((AtomBase<P> *)&instanceProperties,
+          (PtrT)offsetof(DataT, instanceProperties));
+    visit((AtomBase<P> *)&_classProperties,
+          (PtrT)offsetof(DataT, _classProperties));
   }
 
   virtual PtrT encodedSize() const override {
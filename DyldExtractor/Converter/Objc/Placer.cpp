@@ -10,7 +10,7 @@ template <class A>
 Placer<A>::Placer(Utils::ExtractionContext<A> &eCtx, Walker<A> &walker)
     : mCtx(*eCtx.mCtx), logger(eCtx.logger), ptrTracker(eCtx.ptrTracker),
       leTracker(eCtx.leTracker.value()), stTracker(eCtx.stTracker.value()),
-      walker(walker) {}
+      symbolStore(eCtx.symbolStore), walker(walker) {}
 
 template <class A>
 std::optional<Provider::ExtraData<typename A::P>> Placer<A>::placeAll() {
@@ -23,8 +23,8 @@ std::optional<Provider::ExtraData<typename A::P>> Placer<A>::placeAll() {
   PtrT exDataSize = placeAtoms(exDataAddr);
   Provider::ExtraData<P> exData(extendsSeg, exDataAddr, exDataSize);
 
-  propagateAtoms();
   writeAtoms(exData);
+  propagatePointers();
   trackAtoms(exData);
   return exData;
 }
@@ -153,69 +153,33 @@ Placer<A>::PtrT Placer<A>::placeAtoms(const PtrT exDataAddr) {
   return currentAddr - exDataAddr;
 }
 
-template <class A> void Placer<A>::propagateAtoms() {
-  auto propagateAtoms = [](auto &atoms) {
-    for (auto &[origAddr, atom] : atoms) {
-      atom.propagate();
-    }
-  };
-
-  propagateAtoms(walker.atoms.classes);
-  propagateAtoms(walker.atoms.classData);
-  propagateAtoms(walker.atoms.smallMethodLists);
-  propagateAtoms(walker.atoms.largeMethodLists);
-  propagateAtoms(walker.atoms.protocolLists);
-  propagateAtoms(walker.atoms.propertyLists);
-  propagateAtoms(walker.atoms.ivarLists);
-  propagateAtoms(walker.atoms.extendedMethodTypes);
-  propagateAtoms(walker.atoms.protocols);
-  propagateAtoms(walker.atoms.categories);
-  propagateAtoms(walker.atoms.smallMethodSelRefs);
-  propagateAtoms(walker.atoms.strings);
-  propagateAtoms(walker.atoms.ivarLayouts);
-  propagateAtoms(walker.atoms.ivarOffsets);
-
-  propagateAtoms(walker.pointers.classes);
-  propagateAtoms(walker.pointers.categories);
-  propagateAtoms(walker.pointers.protocols);
-  propagateAtoms(walker.pointers.selectorRefs);
-  propagateAtoms(walker.pointers.protocolRefs);
-  propagateAtoms(walker.pointers.classRefs);
-  propagateAtoms(walker.pointers.superRefs);
-}
-
 template <class A> void Placer<A>::writeAtoms(Provider::ExtraData<P> &exData) {
   auto exDataLoc = exData.getData();
   auto exDataStart = exData.getBaseAddr();
   auto exDataEnd = exData.getEndAddr();
 
-  // Write simple atoms
+  auto atomLocation = [&](const auto &atom) -> uint8_t * {
+    if (atom.placedInImage) {
+      return mCtx.convertAddrP(atom.finalAddr());
+    }
+    assert(atom.finalAddr() >= exDataStart && atom.finalAddr() < exDataEnd);
+    return exDataLoc + (atom.finalAddr() - exDataStart);
+  };
+
+  // Propagate and write simple atoms
   auto writeAtoms = [&](auto &atoms) {
     for (auto &[origAddr, atom] : atoms) {
-      auto finalAddr = atom.finalAddr();
-      uint8_t *atomLoc;
-      if (finalAddr >= exDataStart && finalAddr < exDataEnd) {
-        atomLoc = exDataLoc + (finalAddr - exDataStart);
-      } else {
-        atomLoc = mCtx.convertAddrP(finalAddr);
-      }
-
-      memcpy(atomLoc, (uint8_t *)&atom.data, atom.encodedSize());
+      atom.propagate();
+      memcpy(atomLocation(atom), (uint8_t *)&atom.data, atom.encodedSize());
     }
   };
 
-  // Write an atom with a list after it
+  // Propagate and write an atom with a list after it
   auto writeAtomLists = [&](auto &atoms, PtrT headerSize) {
     for (auto &[origAddr, atom] : atoms) {
+      atom.propagate();
       auto finalAddr = atom.finalAddr();
-
-      uint8_t *atomLoc;
-      if (atom.placedInImage) {
-        atomLoc = mCtx.convertAddrP(finalAddr);
-      } else {
-        assert(finalAddr >= exDataStart && finalAddr < exDataEnd);
-        atomLoc = exDataLoc + (finalAddr - exDataStart);
-      }
+      uint8_t *atomLoc = atomLocation(atom);
 
       // Write header atom
       memcpy(atomLoc, (uint8_t *)&atom.data, headerSize);
@@ -230,6 +194,17 @@ template <class A> void Placer<A>::writeAtoms(Provider::ExtraData<P> &exData) {
     }
   };
 
+  // Write atoms whose data is a pointer to the contents, only if moved
+  auto writeDataAtoms = [&](auto &atoms) {
+    for (auto &[origAddr, atom] : atoms) {
+      if (!atom.placedInImage) {
+        memcpy(atomLocation(atom), atom.data, atom.encodedSize());
+      }
+    }
+  };
+
+  // In the same order as placeAtoms, so the extra data is written
+  // sequentially
   writeAtoms(walker.atoms.classes);
   writeAtoms(walker.atoms.classData);
 
@@ -243,25 +218,26 @@ template <class A> void Placer<A>::writeAtoms(Provider::ExtraData<P> &exData) {
   writeAtoms(walker.atoms.protocols);
   writeAtoms(walker.atoms.categories);
   writeAtoms(walker.atoms.smallMethodSelRefs);
+
+  writeDataAtoms(walker.atoms.strings);
+  writeDataAtoms(walker.atoms.ivarLayouts);
   writeAtoms(walker.atoms.ivarOffsets);
+}
 
-  for (auto &[origAddr, atom] : walker.atoms.strings) {
-    if (!atom.placedInImage) {
-      auto finalAddr = atom.finalAddr();
-      assert(finalAddr >= exDataStart && finalAddr < exDataEnd);
-      uint8_t *atomLoc = exDataLoc + (finalAddr - exDataStart);
-      memcpy(atomLoc, atom.data, atom.encodedSize());
+template <class A> void Placer<A>::propagatePointers() {
+  auto propagateAtoms = [](auto &atoms) {
+    for (auto &[origAddr, atom] : atoms) {
+      atom.propagate();
     }
-  }
+  };
 
-  for (auto &[origAddr, atom] : walker.atoms.ivarLayouts) {
-    if (!atom.placedInImage) {
-      auto finalAddr = atom.finalAddr();
-      assert(finalAddr >= exDataStart && finalAddr < exDataEnd);
-      uint8_t *atomLoc = exDataLoc + (finalAddr - exDataStart);
-      memcpy(atomLoc, atom.data, atom.encodedSize());
-    }
-  }
+  propagateAtoms(walker.pointers.classes);
+  propagateAtoms(walker.pointers.categories);
+  propagateAtoms(walker.pointers.protocols);
+  propagateAtoms(walker.pointers.selectorRefs);
+  propagateAtoms(walker.pointers.protocolRefs);
+  propagateAtoms(walker.pointers.classRefs);
+  propagateAtoms(walker.pointers.superRefs);
 }
 
 template <class A> void Placer<A>::trackAtoms(Provider::ExtraData<P> &exData) {
@@ -350,8 +326,7 @@ template <class A> void Placer<A>::trackAtoms(Provider::ExtraData<P> &exData) {
     ptrTracker.add(pAddr, pAtom.data);
 
     if (pAtom.bind) {
-      ptrTracker.addBind(pAddr, pAtom.bind);
-      checkBind(pAtom.bind);
+      addBind(pAddr, pAtom.bind);
     }
   }
 
@@ -359,43 +334,54 @@ template <class A> void Placer<A>::trackAtoms(Provider::ExtraData<P> &exData) {
     ptrTracker.add(pAddr, pAtom.data);
 
     if (pAtom.bind) {
-      ptrTracker.addBind(pAddr, pAtom.bind);
-      checkBind(pAtom.bind);
+      addBind(pAddr, pAtom.bind);
     }
   }
 
   // Add binds for structures
   for (auto &[origAddr, atom] : walker.atoms.classes) {
     if (atom.isa.bind) {
-      ptrTracker.addBind(atom.isa.finalAddr(), atom.isa.bind);
-      checkBind(atom.isa.bind);
+      addBind(atom.isa.finalAddr(), atom.isa.bind);
     }
     if (atom.superclass.bind) {
-      ptrTracker.addBind(atom.superclass.finalAddr(), atom.superclass.bind);
-      checkBind(atom.superclass.bind);
+      addBind(atom.superclass.finalAddr(), atom.superclass.bind);
     }
   }
 
   for (auto &[origAddr, atom] : walker.atoms.protocols) {
     if (atom.isa.bind) {
-      ptrTracker.addBind(atom.isa.finalAddr(), atom.isa.bind);
-      checkBind(atom.isa.bind);
+      addBind(atom.isa.finalAddr(), atom.isa.bind);
     }
   }
 
   for (auto &[origAddr, atom] : walker.atoms.categories) {
     if (atom.cls.bind) {
-      ptrTracker.addBind(atom.cls.finalAddr(), atom.cls.bind);
-      checkBind(atom.cls.bind);
+      addBind(atom.cls.finalAddr(), atom.cls.bind);
     }
   }
 }
 
 template <class A>
-void Placer<A>::checkBind(const std::shared_ptr<Provider::SymbolicInfo> &bind) {
-  auto &sym = bind->preferredSymbol();
+void Placer<A>::addBind(const PtrT addr, const Provider::SymbolicInfo *bind) {
+  const auto id = symbolStore.ref(bind);
+  ptrTracker.addBind(addr, id);
+  checkBind(id);
+}
+
+template <class A>
+void Placer<A>::checkBind(const Provider::SymbolicInfoStore::Id bind) {
+  // Many pointers bind to the same class
+  if (bind < checkedBinds.size() && checkedBinds[bind]) {
+    return;
+  }
+  if (bind >= checkedBinds.size()) {
+    checkedBinds.resize(bind + 1);
+  }
+  checkedBinds[bind] = true;
+
+  auto &sym = symbolStore.get(bind).preferredSymbol();
   if (!stTracker.getStrings().contains(sym.name)) {
-    auto &str = stTracker.addString(sym.name);
+    auto str = stTracker.addString(sym.name);
 
     /// TODO: Check if symbol type is correct
     Macho::Loader::nlist<P> entry{};
@@ -21,25 +21,31 @@ private:
   std::pair<std::string, PtrT> allocateDataRegion();
 
   /// @brief Gives addresses to all atoms
-  /// @returns The size of the extra data section
+  /// @returns The exact size of the extra data section
   PtrT placeAtoms(const PtrT exDataAddr);
-  /// @brief Propagate all atoms
-  void propagateAtoms();
-  /// @brief Update data fields and write
+  /// @brief Propagate and write atoms in a single pass, in placement order
   void writeAtoms(Provider::ExtraData<P> &exData);
+  /// @brief Propagate the in image pointers
+  void propagatePointers();
   /// @brief Adds pointers to tracking
   void trackAtoms(Provider::ExtraData<P> &exData);
 
+  /// @brief Adds a bind to tracking, and checks if it has a symbol entry
+  void addBind(const PtrT addr, const Provider::SymbolicInfo *bind);
+
   /// @brief Checks if a bind has a symbol entry
-  void checkBind(const std::shared_ptr<Provider::SymbolicInfo> &bind);
+  void checkBind(const Provider::SymbolicInfoStore::Id bind);
 
   Macho::Context<false, P> &mCtx;
   std::shared_ptr<spdlog::logger> logger;
   Provider::PointerTracker<P> &ptrTracker;
   Provider::LinkeditTracker<P> &leTracker;
   Provider::SymbolTableTracker<P> &stTracker;
+  Provider::SymbolicInfoStore &symbolStore;
 
   Walker<A> &walker;
+  // Binds that were checked, indexed by id
+  std::vector<bool> checkedBinds;
 };
 
 } // namespace DyldExtractor::Converter::ObjcFixer
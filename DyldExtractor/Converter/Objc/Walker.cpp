@@ -1,14 +1,85 @@
 #include "Walker.h"
 
+#include <Utils/Threading.h>
+#include <spdlog/sinks/dist_sink.h>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define OBJC_RELATIVE_SSE2
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define OBJC_RELATIVE_NEON
+#endif
+
 using namespace DyldExtractor;
 using namespace Converter;
 using namespace ObjcFixer;
 
+#define OBJC_MIN_ROOTS_PER_THREAD 512
+
+/// @brief Resolve consecutive int32 offsets that are relative to themselves.
+///
+/// The offset at index i is at base + i * 4, an offset of 0 is a null
+/// reference and stays 0.
+///
+/// @param offsets The relative offsets.
+/// @param base The address of the first offset.
+/// @param count The number of offsets.
+/// @param targets The absolute addresses of the targets.
+static void decodeRelativeOffsets(const int32_t *offsets, uint64_t base,
+                                  std::size_t count, uint64_t *targets) {
+  std::size_t i = 0;
+#if defined(OBJC_RELATIVE_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i step = _mm_set1_epi64x(16);
+  __m128i addrLo = _mm_set_epi64x(base + 4, base);
+  __m128i addrHi = _mm_set_epi64x(base + 12, base + 8);
+  for (; i + 4 <= count; i += 4) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(offsets + i));
+    // Sign extend to 64 bits, and mask out the null offsets
+    __m128i sign = _mm_srai_epi32(v, 31);
+    __m128i isZero = _mm_cmpeq_epi32(v, zero);
+    __m128i lo = _mm_add_epi64(_mm_unpacklo_epi32(v, sign), addrLo);
+    __m128i hi = _mm_add_epi64(_mm_unpackhi_epi32(v, sign), addrHi);
+    lo = _mm_andnot_si128(_mm_unpacklo_epi32(isZero, isZero), lo);
+    hi = _mm_andnot_si128(_mm_unpackhi_epi32(isZero, isZero), hi);
+    _mm_storeu_si128((__m128i *)(targets + i), lo);
+    _mm_storeu_si128((__m128i *)(targets + i + 2), hi);
+    addrLo = _mm_add_epi64(addrLo, step);
+    addrHi = _mm_add_epi64(addrHi, step);
+  }
+#elif defined(OBJC_RELATIVE_NEON)
+  const int64x2_t step = vdupq_n_s64(16);
+  int64x2_t addrLo = vcombine_s64(vcreate_s64(base), vcreate_s64(base + 4));
+  int64x2_t addrHi =
+      vcombine_s64(vcreate_s64(base + 8), vcreate_s64(base + 12));
+  for (; i + 4 <= count; i += 4) {
+    int32x4_t v = vld1q_s32(offsets + i);
+    int64x2_t lo = vmovl_s32(vget_low_s32(v));
+    int64x2_t hi = vmovl_s32(vget_high_s32(v));
+    // Mask out the null offsets
+    uint64x2_t loNonZero = vtstq_s64(lo, lo);
+    uint64x2_t hiNonZero = vtstq_s64(hi, hi);
+    lo = vandq_s64(vaddq_s64(lo, addrLo), vreinterpretq_s64_u64(loNonZero));
+    hi = vandq_s64(vaddq_s64(hi, addrHi), vreinterpretq_s64_u64(hiNonZero));
+    vst1q_u64(targets + i, vreinterpretq_u64_s64(lo));
+    vst1q_u64(targets + i + 2, vreinterpretq_u64_s64(hi));
+    addrLo = vaddq_s64(addrLo, step);
+    addrHi = vaddq_s64(addrHi, step);
+  }
+#endif
+
+  for (; i < count; i++) {
+    targets[i] = offsets[i] ? base + (i * 4) + (int64_t)offsets[i] : 0;
+  }
+}
+
 template <class A>
 Walker<A>::Walker(Utils::ExtractionContext<A> &eCtx)
     : dCtx(*eCtx.dCtx), mCtx(*eCtx.mCtx), activity(*eCtx.activity),
       logger(eCtx.logger), bindInfo(eCtx.bindInfo), ptrTracker(eCtx.ptrTracker),
-      symbolizer(eCtx.symbolizer.value()) {}
+      symbolizer(eCtx.symbolizer.value()), symbolStore(eCtx.symbolStore),
+      accelerator(*eCtx.accelerator), threads(eCtx.threads) {}
 
 template <class A> bool Walker<A>::walkAll() {
   if (auto sect = mCtx.getSection(nullptr, "__objc_imageinfo").second; sect) {
@@ -34,142 +105,214 @@ template <class A> bool Walker<A>::walkAll() {
     bindRecords[(PtrT)bind.address] = &bind;
   }
 
-  mCtx.enumerateSections([this, &bindRecords](const auto seg, const auto sect) {
+  // Collect the roots, so they can be split between threads
+  std::vector<Root> roots;
+  mCtx.enumerateSections([&roots](const auto seg, const auto sect) {
+    RootKind kind;
+    if (memcmp(sect->sectname, "__objc_classlist", 16) == 0) {
+      kind = RootKind::classList;
+    } else if (memcmp(sect->sectname, "__objc_catlist", 15) == 0) {
+      kind = RootKind::categoryList;
+    } else if (memcmp(sect->sectname, "__objc_protolist", 16) == 0) {
+      kind = RootKind::protocolList;
+    } else if (memcmp(sect->sectname, "__objc_selrefs", 15) == 0) {
+      kind = RootKind::selectorRefs;
+    } else if (memcmp(sect->sectname, "__objc_protorefs", 16) == 0) {
+      kind = RootKind::protocolRefs;
+    } else if (memcmp(sect->sectname, "__objc_classrefs", 16) == 0) {
+      kind = RootKind::classRefs;
+    } else if (memcmp(sect->sectname, "__objc_superrefs", 16) == 0) {
+      kind = RootKind::superRefs;
+    } else {
+      return true;
+    }
+
     PtrT sectAddr = sect->addr;
     PtrT sectEnd = sectAddr + sect->size;
-
-    if (memcmp(sect->sectname, "__objc_classlist", 16) == 0) {
-      activity.update(std::nullopt, "Processing classes");
-      for (PtrT pAddr = sectAddr; pAddr < sectEnd; pAddr += sizeof(PtrT)) {
-        activity.update();
-        auto cAddr = ptrTracker.slideP(pAddr);
-
-        if (mCtx.containsAddr(cAddr)) {
-          auto &ptr = pointers.classes.try_emplace(pAddr).first->second;
-          ptr.ref = walkClass(cAddr);
-          ptr.setFinalAddr(pAddr);
-        } else {
-          SPDLOG_LOGGER_WARN(
-              logger, "Class pointer at {:#x} points outside of image.", pAddr);
-        }
-      }
+    for (PtrT pAddr = sectAddr; pAddr < sectEnd; pAddr += sizeof(PtrT)) {
+      roots.push_back({kind, pAddr});
     }
+    return true;
+  });
 
-    else if (memcmp(sect->sectname, "__objc_catlist", 15) == 0) {
-      activity.update(std::nullopt, "Processing categories");
-      for (PtrT pAddr = sectAddr; pAddr < sectEnd; pAddr += sizeof(PtrT)) {
-        activity.update();
-        auto cAddr = ptrTracker.slideP(pAddr);
+  const auto chunks =
+      Utils::chunkCount(threads, roots.size(), OBJC_MIN_ROOTS_PER_THREAD);
+  auto imageLogger = logger;
+  if (chunks > 1) {
+    // Share the image's sinks behind a lock while walking
+    logger = std::make_shared<spdlog::logger>(
+        imageLogger->name(),
+        std::make_shared<spdlog::sinks::dist_sink_mt>(imageLogger->sinks()));
+    logger->set_level(imageLogger->level());
+  }
+
+  try {
+    Utils::parallelChunks(
+        chunks, roots.size(),
+        [&](std::size_t chunkI, std::size_t begin, std::size_t end) {
+          std::optional<RootKind> currentKind;
+          for (auto i = begin; i < end; i++) {
+            const auto &root = roots[i];
+            if (chunkI == 0) {
+              // Only the calling thread updates the activity
+              if (root.kind != currentKind) {
+                activity.update(std::nullopt, rootMessage(root.kind));
+                currentKind = root.kind;
+              }
+              activity.update();
+            }
+            walkRoot(root, bindRecords);
+          }
+        });
+  } catch (...) {
+    logger = imageLogger;
+    throw;
+  }
 
-        if (mCtx.containsAddr(cAddr)) {
-          auto &ptr = pointers.categories.try_emplace(pAddr).first->second;
-          ptr.ref = walkCategory(cAddr);
-          ptr.setFinalAddr(pAddr);
-        } else {
-          SPDLOG_LOGGER_WARN(
-              logger, "Category pointer at {:#x} points outside of image.",
-              pAddr);
-        }
-      }
-    }
+  logger = imageLogger;
+  return true;
+}
 
-    else if (memcmp(sect->sectname, "__objc_protolist", 16) == 0) {
-      activity.update(std::nullopt, "Processing categories");
-      for (PtrT pAddr = sectAddr; pAddr < sectEnd; pAddr += sizeof(PtrT)) {
-        activity.update();
-        auto protoAddr = ptrTracker.slideP(pAddr);
+template <class A>
+const char *Walker<A>::rootMessage(const RootKind kind) {
+  switch (kind) {
+  case RootKind::classList:
+    return "Processing classes";
+  case RootKind::categoryList:
+    return "Processing categories";
+  case RootKind::protocolList:
+    return "Processing protocols";
+  case RootKind::selectorRefs:
+    return "Processing selector references";
+  case RootKind::protocolRefs:
+    return "Processing protocol references";
+  case RootKind::classRefs:
+    return "Processing class references";
+  case RootKind::superRefs:
+    return "Processing super class references";
+  default:
+    Utils::unreachable();
+  }
+}
 
-        if (mCtx.containsAddr(protoAddr)) {
-          auto &ptr = pointers.protocols.try_emplace(pAddr).first->second;
-          ptr.ref = walkProtocol(protoAddr);
-          ptr.setFinalAddr(pAddr);
-        } else {
-          SPDLOG_LOGGER_WARN(
-              logger, "Protocol pointer at {:#x} points outside of image.",
-              pAddr);
-        }
-      }
+template <class A>
+void Walker<A>::walkRoot(
+    const Root &root,
+    const std::map<PtrT, const Provider::BindRecord *> &bindRecords) {
+  const PtrT pAddr = root.addr;
+
+  switch (root.kind) {
+  case RootKind::classList: {
+    auto cAddr = ptrTracker.slideP(pAddr);
+
+    if (mCtx.containsAddr(cAddr)) {
+      auto &ptr = pointers.classes.try_emplace(pAddr).first->second;
+      ptr.ref = walkClass(cAddr);
+      ptr.setFinalAddr(pAddr);
+    } else {
+      SPDLOG_LOGGER_WARN(logger,
+                         "Class pointer at {:#x} points outside of image.",
+                         pAddr);
     }
+    break;
+  }
 
-    else if (memcmp(sect->sectname, "__objc_selrefs", 15) == 0) {
-      activity.update(std::nullopt, "Processing selector references");
-      for (PtrT pAddr = sectAddr; pAddr < sectEnd; pAddr += sizeof(PtrT)) {
-        activity.update();
-        auto stringAddr = ptrTracker.slideP(pAddr);
+  case RootKind::categoryList: {
+    auto cAddr = ptrTracker.slideP(pAddr);
 
-        auto &ptr = pointers.selectorRefs.try_emplace(pAddr).first->second;
-        ptr.ref = walkString(stringAddr);
-        ptr.setFinalAddr(pAddr);
-      }
+    if (mCtx.containsAddr(cAddr)) {
+      auto &ptr = pointers.categories.try_emplace(pAddr).first->second;
+      ptr.ref = walkCategory(cAddr);
+      ptr.setFinalAddr(pAddr);
+    } else {
+      SPDLOG_LOGGER_WARN(logger,
+                         "Category pointer at {:#x} points outside of image.",
+                         pAddr);
     }
+    break;
+  }
 
-    else if (memcmp(sect->sectname, "__objc_protorefs", 16) == 0) {
-      activity.update(std::nullopt, "Processing protocol references");
-      for (PtrT pAddr = sectAddr; pAddr < sectEnd; pAddr += sizeof(PtrT)) {
-        activity.update();
-        auto protoAddr = ptrTracker.slideP(pAddr);
+  case RootKind::protocolList: {
+    auto protoAddr = ptrTracker.slideP(pAddr);
 
-        auto &ptr = pointers.protocolRefs.try_emplace(pAddr).first->second;
-        ptr.ref = walkProtocol(protoAddr);
-        ptr.setFinalAddr(pAddr);
-      }
+    if (mCtx.containsAddr(protoAddr)) {
+      auto &ptr = pointers.protocols.try_emplace(pAddr).first->second;
+      ptr.ref = walkProtocol(protoAddr);
+      ptr.setFinalAddr(pAddr);
+    } else {
+      SPDLOG_LOGGER_WARN(logger,
+                         "Protocol pointer at {:#x} points outside of image.",
+                         pAddr);
     }
+    break;
+  }
 
-    else if (memcmp(sect->sectname, "__objc_classrefs", 16) == 0) {
-      activity.update(std::nullopt, "Processing class references");
-      for (PtrT pAddr = sectAddr; pAddr < sectEnd; pAddr += sizeof(PtrT)) {
-        activity.update();
-        auto classAddr = ptrTracker.slideP(pAddr);
-
-        auto &ptr = pointers.classRefs.try_emplace(pAddr).first->second;
-        ptr.setFinalAddr(pAddr);
-
-        if (mCtx.containsAddr(classAddr)) {
-          ptr.ref = walkClass(classAddr);
-        } else if (symbolizer.containsAddr(classAddr)) {
-          ptr.bind = symbolizer.shareInfo(classAddr);
-        } else if (bindRecords.contains(pAddr)) {
-          auto record = bindRecords.at(pAddr);
-          ptr.bind = std::make_shared<Provider::SymbolicInfo>(
-              Provider::SymbolicInfo::Symbol{std::string(record->symbolName),
-                                             (uint64_t)record->libOrdinal,
-                                             std::nullopt},
-              Provider::SymbolicInfo::Encoding::None);
-        } else {
-          SPDLOG_LOGGER_WARN(logger,
-                             "Unable to fix class ref at {:#x} -> {:#x}.",
-                             pAddr, classAddr);
-          pointers.classRefs.erase(pAddr);
-        }
-      }
-    }
+  case RootKind::selectorRefs: {
+    auto stringAddr = ptrTracker.slideP(pAddr);
 
-    else if (memcmp(sect->sectname, "__objc_superrefs", 16) == 0) {
-      activity.update(std::nullopt, "Processing super class references");
-      for (PtrT pAddr = sectAddr; pAddr < sectEnd; pAddr += sizeof(PtrT)) {
-        activity.update();
-        auto superAddr = ptrTracker.slideP(pAddr);
+    auto &ptr = pointers.selectorRefs.try_emplace(pAddr).first->second;
+    ptr.ref = walkString(stringAddr);
+    ptr.setFinalAddr(pAddr);
+    break;
+  }
 
-        auto &ptr = pointers.superRefs.try_emplace(pAddr).first->second;
-        ptr.setFinalAddr(pAddr);
+  case RootKind::protocolRefs: {
+    auto protoAddr = ptrTracker.slideP(pAddr);
 
-        if (mCtx.containsAddr(superAddr)) {
-          ptr.ref = walkClass(superAddr);
-        } else if (symbolizer.containsAddr(superAddr)) {
-          ptr.bind = symbolizer.shareInfo(superAddr);
-        } else {
-          SPDLOG_LOGGER_WARN(logger,
-                             "Unable to fix super class ref at {:#x} -> {:#x}.",
-                             pAddr, superAddr);
-          pointers.superRefs.erase(pAddr);
-        }
-      }
+    auto &ptr = pointers.protocolRefs.try_emplace(pAddr).first->second;
+    ptr.ref = walkProtocol(protoAddr);
+    ptr.setFinalAddr(pAddr);
+    break;
+  }
+
+  case RootKind::classRefs: {
+    auto classAddr = ptrTracker.slideP(pAddr);
+
+    auto &ptr = pointers.classRefs.try_emplace(pAddr).first->second;
+    ptr.setFinalAddr(pAddr);
+
+    if (mCtx.containsAddr(classAddr)) {
+      ptr.ref = walkClass(classAddr);
+    } else if (symbolizer.containsAddr(classAddr)) {
+      ptr.bind = symbolizer.shareInfo(classAddr);
+    } else if (bindRecords.contains(pAddr)) {
+      auto record = bindRecords.at(pAddr);
+      std::lock_guard lock(symbolStoreMutex);
+      ptr.bind = &symbolStore.get(symbolStore.intern(
+          Provider::SymbolicInfo::Symbol{std::string(record->symbolName),
+                                         (uint64_t)record->libOrdinal,
+                                         std::nullopt},
+          Provider::SymbolicInfo::Encoding::None));
+    } else {
+      SPDLOG_LOGGER_WARN(logger, "Unable to fix class ref at {:#x} -> {:#x}.",
+                         pAddr, classAddr);
+      pointers.classRefs.erase(pAddr);
     }
+    break;
+  }
 
-    return true;
-  });
+  case RootKind::superRefs: {
+    auto superAddr = ptrTracker.slideP(pAddr);
 
-  return true;
+    auto &ptr = pointers.superRefs.try_emplace(pAddr).first->second;
+    ptr.setFinalAddr(pAddr);
+
+    if (mCtx.containsAddr(superAddr)) {
+      ptr.ref = walkClass(superAddr);
+    } else if (symbolizer.containsAddr(superAddr)) {
+      ptr.bind = symbolizer.shareInfo(superAddr);
+    } else {
+      SPDLOG_LOGGER_WARN(logger,
+                         "Unable to fix super class ref at {:#x} -> {:#x}.",
+                         pAddr, superAddr);
+      pointers.superRefs.erase(pAddr);
+    }
+    break;
+  }
+
+  default:
+    Utils::unreachable();
+  }
 }
 
 template <class A> bool Walker<A>::parseOptInfo() {
@@ -274,14 +417,18 @@ template <class A> bool Walker<A>::parseOptInfo() {
 }
 
 template <class A> ClassAtom<A> *Walker<A>::walkClass(const PtrT addr) {
-  if (atoms.classes.contains(addr)) {
-    return &atoms.classes.at(addr);
+  if (auto atom = atoms.classes.get(addr); atom) {
+    return atom;
   }
 
   // Make new atom
-  auto &atom =
-    atoms.classes.try_emplace(addr, ptrTracker.template slideS<Objc::class_t<P>>(addr))
-          .first->second;
+  auto [entry, inserted] = atoms.classes.try_emplace(
+      addr, ptrTracker.template slideS<Objc::class_t<P>>(addr));
+  auto &atom = entry->second;
+  if (!inserted) {
+    // Walked on another thread
+    return &atom;
+  }
 
   // Walk data
   if (auto isaAddr = atom.data.isa; isaAddr) {
@@ -347,15 +494,18 @@ template <class A> ClassAtom<A> *Walker<A>::walkClass(const PtrT addr) {
 }
 
 template <class A> ClassDataAtom<A> *Walker<A>::walkClassData(const PtrT addr) {
-  if (atoms.classData.contains(addr)) {
-    return &atoms.classData.at(addr);
+  if (auto atom = atoms.classData.get(addr); atom) {
+    return atom;
   }
 
   // Make new atom
-  auto &atom =
-      atoms.classData
-        .try_emplace(addr, ptrTracker.template slideS<Objc::class_data_t<P>>(addr))
-          .first->second;
+  auto [entry, inserted] = atoms.classData.try_emplace(
+      addr, ptrTracker.template slideS<Objc::class_data_t<P>>(addr));
+  auto &atom = entry->second;
+  if (!inserted) {
+    // Walked on another thread
+    return &atom;
+  }
 
   // Walk data
   if (atom.data.ivarLayout) {
@@ -424,8 +574,8 @@ template <class A> ClassDataAtom<A> *Walker<A>::walkClassData(const PtrT addr) {
 
 template <class A>
 IvarLayoutAtom<typename A::P> *Walker<A>::walkIvarLayout(const PtrT addr) {
-  if (atoms.ivarLayouts.contains(addr)) {
-    return &atoms.ivarLayouts.at(addr);
+  if (auto atom = atoms.ivarLayouts.get(addr); atom) {
+    return atom;
   }
 
   // Make new atom
@@ -435,8 +585,8 @@ IvarLayoutAtom<typename A::P> *Walker<A>::walkIvarLayout(const PtrT addr) {
 
 template <class A>
 StringAtom<typename A::P> *Walker<A>::walkString(const PtrT addr) {
-  if (atoms.strings.contains(addr)) {
-    return &atoms.strings.at(addr);
+  if (auto atom = atoms.strings.get(addr); atom) {
+    return atom;
   }
 
   // Make new atom
@@ -457,12 +607,17 @@ MethodListAtom<typename A::P> *Walker<A>::walkMethodList(const PtrT addr) {
 template <class A>
 SmallMethodListAtom<typename A::P> *
 Walker<A>::walkSmallMethodList(const PtrT addr, Objc::method_list_t data) {
-  if (atoms.smallMethodLists.contains(addr)) {
-    return &atoms.smallMethodLists.at(addr);
+  if (auto atom = atoms.smallMethodLists.get(addr); atom) {
+    return atom;
   }
 
   // Make new atom
-  auto &atom = atoms.smallMethodLists.try_emplace(addr, data).first->second;
+  auto [entry, inserted] = atoms.smallMethodLists.try_emplace(addr, data);
+  auto &atom = entry->second;
+  if (!inserted) {
+    // Walked on another thread
+    return &atom;
+  }
 
   // Remove flag
   if (atom.data.entsizeAndFlags &
@@ -489,36 +644,50 @@ Walker<A>::walkSmallMethodList(const PtrT addr, Objc::method_list_t data) {
   }
 
   PtrT methodAddr = addr + sizeof(Objc::method_list_t);
-  for (uint32_t i = 0; i < atom.data.count; i++, methodAddr += entsize) {
-    auto &methodAtom =
-      atom.entries.emplace_back(ptrTracker.template slideS<MethodT>(methodAddr));
-
-    // Walk data
-    if (auto nameAddr = methodAtom.data.name; nameAddr) {
-      PtrT targetAddr;
+  const auto methods =
+      ptrTracker.template slideArray<MethodT>(methodAddr, atom.data.count);
+
+  // Resolve the name, types, and imp of every method at once
+  static_assert(sizeof(MethodT) == sizeof(int32_t) * 3);
+  std::vector<uint64_t> targets(methods.size() * 3);
+  decodeRelativeOffsets(reinterpret_cast<const int32_t *>(methods.data()),
+                        methodAddr, targets.size(), targets.data());
+
+  std::vector<PtrT> selAddrs;
+  selAddrs.reserve(methods.size());
+  for (uint32_t i = 0; i < methods.size(); i++) {
+    if (auto nameAddr = methods[i].name; nameAddr) {
       if (relMethodSelBaseAddr) {
-        targetAddr = *relMethodSelBaseAddr + nameAddr;
+        selAddrs.push_back(*relMethodSelBaseAddr + nameAddr);
       } else {
-        targetAddr = methodAddr + (PtrT)offsetof(MethodT, name) + nameAddr;
+        selAddrs.push_back((PtrT)targets[i * 3]);
       }
+    }
+  }
+  const auto selRefs = makeSmallMethodSelRefs(selAddrs);
 
-      methodAtom.name.ref = makeSmallMethodSelRef(targetAddr);
+  auto selRefIt = selRefs.begin();
+  atom.entries.reserve(atom.data.count);
+  for (uint32_t i = 0; i < atom.data.count; i++, methodAddr += entsize) {
+    auto &methodAtom = atom.entries.emplace_back(methods[i]);
+
+    // Walk data
+    if (methodAtom.data.name) {
+      methodAtom.name.ref = *selRefIt++;
     } else {
       SPDLOG_LOGGER_WARN(logger, "Method at {:#x} doesn't have a name.",
                          methodAddr);
     }
 
-    if (auto typesAddr = methodAtom.data.types; typesAddr) {
-      PtrT targetAddr = methodAddr + (PtrT)offsetof(MethodT, types) + typesAddr;
-      methodAtom.types.ref = walkString(targetAddr);
+    if (methodAtom.data.types) {
+      methodAtom.types.ref = walkString((PtrT)targets[i * 3 + 1]);
     } else {
       SPDLOG_LOGGER_WARN(logger, "Method at {:#x} doesn't have a type.",
                          methodAddr);
     }
 
     if (methodAtom.data.imp) {
-      PtrT targetAddr =
-          methodAddr + (PtrT)offsetof(MethodT, imp) + methodAtom.data.imp;
+      const PtrT targetAddr = (PtrT)targets[i * 3 + 2];
       if (mCtx.containsAddr(targetAddr)) {
         methodAtom.imp.ref = walkImp(targetAddr);
       } else {
@@ -538,12 +707,17 @@ LargeMethodListAtom<typename A::P> *
 Walker<A>::walkLargeMethodList(const PtrT addr, Objc::method_list_t data) {
   assert(!data.usesRelativeMethods());
 
-  if (atoms.largeMethodLists.contains(addr)) {
-    return &atoms.largeMethodLists.at(addr);
+  if (auto atom = atoms.largeMethodLists.get(addr); atom) {
+    return atom;
   }
 
   // make new atom
-  auto &atom = atoms.largeMethodLists.try_emplace(addr, data).first->second;
+  auto [entry, inserted] = atoms.largeMethodLists.try_emplace(addr, data);
+  auto &atom = entry->second;
+  if (!inserted) {
+    // Walked on another thread
+    return &atom;
+  }
 
   // walk methods
   using MethodT = Objc::method_large_t<P>;
@@ -557,9 +731,11 @@ Walker<A>::walkLargeMethodList(const PtrT addr, Objc::method_list_t data) {
   }
 
   PtrT methodAddr = addr + sizeof(Objc::method_list_t);
+  const auto methods =
+      ptrTracker.template slideArray<MethodT>(methodAddr, atom.data.count);
+  atom.entries.reserve(atom.data.count);
   for (uint32_t i = 0; i < atom.data.count; i++, methodAddr += entsize) {
-    auto &methodAtom =
-      atom.entries.emplace_back(ptrTracker.template slideS<MethodT>(methodAddr));
+    auto &methodAtom = atom.entries.emplace_back(methods[i]);
 
     // Walk data
     if (methodAtom.data.name) {
@@ -593,20 +769,48 @@ Walker<A>::walkLargeMethodList(const PtrT addr, Objc::method_list_t data) {
 
 template <class A>
 ProtocolListAtom<A> *Walker<A>::walkProtocolList(const PtrT addr) {
-  if (atoms.protocolLists.contains(addr)) {
-    return &atoms.protocolLists.at(addr);
+  if (auto atom = atoms.protocolLists.get(addr); atom) {
+    return atom;
+  }
+
+  // Lists outside the image are shared between images
+  std::shared_ptr<const std::vector<PtrT>> shared;
+  if (!mCtx.containsAddr(addr)) {
+    if (auto cached = accelerator.objcProtocolLists.get(addr); cached) {
+      shared = *cached;
+    }
   }
 
   // Make new atom
-  auto &atom =
-      atoms.protocolLists
-        .try_emplace(addr, ptrTracker.template slideS<Objc::protocol_list_t<P>>(addr))
-          .first->second;
+  auto [entry, inserted] =
+      shared ? atoms.protocolLists.try_emplace(
+                   addr, Objc::protocol_list_t<P>{(PtrT)shared->size()})
+             : atoms.protocolLists.try_emplace(
+                   addr,
+                   ptrTracker.template slideS<Objc::protocol_list_t<P>>(addr));
+  auto &atom = entry->second;
+  if (!inserted) {
+    // Walked on another thread
+    return &atom;
+  }
 
   // Walk data
-  PtrT protoRefAddr = addr + sizeof(Objc::protocol_list_t<P>);
-  for (PtrT i = 0; i < atom.data.count; i++, protoRefAddr += sizeof(PtrT)) {
-    PtrT protoAddr = ptrTracker.slideP(protoRefAddr);
+  if (!shared) {
+    auto protoAddrs = std::make_shared<std::vector<PtrT>>();
+    PtrT protoRefAddr = addr + sizeof(Objc::protocol_list_t<P>);
+    protoAddrs->reserve(atom.data.count);
+    for (PtrT i = 0; i < atom.data.count; i++, protoRefAddr += sizeof(PtrT)) {
+      protoAddrs->push_back(ptrTracker.slideP(protoRefAddr));
+    }
+
+    shared = std::move(protoAddrs);
+    if (!mCtx.containsAddr(addr)) {
+      accelerator.objcProtocolLists.insert(addr, shared);
+    }
+  }
+
+  atom.entries.reserve(shared->size());
+  for (const auto protoAddr : *shared) {
     atom.entries.emplace_back().ref = walkProtocol(protoAddr);
   }
 
@@ -614,15 +818,29 @@ ProtocolListAtom<A> *Walker<A>::walkProtocolList(const PtrT addr) {
 }
 
 template <class A> ProtocolAtom<A> *Walker<A>::walkProtocol(const PtrT addr) {
-  if (atoms.protocols.contains(addr)) {
-    return &atoms.protocols.at(addr);
+  if (auto atom = atoms.protocols.get(addr); atom) {
+    return atom;
+  }
+
+  // Protocols outside the image are shared between images
+  std::optional<Objc::protocol_t<P>> data;
+  if (!mCtx.containsAddr(addr)) {
+    data = accelerator.objcProtocols.get(addr);
+    if (!data) {
+      data = ptrTracker.template slideS<Objc::protocol_t<P>>(addr);
+      accelerator.objcProtocols.insert(addr, *data);
+    }
+  } else {
+    data = ptrTracker.template slideS<Objc::protocol_t<P>>(addr);
   }
 
   // Make new atom
-  auto &atom =
-      atoms.protocols
-        .try_emplace(addr, ptrTracker.template slideS<Objc::protocol_t<P>>(addr))
-          .first->second;
+  auto [entry, inserted] = atoms.protocols.try_emplace(addr, *data);
+  auto &atom = entry->second;
+  if (!inserted) {
+    // Walked on another thread
+    return &atom;
+  }
 
   // Walk data
   if (auto isaAddr = atom.data.isa; isaAddr) {
@@ -698,15 +916,18 @@ template <class A> ProtocolAtom<A> *Walker<A>::walkProtocol(const PtrT addr) {
 
 template <class A>
 PropertyListAtom<typename A::P> *Walker<A>::walkPropertyList(const PtrT addr) {
-  if (atoms.propertyLists.contains(addr)) {
-    return &atoms.propertyLists.at(addr);
+  if (auto atom = atoms.propertyLists.get(addr); atom) {
+    return atom;
   }
 
   // Make new atom
-  auto &atom =
-      atoms.propertyLists
-        .try_emplace(addr, ptrTracker.template slideS<Objc::property_list_t>(addr))
-          .first->second;
+  auto [entry, inserted] = atoms.propertyLists.try_emplace(
+      addr, ptrTracker.template slideS<Objc::property_list_t>(addr));
+  auto &atom = entry->second;
+  if (!inserted) {
+    // Walked on another thread
+    return &atom;
+  }
 
   auto entsize = atom.data.entsize;
   if (entsize != sizeof(Objc::property_t<P>)) {
@@ -719,9 +940,11 @@ PropertyListAtom<typename A::P> *Walker<A>::walkPropertyList(const PtrT addr) {
 
   // Walk data
   PtrT propertyAddr = addr + sizeof(Objc::property_list_t);
+  const auto properties = ptrTracker.template slideArray<Objc::property_t<P>>(
+      propertyAddr, atom.data.count);
+  atom.entries.reserve(atom.data.count);
   for (uint32_t i = 0; i < atom.data.count; i++, propertyAddr += entsize) {
-    auto &property = atom.entries.emplace_back(
-                                               ptrTracker.template slideS<Objc::property_t<P>>(propertyAddr));
+    auto &property = atom.entries.emplace_back(properties[i]);
 
     if (property.data.name) {
       property.name.ref = walkString(property.data.name);
@@ -744,20 +967,25 @@ PropertyListAtom<typename A::P> *Walker<A>::walkPropertyList(const PtrT addr) {
 template <class A>
 ExtendedMethodTypesAtom<typename A::P> *
 Walker<A>::walkExtendedMethodTypes(const PtrT addr, const uint32_t count) {
-  if (atoms.extendedMethodTypes.contains(addr)) {
-    auto &atom = atoms.extendedMethodTypes.at(addr);
-    if (atom.entries.size() != count) {
+  if (auto atom = atoms.extendedMethodTypes.get(addr); atom) {
+    if (atom->count != count) {
       SPDLOG_LOGGER_WARN(
           logger, "Conflicting count for extendedMethodTypes at {:#x}.", addr);
-      return &atom;
     }
+    return atom;
   }
 
   // Make new atom
-  auto &atom = atoms.extendedMethodTypes.try_emplace(addr).first->second;
+  auto [entry, inserted] = atoms.extendedMethodTypes.try_emplace(addr, count);
+  auto &atom = entry->second;
+  if (!inserted) {
+    // Walked on another thread
+    return &atom;
+  }
 
   // walk data
   PtrT pAddr = addr;
+  atom.entries.reserve(count);
   for (uint32_t i = 0; i < count; i++, pAddr += sizeof(PtrT)) {
     atom.entries.emplace_back().ref = walkString(ptrTracker.slideP(pAddr));
   }
@@ -766,15 +994,18 @@ Walker<A>::walkExtendedMethodTypes(const PtrT addr, const uint32_t count) {
 }
 
 template <class A> IvarListAtom<A> *Walker<A>::walkIvarList(const PtrT addr) {
-  if (atoms.ivarLists.contains(addr)) {
-    return &atoms.ivarLists.at(addr);
+  if (auto atom = atoms.ivarLists.get(addr); atom) {
+    return atom;
   }
 
   // Make new atom
-  auto &atom =
-      atoms.ivarLists
-        .try_emplace(addr, ptrTracker.template slideS<Objc::ivar_list_t>(addr))
-          .first->second;
+  auto [entry, inserted] = atoms.ivarLists.try_emplace(
+      addr, ptrTracker.template slideS<Objc::ivar_list_t>(addr));
+  auto &atom = entry->second;
+  if (!inserted) {
+    // Walked on another thread
+    return &atom;
+  }
 
   auto entsize = atom.data.entsize;
   if (entsize != sizeof(Objc::ivar_t<P>)) {
@@ -787,9 +1018,11 @@ template <class A> IvarListAtom<A> *Walker<A>::walkIvarList(const PtrT addr) {
 
   // Walk data
   PtrT ivarAddr = addr + sizeof(Objc::ivar_list_t);
+  const auto ivars =
+      ptrTracker.template slideArray<Objc::ivar_t<P>>(ivarAddr, atom.data.count);
+  atom.entries.reserve(atom.data.count);
   for (uint32_t i = 0; i < atom.data.count; i++, ivarAddr += entsize) {
-    auto &ivar =
-      atom.entries.emplace_back(ptrTracker.template slideS<Objc::ivar_t<P>>(ivarAddr));
+    auto &ivar = atom.entries.emplace_back(ivars[i]);
 
     // Process data
     if (ivar.data.offset) {
@@ -819,8 +1052,8 @@ template <class A> IvarListAtom<A> *Walker<A>::walkIvarList(const PtrT addr) {
 
 template <class A>
 IvarOffsetAtom<A> *Walker<A>::walkIvarOffset(const PtrT addr) {
-  if (atoms.ivarOffsets.contains(addr)) {
-    return &atoms.ivarOffsets.at(addr);
+  if (auto atom = atoms.ivarOffsets.get(addr); atom) {
+    return atom;
   }
 
   // Make new atom
@@ -830,16 +1063,19 @@ IvarOffsetAtom<A> *Walker<A>::walkIvarOffset(const PtrT addr) {
 }
 
 template <class A> CategoryAtom<A> *Walker<A>::walkCategory(const PtrT addr) {
-  if (atoms.categories.contains(addr)) {
-    return &atoms.categories.at(addr);
+  if (auto atom = atoms.categories.get(addr); atom) {
+    return atom;
   }
 
   // Make new atom
-  auto &atom =
-      atoms.categories
-        .try_emplace(addr, ptrTracker.template slideS<Objc::category_t<P>>(addr),
-                       hasCategoryClassProperties)
-          .first->second;
+  auto [entry, inserted] = atoms.categories.try_emplace(
+      addr, ptrTracker.template slideS<Objc::category_t<P>>(addr),
+      hasCategoryClassProperties);
+  auto &atom = entry->second;
+  if (!inserted) {
+    // Walked on another thread
+    return &atom;
+  }
 
   // walk data
   if (atom.data.name) {
@@ -892,14 +1128,18 @@ template <class A> CategoryAtom<A> *Walker<A>::walkCategory(const PtrT addr) {
 }
 
 template <class A> ImpAtom<typename A::P> *Walker<A>::walkImp(const PtrT addr) {
-  if (atoms.imps.contains(addr)) {
-    return &atoms.imps.at(addr);
+  if (auto atom = atoms.imps.get(addr); atom) {
+    return atom;
   }
 
   // Make atom
-  auto &atom =
-      atoms.imps.try_emplace(addr, (const uint8_t *)dCtx.convertAddrP(addr))
-          .first->second;
+  auto [entry, inserted] =
+      atoms.imps.try_emplace(addr, (const uint8_t *)dCtx.convertAddrP(addr));
+  auto &atom = entry->second;
+  if (!inserted) {
+    // Walked on another thread
+    return &atom;
+  }
 
   // Set finalAddr now
   atom.setFinalAddr(addr);
@@ -907,16 +1147,25 @@ template <class A> ImpAtom<typename A::P> *Walker<A>::walkImp(const PtrT addr) {
 }
 
 template <class A>
-PointerAtom<typename A::P, StringAtom<typename A::P>> *
-Walker<A>::makeSmallMethodSelRef(const PtrT stringAddr) {
-  if (atoms.smallMethodSelRefs.contains(stringAddr)) {
-    return &atoms.smallMethodSelRefs.at(stringAddr);
+std::vector<PointerAtom<typename A::P, StringAtom<typename A::P>> *>
+Walker<A>::makeSmallMethodSelRefs(const std::vector<PtrT> &stringAddrs) {
+  // Find or make all atoms with one lock
+  using EntryT = CacheT<PointerAtom<P, StringAtom<P>>>::Entry;
+  std::vector<std::pair<EntryT *, bool>> entries(stringAddrs.size());
+  atoms.smallMethodSelRefs.try_emplace_all(stringAddrs.data(),
+                                           stringAddrs.size(), entries.data());
+
+  std::vector<PointerAtom<P, StringAtom<P>> *> refs;
+  refs.reserve(entries.size());
+  for (auto [entry, inserted] : entries) {
+    auto &atom = entry->second;
+    if (inserted) {
+      // Others are walked already, or on another thread
+      atom.ref = walkString(entry->first);
+    }
+    refs.push_back(&atom);
   }
-
-  // Make new atom
-  auto &atom = atoms.smallMethodSelRefs.try_emplace(stringAddr).first->second;
-  atom.ref = walkString(stringAddr);
-  return &atom;
+  return refs;
 }
 
 template <class A>
@@ -936,7 +1185,7 @@ Walker<A>::findInImageRelList(const PtrT addr) const {
   // Iterate in reverse, seems like the target is always at the end
   auto relListsAddr = addr + (PtrT)sizeof(Objc::relative_list_list_t);
   auto relLists = (Objc::relative_list_t *)mCtx.convertAddrP(relListsAddr);
-  for (auto i = relListList.count - 1; i >= 0; i--) {
+  for (auto i = relListList.count; i-- > 0;) {
     auto entry = relLists + i;
     if (entry->getImageIndex() == imageIndex && entry->getOffset()) {
       return (PtrT)(relListsAddr + (i * sizeof(Objc::relative_list_t)) +
@@ -4,6 +4,8 @@
 #include "Atoms.h"
 #include <Objc/Abstraction.h>
 #include <Utils/ExtractionContext.h>
+#include <map>
+#include <mutex>
 #include <optional>
 
 namespace DyldExtractor::Converter::ObjcFixer {
@@ -18,11 +20,36 @@ template <class A> class Walker {
 
 public:
   Walker(Utils::ExtractionContext<A> &eCtx);
+
+  /// @brief Walk all ObjC metadata in the image.
+  ///
+  /// The roots in the ObjC sections are split between the context's threads,
+  /// atoms that are shared between roots are only walked once.
   bool walkAll();
 
 private:
+  /// @brief The section a root pointer is in
+  enum class RootKind {
+    classList,
+    categoryList,
+    protocolList,
+    selectorRefs,
+    protocolRefs,
+    classRefs,
+    superRefs
+  };
+
+  struct Root {
+    RootKind kind;
+    PtrT addr;
+  };
+
   bool parseOptInfo();
 
+  void walkRoot(const Root &root,
+                const std::map<PtrT, const Provider::BindRecord *> &bindRecords);
+  static const char *rootMessage(const RootKind kind);
+
   ClassAtom<A> *walkClass(const PtrT addr);
   ClassDataAtom<A> *walkClassData(const PtrT addr);
   IvarLayoutAtom<P> *walkIvarLayout(const PtrT addr);
@@ -42,7 +69,11 @@ private:
   CategoryAtom<A> *walkCategory(const PtrT addr);
   ImpAtom<P> *walkImp(const PtrT addr);
 
-  PointerAtom<P, StringAtom<P>> *makeSmallMethodSelRef(const PtrT stringAddr);
+  /// @brief Get the selector reference atoms of all methods in a list.
+  /// @param stringAddrs The addresses of the selector strings.
+  /// @returns The atom for each address.
+  std::vector<PointerAtom<P, StringAtom<P>> *>
+  makeSmallMethodSelRefs(const std::vector<PtrT> &stringAddrs);
 
   /// @brief Find the list in a relative_list_list_t with the same image index.
   /// @param addr VM address of the relative_list_list_t
@@ -57,13 +88,17 @@ private:
   Provider::BindInfo<P> &bindInfo;
   Provider::PointerTracker<P> &ptrTracker;
   Provider::Symbolizer<A> &symbolizer;
+  Provider::SymbolicInfoStore &symbolStore;
+  Provider::Accelerator<P> &accelerator;
+  std::mutex symbolStoreMutex;
+  const unsigned int threads;
 
   uint16_t imageIndex;
   bool hasCategoryClassProperties = false;
   std::optional<PtrT> relMethodSelBaseAddr;
 
   /// @brief Cache of atoms, keys are the original addresses
-  template <class T> using CacheT = std::map<PtrT, T>;
+  template <class T> using CacheT = AtomMap<PtrT, T>;
   struct {
     CacheT<ClassAtom<A>> classes;
     CacheT<ClassDataAtom<A>> classData;
@@ -3,6 +3,8 @@
 #include <Macho/Loader.h>
 #include <Objc/Abstraction.h>
 #include <Utils/Utils.h>
+#include <algorithm>
+#include <cstring>
 #include <exception>
 
 using namespace DyldExtractor;
@@ -56,18 +58,18 @@ template <class A> bool checkExtraObjc(Utils::ExtractionContext<A> &eCtx) {
 }
 
 template <class A>
-std::vector<OffsetWriteProcedure>
-Converter::optimizeOffsets(Utils::ExtractionContext<A> &eCtx) {
+OutputPlan Converter::planOutput(Utils::ExtractionContext<A> &eCtx) {
   eCtx.activity->update("Offset Optimizer", "Updating Offsets");
   auto &mCtx = *eCtx.mCtx;
 
-  std::vector<OffsetWriteProcedure> procedures;
+  OutputPlan plan;
+  auto &procedures = plan.procedures;
 
   if (!eCtx.leTracker) {
     SPDLOG_LOGGER_ERROR(
         eCtx.logger,
         "Offset optimizer and output depends on linkedit optimizer.");
-    return procedures; // empty
+    return plan; // empty
   }
 
   // verify sizes
@@ -77,7 +79,7 @@ Converter::optimizeOffsets(Utils::ExtractionContext<A> &eCtx) {
       SPDLOG_LOGGER_ERROR(eCtx.logger,
                           "Segment has too big of a fileoff or filesize, "
                           "likely a malformed segment command.");
-      return procedures; // empty
+      return plan; // empty
     }
   }
 
@@ -120,16 +122,36 @@ Converter::optimizeOffsets(Utils::ExtractionContext<A> &eCtx) {
     if (isLinkedit) {
       eCtx.leTracker->changeOffset((uint32_t)seg.command->fileoff);
     }
+    plan.segments.push_back({std::string(seg.command->segname,
+                                         strnlen(seg.command->segname, 16)),
+                             seg.command->fileoff, seg.command->filesize});
 
     // update and page align dataHead
     dataHead += (uint32_t)seg.command->filesize;
     Utils::align(&dataHead, SEGMENT_ALIGNMENT);
   }
 
-  return procedures;
+  // The extra ObjC data is placed inside of the segment it extends
+  std::stable_sort(procedures.begin(), procedures.end(),
+                   [](const auto &a, const auto &b) {
+                     return a.writeOffset < b.writeOffset;
+                   });
+  for (const auto &procedure : procedures) {
+    plan.fileSize =
+        std::max(plan.fileSize, procedure.writeOffset + procedure.size);
+  }
+  return plan;
+}
+
+template <class A>
+std::vector<OffsetWriteProcedure>
+Converter::optimizeOffsets(Utils::ExtractionContext<A> &eCtx) {
+  return planOutput(eCtx).procedures;
 }
 
 #define X(T)                                                                   \
+  template OutputPlan Converter::planOutput<T>(Utils::ExtractionContext<T> &   \
+                                               eCtx);                          \
   template std::vector<OffsetWriteProcedure> Converter::optimizeOffsets<T>(    \
       Utils::ExtractionContext<T> & eCtx);
 X(Utils::Arch::x86_64)
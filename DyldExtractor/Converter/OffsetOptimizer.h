@@ -3,6 +3,8 @@
 
 #include <Utils/Architectures.h>
 #include <Utils/ExtractionContext.h>
+#include <string>
+#include <vector>
 
 #define SEGMENT_ALIGNMENT 0x4000
 
@@ -19,6 +21,27 @@ struct OffsetWriteProcedure {
                          ): writeOffset(writeOffset), source(source), size(size) {}
 };
 
+/// @brief The range of a segment in an output file.
+struct OutputSegment {
+  std::string name;
+  uint64_t fileOffset;
+  uint64_t fileSize;
+};
+
+/// @brief The layout of an output file, so that outputs can be sized once.
+struct OutputPlan {
+  /// The write procedures, sorted by offset.
+  std::vector<OffsetWriteProcedure> procedures;
+  /// The segments, in file order.
+  std::vector<OutputSegment> segments;
+  /// The size of the file, the end of the last procedure.
+  uint64_t fileSize = 0;
+};
+
+/// @brief Optimize a mach-o file's offsets for output.
+/// @returns The layout of the output file, procedures are empty on failure.
+template <class A> OutputPlan planOutput(Utils::ExtractionContext<A> &eCtx);
+
 /// @brief Optimize a mach-o file's offsets for output.
 /// @returns A vector of write procedures.
 template <class A>
@@ -0,0 +1,617 @@
+#include "OutputWriter.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fmt/format.h>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef DYLDEXTRACTORC_ZSTD
+#include <zstd.h>
+#endif
+
+#ifndef _WIN32
+#include <climits>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+using namespace DyldExtractor;
+using namespace Converter;
+
+#ifndef _WIN32
+
+/// @brief Write all iovecs, retrying on partial writes.
+static bool pwriteAll(int fd, std::vector<iovec> &iovs, off_t offset) {
+  auto it = iovs.begin();
+  while (true) {
+    // Skip empty buffers, so a write of 0 bytes means no progress
+    while (it != iovs.end() && !it->iov_len) {
+      it++;
+    }
+    if (it == iovs.end()) {
+      break;
+    }
+
+    const int count = (int)std::min<std::size_t>(iovs.end() - it, IOV_MAX);
+    ssize_t written = pwritev(fd, &*it, count, offset);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    } else if (written == 0) {
+      return false;
+    }
+    offset += written;
+
+    // Skip completed buffers and adjust a partially written one
+    while (it != iovs.end() && (std::size_t)written >= it->iov_len) {
+      written -= it->iov_len;
+      it++;
+    }
+    if (it != iovs.end() && written) {
+      it->iov_base = (uint8_t *)it->iov_base + written;
+      it->iov_len -= written;
+    }
+  }
+
+  return true;
+}
+
+/// The granularity of holes in sparse output files.
+constexpr uint64_t SPARSE_PAGE_SIZE = 0x1000;
+
+/// @brief Check if a page is all zeros.
+static bool isZeroPage(const uint8_t *data) {
+  // Independent accumulators so the loop is vectorized
+  uint64_t acc[8] = {};
+  for (std::size_t i = 0; i < SPARSE_PAGE_SIZE; i += sizeof(acc)) {
+    for (std::size_t j = 0; j < 8; j++) {
+      uint64_t word;
+      memcpy(&word, data + i + j * sizeof(uint64_t), sizeof(uint64_t));
+      acc[j] |= word;
+    }
+  }
+
+  uint64_t result = 0;
+  for (auto value : acc) {
+    result |= value;
+  }
+  return result == 0;
+}
+
+/// @brief Add the parts of a procedure that are not in zero pages.
+///
+/// Only pages that are aligned in the output file are skipped, as only those
+/// can become holes.
+static void addNonZeroParts(const OffsetWriteProcedure &procedure,
+                            std::vector<OffsetWriteProcedure> &parts) {
+  const auto end = procedure.writeOffset + procedure.size;
+  auto partStart = procedure.writeOffset;
+  auto page = (procedure.writeOffset + SPARSE_PAGE_SIZE - 1) &
+              ~(SPARSE_PAGE_SIZE - 1);
+  for (; page + SPARSE_PAGE_SIZE <= end; page += SPARSE_PAGE_SIZE) {
+    const auto source = procedure.source + (page - procedure.writeOffset);
+    if (!isZeroPage(source)) {
+      continue;
+    }
+
+    if (page > partStart) {
+      parts.emplace_back(partStart,
+                         procedure.source + (partStart - procedure.writeOffset),
+                         page - partStart);
+    }
+    partStart = page + SPARSE_PAGE_SIZE;
+  }
+
+  if (end > partStart) {
+    parts.emplace_back(partStart,
+                       procedure.source + (partStart - procedure.writeOffset),
+                       end - partStart);
+  }
+}
+
+/// @brief Write procedures that are sorted by offset.
+static bool writeSorted(const std::filesystem::path &path,
+                        const std::vector<const OffsetWriteProcedure *> &sorted,
+                        uint64_t fileSize, bool sparse) {
+  // Parts of procedures to write, split around zero pages if sparse
+  std::vector<OffsetWriteProcedure> parts;
+  parts.reserve(sorted.size());
+  for (auto procedure : sorted) {
+    if (sparse) {
+      addNonZeroParts(*procedure, parts);
+    } else {
+      parts.push_back(*procedure);
+    }
+  }
+
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1) {
+    return false;
+  }
+#ifdef __linux__
+  // Allocate the whole file at once, file systems without support fall back
+  // to allocating as it is written
+  if (!sparse && fileSize) {
+    fallocate(fd, 0, 0, (off_t)fileSize);
+  }
+#endif
+  // Ranges that are never written stay as holes
+  if (ftruncate(fd, (off_t)fileSize) != 0) {
+    close(fd);
+    return false;
+  }
+
+  bool success = true;
+  std::vector<iovec> iovs;
+  off_t batchOffset = 0;
+  uint64_t batchEnd = 0;
+  for (const auto &part : parts) {
+    if (!iovs.empty() && part.writeOffset != batchEnd) {
+      if (!(success = pwriteAll(fd, iovs, batchOffset))) {
+        break;
+      }
+      iovs.clear();
+    }
+
+    if (iovs.empty()) {
+      batchOffset = (off_t)part.writeOffset;
+    }
+    iovs.push_back({(void *)part.source, part.size});
+    batchEnd = part.writeOffset + part.size;
+  }
+  if (success && !iovs.empty()) {
+    success = pwriteAll(fd, iovs, batchOffset);
+  }
+
+  return close(fd) == 0 && success;
+}
+
+bool Converter::writeProcedures(
+    const std::filesystem::path &path,
+    const std::vector<OffsetWriteProcedure> &procedures, bool sparse) {
+  // Sort by offset so that adjacent procedures can be batched
+  std::vector<const OffsetWriteProcedure *> sorted;
+  sorted.reserve(procedures.size());
+  uint64_t fileSize = 0;
+  for (const auto &procedure : procedures) {
+    if (procedure.size) {
+      sorted.push_back(&procedure);
+      fileSize = std::max(fileSize, procedure.writeOffset + procedure.size);
+    }
+  }
+  std::stable_sort(sorted.begin(), sorted.end(), [](auto a, auto b) {
+    return a->writeOffset < b->writeOffset;
+  });
+
+  return writeSorted(path, sorted, fileSize, sparse);
+}
+
+bool Converter::writeProcedures(const std::filesystem::path &path,
+                                const OutputPlan &plan, bool sparse) {
+  std::vector<const OffsetWriteProcedure *> sorted;
+  sorted.reserve(plan.procedures.size());
+  for (const auto &procedure : plan.procedures) {
+    if (procedure.size) {
+      sorted.push_back(&procedure);
+    }
+  }
+  return writeSorted(path, sorted, plan.fileSize, sparse);
+}
+
+#else
+
+bool Converter::writeProcedures(
+    const std::filesystem::path &path,
+    const std::vector<OffsetWriteProcedure> &procedures, bool sparse) {
+  std::ofstream outFile(path, std::ios_base::binary);
+  if (!outFile.good()) {
+    return false;
+  }
+
+  for (const auto &procedure : procedures) {
+    outFile.seekp(procedure.writeOffset);
+    outFile.write((const char *)procedure.source, procedure.size);
+  }
+  outFile.close();
+  return outFile.good();
+}
+
+bool Converter::writeProcedures(const std::filesystem::path &path,
+                                const OutputPlan &plan, bool sparse) {
+  return writeProcedures(path, plan.procedures, sparse);
+}
+
+#endif
+
+namespace {
+
+constexpr std::size_t ZEROS_SIZE = 0x10000;
+const uint8_t ZEROS[ZEROS_SIZE] = {};
+
+/// @brief Add buffers of zeros.
+void addZeros(std::vector<FileBuffer> &buffers, uint64_t size) {
+  for (; size; size -= std::min<uint64_t>(size, ZEROS_SIZE)) {
+    buffers.emplace_back(ZEROS, std::min<uint64_t>(size, ZEROS_SIZE));
+  }
+}
+
+/// @brief Get the buffers of procedures that are sorted by offset.
+uint64_t
+getSortedBuffers(const std::vector<const OffsetWriteProcedure *> &sorted,
+                 std::vector<FileBuffer> &buffers) {
+  uint64_t position = 0;
+  for (auto procedure : sorted) {
+    const auto end = procedure->writeOffset + procedure->size;
+    if (end <= position) {
+      continue;
+    }
+    if (procedure->writeOffset > position) {
+      addZeros(buffers, procedure->writeOffset - position);
+      position = procedure->writeOffset;
+    }
+    const auto skip = position - procedure->writeOffset;
+    buffers.emplace_back(procedure->source + skip, procedure->size - skip);
+    position = end;
+  }
+  return position;
+}
+
+} // namespace
+
+uint64_t
+Converter::getFileBuffers(const std::vector<OffsetWriteProcedure> &procedures,
+                          std::vector<FileBuffer> &buffers) {
+  std::vector<const OffsetWriteProcedure *> sorted;
+  sorted.reserve(procedures.size());
+  for (const auto &procedure : procedures) {
+    if (procedure.size) {
+      sorted.push_back(&procedure);
+    }
+  }
+  std::stable_sort(sorted.begin(), sorted.end(), [](auto a, auto b) {
+    return a->writeOffset < b->writeOffset;
+  });
+  return getSortedBuffers(sorted, buffers);
+}
+
+uint64_t Converter::getFileBuffers(const OutputPlan &plan,
+                                   std::vector<FileBuffer> &buffers) {
+  std::vector<const OffsetWriteProcedure *> sorted;
+  sorted.reserve(plan.procedures.size());
+  for (const auto &procedure : plan.procedures) {
+    if (procedure.size) {
+      sorted.push_back(&procedure);
+    }
+  }
+  return getSortedBuffers(sorted, buffers);
+}
+
+bool Converter::compressionSupported() {
+#ifdef DYLDEXTRACTORC_ZSTD
+  return true;
+#else
+  return false;
+#endif
+}
+
+#ifdef DYLDEXTRACTORC_ZSTD
+
+bool Converter::writeCompressedProcedures(
+    const std::filesystem::path &path,
+    const std::vector<OffsetWriteProcedure> &procedures,
+    const CompressionOptions &options) {
+  // Each thread keeps its context, which keeps the compressor's memory
+  static thread_local std::unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)>
+      cctx(ZSTD_createCCtx(), ZSTD_freeCCtx);
+  if (!cctx) {
+    return false;
+  }
+
+  std::vector<FileBuffer> buffers;
+  const auto fileSize = getFileBuffers(procedures, buffers);
+
+  ZSTD_CCtx_reset(cctx.get(), ZSTD_reset_session_and_parameters);
+  ZSTD_CCtx_setParameter(cctx.get(), ZSTD_c_compressionLevel, options.level);
+  ZSTD_CCtx_setParameter(cctx.get(), ZSTD_c_checksumFlag, 1);
+  if (options.threads > 1 && fileSize >= options.multithreadSize) {
+    // Fails if zstd was built without threads, which compresses inline
+    ZSTD_CCtx_setParameter(cctx.get(), ZSTD_c_nbWorkers, options.threads);
+  }
+  ZSTD_CCtx_setPledgedSrcSize(cctx.get(), fileSize);
+
+  std::ofstream outFile(path, std::ios_base::binary);
+  if (!outFile.good()) {
+    return false;
+  }
+
+  std::vector<char> outData(ZSTD_CStreamOutSize());
+  auto compress = [&](ZSTD_inBuffer &input, ZSTD_EndDirective mode) {
+    std::size_t remaining;
+    do {
+      ZSTD_outBuffer output = {outData.data(), outData.size(), 0};
+      remaining = ZSTD_compressStream2(cctx.get(), &output, &input, mode);
+      if (ZSTD_isError(remaining)) {
+        return false;
+      }
+      outFile.write(outData.data(), output.pos);
+    } while (mode == ZSTD_e_end ? remaining != 0 : input.pos != input.size);
+    return outFile.good();
+  };
+
+  for (const auto &[data, size] : buffers) {
+    ZSTD_inBuffer input = {data, size, 0};
+    if (!compress(input, ZSTD_e_continue)) {
+      return false;
+    }
+  }
+  ZSTD_inBuffer input = {nullptr, 0, 0};
+  if (!compress(input, ZSTD_e_end)) {
+    return false;
+  }
+
+  outFile.close();
+  return outFile.good();
+}
+
+#else
+
+bool Converter::writeCompressedProcedures(
+    const std::filesystem::path &, const std::vector<OffsetWriteProcedure> &,
+    const CompressionOptions &) {
+  return false;
+}
+
+#endif
+
+#pragma region ArchiveWriter
+namespace {
+
+constexpr std::size_t TAR_BLOCK_SIZE = 512;
+
+/// A ustar header block.
+struct TarHeader {
+  char name[100];
+  char mode[8];
+  char uid[8];
+  char gid[8];
+  char size[12];
+  char mtime[12];
+  char chksum[8];
+  char typeflag;
+  char linkname[100];
+  char magic[6];
+  char version[2];
+  char uname[32];
+  char gname[32];
+  char devmajor[8];
+  char devminor[8];
+  char prefix[155];
+  char pad[12];
+};
+static_assert(sizeof(TarHeader) == TAR_BLOCK_SIZE);
+
+/// @brief Create a header, the name and size must fit.
+TarHeader makeTarHeader(std::string_view name, uint64_t size, char type) {
+  TarHeader header{};
+  memcpy(header.name, name.data(), std::min(name.size(), sizeof(header.name)));
+  fmt::format_to(header.mode, "{:07o}", 0644);
+  fmt::format_to(header.uid, "{:07o}", 0);
+  fmt::format_to(header.gid, "{:07o}", 0);
+  fmt::format_to(header.size, "{:011o}", size);
+  // A zero modification time keeps archives reproducible
+  fmt::format_to(header.mtime, "{:011o}", 0);
+  header.typeflag = type;
+  memcpy(header.magic, "ustar", 6);
+  memcpy(header.version, "00", 2);
+
+  // The checksum is calculated with the checksum field as spaces
+  memset(header.chksum, ' ', sizeof(header.chksum));
+  unsigned int checksum = 0;
+  for (std::size_t i = 0; i < sizeof(TarHeader); i++) {
+    checksum += ((const uint8_t *)&header)[i];
+  }
+  fmt::format_to(header.chksum, "{:06o}", checksum);
+  header.chksum[6] = '\0';
+  return header;
+}
+
+/// @brief Create a pax record, which includes the length of itself.
+std::string makePaxRecord(std::string_view key, std::string_view value) {
+  const auto base = key.size() + value.size() + 3; // space, equals, newline
+  auto length = base + 1;
+  while (length != base + std::to_string(length).size()) {
+    length = base + std::to_string(length).size();
+  }
+  return fmt::format("{} {}={}\n", length, key, value);
+}
+
+} // namespace
+
+ArchiveWriter::ArchiveWriter(const std::filesystem::path &path) {
+#ifndef _WIN32
+  fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1) {
+    throw std::runtime_error(
+        fmt::format("Unable to create archive {}.", path.string()));
+  }
+#else
+  file.open(path, std::ios_base::binary);
+  if (!file.good()) {
+    throw std::runtime_error(
+        fmt::format("Unable to create archive {}.", path.string()));
+  }
+#endif
+}
+
+ArchiveWriter::~ArchiveWriter() { finish(); }
+
+bool ArchiveWriter::add(std::string_view name,
+                        const std::vector<OffsetWriteProcedure> &procedures) {
+  if (finished || !good) {
+    return false;
+  }
+
+  std::vector<FileBuffer> data;
+  const auto fileSize = getFileBuffers(procedures, data);
+
+  std::vector<FileBuffer> buffers;
+  auto addPadding = [&buffers](uint64_t size) {
+    addZeros(buffers,
+             (TAR_BLOCK_SIZE - size % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE);
+  };
+
+  // Names that don't fit and sizes over 8GiB are given in a pax header
+  std::string paxData;
+  if (name.size() > sizeof(TarHeader::name)) {
+    paxData += makePaxRecord("path", name);
+  }
+  if (fileSize >= (1ULL << 33)) {
+    paxData += makePaxRecord("size", std::to_string(fileSize));
+  }
+  TarHeader paxHeader;
+  if (!paxData.empty()) {
+    paxHeader = makeTarHeader("PaxHeader", paxData.size(), 'x');
+    buffers.emplace_back(&paxHeader, sizeof(TarHeader));
+    buffers.emplace_back(paxData.data(), paxData.size());
+    addPadding(paxData.size());
+  }
+  const auto header =
+      makeTarHeader(name, fileSize < (1ULL << 33) ? fileSize : 0, '0');
+  buffers.emplace_back(&header, sizeof(TarHeader));
+  buffers.insert(buffers.end(), data.begin(), data.end());
+  addPadding(fileSize);
+
+  return good = writeBuffers(buffers);
+}
+
+bool ArchiveWriter::finish() {
+  if (finished) {
+    return good;
+  }
+  finished = true;
+
+  // Two zero blocks mark the end of the archive
+  std::vector<FileBuffer> buffers = {{ZEROS, TAR_BLOCK_SIZE * 2}};
+  if (good) {
+    good = writeBuffers(buffers);
+  }
+
+#ifndef _WIN32
+  good = close(fd) == 0 && good;
+  fd = -1;
+#else
+  file.close();
+  good = good && file.good();
+#endif
+  return good;
+}
+
+std::filesystem::path
+ArchiveWriter::getShardPath(const std::filesystem::path &path,
+                            unsigned int shard) {
+  auto shardPath = path;
+  shardPath.replace_filename(fmt::format("{}.{}{}", path.stem().string(),
+                                         shard, path.extension().string()));
+  return shardPath;
+}
+
+bool ArchiveWriter::writeBuffers(std::vector<FileBuffer> &buffers) {
+  uint64_t size = 0;
+#ifndef _WIN32
+  std::vector<iovec> iovs;
+  iovs.reserve(buffers.size());
+  for (const auto &[data, dataSize] : buffers) {
+    iovs.push_back({(void *)data, dataSize});
+    size += dataSize;
+  }
+  if (!pwriteAll(fd, iovs, (off_t)offset)) {
+    return false;
+  }
+#else
+  for (const auto &[data, dataSize] : buffers) {
+    file.write((const char *)data, dataSize);
+    size += dataSize;
+  }
+  if (!file.good()) {
+    return false;
+  }
+#endif
+
+  offset += size;
+  return true;
+}
+#pragma endregion ArchiveWriter
+
+AsyncWriter::AsyncWriter(unsigned int threadCount, std::size_t queueDepth,
+                         bool sparse,
+                         std::optional<CompressionOptions> compression)
+    : queueDepth(std::max<std::size_t>(queueDepth, 1)), sparse(sparse),
+      compression(compression) {
+  threadCount = std::max(threadCount, 1u);
+  threads.reserve(threadCount);
+  for (unsigned int i = 0; i < threadCount; i++) {
+    threads.emplace_back(&AsyncWriter::run, this);
+  }
+}
+
+AsyncWriter::~AsyncWriter() { finish(); }
+
+void AsyncWriter::write(std::filesystem::path path, OutputPlan plan,
+                        std::shared_ptr<const void> owner) {
+  std::unique_lock lock(mutex);
+  jobDone.wait(lock, [this] { return pending < queueDepth; });
+  jobs.push_back({std::move(path), std::move(plan), std::move(owner)});
+  pending++;
+  jobQueued.notify_one();
+}
+
+std::vector<std::filesystem::path> AsyncWriter::finish() {
+  {
+    std::scoped_lock lock(mutex);
+    stopping = true;
+  }
+  jobQueued.notify_all();
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  threads.clear();
+
+  std::scoped_lock lock(mutex);
+  return failed;
+}
+
+void AsyncWriter::run() {
+  while (true) {
+    Job job;
+    {
+      std::unique_lock lock(mutex);
+      jobQueued.wait(lock, [this] { return stopping || !jobs.empty(); });
+      if (jobs.empty()) {
+        return;
+      }
+      job = std::move(jobs.front());
+      jobs.pop_front();
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(job.path.parent_path(), ec);
+    const bool written =
+        compression
+            ? writeCompressedProcedures(job.path, job.plan.procedures,
+                                        *compression)
+            : writeProcedures(job.path, job.plan, sparse);
+    // Release the image outside of the lock
+    job.owner.reset();
+
+    std::scoped_lock lock(mutex);
+    if (!written) {
+      failed.push_back(std::move(job.path));
+    }
+    pending--;
+    jobDone.notify_all();
+  }
+}
@@ -0,0 +1,200 @@
+#ifndef __CONVERTER_OUTPUTWRITER__
+#define __CONVERTER_OUTPUTWRITER__
+
+#include "OffsetOptimizer.h"
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <thread>
+
+#ifdef _WIN32
+#include <fstream>
+#endif
+
+namespace DyldExtractor::Converter {
+
+/// @brief Write a list of write procedures to a file.
+///
+/// The file is sized up front and the procedures are submitted in batches of
+/// vectored writes, so the data is not copied through stream buffers. Gaps
+/// between procedures are never written, so they are holes on file systems
+/// with sparse files.
+///
+/// @param path The output file, which is replaced.
+/// @param procedures The procedures from optimizeOffsets.
+/// @param sparse Also skip pages of procedures that are all zeros, leaving
+///   them as holes. Ignored on Windows.
+/// @returns If the file was written successfully.
+bool writeProcedures(const std::filesystem::path &path,
+                     const std::vector<OffsetWriteProcedure> &procedures,
+                     bool sparse = false);
+
+/// @brief Write a planned output file.
+///
+/// The same as writeProcedures, but the procedures are already in order and
+/// the size is known. Unless sparse, the file's space is allocated in one
+/// call before writing, on Linux.
+///
+/// @param path The output file, which is replaced.
+/// @param plan The plan from planOutput.
+/// @param sparse Leave zero pages as holes, see writeProcedures.
+/// @returns If the file was written successfully.
+bool writeProcedures(const std::filesystem::path &path, const OutputPlan &plan,
+                     bool sparse = false);
+
+/// Options for compressed output files.
+struct CompressionOptions {
+  /// The zstd compression level.
+  int level = 3;
+  /// Compression threads for files of at least multithreadSize bytes, 0 or 1
+  /// compresses on the calling thread.
+  unsigned int threads = 0;
+  uint64_t multithreadSize = 16 * 1024 * 1024;
+};
+
+/// @brief If compressed output is supported by this build.
+bool compressionSupported();
+
+/// @brief Write a list of write procedures to a zstd compressed file.
+///
+/// The contents are streamed in file offset order straight from the
+/// procedures into the compressor, so the uncompressed file is never written.
+/// Gaps between procedures are compressed as zeros. Needs the
+/// DYLDEXTRACTORC_ZSTD build option, otherwise it always fails.
+///
+/// @param path The output file, which is replaced.
+/// @param procedures The procedures from optimizeOffsets.
+/// @param options The compression options.
+/// @returns If the file was written successfully.
+bool writeCompressedProcedures(
+    const std::filesystem::path &path,
+    const std::vector<OffsetWriteProcedure> &procedures,
+    const CompressionOptions &options);
+
+/// A contiguous part of an output file.
+using FileBuffer = std::pair<const void *, std::size_t>;
+
+/// @brief Get the contents of an output file in order, for streaming it.
+///
+/// Gaps between procedures are filled with zeros. Procedures don't overlap,
+/// but any overlapping part is skipped so the size stays the same.
+///
+/// @param procedures The procedures from optimizeOffsets.
+/// @param buffers The buffers are appended to this.
+/// @returns The size of the file.
+uint64_t getFileBuffers(const std::vector<OffsetWriteProcedure> &procedures,
+                        std::vector<FileBuffer> &buffers);
+
+/// @brief Get the contents of a planned output file in order.
+/// @param plan The plan from planOutput.
+/// @param buffers The buffers are appended to this.
+/// @returns The size of the file.
+uint64_t getFileBuffers(const OutputPlan &plan,
+                        std::vector<FileBuffer> &buffers);
+
+/// @brief Streams images into a tar archive.
+///
+/// Images are appended one after another to a single file, so only that file
+/// is created and no directories are made for the images. Not thread safe,
+/// give each worker its own shard with getShardPath.
+class ArchiveWriter {
+public:
+  /// @brief Create an archive, throws if the file can't be created.
+  /// @param path The archive, which is replaced.
+  ArchiveWriter(const std::filesystem::path &path);
+  ~ArchiveWriter();
+  ArchiveWriter(const ArchiveWriter &) = delete;
+  ArchiveWriter &operator=(const ArchiveWriter &) = delete;
+
+  /// @brief Add an image to the archive.
+  /// @param name The path of the image in the archive, without a leading /.
+  /// @param procedures The procedures from optimizeOffsets.
+  /// @returns If the image was written successfully.
+  bool add(std::string_view name,
+           const std::vector<OffsetWriteProcedure> &procedures);
+
+  /// @brief Write the end of archive marker and close the file.
+  /// @returns If the archive was written successfully.
+  bool finish();
+
+  /// @brief Get the path of a shard of an archive.
+  ///
+  /// For example, shard 2 of "out/cache.tar" is "out/cache.2.tar".
+  static std::filesystem::path getShardPath(const std::filesystem::path &path,
+                                            unsigned int shard);
+
+private:
+#ifndef _WIN32
+  int fd = -1;
+#else
+  std::ofstream file;
+#endif
+  uint64_t offset = 0;
+  bool good = true;
+  bool finished = false;
+
+  /// @brief Write buffers at the end of the archive.
+  bool writeBuffers(std::vector<FileBuffer> &buffers);
+};
+
+/// @brief Writes output files on background threads.
+///
+/// A file is queued with the object that owns the memory of its procedures,
+/// which is released once the file is written, so a worker can go on to the
+/// next image. Thread safe.
+class AsyncWriter {
+public:
+  /// @param threads The number of threads that write files.
+  /// @param queueDepth The number of files that can be queued or being
+  ///   written, queueing more blocks until one is done.
+  /// @param sparse Leave zero pages as holes, see writeProcedures.
+  /// @param compression Compress the files with these options instead, see
+  ///   writeCompressedProcedures.
+  AsyncWriter(unsigned int threads, std::size_t queueDepth,
+              bool sparse = false,
+              std::optional<CompressionOptions> compression = std::nullopt);
+  ~AsyncWriter();
+  AsyncWriter(const AsyncWriter &) = delete;
+  AsyncWriter &operator=(const AsyncWriter &) = delete;
+
+  /// @brief Queue a file to be written, see writeProcedures.
+  /// @param path The output file, its directories are created.
+  /// @param plan The plan from planOutput.
+  /// @param owner Keeps the memory of the procedures alive.
+  void write(std::filesystem::path path, OutputPlan plan,
+             std::shared_ptr<const void> owner);
+
+  /// @brief Wait for all queued files and stop the threads.
+  /// @returns The files that could not be written.
+  std::vector<std::filesystem::path> finish();
+
+private:
+  struct Job {
+    std::filesystem::path path;
+    OutputPlan plan;
+    std::shared_ptr<const void> owner;
+  };
+
+  std::mutex mutex;
+  std::condition_variable jobQueued;
+  std::condition_variable jobDone;
+  std::deque<Job> jobs;
+  std::size_t queueDepth;
+  bool sparse;
+  std::optional<CompressionOptions> compression;
+  std::size_t pending = 0;
+  bool stopping = false;
+
+  std::vector<std::thread> threads;
+  std::vector<std::filesystem::path> failed;
+
+  void run();
+};
+
+} // namespace DyldExtractor::Converter
+
+#endif // __CONVERTER_OUTPUTWRITER__
@@ -2,6 +2,7 @@
 
 #include <Provider/PointerTracker.h>
 #include <Utils/Architectures.h>
+#include <Utils/Threading.h>
 #include <Utils/Utils.h>
 #include <spdlog/spdlog.h>
 
@@ -14,10 +15,178 @@ static inline int __builtin_ctzll(unsigned long long x) {
 }
 #endif
 
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define SLIDE_BITMAP_SSE2
+#if defined(__GNUC__)
+#define SLIDE_BITMAP_AVX2
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define SLIDE_BITMAP_NEON
+#endif
+
 using namespace DyldExtractor;
 using namespace Converter;
 
+/// The minimum number of pages for each thread, smaller ranges are not worth
+/// splitting.
+#define SLIDE_MIN_PAGES_PER_THREAD 256
+
+/// @brief Pointers found in a range of pages, before they are added to
+///   tracking.
+template <class P> struct SlideBuffer {
+  using PtrT = P::PtrT;
+  using AuthData = Provider::PointerTracker<P>::AuthData;
+
+  std::vector<std::pair<PtrT, PtrT>> pointers;
+  std::vector<std::pair<PtrT, AuthData>> auths;
+  // Page address and page start of pages that couldn't be processed
+  std::vector<std::pair<uint64_t, uint16_t>> unknownPages;
+};
+
+/// @brief Process a range of pages, splitting it between threads.
+///
+/// Each thread fills its own buffer, and the buffers are added to the pointer
+/// tracker in page order afterwards.
+///
+/// @param startI The first page index.
+/// @param endI The last page index, exclusive.
+/// @param threads The maximum number of threads.
+/// @param processPages Processes a range of page indices into a buffer.
+template <class P, class F>
+void processPageRange(uint64_t startI, uint64_t endI, unsigned int threads,
+                      Provider::ActivityLogger &activity,
+                      std::shared_ptr<spdlog::logger> logger,
+                      Provider::PointerTracker<P> &ptrTracker,
+                      F processPages) {
+  if (startI >= endI) {
+    return;
+  }
+
+  const auto count = (std::size_t)(endI - startI);
+  const auto chunks =
+      Utils::chunkCount(threads, count, SLIDE_MIN_PAGES_PER_THREAD);
+  std::vector<SlideBuffer<P>> buffers(chunks);
+  Utils::parallelChunks(chunks, count,
+                        [&](std::size_t chunkI, std::size_t begin,
+                            std::size_t end) {
+                          processPages(startI + begin, startI + end,
+                                       buffers[chunkI]);
+                        });
+
+  for (const auto &buffer : buffers) {
+    for (const auto &[addr, target] : buffer.pointers) {
+      ptrTracker.add(addr, target);
+    }
+    for (const auto &[addr, auth] : buffer.auths) {
+      ptrTracker.addAuth(addr, auth);
+    }
+    if (logger) {
+      for (const auto &[pageAddr, page] : buffer.unknownPages) {
+        SPDLOG_LOGGER_ERROR(logger, "Unknown page start {:#x} at {:#x}.",
+                            page, pageAddr);
+      }
+    }
+  }
+
+  activity.update();
+}
+
 #pragma region V1Processor
+/// The size of a V1 bitmap entry, one bit for each 4 byte location in a page.
+#define SLIDE_V1_ENTRY_SIZE 128
+
+/// @brief Find the non-zero 64 bit words in a V1 bitmap entry.
+/// @returns A mask with a bit set for each non-zero word.
+using BitmapScanner = uint32_t (*)(const uint8_t *entry);
+
+static uint32_t scanBitmapScalar(const uint8_t *entry) {
+  uint32_t mask = 0;
+  for (int i = 0; i < SLIDE_V1_ENTRY_SIZE / 8; i++) {
+    uint64_t word;
+    memcpy(&word, entry + (i * 8), sizeof(word));
+    if (word) {
+      mask |= 1u << i;
+    }
+  }
+  return mask;
+}
+
+#ifdef SLIDE_BITMAP_SSE2
+static uint32_t scanBitmapSSE2(const uint8_t *entry) {
+  const __m128i zero = _mm_setzero_si128();
+  uint32_t mask = 0;
+  for (int i = 0; i < SLIDE_V1_ENTRY_SIZE / 16; i++) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(entry + (i * 16)));
+    // A bit for each zero byte, a word is zero if all 8 of its bits are set
+    uint32_t zeros = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero));
+    if ((zeros & 0xFF) != 0xFF) {
+      mask |= 1u << (i * 2);
+    }
+    if ((zeros & 0xFF00) != 0xFF00) {
+      mask |= 1u << (i * 2 + 1);
+    }
+  }
+  return mask;
+}
+#endif
+
+#ifdef SLIDE_BITMAP_AVX2
+__attribute__((target("avx2"))) static uint32_t
+scanBitmapAVX2(const uint8_t *entry) {
+  const __m256i zero = _mm256_setzero_si256();
+  uint32_t mask = 0;
+  for (int i = 0; i < SLIDE_V1_ENTRY_SIZE / 32; i++) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(entry + (i * 32)));
+    // All ones in each zero word, take the top bit of each word
+    __m256i zeros = _mm256_cmpeq_epi64(v, zero);
+    uint32_t zeroWords =
+        (uint32_t)_mm256_movemask_pd(_mm256_castsi256_pd(zeros));
+    mask |= (~zeroWords & 0xF) << (i * 4);
+  }
+  return mask;
+}
+#endif
+
+#ifdef SLIDE_BITMAP_NEON
+static uint32_t scanBitmapNEON(const uint8_t *entry) {
+  uint32_t mask = 0;
+  for (int i = 0; i < SLIDE_V1_ENTRY_SIZE / 16; i++) {
+    uint64x2_t v = vld1q_u64((const uint64_t *)(entry + (i * 16)));
+    uint64x2_t nonZero = vtstq_u64(v, v);
+    if (vgetq_lane_u64(nonZero, 0)) {
+      mask |= 1u << (i * 2);
+    }
+    if (vgetq_lane_u64(nonZero, 1)) {
+      mask |= 1u << (i * 2 + 1);
+    }
+  }
+  return mask;
+}
+#endif
+
+/// @brief Select the best bitmap scanner for the host CPU.
+static BitmapScanner selectBitmapScanner() {
+#ifdef SLIDE_BITMAP_AVX2
+  // This runs during static initialization, possibly before libgcc has
+  // filled in the CPU model.
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return scanBitmapAVX2;
+  }
+#endif
+#if defined(SLIDE_BITMAP_SSE2)
+  return scanBitmapSSE2;
+#elif defined(SLIDE_BITMAP_NEON)
+  return scanBitmapNEON;
+#else
+  return scanBitmapScalar;
+#endif
+}
+
+static const BitmapScanner scanBitmap = selectBitmapScanner();
+
 class V1Processor {
   using P = Utils::Arch::Pointer32;
   using PtrT = P::PtrT;
@@ -70,16 +239,22 @@ void V1Processor::run() {
       auto pageAddr = addr + (4096 * tocI);
       auto pageData = data + (4096 * tocI);
 
-      for (int entryI = 0; entryI < 128; entryI++) {
-        auto byte = entry[entryI];
-        if (byte != 0) {
-          for (int bitI = 0; bitI < 8; bitI++) {
-            if (byte & (1 << bitI)) {
-              auto pAddr = pageAddr + entryI * 8 * 4 + bitI * 4;
-              auto pLoc = pageData + entryI * 8 * 4 + bitI * 4;
-              ptrTracker.add((PtrT)pAddr, *(PtrT *)pLoc);
-            }
-          }
+      // Only look at the bits of non-zero words, bit n of the entry is the
+      // location at n * 4. This relies on the host being little endian.
+      auto words = scanBitmap(entry);
+      while (words) {
+        const int wordI = __builtin_ctzll(words);
+        words &= words - 1;
+
+        uint64_t bits;
+        memcpy(&bits, entry + (wordI * 8), sizeof(bits));
+        while (bits) {
+          const int bitI = (wordI * 64) + __builtin_ctzll(bits);
+          bits &= bits - 1;
+
+          auto pAddr = pageAddr + bitI * 4;
+          auto pLoc = pageData + bitI * 4;
+          ptrTracker.add((PtrT)pAddr, *(PtrT *)pLoc);
         }
       }
 
@@ -99,16 +274,20 @@ public:
               std::shared_ptr<spdlog::logger> logger,
               Provider::PointerTracker<P> &ptrTracker,
               const typename Provider::PointerTracker<P>::MappingSlideInfo
-                  &mapSlideInfo);
+                  &mapSlideInfo,
+              unsigned int threads);
   void run();
 
 private:
-  void processPage(uint64_t pageAddr, uint8_t *pageData, uint64_t pageOffset);
+  void processPages(uint64_t startI, uint64_t endI, SlideBuffer<P> &buffer);
+  void processPage(uint64_t pageAddr, uint8_t *pageData, uint64_t pageOffset,
+                   SlideBuffer<P> &buffer);
 
   Macho::Context<false, P> &mCtx;
   Provider::ActivityLogger &activity;
   std::shared_ptr<spdlog::logger> logger;
   Provider::PointerTracker<P> &ptrTracker;
+  unsigned int threads;
 
   const typename Provider::PointerTracker<P>::MappingSlideInfo &mapInfo;
   dyld_cache_slide_info2 *slideInfo;
@@ -124,9 +303,10 @@ V2Processor<P>::V2Processor(
     Macho::Context<false, P> &mCtx, Provider::ActivityLogger &activity,
     std::shared_ptr<spdlog::logger> logger,
     Provider::PointerTracker<P> &ptrTracker,
-    const typename Provider::PointerTracker<P>::MappingSlideInfo &mapSlideInfo)
+    const typename Provider::PointerTracker<P>::MappingSlideInfo &mapSlideInfo,
+    unsigned int threads)
     : mCtx(mCtx), activity(activity), logger(logger), ptrTracker(ptrTracker),
-      mapInfo(mapSlideInfo),
+      threads(threads), mapInfo(mapSlideInfo),
       slideInfo((dyld_cache_slide_info2 *)mapSlideInfo.slideInfo) {
   assert(mapSlideInfo.slideInfoVersion == 2);
 
@@ -137,12 +317,6 @@ V2Processor<P>::V2Processor(
 }
 
 template <class P> void V2Processor<P>::run() {
-  const auto pageStarts =
-      (uint16_t *)((uint8_t *)slideInfo + slideInfo->page_starts_offset);
-  const auto pageExtras =
-      (uint16_t *)((uint8_t *)slideInfo + slideInfo->page_extras_offset);
-  auto dataStart = mCtx.convertAddrP(mapInfo.address);
-
   for (const auto &seg : mCtx.segments) {
     if (!mapInfo.containsAddr(seg.command->vmaddr)) {
       continue;
@@ -156,39 +330,53 @@ template <class P> void V2Processor<P>::run() {
                                    slideInfo->page_size) /
                       slideInfo->page_size;
 
-    for (auto i = startI; i < endI; i++) {
-      const auto page = pageStarts[i];
-      auto pageAddr = mapInfo.address + (i * slideInfo->page_size);
-      auto pageData = dataStart + (i * slideInfo->page_size);
+    processPageRange<P>(startI, endI, threads, activity, logger, ptrTracker,
+                        [this](uint64_t start, uint64_t end,
+                               SlideBuffer<P> &buffer) {
+                          processPages(start, end, buffer);
+                        });
+  }
+}
 
-      if (page == DYLD_CACHE_SLIDE_PAGE_ATTR_NO_REBASE) {
-        continue;
-      } else if (page & DYLD_CACHE_SLIDE_PAGE_ATTR_EXTRA) {
-        uint16_t chainI = page & 0x3FFF;
-        bool done = false;
-        while (!done) {
-          uint16_t pInfo = pageExtras[chainI];
-          uint16_t pageStartOffset = (pInfo & 0x3FFF) * 4;
-          processPage(pageAddr, pageData, pageStartOffset);
-
-          done = pInfo & DYLD_CACHE_SLIDE_PAGE_ATTR_END;
-          chainI++;
-        }
-      } else if ((page & DYLD_CACHE_SLIDE_PAGE_ATTR_EXTRA) == 0) {
-        // The page starts are 32bit jumps
-        processPage(pageAddr, pageData, page * 4);
-      } else {
-        SPDLOG_LOGGER_ERROR(logger, "Unknown page start {:#x}.", page);
-      }
+template <class P>
+void V2Processor<P>::processPages(uint64_t startI, uint64_t endI,
+                                  SlideBuffer<P> &buffer) {
+  const auto pageStarts =
+      (uint16_t *)((uint8_t *)slideInfo + slideInfo->page_starts_offset);
+  const auto pageExtras =
+      (uint16_t *)((uint8_t *)slideInfo + slideInfo->page_extras_offset);
+  auto dataStart = mCtx.convertAddrP(mapInfo.address);
 
-      activity.update();
+  for (auto i = startI; i < endI; i++) {
+    const auto page = pageStarts[i];
+    auto pageAddr = mapInfo.address + (i * slideInfo->page_size);
+    auto pageData = dataStart + (i * slideInfo->page_size);
+
+    if (page == DYLD_CACHE_SLIDE_PAGE_ATTR_NO_REBASE) {
+      continue;
+    } else if (page & DYLD_CACHE_SLIDE_PAGE_ATTR_EXTRA) {
+      uint16_t chainI = page & 0x3FFF;
+      bool done = false;
+      while (!done) {
+        uint16_t pInfo = pageExtras[chainI];
+        uint16_t pageStartOffset = (pInfo & 0x3FFF) * 4;
+        processPage(pageAddr, pageData, pageStartOffset, buffer);
+
+        done = pInfo & DYLD_CACHE_SLIDE_PAGE_ATTR_END;
+        chainI++;
+      }
+    } else if ((page & DYLD_CACHE_SLIDE_PAGE_ATTR_EXTRA) == 0) {
+      // The page starts are 32bit jumps
+      processPage(pageAddr, pageData, page * 4, buffer);
+    } else {
+      buffer.unknownPages.emplace_back(pageAddr, page);
     }
   }
 }
 
 template <class P>
 void V2Processor<P>::processPage(uint64_t pageAddr, uint8_t *pageData,
-                                 uint64_t pageOffset) {
+                                 uint64_t pageOffset, SlideBuffer<P> &buffer) {
   uint64_t delta = 1;
   while (delta != 0) {
     auto pAddr = (PtrT)(pageAddr + pageOffset);
@@ -201,7 +389,7 @@ void V2Processor<P>::processPage(uint64_t pageAddr, uint8_t *pageData,
     }
 
     // Add to tracking
-    ptrTracker.add(pAddr, newValue);
+    buffer.pointers.emplace_back(pAddr, newValue);
     pageOffset += delta;
   }
 }
@@ -216,15 +404,19 @@ public:
   V3Processor(
       Macho::Context<false, P> &mCtx, Provider::ActivityLogger &activity,
       Provider::PointerTracker<P> &ptrTracker,
-      const Provider::PointerTracker<P>::MappingSlideInfo &mapSlideInfo);
+      const Provider::PointerTracker<P>::MappingSlideInfo &mapSlideInfo,
+      unsigned int threads);
   void run();
 
 private:
-  void processPage(uint64_t pageAddr, uint8_t *pageData, uint64_t delta);
+  void processPages(uint64_t startI, uint64_t endI, SlideBuffer<P> &buffer);
+  void processPage(uint64_t pageAddr, uint8_t *pageData, uint64_t delta,
+                   SlideBuffer<P> &buffer);
 
   Macho::Context<false, P> &mCtx;
   Provider::ActivityLogger &activity;
   Provider::PointerTracker<P> &ptrTracker;
+  unsigned int threads;
 
   const Provider::PointerTracker<P>::MappingSlideInfo &mapInfo;
   dyld_cache_slide_info3 *slideInfo;
@@ -233,18 +425,15 @@ private:
 V3Processor::V3Processor(
     Macho::Context<false, P> &mCtx, Provider::ActivityLogger &activity,
     Provider::PointerTracker<P> &ptrTracker,
-    const Provider::PointerTracker<P>::MappingSlideInfo &mapSlideInfo)
-    : mCtx(mCtx), activity(activity), ptrTracker(ptrTracker),
+    const Provider::PointerTracker<P>::MappingSlideInfo &mapSlideInfo,
+    unsigned int threads)
+    : mCtx(mCtx), activity(activity), ptrTracker(ptrTracker), threads(threads),
       mapInfo(mapSlideInfo),
       slideInfo((dyld_cache_slide_info3 *)mapSlideInfo.slideInfo) {
   assert(mapSlideInfo.slideInfoVersion == 3);
 }
 
 void V3Processor::run() {
-  auto pageStarts = (uint16_t *)((uint8_t *)slideInfo +
-                                 offsetof(dyld_cache_slide_info3, page_starts));
-  auto dataStart = mCtx.convertAddrP(mapInfo.address);
-
   for (auto &seg : mCtx.segments) {
     if (!mapInfo.containsAddr(seg.command->vmaddr)) {
       continue;
@@ -258,24 +447,35 @@ void V3Processor::run() {
                              slideInfo->page_size) /
                 slideInfo->page_size;
 
-    for (auto i = startI; i < endI; i++) {
-      auto page = pageStarts[i];
-      if (page == DYLD_CACHE_SLIDE_V3_PAGE_ATTR_NO_REBASE) {
-        continue;
-      } else {
-        auto pageAddr = mapInfo.address + (i * slideInfo->page_size);
-        auto pageData = dataStart + (i * slideInfo->page_size);
-        // Page is a byte offset into page data, delta is 8 byte stride
-        processPage(pageAddr, pageData, page / sizeof(PtrT));
-      }
+    processPageRange<P>(startI, endI, threads, activity, nullptr, ptrTracker,
+                        [this](uint64_t start, uint64_t end,
+                               SlideBuffer<P> &buffer) {
+                          processPages(start, end, buffer);
+                        });
+  }
+}
 
-      activity.update();
+void V3Processor::processPages(uint64_t startI, uint64_t endI,
+                               SlideBuffer<P> &buffer) {
+  auto pageStarts = (uint16_t *)((uint8_t *)slideInfo +
+                                 offsetof(dyld_cache_slide_info3, page_starts));
+  auto dataStart = mCtx.convertAddrP(mapInfo.address);
+
+  for (auto i = startI; i < endI; i++) {
+    auto page = pageStarts[i];
+    if (page == DYLD_CACHE_SLIDE_V3_PAGE_ATTR_NO_REBASE) {
+      continue;
+    } else {
+      auto pageAddr = mapInfo.address + (i * slideInfo->page_size);
+      auto pageData = dataStart + (i * slideInfo->page_size);
+      // Page is a byte offset into page data, delta is 8 byte stride
+      processPage(pageAddr, pageData, page / sizeof(PtrT), buffer);
     }
   }
 }
 
 void V3Processor::processPage(uint64_t pageAddr, uint8_t *pageData,
-                              uint64_t delta) {
+                              uint64_t delta, SlideBuffer<P> &buffer) {
   auto pAddr = pageAddr;
   auto pLoc = (dyld_cache_slide_pointer3 *)pageData;
   do {
@@ -287,9 +487,10 @@ void V3Processor::processPage(uint64_t pageAddr, uint8_t *pageData,
     if (pLoc->auth.authenticated) {
       newValue =
           pLoc->auth.offsetFromSharedCacheBase + slideInfo->auth_value_add;
-      ptrTracker.addAuth(pAddr, {(uint16_t)pLoc->auth.diversityData,
-                                 (bool)pLoc->auth.hasAddressDiversity,
-                                 (uint8_t)pLoc->auth.key});
+      buffer.auths.push_back({pAddr,
+                              {(uint16_t)pLoc->auth.diversityData,
+                               (bool)pLoc->auth.hasAddressDiversity,
+                               (uint8_t)pLoc->auth.key}});
     } else {
       uint64_t value51 = pLoc->plain.pointerValue;
       uint64_t top8Bits = value51 & 0x0007F80000000000ULL;
@@ -297,7 +498,7 @@ void V3Processor::processPage(uint64_t pageAddr, uint8_t *pageData,
       newValue = (top8Bits << 13) | bottom43Bits;
     }
 
-    ptrTracker.add(pAddr, newValue);
+    buffer.pointers.emplace_back(pAddr, newValue);
     pLoc->raw = newValue;
   } while (delta != 0);
 }
@@ -312,16 +513,20 @@ public:
       Macho::Context<false, P> &mCtx, Provider::ActivityLogger &activity,
       std::shared_ptr<spdlog::logger> logger,
       Provider::PointerTracker<P> &ptrTracker,
-      const Provider::PointerTracker<P>::MappingSlideInfo &mapSlideInfo);
+      const Provider::PointerTracker<P>::MappingSlideInfo &mapSlideInfo,
+      unsigned int threads);
   void run();
 
 private:
-  void processPage(uint32_t pageAddr, uint8_t *pageData, uint32_t pageOffset);
+  void processPages(uint64_t startI, uint64_t endI, SlideBuffer<P> &buffer);
+  void processPage(uint32_t pageAddr, uint8_t *pageData, uint32_t pageOffset,
+                   SlideBuffer<P> &buffer);
 
   Macho::Context<false, P> &mCtx;
   Provider::ActivityLogger &activity;
   std::shared_ptr<spdlog::logger> logger;
   Provider::PointerTracker<P> &ptrTracker;
+  unsigned int threads;
 
   const Provider::PointerTracker<P>::MappingSlideInfo &mapInfo;
   dyld_cache_slide_info4 *slideInfo;
@@ -336,9 +541,10 @@ V4Processor::V4Processor(
     Macho::Context<false, P> &mCtx, Provider::ActivityLogger &activity,
     std::shared_ptr<spdlog::logger> logger,
     Provider::PointerTracker<P> &ptrTracker,
-    const Provider::PointerTracker<P>::MappingSlideInfo &mapSlideInfo)
+    const Provider::PointerTracker<P>::MappingSlideInfo &mapSlideInfo,
+    unsigned int threads)
     : mCtx(mCtx), activity(activity), logger(logger), ptrTracker(ptrTracker),
-      mapInfo(mapSlideInfo),
+      threads(threads), mapInfo(mapSlideInfo),
       slideInfo((dyld_cache_slide_info4 *)mapSlideInfo.slideInfo) {
   assert(mapSlideInfo.slideInfoVersion == 4);
 
@@ -349,12 +555,6 @@ V4Processor::V4Processor(
 }
 
 void V4Processor::run() {
-  auto pageStarts =
-      (uint16_t *)((uint8_t *)slideInfo + slideInfo->page_starts_offset);
-  auto pageExtras =
-      (uint16_t *)((uint8_t *)slideInfo + slideInfo->page_extras_offset);
-  auto dataStart = mCtx.convertAddrP(mapInfo.address);
-
   for (auto &seg : mCtx.segments) {
     if (!mapInfo.containsAddr(seg.command->vmaddr)) {
       continue;
@@ -368,38 +568,51 @@ void V4Processor::run() {
                              slideInfo->page_size) /
                 slideInfo->page_size;
 
-    for (auto i = startI; i < endI; i++) {
-      auto page = pageStarts[i];
-      auto pageAddr = (uint32_t)(mapInfo.address + (i * slideInfo->page_size));
-      auto pageData = dataStart + (i * slideInfo->page_size);
+    processPageRange<P>(startI, endI, threads, activity, logger, ptrTracker,
+                        [this](uint64_t start, uint64_t end,
+                               SlideBuffer<P> &buffer) {
+                          processPages(start, end, buffer);
+                        });
+  }
+}
 
-      if (page == DYLD_CACHE_SLIDE4_PAGE_NO_REBASE) {
-        continue;
-      } else if ((page & DYLD_CACHE_SLIDE4_PAGE_USE_EXTRA) == 0) {
-        processPage(pageAddr, pageData, page * 4);
-      } else if (page & DYLD_CACHE_SLIDE4_PAGE_USE_EXTRA) {
-        auto extra = pageExtras + (page & DYLD_CACHE_SLIDE4_PAGE_INDEX);
-        while (true) {
-          auto pageOff = (*extra & DYLD_CACHE_SLIDE4_PAGE_INDEX) * 4;
-          processPage(pageAddr, pageData, pageOff);
-          if (*extra & DYLD_CACHE_SLIDE4_PAGE_EXTRA_END) {
-            break;
-          } else {
-            extra++;
-          }
-        }
+void V4Processor::processPages(uint64_t startI, uint64_t endI,
+                               SlideBuffer<P> &buffer) {
+  auto pageStarts =
+      (uint16_t *)((uint8_t *)slideInfo + slideInfo->page_starts_offset);
+  auto pageExtras =
+      (uint16_t *)((uint8_t *)slideInfo + slideInfo->page_extras_offset);
+  auto dataStart = mCtx.convertAddrP(mapInfo.address);
+
+  for (auto i = startI; i < endI; i++) {
+    auto page = pageStarts[i];
+    auto pageAddr = (uint32_t)(mapInfo.address + (i * slideInfo->page_size));
+    auto pageData = dataStart + (i * slideInfo->page_size);
 
-      } else {
-        SPDLOG_LOGGER_ERROR(logger, "Unknown page start {:#x}.", page);
+    if (page == DYLD_CACHE_SLIDE4_PAGE_NO_REBASE) {
+      continue;
+    } else if ((page & DYLD_CACHE_SLIDE4_PAGE_USE_EXTRA) == 0) {
+      processPage(pageAddr, pageData, page * 4, buffer);
+    } else if (page & DYLD_CACHE_SLIDE4_PAGE_USE_EXTRA) {
+      auto extra = pageExtras + (page & DYLD_CACHE_SLIDE4_PAGE_INDEX);
+      while (true) {
+        auto pageOff = (*extra & DYLD_CACHE_SLIDE4_PAGE_INDEX) * 4;
+        processPage(pageAddr, pageData, pageOff, buffer);
+        if (*extra & DYLD_CACHE_SLIDE4_PAGE_EXTRA_END) {
+          break;
+        } else {
+          extra++;
+        }
       }
 
-      activity.update();
+    } else {
+      buffer.unknownPages.emplace_back(pageAddr, page);
     }
   }
 }
 
 void V4Processor::processPage(uint32_t pageAddr, uint8_t *pageData,
-                              uint32_t pageOffset) {
+                              uint32_t pageOffset, SlideBuffer<P> &buffer) {
   uint32_t delta = 1;
   while (delta != 0) {
     uint32_t pAddr = pageAddr + pageOffset;
@@ -418,7 +631,7 @@ void V4Processor::processPage(uint32_t pageAddr, uint8_t *pageData,
     } else {
       // pointer that needs rebasing
       newValue += (uint32_t)valueAdd;
-      ptrTracker.add(pAddr, newValue);
+      buffer.pointers.emplace_back(pAddr, newValue);
     }
     pageOffset += delta;
   }
@@ -426,7 +639,10 @@ void V4Processor::processPage(uint32_t pageAddr, uint8_t *pageData,
 #pragma endregion V4Processor
 
 template <class A>
-void Converter::processSlideInfo(Utils::ExtractionContext<A> &eCtx) {
+void Converter::processSlideMapping(
+    Utils::ExtractionContext<A> &eCtx,
+    const typename Provider::PointerTracker<typename A::P>::MappingSlideInfo
+        &map) {
   using P = A::P;
 
   auto &mCtx = *eCtx.mCtx;
@@ -434,6 +650,51 @@ void Converter::processSlideInfo(Utils::ExtractionContext<A> &eCtx) {
   auto logger = eCtx.logger;
   auto &ptrTracker = eCtx.ptrTracker;
 
+  switch (map.slideInfoVersion) {
+  case 1: {
+    if constexpr (std::is_same<P, Utils::Arch::Pointer64>::value) {
+      SPDLOG_LOGGER_ERROR(logger, "Unable to handle 64bit V1 slide info.");
+    } else {
+      V1Processor(mCtx, activity, ptrTracker, map).run();
+    }
+    break;
+  }
+  case 2: {
+    V2Processor<P>(mCtx, activity, logger, ptrTracker, map, eCtx.threads)
+        .run();
+    break;
+  }
+  case 3: {
+    if constexpr (std::is_same<P, Utils::Arch::Pointer32>::value) {
+      SPDLOG_LOGGER_ERROR(logger, "Unable to handle 32bit V3 slide info.");
+    } else {
+      V3Processor(mCtx, activity, ptrTracker, map, eCtx.threads).run();
+    }
+    break;
+  }
+  case 4: {
+    if constexpr (std::is_same<P, Utils::Arch::Pointer64>::value) {
+      SPDLOG_LOGGER_ERROR(logger, "Unable to handle 64bit V4 slide info.");
+    } else {
+      V4Processor(mCtx, activity, logger, ptrTracker, map, eCtx.threads)
+          .run();
+    }
+    break;
+  }
+  default:
+    SPDLOG_LOGGER_ERROR(logger, "Unknown slide info version {}.",
+                        map.slideInfoVersion);
+  }
+}
+
+template <class A>
+void Converter::processSlideInfo(Utils::ExtractionContext<A> &eCtx) {
+  using P = A::P;
+
+  auto &activity = *eCtx.activity;
+  auto logger = eCtx.logger;
+  auto &ptrTracker = eCtx.ptrTracker;
+
   activity.update("Slide Info", "Processing slide info");
 
   const auto &mappings = eCtx.ptrTracker.getSlideMappings();
@@ -441,55 +702,35 @@ void Converter::processSlideInfo(Utils::ExtractionContext<A> &eCtx) {
     SPDLOG_LOGGER_WARN(logger, "No slide mappings found.");
   }
 
-  for (const auto &map : mappings) {
-    switch (map->slideInfoVersion) {
-    case 1: {
-      if constexpr (std::is_same<P, Utils::Arch::Pointer64>::value) {
-        SPDLOG_LOGGER_ERROR(logger, "Unable to handle 64bit V1 slide info.");
-      } else {
-        V1Processor(mCtx, activity, ptrTracker, *map).run();
-      }
-      break;
-    }
-    case 2: {
-      V2Processor<P>(mCtx, activity, logger, ptrTracker, *map).run();
-      break;
-    }
-    case 3: {
-      if constexpr (std::is_same<P, Utils::Arch::Pointer32>::value) {
-        SPDLOG_LOGGER_ERROR(logger, "Unable to handle 32bit V3 slide info.");
-      } else {
-        V3Processor(mCtx, activity, ptrTracker, *map).run();
-      }
-      break;
-    }
-    case 4: {
-      if constexpr (std::is_same<P, Utils::Arch::Pointer64>::value) {
-        SPDLOG_LOGGER_ERROR(logger, "Unable to handle 64bit V4 slide info.");
-      } else {
-        V4Processor(mCtx, activity, logger, ptrTracker, *map).run();
-      }
-      break;
-    }
-    default:
-      SPDLOG_LOGGER_ERROR(logger, "Unknown slide info version {}.",
-                          map->slideInfoVersion);
+  // The processors walk the pages of each segment in order
+  for (const auto &seg : eCtx.mCtx->segments) {
+    if (strncmp(seg.command->segname, SEG_LINKEDIT, 16) != 0) {
+      eCtx.mCtx->advise(seg.command->vmaddr, seg.command->vmsize,
+                        Macho::Advice::Sequential);
     }
   }
 
+  for (const auto &map : mappings) {
+    processSlideMapping(eCtx, *map);
+  }
+
   // Add normal binds to tracking
   eCtx.bindInfo.load();
-  for (const auto &bind : eCtx.bindInfo.getBinds()) {
+  for (const auto &[offset, bind] : eCtx.bindInfo.getBindStream()) {
     ptrTracker.addBind((typename P::PtrT)bind.address,
-                       std::make_shared<Provider::SymbolicInfo>(
+                       eCtx.symbolStore.intern(
                            Provider::SymbolicInfo::Symbol{
                                std::string(bind.symbolName),
                                (uint64_t)bind.libOrdinal, std::nullopt},
-                           Provider::SymbolicInfo::Encoding::None));
+                           Provider::SymbolicInfo::Encoding::None),
+                       bind.addend);
   }
 }
 
 #define X(T)                                                                   \
+  template void Converter::processSlideMapping<T>(                             \
+      Utils::ExtractionContext<T> & eCtx,                                      \
+      const Provider::PointerTracker<T::P>::MappingSlideInfo &map);            \
   template void Converter::processSlideInfo<T>(Utils::ExtractionContext<T> &   \
                                                eCtx);
 X(Utils::Arch::x86_64)
@@ -8,6 +8,15 @@ namespace DyldExtractor::Converter {
 
 template <class A> void processSlideInfo(Utils::ExtractionContext<A> &eCtx);
 
+/// @brief Track the pointers in a single slide mapping, without adding binds.
+/// @param eCtx The extraction context.
+/// @param map The slide mapping, from the pointer tracker.
+template <class A>
+void processSlideMapping(
+    Utils::ExtractionContext<A> &eCtx,
+    const typename Provider::PointerTracker<typename A::P>::MappingSlideInfo
+        &map);
+
 } // namespace DyldExtractor::Converter
 
 #endif // __CONVERTER_SLIDE__
\ No newline at end of file
@@ -0,0 +1,54 @@
+#ifndef __CONVERTER_STUBS_ARM64DECODER__
+#define __CONVERTER_STUBS_ARM64DECODER__
+
+#include <stdint.h>
+
+/// A small decoder for the arm64 encodings used by stubs and callsites. It
+/// works directly on instruction words, so it doesn't need the disassembler.
+namespace DyldExtractor::Converter::Stubs::Arm64Decoder {
+
+/// @brief Check if the instruction is a B or BL.
+constexpr bool isImmBranch(const uint32_t instr) {
+  return (instr & 0x7C000000) == 0x14000000;
+}
+
+/// @brief The destination register, Rd or Rt.
+constexpr uint32_t rd(const uint32_t instr) { return instr & 0x1F; }
+
+/// @brief The first source register, Rn.
+constexpr uint32_t rn(const uint32_t instr) { return (instr >> 5) & 0x1F; }
+
+/// @brief The byte offset of a B or BL.
+constexpr int64_t branchOffset(const uint32_t instr) {
+  // Sign extend imm26 and scale by 4
+  return (int64_t)((uint64_t)(instr & 0x3FFFFFF) << 38) >> 36;
+}
+
+/// @brief The page offset of an ADRP.
+constexpr int64_t adrpOffset(const uint32_t instr) {
+  const uint64_t immlo = (instr & 0x60000000) >> 29;
+  const uint64_t immhi = (instr & 0xFFFFE0) >> 3;
+  // Sign extend the 21 bit page count and scale by the page size
+  return (int64_t)((immhi | immlo) << 43) >> 31;
+}
+
+/// @brief The target page of an ADRP.
+/// @param pc The address of the instruction.
+constexpr uint64_t adrpTarget(const uint64_t pc, const uint32_t instr) {
+  return (pc & ~0xFFFULL) + adrpOffset(instr);
+}
+
+/// @brief The immediate of an ADD, which must not be shifted.
+constexpr uint32_t addImm(const uint32_t instr) {
+  return (instr & 0x3FFC00) >> 10;
+}
+
+/// @brief The scaled byte offset of an LDR.
+constexpr uint32_t ldrOffset(const uint32_t instr) {
+  const uint32_t scale = instr >> 30;
+  return ((instr & 0x3FFC00) >> 10) << scale;
+}
+
+} // namespace DyldExtractor::Converter::Stubs::Arm64Decoder
+
+#endif // __CONVERTER_STUBS_ARM64DECODER__
@@ -1,8 +1,13 @@
 #include "Arm64Fixer.h"
 
+#include "Arm64Decoder.h"
 #include "Fixer.h"
+#include <Utils/Threading.h>
 #include <Utils/Utils.h>
 
+#define STUBS_MIN_STUBS_PER_THREAD 256
+#define STUBS_MIN_FUNCS_PER_THREAD 512
+
 using namespace DyldExtractor;
 using namespace Converter;
 using namespace Stubs;
@@ -91,85 +96,135 @@ template <class A> void Arm64Fixer<A>::fixStubHelpers() {
 template <class A> void Arm64Fixer<A>::scanStubs() {
   activity.update(std::nullopt, "Scanning Stubs");
 
+  // Collect all stubs
+  struct ScannedStub {
+    PtrT addr;
+    uint8_t *loc;
+    uint32_t size;
+    uint32_t indirectI;
+
+    std::optional<std::pair<PtrT, AStubFormat>> data;
+    std::optional<PtrT> ldrAddr;
+    PtrT targetFunc;
+  };
+  std::vector<ScannedStub> stubs;
+
   mCtx.enumerateSections(
       [](auto seg, auto sect) {
         return (sect->flags & SECTION_TYPE) == S_SYMBOL_STUBS;
       },
-      [this](auto seg, auto sect) {
-          PtrT sAddr = sect->addr;
-          uint8_t *sLoc = mCtx.convertAddrP(sAddr);
-        auto indirectI = sect->reserved1;
-
+      [&stubs, this](auto seg, auto sect) {
         const uint32_t stubSize = sect->reserved2;
+        if (!stubSize) {
+          return true;
+        }
+
+        PtrT sAddr = sect->addr;
+        uint8_t *sLoc = mCtx.convertAddrP(sAddr);
+        auto indirectI = sect->reserved1;
+        stubs.reserve(stubs.size() + sect->size / stubSize);
         for (; sAddr < sect->addr + sect->size;
              sAddr += stubSize, sLoc += stubSize, indirectI++) {
-          activity.update();
+          stubs.push_back({sAddr, sLoc, stubSize, indirectI, std::nullopt,
+                           std::nullopt, 0});
+        }
+        return true;
+      });
 
-          const std::optional<std::pair<PtrT, AStubFormat>> sDataPair = arm64Utils.resolveStub(sAddr);
-          if (!sDataPair) {
-            SPDLOG_LOGGER_ERROR(logger, "Unknown Arm64 stub format at {:#x}.",
-                                sAddr);
+  // Decode stubs and resolve their chains, only reads the cache
+  const auto chunks = Utils::chunkCount(delegate.eCtx.threads, stubs.size(),
+                                        STUBS_MIN_STUBS_PER_THREAD);
+  std::vector<std::vector<std::pair<PtrT, PtrT>>> newChains(chunks);
+  Utils::parallelChunks(
+      chunks, stubs.size(),
+      [&](std::size_t chunkI, std::size_t begin, std::size_t end) {
+        auto &chains = newChains[chunkI];
+        for (auto i = begin; i < end; i++) {
+          auto &stub = stubs[i];
+          stub.data = arm64Utils.resolveStub(stub.addr);
+          if (!stub.data) {
             continue;
           }
-          const auto [sTarget, sFormat] = *sDataPair;
 
-          // First symbolize the stub
-          std::set<Provider::SymbolicInfo::Symbol> symbols;
+          if (stub.data->second == AStubFormat::StubNormal) {
+            stub.ldrAddr = arm64Utils.getStubLdrAddr(stub.addr);
+          } else if (stub.data->second == AStubFormat::AuthStubNormal) {
+            stub.ldrAddr = arm64Utils.getAuthStubLdrAddr(stub.addr);
+          }
 
-          // Though indirect entries
-          if (indirectI >= stTracker.indirectSyms.size()) {
-            SPDLOG_LOGGER_WARN(logger,
-                               "Unable to symbolize stub via indirect symbols "
-                               "as the index overruns the entries.");
+          if (auto cached = arm64Utils.getResolvedChain(stub.addr); cached) {
+            stub.targetFunc = *cached;
           } else {
-            const auto &[strIt, entry] =
-                stTracker.getSymbol(stTracker.indirectSyms.at(indirectI));
-            uint64_t ordinal = GET_LIBRARY_ORDINAL(entry.n_desc);
-            symbols.insert({*strIt, ordinal, std::nullopt});
+            stub.targetFunc = arm64Utils.followStubChain(stub.data->first);
+            chains.emplace_back(stub.addr, stub.targetFunc);
           }
+        }
+      });
+  for (const auto &chains : newChains) {
+    arm64Utils.addResolvedChains(chains);
+  }
 
-          // Though its pointer if not optimized
-          if (sFormat == AStubFormat::StubNormal) {
-            if (const auto pAddr = *arm64Utils.getStubLdrAddr(sAddr);
-                mCtx.containsAddr(pAddr)) {
-              if (pointerCache.ptr.lazy.contains(pAddr)) {
-                const auto &info = pointerCache.ptr.lazy.at(pAddr);
-                symbols.insert(info->symbols.begin(), info->symbols.end());
-              } else if (pointerCache.ptr.normal.contains(pAddr)) {
-                const auto &info = pointerCache.ptr.normal.at(pAddr);
-                symbols.insert(info->symbols.begin(), info->symbols.end());
-              }
-            }
-          }
+  for (const auto &stub : stubs) {
+    activity.update();
 
-          if (sFormat == AStubFormat::AuthStubNormal) {
-            if (const auto pAddr = *arm64Utils.getAuthStubLdrAddr(sAddr);
-                mCtx.containsAddr(pAddr) &&
-                pointerCache.ptr.auth.contains(pAddr)) {
-              const auto &info = pointerCache.ptr.auth.at(pAddr);
-              symbols.insert(info->symbols.begin(), info->symbols.end());
-            }
-          }
+    if (!stub.data) {
+      SPDLOG_LOGGER_ERROR(logger, "Unknown Arm64 stub format at {:#x}.",
+                          stub.addr);
+      continue;
+    }
+    const auto sFormat = stub.data->second;
 
-          // Though its target function
-          const PtrT sTargetFunc = arm64Utils.resolveStubChain(sAddr);
-          if (const auto info = symbolizer.symbolizeAddr(sTargetFunc); info) {
-            symbols.insert(info->symbols.begin(), info->symbols.end());
-          }
+    // First symbolize the stub
+    std::set<Provider::SymbolicInfo::Symbol> symbols;
 
-          if (!symbols.empty()) {
-            addStubInfo(sAddr,
-                        {symbols, Provider::SymbolicInfo::Encoding::None});
-            brokenStubs.emplace_back(sFormat, sTargetFunc, sAddr, sLoc,
-                                     stubSize);
-          } else {
-            SPDLOG_LOGGER_WARN(logger, "Unable to symbolize stub at {:#x}.",
-                               sAddr);
-          }
+    // Though indirect entries
+    if (stub.indirectI >= stTracker.indirectSyms.size()) {
+      SPDLOG_LOGGER_WARN(logger,
+                         "Unable to symbolize stub via indirect symbols "
+                         "as the index overruns the entries.");
+    } else {
+      const auto &[strId, entry] =
+          stTracker.getSymbol(stTracker.indirectSyms.at(stub.indirectI));
+      uint64_t ordinal = GET_LIBRARY_ORDINAL(entry.n_desc);
+      symbols.insert(
+          {std::string(stTracker.getString(strId)), ordinal, std::nullopt});
+    }
+
+    // Though its pointer if not optimized
+    if (sFormat == AStubFormat::StubNormal) {
+      if (const auto pAddr = *stub.ldrAddr; mCtx.containsAddr(pAddr)) {
+        if (pointerCache.ptr.lazy.contains(pAddr)) {
+          const auto &info = pointerCache.ptr.lazy.at(pAddr);
+          symbols.insert(info.symbols.begin(), info.symbols.end());
+        } else if (pointerCache.ptr.normal.contains(pAddr)) {
+          const auto &info = pointerCache.ptr.normal.at(pAddr);
+          symbols.insert(info.symbols.begin(), info.symbols.end());
         }
+      }
+    }
 
-        return true;
-      });
+    if (sFormat == AStubFormat::AuthStubNormal) {
+      if (const auto pAddr = *stub.ldrAddr;
+          mCtx.containsAddr(pAddr) && pointerCache.ptr.auth.contains(pAddr)) {
+        const auto &info = pointerCache.ptr.auth.at(pAddr);
+        symbols.insert(info.symbols.begin(), info.symbols.end());
+      }
+    }
+
+    // Though its target function
+    if (const auto info = symbolizer.symbolizeAddr(stub.targetFunc); info) {
+      symbols.insert(info->symbols.begin(), info->symbols.end());
+    }
+
+    if (!symbols.empty()) {
+      addStubInfo(stub.addr, {symbols, Provider::SymbolicInfo::Encoding::None});
+      brokenStubs.emplace_back(sFormat, stub.targetFunc, stub.addr, stub.loc,
+                               stub.size);
+    } else {
+      SPDLOG_LOGGER_WARN(logger, "Unable to symbolize stub at {:#x}.",
+                         stub.addr);
+    }
+  }
 }
 
 template <class A>
@@ -319,37 +374,21 @@ template <class A> void Arm64Fixer<A>::fixPass2() {
     case AStubFormat::StubOptimized: {
       // Try to find an unused named lazy pointer
       PtrT pAddr = 0;
-      for (const auto &sym : sSymbols.symbols) {
-        if (pointerCache.reverse.lazy.contains(sym.name)) {
-          for (const auto ptr : pointerCache.reverse.lazy[sym.name]) {
-            if (!pointerCache.used.lazy.contains(ptr)) {
-              pAddr = ptr;
-              pointerCache.used.lazy.insert(ptr);
-              break;
-            }
-          }
-          if (pAddr) {
-            break;
-          }
-        }
+      if (const auto ptr =
+              pointerCache.findFreePointer(SPointerType::lazy, sSymbols);
+          ptr) {
+        pAddr = *ptr;
+        pointerCache.used.lazy.insert(pAddr);
       }
 
       // Try to find an unused named normal pointer
       if (!pAddr) {
-        for (const auto &sym : sSymbols.symbols) {
-          if (pointerCache.reverse.normal.contains(sym.name)) {
-            for (const auto ptr : pointerCache.reverse.normal[sym.name]) {
-              if (!pointerCache.used.normal.contains(ptr)) {
-                pAddr = ptr;
-                pointerCache.used.normal.insert(ptr);
-                ptrTracker.add(pAddr, 0);
-                break;
-              }
-            }
-            if (pAddr) {
-              break;
-            }
-          }
+        if (const auto ptr =
+                pointerCache.findFreePointer(SPointerType::normal, sSymbols);
+            ptr) {
+          pAddr = *ptr;
+          pointerCache.used.normal.insert(pAddr);
+          ptrTracker.add(pAddr, 0);
         }
       }
 
@@ -383,18 +422,10 @@ template <class A> void Arm64Fixer<A>::fixPass2() {
     case AStubFormat::AuthStubOptimized: {
       // Try to find an unused named pointer
       PtrT pAddr = 0;
-      for (const auto &sym : sSymbols.symbols) {
-        if (pointerCache.reverse.auth.contains(sym.name)) {
-          for (const auto ptr : pointerCache.reverse.auth[sym.name]) {
-            if (!pointerCache.used.auth.contains(ptr)) {
-              pAddr = ptr;
-              break;
-            }
-          }
-          if (pAddr) {
-            break;
-          }
-        }
+      if (const auto ptr =
+              pointerCache.findFreePointer(SPointerType::auth, sSymbols);
+          ptr) {
+        pAddr = *ptr;
       }
 
       if (!pAddr && !pointerCache.unnamed.auth.empty()) {
@@ -436,24 +467,129 @@ template <class A> void Arm64Fixer<A>::fixPass2() {
 template <class A> void Arm64Fixer<A>::fixCallsites() {
   activity.update(std::nullopt, "Fixing Callsites");
   const auto textSect = mCtx.getSection(SEG_TEXT, SECT_TEXT).second;
+  const PtrT textStart = textSect->addr;
+  const PtrT textEnd = textSect->addr + textSect->size;
+
+  // Split the text into ranges of whole functions
+  auto &funcTracker = delegate.eCtx.funcTracker;
+  funcTracker.load();
+  const auto &funcs = funcTracker.getFunctions();
+  const auto chunks = Utils::chunkCount(delegate.eCtx.threads, funcs.size(),
+                                        STUBS_MIN_FUNCS_PER_THREAD);
+  auto chunkStart = [&](std::size_t chunkI) -> PtrT {
+    if (chunkI == 0) {
+      return textStart;
+    } else if (chunkI == chunks) {
+      return textEnd;
+    }
+    return std::clamp(funcs[funcs.size() * chunkI / chunks].address, textStart,
+                      textEnd);
+  };
+
+  // Callsites are rewritten after all chunks are done, and unfixed
+  // callsites are checked and reported in order.
+  std::vector<std::vector<std::pair<uint32_t *, uint32_t>>> rewrites(chunks);
+  std::vector<std::vector<UnfixedCallsite>> unfixed(chunks);
+  Utils::parallelChunks(
+      chunks, chunks, [&](std::size_t chunkI, std::size_t, std::size_t) {
+        fixCallsiteRange(chunkStart(chunkI), chunkStart(chunkI + 1),
+                         chunkI == 0, rewrites[chunkI], unfixed[chunkI]);
+      });
 
-  auto iAddr = textSect->addr;
-  auto iLoc = mCtx.convertAddrP(iAddr);
-  for (; iAddr < textSect->addr + textSect->size; iAddr += 4, iLoc += 4) {
-    /**
-     * We are only looking for bl and b instructions only.
-     * Theses instructions are only identical by their top
-     * most byte. By only looking at the top byte, we can
-     * save a lot of time.
-     */
-    const uint32_t instrTop = *(iLoc + 3) & 0xFC;
-    if (instrTop != 0x94 && instrTop != 0x14) {
+  for (const auto &chunkRewrites : rewrites) {
+    for (const auto &[instr, newInstr] : chunkRewrites) {
+      *instr = newInstr;
+    }
+  }
+
+  // Check if the unfixed callsites are pointing to code
+  std::vector<UnfixedCallsite> callsites;
+  for (auto &chunkUnfixed : unfixed) {
+    callsites.insert(callsites.end(),
+                     std::make_move_iterator(chunkUnfixed.begin()),
+                     std::make_move_iterator(chunkUnfixed.end()));
+  }
+  std::vector<PtrT> targetFuncs;
+  targetFuncs.reserve(callsites.size());
+  for (const auto &callsite : callsites) {
+    targetFuncs.push_back(callsite.brTargetFunc);
+  }
+  std::vector<uint8_t> inCode(callsites.size());
+  delegate.accelerator.codeRegions.containsAll(targetFuncs, inCode);
+
+  for (std::size_t callsiteI = 0; callsiteI < callsites.size(); callsiteI++) {
+    if (!inCode[callsiteI]) {
+      continue;
+    }
+    const auto &[iAddr, brTarget, brTargetFunc, names] = callsites[callsiteI];
+
+    // It might be in a non code region, check if the previous instructions
+    // are invalid. This is the only part that needs the disassembler, so
+    // it's only loaded when needed.
+    disasm.load(delegate.eCtx.threads);
+    auto inst = disasm.instructionAtAddr(iAddr);
+    if (inst == disasm.instructionsEnd()) {
       continue;
     }
 
+    bool invalidInst = false;
+    for (int i = 0; inst != disasm.instructionsBegin() && i <= 2;
+         inst--, i++) {
+      if (inst->id == DISASM_INVALID_INSN) {
+        invalidInst = true;
+        break;
+      }
+    }
+    if (invalidInst) {
+      continue;
+    }
+
+    if (!names) {
+      SPDLOG_LOGGER_WARN(logger,
+                         "Unable to symbolize branch at {:#x} with target "
+                         "{:#x} and destination {:#x}.",
+                         iAddr, brTarget, brTargetFunc);
+    } else {
+      const auto &symbols = names->symbols;
+      std::string symbolNames;
+      for (auto it = symbols.cbegin(); it != std::prev(symbols.cend()); it++) {
+        symbolNames += it->name + ", ";
+      }
+      symbolNames += symbols.crbegin()->name;
+
+      SPDLOG_LOGGER_WARN(logger,
+                         "Unable to find stub for branch at {:#x}, with target "
+                         "{:#x}, with symbols {}.",
+                         iAddr, brTarget, symbolNames);
+    }
+  }
+}
+
+/// @brief Fix callsites in a range of the text
+///
+/// Only reads shared state, so ranges can be fixed concurrently.
+/// @param start The first address in the range.
+/// @param end The end of the range, exclusive.
+/// @param updateActivity If the activity logger should be updated.
+/// @param rewrites Appended with the instructions to write.
+/// @param unfixed Appended with callsites that might need fixing.
+template <class A>
+void Arm64Fixer<A>::fixCallsiteRange(
+    const PtrT start, const PtrT end, const bool updateActivity,
+    std::vector<std::pair<uint32_t *, uint32_t>> &rewrites,
+    std::vector<UnfixedCallsite> &unfixed) {
+  const auto textAddr = mCtx.getSection(SEG_TEXT, SECT_TEXT).second->addr;
+
+  auto iAddr = start;
+  auto iLoc = mCtx.convertAddrP(iAddr);
+  for (; iAddr < end; iAddr += 4, iLoc += 4) {
+    // We are only looking for bl and b instructions only.
     const auto brInstr = (uint32_t *)iLoc;
-    const SPtrT brOff =
-      arm64Utils.template signExtend<SPtrT, 28>((*brInstr & 0x3FFFFFF) << 2);
+    if (!Arm64Decoder::isImmBranch(*brInstr)) {
+      continue;
+    }
+
+    const SPtrT brOff = (SPtrT)Arm64Decoder::branchOffset(*brInstr);
     const auto brTarget = iAddr + brOff;
 
     // Check if it needs fixing
@@ -482,86 +618,47 @@ template <class A> void Arm64Fixer<A>::fixCallsites() {
     }
 
     // Try to fix stub
-    bool stubFixed = false;
     if (names) {
+      bool stubFixed = false;
       for (const auto &name : names->symbols) {
-        if (reverseStubMap.contains(name.name)) {
-          const auto stubAddr = *reverseStubMap[name.name].begin();
+        if (auto it = reverseStubMap.find(name.name);
+            it != reverseStubMap.end()) {
+          const auto stubAddr = *it->second.begin();
           const auto imm26 = ((SPtrT)stubAddr - iAddr) >> 2;
-          *brInstr = (*brInstr & 0xFC000000) | (uint32_t)imm26;
+          rewrites.emplace_back(brInstr, (*brInstr & 0xFC000000) |
+                                             ((uint32_t)imm26 & 0x3FFFFFF));
           stubFixed = true;
           break;
         }
       }
 
       if (stubFixed) {
-        activity.update();
-        continue;
-      }
-    }
-
-    if (!stubFixed) {
-      /**
-       * Sometimes there are bytes of data in the text section
-       * that match the bl and b filter, these seem to follow a
-       * BR or other branch, skip these.
-       */
-      if (iAddr != textSect->addr) {
-        const auto lastInstrTop = *(iLoc - 1) & 0xFC;
-        if (lastInstrTop == 0x94 || lastInstrTop == 0x14 ||
-            lastInstrTop == 0xD4) {
-          continue;
+        if (updateActivity) {
+          activity.update();
         }
-      }
-
-      if (brTarget == brTargetFunc) {
-        // it probably isn't a branch if it didn't go though any stubs...
-        continue;
-      }
-
-      // Check if it's pointing to code
-      if (!delegate.isInCodeRegions(brTargetFunc)) {
-        continue;
-      }
-
-      // It might be in a non code region, check if the previous instructions
-      // are invalid
-      auto inst = disasm.instructionAtAddr(iAddr);
-      if (inst == disasm.instructionsEnd()) {
         continue;
       }
+    }
 
-      bool invalidInst = false;
-      for (int i = 0; inst != disasm.instructionsBegin() && i <= 2;
-           inst--, i++) {
-        if (inst->id == DISASM_INVALID_INSN) {
-          invalidInst = true;
-          break;
-        }
-      }
-      if (invalidInst) {
+    /**
+     * Sometimes there are bytes of data in the text section
+     * that match the bl and b filter, these seem to follow a
+     * BR or other branch, skip these.
+     */
+    if (iAddr != textAddr) {
+      const auto lastInstrTop = *(iLoc - 1) & 0xFC;
+      if (lastInstrTop == 0x94 || lastInstrTop == 0x14 ||
+          lastInstrTop == 0xD4) {
         continue;
       }
     }
 
-    if (!names) {
-      SPDLOG_LOGGER_WARN(logger,
-                         "Unable to symbolize branch at {:#x} with target "
-                         "{:#x} and destination {:#x}.",
-                         iAddr, brTarget, brTargetFunc);
-    } else {
-      const auto &symbols = names->symbols;
-      std::string symbolNames;
-      for (auto it = symbols.cbegin(); it != std::prev(symbols.cend()); it++) {
-        symbolNames += it->name + ", ";
-      }
-      symbolNames += symbols.crbegin()->name;
-
-      SPDLOG_LOGGER_WARN(logger,
-                         "Unable to find stub for branch at {:#x}, with target "
-                         "{:#x}, with symbols {}.",
-                         iAddr, brTarget, symbolNames);
+    if (brTarget == brTargetFunc) {
+      // it probably isn't a branch if it didn't go though any stubs...
+      continue;
     }
+
+    unfixed.push_back({iAddr, brTarget, brTargetFunc, names});
   }
 }
 
@@ -34,11 +34,23 @@ private:
         : format(fmt), target(tgt), addr(address), loc(location), size(sz) {}
     };
     
+    /// A callsite that could not be fixed, and might not be a branch.
+    struct UnfixedCallsite {
+        PtrT iAddr;
+        PtrT brTarget;
+        PtrT brTargetFunc;
+        const Provider::SymbolicInfo *names;
+    };
+    
     void fixStubHelpers();
     void scanStubs();
     void fixPass1();
     void fixPass2();
     void fixCallsites();
+    void fixCallsiteRange(const PtrT start, const PtrT end,
+                          const bool updateActivity,
+                          std::vector<std::pair<uint32_t *, uint32_t>> &rewrites,
+                          std::vector<UnfixedCallsite> &unfixed);
     
     void addStubInfo(PtrT sAddr, Provider::SymbolicInfo info);
     
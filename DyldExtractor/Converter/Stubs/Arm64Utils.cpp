@@ -1,5 +1,11 @@
 #include "Arm64Utils.h"
 
+#include "Arm64Decoder.h"
+#include <Utils/Threading.h>
+#include <utility>
+
+#define ARM64_MIN_ISLAND_INSTRS_PER_THREAD 0x4000
+
 using namespace DyldExtractor;
 using namespace Converter;
 using namespace Stubs;
@@ -8,21 +14,7 @@ template <class A>
 Arm64Utils<A>::Arm64Utils(const Dyld::Context &dCtx,
                           Provider::Accelerator<P> &accelerator,
                           const Provider::PointerTracker<P> &ptrTracker)
-    : dCtx(dCtx), ptrTracker(ptrTracker), accelerator(accelerator) {
-
-  stubResolvers = {
-      {StubFormat::StubNormal,
-       [this](PtrT a) { return getStubNormalTarget(a); }},
-      {StubFormat::StubOptimized,
-       [this](PtrT a) { return getStubOptimizedTarget(a); }},
-      {StubFormat::AuthStubNormal,
-       [this](PtrT a) { return getAuthStubNormalTarget(a); }},
-      {StubFormat::AuthStubOptimized,
-       [this](PtrT a) { return getAuthStubOptimizedTarget(a); }},
-      {StubFormat::AuthStubResolver,
-       [this](PtrT a) { return getAuthStubResolverTarget(a); }},
-      {StubFormat::Resolver, [this](PtrT a) { return getResolverTarget(a); }}};
-}
+    : dCtx(dCtx), ptrTracker(ptrTracker), accelerator(accelerator) {}
 
 template <class A> bool Arm64Utils<A>::isStubBinder(const PtrT addr) const {
   /**
@@ -144,21 +136,18 @@ Arm64Utils<A>::getResolverData(const PtrT addr) const {
   // Hopefully it's a resolver, first get function target
   PtrT blResult;
   {
-    const SPtrT imm = signExtend<SPtrT, 28>((*blInstr & 0x3FFFFFF) << 2);
+    const SPtrT imm = (SPtrT)Arm64Decoder::branchOffset(*blInstr);
     blResult = addr + ((PtrT)(blInstr - p) * 4) + imm;
   }
 
   // Get pointer
   PtrT adrpResult;
   {
-    const uint64_t immlo = (adrp & 0x60000000) >> 29;
-    const uint64_t immhi = (adrp & 0xFFFFE0) >> 3;
-    const int64_t imm = signExtend<int64_t, 33>((immhi | immlo) << 12);
-    adrpResult = (PtrT)((addr & ~0xFFF) + imm);
+    adrpResult = (PtrT)Arm64Decoder::adrpTarget(addr, adrp);
   }
   PtrT addResult;
   {
-    const PtrT addImm = (add & 0x3FFC00) >> 10;
+    const PtrT addImm = Arm64Decoder::addImm(add);
     addResult = adrpResult + addImm;
   }
   PtrT strResult;
@@ -176,22 +165,56 @@ template <class A>
 std::optional<
     std::pair<typename Arm64Utils<A>::PtrT, typename Arm64Utils<A>::StubFormat>>
 Arm64Utils<A>::resolveStub(const PtrT addr) const {
-  for (auto &[format, resolver] : stubResolvers) {
-    if (auto res = resolver(addr); res != std::nullopt) {
-      return std::make_pair(*res, format);
+  std::optional<std::pair<PtrT, StubFormat>> result;
+  auto tryFormat = [&]<StubFormat format>() {
+    if (auto target = getStubTarget<format>(addr); target) {
+      result.emplace(*target, format);
+      return true;
     }
-  }
+    return false;
+  };
 
-  return std::nullopt;
+  // Unrolled over the formats in order, stopping at the first match
+  [&]<std::size_t... I>(std::index_sequence<I...>) {
+    (tryFormat.template operator()<STUB_FORMATS[I]>() || ...);
+  }(std::make_index_sequence<std::size(STUB_FORMATS)>());
+  return result;
+}
+
+template <class A>
+template <typename Arm64Utils<A>::StubFormat format>
+std::optional<typename Arm64Utils<A>::PtrT>
+Arm64Utils<A>::getStubTarget(const PtrT addr) const {
+  if constexpr (format == StubFormat::StubNormal) {
+    return getStubNormalTarget(addr);
+  } else if constexpr (format == StubFormat::StubOptimized) {
+    return getStubOptimizedTarget(addr);
+  } else if constexpr (format == StubFormat::AuthStubNormal) {
+    return getAuthStubNormalTarget(addr);
+  } else if constexpr (format == StubFormat::AuthStubOptimized) {
+    return getAuthStubOptimizedTarget(addr);
+  } else if constexpr (format == StubFormat::AuthStubResolver) {
+    return getAuthStubResolverTarget(addr);
+  } else {
+    static_assert(format == StubFormat::Resolver);
+    return getResolverTarget(addr);
+  }
 }
 
 template <class A>
 Arm64Utils<A>::PtrT Arm64Utils<A>::resolveStubChain(const PtrT addr) {
-  if (accelerator.arm64ResolvedChains.contains(addr)) {
-    return accelerator.arm64ResolvedChains[addr];
+  if (auto cached = getResolvedChain(addr); cached) {
+    return *cached;
   }
 
-  PtrT target = addr;
+  const PtrT target = followStubChain(addr);
+  accelerator.arm64ResolvedChains.insert(addr, target);
+
+  return target;
+}
+
+template <class A>
+Arm64Utils<A>::PtrT Arm64Utils<A>::followStubChain(PtrT target) const {
   while (true) {
     if (auto stubData = resolveStub(target); stubData != std::nullopt) {
       target = stubData->first;
@@ -199,10 +222,80 @@ Arm64Utils<A>::PtrT Arm64Utils<A>::resolveStubChain(const PtrT addr) {
       break;
     }
   }
+  return target;
+}
+
+template <class A>
+std::optional<typename Arm64Utils<A>::PtrT>
+Arm64Utils<A>::getResolvedChain(const PtrT addr) const {
+  const auto &islands = accelerator.arm64StubIslands;
+  if (auto it = std::lower_bound(
+          islands.begin(), islands.end(), addr,
+          [](const auto &entry, PtrT a) { return entry.first < a; });
+      it != islands.end() && it->first == addr) {
+    return it->second;
+  }
 
-  accelerator.arm64ResolvedChains[addr] = target;
+  return accelerator.arm64ResolvedChains.get(addr);
+}
 
-  return target;
+template <class A>
+void Arm64Utils<A>::addResolvedChains(
+    const std::vector<std::pair<PtrT, PtrT>> &chains) {
+  for (const auto &[addr, target] : chains) {
+    accelerator.arm64ResolvedChains.insert(addr, target);
+  }
+}
+
+template <class A>
+void Arm64Utils<A>::scanStubIslands(
+    const std::vector<std::pair<PtrT, PtrT>> &islands, unsigned int threads) {
+  // The index of the first instruction in each island. Decoding a resolver
+  // can read up to 50 instructions ahead, so the end of each island is left
+  // to be resolved lazily, as it may be the end of a mapping.
+  const PtrT ISLAND_TAIL = 50 * 4;
+  std::vector<std::size_t> starts;
+  starts.reserve(islands.size());
+  std::size_t count = 0;
+  for (const auto &[start, end] : islands) {
+    starts.push_back(count);
+    if (end - start > ISLAND_TAIL) {
+      count += (end - start - ISLAND_TAIL) / 4;
+    }
+  }
+  if (!count) {
+    return;
+  }
+
+  // Try every instruction as a stub, chunks are in address order
+  const auto chunks =
+      Utils::chunkCount(threads, count, ARM64_MIN_ISLAND_INSTRS_PER_THREAD);
+  std::vector<std::vector<std::pair<PtrT, PtrT>>> results(chunks);
+  Utils::parallelChunks(
+      chunks, count,
+      [&](std::size_t chunkI, std::size_t begin, std::size_t end) {
+        auto islandI =
+            (std::size_t)(std::upper_bound(starts.begin(), starts.end(),
+                                           begin) -
+                          starts.begin() - 1);
+        auto &chains = results[chunkI];
+        for (auto i = begin; i < end; i++) {
+          while (islandI + 1 < starts.size() && starts[islandI + 1] <= i) {
+            islandI++;
+          }
+
+          const PtrT addr =
+              islands[islandI].first + (PtrT)(i - starts[islandI]) * 4;
+          if (const auto stub = resolveStub(addr); stub) {
+            chains.emplace_back(addr, followStubChain(stub->first));
+          }
+        }
+      });
+
+  auto &table = accelerator.arm64StubIslands;
+  for (const auto &chains : results) {
+    table.insert(table.end(), chains.begin(), chains.end());
+  }
 }
 
 template <class A>
@@ -258,13 +351,10 @@ Arm64Utils<A>::getStubLdrAddr(const PtrT addr) const {
   }
 
   // adrp
-  const uint64_t immlo = (adrp & 0x60000000) >> 29;
-  const uint64_t immhi = (adrp & 0xFFFFE0) >> 3;
-  const int64_t imm = signExtend<int64_t, 33>((immhi | immlo) << 12);
-  const PtrT adrpResult = (PtrT)((addr & ~0xFFF) + imm);
+  const PtrT adrpResult = (PtrT)Arm64Decoder::adrpTarget(addr, adrp);
 
   // ldr
-  const PtrT offset = getLdrOffset(ldr);
+  const PtrT offset = Arm64Decoder::ldrOffset(ldr);
   return adrpResult + offset;
 }
 
@@ -287,17 +377,14 @@ Arm64Utils<A>::getAuthStubLdrAddr(const PtrT addr) const {
   }
 
   // adrp
-  const uint64_t immhi = (adrp & 0xFFFFE0) >> 3;
-  const uint64_t immlo = (adrp & 0x60000000) >> 29;
-  const int64_t adrpImm = signExtend<int64_t, 33>((immhi | immlo) << 12);
-  const PtrT adrpResult = (PtrT)((addr & ~0xFFF) + adrpImm);
+  const PtrT adrpResult = (PtrT)Arm64Decoder::adrpTarget(addr, adrp);
 
   // add
-  const PtrT addImm = (add & 0x3FFC00) >> 10;
+  const PtrT addImm = Arm64Decoder::addImm(add);
   const PtrT addResult = adrpResult + addImm;
 
   // ldr
-  const PtrT ldrOffset = getLdrOffset(ldr);
+  const PtrT ldrOffset = Arm64Decoder::ldrOffset(ldr);
   return addResult + ldrOffset;
 }
 
@@ -375,13 +462,10 @@ Arm64Utils<A>::getStubNormalTarget(const PtrT addr) const {
   }
 
   // adrp
-  const uint64_t immlo = (adrp & 0x60000000) >> 29;
-  const uint64_t immhi = (adrp & 0xFFFFE0) >> 3;
-  const int64_t imm = signExtend<int64_t, 33>((immhi | immlo) << 12);
-  const PtrT adrpResult = (PtrT)((addr & ~0xFFF) + imm);
+  const PtrT adrpResult = (PtrT)Arm64Decoder::adrpTarget(addr, adrp);
 
   // ldr
-  const PtrT offset = getLdrOffset(ldr);
+  const PtrT offset = Arm64Decoder::ldrOffset(ldr);
   const PtrT ldrTarget = adrpResult + offset;
   return ptrTracker.slideP(ldrTarget);
 }
@@ -410,13 +494,10 @@ Arm64Utils<A>::getStubOptimizedTarget(const PtrT addr) const {
   }
 
   // adrp
-  const uint64_t immlo = (adrp & 0x60000000) >> 29;
-  const uint64_t immhi = (adrp & 0xFFFFE0) >> 3;
-  const int64_t imm = signExtend<int64_t, 33>((immhi | immlo) << 12);
-  const PtrT adrpResult = (PtrT)((addr & ~0xFFF) + imm);
+  const PtrT adrpResult = (PtrT)Arm64Decoder::adrpTarget(addr, adrp);
 
   // add
-  const PtrT imm12 = (add & 0x3FFC00) >> 10;
+  const PtrT imm12 = Arm64Decoder::addImm(add);
   return adrpResult + imm12;
 }
 
@@ -446,17 +527,14 @@ Arm64Utils<A>::getAuthStubNormalTarget(const PtrT addr) const {
   }
 
   // adrp
-  const uint64_t immhi = (adrp & 0xFFFFE0) >> 3;
-  const uint64_t immlo = (adrp & 0x60000000) >> 29;
-  const int64_t adrpImm = signExtend<int64_t, 33>((immhi | immlo) << 12);
-  const PtrT adrpResult = (PtrT)((addr & ~0xFFF) + adrpImm);
+  const PtrT adrpResult = (PtrT)Arm64Decoder::adrpTarget(addr, adrp);
 
   // add
-  const PtrT addImm = (add & 0x3FFC00) >> 10;
+  const PtrT addImm = Arm64Decoder::addImm(add);
   const PtrT addResult = adrpResult + addImm;
 
   // ldr
-  const PtrT ldrOffset = getLdrOffset(ldr);
+  const PtrT ldrOffset = Arm64Decoder::ldrOffset(ldr);
   const PtrT ldrTarget = addResult + ldrOffset;
   return ptrTracker.slideP(ldrTarget);
 }
@@ -487,12 +565,9 @@ Arm64Utils<A>::getAuthStubOptimizedTarget(const PtrT addr) const {
   }
 
   // adrp
-  const uint64_t immlo = (adrp & 0x60000000) >> 29;
-  const uint64_t immhi = (adrp & 0xFFFFE0) >> 3;
-  const int64_t imm = signExtend<int64_t, 33>((immhi | immlo) << 12);
-  const PtrT adrpResult = (PtrT)((addr & ~0xFFF) + imm);
+  const PtrT adrpResult = (PtrT)Arm64Decoder::adrpTarget(addr, adrp);
 
-  const PtrT imm12 = (add & 0x3FFC00) >> 10;
+  const PtrT imm12 = Arm64Decoder::addImm(add);
   return adrpResult + imm12;
 }
 
@@ -520,13 +595,10 @@ Arm64Utils<A>::getAuthStubResolverTarget(const PtrT addr) const {
   }
 
   // adrp
-  const uint64_t immlo = (adrp & 0x60000000) >> 29;
-  const uint64_t immhi = (adrp & 0xFFFFE0) >> 3;
-  const int64_t imm = signExtend<int64_t, 33>((immhi | immlo) << 12);
-  const PtrT adrpResult = (PtrT)((addr & ~0xFFF) + imm);
+  const PtrT adrpResult = (PtrT)Arm64Decoder::adrpTarget(addr, adrp);
 
   // ldr
-  const PtrT ldrOffset = getLdrOffset(ldr);
+  const PtrT ldrOffset = Arm64Decoder::ldrOffset(ldr);
   const PtrT ldrTarget = adrpResult + ldrOffset;
   return ptrTracker.slideP(ldrTarget);
 }
@@ -542,11 +614,5 @@ Arm64Utils<A>::getResolverTarget(const PtrT addr) const {
   }
 }
 
-template <class A>
-typename Arm64Utils<A>::PtrT Arm64Utils<A>::getLdrOffset(const uint32_t ldrI) {
-  int scale = ldrI >> 30;
-  return (ldrI & 0x3FFC00) >> (10 - scale);
-}
-
 template class DyldExtractor::Converter::Stubs::Arm64Utils<Utils::Arch::arm64>;
 template class DyldExtractor::Converter::Stubs::Arm64Utils<Utils::Arch::arm64_32>;
@@ -60,6 +60,27 @@ public:
   ///     addr or an address to a stub if the format is not known.
   PtrT resolveStubChain(const PtrT addr);
 
+  /// @brief Follow a stub chain without the accelerator.
+  /// @param target The target of the first stub in the chain.
+  /// @returns The address to the final target.
+  PtrT followStubChain(PtrT target) const;
+
+  /// @brief Get a stub chain that was already resolved.
+  /// @param addr The address of the first stub.
+  /// @returns The final target, or nullopt if it was not resolved.
+  std::optional<PtrT> getResolvedChain(const PtrT addr) const;
+
+  /// @brief Add resolved stub chains to the accelerator.
+  /// @param chains Pairs of the first stub and the final target.
+  void addResolvedChains(const std::vector<std::pair<PtrT, PtrT>> &chains);
+
+  /// @brief Resolve every stub in the stub islands.
+  /// Fills the accelerator's stub island table, call once per cache.
+  /// @param islands Sorted address ranges of code outside of images.
+  /// @param threads The maximum number of threads.
+  void scanStubIslands(const std::vector<std::pair<PtrT, PtrT>> &islands,
+                       unsigned int threads);
+
   /// @brief Resolve a stub chain with extended chain information
   /// @param addr The address of the first stub
   /// @return A vector of stubs in the chain, the first in the pair is the
@@ -114,8 +135,15 @@ private:
   Provider::Accelerator<P> &accelerator;
   const Provider::PointerTracker<P> &ptrTracker;
 
-  using ResolverT = typename std::function<std::optional<PtrT>(PtrT)>;
-  std::map<StubFormat, ResolverT> stubResolvers;
+  /// The formats in the order that resolveStub tries them
+  static constexpr StubFormat STUB_FORMATS[] = {
+      StubFormat::StubNormal,        StubFormat::StubOptimized,
+      StubFormat::AuthStubNormal,    StubFormat::AuthStubOptimized,
+      StubFormat::AuthStubResolver, StubFormat::Resolver};
+
+  /// @brief Get the target of a stub in a format, resolved at compile time.
+  template <StubFormat format>
+  std::optional<PtrT> getStubTarget(const PtrT addr) const;
 
   std::optional<PtrT> getStubNormalTarget(const PtrT addr) const;
   std::optional<PtrT> getStubOptimizedTarget(const PtrT addr) const;
@@ -123,8 +151,6 @@ private:
   std::optional<PtrT> getAuthStubOptimizedTarget(const PtrT addr) const;
   std::optional<PtrT> getAuthStubResolverTarget(const PtrT addr) const;
   std::optional<PtrT> getResolverTarget(const PtrT addr) const;
-
-  static PtrT getLdrOffset(const uint32_t ldrI);
 };
 
 }; // namespace DyldExtractor::Converter::Stubs
@@ -0,0 +1,141 @@
+#ifndef __CONVERTER_STUBS_ARMDECODER__
+#define __CONVERTER_STUBS_ARMDECODER__
+
+#include <array>
+#include <stdint.h>
+
+/// Masked instruction patterns for the armv7 stubs and stub helpers. All
+/// formats are classified together, so a stub is matched in one pass over its
+/// words.
+namespace DyldExtractor::Converter::Stubs::ArmDecoder {
+
+enum class Format : uint8_t {
+  // ldr ip, [pc, #4]; add ip, pc, ip; ldr pc, [ip]; data
+  NormalV4,
+  // ldr ip, [pc]; add pc, pc, ip; data; trap
+  OptimizedV5,
+  // stmdb; blx; ldr; add; str; cpy; ldmia; bx; data
+  Resolver,
+  // str; ldr; add; str; ldr; add; ldr; data; data
+  StubBinder,
+  // ldr ip, [pc]; b; data
+  StubHelper
+};
+
+struct Word {
+  uint32_t mask;
+  uint32_t value;
+};
+
+struct Pattern {
+  Format format;
+  uint8_t count;
+  std::array<Word, 8> words;
+};
+
+/// Words with a mask of 0 match anything, like inline data.
+inline constexpr Pattern PATTERNS[] = {
+    {Format::NormalV4,
+     3,
+     {{{0xFFFFFFFF, 0xE59FC004},
+       {0xFFFFFFFF, 0xE08FC00C},
+       {0xFFFFFFFF, 0xE59CF000}}}},
+    {Format::OptimizedV5,
+     4,
+     {{{0xFFFFFFFF, 0xE59FC000},
+       {0xFFFFFFFF, 0xE08FF00C},
+       {0x00000000, 0x00000000},
+       {0xFFFFFFFF, 0xE7FFDEFE}}}},
+    {Format::Resolver,
+     8,
+     {{{0x0FD00000, 0x09000000},
+       {0xFE000000, 0xFA000000},
+       {0x0E500000, 0x04100000},
+       {0x0FE00010, 0x00800000},
+       {0x0E500000, 0x04000000},
+       {0x0FEF0FF0, 0x01A00000},
+       {0x0FD00000, 0x08900000},
+       {0x0FFFFFF0, 0x012FFF10}}}},
+    {Format::StubBinder,
+     7,
+     {{{0x0E500000, 0x04000000},
+       {0x0F7F0000, 0x051F0000},
+       {0x0FE00010, 0x00800000},
+       {0x0E500000, 0x04000000},
+       {0x0F7F0000, 0x051F0000},
+       {0x0FE00010, 0x00800000},
+       {0x0E500000, 0x04100000}}}},
+    {Format::StubHelper,
+     2,
+     {{{0xFFFFFFFF, 0xE59FC000}, {0x0F000000, 0x0A000000}}}},
+};
+
+inline constexpr std::size_t MAX_WORDS = 8;
+
+/// The bit of a format in a set of formats.
+constexpr uint8_t formatBit(const Format format) {
+  return (uint8_t)(1 << (uint8_t)format);
+}
+
+/// For each top byte of the first word, a bit set of the patterns that can
+/// match it.
+inline constexpr auto FIRST_BYTE_CANDIDATES = [] {
+  std::array<uint8_t, 256> table{};
+  for (uint32_t top = 0; top < 256; top++) {
+    for (uint8_t i = 0; i < std::size(PATTERNS); i++) {
+      const auto &word = PATTERNS[i].words[0];
+      if (((top << 24) & word.mask) == (word.value & word.mask & 0xFF000000)) {
+        table[top] |= (uint8_t)(1 << i);
+      }
+    }
+  }
+  return table;
+}();
+
+/// @brief Classify instructions against all patterns.
+/// @param p The instructions, must have at least MAX_WORDS words readable.
+/// @returns A bit set of the matching formats, see formatBit.
+constexpr uint8_t classify(const uint32_t *p) {
+  uint8_t candidates = FIRST_BYTE_CANDIDATES[p[0] >> 24];
+  uint8_t matched = 0;
+  for (std::size_t w = 0; w < MAX_WORDS && candidates; w++) {
+    for (auto c = candidates; c; c &= c - 1) {
+      const auto i = __builtin_ctz(c);
+      const auto &pattern = PATTERNS[i];
+      if (w == pattern.count) {
+        // Fully matched
+        matched |= formatBit(pattern.format);
+        candidates &= (uint8_t)~(1 << i);
+      } else if ((p[w] & pattern.words[w].mask) != pattern.words[w].value) {
+        candidates &= (uint8_t)~(1 << i);
+      }
+    }
+  }
+
+  // Patterns with the maximum number of words
+  for (auto c = candidates; c; c &= c - 1) {
+    matched |= formatBit(PATTERNS[__builtin_ctz(c)].format);
+  }
+  return matched;
+}
+
+/// @brief Check if instructions match a format.
+/// @param p The instructions, must have enough words for the format.
+constexpr bool matches(const Format format, const uint32_t *p) {
+  for (const auto &pattern : PATTERNS) {
+    if (pattern.format != format) {
+      continue;
+    }
+    for (std::size_t w = 0; w < pattern.count; w++) {
+      if ((p[w] & pattern.words[w].mask) != pattern.words[w].value) {
+        return false;
+      }
+    }
+    return true;
+  }
+  return false;
+}
+
+} // namespace DyldExtractor::Converter::Stubs::ArmDecoder
+
+#endif // __CONVERTER_STUBS_ARMDECODER__
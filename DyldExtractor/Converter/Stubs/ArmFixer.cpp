@@ -105,11 +105,16 @@ void ArmFixer::scanStubs() {
                                const auto sSize = sect->reserved2;
                                uint8_t *sLoc = mCtx.convertAddrP(sect->addr);
                                uint32_t indirectI = sect->reserved1;
-                               for (PtrT sAddr = sect->addr; sAddr < sect->addr + sect->size;
-                                    sAddr += sSize, sLoc += sSize, indirectI++) {
+                               
+                               // Decode the whole section at once
+                               const auto decoded =
+                               armUtils.resolveStubs(sect->addr, sect->size, sSize);
+                               PtrT sAddr = sect->addr;
+                               for (std::size_t stubI = 0; stubI < decoded.size();
+                                    stubI++, sAddr += sSize, sLoc += sSize, indirectI++) {
                                    activity.update();
                                    
-                                   const auto sDataPair = armUtils.resolveStub(sAddr);
+                                   const auto &sDataPair = decoded[stubI];
                                    if (!sDataPair) {
                                        SPDLOG_LOGGER_ERROR(logger, "Unknown Arm stub at {:#x}.", sAddr);
                                        continue;
@@ -125,10 +130,10 @@ void ArmFixer::scanStubs() {
                                                           "Unable to symbolize stub via indirect symbols "
                                                           "as the index overruns the entries.");
                                    } else {
-                                       const auto &[strIt, entry] =
+                                       const auto &[strId, entry] =
                                        stTracker.getSymbol(stTracker.indirectSyms.at(indirectI));
                                        uint64_t ordinal = GET_LIBRARY_ORDINAL(entry.n_desc);
-                                       symbols.insert({*strIt, ordinal, std::nullopt});
+                                       symbols.insert({std::string(stTracker.getString(strId)), ordinal, std::nullopt});
                                    }
                                    
                                    // Though its pointer if not optimized
@@ -137,10 +142,10 @@ void ArmFixer::scanStubs() {
                                            mCtx.containsAddr(pAddr)) {
                                            if (pointerCache.ptr.lazy.contains(pAddr)) {
                                                const auto &info = pointerCache.ptr.lazy.at(pAddr);
-                                               symbols.insert(info->symbols.begin(), info->symbols.end());
+                                               symbols.insert(info.symbols.begin(), info.symbols.end());
                                            } else if (pointerCache.ptr.normal.contains(pAddr)) {
                                                const auto &info = pointerCache.ptr.normal.at(pAddr);
-                                               symbols.insert(info->symbols.begin(), info->symbols.end());
+                                               symbols.insert(info.symbols.begin(), info.symbols.end());
                                            }
                                        }
                                    }
@@ -244,37 +249,19 @@ void ArmFixer::fixPass2() {
             case AStubFormat::optimizedV5: {
                 // Try to find an unused named lazy pointer
                 PtrT pAddr = 0;
-                for (const auto &sym : sSymbols.symbols) {
-                    if (pointerCache.reverse.lazy.contains(sym.name)) {
-                        for (const auto ptr : pointerCache.reverse.lazy[sym.name]) {
-                            if (!pointerCache.used.lazy.contains(ptr)) {
-                                pAddr = ptr;
-                                pointerCache.used.lazy.insert(ptr);
-                                break;
-                            }
-                        }
-                        if (pAddr) {
-                            break;
-                        }
-                    }
+                if (const auto ptr = pointerCache.findFreePointer(SPointerType::lazy, sSymbols);
+                    ptr) {
+                    pAddr = *ptr;
+                    pointerCache.used.lazy.insert(pAddr);
                 }
                 
                 // Try to find an unused named normal pointer
                 if (!pAddr) {
-                    for (const auto &sym : sSymbols.symbols) {
-                        if (pointerCache.reverse.normal.contains(sym.name)) {
-                            for (const auto ptr : pointerCache.reverse.normal[sym.name]) {
-                                if (!pointerCache.used.normal.contains(ptr)) {
-                                    pAddr = ptr;
-                                    pointerCache.used.normal.insert(ptr);
-                                    ptrTracker.add(ptr, 0);
-                                    break;
-                                }
-                            }
-                            if (pAddr) {
-                                break;
-                            }
-                        }
+                    if (const auto ptr = pointerCache.findFreePointer(SPointerType::normal, sSymbols);
+                        ptr) {
+                        pAddr = *ptr;
+                        pointerCache.used.normal.insert(pAddr);
+                        ptrTracker.add(pAddr, 0);
                     }
                 }
                 
@@ -331,17 +318,12 @@ void ArmFixer::fixCallsites() {
             }
             
             // get the branch target
-            if (inst.opStr.find(",") != std::string::npos || inst.opStr[0] != '#') {
+            if (!inst.hasImmediate) {
                 // only want direct branches with imm, no registers
                 continue;
             }
             
-            uint32_t brTarget;
-            try {
-                brTarget = std::stoi(inst.opStr.substr(1), nullptr, 16);
-            } catch (std::invalid_argument const &) {
-                continue;
-            }
+            uint32_t brTarget = (uint32_t)inst.immediate;
             
             if (mCtx.containsAddr(brTarget)) {
                 continue;
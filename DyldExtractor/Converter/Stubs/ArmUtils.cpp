@@ -1,5 +1,7 @@
 #include "ArmUtils.h"
 
+#include "ArmDecoder.h"
+
 using namespace DyldExtractor;
 using namespace Converter;
 using namespace Stubs;
@@ -7,13 +9,7 @@ using namespace Stubs;
 ArmUtils::ArmUtils(const Dyld::Context &dCtx,
                    Provider::Accelerator<P> &accelerator,
                    const Provider::PointerTracker<P> &ptrTracker)
-    : dCtx(dCtx), accelerator(accelerator), ptrTracker(ptrTracker) {
-  stubResolvers = {
-      {StubFormat::normalV4, [this](PtrT a) { return getNormalV4Target(a); }},
-      {StubFormat::optimizedV5,
-       [this](PtrT a) { return getOptimizedV5Target(a); }},
-      {StubFormat::resolver, [this](PtrT a) { return getResolverTarget(a); }}};
-}
+    : dCtx(dCtx), accelerator(accelerator), ptrTracker(ptrTracker) {}
 
 std::optional<ArmUtils::StubBinderInfo>
 ArmUtils::isStubBinder(const PtrT addr) const {
@@ -35,17 +31,7 @@ ArmUtils::isStubBinder(const PtrT addr) const {
     return std::nullopt;
   }
 
-  const auto str = p[0];
-  const auto ldr = p[1];
-  const auto add = p[2];
-  const auto str2 = p[3];
-  const auto ldr2 = p[4];
-  const auto add2 = p[5];
-  const auto ldr3 = p[6];
-  if ((str & 0x0E500000) != 0x04000000 || (ldr & 0x0F7F0000) != 0x051F0000 ||
-      (add & 0x0FE00010) != 0x00800000 || (str2 & 0x0E500000) != 0x04000000 ||
-      (ldr2 & 0x0F7F0000) != 0x051F0000 || (add2 & 0x0FE00010) != 0x00800000 ||
-      (ldr3 & 0x0E500000) != 0x04100000) {
+  if (!ArmDecoder::matches(ArmDecoder::Format::StubBinder, p)) {
     return std::nullopt;
   } else {
     const auto privPtrOffset = p[7];
@@ -66,9 +52,7 @@ ArmUtils::getStubHelperData(const PtrT addr) const {
     return std::nullopt;
   }
 
-  const auto ldr = p[0];
-  const auto b = p[1];
-  if (ldr != 0x0E59FC000 || (b & 0x0F000000) != 0x0A000000) {
+  if (!ArmDecoder::matches(ArmDecoder::Format::StubHelper, p)) {
     return std::nullopt;
   }
 
@@ -95,20 +79,15 @@ ArmUtils::getResolverData(const PtrT addr) const {
     return std::nullopt;
   }
 
-  const auto stmdb = p[0];
-  const auto blx = p[1];
-  const auto ldr = p[2];
-  const auto add = p[3];
-  const auto str = p[4];
-  const auto cpy = p[5];
-  const auto ldmia = p[6];
-  const auto bx = p[7];
-  if ((stmdb & 0x0FD00000) != 0x09000000 || (blx & 0xFE000000) != 0xFA000000 ||
-      (ldr & 0x0E500000) != 0x04100000 || (add & 0x0FE00010) != 0x00800000 ||
-      (str & 0x0E500000) != 0x04000000 || (cpy & 0x0FEF0FF0) != 0x01A00000 ||
-      (ldmia & 0x0FD00000) != 0x08900000 || (bx & 0x0FFFFFF0) != 0x012FFF10) {
+  if (!ArmDecoder::matches(ArmDecoder::Format::Resolver, p)) {
     return std::nullopt;
   }
+  return getResolverData(p, plainAddr);
+}
+
+ArmUtils::ResolverData ArmUtils::getResolverData(const uint32_t *p,
+                                                 const PtrT plainAddr) const {
+  const auto blx = p[1];
   const auto resolverData = (int32_t)p[8];
 
   // Get target function
@@ -126,8 +105,8 @@ ArmUtils::getResolverData(const PtrT addr) const {
 }
 
 ArmUtils::PtrT ArmUtils::resolveStubChain(const PtrT addr) {
-  if (accelerator.armResolvedChains.contains(addr)) {
-    return accelerator.armResolvedChains[addr];
+  if (auto cached = accelerator.armResolvedChains.get(addr); cached) {
+    return *cached;
   }
 
   PtrT target = addr;
@@ -139,36 +118,69 @@ ArmUtils::PtrT ArmUtils::resolveStubChain(const PtrT addr) {
     }
   }
 
-  accelerator.armResolvedChains[addr] = target;
+  accelerator.armResolvedChains.insert(addr, target);
 
   return target;
 }
 
 std::optional<std::pair<ArmUtils::PtrT, ArmUtils::StubFormat>>
 ArmUtils::resolveStub(const PtrT addr) const {
-  for (auto &[format, resolver] : stubResolvers) {
-    if (auto res = resolver(addr); res != std::nullopt) {
-      return std::make_pair(*res, format);
-    }
+  auto plainAddr = addr & -4;
+  const auto p = (const uint32_t *)dCtx.convertAddrP(plainAddr);
+  if (p == nullptr) {
+    return std::nullopt;
+  }
+
+  return resolveStub(p, plainAddr);
+}
+
+std::optional<std::pair<ArmUtils::PtrT, ArmUtils::StubFormat>>
+ArmUtils::resolveStub(const uint32_t *p, const PtrT plainAddr) const {
+  using ArmDecoder::Format;
+  using ArmDecoder::formatBit;
+
+  const auto formats = ArmDecoder::classify(p);
+  if (formats & formatBit(Format::NormalV4)) {
+    return std::make_pair(ptrTracker.slideP(plainAddr + 12 + p[3]),
+                          StubFormat::normalV4);
+  }
+  if (formats & formatBit(Format::OptimizedV5)) {
+    return std::make_pair(plainAddr + 12 + p[2], StubFormat::optimizedV5);
+  }
+  if (formats & formatBit(Format::Resolver)) {
+    return std::make_pair(getResolverData(p, plainAddr).targetFunc,
+                          StubFormat::resolver);
   }
 
   return std::nullopt;
 }
 
+std::vector<std::optional<std::pair<ArmUtils::PtrT, ArmUtils::StubFormat>>>
+ArmUtils::resolveStubs(const PtrT addr, const PtrT size,
+                       const uint32_t stubSize) const {
+  std::vector<std::optional<std::pair<PtrT, StubFormat>>> results;
+  if (!stubSize) {
+    return results;
+  }
+
+  const auto p = (const uint8_t *)dCtx.convertAddrP(addr);
+  results.reserve(size / stubSize);
+  for (PtrT offset = 0; offset < size; offset += stubSize) {
+    if (p == nullptr || (addr + offset) & 3) {
+      results.push_back(resolveStub(addr + offset));
+    } else {
+      results.push_back(
+          resolveStub((const uint32_t *)(p + offset), addr + offset));
+    }
+  }
+  return results;
+}
+
 std::optional<ArmUtils::PtrT>
 ArmUtils::getNormalV4LdrAddr(const PtrT addr) const {
-  // Reference getNormalV4Target
-
   auto plainAddr = addr & -4;
   const auto p = (const uint32_t *)dCtx.convertAddrP(plainAddr);
-  if (p == nullptr) {
-    return std::nullopt;
-  }
-
-  const auto ldr = p[0];
-  const auto add = p[1];
-  const auto ldr2 = p[2];
-  if (ldr != 0xE59FC004 || add != 0xE08FC00C || ldr2 != 0xE59CF000) {
+  if (p == nullptr || !ArmDecoder::matches(ArmDecoder::Format::NormalV4, p)) {
     return std::nullopt;
   }
 
@@ -191,65 +203,3 @@ void ArmUtils::writeNormalV4Stub(uint8_t *loc, const PtrT stubAddr,
   p[2] = 0xE59CF000;
   *(int32_t *)(p + 3) = (int32_t)ldrAddr - stubAddr - 12;
 }
-
-std::optional<ArmUtils::PtrT>
-ArmUtils::getNormalV4Target(const PtrT addr) const {
-  /**
-   * 04 c0 9f e5 ldr r12,[DAT_00007f18]
-   * 0c c0 8f e0 add r12,pc,r12
-   * 00 f0 9c e5 ldr pc=>__stub_helper::_NSLog,[r12,#0x0]
-   * f0 00 00 00 UNK 000000F0h
-   */
-
-  auto plainAddr = addr & -4;
-  const auto p = (const uint32_t *)dCtx.convertAddrP(plainAddr);
-  if (p == nullptr) {
-    return std::nullopt;
-  }
-
-  const auto ldr = p[0];
-  const auto add = p[1];
-  const auto ldr2 = p[2];
-  if (ldr != 0xE59FC004 || add != 0xE08FC00C || ldr2 != 0xE59CF000) {
-    return std::nullopt;
-  }
-
-  const auto stubData = p[3];
-  return ptrTracker.slideP(plainAddr + 12 + stubData);
-}
-
-std::optional<ArmUtils::PtrT>
-ArmUtils::getOptimizedV5Target(const PtrT addr) const {
-  /**
-   * 576a3a28 00 c0 9f e5 ldr r12,[DAT_576a3a30]
-   * 576a3a2c 0c f0 8f e0 add pc=>LAB_4692f7c4,pc,r12
-   * 576a3a30 91 bd 28 ef UNK EF28BD91h
-   * 576a3a34 fe de ff e7 udf #0xfdee TRAP
-   */
-
-  auto plainAddr = addr & -4;
-  const auto p = (const uint32_t *)dCtx.convertAddrP(plainAddr);
-  if (p == nullptr) {
-    return std::nullopt;
-  }
-
-  const auto ldr = p[0];
-  const auto add = p[1];
-  const auto trap = p[3];
-  if (ldr != 0xE59FC000 || add != 0xE08FF00C || trap != 0xE7FFDEFE) {
-    return std::nullopt;
-  }
-
-  const auto stubData = p[2];
-
-  return (plainAddr + 12 + stubData);
-}
-
-std::optional<ArmUtils::PtrT>
-ArmUtils::getResolverTarget(const PtrT addr) const {
-  if (const auto res = getResolverData(addr); res) {
-    return res->targetFunc;
-  } else {
-    return std::nullopt;
-  }
-}
\ No newline at end of file
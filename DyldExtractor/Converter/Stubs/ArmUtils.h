@@ -72,6 +72,14 @@ public:
   /// @returns An optional pair of the stub's target and its format.
   std::optional<std::pair<PtrT, StubFormat>> resolveStub(const PtrT addr) const;
 
+  /// @brief Get the targets and formats of all stubs in a section.
+  /// @param addr The address of the first stub
+  /// @param size The size of the stubs
+  /// @param stubSize The size of each stub
+  /// @returns An optional pair of the target and format for each stub.
+  std::vector<std::optional<std::pair<PtrT, StubFormat>>>
+  resolveStubs(const PtrT addr, const PtrT size, const uint32_t stubSize) const;
+
   /// @brief Get the ldr address of a normal V4 stub
   /// @param addr The address of the stub
   /// @returns The target address or nullopt
@@ -85,16 +93,13 @@ public:
                          const PtrT ldrAddr) const;
 
 private:
-  std::optional<PtrT> getNormalV4Target(const PtrT addr) const;
-  std::optional<PtrT> getOptimizedV5Target(const PtrT addr) const;
-  std::optional<PtrT> getResolverTarget(const PtrT addr) const;
+  std::optional<std::pair<PtrT, StubFormat>>
+  resolveStub(const uint32_t *p, const PtrT plainAddr) const;
+  ResolverData getResolverData(const uint32_t *p, const PtrT plainAddr) const;
 
   const Dyld::Context &dCtx;
   Provider::Accelerator<P> &accelerator;
   const Provider::PointerTracker<P> &ptrTracker;
-
-  using ResolverT = typename std::function<std::optional<PtrT>(PtrT)>;
-  std::map<StubFormat, ResolverT> stubResolvers;
 };
 
 } // namespace DyldExtractor::Converter::Stubs
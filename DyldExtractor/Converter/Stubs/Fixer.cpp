@@ -29,19 +29,28 @@ ptrCache(*eCtx.mCtx, *eCtx.activity, eCtx.logger, eCtx.ptrTracker,
 
 template <class A> void Fixer<A>::fix() {
     // fill out code regions
-    if (accelerator.codeRegions.empty()) {
+    std::call_once(accelerator.codeRegionsOnce, [this]() {
+        std::vector<std::pair<PtrT, PtrT>> regions;
         for (auto imageInfo : dCtx.images) {
             auto ctx = dCtx.createMachoCtx<true, P>(imageInfo);
             ctx.enumerateSections(
                                   [](auto seg, auto sect) {
                                       return sect->flags & S_ATTR_SOME_INSTRUCTIONS;
                                   },
-                                  [this](auto seg, auto sect) {
-                                      accelerator.codeRegions.insert(typename Provider::Accelerator<P>::CodeRegion(
-                                                                                                          sect->addr, sect->addr + sect->size));
+                                  [&regions](auto seg, auto sect) {
+                                      regions.emplace_back(sect->addr, sect->addr + sect->size);
                                       return true;
                                   });
         }
+        accelerator.codeRegions.build(std::move(regions));
+    });
+    
+    if constexpr (std::is_same_v<A, Utils::Arch::arm64> ||
+                  std::is_same_v<A, Utils::Arch::arm64_32>) {
+        std::call_once(accelerator.arm64StubIslandsOnce, [this]() {
+            activity.update(std::nullopt, "Scanning Stub Islands");
+            arm64Utils->scanStubIslands(findStubIslands(), eCtx.threads);
+        });
     }
     
     checkIndirectEntries();
@@ -184,7 +193,7 @@ template <class A> void Fixer<A>::fixIndirectEntries() {
                     const auto &preferredSym = pInfo->preferredSymbol();
                     
                     // Create new string and entry
-                    auto &str = stTracker.addString(preferredSym.name);
+                    auto str = stTracker.addString(preferredSym.name);
                     /// TODO: Check if symbol types are correct
                     Macho::Loader::nlist<P> sym{};
                     sym.n_type = 1;
@@ -225,7 +234,7 @@ template <class A> void Fixer<A>::fixIndirectEntries() {
                     const auto &preferredSym = sInfo->preferredSymbol();
                     
                     // Create new string and entry
-                    auto &str = stTracker.addString(preferredSym.name);
+                    auto str = stTracker.addString(preferredSym.name);
                     /// TODO: Check if symbol types are correct
                     Macho::Loader::nlist<P> sym{};
                     sym.n_type = 1;
@@ -256,29 +265,82 @@ template <class A> void Fixer<A>::fixIndirectEntries() {
 
 /// @brief Bind non lazy symbol pointers
 template <class A> void Fixer<A>::bindPointers() {
+    // The pointer cache doesn't outlive the fixer, copy infos to the store
     for (auto &[pAddr, info] : ptrCache.ptr.normal) {
         ptrTracker.add(pAddr, 0);
-        ptrTracker.addBind(pAddr, info);
+        ptrTracker.addBind(pAddr, eCtx.symbolStore.add(info));
     }
     for (auto &[pAddr, info] : ptrCache.ptr.auth) {
         ptrTracker.add(pAddr, 0);
-        ptrTracker.addBind(pAddr, info);
+        ptrTracker.addBind(pAddr, eCtx.symbolStore.add(info));
     }
 }
 
 template <class A> bool Fixer<A>::isInCodeRegions(PtrT addr) {
-    if (accelerator.codeRegions.empty()) {
-        return false;
+    return accelerator.codeRegions.contains(addr);
+}
+
+/// @brief Find code that is not in any image.
+///
+/// Stub islands, and branch pools in older caches, are in executable mappings
+/// between images.
+/// @returns Sorted address ranges.
+template <class A>
+std::vector<std::pair<typename Fixer<A>::PtrT, typename Fixer<A>::PtrT>>
+Fixer<A>::findStubIslands() const {
+    std::vector<std::pair<uint64_t, uint64_t>> imageRanges;
+    for (auto imageInfo : dCtx.images) {
+        const auto path = (const char *)(dCtx.file + imageInfo->pathFileOffset);
+        if (strstr(path, "dyld_shared_cache_branch_islands") != nullptr) {
+            continue;
+        }
+        
+        auto ctx = dCtx.createMachoCtx<true, P>(imageInfo);
+        for (const auto &seg : ctx.segments) {
+            imageRanges.emplace_back(seg.command->vmaddr,
+                                     seg.command->vmaddr + seg.command->vmsize);
+        }
     }
+    std::sort(imageRanges.begin(), imageRanges.end());
     
-    auto upper = accelerator.codeRegions.upper_bound(
-                                                     typename Provider::Accelerator<P>::CodeRegion(addr, addr));
-    if (upper == accelerator.codeRegions.begin()) {
-        return false;
+    std::vector<std::pair<uint64_t, uint64_t>> codeMappings;
+    auto addMappings = [&codeMappings](const Dyld::Context &cache) {
+        const auto mappings =
+        (const dyld_cache_mapping_info *)(cache.file + cache.header->mappingOffset);
+        for (uint32_t i = 0; i < cache.header->mappingCount; i++) {
+            if (mappings[i].initProt & 0x4) { // VM_PROT_EXECUTE
+                codeMappings.emplace_back(mappings[i].address,
+                                          mappings[i].address + mappings[i].size);
+            }
+        }
+    };
+    addMappings(dCtx);
+    for (const auto &subcache : dCtx.subcaches) {
+        addMappings(subcache);
     }
+    std::sort(codeMappings.begin(), codeMappings.end());
     
-    const auto &potentialRange = *--upper;
-    return addr >= potentialRange.start && addr < potentialRange.end;
+    // Subtract images from the code mappings
+    std::vector<std::pair<PtrT, PtrT>> islands;
+    auto imageIt = imageRanges.begin();
+    for (const auto &[mapStart, mapEnd] : codeMappings) {
+        uint64_t cursor = mapStart;
+        while (imageIt != imageRanges.end() && imageIt->second <= cursor) {
+            imageIt++;
+        }
+        for (auto it = imageIt; it != imageRanges.end() && it->first < mapEnd;
+             it++) {
+            if (it->first > cursor) {
+                islands.emplace_back((PtrT)cursor, (PtrT)it->first);
+            }
+            cursor = std::max(cursor, it->second);
+        }
+        if (cursor < mapEnd) {
+            islands.emplace_back((PtrT)cursor, (PtrT)mapEnd);
+        }
+    }
+    
+    return islands;
 }
 
 template class DyldExtractor::Converter::Stubs::Fixer<Utils::Arch::arm>;
@@ -291,7 +353,11 @@ template <class A> void Converter::fixStubs(Utils::ExtractionContext<A> &eCtx) {
                   std::is_same_v<A, Utils::Arch::arm64_32>) {
         // Load providers
         eCtx.bindInfo.load();
-        eCtx.disasm.load();
+        if constexpr (std::is_same_v<A, Utils::Arch::arm>) {
+            // Arm64 decodes callsites directly, and only loads the
+            // disassembler when needed.
+            eCtx.disasm.load(eCtx.threads);
+        }
         
         eCtx.activity->update("Stub Fixer", "Starting Up");
         if (!eCtx.symbolizer || !eCtx.leTracker || !eCtx.stTracker) {
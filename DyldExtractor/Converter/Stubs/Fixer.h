@@ -27,6 +27,7 @@ public:
   void bindPointers();
 
   bool isInCodeRegions(PtrT addr);
+  std::vector<std::pair<PtrT, PtrT>> findStubIslands() const;
 
   Utils::ExtractionContext<A> &eCtx;
   const Dyld::Context &dCtx;
@@ -45,6 +45,37 @@ SymbolPointerCache<A>::getPointerType(const auto sect) const {
 template <class A> void SymbolPointerCache<A>::scanPointers() {
   activity.update(std::nullopt, "Scanning Symbol Pointers");
 
+  // Size the tables from the sections
+  std::size_t normalCount = 0, lazyCount = 0, authCount = 0;
+  mCtx.enumerateSections(
+      [](auto seg, auto sect) {
+        return (sect->flags & SECTION_TYPE) == S_NON_LAZY_SYMBOL_POINTERS ||
+               (sect->flags & SECTION_TYPE) == S_LAZY_SYMBOL_POINTERS;
+      },
+      [&, this](auto seg, auto sect) {
+        const std::size_t count = sect->size / sizeof(PtrT);
+        switch (getPointerType(sect)) {
+        case PointerType::normal:
+          normalCount += count;
+          break;
+        case PointerType::lazy:
+          lazyCount += count;
+          break;
+        case PointerType::auth:
+          authCount += count;
+          break;
+        default:
+          Utils::unreachable();
+        }
+        return true;
+      });
+  ptr.normal.reserve(normalCount);
+  ptr.lazy.reserve(lazyCount);
+  ptr.auth.reserve(authCount);
+  used.normal.reserve(normalCount);
+  used.lazy.reserve(lazyCount);
+  used.auth.reserve(authCount);
+
   mCtx.enumerateSections(
       [](auto seg, auto sect) {
         return (sect->flags & SECTION_TYPE) == S_NON_LAZY_SYMBOL_POINTERS ||
@@ -66,10 +97,11 @@ template <class A> void SymbolPointerCache<A>::scanPointers() {
                                "Unable to symbolize stub via indirect symbols "
                                "as the index overruns the entries.");
           } else {
-            const auto &[strIt, entry] =
+            const auto &[strId, entry] =
                 stTracker.getSymbol(stTracker.indirectSyms.at(indirectI));
             uint64_t ordinal = GET_LIBRARY_ORDINAL(entry.n_desc);
-            symbols.insert({*strIt, ordinal, std::nullopt});
+            symbols.insert({std::string(stTracker.getString(strId)), ordinal,
+                            std::nullopt});
           }
 
           // The pointer's target function
@@ -162,29 +194,61 @@ const Provider::SymbolicInfo *
 SymbolPointerCache<A>::getPointerInfo(PointerType pType, PtrT addr) const {
   switch (pType) {
   case PointerType::normal:
-    if (ptr.normal.contains(addr)) {
-      return ptr.normal.at(addr).get();
-    } else {
-      return nullptr;
-    }
+    return ptr.normal.find(addr);
+  case PointerType::lazy:
+    return ptr.lazy.find(addr);
+  case PointerType::auth:
+    return ptr.auth.find(addr);
+
+  default:
+    Utils::unreachable();
+  }
+}
+
+template <class A>
+std::optional<typename SymbolPointerCache<A>::PtrT>
+SymbolPointerCache<A>::findFreePointer(PointerType pType,
+                                       const Provider::SymbolicInfo &info) {
+  ReverseMapT *reversePtrs;
+  const UsedSetT *usedPtrs;
+  switch (pType) {
+  case PointerType::normal:
+    reversePtrs = &reverse.normal;
+    usedPtrs = &used.normal;
+    break;
 
   case PointerType::lazy:
-    if (ptr.lazy.contains(addr)) {
-      return ptr.lazy.at(addr).get();
-    } else {
-      return nullptr;
-    }
+    reversePtrs = &reverse.lazy;
+    usedPtrs = &used.lazy;
+    break;
 
   case PointerType::auth:
-    if (ptr.auth.contains(addr)) {
-      return ptr.auth.at(addr).get();
-    } else {
-      return nullptr;
-    }
+    reversePtrs = &reverse.auth;
+    usedPtrs = &used.auth;
+    break;
 
   default:
     Utils::unreachable();
   }
+
+  for (const auto &sym : info.symbols) {
+    auto it = reversePtrs->find(sym.name);
+    if (it == reversePtrs->end()) {
+      continue;
+    }
+
+    // Used pointers are never freed, so skip them for later searches
+    auto &entry = it->second;
+    while (entry.freeI < entry.pointers.size() &&
+           usedPtrs->contains(entry.pointers[entry.freeI])) {
+      entry.freeI++;
+    }
+    if (entry.freeI < entry.pointers.size()) {
+      return entry.pointers[entry.freeI];
+    }
+  }
+
+  return std::nullopt;
 }
 
 template <class A>
@@ -213,19 +277,23 @@ void SymbolPointerCache<A>::addPointerInfo(PointerType pType, PtrT pAddr,
   }
 
   // Add to normal cache
-  Provider::SymbolicInfo *newInfo;
-  if (pointers->contains(pAddr)) {
-    newInfo = pointers->at(pAddr).get();
+  auto [newInfo, inserted] = pointers->try_emplace(pAddr, info);
+  if (!inserted) {
     newInfo->symbols.insert(info.symbols.begin(), info.symbols.end());
-  } else {
-    newInfo =
-        pointers->emplace(pAddr, std::make_shared<Provider::SymbolicInfo>(info))
-            .first->second.get();
   }
 
-  // add to reverse cache
+  // add to reverse cache, keeping the pointers sorted
   for (auto &sym : newInfo->symbols) {
-    (*reversePtrs)[sym.name].insert(pAddr);
+    auto &entry = (*reversePtrs)[sym.name];
+    auto &ptrs = entry.pointers;
+    auto it = std::lower_bound(ptrs.begin(), ptrs.end(), pAddr);
+    if (it != ptrs.end() && *it == pAddr) {
+      continue;
+    }
+
+    const auto pos = (std::size_t)(it - ptrs.begin());
+    ptrs.insert(it, pAddr);
+    entry.freeI = std::min(entry.freeI, pos);
   }
 }
 
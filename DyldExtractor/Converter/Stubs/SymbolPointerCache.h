@@ -5,6 +5,9 @@
 #include "ArmUtils.h"
 #include <Provider/SymbolTableTracker.h>
 #include <Provider/Symbolizer.h>
+#include <Utils/AddressHashMap.h>
+#include <string_view>
+#include <unordered_map>
 
 namespace DyldExtractor::Converter::Stubs {
 
@@ -37,36 +40,51 @@ public:
                    const Provider::SymbolicInfo &info);
   const Provider::SymbolicInfo *getPointerInfo(PointerType pType,
                                                PtrT addr) const;
+  /// @brief Find a named pointer that is not used
+  ///
+  /// Symbols are tried in order, and the lowest pointer with the symbol is
+  /// returned. The pointer is not marked as used.
+  /// @param pType The type of pointer
+  /// @param info The symbols to look for
+  /// @returns The address of the pointer, or nullopt.
+  std::optional<PtrT> findFreePointer(PointerType pType,
+                                      const Provider::SymbolicInfo &info);
 
   /// TODO: Add weak type
-  using PtrMapT = std::map<PtrT, std::shared_ptr<Provider::SymbolicInfo>>;
+  using PtrMapT = Utils::AddressHashMap<PtrT, Provider::SymbolicInfo>;
   struct {
     PtrMapT normal;
     PtrMapT lazy;
     PtrMapT auth;
   } ptr;
 
-  using ReverseMapT = std::map<std::reference_wrapper<const std::string>,
-                               std::set<PtrT>, std::less<const std::string>>;
-  struct {
-    ReverseMapT normal;
-    ReverseMapT lazy;
-    ReverseMapT auth;
-  } reverse;
-
   struct {
     std::set<PtrT> normal;
     std::set<PtrT> lazy;
     std::set<PtrT> auth;
   } unnamed;
 
+  using UsedSetT = Utils::AddressHashSet<PtrT>;
   struct {
-    std::set<PtrT> normal;
-    std::set<PtrT> lazy;
-    std::set<PtrT> auth;
+    UsedSetT normal;
+    UsedSetT lazy;
+    UsedSetT auth;
   } used;
 
 private:
+  /// Pointers with a symbol, sorted. Pointers before freeI are all used.
+  struct ReverseEntry {
+    std::vector<PtrT> pointers;
+    std::size_t freeI = 0;
+  };
+  /// Keys are names in the pointer infos.
+  using ReverseMapT = std::unordered_map<std::string_view, ReverseEntry>;
+  struct {
+    ReverseMapT normal;
+    ReverseMapT lazy;
+    ReverseMapT auth;
+  } reverse;
+
   void addPointerInfo(PointerType pType, PtrT pAddr,
                       const Provider::SymbolicInfo &info);
 
@@ -0,0 +1,136 @@
+#include "CacheOverlay.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+using namespace DyldExtractor;
+using namespace Dyld;
+
+CacheOverlay::OverlayFile::OverlayFile(const Context *cache)
+    : cache(cache),
+      fileMapping(cache->cachePath.string().c_str(), bi::read_only),
+      region(fileMapping, bi::copy_on_write) {
+  for (auto mapping : cache->mappings) {
+    mappings.emplace_back(mapping);
+  }
+}
+
+CacheOverlay::CacheOverlay(const Context &dCtx) : dCtx(dCtx) {
+  files.reserve(dCtx.subcaches.size() + 1);
+  files.emplace_back(&dCtx);
+  for (auto &cache : dCtx.subcaches) {
+    files.emplace_back(&cache);
+  }
+}
+
+template <class P>
+Macho::Context<false, P>
+CacheOverlay::createMachoCtx(const dyld_cache_image_info *imageInfo) {
+  auto [imageOffset, mainCache] = dCtx.convertAddr(imageInfo->address);
+  if (!mainCache) {
+    throw std::invalid_argument("Image is not contained in the cache.");
+  }
+
+  uint8_t *mainFile = nullptr;
+  std::vector<Macho::MappingInfo> mainMappings;
+  std::vector<std::tuple<uint8_t *, std::vector<Macho::MappingInfo>>> subFiles;
+  subFiles.reserve(files.size());
+  for (auto &file : files) {
+    if (file.cache == mainCache) {
+      mainFile = (uint8_t *)file.region.get_address();
+      mainMappings = file.mappings;
+    } else {
+      subFiles.emplace_back((uint8_t *)file.region.get_address(),
+                            file.mappings);
+    }
+  }
+
+  Macho::Context<false, P> mCtx(imageOffset, mainFile, mainMappings, subFiles);
+
+  // Record the original extent of the image, segments can change size
+  for (auto &seg : mCtx.segments) {
+    addDirtyRange(seg.command->vmaddr, seg.command->vmsize);
+  }
+
+  return mCtx;
+}
+
+template Macho::Context<false, Utils::Arch::Pointer32>
+CacheOverlay::createMachoCtx<Utils::Arch::Pointer32>(
+    const dyld_cache_image_info *imageInfo);
+template Macho::Context<false, Utils::Arch::Pointer64>
+CacheOverlay::createMachoCtx<Utils::Arch::Pointer64>(
+    const dyld_cache_image_info *imageInfo);
+
+void CacheOverlay::reset() {
+  const uint64_t pageSize = bi::mapped_region::get_page_size();
+
+  // Page align and merge ranges
+  for (auto &range : dirtyRanges) {
+    const uint64_t fileSize = files[range.fileIndex].region.get_size();
+    const uint64_t start = range.offset & ~(pageSize - 1);
+    const uint64_t end = std::min(
+        (range.offset + range.size + pageSize - 1) & ~(pageSize - 1), fileSize);
+    range.offset = start;
+    range.size = end - start;
+  }
+  std::sort(dirtyRanges.begin(), dirtyRanges.end());
+
+  std::vector<DirtyRange> merged;
+  for (const auto &range : dirtyRanges) {
+    if (!merged.empty() && merged.back().fileIndex == range.fileIndex &&
+        merged.back().offset + merged.back().size >= range.offset) {
+      auto &last = merged.back();
+      last.size = std::max(last.offset + last.size, range.offset + range.size) -
+                  last.offset;
+    } else {
+      merged.push_back(range);
+    }
+  }
+
+  for (const auto &range : merged) {
+    auto &file = files[range.fileIndex];
+    auto loc = (uint8_t *)file.region.get_address() + range.offset;
+
+#ifndef _WIN32
+    // Replace the private pages with fresh pages from the file
+    if (mmap(loc, range.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+             file.fileMapping.get_mapping_handle().handle,
+             (off_t)range.offset) == MAP_FAILED) {
+      throw std::runtime_error("Unable to reset cache overlay pages.");
+    }
+#else
+    memcpy(loc, file.cache->file + range.offset, range.size);
+#endif
+  }
+
+  dirtyRanges.clear();
+}
+
+void CacheOverlay::releasePages() {
+  reset();
+  for (auto &file : files) {
+    Macho::adviseMemory(file.region.get_address(), file.region.get_size(),
+                        Macho::Advice::DontNeed);
+  }
+}
+
+void CacheOverlay::addDirtyRange(uint64_t addr, uint64_t size) {
+  // A range can span mappings, so record the part in each one
+  const uint64_t end = addr + size;
+  for (std::size_t i = 0; i < files.size(); i++) {
+    for (const auto &mapping : files[i].mappings) {
+      const uint64_t start = std::max(addr, mapping.address);
+      const uint64_t stop = std::min(end, mapping.address + mapping.size);
+      if (start < stop) {
+        dirtyRanges.push_back(
+            {i, (start - mapping.address) + mapping.fileOffset, stop - start});
+      }
+    }
+  }
+}
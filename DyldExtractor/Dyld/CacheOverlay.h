@@ -0,0 +1,72 @@
+#ifndef __DYLD_CACHEOVERLAY__
+#define __DYLD_CACHEOVERLAY__
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "DyldContext.h"
+
+namespace DyldExtractor::Dyld {
+
+namespace bi = boost::interprocess;
+
+/// @brief A writable view of a cache and its subcaches that is shared between
+///   images.
+///
+/// Every cache file is mapped once with copy on write access, so creating a
+/// writable macho context does not need to remap any files. The pages that an
+/// image's segments occupy are recorded, and reset discards any writes to them
+/// so that the next image sees the original data. Only one image should be
+/// processed at a time, as images share pages like the linkedit.
+class CacheOverlay {
+public:
+  CacheOverlay(const Context &dCtx);
+  CacheOverlay(const CacheOverlay &other) = delete;
+  CacheOverlay &operator=(const CacheOverlay &other) = delete;
+
+  /// @brief Create a writable macho context backed by the overlay.
+  ///
+  /// The context does not own any files and is invalidated by the
+  /// destruction of the overlay.
+  ///
+  /// @param imageInfo The image info of the MachO file.
+  template <class P>
+  Macho::Context<false, P>
+  createMachoCtx(const dyld_cache_image_info *imageInfo);
+
+  /// @brief Discard all writes made to images created since the last reset.
+  void reset();
+
+  /// @brief Reset the overlay and drop its resident pages.
+  ///
+  /// The pages are read from the files again when they are next accessed.
+  void releasePages();
+
+private:
+  struct OverlayFile {
+    const Context *cache;
+    bi::file_mapping fileMapping;
+    bi::mapped_region region;
+    std::vector<Macho::MappingInfo> mappings;
+
+    OverlayFile(const Context *cache);
+  };
+
+  struct DirtyRange {
+    std::size_t fileIndex;
+    uint64_t offset;
+    uint64_t size;
+
+    auto operator<=>(const DirtyRange &rhs) const = default;
+  };
+
+  const Context &dCtx;
+  std::vector<OverlayFile> files;
+  std::vector<DirtyRange> dirtyRanges;
+
+  void addDirtyRange(uint64_t addr, uint64_t size);
+};
+
+} // namespace DyldExtractor::Dyld
+
+#endif // __DYLD_CACHEOVERLAY__
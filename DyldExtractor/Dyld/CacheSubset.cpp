@@ -0,0 +1,383 @@
+#include "CacheSubset.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fmt/format.h>
+#include <fstream>
+#include <set>
+#include <stdexcept>
+
+using namespace DyldExtractor;
+using namespace Dyld;
+
+// Captured data is rounded to pages, so slide info chains stay complete.
+static constexpr uint64_t PAGE_SIZE = 0x4000;
+
+/// Round ranges out to pages, then sort and merge them.
+static void mergeRanges(std::vector<std::pair<uint64_t, uint64_t>> &ranges) {
+  for (auto &[start, end] : ranges) {
+    start &= ~(PAGE_SIZE - 1);
+    end = (end + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+  }
+  std::sort(ranges.begin(), ranges.end());
+
+  std::vector<std::pair<uint64_t, uint64_t>> merged;
+  for (const auto &range : ranges) {
+    if (!merged.empty() && range.first <= merged.back().second) {
+      merged.back().second = std::max(merged.back().second, range.second);
+    } else {
+      merged.push_back(range);
+    }
+  }
+  ranges = std::move(merged);
+}
+
+template <class P>
+CacheSubset CacheSubset::build(const Context &dCtx,
+                               const std::vector<uint32_t> &imageIndices) {
+  using HeaderT = Macho::Loader::mach_header<P>;
+  using SegmentCommandT = Macho::Loader::segment_command<P>;
+  using NlistT = Macho::Loader::nlist<P>;
+
+  CacheSubset subset(dCtx);
+  subset.imageIndices = imageIndices;
+
+  // Start and end offsets in each file, and addresses in any file
+  std::vector<std::vector<std::pair<uint64_t, uint64_t>>> fileRanges(
+      dCtx.subcaches.size() + 1);
+  std::vector<std::pair<uint64_t, uint64_t>> addrRanges;
+  auto addAddr = [&](uint64_t addr, uint64_t size) {
+    if (size) {
+      addrRanges.emplace_back(addr, addr + size);
+    }
+  };
+  auto getCacheIndex = [&](const Context *cache) {
+    return cache == &dCtx ? 0 : (std::size_t)(cache - dCtx.subcaches.data()) + 1;
+  };
+  auto addFile = [&](const Context *cache, uint64_t offset, uint64_t size) {
+    if (size) {
+      fileRanges[getCacheIndex(cache)].emplace_back(offset, offset + size);
+    }
+  };
+
+  // The data of each image
+  for (const auto imageIndex : imageIndices) {
+    const auto imageInfo = dCtx.images.at(imageIndex);
+    const auto imagePath = (const char *)(dCtx.file + imageInfo->pathFileOffset);
+    auto header = (const HeaderT *)dCtx.convertAddrP(imageInfo->address);
+    if (!header || header->magic != HeaderT::MAGIC) {
+      throw std::invalid_argument(
+          fmt::format("Unable to read the header of {}.", imagePath));
+    }
+    addFile(&dCtx, imageInfo->pathFileOffset, strlen(imagePath) + 1);
+
+    std::vector<const Macho::Loader::load_command *> loadCommands;
+    const SegmentCommandT *leSeg = nullptr;
+    auto cmd = (const uint8_t *)header + sizeof(HeaderT);
+    const auto cmdsEnd = cmd + header->sizeofcmds;
+    for (uint32_t c = 0; c < header->ncmds && cmd < cmdsEnd; c++) {
+      auto lc = (const Macho::Loader::load_command *)cmd;
+      if (lc->cmd == SegmentCommandT::CMDS[0]) {
+        auto seg = (const SegmentCommandT *)cmd;
+        if (strncmp(seg->segname, SEG_LINKEDIT, 16) == 0) {
+          leSeg = seg;
+        } else {
+          addAddr(seg->vmaddr, seg->vmsize);
+        }
+      }
+      loadCommands.push_back(lc);
+      if (!lc->cmdsize) {
+        break;
+      }
+      cmd += lc->cmdsize;
+    }
+    if (!leSeg) {
+      continue;
+    }
+
+    // Only the parts of the shared linkedit that the image uses
+    auto leAddr = [leSeg](uint64_t offset) {
+      return leSeg->vmaddr + (offset - leSeg->fileoff);
+    };
+    auto addLinkedit = [&](uint64_t offset, uint64_t size) {
+      if (size) {
+        addAddr(leAddr(offset), size);
+      }
+    };
+    for (auto lc : loadCommands) {
+      switch (lc->cmd) {
+      case LC_SYMTAB: {
+        auto symtab = (const Macho::Loader::symtab_command *)lc;
+        addLinkedit(symtab->symoff, symtab->nsyms * sizeof(NlistT));
+        auto nlists = (const NlistT *)dCtx.convertAddrP(leAddr(symtab->symoff));
+        auto strings = (const char *)dCtx.convertAddrP(leAddr(symtab->stroff));
+        if (!nlists || !strings) {
+          break;
+        }
+        for (uint32_t i = 0; i < symtab->nsyms; i++) {
+          const auto strx = nlists[i].n_un.n_strx;
+          if (strx < symtab->strsize) {
+            addLinkedit(symtab->stroff + strx,
+                        strnlen(strings + strx, symtab->strsize - strx) + 1);
+          }
+        }
+        break;
+      }
+      case LC_DYSYMTAB: {
+        auto dysymtab = (const Macho::Loader::dysymtab_command *)lc;
+        addLinkedit(dysymtab->indirectsymoff,
+                    dysymtab->nindirectsyms * sizeof(uint32_t));
+        addLinkedit(dysymtab->extreloff, dysymtab->nextrel * 8);
+        addLinkedit(dysymtab->locreloff, dysymtab->nlocrel * 8);
+        break;
+      }
+      case LC_DYLD_INFO:
+      case LC_DYLD_INFO_ONLY: {
+        auto dyldInfo = (const Macho::Loader::dyld_info_command *)lc;
+        addLinkedit(dyldInfo->rebase_off, dyldInfo->rebase_size);
+        addLinkedit(dyldInfo->bind_off, dyldInfo->bind_size);
+        addLinkedit(dyldInfo->weak_bind_off, dyldInfo->weak_bind_size);
+        addLinkedit(dyldInfo->lazy_bind_off, dyldInfo->lazy_bind_size);
+        addLinkedit(dyldInfo->export_off, dyldInfo->export_size);
+        break;
+      }
+      case LC_DYLD_EXPORTS_TRIE: // linkedit_data_command
+      case LC_FUNCTION_STARTS:
+      case LC_DATA_IN_CODE:
+      case LC_SEGMENT_SPLIT_INFO:
+      case LC_DYLIB_CODE_SIGN_DRS:
+      case LC_LINKER_OPTIMIZATION_HINT:
+      case LC_DYLD_CHAINED_FIXUPS: {
+        auto data = (const Macho::Loader::linkedit_data_command *)lc;
+        addLinkedit(data->dataoff, data->datasize);
+        break;
+      }
+      default:
+        break;
+      }
+    }
+  }
+
+  // Optimization headers and stub islands, which are not in any image
+  const auto cacheBase = dCtx.mappings.at(0)->address;
+  if (dCtx.headerContainsMember(offsetof(dyld_cache_header, objcOptsSize))) {
+    addAddr(cacheBase + dCtx.header->objcOptsOffset, dCtx.header->objcOptsSize);
+  }
+  if (dCtx.headerContainsMember(offsetof(dyld_cache_header, swiftOptsSize))) {
+    addAddr(cacheBase + dCtx.header->swiftOptsOffset,
+            dCtx.header->swiftOptsSize);
+  }
+
+  std::vector<const Context *> caches = {&dCtx};
+  for (auto &cache : dCtx.subcaches) {
+    caches.push_back(&cache);
+  }
+  auto getSlideMappings = [](const Context *cache) {
+    std::pair<const dyld_cache_mapping_and_slide_info *, uint32_t> result{};
+    if (cache->headerContainsMember(
+            offsetof(dyld_cache_header, mappingWithSlideCount))) {
+      result = {(const dyld_cache_mapping_and_slide_info
+                     *)(cache->file + cache->header->mappingWithSlideOffset),
+                cache->header->mappingWithSlideCount};
+    }
+    return result;
+  };
+  for (auto cache : caches) {
+    auto [slideMappings, count] = getSlideMappings(cache);
+    for (uint32_t i = 0; i < count; i++) {
+      if (slideMappings[i].flags & DYLD_CACHE_MAPPING_TEXT_STUBS) {
+        addAddr(slideMappings[i].address, slideMappings[i].size);
+      }
+    }
+  }
+  mergeRanges(addrRanges);
+
+  // Convert addresses to file offsets, and add the slide info of mappings
+  // with captured pages.
+  for (auto cache : caches) {
+    auto [slideMappings, slideCount] = getSlideMappings(cache);
+    for (uint32_t i = 0; i < cache->mappings.size(); i++) {
+      const auto mapping = cache->mappings[i];
+      const auto mappingEnd = mapping->address + mapping->size;
+
+      bool captured = false;
+      auto it = std::lower_bound(
+          addrRanges.begin(), addrRanges.end(), mapping->address,
+          [](const auto &range, uint64_t addr) { return range.second <= addr; });
+      for (; it != addrRanges.end() && it->first < mappingEnd; it++) {
+        const auto start = std::max(it->first, mapping->address);
+        const auto end = std::min(it->second, mappingEnd);
+        addFile(cache, mapping->fileOffset + (start - mapping->address),
+                end - start);
+        captured = true;
+      }
+
+      if (captured && i < slideCount && slideMappings[i].slideInfoFileOffset) {
+        addFile(cache, slideMappings[i].slideInfoFileOffset,
+                slideMappings[i].slideInfoFileSize);
+      }
+    }
+
+    // Header structures
+    const auto cacheHeader = cache->header;
+    addFile(cache, 0, cacheHeader->mappingOffset);
+    addFile(cache, cacheHeader->mappingOffset,
+            cacheHeader->mappingCount * sizeof(dyld_cache_mapping_info));
+    addFile(cache, cacheHeader->mappingWithSlideOffset,
+            slideCount * sizeof(dyld_cache_mapping_and_slide_info));
+    if (cache->headerContainsMember(
+            offsetof(dyld_cache_header, subCacheArrayCount))) {
+      const auto entrySize =
+          cache->headerContainsMember(offsetof(dyld_cache_header, cacheSubType))
+              ? sizeof(dyld_subcache_entry)
+              : sizeof(dyld_subcache_entry_v1);
+      addFile(cache, cacheHeader->subCacheArrayOffset,
+              cacheHeader->subCacheArrayCount * entrySize);
+    }
+    if (!cache->images.empty()) {
+      addFile(cache,
+              (const uint8_t *)cache->images.front() - cache->file,
+              cache->images.size() * sizeof(dyld_cache_image_info));
+    }
+  }
+  if (dCtx.header->slideInfoOffsetUnused) {
+    // Legacy caches with one slide info
+    addFile(&dCtx, dCtx.header->slideInfoOffsetUnused,
+            dCtx.header->slideInfoSizeUnused);
+  }
+
+  // Local symbols of the images
+  auto symbolsCache = dCtx.getSymbolsCache();
+  if (symbolsCache && symbolsCache->header->localSymbolsOffset) {
+    const auto infoOffset = symbolsCache->header->localSymbolsOffset;
+    auto info = (const dyld_cache_local_symbols_info *)(symbolsCache->file +
+                                                        infoOffset);
+    addFile(symbolsCache, infoOffset, sizeof(dyld_cache_local_symbols_info));
+
+    auto addEntries = [&]<class T>(const std::set<uint64_t> &dylibOffsets) {
+      addFile(symbolsCache, infoOffset + info->entriesOffset,
+              info->entriesCount * sizeof(T));
+      auto entries = (const T *)((const uint8_t *)info + info->entriesOffset);
+      auto nlists = (const NlistT *)((const uint8_t *)info + info->nlistOffset);
+      auto strings = (const char *)info + info->stringsOffset;
+      for (uint32_t i = 0; i < info->entriesCount; i++) {
+        const auto &entry = entries[i];
+        if (!dylibOffsets.contains(entry.dylibOffset)) {
+          continue;
+        }
+
+        addFile(symbolsCache,
+                infoOffset + info->nlistOffset +
+                    entry.nlistStartIndex * sizeof(NlistT),
+                entry.nlistCount * sizeof(NlistT));
+        for (uint32_t n = 0; n < entry.nlistCount; n++) {
+          const auto strx = nlists[entry.nlistStartIndex + n].n_un.n_strx;
+          if (strx < info->stringsSize) {
+            addFile(symbolsCache, infoOffset + info->stringsOffset + strx,
+                    strnlen(strings + strx, info->stringsSize - strx) + 1);
+          }
+        }
+      }
+    };
+
+    // See LinkeditOptimizer::findLocalSymbolEntries
+    std::set<uint64_t> dylibOffsets;
+    if (dCtx.headerContainsMember(
+            offsetof(dyld_cache_header, symbolFileUUID))) {
+      for (const auto imageIndex : imageIndices) {
+        dylibOffsets.insert(dCtx.images[imageIndex]->address -
+                            dCtx.header->sharedRegionStart);
+      }
+      addEntries.template operator()<dyld_cache_local_symbols_entry_64>(
+          dylibOffsets);
+    } else {
+      for (const auto imageIndex : imageIndices) {
+        dylibOffsets.insert(
+            dCtx.convertAddr(dCtx.images[imageIndex]->address).first);
+      }
+      addEntries.template operator()<dyld_cache_local_symbols_entry>(
+          dylibOffsets);
+    }
+  }
+
+  for (std::size_t i = 0; i < caches.size(); i++) {
+    auto &ranges = fileRanges[i];
+    mergeRanges(ranges);
+
+    CacheFile file{caches[i], {}};
+    const auto fileSize = caches[i]->cacheFile.size();
+    for (const auto &[start, end] : ranges) {
+      if (start < fileSize) {
+        file.ranges.push_back({start, std::min<uint64_t>(end, fileSize) - start});
+      }
+    }
+    subset.files.push_back(std::move(file));
+  }
+  return subset;
+}
+
+void CacheSubset::write(const fs::path &path) const {
+  const auto basePath = dCtx.cachePath.string();
+  for (const auto &[cache, ranges] : files) {
+    const auto filePath =
+        path.string() + cache->cachePath.string().substr(basePath.size());
+
+    // Skipped parts are left as holes
+    std::ofstream stream(filePath, std::ios::binary | std::ios::trunc);
+    if (!stream.good()) {
+      throw std::runtime_error(fmt::format("Unable to open {}.", filePath));
+    }
+    for (const auto &range : ranges) {
+      stream.seekp(range.offset);
+      stream.write((const char *)cache->file + range.offset, range.size);
+    }
+
+    if (cache == &dCtx && !cache->images.empty()) {
+      // Only list the captured images
+      const auto imagesOffset =
+          (const uint8_t *)cache->images.front() - cache->file;
+      stream.seekp(imagesOffset);
+      for (const auto imageIndex : imageIndices) {
+        stream.write((const char *)cache->images[imageIndex],
+                     sizeof(dyld_cache_image_info));
+      }
+
+      std::vector<uint8_t> headerData(cache->file,
+                                      cache->file + cache->header->mappingOffset);
+      auto header = (dyld_cache_header *)headerData.data();
+      if (cache->headerContainsMember(
+              offsetof(dyld_cache_header, imagesOffset))) {
+        header->imagesCount = (uint32_t)imageIndices.size();
+      } else {
+        header->imagesCountOld = (uint32_t)imageIndices.size();
+      }
+      if (cache->headerContainsMember(
+              offsetof(dyld_cache_header, imagesTextCount))) {
+        header->imagesTextCount = 0;
+      }
+      stream.seekp(0);
+      stream.write((const char *)headerData.data(), headerData.size());
+    }
+
+    stream.close();
+    if (!stream) {
+      throw std::runtime_error(fmt::format("Unable to write {}.", filePath));
+    }
+    fs::resize_file(filePath, cache->cacheFile.size());
+  }
+}
+
+uint64_t CacheSubset::capturedSize() const {
+  uint64_t size = 0;
+  for (const auto &file : files) {
+    for (const auto &range : file.ranges) {
+      size += range.size;
+    }
+  }
+  return size;
+}
+
+template CacheSubset CacheSubset::build<Utils::Arch::Pointer32>(
+    const Context &dCtx, const std::vector<uint32_t> &imageIndices);
+template CacheSubset CacheSubset::build<Utils::Arch::Pointer64>(
+    const Context &dCtx, const std::vector<uint32_t> &imageIndices);
@@ -0,0 +1,63 @@
+#ifndef __DYLD_CACHESUBSET__
+#define __DYLD_CACHESUBSET__
+
+#include "DyldContext.h"
+
+#include <filesystem>
+#include <vector>
+
+namespace DyldExtractor::Dyld {
+
+namespace fs = std::filesystem;
+
+/// @brief A part of a cache that only contains some of its images.
+///
+/// The subset keeps the header, the mappings and the slide info, and the
+/// pages that the images use, like their segments and their parts of the
+/// shared linkedit. Everything keeps its file offset and address, so the
+/// images are the same as in the full cache. The rest of the files are
+/// holes, which makes them sparse on disk and small once compressed. The
+/// subset can be opened with a Context like a full cache.
+///
+/// Data that is outside the images, other than the ObjC and Swift
+/// optimization headers and stub islands, is not captured. Pass the
+/// dependencies of the images so that references between them resolve.
+class CacheSubset {
+public:
+  /// @brief Find the data used by images.
+  /// @param dCtx The full cache.
+  /// @param imageIndices The indices of the images to keep.
+  template <class P>
+  static CacheSubset build(const Context &dCtx,
+                           const std::vector<uint32_t> &imageIndices);
+
+  /// @brief Write the subset, subcaches get the suffixes of the full cache.
+  /// @param path The path of the main cache file.
+  void write(const fs::path &path) const;
+
+  /// @brief The number of bytes that are captured from the cache files.
+  uint64_t capturedSize() const;
+
+private:
+  struct FileRange {
+    uint64_t offset;
+    uint64_t size;
+  };
+
+  /// The ranges to copy from a cache file, sorted and not overlapping.
+  struct CacheFile {
+    const Context *cache;
+    std::vector<FileRange> ranges;
+  };
+
+  CacheSubset(const Context &dCtx) : dCtx(dCtx) {}
+
+  const Context &dCtx;
+  // The main cache, then its subcaches
+  std::vector<CacheFile> files;
+  std::vector<uint32_t> imageIndices;
+};
+
+} // namespace DyldExtractor::Dyld
+
+#endif // __DYLD_CACHESUBSET__
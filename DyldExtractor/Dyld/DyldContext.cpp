@@ -1,9 +1,15 @@
 #include "DyldContext.h"
 
+#include <algorithm>
+#include <cstring>
 #include <fmt/core.h>
 #include <iostream>
 #include <stdexcept>
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
 using namespace DyldExtractor;
 using namespace Dyld;
 
@@ -15,49 +21,18 @@ Context::Context(fs::path sharedCachePath, const uint8_t *subCacheUUID)
   preflightCache(subCacheUUID);
 
   if (!subCacheUUID) {
-    // open subcaches if there are any
-    if (!headerContainsMember(
-            offsetof(dyld_cache_header, subCacheArrayCount))) {
-      return;
-    }
-
-    bool _usesNewerSubCacheInfo =
-        headerContainsMember(offsetof(dyld_cache_header, cacheSubType));
-    const std::string pathBase = sharedCachePath.string();
-    for (uint32_t i = 0; i < header->subCacheArrayCount; i++) {
-      std::string fullPath;
-      const uint8_t *subCacheUUID;
-      if (_usesNewerSubCacheInfo) {
-        auto subCacheInfo =
-            (dyld_subcache_entry *)(file + header->subCacheArrayOffset) + i;
-        subCacheUUID = subCacheInfo->uuid;
-        fullPath = pathBase + std::string(subCacheInfo->fileSuffix);
-      } else {
-        auto subCacheInfo =
-            (dyld_subcache_entry_v1 *)(file + header->subCacheArrayOffset) + i;
-        subCacheUUID = subCacheInfo->uuid;
-        fullPath = pathBase + fmt::format(".{}", i + 1);
-      }
-      subcaches.emplace_back(fullPath, subCacheUUID);
-    }
-
-    // symbols cache
-    if (headerContainsMember(offsetof(dyld_cache_header, symbolFileUUID))) {
-      // Check for null uuid
-      uint8_t summary = 0;
-      for (int i = 0; i < 16; i++) {
-        summary |= header->symbolFileUUID[i];
-      }
-      if (summary == 0) {
-        return;
-      }
-
-      subcaches.emplace_back(pathBase + ".symbols", header->symbolFileUUID);
-    }
+    openSubCaches();
+    buildAddrIndex();
+    buildLocalSymbolsIndex();
   }
 }
 
 Context::~Context() {
+#ifndef _WIN32
+  if (hugeCopy) {
+    munmap(hugeCopy, hugeCopySize);
+  }
+#endif
   if (cacheOpen && cacheFile.is_open()) {
     cacheFile.close();
     cacheOpen = false;
@@ -66,48 +41,74 @@ Context::~Context() {
 
 Context::Context(Context &&other)
     : file(other.file), header(other.header),
+      subcaches(std::move(other.subcaches)),
       cacheFile(std::move(other.cacheFile)),
       cachePath(std::move(other.cachePath)), cacheOpen(other.cacheOpen),
-      subcaches(std::move(other.subcaches)),
-      mappings(std::move(other.mappings)) {
+      hugeCopy(other.hugeCopy), hugeCopySize(other.hugeCopySize),
+      mappings(std::move(other.mappings)),
+      addrIndex(std::move(other.addrIndex)),
+      lastHit(other.lastHit.load(std::memory_order_relaxed)),
+      localSymbolsIndex(std::move(other.localSymbolsIndex)) {
   other.file = nullptr;
   other.header = nullptr;
   other.cacheOpen = false;
+  other.hugeCopy = nullptr;
 }
 
 Context &Context::operator=(Context &&other) {
+#ifndef _WIN32
+  if (this->hugeCopy) {
+    munmap(this->hugeCopy, this->hugeCopySize);
+  }
+#endif
   this->file = other.file;
   this->header = other.header;
   this->cacheOpen = other.cacheOpen;
+  this->hugeCopy = other.hugeCopy;
+  this->hugeCopySize = other.hugeCopySize;
 
   this->cacheFile = std::move(other.cacheFile);
   this->cachePath = std::move(other.cachePath);
   this->subcaches = std::move(other.subcaches);
   this->mappings = std::move(other.mappings);
+  this->addrIndex = std::move(other.addrIndex);
+  this->lastHit = other.lastHit.load(std::memory_order_relaxed);
+  this->localSymbolsIndex = std::move(other.localSymbolsIndex);
 
   other.file = nullptr;
   other.header = nullptr;
   other.cacheOpen = false;
+  other.hugeCopy = nullptr;
 
   return *this;
 }
 
 std::pair<uint64_t, const Context *> Context::convertAddr(uint64_t addr) const {
-  for (auto const &mapping : mappings) {
-    if (addr >= mapping->address && addr < mapping->address + mapping->size) {
-      return std::make_pair((addr - mapping->address) + mapping->fileOffset,
-                            this);
-    }
+  if (addrIndex.empty()) {
+    return std::make_pair(0, nullptr);
   }
 
-  for (auto const &subcache : subcaches) {
-    auto convert = subcache.convertAddr(addr);
-    if (convert.second != nullptr) {
-      return convert;
+  // Check the last mapping that was hit first
+  auto entry = addrIndex.data() + lastHit.load(std::memory_order_relaxed);
+  if (addr < entry->address || addr >= entry->end) {
+    // Find the last entry that starts at or before the address
+    entry = addrIndex.data();
+    std::size_t n = addrIndex.size();
+    while (n > 1) {
+      const std::size_t half = n / 2;
+      entry = (entry[half].address <= addr) ? entry + half : entry;
+      n -= half;
     }
+
+    if (addr < entry->address || addr >= entry->end) {
+      return std::make_pair(0, nullptr);
+    }
+    lastHit.store(entry - addrIndex.data(), std::memory_order_relaxed);
   }
 
-  return std::make_pair(0, nullptr);
+  const Context *cache =
+      entry->cacheIndex ? &subcaches[entry->cacheIndex - 1] : this;
+  return std::make_pair((addr - entry->address) + entry->fileOffset, cache);
 }
 
 const uint8_t *Context::convertAddrP(uint64_t addr) const {
@@ -115,6 +116,112 @@ const uint8_t *Context::convertAddrP(uint64_t addr) const {
   return ctx ? ctx->file + offset : nullptr;
 }
 
+void Context::advise(uint64_t addr, uint64_t size,
+                     Macho::Advice advice) const {
+  const auto end = addr + size;
+  auto entry = std::upper_bound(
+      addrIndex.begin(), addrIndex.end(), addr,
+      [](uint64_t a, const AddrIndexEntry &e) { return a < e.address; });
+  if (entry != addrIndex.begin()) {
+    entry--;
+  }
+
+  for (; entry != addrIndex.end() && entry->address < end; entry++) {
+    const auto start = std::max(addr, entry->address);
+    const auto stop = std::min(end, entry->end);
+    if (start >= stop) {
+      continue;
+    }
+
+    const Context *cache =
+        entry->cacheIndex ? &subcaches[entry->cacheIndex - 1] : this;
+    Macho::adviseMemory(cache->file + entry->fileOffset +
+                            (start - entry->address),
+                        stop - start, advice);
+  }
+}
+
+void Context::releasePages() const {
+  // A huge page copy is anonymous memory, dropping it would zero it.
+  if (cacheOpen && !hugeCopy) {
+    Macho::adviseMemory(file, cacheFile.size(), Macho::Advice::DontNeed);
+  }
+  for (auto &cache : subcaches) {
+    cache.releasePages();
+  }
+}
+
+unsigned int Context::loadIntoHugePages() {
+  unsigned int loaded = 0;
+  for (auto &cache : subcaches) {
+    loaded += cache.loadIntoHugePages();
+  }
+
+#ifndef _WIN32
+  if (!cacheOpen || hugeCopy) {
+    return loaded;
+  }
+
+  const std::size_t fileSize = cacheFile.size();
+  const std::size_t hugePageSize = 2 * 1024 * 1024;
+  const std::size_t size = (fileSize + hugePageSize - 1) & ~(hugePageSize - 1);
+
+  uint8_t *copy = nullptr;
+#ifdef MAP_HUGETLB
+  if (auto region = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      region != MAP_FAILED) {
+    copy = (uint8_t *)region;
+  }
+#endif
+  if (!copy) {
+    // Transparent huge pages need the region to be aligned
+    auto region = mmap(nullptr, size + hugePageSize, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED) {
+      return loaded;
+    }
+
+    const auto base = (uintptr_t)region;
+    const auto aligned = (base + hugePageSize - 1) & ~(hugePageSize - 1);
+    if (aligned != base) {
+      munmap(region, aligned - base);
+    }
+    if (const auto tail = base + hugePageSize - aligned; tail) {
+      munmap((void *)(aligned + size), tail);
+    }
+    copy = (uint8_t *)aligned;
+#ifdef MADV_HUGEPAGE
+    madvise(copy, size, MADV_HUGEPAGE);
+#endif
+  }
+
+  Macho::adviseMemory(file, fileSize, Macho::Advice::Sequential);
+  memcpy(copy, file, fileSize);
+  mprotect(copy, size, PROT_READ);
+  Macho::adviseMemory(file, fileSize, Macho::Advice::DontNeed);
+
+  // Move everything that points into the file to the copy
+  auto rebase = [this, copy]<class T>(const T *&ptr) {
+    ptr = (const T *)(copy + ((const uint8_t *)ptr - file));
+  };
+  rebase(header);
+  for (auto &mapping : mappings) {
+    rebase(mapping);
+  }
+  for (auto &image : images) {
+    rebase(image);
+  }
+  file = copy;
+
+  hugeCopy = copy;
+  hugeCopySize = size;
+  loaded++;
+#endif
+
+  return loaded;
+}
+
 bool Context::headerContainsMember(std::size_t memberOffset) const {
   // Use mapping offset as the cutoff point.
   return memberOffset < header->mappingOffset;
@@ -203,6 +310,119 @@ const Context *Context::getSymbolsCache() const {
   return nullptr;
 }
 
+const Context::LocalSymbolsEntry *
+Context::findLocalSymbolsEntry(uint64_t dylibOffset) const {
+  auto it = std::lower_bound(localSymbolsIndex.begin(),
+                             localSymbolsIndex.end(), dylibOffset,
+                             [](const LocalSymbolsEntry &e, uint64_t offset) {
+                               return e.dylibOffset < offset;
+                             });
+  if (it == localSymbolsIndex.end() || it->dylibOffset != dylibOffset) {
+    return nullptr;
+  }
+  return &*it;
+}
+
+void Context::openSubCaches() {
+  // open subcaches if there are any
+  if (!headerContainsMember(offsetof(dyld_cache_header, subCacheArrayCount))) {
+    return;
+  }
+
+  bool _usesNewerSubCacheInfo =
+      headerContainsMember(offsetof(dyld_cache_header, cacheSubType));
+  const std::string pathBase = cachePath.string();
+  for (uint32_t i = 0; i < header->subCacheArrayCount; i++) {
+    std::string fullPath;
+    const uint8_t *subCacheUUID;
+    if (_usesNewerSubCacheInfo) {
+      auto subCacheInfo =
+          (dyld_subcache_entry *)(file + header->subCacheArrayOffset) + i;
+      subCacheUUID = subCacheInfo->uuid;
+      fullPath = pathBase + std::string(subCacheInfo->fileSuffix);
+    } else {
+      auto subCacheInfo =
+          (dyld_subcache_entry_v1 *)(file + header->subCacheArrayOffset) + i;
+      subCacheUUID = subCacheInfo->uuid;
+      fullPath = pathBase + fmt::format(".{}", i + 1);
+    }
+    subcaches.emplace_back(fullPath, subCacheUUID);
+  }
+
+  // symbols cache
+  if (headerContainsMember(offsetof(dyld_cache_header, symbolFileUUID))) {
+    // Check for null uuid
+    uint8_t summary = 0;
+    for (int i = 0; i < 16; i++) {
+      summary |= header->symbolFileUUID[i];
+    }
+    if (summary == 0) {
+      return;
+    }
+
+    subcaches.emplace_back(pathBase + ".symbols", header->symbolFileUUID);
+  }
+}
+
+void Context::buildAddrIndex() {
+  addrIndex.clear();
+  auto addMappings = [this](const Context &cache, uint32_t cacheIndex) {
+    for (auto mapping : cache.mappings) {
+      if (mapping->size) {
+        addrIndex.push_back({mapping->address, mapping->address + mapping->size,
+                             mapping->fileOffset, cacheIndex});
+      }
+    }
+  };
+
+  addMappings(*this, 0);
+  for (uint32_t i = 0; i < subcaches.size(); i++) {
+    addMappings(subcaches[i], i + 1);
+  }
+
+  // Sort by address, on ties the earlier cache takes precedence by being last.
+  std::sort(addrIndex.begin(), addrIndex.end(),
+            [](const AddrIndexEntry &a, const AddrIndexEntry &b) {
+              if (a.address != b.address) {
+                return a.address < b.address;
+              }
+              return a.cacheIndex > b.cacheIndex;
+            });
+  lastHit = 0;
+}
+
+void Context::buildLocalSymbolsIndex() {
+  localSymbolsIndex.clear();
+  auto symbolsCache = getSymbolsCache();
+  if (!symbolsCache || !symbolsCache->header->localSymbolsOffset) {
+    return;
+  }
+
+  auto info = (const dyld_cache_local_symbols_info *)(symbolsCache->file +
+                                                      symbolsCache->header
+                                                          ->localSymbolsOffset);
+  auto addEntries = [&]<class T>() {
+    auto entries = (const T *)((const uint8_t *)info + info->entriesOffset);
+    localSymbolsIndex.reserve(info->entriesCount);
+    for (uint32_t i = 0; i < info->entriesCount; i++) {
+      localSymbolsIndex.push_back({entries[i].dylibOffset,
+                                   entries[i].nlistStartIndex,
+                                   entries[i].nlistCount});
+    }
+  };
+  if (headerContainsMember(offsetof(dyld_cache_header, symbolFileUUID))) {
+    addEntries.template operator()<dyld_cache_local_symbols_entry_64>();
+  } else {
+    addEntries.template operator()<dyld_cache_local_symbols_entry>();
+  }
+
+  // Stable so the first entry for an offset is found, like a linear search.
+  std::stable_sort(localSymbolsIndex.begin(), localSymbolsIndex.end(),
+                   [](const LocalSymbolsEntry &a, const LocalSymbolsEntry &b) {
+                     return a.dylibOffset < b.dylibOffset;
+                   });
+}
+
 void Context::preflightCache(const uint8_t *subCacheUUID) {
   // validate cache
   if (cacheFile.size() < sizeof(dyld_cache_header)) {
@@ -228,6 +448,8 @@ void Context::preflightCache(const uint8_t *subCacheUUID) {
                                     (i * sizeof(dyld_cache_mapping_info))));
   }
 
+  buildAddrIndex();
+
   bool usesNewerImages =
       headerContainsMember(offsetof(dyld_cache_header, imagesOffset));
   uint32_t imagesOffset =
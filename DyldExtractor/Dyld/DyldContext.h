@@ -1,6 +1,7 @@
 #ifndef __DYLD_CONTEXT__
 #define __DYLD_CONTEXT__
 
+#include <atomic>
 #include <boost/iostreams/device/mapped_file.hpp>
 #include <filesystem>
 
@@ -12,6 +13,9 @@ namespace DyldExtractor::Dyld {
 namespace bio = boost::iostreams;
 namespace fs = std::filesystem;
 
+class CacheOverlay;
+class CacheSubset;
+
 class Context {
 public:
   const uint8_t *file;
@@ -62,15 +66,84 @@ public:
   /// @brief Get the cache file for local symbols
   const Context *getSymbolsCache() const;
 
+  /// A local symbols entry, the same for both entry formats.
+  struct LocalSymbolsEntry {
+    uint64_t dylibOffset;
+    uint32_t nlistStartIndex;
+    uint32_t nlistCount;
+  };
+
+  /// @brief Find the local symbols entry of an image.
+  ///
+  /// The entries of the symbols cache are indexed when the cache is opened.
+  /// Newer caches use the vm offset of the mach header from the shared region
+  /// start, older caches use its file offset.
+  ///
+  /// @param dylibOffset The offset of the image's mach header.
+  /// @returns The entry, or nullptr if there isn't one.
+  const LocalSymbolsEntry *findLocalSymbolsEntry(uint64_t dylibOffset) const;
+
+  /// @brief Give the kernel a hint about a range of addresses.
+  ///
+  /// The range can span this cache and its subcaches, parts that are not
+  /// mapped are ignored. See Macho::adviseMemory.
+  ///
+  /// @param addr The start address.
+  /// @param size The size of the range.
+  /// @param advice The expected access pattern.
+  void advise(uint64_t addr, uint64_t size, Macho::Advice advice) const;
+
+  /// @brief Drop the resident pages of this cache and its subcaches.
+  ///
+  /// Caches that are mapped from their files are read again when they are
+  /// next accessed, so this is safe while other threads are using them.
+  /// Caches copied by loadIntoHugePages are skipped, their pages are not
+  /// backed by the files.
+  void releasePages() const;
+
+  /// @brief Copy this cache and its subcaches into huge page backed memory.
+  ///
+  /// Reserved hugetlbfs pages are used if there are enough, otherwise
+  /// transparent huge pages are requested. A cache that can't be copied stays
+  /// mapped from its file. The file, header, and images are moved to the
+  /// copy, so this should be called before anything else uses the context.
+  ///
+  /// @returns The number of cache files that were copied.
+  unsigned int loadIntoHugePages();
+
 private:
+  friend class CacheOverlay;
+  friend class CacheSubset;
+
   bio::mapped_file cacheFile;
   fs::path cachePath;
   // False when the cacheFile is not constructed, closed, or moved.
   bool cacheOpen = false;
+  // A copy of the cache in huge pages, see loadIntoHugePages.
+  uint8_t *hugeCopy = nullptr;
+  std::size_t hugeCopySize = 0;
 
   std::vector<const dyld_cache_mapping_info *> mappings;
 
+  /// A mapping of this cache or one of its subcaches, cacheIndex is 0 for
+  /// this cache and the subcache index plus 1 otherwise.
+  struct AddrIndexEntry {
+    uint64_t address;
+    uint64_t end;
+    uint64_t fileOffset;
+    uint32_t cacheIndex;
+  };
+  // Sorted mappings of this cache and all subcaches
+  std::vector<AddrIndexEntry> addrIndex;
+  // Index of the last entry that was found by convertAddr
+  mutable std::atomic<std::size_t> lastHit = 0;
+  // Local symbols entries sorted by dylib offset
+  std::vector<LocalSymbolsEntry> localSymbolsIndex;
+
   void preflightCache(const uint8_t *subCacheUUID = nullptr);
+  void openSubCaches();
+  void buildAddrIndex();
+  void buildLocalSymbolsIndex();
 };
 
 }; // namespace DyldExtractor::Dyld
@@ -0,0 +1,189 @@
+#include "ImageIndex.h"
+
+#include <algorithm>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <fmt/format.h>
+#include <fstream>
+#include <random>
+#include <set>
+
+using namespace DyldExtractor;
+using namespace Dyld;
+
+template <class P> ImageIndex ImageIndex::build(const Context &dCtx) {
+  using HeaderT = Macho::Loader::mach_header<P>;
+  using SegmentCommandT = Macho::Loader::segment_command<P>;
+
+  // Read the segments from the load commands
+  std::vector<Segment> rawSegments;
+  for (uint32_t i = 0; i < dCtx.images.size(); i++) {
+    auto header = (const HeaderT *)dCtx.convertAddrP(dCtx.images[i]->address);
+    if (!header || header->magic != HeaderT::MAGIC) {
+      continue;
+    }
+
+    auto cmd = (const uint8_t *)header + sizeof(HeaderT);
+    const auto cmdsEnd = cmd + header->sizeofcmds;
+    for (uint32_t c = 0; c < header->ncmds && cmd < cmdsEnd; c++) {
+      auto lc = (const Macho::Loader::load_command *)cmd;
+      if (lc->cmd == SegmentCommandT::CMDS[0]) {
+        auto seg = (const SegmentCommandT *)cmd;
+        if (seg->vmsize) {
+          Segment segment{seg->vmaddr, seg->vmaddr + seg->vmsize, i, {}};
+          memcpy(segment.segname, seg->segname, sizeof(segment.segname));
+          rawSegments.push_back(segment);
+        }
+      }
+      if (!lc->cmdsize) {
+        break;
+      }
+      cmd += lc->cmdsize;
+    }
+  }
+
+  // Split overlapping segments at their boundaries, and give each part to the
+  // covering segment with the lowest image index.
+  std::vector<std::pair<uint64_t, std::size_t>> boundaries;
+  boundaries.reserve(rawSegments.size() * 2);
+  for (std::size_t i = 0; i < rawSegments.size(); i++) {
+    boundaries.emplace_back(rawSegments[i].address, i);
+    boundaries.emplace_back(rawSegments[i].end, i);
+  }
+  std::sort(boundaries.begin(), boundaries.end());
+
+  ImageIndex index;
+  // Active segments, ordered by image index
+  std::set<std::pair<uint32_t, std::size_t>> active;
+  for (std::size_t b = 0; b < boundaries.size();) {
+    const auto addr = boundaries[b].first;
+    for (; b < boundaries.size() && boundaries[b].first == addr; b++) {
+      const auto segI = boundaries[b].second;
+      const auto key = std::make_pair(rawSegments[segI].imageIndex, segI);
+      if (rawSegments[segI].address == addr) {
+        active.insert(key);
+      } else {
+        active.erase(key);
+      }
+    }
+    if (active.empty() || b == boundaries.size()) {
+      continue;
+    }
+
+    const auto &owner = rawSegments[active.begin()->second];
+    const auto end = boundaries[b].first;
+    auto &segments = index.segments;
+    if (!segments.empty() && segments.back().end == addr &&
+        segments.back().imageIndex == owner.imageIndex &&
+        memcmp(segments.back().segname, owner.segname,
+               sizeof(owner.segname)) == 0) {
+      segments.back().end = end;
+    } else {
+      Segment part = owner;
+      part.address = addr;
+      part.end = end;
+      segments.push_back(part);
+    }
+  }
+
+  return index;
+}
+
+std::optional<ImageIndex> ImageIndex::load(const fs::path &path,
+                                           const Context &dCtx) {
+  // Also rejects empty files, which can't be mapped
+  std::error_code ec;
+  const uint64_t fileSize = fs::file_size(path, ec);
+  if (ec || fileSize < sizeof(Header)) {
+    return std::nullopt;
+  }
+
+  bio::mapped_file_source file(path.string());
+  const auto data = (const uint8_t *)file.data();
+
+  const auto header = (const Header *)data;
+  if (memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      header->version != VERSION ||
+      header->imagesCount != dCtx.images.size() ||
+      memcmp(header->uuid, dCtx.header->uuid, 16) != 0 ||
+      header->segmentsCount >
+          (fileSize - sizeof(Header)) / sizeof(Segment)) {
+    return std::nullopt;
+  }
+
+  ImageIndex index;
+  const auto segments = (const Segment *)(data + sizeof(Header));
+  index.segments.assign(segments, segments + header->segmentsCount);
+  for (std::size_t i = 0; i < index.segments.size(); i++) {
+    const auto &seg = index.segments[i];
+    if (seg.imageIndex >= header->imagesCount || seg.address >= seg.end ||
+        (i && index.segments[i - 1].end > seg.address)) {
+      return std::nullopt;
+    }
+  }
+  return index;
+}
+
+void ImageIndex::save(const fs::path &path, const Context &dCtx) const {
+  Header header{};
+  memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.imagesCount = (uint32_t)dCtx.images.size();
+  memcpy(header.uuid, dCtx.header->uuid, 16);
+  header.segmentsCount = segments.size();
+
+  // Copy the fields into zeroed records, so the padding is the same every run
+  std::vector<Segment> records(segments.size());
+  for (std::size_t i = 0; i < segments.size(); i++) {
+    records[i].address = segments[i].address;
+    records[i].end = segments[i].end;
+    records[i].imageIndex = segments[i].imageIndex;
+    memcpy(records[i].segname, segments[i].segname,
+           sizeof(records[i].segname));
+  }
+
+  // Write to a temporary file and replace the old one. The name is unique so
+  // that processes saving at the same time don't write to the same file.
+  auto tmpPath = path;
+  tmpPath += fmt::format(".{:08x}.tmp", std::random_device()());
+  std::ofstream outFile(tmpPath, std::ios_base::binary);
+  if (!outFile.good()) {
+    throw std::runtime_error("Unable to open image index file.");
+  }
+  outFile.write((const char *)&header, sizeof(Header));
+  outFile.write((const char *)records.data(),
+                records.size() * sizeof(Segment));
+  outFile.close();
+  if (!outFile) {
+    std::error_code ec;
+    fs::remove(tmpPath, ec);
+    throw std::runtime_error("Unable to write image index file.");
+  }
+
+  fs::rename(tmpPath, path);
+}
+
+fs::path ImageIndex::getPath(const fs::path &dir, const Context &dCtx) {
+  std::string name;
+  for (int i = 0; i < 16; i++) {
+    name += fmt::format("{:02X}", dCtx.header->uuid[i]);
+  }
+  return dir / (name + ".dyldex_images");
+}
+
+const ImageIndex::Segment *ImageIndex::find(uint64_t addr) const {
+  auto it = std::upper_bound(
+      segments.begin(), segments.end(), addr,
+      [](uint64_t addr, const Segment &seg) { return addr < seg.address; });
+  if (it == segments.begin()) {
+    return nullptr;
+  }
+  it--;
+  return addr < it->end ? &*it : nullptr;
+}
+
+const std::vector<ImageIndex::Segment> &ImageIndex::getSegments() const {
+  return segments;
+}
+
+template ImageIndex ImageIndex::build<Utils::Arch::Pointer32>(const Context &);
+template ImageIndex ImageIndex::build<Utils::Arch::Pointer64>(const Context &);
@@ -0,0 +1,70 @@
+#ifndef __DYLD_IMAGEINDEX__
+#define __DYLD_IMAGEINDEX__
+
+#include "DyldContext.h"
+
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+namespace DyldExtractor::Dyld {
+
+namespace fs = std::filesystem;
+
+/// @brief A sorted index of the segments of all images in a cache, for
+/// finding the image that contains an address.
+///
+/// The index is built from the load commands of every image without creating
+/// Macho contexts. Segments can overlap, like the shared linkedit, and the
+/// overlapping parts belong to the image that is first in the cache. The
+/// index can be saved to a sidecar file named with the UUID of the cache.
+class ImageIndex {
+public:
+  struct Segment {
+    uint64_t address;
+    uint64_t end;
+    uint32_t imageIndex;
+    char segname[16];
+  };
+
+  static constexpr char MAGIC[8] = {'D', 'Y', 'E', 'X', 'I', 'M', 'G', 'I'};
+  static constexpr uint32_t VERSION = 1;
+
+  /// @brief Build the index from the images of a cache.
+  template <class P> static ImageIndex build(const Context &dCtx);
+
+  /// @brief Load a sidecar file.
+  /// @returns The index, or nullopt if the file doesn't exist or is not for
+  /// the cache.
+  static std::optional<ImageIndex> load(const fs::path &path,
+                                        const Context &dCtx);
+
+  /// @brief Save the index to a sidecar file, replacing the existing one.
+  void save(const fs::path &path, const Context &dCtx) const;
+
+  /// @brief Get the path of the sidecar file for a cache.
+  /// @param dir The directory that contains the sidecar files.
+  static fs::path getPath(const fs::path &dir, const Context &dCtx);
+
+  /// @brief Find the segment that contains an address.
+  /// @returns The segment or nullptr.
+  const Segment *find(uint64_t addr) const;
+
+  const std::vector<Segment> &getSegments() const;
+
+private:
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t imagesCount;
+    uint8_t uuid[16];
+    uint64_t segmentsCount;
+  };
+
+  // Sorted and not overlapping
+  std::vector<Segment> segments;
+};
+
+} // namespace DyldExtractor::Dyld
+
+#endif // __DYLD_IMAGEINDEX__
@@ -1,10 +1,55 @@
 #include "MachoContext.h"
 
+#include <algorithm>
 #include <exception>
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 using namespace DyldExtractor;
 using namespace Macho;
 
+void Macho::adviseMemory(const void *data, uint64_t size, Advice advice) {
+#ifndef _WIN32
+  if (!data || !size) {
+    return;
+  }
+
+  static const uintptr_t pageSize = (uintptr_t)sysconf(_SC_PAGESIZE);
+  auto start = (uintptr_t)data;
+  auto end = start + (uintptr_t)size;
+  if (advice == Advice::DontNeed) {
+    start = (start + pageSize - 1) & ~(pageSize - 1);
+    end &= ~(pageSize - 1);
+  } else {
+    start &= ~(pageSize - 1);
+    end = (end + pageSize - 1) & ~(pageSize - 1);
+  }
+  if (start >= end) {
+    return;
+  }
+
+  int flag;
+  switch (advice) {
+  case Advice::Sequential:
+    flag = MADV_SEQUENTIAL;
+    break;
+  case Advice::WillNeed:
+    flag = MADV_WILLNEED;
+    break;
+  case Advice::DontNeed:
+    flag = MADV_DONTNEED;
+    break;
+  default:
+    flag = MADV_NORMAL;
+    break;
+  }
+  madvise((void *)start, end - start, flag);
+#endif
+}
+
 MappingInfo::MappingInfo(const dyld_cache_mapping_info *info)
     : address(info->address), size(info->size), fileOffset(info->fileOffset) {}
 
@@ -68,6 +113,19 @@ Context<ro, P>::Context(
   ownFiles = true;
 }
 
+template <bool ro, class P>
+Context<ro, P>::Context(
+    uint64_t fileOffset, FileT *mainFile, std::vector<MappingInfo> mainMappings,
+    std::vector<std::tuple<FileT *, std::vector<MappingInfo>>> subFiles)
+    : file(mainFile), headerOffset(fileOffset) {
+  files.emplace_back(file, mainMappings);
+  for (auto &[subFile, mapping] : subFiles) {
+    files.emplace_back(subFile, mapping);
+  }
+
+  reloadHeader();
+}
+
 template <bool ro, class P> Context<ro, P>::~Context() {
   if (filesOpen) {
     for (auto &file : fileMaps) {
@@ -79,9 +137,12 @@ template <bool ro, class P> Context<ro, P>::~Context() {
 
 template <bool ro, class P>
 Context<ro, P>::Context(Context<ro, P> &&other)
-    : file(other.file), header(other.header), ownFiles(other.ownFiles),
-      filesOpen(other.filesOpen), fileMaps(std::move(other.fileMaps)),
-      files(std::move(other.files)) {
+    : file(other.file), header(other.header),
+      loadCommands(std::move(other.loadCommands)),
+      segments(std::move(other.segments)), headerOffset(other.headerOffset),
+      ownFiles(other.ownFiles), filesOpen(other.filesOpen),
+      fileMaps(std::move(other.fileMaps)), files(std::move(other.files)),
+      lcIndex(std::move(other.lcIndex)) {
   other.file = nullptr;
   other.header = nullptr;
   other.ownFiles = false;
@@ -92,11 +153,15 @@ template <bool ro, class P>
 Context<ro, P> &Context<ro, P>::operator=(Context<ro, P> &&other) {
   this->file = other.file;
   this->header = other.header;
+  this->loadCommands = std::move(other.loadCommands);
+  this->segments = std::move(other.segments);
+  this->headerOffset = other.headerOffset;
   this->ownFiles = other.ownFiles;
   this->filesOpen = other.filesOpen;
 
   this->fileMaps = std::move(other.fileMaps);
   this->files = std::move(other.files);
+  this->lcIndex = std::move(other.lcIndex);
 
   other.file = nullptr;
   other.header = nullptr;
@@ -108,6 +173,7 @@ Context<ro, P> &Context<ro, P>::operator=(Context<ro, P> &&other) {
 template <bool ro, class P> void Context<ro, P>::reloadHeader() {
   loadCommands.clear();
   segments.clear();
+  lcIndex.clear();
 
   header = (HeaderT *)(file + headerOffset);
 
@@ -119,16 +185,18 @@ template <bool ro, class P> void Context<ro, P>::reloadHeader() {
   }
 
   loadCommands.reserve(header->ncmds);
+  lcIndex.reserve(header->ncmds);
   FileT *cmdStart = (FileT *)header + sizeof(HeaderT);
   for (uint32_t cmdOff = 0; cmdOff < header->sizeofcmds;) {
     auto cmd = (LoadCommandT *)(cmdStart + cmdOff);
+    lcIndex.push_back({cmd->cmd, (uint32_t)loadCommands.size()});
     loadCommands.emplace_back(cmd);
     cmdOff += cmd->cmdsize;
   }
+  std::sort(lcIndex.begin(), lcIndex.end());
 
-  for (auto const seg : getAllLCs<Loader::segment_command<P>>()) {
-    segments.emplace_back(seg);
-  }
+  forEachLC<Loader::segment_command<P>>(
+      [this](auto seg) { segments.emplace_back(seg); });
 }
 
 template <bool ro, class P>
@@ -153,6 +221,22 @@ Context<ro, P>::convertAddrP(uint64_t addr) const {
   return file ? file + offset : nullptr;
 }
 
+template <bool ro, class P>
+void Context<ro, P>::advise(uint64_t addr, uint64_t size,
+                            Advice advice) const {
+  const auto end = addr + size;
+  for (auto &[file, mappings] : files) {
+    for (auto &mapping : mappings) {
+      const auto start = std::max(addr, mapping.address);
+      const auto stop = std::min(end, mapping.address + mapping.size);
+      if (start < stop) {
+        adviseMemory(file + mapping.fileOffset + (start - mapping.address),
+                     stop - start, advice);
+      }
+    }
+  }
+}
+
 template <bool ro, class P>
 const SegmentContext<ro, P> *
 Context<ro, P>::getSegment(const char *segName) const {
@@ -251,27 +335,22 @@ template <bool ro, class P>
 typename Context<ro, P>::LoadCommandT *
 Context<ro, P>::_getFirstLC(const uint32_t (&targetCmds)[],
                             std::size_t ncmds) const {
-  auto matchLoadCommands = [&targetCmds, ncmds](uint32_t cmd) {
-    // magic value for load_command, match all.
-    if (ncmds == 2 && targetCmds[0] == 0x00 && targetCmds[1] == 0x00) {
-      return true;
-    }
-
-    for (int i = 0; i < ncmds; i++) {
-      if (cmd == targetCmds[i]) {
-        return true;
-      }
-    }
-    return false;
-  };
+  // magic value for load_command, match all.
+  if (ncmds == 2 && targetCmds[0] == 0x00 && targetCmds[1] == 0x00) {
+    return loadCommands.empty() ? nullptr : loadCommands.front();
+  }
 
-  for (auto lc : loadCommands) {
-    if (matchLoadCommands(lc->cmd)) {
-      return lc;
+  // The first entry of each ID in the index is its first load command.
+  uint32_t first = UINT32_MAX;
+  for (std::size_t i = 0; i < ncmds; i++) {
+    auto it = std::lower_bound(lcIndex.begin(), lcIndex.end(),
+                               LCIndexEntry{targetCmds[i], 0});
+    if (it != lcIndex.end() && it->cmd == targetCmds[i]) {
+      first = std::min(first, it->index);
     }
   }
 
-  return nullptr;
+  return first != UINT32_MAX ? loadCommands[first] : nullptr;
 }
 
 template <bool ro, class P>
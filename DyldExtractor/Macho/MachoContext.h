@@ -1,8 +1,10 @@
 #ifndef __MACHO_CONTEXT__
 #define __MACHO_CONTEXT__
 
+#include <algorithm>
 #include <boost/iostreams/device/mapped_file.hpp>
 #include <filesystem>
+#include <functional>
 
 #include "Loader.h"
 #include <dyld/dyld_cache_format.h>
@@ -30,6 +32,29 @@ struct MappingInfo {
     MappingInfo(const dyld_cache_mapping_info *);
 };
 
+/// @brief How mapped memory is expected to be accessed.
+enum class Advice {
+    Normal,
+    /// Pages are read in order, read ahead aggressively.
+    Sequential,
+    /// Pages will be read soon, start reading them in.
+    WillNeed,
+    /// Pages are no longer needed, drop them from the resident set. Changes
+    /// to private mappings are discarded.
+    DontNeed
+};
+
+/// @brief Give the kernel a hint about a range of mapped memory.
+///
+/// The range is rounded out to whole pages, except for DontNeed which is
+/// rounded in so no neighbouring data is dropped. Advice is only a hint, so
+/// errors are ignored, and it does nothing on platforms without madvise.
+///
+/// @param data The start of the range.
+/// @param size The size of the range.
+/// @param advice The expected access pattern.
+void adviseMemory(const void *data, uint64_t size, Advice advice);
+
 template <bool ro, class P> class SegmentContext {
 public:
     using SegmentCommandT = c_const<ro, Loader::segment_command<P>>::T;
@@ -85,6 +110,19 @@ public:
     Context(uint64_t fileOffset, fs::path mainPath,
             std::vector<MappingInfo> mainMappings,
             std::vector<std::tuple<fs::path, std::vector<MappingInfo>>> subFiles);
+    /// @brief A wrapper around a MachO file in memory managed elsewhere.
+    ///
+    /// The context does not own or manage any of the files, the caller must
+    /// keep them mapped for the lifetime of the context.
+    ///
+    /// @param fileOffset The file offset to the mach header.
+    /// @param mainFile The start of the file that contains the header.
+    /// @param mainMapping The mapping info for mainFile
+    /// @param subFiles A vector of tuples of all other files and their mapping
+    ///   info.
+    Context(uint64_t fileOffset, FileT *mainFile,
+            std::vector<MappingInfo> mainMappings,
+            std::vector<std::tuple<FileT *, std::vector<MappingInfo>>> subFiles);
     
     /// @brief Reload the header and load commands
     void reloadHeader();
@@ -143,6 +181,33 @@ public:
         return getAllLCs<lc>(lc::CMDS);
     }
     
+    /// @brief Call a function for each load command with a custom filter
+    ///
+    /// The load commands are visited in the order they appear in, without
+    /// building a list of them.
+    ///
+    /// @tparam lc The type of load command
+    /// @param cmds The custom ID filter
+    /// @param callback The function to call for each load command.
+    template <class lc, std::size_t _s, class F>
+    inline void forEachLC(const uint32_t (&cmds)[_s], F &&callback) const {
+        const bool matchAll = _s == 2 && cmds[0] == 0x00 && cmds[1] == 0x00;
+        for (auto cmd : loadCommands) {
+            if (matchAll ||
+                std::find(std::begin(cmds), std::end(cmds), cmd->cmd) !=
+                std::end(cmds)) {
+                callback(reinterpret_cast<typename c_const<ro, lc>::T *>(cmd));
+            }
+        }
+    }
+    
+    /// @brief Call a function for each load command
+    /// @tparam lc The type of load command
+    /// @param callback The function to call for each load command.
+    template <class lc, class F> inline void forEachLC(F &&callback) const {
+        forEachLC<lc>(lc::CMDS, std::forward<F>(callback));
+    }
+    
     /// @brief Search for a segment
     ///
     /// @param segName The name of the segment.
@@ -168,11 +233,56 @@ public:
     ///     stop.
     void enumerateSections(EnumerationCallback callback);
     
+    /// @brief Enumerate all segments
+    ///
+    /// Same as the EnumerationCallback version, but the functions can be
+    /// inlined. Prefer this in loops that run for every image.
+    ///
+    /// @param pred The predicate used to filter.
+    /// @param callback The function to call for each section. Return false to
+    ///     stop.
+    template <class Pred, class F>
+    inline void enumerateSections(Pred &&pred, F &&callback) {
+        for (auto &seg : segments) {
+            for (auto sect : seg.sections) {
+                if (pred(seg, sect) && !callback(seg, sect)) {
+                    return;
+                }
+            }
+        }
+    }
+    
+    /// @brief Enumerate all segments
+    ///
+    /// Same as the EnumerationCallback version, but the function can be
+    /// inlined.
+    ///
+    /// @param callback The function to call for each section. Return false to
+    ///     stop.
+    template <class F> inline void enumerateSections(F &&callback) {
+        for (auto &seg : segments) {
+            for (auto sect : seg.sections) {
+                if (!callback(seg, sect)) {
+                    return;
+                }
+            }
+        }
+    }
+    
     /// @brief Check if the address is in the macho file
     /// @param addr
     /// @returns If the file contains the address
     bool containsAddr(const uint64_t addr) const;
     
+    /// @brief Give the kernel a hint about a range of addresses.
+    ///
+    /// Parts of the range that are not mapped are ignored. See adviseMemory.
+    ///
+    /// @param addr The start address.
+    /// @param size The size of the range.
+    /// @param advice The expected access pattern.
+    void advise(uint64_t addr, uint64_t size, Advice advice) const;
+    
     ~Context();
     Context(const Context &other) = delete;
     Context(Context &&other);
@@ -191,6 +301,18 @@ private:
     // Contains all files and mappings
     std::vector<std::tuple<FileT *, std::vector<MappingInfo>>> files;
     
+    /// A load command's ID and its index in loadCommands.
+    struct LCIndexEntry {
+        uint32_t cmd;
+        uint32_t index;
+        
+        bool operator<(const LCIndexEntry &other) const {
+            return cmd < other.cmd || (cmd == other.cmd && index < other.index);
+        }
+    };
+    // loadCommands sorted by ID then index, built in reloadHeader
+    std::vector<LCIndexEntry> lcIndex;
+    
     std::vector<LoadCommandT *> _getAllLCs(const uint32_t (&targetCmds)[],
                                            std::size_t ncmds) const;
     LoadCommandT *_getFirstLC(const uint32_t (&targetCmds)[],
@@ -1,11 +1,26 @@
 #ifndef __PROVIDER_ACCELERATOR__
 #define __PROVIDER_ACCELERATOR__
 
+#include <Objc/Abstraction.h>
 #include <dyld/dyld_cache_format.h>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <condition_variable>
+#include <cstring>
+#include <limits>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <set>
+#include <shared_mutex>
+#include <span>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <unordered_set>
+#include <vector>
 
 #pragma warning(push)
 #pragma warning(disable : 4267)
@@ -16,19 +31,58 @@ namespace DyldExtractor::Provider {
 
 namespace AcceleratorTypes {
 
+/// Storage for strings that live as long as the accelerator.
+class StringArena {
+public:
+    /// @brief Copy a block of characters into the arena.
+    /// @returns The copy, valid for the lifetime of the arena.
+    const char *store(const char *data, std::size_t size) {
+        auto block = std::make_unique<char[]>(size);
+        std::memcpy(block.get(), data, size);
+        std::scoped_lock lock(mutex);
+        return blocks.emplace_back(std::move(block)).get();
+    }
+    
+    /// @brief Keep memory that strings point into, like a mapped file, alive
+    ///     for the lifetime of the arena.
+    void keep(std::shared_ptr<const void> owner) {
+        std::scoped_lock lock(mutex);
+        owners.push_back(std::move(owner));
+    }
+    
+private:
+    std::mutex mutex;
+    std::vector<std::unique_ptr<char[]>> blocks;
+    std::vector<std::shared_ptr<const void>> owners;
+};
+
+/// An export trie entry that doesn't own its strings. The strings are either
+/// in a StringArena, or point into the cache.
+struct ExportEntryView {
+    struct Info {
+        uint64_t address = 0;
+        uint64_t flags = 0;
+        uint64_t other = 0;
+        std::string_view importName;
+    };
+    
+    std::string_view name;
+    Info info;
+};
+
 /// Intermediate representation of a export, should not be used.
 struct SymbolizerExportEntry {
     uint64_t address;
-    ExportInfoTrie::Entry entry;
+    ExportEntryView entry;
     
     /// @brief This constructor should only be used for searching
-    SymbolizerExportEntry(std::string n) : address(0), entry(n, ExportInfo()) {}
-    SymbolizerExportEntry(uint64_t a, ExportInfoTrie::Entry e)
+    SymbolizerExportEntry(std::string_view n) : address(0), entry{n, {}} {}
+    SymbolizerExportEntry(uint64_t a, ExportEntryView e)
     : address(a), entry(e) {}
     
     struct Hash {
         std::size_t operator()(const SymbolizerExportEntry &e) const {
-            return std::hash<std::string>{}(e.entry.name);
+            return std::hash<std::string_view>{}(e.entry.name);
         }
     };
     
@@ -44,30 +98,238 @@ using SymbolizerExportEntryMapT =
 std::unordered_multiset<SymbolizerExportEntry, SymbolizerExportEntry::Hash,
 SymbolizerExportEntry::KeyEqual>;
 
+/// The parts of an image that a lazy Symbolizer needs to know which
+/// dependencies could have symbols at an address.
+struct SymbolizerImageLinks {
+    /// The start and end of each segment, except the linkedit.
+    std::vector<std::pair<uint64_t, uint64_t>> segments;
+    /// The paths of the images reexported with LC_REEXPORT_DYLIB, and of
+    /// the dependencies that individual exports are reexported from.
+    std::vector<std::string> reExports;
+};
+
+/// A map split into shards that are locked independently.
+template <class K, class V, std::size_t ShardCount = 16> class ShardedMap {
+public:
+    /// @brief Find a value
+    /// @param key The key to search for.
+    /// @returns The value or nullopt if not found.
+    std::optional<V> get(const K &key) const {
+        const auto &shard = getShard(key);
+        std::shared_lock lock(shard.mutex);
+        if (auto it = shard.map.find(key); it != shard.map.end()) {
+            return it->second;
+        }
+        return std::nullopt;
+    }
+    
+    /// @brief Insert or replace a value
+    void insert(const K &key, const V &value) {
+        auto &shard = getShard(key);
+        std::unique_lock lock(shard.mutex);
+        shard.map.insert_or_assign(key, value);
+    }
+    
+    /// @brief Call a function with every key and value
+    template <class F> void forEach(F callback) const {
+        for (const auto &shard : shards) {
+            std::shared_lock lock(shard.mutex);
+            for (const auto &[key, value] : shard.map) {
+                callback(key, value);
+            }
+        }
+    }
+    
+private:
+    struct Shard {
+        mutable std::shared_mutex mutex;
+        std::map<K, V> map;
+    };
+    std::array<Shard, ShardCount> shards;
+    
+    Shard &getShard(const K &key) {
+        return shards[shardIndex(key)];
+    }
+    const Shard &getShard(const K &key) const {
+        return shards[shardIndex(key)];
+    }
+    static std::size_t shardIndex(const K &key) {
+        // Mix the hash as addresses are aligned
+        return (std::hash<K>{}(key) * 0x9E3779B97F4A7C15ULL >> 32) % ShardCount;
+    }
+};
+
+/// Sorted, non overlapping address ranges, searched with an Eytzinger layout.
+///
+/// The starts of the ranges are stored in breadth first order of a complete
+/// binary search tree, so a search reads one contiguous array and every
+/// search takes the same number of steps.
+template <class PtrT> class RegionIndex {
+public:
+    /// @brief Build the index, replacing any previous regions.
+    /// @param ranges Pairs of the start and end of each region, in any order.
+    ///     Overlapping and adjacent regions are merged.
+    void build(std::vector<std::pair<PtrT, PtrT>> ranges) {
+        std::sort(ranges.begin(), ranges.end());
+        regions.clear();
+        for (const auto &range : ranges) {
+            if (!regions.empty() && range.first <= regions.back().second) {
+                regions.back().second =
+                std::max(regions.back().second, range.second);
+            } else {
+                regions.push_back(range);
+            }
+        }
+        
+        // Pad the tree to a complete tree, padding sorts after everything
+        depth = (unsigned int)std::bit_width(regions.size());
+        const std::size_t treeSize = std::size_t(1) << depth;
+        tree.assign(treeSize, std::numeric_limits<PtrT>::max());
+        order.assign(treeSize, regions.size());
+        std::size_t i = 0;
+        fillTree(1, i);
+    }
+    
+    bool empty() const { return regions.empty(); }
+    std::size_t size() const { return regions.size(); }
+    
+    /// @brief Get the regions, sorted
+    const std::vector<std::pair<PtrT, PtrT>> &getRegions() const {
+        return regions;
+    }
+    
+    /// @brief Check if any region contains the address
+    bool contains(const PtrT addr) const {
+        if (regions.empty()) {
+            return false;
+        }
+        
+        std::size_t k = 1;
+        for (unsigned int level = 0; level < depth; level++) {
+            k = 2 * k + (tree[k] <= addr);
+        }
+        return check(k, addr);
+    }
+    
+    /// @brief Check many addresses at once
+    ///
+    /// The searches are interleaved so their memory accesses overlap.
+    /// @param addrs The addresses to check.
+    /// @param results Set to 1 if the address is in a region, or 0. Must be
+    ///     the same size as addrs.
+    void containsAll(std::span<const PtrT> addrs,
+                     std::span<uint8_t> results) const {
+        if (regions.empty()) {
+            std::fill(results.begin(), results.end(), 0);
+            return;
+        }
+        
+        constexpr std::size_t GROUP = 8;
+        std::size_t i = 0;
+        for (; i + GROUP <= addrs.size(); i += GROUP) {
+            std::size_t k[GROUP];
+            std::fill(std::begin(k), std::end(k), 1);
+            for (unsigned int level = 0; level < depth; level++) {
+                for (std::size_t g = 0; g < GROUP; g++) {
+                    k[g] = 2 * k[g] + (tree[k[g]] <= addrs[i + g]);
+                }
+            }
+            for (std::size_t g = 0; g < GROUP; g++) {
+                results[i + g] = check(k[g], addrs[i + g]);
+            }
+        }
+        for (; i < addrs.size(); i++) {
+            results[i] = contains(addrs[i]);
+        }
+    }
+    
+private:
+    std::vector<std::pair<PtrT, PtrT>> regions;
+    /// The starts of the regions in Eytzinger order, 1 based.
+    std::vector<PtrT> tree;
+    /// The index of the region at each tree node.
+    std::vector<std::size_t> order;
+    unsigned int depth = 0;
+    
+    void fillTree(std::size_t k, std::size_t &i) {
+        if (k >= tree.size()) {
+            return;
+        }
+        fillTree(2 * k, i);
+        if (i < regions.size()) {
+            tree[k] = regions[i].first;
+            order[k] = i;
+            i++;
+        }
+        fillTree(2 * k + 1, i);
+    }
+    
+    /// @brief Finish a search at leaf position k.
+    bool check(std::size_t k, const PtrT addr) const {
+        // Remove the right turns after the last left turn, leaving the node
+        // of the first region that starts after the address.
+        k >>= std::countr_one(k) + 1;
+        const std::size_t upper = k ? order[k] : regions.size();
+        return upper && addr < regions[upper - 1].second;
+    }
+};
+
 }; // namespace AcceleratorTypes
 
-/// Accelerate modules when processing more than one image. Single threaded.
+/// Accelerate modules when processing more than one image. All members can be
+/// shared between threads with the noted synchronization.
 template <class P> class Accelerator {
     using PtrT = P::PtrT;
     
 public:
     // Provider::Symbolizer
+    /// Initializes pathToImage, which is read only afterwards.
+    std::once_flag pathToImageOnce;
     std::map<std::string, const dyld_cache_image_info *> pathToImage;
+    /// Guards exportsCache, exportsCompleted, exportsBuilding, and
+    /// exportsWaiting. An entry is only changed by the thread building it,
+    /// entries in exportsCompleted are read only.
+    std::shared_mutex exportsMutex;
+    /// Notified when an entry is completed.
+    std::condition_variable_any exportsBuilt;
+    /// The thread building each entry that is not completed.
+    std::map<std::string, std::thread::id> exportsBuilding;
+    /// The entry each building thread is waiting for, to find cycles.
+    std::map<std::thread::id, std::string> exportsWaiting;
     std::map<std::string, AcceleratorTypes::SymbolizerExportEntryMapT>
     exportsCache;
+    std::set<std::string> exportsCompleted;
+    /// Owns the export names in exportsCache.
+    AcceleratorTypes::StringArena exportStrings;
+    /// Export tries parsed ahead of time by Symbolizer::preloadExports,
+    /// guarded by exportsMutex. Taken when the dylib's exports are built.
+    std::map<std::string, std::vector<AcceleratorTypes::ExportEntryView>>
+    parsedExports;
+    /// Guards imageLinks.
+    std::shared_mutex imageLinksMutex;
+    /// Read from each image's load commands by lazy symbolizers.
+    std::map<std::string, AcceleratorTypes::SymbolizerImageLinks> imageLinks;
     
     // Converter::Stubs::Arm64Utils, Converter::Stubs::ArmUtils
-    std::map<PtrT, PtrT> arm64ResolvedChains;
-    std::map<PtrT, PtrT> armResolvedChains;
+    AcceleratorTypes::ShardedMap<PtrT, PtrT> arm64ResolvedChains;
+    AcceleratorTypes::ShardedMap<PtrT, PtrT> armResolvedChains;
+    /// Initializes arm64StubIslands, which is read only afterwards. Sorted
+    /// pairs of stubs outside of images and the final targets of their chains.
+    std::once_flag arm64StubIslandsOnce;
+    std::vector<std::pair<PtrT, PtrT>> arm64StubIslands;
     
     // Converter::Stubs::Fixer
-    struct CodeRegion {
-        PtrT start;
-        PtrT end;
-        CodeRegion(PtrT start, PtrT end):start(start), end(end) {}
-        auto operator<=>(const auto &o) const { return start <=> o.start; }
-    };
-    std::set<CodeRegion> codeRegions;
+    /// Initializes codeRegions, which is read only afterwards.
+    std::once_flag codeRegionsOnce;
+    AcceleratorTypes::RegionIndex<PtrT> codeRegions;
+    
+    // Converter::ObjcFixer::Walker
+    /// Slid protocols outside of images, keyed by address. Nearly every
+    /// image references the same ones, like NSObject and NSCopying.
+    AcceleratorTypes::ShardedMap<PtrT, Objc::protocol_t<P>> objcProtocols;
+    /// The slid protocol addresses of protocol lists outside of images.
+    AcceleratorTypes::ShardedMap<PtrT, std::shared_ptr<const std::vector<PtrT>>>
+    objcProtocolLists;
     
     Accelerator() = default;
     Accelerator(const Accelerator &) = delete;
@@ -0,0 +1,241 @@
+#include "AcceleratorCache.h"
+
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <fmt/format.h>
+#include <fstream>
+
+using namespace DyldExtractor;
+using namespace Provider;
+
+namespace bio = boost::iostreams;
+
+template <class P>
+AcceleratorCache<P>::AcceleratorCache(const fs::path &dir,
+                                      const Dyld::Context &dCtx)
+    : dCtx(dCtx) {
+  std::string name;
+  for (int i = 0; i < 16; i++) {
+    name += fmt::format("{:02X}", dCtx.header->uuid[i]);
+  }
+  path = dir / (name + ".dyldex_accel");
+}
+
+template <class P>
+bool AcceleratorCache<P>::load(Accelerator<P> &accelerator) const {
+  // Also rejects empty files, which can't be mapped
+  std::error_code ec;
+  const uint64_t fileSize = fs::file_size(path, ec);
+  if (ec || fileSize < sizeof(Header)) {
+    return false;
+  }
+
+  const auto file = std::make_shared<bio::mapped_file_source>(path.string());
+  const auto data = (const uint8_t *)file->data();
+
+  // Validate
+  const auto header = (const Header *)data;
+  if (memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      header->version != VERSION || header->pointerSize != sizeof(PtrT) ||
+      memcmp(header->uuid, dCtx.header->uuid, 16) != 0) {
+    return false;
+  }
+
+  auto tableValid = [fileSize](uint64_t offset, uint64_t count,
+                               uint64_t size) {
+    return offset <= fileSize && count <= (fileSize - offset) / size;
+  };
+  if (!tableValid(header->stringsOffset, header->stringsSize, 1) ||
+      !tableValid(header->dylibsOffset, header->dylibsCount,
+                  sizeof(DylibRecord)) ||
+      !tableValid(header->exportsOffset, header->exportsCount,
+                  sizeof(ExportRecord)) ||
+      !tableValid(header->arm64ChainsOffset, header->arm64ChainsCount,
+                  sizeof(PairRecord)) ||
+      !tableValid(header->armChainsOffset, header->armChainsCount,
+                  sizeof(PairRecord)) ||
+      !tableValid(header->codeRegionsOffset, header->codeRegionsCount,
+                  sizeof(PairRecord))) {
+    return false;
+  }
+
+  const auto strings = (const char *)data + header->stringsOffset;
+  if (header->stringsSize == 0 || strings[header->stringsSize - 1] != '\0') {
+    return false;
+  }
+  auto getString = [&](uint64_t offset) -> std::string {
+    return offset < header->stringsSize ? std::string(strings + offset) : "";
+  };
+
+  const auto dylibs = (const DylibRecord *)(data + header->dylibsOffset);
+  const auto exports = (const ExportRecord *)(data + header->exportsOffset);
+  for (uint64_t i = 0; i < header->dylibsCount; i++) {
+    if (dylibs[i].exportsStart > header->exportsCount ||
+        dylibs[i].exportsCount >
+            header->exportsCount - dylibs[i].exportsStart) {
+      return false;
+    }
+  }
+
+  // Exports, names point into the file, which the arena keeps mapped
+  {
+    accelerator.exportStrings.keep(file);
+    auto getView = [&](uint64_t offset) -> std::string_view {
+      return offset < header->stringsSize ? strings + offset : "";
+    };
+
+    std::unique_lock lock(accelerator.exportsMutex);
+    for (uint64_t i = 0; i < header->dylibsCount; i++) {
+      const auto &dylib = dylibs[i];
+      auto dylibPath = getString(dylib.pathOffset);
+      if (accelerator.exportsCache.contains(dylibPath)) {
+        continue;
+      }
+
+      auto &exportsMap = accelerator.exportsCache[dylibPath];
+      exportsMap.reserve(dylib.exportsCount);
+      for (uint64_t j = 0; j < dylib.exportsCount; j++) {
+        const auto &record = exports[dylib.exportsStart + j];
+        AcceleratorTypes::ExportEntryView entry;
+        entry.name = getView(record.nameOffset);
+        entry.info.address = record.infoAddress;
+        entry.info.flags = record.flags;
+        entry.info.other = record.other;
+        entry.info.importName = getView(record.importNameOffset);
+        exportsMap.emplace(record.address, entry);
+      }
+      accelerator.exportsCompleted.insert(std::move(dylibPath));
+    }
+  }
+
+  // Stub chains
+  const auto arm64Chains =
+      (const PairRecord *)(data + header->arm64ChainsOffset);
+  for (uint64_t i = 0; i < header->arm64ChainsCount; i++) {
+    accelerator.arm64ResolvedChains.insert((PtrT)arm64Chains[i].first,
+                                           (PtrT)arm64Chains[i].second);
+  }
+  const auto armChains = (const PairRecord *)(data + header->armChainsOffset);
+  for (uint64_t i = 0; i < header->armChainsCount; i++) {
+    accelerator.armResolvedChains.insert((PtrT)armChains[i].first,
+                                         (PtrT)armChains[i].second);
+  }
+
+  // Code regions, only if they were generated
+  if (header->codeRegionsCount) {
+    const auto regions = (const PairRecord *)(data + header->codeRegionsOffset);
+    std::call_once(accelerator.codeRegionsOnce, [&]() {
+      std::vector<std::pair<PtrT, PtrT>> ranges;
+      ranges.reserve(header->codeRegionsCount);
+      for (uint64_t i = 0; i < header->codeRegionsCount; i++) {
+        ranges.emplace_back((PtrT)regions[i].first, (PtrT)regions[i].second);
+      }
+      accelerator.codeRegions.build(std::move(ranges));
+    });
+  }
+
+  return true;
+}
+
+template <class P>
+void AcceleratorCache<P>::save(Accelerator<P> &accelerator) const {
+  std::vector<char> strings;
+  std::map<std::string, uint64_t, std::less<>> stringOffsets;
+  auto addString = [&](std::string_view str) {
+    if (auto it = stringOffsets.find(str); it != stringOffsets.end()) {
+      return it->second;
+    }
+    const uint64_t offset = strings.size();
+    strings.insert(strings.end(), str.begin(), str.end());
+    strings.push_back('\0');
+    stringOffsets.emplace(std::string(str), offset);
+    return offset;
+  };
+  addString("");
+
+  std::vector<DylibRecord> dylibs;
+  std::vector<ExportRecord> exports;
+  {
+    std::shared_lock lock(accelerator.exportsMutex);
+    for (const auto &dylibPath : accelerator.exportsCompleted) {
+      const auto &exportsMap = accelerator.exportsCache.at(dylibPath);
+      dylibs.push_back(
+          {addString(dylibPath), exports.size(), exportsMap.size()});
+      for (const auto &e : exportsMap) {
+        exports.push_back({e.address, e.entry.info.address, e.entry.info.flags,
+                           e.entry.info.other, addString(e.entry.name),
+                           addString(e.entry.info.importName)});
+      }
+    }
+  }
+
+  std::vector<PairRecord> arm64Chains;
+  accelerator.arm64ResolvedChains.forEach(
+      [&](PtrT addr, PtrT target) { arm64Chains.push_back({addr, target}); });
+  std::vector<PairRecord> armChains;
+  accelerator.armResolvedChains.forEach(
+      [&](PtrT addr, PtrT target) { armChains.push_back({addr, target}); });
+
+  // Code regions are only saved once they're filled
+  std::vector<PairRecord> codeRegions;
+  for (const auto &[start, end] : accelerator.codeRegions.getRegions()) {
+    codeRegions.push_back({start, end});
+  }
+
+  // Layout
+  Header header{};
+  memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.pointerSize = sizeof(PtrT);
+  memcpy(header.uuid, dCtx.header->uuid, 16);
+
+  uint64_t offset = sizeof(Header);
+  auto placeTable = [&offset](uint64_t &tableOffset, uint64_t &tableCount,
+                              uint64_t count, uint64_t size) {
+    tableOffset = offset;
+    tableCount = count;
+    offset += count * size;
+    offset = (offset + 7) & ~7ULL;
+  };
+  placeTable(header.dylibsOffset, header.dylibsCount, dylibs.size(),
+             sizeof(DylibRecord));
+  placeTable(header.exportsOffset, header.exportsCount, exports.size(),
+             sizeof(ExportRecord));
+  placeTable(header.arm64ChainsOffset, header.arm64ChainsCount,
+             arm64Chains.size(), sizeof(PairRecord));
+  placeTable(header.armChainsOffset, header.armChainsCount, armChains.size(),
+             sizeof(PairRecord));
+  placeTable(header.codeRegionsOffset, header.codeRegionsCount,
+             codeRegions.size(), sizeof(PairRecord));
+  placeTable(header.stringsOffset, header.stringsSize, strings.size(), 1);
+
+  // Write to a temporary file and replace the old one
+  auto tmpPath = path;
+  tmpPath += ".tmp";
+  std::ofstream outFile(tmpPath, std::ios_base::binary);
+  if (!outFile.good()) {
+    throw std::runtime_error("Unable to open accelerator cache file.");
+  }
+
+  auto writeTable = [&outFile](uint64_t tableOffset, const auto &table) {
+    outFile.seekp(tableOffset);
+    outFile.write((const char *)table.data(),
+                  table.size() * sizeof(*table.data()));
+  };
+  outFile.write((const char *)&header, sizeof(Header));
+  writeTable(header.dylibsOffset, dylibs);
+  writeTable(header.exportsOffset, exports);
+  writeTable(header.arm64ChainsOffset, arm64Chains);
+  writeTable(header.armChainsOffset, armChains);
+  writeTable(header.codeRegionsOffset, codeRegions);
+  writeTable(header.stringsOffset, strings);
+  outFile.close();
+
+  fs::rename(tmpPath, path);
+}
+
+template <class P> const fs::path &AcceleratorCache<P>::getPath() const {
+  return path;
+}
+
+template class DyldExtractor::Provider::AcceleratorCache<Utils::Arch::Pointer32>;
+template class DyldExtractor::Provider::AcceleratorCache<Utils::Arch::Pointer64>;
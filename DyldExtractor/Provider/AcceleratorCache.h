@@ -0,0 +1,92 @@
+#ifndef __PROVIDER_ACCELERATORCACHE__
+#define __PROVIDER_ACCELERATORCACHE__
+
+#include "Accelerator.h"
+#include <Dyld/DyldContext.h>
+#include <filesystem>
+
+namespace DyldExtractor::Provider {
+
+namespace fs = std::filesystem;
+
+/// @brief A sidecar file that persists an Accelerator between runs.
+///
+/// The file is named with the UUID of the cache and stores the exports cache,
+/// resolved stub chains, and code regions in a flat format that only uses
+/// offsets, so it can be memory mapped and read directly.
+template <class P> class AcceleratorCache {
+  using PtrT = P::PtrT;
+
+public:
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t pointerSize;
+    uint8_t uuid[16];
+
+    uint64_t stringsOffset;
+    uint64_t stringsSize;
+    uint64_t dylibsOffset;
+    uint64_t dylibsCount;
+    uint64_t exportsOffset;
+    uint64_t exportsCount;
+    uint64_t arm64ChainsOffset;
+    uint64_t arm64ChainsCount;
+    uint64_t armChainsOffset;
+    uint64_t armChainsCount;
+    uint64_t codeRegionsOffset;
+    uint64_t codeRegionsCount;
+  };
+
+  /// A dylib in the exports cache, and the range of its exports.
+  struct DylibRecord {
+    uint64_t pathOffset;
+    uint64_t exportsStart;
+    uint64_t exportsCount;
+  };
+
+  /// A SymbolizerExportEntry, strings are offsets into the string pool.
+  struct ExportRecord {
+    uint64_t address;
+    uint64_t infoAddress;
+    uint64_t flags;
+    uint64_t other;
+    uint64_t nameOffset;
+    uint64_t importNameOffset;
+  };
+
+  struct PairRecord {
+    uint64_t first;
+    uint64_t second;
+  };
+
+  static constexpr char MAGIC[8] = {'D', 'Y', 'E', 'X', 'A', 'C', 'C', 'L'};
+  static constexpr uint32_t VERSION = 1;
+
+  /// @brief Create a sidecar file for a cache
+  /// @param dir The directory that contains the sidecar files.
+  /// @param dCtx The cache that the accelerator is used with.
+  AcceleratorCache(const fs::path &dir, const Dyld::Context &dCtx);
+
+  /// @brief Load the sidecar file into an accelerator.
+  ///
+  /// Should be called before the accelerator is used.
+  ///
+  /// @param accelerator The accelerator to fill.
+  /// @returns If the file existed and was valid.
+  bool load(Accelerator<P> &accelerator) const;
+
+  /// @brief Save an accelerator, replacing the existing file.
+  /// @param accelerator The accelerator to save.
+  void save(Accelerator<P> &accelerator) const;
+
+  const fs::path &getPath() const;
+
+private:
+  fs::path path;
+  const Dyld::Context &dCtx;
+};
+
+} // namespace DyldExtractor::Provider
+
+#endif // __PROVIDER_ACCELERATORCACHE__
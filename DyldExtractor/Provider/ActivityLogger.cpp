@@ -1,105 +1,162 @@
 #include "ActivityLogger.h"
 
+#include <fmt/format.h>
+
 using namespace DyldExtractor;
 using namespace Provider;
 
-ActivityLogger::StreamBuffer::StreamBuffer(std::streambuf *buffer)
-    : buffer(buffer) {}
-
-int ActivityLogger::StreamBuffer::sync() { return buffer->pubsync(); }
+ActivityLogger::StreamBuffer::StreamBuffer(ActivityLogger &activity)
+    : activity(activity) {}
 
 int ActivityLogger::StreamBuffer::overflow(int c) {
   if (c != std::char_traits<char>::eof()) {
-    if (needPrefix &&
-        prefix.size() != buffer->sputn(prefix.c_str(), prefix.size())) {
-      return std::char_traits<char>::eof();
+    line.push_back((char)c);
+    if (c == '\n') {
+      activity.writeLines(line);
+      line.clear();
     }
-    needPrefix = (c == '\n');
   }
+  return c;
+}
+
+std::streamsize ActivityLogger::StreamBuffer::xsputn(const char *s,
+                                                     std::streamsize count) {
+  // Pass on everything up to the last new line
+  std::string_view data(s, count);
+  if (auto end = data.rfind('\n'); end != data.npos) {
+    line.append(data.substr(0, end + 1));
+    activity.writeLines(line);
+    line.clear();
+    data.remove_prefix(end + 1);
+  }
+  line.append(data);
+  return count;
+}
+
+int ActivityLogger::StreamBuffer::sync() {
+  if (line.size()) {
+    activity.writeLines(line);
+    line.clear();
+  }
+  return 0;
+}
+
+ActivityLogger::LineSink::LineSink(ActivityLogger &activity)
+    : activity(activity) {}
 
-  return buffer->sputc(c);
+void ActivityLogger::LineSink::sink_it_(const spdlog::details::log_msg &msg) {
+  spdlog::memory_buf_t formatted;
+  formatter_->format(msg, formatted);
+  activity.writeLines(std::string_view(formatted.data(), formatted.size()));
 }
 
 ActivityLogger::ActivityLogger(std::string name, std::ostream &output,
                                bool enableActivity)
-    : activityStream(output), loggerStream(&streamBuffer),
-      streamBuffer(output.rdbuf()), enableActivity(enableActivity),
-      lastActivityUpdate(std::chrono::high_resolution_clock::now()),
-      lastElapsedTime(0), startTime(std::chrono::high_resolution_clock::now()) {
-  std::shared_ptr<spdlog::sinks::ostream_sink_st> streamSink;
+    : activityStream(output), loggerStream(&streamBuffer), streamBuffer(*this),
+      enableActivity(enableActivity),
+      startTime(std::chrono::high_resolution_clock::now()) {
   if (enableActivity) {
-    // Create a logger with the special buffer
-    streamSink = std::make_shared<spdlog::sinks::ostream_sink_st>(loggerStream);
+    // Log lines are written by the render thread
+    logger = std::make_shared<spdlog::logger>(
+        name, std::make_shared<LineSink>(*this));
 
-    // preload activity
-    update(currentModule, currentMessage, true);
+    rendering = true;
+    redrawNow = true;
+    renderThread = std::thread(&ActivityLogger::render, this);
   } else {
-    streamSink = std::make_shared<spdlog::sinks::ostream_sink_st>(output);
+    logger = std::make_shared<spdlog::logger>(
+        name, std::make_shared<spdlog::sinks::ostream_sink_st>(output));
   }
-
-  logger = std::make_shared<spdlog::logger>(name, streamSink);
 }
 
+ActivityLogger::~ActivityLogger() { stopActivity(); }
+
 void ActivityLogger::update(std::optional<std::string> moduleName,
                             std::optional<std::string> message,
                             bool fullUpdate) {
-  if (!enableActivity) {
+  // Most calls only keep the spinner going, which the render thread does
+  if (!enableActivity || (!moduleName && !message && !fullUpdate)) {
     return;
   }
 
-  // Format, [(/) Elapsed Time] Module - Text
-  unsigned int updateLevel = fullUpdate ? INT_MAX : 0;
-
-  // Spinner
-  auto currentTime = std::chrono::high_resolution_clock::now();
-  if (std::chrono::duration_cast<std::chrono::milliseconds>(currentTime -
-                                                            lastActivityUpdate)
-          .count() > 150) {
-    lastActivityUpdate = currentTime;
-    currentActivityState = (currentActivityState + 1) % activityStates.size();
-    updateLevel |= 0b1;
+  {
+    std::scoped_lock lock(stateMutex);
+    if (moduleName) {
+      currentModule = std::move(*moduleName);
+    }
+    if (message) {
+      currentMessage = std::move(*message);
+    }
+    redrawNow |= fullUpdate;
   }
-
-  // elapsed time
-  auto elapsedTime = std::chrono::duration_cast<std::chrono::seconds>(
-      std::chrono::high_resolution_clock::now() - startTime);
-  if (elapsedTime != lastElapsedTime) {
-    lastElapsedTime = elapsedTime;
-    updateLevel |= 0b10;
+  if (fullUpdate) {
+    stateCondition.notify_one();
   }
+}
 
-  // text
-  if (moduleName) {
-    currentModule = moduleName.value();
-    updateLevel |= 0b100;
-  }
-  if (message) {
-    currentMessage = message.value();
-    updateLevel |= 0b100;
+void ActivityLogger::stopActivity() {
+  {
+    std::scoped_lock lock(stateMutex);
+    if (!rendering) {
+      return;
+    }
+    rendering = false;
   }
+  stateCondition.notify_one();
+  renderThread.join();
+}
 
-  // Update
-  std::string output;
-  if (updateLevel >= 0b100) {
-    output = fmt::format(
-        "\033[2K[({}) {}] {} - {}", activityStates[currentActivityState],
-        _formatTime(elapsedTime), currentModule, currentMessage);
-  } else if (updateLevel >= 0b10) {
-    output = fmt::format("[({}) {}", activityStates[currentActivityState],
-                         _formatTime(elapsedTime));
-  } else if (updateLevel >= 0b1) {
-    output = fmt::format("[({}", activityStates[currentActivityState]);
+void ActivityLogger::writeLines(std::string_view lines) {
+  std::scoped_lock lock(stateMutex);
+  if (!rendering) {
+    activityStream << lines << std::flush;
+    return;
   }
 
-  if (output.length()) {
-    activityStream << output + "\r" << std::flush;
+  // Thanks to alkis-pap from github.com/p-ranav/indicators/issues/107
+  // New line, move up, and insert line before every line, which keeps the
+  // activity indicator below it.
+  const std::string_view prefix = "\n\033[A\033[1L";
+  while (lines.size()) {
+    const auto end = std::min(lines.find('\n'), lines.size() - 1);
+    if (atLineStart) {
+      pendingOutput.append(prefix);
+    }
+    pendingOutput.append(lines.substr(0, end + 1));
+    atLineStart = lines[end] == '\n';
+    lines.remove_prefix(end + 1);
   }
 }
 
-void ActivityLogger::stopActivity() {
-  if (enableActivity) {
-    enableActivity = false;
-    activityStream << "\n";
+void ActivityLogger::render() {
+  // Format, [(/) Elapsed Time] Module - Text
+  std::unique_lock lock(stateMutex);
+  while (true) {
+    stateCondition.wait_for(lock, REFRESH_INTERVAL,
+                            [this]() { return !rendering || redrawNow; });
+    if (!redrawNow) {
+      currentActivityState =
+          (currentActivityState + 1) % activityStates.size();
+    }
+    redrawNow = false;
+
+    auto elapsedTime = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::high_resolution_clock::now() - startTime);
+    auto output = std::move(pendingOutput);
+    pendingOutput.clear();
+    output += fmt::format(
+        "\033[2K[({}) {}] {} - {}\r", activityStates[currentActivityState],
+        _formatTime(elapsedTime), currentModule, currentMessage);
+    if (!rendering) {
+      // Lines written after this go straight to the stream
+      activityStream << output << "\n" << std::flush;
+      return;
+    }
+
+    // Write without blocking updates
+    lock.unlock();
+    activityStream << output << std::flush;
+    lock.lock();
   }
 }
 
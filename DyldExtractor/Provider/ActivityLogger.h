@@ -2,31 +2,51 @@
 #define __PROVIDER_ACTIVITYLOGGER__
 
 #include <chrono>
+#include <condition_variable>
 #include <iostream>
+#include <mutex>
+#include <optional>
 #include <spdlog/logger.h>
+#include <spdlog/sinks/base_sink.h>
 #include <spdlog/sinks/ostream_sink.h>
+#include <string_view>
+#include <thread>
 
 namespace DyldExtractor::Provider {
 
+/// @brief A logger with an activity indicator.
+///
+/// With the activity indicator, a background thread redraws it at a fixed
+/// rate and writes the log lines above it, so updates and logging don't wait
+/// on the terminal.
 class ActivityLogger {
-  /// @brief A wrapper for a streambuf that allows an activity indicator.
-  ///
-  /// Essentially does new line, moves line up, and insert line, before
-  /// every line.
+  /// @brief A streambuf that passes complete lines to the activity logger.
   class StreamBuffer : public std::streambuf {
   public:
-    StreamBuffer(std::streambuf *buffer);
+    StreamBuffer(ActivityLogger &activity);
 
   private:
-    std::streambuf *buffer;
-
-    /// Thanks to alkis-pap from github.com/p-ranav/indicators/issues/107
-    /// Move up, insert line
-    const std::string prefix = "\n\033[A\033[1L";
-    bool needPrefix;
+    ActivityLogger &activity;
+    // The line that is being written
+    std::string line;
 
     int sync();
     int overflow(int c);
+    std::streamsize xsputn(const char *s, std::streamsize count);
+  };
+
+  /// @brief A spdlog sink that passes formatted messages to the activity
+  /// logger.
+  class LineSink : public spdlog::sinks::base_sink<std::mutex> {
+  public:
+    LineSink(ActivityLogger &activity);
+
+  protected:
+    void sink_it_(const spdlog::details::log_msg &msg) override;
+    void flush_() override {}
+
+  private:
+    ActivityLogger &activity;
   };
 
 public:
@@ -35,6 +55,7 @@ public:
   /// @param output The output stream.
   /// @param enableActivity Enable or disable the activity indicator.
   ActivityLogger(std::string name, std::ostream &output, bool enableActivity);
+  ~ActivityLogger();
 
   ActivityLogger(const ActivityLogger &) = delete;
   ActivityLogger(const ActivityLogger &&) = delete;
@@ -43,13 +64,16 @@ public:
 
   /// Update the activity indicator.
   ///
+  /// Only stores the text, the indicator is drawn by the background thread.
+  ///
   /// @param module The name of the module.
   /// @param message The message.
+  /// @param fullUpdate Redraw now instead of at the next refresh.
   void update(std::optional<std::string> moduleName = std::nullopt,
               std::optional<std::string> message = std::nullopt,
               bool fullUpdate = false);
 
-  /// @brief Stop the activity indicator
+  /// @brief Stop the activity indicator, after writing the remaining lines.
   void stopActivity();
 
   /// @brief Get the spdlog logger
@@ -60,22 +84,36 @@ public:
   std::ostream &getLoggerStream();
 
 private:
+  /// The time between redraws of the activity indicator
+  static constexpr std::chrono::milliseconds REFRESH_INTERVAL{150};
+
   std::shared_ptr<spdlog::logger> logger;
   std::ostream &activityStream;
   std::ostream loggerStream;
   StreamBuffer streamBuffer;
 
-  bool enableActivity;
+  const bool enableActivity;
   std::string currentModule = "---";
   std::string currentMessage = "---";
   int currentActivityState = 0;
   const std::vector<std::string> activityStates = {"|", "/", "-", "\\"};
-  std::chrono::time_point<std::chrono::high_resolution_clock>
-      lastActivityUpdate;
-
-  std::chrono::seconds lastElapsedTime;
   const std::chrono::time_point<std::chrono::high_resolution_clock> startTime;
 
+  // Protects the text, the pending output, and the render thread's state
+  std::mutex stateMutex;
+  std::condition_variable stateCondition;
+  // Lines waiting to be written above the activity indicator
+  std::string pendingOutput;
+  // If the pending output ends with a complete line
+  bool atLineStart = true;
+  bool rendering = false;
+  bool redrawNow = false;
+  std::thread renderThread;
+
+  /// Write lines above the activity indicator.
+  void writeLines(std::string_view lines);
+  void render();
+
   std::string _formatTime(std::chrono::seconds seconds);
 };
 
@@ -3,36 +3,70 @@
 #include <Utils/Architectures.h>
 #include <Utils/Leb128.h>
 #include <fmt/core.h>
-#include <functional>
 
 using namespace DyldExtractor;
 using namespace Provider;
 
-struct IntermediateBindRecord {
-  uint8_t segIndex = 0;
-  uint64_t segOffset = 0;
-  uint8_t type = 0;
-  uint8_t flags = 0;
-  int libOrdinal = 0;
-  char *symbolName = nullptr;
-  int64_t addend = 0;
-};
-
-/// @brief Bind info reader implementation
-/// @param start Pointer to start of opcode stream.
-/// @param end Pointer to end of opcode stream.
-/// @param callback Called for each bind record. The first argument is the
-/// offset of the bind record from the start of the stream, which only makes
-/// sense for lazy bind info. Return false to stop reading.
 template <class P>
-void readBindStream(
-    const uint8_t *const start, const uint8_t *const end, bool stopAtDone,
-    std::function<bool(uint32_t, IntermediateBindRecord)> callback) {
-  const uint8_t *currentRecordStart = start;
-  IntermediateBindRecord currentRecord;
+BindStream<P>::BindStream(const Macho::Context<false, P> &mCtx,
+                          const uint8_t *start, const uint8_t *end,
+                          bool stopAtDone)
+    : mCtx(&mCtx), start(start), _end(end), stopAtDone(stopAtDone) {}
+
+template <class P> BindStream<P>::Iterator BindStream<P>::begin() const {
+  if (start == _end) {
+    return end();
+  }
+  return Iterator(this, start);
+}
+
+template <class P> BindStream<P>::Iterator BindStream<P>::end() const {
+  return Iterator();
+}
 
-    const uint32_t ptrSize = sizeof(typename P::PtrT);
-  const uint8_t *p = start;
+template <class P>
+BindStream<P>::Iterator::Iterator(const BindStream *stream, const uint8_t *p)
+    : stream(stream), p(p), recordStart(p) {
+  advance();
+}
+
+template <class P>
+BindStream<P>::Iterator &BindStream<P>::Iterator::operator++() {
+  advance();
+  return *this;
+}
+
+template <class P>
+BindStream<P>::Iterator BindStream<P>::Iterator::operator++(int) {
+  auto copy = *this;
+  advance();
+  return copy;
+}
+
+template <class P> void BindStream<P>::Iterator::advance() {
+  const uint32_t ptrSize = sizeof(typename P::PtrT);
+  auto &record = current.record;
+
+  // Finish the last bind
+  if (repeatLeft) {
+    segOffset += repeatSkip + ptrSize;
+    if (--repeatLeft) {
+      record.address =
+          stream->mCtx->segments.at(segIndex).command->vmaddr + segOffset;
+      return;
+    }
+  } else {
+    segOffset += pendingAdvance;
+    pendingAdvance = 0;
+  }
+
+  const uint8_t *const start = stream->start;
+  const uint8_t *const end = stream->_end;
+  auto emit = [&]() {
+    current.offset = (uint32_t)(recordStart - start);
+    record.address =
+        stream->mCtx->segments.at(segIndex).command->vmaddr + segOffset;
+  };
 
   while (p < end) {
     const auto opcode = *p & BIND_OPCODE_MASK;
@@ -41,188 +75,218 @@ void readBindStream(
 
     switch (opcode) {
     case BIND_OPCODE_DONE:
-      if (stopAtDone) {
-        return;
+      if (stream->stopAtDone) {
+        p = end;
       } else {
         // Resets and starts a new record
-        currentRecord = IntermediateBindRecord();
-        currentRecordStart = p;
+        record = BindRecord();
+        segIndex = 0;
+        segOffset = 0;
+        recordStart = p;
       }
       break;
 
     case BIND_OPCODE_SET_DYLIB_ORDINAL_IMM:
-      currentRecord.libOrdinal = imm;
+      record.libOrdinal = imm;
       break;
 
     case BIND_OPCODE_SET_DYLIB_ORDINAL_ULEB:
-      currentRecord.libOrdinal = (int)Utils::readUleb128(p, end);
+      record.libOrdinal = (int)Utils::readUleb128(p, end);
       break;
 
     case BIND_OPCODE_SET_DYLIB_SPECIAL_IMM:
       // the special ordinals are negative numbers
       if (imm == 0)
-        currentRecord.libOrdinal = 0;
+        record.libOrdinal = 0;
       else {
         int8_t signExtended = BIND_OPCODE_MASK | imm;
-        currentRecord.libOrdinal = signExtended;
+        record.libOrdinal = signExtended;
       }
       break;
 
     case BIND_OPCODE_SET_SYMBOL_TRAILING_FLAGS_IMM:
-      currentRecord.flags = imm;
-      currentRecord.symbolName = (char *)p;
+      record.flags = imm;
+      record.symbolName = (char *)p;
       while (*p != '\0')
         p++;
       p++;
       break;
 
     case BIND_OPCODE_SET_TYPE_IMM:
-      currentRecord.type = imm;
+      record.type = imm;
       break;
 
     case BIND_OPCODE_SET_ADDEND_SLEB:
-      currentRecord.addend = Utils::readSleb128(p, end);
+      record.addend = Utils::readSleb128(p, end);
       break;
 
     case BIND_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB:
-      currentRecord.segIndex = imm;
-      currentRecord.segOffset = Utils::readUleb128(p, end);
+      segIndex = imm;
+      segOffset = Utils::readUleb128(p, end);
       break;
 
     case BIND_OPCODE_ADD_ADDR_ULEB:
-      currentRecord.segOffset += Utils::readUleb128(p, end);
+      segOffset += Utils::readUleb128(p, end);
       break;
 
     case BIND_OPCODE_DO_BIND:
-      if (!callback((uint32_t)(currentRecordStart - start), currentRecord)) {
-        return;
-      }
-
-      currentRecord.segOffset += ptrSize;
-      break;
+      pendingAdvance = ptrSize;
+      emit();
+      return;
 
     case BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB:
-      if (!callback((uint32_t)(currentRecordStart - start), currentRecord)) {
-        return;
-      }
-
-      currentRecord.segOffset += Utils::readUleb128(p, end) + ptrSize;
-      break;
+      pendingAdvance = Utils::readUleb128(p, end) + ptrSize;
+      emit();
+      return;
 
     case BIND_OPCODE_DO_BIND_ADD_ADDR_IMM_SCALED:
-      if (!callback((uint32_t)(currentRecordStart - start), currentRecord)) {
-        return;
-      }
-
-      currentRecord.segOffset += imm * ptrSize + ptrSize;
-      break;
+      pendingAdvance = imm * ptrSize + ptrSize;
+      emit();
+      return;
 
     case BIND_OPCODE_DO_BIND_ULEB_TIMES_SKIPPING_ULEB: {
       const auto count = Utils::readUleb128(p, end);
       const auto skip = Utils::readUleb128(p, end);
-      for (uint32_t i = 0; i < count; i++) {
-        if (!callback((uint32_t)(currentRecordStart - start), currentRecord)) {
-          return;
-        }
-
-        currentRecord.segOffset += skip + ptrSize;
+      if (count) {
+        repeatLeft = count;
+        repeatSkip = skip;
+        emit();
+        return;
       }
       break;
     }
 
     default:
       throw std::invalid_argument(
-          fmt::format("Unknown bind opcode 0x{:02x}.", *p));
+          fmt::format("Unknown bind opcode 0x{:02x}.", *(p - 1)));
     }
   }
+
+  // Reached the end
+  p = nullptr;
+  repeatLeft = 0;
 }
 
 template <class P>
 BindInfo<P>::BindInfo(const Macho::Context<false, P> &mCtx,
                       Provider::ActivityLogger &activity)
-    : mCtx(&mCtx), activity(&activity) {}
+    : mCtx(&mCtx), activity(&activity) {
+  // Empty until loaded
+  locate(binds, nullptr, 0);
+  locate(weakBinds, nullptr, 0);
+  locate(lazyBinds, nullptr, 0);
+}
 
-template <class P> void BindInfo<P>::load() {
-  if (dataLoaded) {
-    return;
+template <class P>
+void BindInfo<P>::reset(const Macho::Context<false, P> &mCtx,
+                        Provider::ActivityLogger &activity) {
+  this->mCtx = &mCtx;
+  this->activity = &activity;
+  _hasLazyBinds = false;
+  locate(binds, nullptr, 0);
+  locate(weakBinds, nullptr, 0);
+  locate(lazyBinds, nullptr, 0);
+  retired.clear();
+}
+
+template <class P>
+template <class T>
+void BindInfo<P>::locate(std::unique_ptr<Decoded<T>> &decoded,
+                         const uint8_t *start, uint32_t size) {
+  const uint8_t *end = start + size;
+  if (!size) {
+    start = end = nullptr;
   }
 
+  if (!decoded || decoded->start != start || decoded->end != end) {
+    if (decoded) {
+      retired.emplace_back(std::move(decoded));
+    }
+    decoded = std::make_unique<Decoded<T>>();
+    decoded->start = start;
+    decoded->end = end;
+  }
+}
+
+template <class P> void BindInfo<P>::load() {
   const uint8_t *linkeditFile =
       mCtx->convertAddr(mCtx->getSegment(SEG_LINKEDIT)->command->vmaddr).second;
   const dyld_info_command *dyldInfo =
     mCtx->template getFirstLC<Macho::Loader::dyld_info_command>();
 
-  activity->update("BindInfo", "Starting up");
-  if (dyldInfo && dyldInfo->bind_size) {
-    activity->update(std::nullopt, "Reading Binding Info");
-    auto bindStart = linkeditFile + dyldInfo->bind_off;
-    auto bindEnd = bindStart + dyldInfo->bind_size;
-    readBindStream<P>(bindStart, bindEnd, true,
-                      [this](uint32_t, IntermediateBindRecord record) {
-                        binds.emplace_back(
-                            mCtx->segments.at(record.segIndex).command->vmaddr +
-                                record.segOffset,
-                            record.type, record.flags, record.libOrdinal,
-                            record.symbolName, record.addend);
-                        return true;
-                      });
+  if (dyldInfo) {
+    locate(binds, linkeditFile + dyldInfo->bind_off, dyldInfo->bind_size);
+    locate(weakBinds, linkeditFile + dyldInfo->weak_bind_off,
+           dyldInfo->weak_bind_size);
+    locate(lazyBinds, linkeditFile + dyldInfo->lazy_bind_off,
+           dyldInfo->lazy_bind_size);
+  } else {
+    locate(binds, nullptr, 0);
+    locate(weakBinds, nullptr, 0);
+    locate(lazyBinds, nullptr, 0);
   }
 
-  if (dyldInfo && dyldInfo->weak_bind_size) {
-    activity->update(std::nullopt, "Reading Weak Binding Info");
-    auto bindStart = linkeditFile + dyldInfo->weak_bind_off;
-    auto bindEnd = bindStart + dyldInfo->weak_bind_size;
-    readBindStream<P>(bindStart, bindEnd, true,
-                      [this](uint32_t, IntermediateBindRecord record) {
-                        weakBinds.emplace_back(
-                            mCtx->segments.at(record.segIndex).command->vmaddr +
-                                record.segOffset,
-                            record.type, record.flags, record.libOrdinal,
-                            record.symbolName, record.addend);
-                        return true;
-                      });
-  }
+  _hasLazyBinds = dyldInfo != nullptr && dyldInfo->lazy_bind_size != 0;
+}
 
-  if (dyldInfo && dyldInfo->lazy_bind_size) {
-    activity->update(std::nullopt, "Reading Lazy Binding Info");
-    auto bindStart = linkeditFile + dyldInfo->lazy_bind_off;
-    auto bindEnd = bindStart + dyldInfo->lazy_bind_size;
-    readBindStream<P>(
-        bindStart, bindEnd, false,
-        [this](uint32_t off, IntermediateBindRecord record) {
-          lazyBinds.emplace(
-              off,
-              BindRecord{mCtx->segments.at(record.segIndex).command->vmaddr +
-                             record.segOffset,
-                         record.type, record.flags, record.libOrdinal,
-                         record.symbolName, record.addend});
-          return true;
-        });
-  }
+template <class P> BindStream<P> BindInfo<P>::getBindStream() const {
+  return BindStream<P>(*mCtx, binds->start, binds->end, true);
+}
 
-  _hasLazyBinds = dyldInfo != nullptr && dyldInfo->lazy_bind_size != 0;
-  dataLoaded = true;
+template <class P> BindStream<P> BindInfo<P>::getWeakBindStream() const {
+  return BindStream<P>(*mCtx, weakBinds->start, weakBinds->end, true);
+}
+
+template <class P> BindStream<P> BindInfo<P>::getLazyBindStream() const {
+  return BindStream<P>(*mCtx, lazyBinds->start, lazyBinds->end, false);
 }
 
 template <class P>
 const std::vector<BindRecord> &BindInfo<P>::getBinds() const {
-  return binds;
+  std::call_once(binds->once, [this] {
+    activity->update("BindInfo", "Reading Binding Info");
+    for (const auto &entry : getBindStream()) {
+      binds->data.push_back(entry.record);
+    }
+  });
+  return binds->data;
 }
 
 template <class P>
 const std::vector<BindRecord> &BindInfo<P>::getWeakBinds() const {
-  return weakBinds;
+  std::call_once(weakBinds->once, [this] {
+    activity->update("BindInfo", "Reading Weak Binding Info");
+    for (const auto &entry : getWeakBindStream()) {
+      weakBinds->data.push_back(entry.record);
+    }
+  });
+  return weakBinds->data;
 }
 
 template <class P>
-const std::map<uint32_t, BindRecord> &BindInfo<P>::getLazyBinds() const {
-  return lazyBinds;
+const std::vector<typename BindInfo<P>::LazyBind> &
+BindInfo<P>::getLazyBinds() const {
+  std::call_once(lazyBinds->once, [this] {
+    activity->update("BindInfo", "Reading Lazy Binding Info");
+    auto &data = lazyBinds->data;
+    for (const auto &entry : getLazyBindStream()) {
+      // Only the first bind of a record is kept, and offsets only increase
+      if (data.empty() || data.back().offset != entry.offset) {
+        data.push_back({entry.offset, entry.record});
+      }
+    }
+  });
+  return lazyBinds->data;
 }
 
 template <class P>
 const BindRecord *BindInfo<P>::getLazyBind(uint32_t offset) const {
-  if (lazyBinds.contains(offset)) {
-    return &lazyBinds.at(offset);
+  const auto &data = getLazyBinds();
+  auto it = std::lower_bound(
+      data.begin(), data.end(), offset,
+      [](const LazyBind &bind, uint32_t off) { return bind.offset < off; });
+  if (it != data.end() && it->offset == offset) {
+    return &it->record;
   } else {
     return nullptr;
   }
@@ -232,5 +296,7 @@ template <class P> bool BindInfo<P>::hasLazyBinds() const {
   return _hasLazyBinds;
 }
 
+template class DyldExtractor::Provider::BindStream<Utils::Arch::Pointer32>;
+template class DyldExtractor::Provider::BindStream<Utils::Arch::Pointer64>;
 template class DyldExtractor::Provider::BindInfo<Utils::Arch::Pointer32>;
 template class DyldExtractor::Provider::BindInfo<Utils::Arch::Pointer64>;
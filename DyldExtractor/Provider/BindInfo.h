@@ -3,7 +3,8 @@
 
 #include "ActivityLogger.h"
 #include <Macho/MachoContext.h>
-#include <map>
+#include <memory>
+#include <mutex>
 
 namespace DyldExtractor::Provider {
 
@@ -20,24 +21,125 @@ struct BindRecord {
     libOrdinal(libOrd), symbolName(symName), addend(add) {}
 };
 
+/// @brief A lazily decoded bind opcode stream.
+///
+/// Records are decoded as the stream is iterated, nothing is stored.
+template <class P> class BindStream {
+public:
+    struct Entry {
+        /// The offset of the record's opcodes from the start of the stream,
+        /// which only makes sense for lazy bind info.
+        uint32_t offset = 0;
+        BindRecord record;
+    };
+    
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Entry;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Entry *;
+        using reference = const Entry &;
+        
+        Iterator() = default;
+        
+        const Entry &operator*() const { return current; }
+        const Entry *operator->() const { return &current; }
+        Iterator &operator++();
+        Iterator operator++(int);
+        bool operator==(const Iterator &other) const {
+            return p == other.p && repeatLeft == other.repeatLeft;
+        }
+        
+    private:
+        friend class BindStream;
+        Iterator(const BindStream *stream, const uint8_t *p);
+        
+        /// @brief Read opcodes until the next bind, or the end.
+        void advance();
+        
+        const BindStream *stream = nullptr;
+        const uint8_t *p = nullptr;
+        const uint8_t *recordStart = nullptr;
+        
+        uint8_t segIndex = 0;
+        uint64_t segOffset = 0;
+        // Added to the offset before reading the next bind
+        uint64_t pendingAdvance = 0;
+        // Remaining binds from a BIND_OPCODE_DO_BIND_ULEB_TIMES_SKIPPING_ULEB
+        uint64_t repeatLeft = 0;
+        uint64_t repeatSkip = 0;
+        
+        Entry current;
+    };
+    
+    BindStream() = default;
+    
+    /// @param mCtx The macho context, used to get segment addresses.
+    /// @param start The start of the opcodes.
+    /// @param end The end of the opcodes.
+    /// @param stopAtDone Stop at the first BIND_OPCODE_DONE, lazy bind info
+    ///   uses it to seperate records instead.
+    BindStream(const Macho::Context<false, P> &mCtx, const uint8_t *start,
+               const uint8_t *end, bool stopAtDone);
+    
+    Iterator begin() const;
+    Iterator end() const;
+    bool empty() const { return start == _end; }
+    
+private:
+    const Macho::Context<false, P> *mCtx = nullptr;
+    const uint8_t *start = nullptr;
+    const uint8_t *_end = nullptr;
+    bool stopAtDone = true;
+};
+
 template <class P> class BindInfo {
 public:
+    /// A lazy bind record, and its offset in the lazy bind info.
+    struct LazyBind {
+        uint32_t offset;
+        BindRecord record;
+    };
+    
     BindInfo(const Macho::Context<false, P> &mCtx,
              Provider::ActivityLogger &activity);
     BindInfo(const BindInfo &) = delete;
     BindInfo &operator=(const BindInfo &) = delete;
     
-    /// @brief Read and load all binds
+    /// @brief Forget the decoded binds and use another image. References to
+    ///   records of the previous image are invalidated.
+    /// @param mCtx The new macho context.
+    /// @param activity The new activity logger.
+    void reset(const Macho::Context<false, P> &mCtx,
+               Provider::ActivityLogger &activity);
+    
+    /// @brief Find the bind opcode streams.
+    ///
+    /// Streams are only decoded when they are first used. If the streams have
+    /// moved since the last load, like after the linkedit is optimized, they
+    /// are found again and decoded again on their next use. Records that were
+    /// already returned stay valid until reset.
     void load();
     
-    /// @brief Get all regular bind records.
+    /// @brief Iterate regular binds without storing them.
+    BindStream<P> getBindStream() const;
+    
+    /// @brief Iterate weak binds without storing them.
+    BindStream<P> getWeakBindStream() const;
+    
+    /// @brief Iterate lazy binds without storing them.
+    BindStream<P> getLazyBindStream() const;
+    
+    /// @brief Get all regular bind records, decoded on first use.
     const std::vector<BindRecord> &getBinds() const;
     
-    /// @brief Get all weak bind records.
+    /// @brief Get all weak bind records, decoded on first use.
     const std::vector<BindRecord> &getWeakBinds() const;
     
-    /// @brief Get all lazy bind records.
-    const std::map<uint32_t, BindRecord> &getLazyBinds() const;
+    /// @brief Get the first bind of each lazy bind record, sorted by offset.
+    ///   Decoded on first use.
+    const std::vector<LazyBind> &getLazyBinds() const;
     
     /// @brief Get a lazy bind record.
     /// @param offset The offset to the bind record.
@@ -47,15 +149,26 @@ public:
     bool hasLazyBinds() const;
     
 private:
+    template <class T> struct Decoded {
+        const uint8_t *start = nullptr;
+        const uint8_t *end = nullptr;
+        std::once_flag once;
+        T data;
+    };
+    
+    template <class T>
+    void locate(std::unique_ptr<Decoded<T>> &decoded, const uint8_t *start,
+                uint32_t size);
+    
     const Macho::Context<false, P> *mCtx;
     Provider::ActivityLogger *activity;
     
-    std::vector<BindRecord> binds;
-    std::vector<BindRecord> weakBinds;
-    std::map<uint32_t, BindRecord> lazyBinds;
-    bool _hasLazyBinds;
-    
-    bool dataLoaded = false;
+    std::unique_ptr<Decoded<std::vector<BindRecord>>> binds;
+    std::unique_ptr<Decoded<std::vector<BindRecord>>> weakBinds;
+    std::unique_ptr<Decoded<std::vector<LazyBind>>> lazyBinds;
+    /// Records replaced by load, kept for references that were handed out.
+    std::vector<std::shared_ptr<const void>> retired;
+    bool _hasLazyBinds = false;
 };
 
 } // namespace DyldExtractor::Provider
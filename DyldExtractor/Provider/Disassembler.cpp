@@ -1,7 +1,14 @@
 #include "Disassembler.h"
 
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <Utils/Threading.h>
 #include <Utils/Utils.h>
 
+/// Minimum number of functions that a disassembly thread handles
+#define DISASM_MIN_FUNCS_PER_THREAD 512
+
 using namespace DyldExtractor;
 using namespace Provider;
 
@@ -11,8 +18,18 @@ Disassembler<A>::Instruction::Instruction(PtrT addr, uint8_t size)
 
 template <class A>
 Disassembler<A>::Instruction::Instruction(cs_insn *raw)
-    : address((PtrT)raw->address), id(raw->id), size((uint8_t)raw->size),
-      opStr(raw->op_str) {}
+    : address((PtrT)raw->address), id(raw->id), size((uint8_t)raw->size) {
+  // Keep single immediate operands like "#0x1234"
+  const char *opStr = raw->op_str;
+  if (opStr[0] == '#' && strchr(opStr, ',') == nullptr) {
+    char *end;
+    auto value = strtoull(opStr + 1, &end, 16);
+    if (end != opStr + 1 && *end == '\0') {
+      immediate = (PtrT)value;
+      hasImmediate = true;
+    }
+  }
+}
 
 template <class A>
 Disassembler<A>::Disassembler(const Macho::Context<false, P> &mCtx,
@@ -21,27 +38,18 @@ Disassembler<A>::Disassembler(const Macho::Context<false, P> &mCtx,
                               Provider::FunctionTracker<P> &funcTracker)
     : mCtx(&mCtx), activity(&activity), logger(logger),
       funcTracker(&funcTracker) {
-  // Create Capstone engine
-  cs_err err;
-  if constexpr (std::is_same_v<A, Utils::Arch::x86_64>) {
-    // x86_64 not supported but allow construction
-    return;
-  } else if constexpr (std::is_same_v<A, Utils::Arch::arm>) {
-    err = cs_open(CS_ARCH_ARM, CS_MODE_THUMB, &handle);
-  } else if constexpr (std::is_same_v<A, Utils::Arch::arm64> ||
-                       std::is_same_v<A, Utils::Arch::arm64_32>) {
-    err = cs_open(CS_ARCH_ARM64, CS_MODE_ARM, &handle);
-  } else {
-    Utils::unreachable();
+  // x86_64 not supported but allow construction
+  if constexpr (!std::is_same_v<A, Utils::Arch::x86_64>) {
+    handle = borrowHandle();
   }
+}
 
-  if (err != CS_ERR_OK) {
-    throw std::runtime_error("Unable to open Capstone engine.");
+template <class A> Disassembler<A>::~Disassembler() {
+  if (handle) {
+    returnHandle(handle);
   }
 }
 
-template <class A> Disassembler<A>::~Disassembler() { cs_close(&handle); }
-
 template <class A>
 Disassembler<A>::Disassembler(Disassembler<A> &&o)
     : mCtx(o.mCtx), activity(o.activity), logger(std::move(o.logger)),
@@ -67,6 +75,9 @@ Disassembler<A> &Disassembler<A>::operator=(Disassembler<A> &&o) {
   this->textData = o.textData;
   this->textAddr = o.textAddr;
   this->disassembled = o.disassembled;
+  if (this->handle) {
+    returnHandle(this->handle);
+  }
   this->handle = o.handle;
 
   o.mCtx = nullptr;
@@ -79,7 +90,21 @@ Disassembler<A> &Disassembler<A>::operator=(Disassembler<A> &&o) {
   return *this;
 }
 
-template <class A> void Disassembler<A>::load() {
+template <class A>
+void Disassembler<A>::reset(const Macho::Context<false, P> &mCtx,
+                            Provider::ActivityLogger &activity,
+                            std::shared_ptr<spdlog::logger> logger) {
+  this->mCtx = &mCtx;
+  this->activity = &activity;
+  this->logger = logger;
+  instructions.clear();
+  dataInCodeEntries.clear();
+  textData = nullptr;
+  textAddr = 0;
+  disassembled = false;
+}
+
+template <class A> void Disassembler<A>::load(unsigned int threads) {
   if constexpr (std::is_same_v<A, Utils::Arch::x86_64>) {
     throw std::runtime_error("X86_64 disassembly not supported.");
   }
@@ -117,10 +142,48 @@ template <class A> void Disassembler<A>::load() {
     }
   }
 
-  // Process all functions
+  // Process all functions, each chunk of functions is disassembled into its
+  // own cache and concatenated in order, so the result matches a serial run.
   funcTracker->load();
-  for (const auto &func : funcTracker->getFunctions()) {
-    disasmFunc((uint32_t)(func.address - textAddr), (uint32_t)func.size);
+  const auto &funcs = funcTracker->getFunctions();
+  const auto chunks =
+      Utils::chunkCount(threads, funcs.size(), DISASM_MIN_FUNCS_PER_THREAD);
+  std::vector<InstructionCacheT> chunkInstructions(chunks);
+  Utils::parallelChunks(
+      chunks, funcs.size(), [&](std::size_t chunkI, std::size_t begin,
+                                std::size_t end) {
+        // The first chunk uses the main handle
+        csh chunkHandle = chunkI == 0 ? handle : borrowHandle();
+        auto &out = chunkInstructions[chunkI];
+        try {
+          for (auto i = begin; i < end; i++) {
+            const auto &func = funcs[i];
+            disasmFunc(chunkHandle, out, (uint32_t)(func.address - textAddr),
+                       (uint32_t)func.size);
+          }
+        } catch (...) {
+          if (chunkI != 0) {
+            returnHandle(chunkHandle);
+          }
+          throw;
+        }
+        if (chunkI != 0) {
+          returnHandle(chunkHandle);
+        }
+      });
+
+  if (chunks == 1) {
+    instructions = std::move(chunkInstructions[0]);
+  } else {
+    std::size_t total = 0;
+    for (const auto &chunk : chunkInstructions) {
+      total += chunk.size();
+    }
+    instructions.reserve(total);
+    for (auto &chunk : chunkInstructions) {
+      std::move(chunk.begin(), chunk.end(), std::back_inserter(instructions));
+      InstructionCacheT().swap(chunk);
+    }
   }
 }
 
@@ -168,8 +231,63 @@ Disassembler<A>::ConstInstructionIt Disassembler<A>::instructionsEnd() const {
   return instructions.cend();
 }
 
+template <class A> csh Disassembler<A>::openHandle() {
+  csh newHandle = 0;
+  cs_err err;
+  if constexpr (std::is_same_v<A, Utils::Arch::arm>) {
+    err = cs_open(CS_ARCH_ARM, CS_MODE_THUMB, &newHandle);
+  } else if constexpr (std::is_same_v<A, Utils::Arch::arm64> ||
+                       std::is_same_v<A, Utils::Arch::arm64_32>) {
+    err = cs_open(CS_ARCH_ARM64, CS_MODE_ARM, &newHandle);
+  } else {
+    Utils::unreachable();
+  }
+
+  if (err != CS_ERR_OK) {
+    throw std::runtime_error("Unable to open Capstone engine.");
+  }
+  return newHandle;
+}
+
+/// Idle capstone handles of an architecture, closed at exit.
+struct HandlePool {
+  std::mutex mutex;
+  std::vector<csh> handles;
+
+  ~HandlePool() {
+    for (auto &handle : handles) {
+      cs_close(&handle);
+    }
+  }
+};
+
+template <class A> static HandlePool &getHandlePool() {
+  static HandlePool pool;
+  return pool;
+}
+
+template <class A> csh Disassembler<A>::borrowHandle() {
+  auto &pool = getHandlePool<A>();
+  {
+    std::scoped_lock lock(pool.mutex);
+    if (!pool.handles.empty()) {
+      const auto handle = pool.handles.back();
+      pool.handles.pop_back();
+      return handle;
+    }
+  }
+  return openHandle();
+}
+
+template <class A> void Disassembler<A>::returnHandle(csh handle) {
+  auto &pool = getHandlePool<A>();
+  std::scoped_lock lock(pool.mutex);
+  pool.handles.push_back(handle);
+}
+
 template <class A>
-void Disassembler<A>::disasmFunc(uint32_t offset, uint32_t size) {
+void Disassembler<A>::disasmFunc(csh handle, InstructionCacheT &out,
+                                 uint32_t offset, uint32_t size) const {
   // Find data in code entries in the function
   auto dataInCodeBegin = dataInCodeEntries.lower_bound({offset, 0, 0});
   auto dataInCodeEnd = dataInCodeEntries.lower_bound({offset + size, 0, 0});
@@ -177,19 +295,20 @@ void Disassembler<A>::disasmFunc(uint32_t offset, uint32_t size) {
   uint32_t currOff = offset;
   for (auto it = dataInCodeBegin; it != dataInCodeEnd; it++) {
     uint32_t chunkSize = it->offset - currOff;
-    disasmChunk(currOff, chunkSize);
+    disasmChunk(handle, out, currOff, chunkSize);
 
     // Add invalid instruction for data in code
-    instructions.emplace_back(textAddr + it->offset, (uint8_t)it->length);
+    out.emplace_back(textAddr + it->offset, (uint8_t)it->length);
     currOff += chunkSize + it->length;
   }
 
   // Disassemble to the end of the function
-  disasmChunk(currOff, size - (currOff - offset));
+  disasmChunk(handle, out, currOff, size - (currOff - offset));
 }
 
 template <class A>
-void Disassembler<A>::disasmChunk(uint32_t offset, uint32_t size) {
+void Disassembler<A>::disasmChunk(csh handle, InstructionCacheT &out,
+                                  uint32_t offset, uint32_t size) const {
   uint32_t currOff = offset;
   while (currOff < offset + size) {
     cs_insn *rawInsn;
@@ -198,12 +317,12 @@ void Disassembler<A>::disasmChunk(uint32_t offset, uint32_t size) {
                   textAddr + currOff, 0, &rawInsn);
     if (count == 0) {
       // Recover and try again
-      currOff += recover(currOff);
+      currOff += recover(out, currOff);
       continue;
     }
 
     for (int i = 0; i < count; i++) {
-      instructions.emplace_back(rawInsn + i);
+      out.emplace_back(rawInsn + i);
       currOff += (rawInsn + i)->size;
     }
 
@@ -211,13 +330,15 @@ void Disassembler<A>::disasmChunk(uint32_t offset, uint32_t size) {
   }
 }
 
-template <class A> uint32_t Disassembler<A>::recover(uint32_t offset) {
+template <class A>
+uint32_t Disassembler<A>::recover(InstructionCacheT &out,
+                                  uint32_t offset) const {
   if constexpr (std::is_same_v<A, Utils::Arch::arm>) {
-    instructions.emplace_back(textAddr + offset, 2);
+    out.emplace_back(textAddr + offset, 2);
     return 2;
   } else if constexpr (std::is_same_v<A, Utils::Arch::arm64> ||
                        std::is_same_v<A, Utils::Arch::arm64_32>) {
-    instructions.emplace_back(textAddr + offset, 4);
+    out.emplace_back(textAddr + offset, 4);
     return 4;
   } else {
     Utils::unreachable();
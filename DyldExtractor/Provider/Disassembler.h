@@ -17,12 +17,18 @@ template <class A> class Disassembler {
   using PtrT = P::PtrT;
 
 public:
+  /// @brief A decoded instruction.
+  ///
+  /// Only the parts used by the fixers are kept, so the record has a fixed
+  /// size and the cache doesn't allocate per instruction.
   struct Instruction {
     PtrT address;
+    /// If the only operand is an immediate, its value
+    PtrT immediate = 0;
     unsigned int id;
     uint8_t size;
-
-    std::string opStr;
+    /// If the only operand is an immediate
+    bool hasImmediate = false;
 
     /// @brief Create an invalid instruction
     Instruction(PtrT addr, uint8_t size);
@@ -42,25 +48,58 @@ public:
   Disassembler &operator=(const Disassembler &) = delete;
   Disassembler &operator=(Disassembler &&o);
 
-  void load();
+  /// @brief Forget the instructions and use another image.
+  ///
+  /// The capstone handle and the instruction cache's space are kept.
+  ///
+  /// @param mCtx The new macho context.
+  /// @param activity The new activity logger.
+  /// @param logger The new logger.
+  void reset(const Macho::Context<false, P> &mCtx,
+             Provider::ActivityLogger &activity,
+             std::shared_ptr<spdlog::logger> logger);
+
+  /// @brief Disassemble all functions.
+  /// @param threads The maximum number of threads to disassemble with, each
+  ///   thread uses its own capstone handle.
+  void load(unsigned int threads = 1);
   ConstInstructionIt instructionAtAddr(PtrT addr) const;
   ConstInstructionIt instructionsBegin() const;
   ConstInstructionIt instructionsEnd() const;
 
 private:
+  /// @brief Open a capstone handle for the architecture
+  static csh openHandle();
+
+  /// @brief Get an idle capstone handle, or open one if there are none.
+  ///
+  /// Handles are shared by all disassemblers of the architecture, so
+  /// disassembling another image doesn't open new handles.
+  static csh borrowHandle();
+
+  /// @brief Give a handle from borrowHandle back to be reused.
+  static void returnHandle(csh handle);
+
   /// @brief Disassemble an entire function
+  /// @param handle The capstone handle to use
+  /// @param out Where to add instructions
   /// @param offset Byte offset from the text seg
   /// @param size Size of function
-  void disasmFunc(uint32_t offset, uint32_t size);
+  void disasmFunc(csh handle, InstructionCacheT &out, uint32_t offset,
+                  uint32_t size) const;
 
   /// @brief Disassemble part of a function
+  /// @param handle The capstone handle to use
+  /// @param out Where to add instructions
   /// @param offset Byte offset from the text seg
   /// @param size Size of chunk
-  void disasmChunk(uint32_t offset, uint32_t size);
+  void disasmChunk(csh handle, InstructionCacheT &out, uint32_t offset,
+                   uint32_t size) const;
 
   /// @brief Recover from failed disassembly
+  /// @param out Where to add the invalid instruction
   /// @return The size of the recovered instruction
-  uint32_t recover(uint32_t offset);
+  uint32_t recover(InstructionCacheT &out, uint32_t offset) const;
 
   const Macho::Context<false, P> *mCtx;
   Provider::ActivityLogger *activity;
@@ -71,7 +110,7 @@ private:
   uint8_t *textData = nullptr; // text segment data
   PtrT textAddr = 0;           // text segment address
   bool disassembled = false;
-  csh handle;
+  csh handle = 0;
 
   static inline auto dataInCodeComp = [](const auto &rhs, const auto &lhs) {
     return rhs.offset < lhs.offset;
@@ -1,29 +1,68 @@
 #include "ExtraData.h"
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
 using namespace DyldExtractor;
 using namespace Provider;
 
 template <class P>
 ExtraData<P>::ExtraData(std::string extendsSeg, ExtraData<P>::PtrT addr,
                         PtrT size)
-    : extendsSeg(extendsSeg), baseAddr(addr), store(size) {}
+    : extendsSeg(extendsSeg), baseAddr(addr), size(size),
+      store(allocate(size)) {}
 
 template <class P> ExtraData<P>::PtrT ExtraData<P>::getBaseAddr() const {
   return baseAddr;
 }
 
 template <class P> ExtraData<P>::PtrT ExtraData<P>::getEndAddr() const {
-  return baseAddr + (PtrT)store.size();
+  return baseAddr + size;
 }
 
-template <class P> uint8_t *ExtraData<P>::getData() { return store.data(); }
+template <class P> uint8_t *ExtraData<P>::getData() { return store.get(); }
 template <class P> const uint8_t *ExtraData<P>::getData() const {
-  return store.data();
+  return store.get();
 }
 
 template <class P> const std::string &ExtraData<P>::getExtendsSeg() const {
   return extendsSeg;
 }
 
+template <class P>
+void ExtraData<P>::StoreDeleter::operator()(uint8_t *data) const {
+#ifndef _WIN32
+  if (mappedSize) {
+    munmap(data, mappedSize);
+    return;
+  }
+#endif
+  delete[] data;
+}
+
+template <class P>
+std::unique_ptr<uint8_t[], typename ExtraData<P>::StoreDeleter>
+ExtraData<P>::allocate(std::size_t size) {
+#ifndef _WIN32
+  // Anonymous pages are zero filled when first touched, instead of all of
+  // them being written by value initialization.
+  if (size) {
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_NORESERVE
+    flags |= MAP_NORESERVE;
+#endif
+    if (auto region = mmap(nullptr, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+        region != MAP_FAILED) {
+      return std::unique_ptr<uint8_t[], StoreDeleter>((uint8_t *)region,
+                                                      StoreDeleter{size});
+    }
+  }
+#endif
+
+  return std::unique_ptr<uint8_t[], StoreDeleter>(new uint8_t[size](),
+                                                  StoreDeleter{});
+}
+
 template class DyldExtractor::Provider::ExtraData<Utils::Arch::Pointer32>;
 template class DyldExtractor::Provider::ExtraData<Utils::Arch::Pointer64>;
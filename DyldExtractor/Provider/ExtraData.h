@@ -3,13 +3,17 @@
 
 #include <Macho/Loader.h>
 #include <Utils/Architectures.h>
+#include <memory>
 #include <string>
-#include <vector>
 
 namespace DyldExtractor::Provider {
 
 /// @brief Contains in memory data that is added to the image. Extends a
-///   segment.
+///   segment. The data is allocated once, zero filled, and never resized.
+///
+/// The data is an anonymous mapping where supported, so pages are only
+/// committed when they are written and untouched pages stay shared zero
+/// pages. Output writers reference the data in place.
 template <class P> class ExtraData {
   using PtrT = P::PtrT;
 
@@ -35,7 +39,16 @@ public:
 private:
   std::string extendsSeg;
   PtrT baseAddr;
-  std::vector<uint8_t> store;
+  PtrT size;
+
+  /// Frees the store, unmapping it when it was mapped.
+  struct StoreDeleter {
+    std::size_t mappedSize = 0;
+    void operator()(uint8_t *data) const;
+  };
+  std::unique_ptr<uint8_t[], StoreDeleter> store;
+
+  static std::unique_ptr<uint8_t[], StoreDeleter> allocate(std::size_t size);
 };
 
 } // namespace DyldExtractor::Provider
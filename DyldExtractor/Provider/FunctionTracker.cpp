@@ -10,6 +10,15 @@ FunctionTracker<P>::FunctionTracker(const Macho::Context<false, P> &mCtx,
                                     std::shared_ptr<spdlog::logger> logger)
     : mCtx(&mCtx), logger(logger) {}
 
+template <class P>
+void FunctionTracker<P>::reset(const Macho::Context<false, P> &mCtx,
+                               std::shared_ptr<spdlog::logger> logger) {
+  this->mCtx = &mCtx;
+  this->logger = logger;
+  loaded = false;
+  functions.clear();
+}
+
 template <class P> void FunctionTracker<P>::load() {
   if (loaded) {
     return;
@@ -30,8 +39,12 @@ template <class P> void FunctionTracker<P>::load() {
     return;
   }
 
-  while (*p) {
-    PtrT next = (PtrT)Utils::readUleb128(p, end);
+  std::vector<uint64_t> deltas;
+  deltas.reserve(end - p);
+  Utils::readUleb128Stream(p, end, deltas);
+  functions.reserve(deltas.size() + 1);
+  for (const auto delta : deltas) {
+    PtrT next = (PtrT)delta;
     functions.emplace_back(funcAddr, next);
     funcAddr += next;
   }
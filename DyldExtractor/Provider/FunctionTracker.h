@@ -26,6 +26,12 @@ public:
   FunctionTracker &operator=(const FunctionTracker &) = delete;
   FunctionTracker &operator=(FunctionTracker &&o) = default;
 
+  /// @brief Forget the functions and use another image.
+  /// @param mCtx The new macho context.
+  /// @param logger The new logger.
+  void reset(const Macho::Context<false, P> &mCtx,
+             std::shared_ptr<spdlog::logger> logger);
+
   void load();
   const std::vector<Function> &getFunctions() const;
 
@@ -0,0 +1,99 @@
+#include "ImageManifest.h"
+
+#include <algorithm>
+#include <fmt/format.h>
+#include <Utils/Hash.h>
+#include <fstream>
+#include <vector>
+
+using namespace DyldExtractor;
+using namespace Provider;
+
+bool ImageManifest::matches(const std::string &image,
+                            uint64_t hash) const {
+  std::scoped_lock lock(imagesMutex);
+  auto it = images.find(image);
+  return it != images.end() && it->second == hash;
+}
+
+void ImageManifest::record(const std::string &image, uint64_t hash) {
+  std::scoped_lock lock(imagesMutex);
+  images[image] = hash;
+}
+
+void ImageManifest::remove(const std::string &image) {
+  std::scoped_lock lock(imagesMutex);
+  images.erase(image);
+}
+
+std::size_t ImageManifest::size() const {
+  std::scoped_lock lock(imagesMutex);
+  return images.size();
+}
+
+bool ImageManifest::load(const std::filesystem::path &path) {
+  std::ifstream file(path);
+  if (!file.good()) {
+    return false;
+  }
+
+  // One image per line, the hash in hex then a tab and the image path.
+  std::scoped_lock lock(imagesMutex);
+  std::string line;
+  while (std::getline(file, line)) {
+    const auto tab = line.find('\t');
+    if (tab == std::string::npos || tab == 0 || tab > 16 ||
+        line.find_first_not_of("0123456789abcdefABCDEF") != tab) {
+      continue;
+    }
+    images[line.substr(tab + 1)] =
+        std::stoull(line.substr(0, tab), nullptr, 16);
+  }
+  return true;
+}
+
+bool ImageManifest::save(const std::filesystem::path &path) const {
+  std::vector<std::pair<std::string, uint64_t>> sorted;
+  {
+    std::scoped_lock lock(imagesMutex);
+    sorted.assign(images.begin(), images.end());
+  }
+  std::sort(sorted.begin(), sorted.end());
+
+  std::ofstream file(path);
+  if (!file.good()) {
+    return false;
+  }
+  for (const auto &[image, hash] : sorted) {
+    file << fmt::format("{:016x}\t{}\n", hash, image);
+  }
+  return file.good();
+}
+
+template <class P>
+uint64_t ImageManifest::fingerprint(const Dyld::Context &dCtx,
+                                    const Macho::Context<false, P> &mCtx,
+                                    std::string_view configuration) {
+  Utils::Hasher64 hasher;
+  hasher.update(configuration.data(), configuration.size());
+  hasher.update(dCtx.header->uuid, sizeof(dCtx.header->uuid));
+  hasher.update(mCtx.header, sizeof(*mCtx.header) + mCtx.header->sizeofcmds);
+
+  for (const auto &seg : mCtx.segments) {
+    if (memcmp(seg.command->segname, SEG_LINKEDIT, sizeof(SEG_LINKEDIT)) ==
+        0) {
+      continue;
+    }
+    if (auto data = mCtx.convertAddrP(seg.command->vmaddr); data) {
+      hasher.update(data, seg.command->filesize);
+    }
+  }
+  return hasher.digest();
+}
+
+template uint64_t ImageManifest::fingerprint<Utils::Arch::Pointer32>(
+    const Dyld::Context &, const Macho::Context<false, Utils::Arch::Pointer32> &,
+    std::string_view);
+template uint64_t ImageManifest::fingerprint<Utils::Arch::Pointer64>(
+    const Dyld::Context &, const Macho::Context<false, Utils::Arch::Pointer64> &,
+    std::string_view);
@@ -0,0 +1,65 @@
+#ifndef __PROVIDER_IMAGEMANIFEST__
+#define __PROVIDER_IMAGEMANIFEST__
+
+#include <Dyld/DyldContext.h>
+#include <Macho/MachoContext.h>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace DyldExtractor::Provider {
+
+/// @brief Records the images that were extracted, so they can be skipped in
+/// later runs.
+///
+/// Each image is recorded with the fingerprint of its input. An image is only
+/// skipped if its fingerprint matches the recorded one. Lookups and records
+/// can be done from multiple threads.
+class ImageManifest {
+public:
+  /// @brief Check if an image was completed with the same input.
+  /// @param image The path of the image in the cache.
+  /// @param hash The current hash of the image.
+  bool matches(const std::string &image, uint64_t hash) const;
+
+  /// @brief Record that an image was completed.
+  void record(const std::string &image, uint64_t hash);
+
+  /// @brief Remove an image, like when it failed.
+  void remove(const std::string &image);
+
+  std::size_t size() const;
+
+  /// @brief Add the images from a manifest file.
+  /// @returns If the file existed and was read.
+  bool load(const std::filesystem::path &path);
+
+  /// @brief Write the manifest, replacing the existing file.
+  /// @returns If the file was written.
+  bool save(const std::filesystem::path &path) const;
+
+  /// @brief Fingerprint the input of an image for extraction.
+  ///
+  /// Covers the UUID of the cache, which identifies its slide info and
+  /// linkedit, the header and load commands, and the data of every segment
+  /// except the shared linkedit.
+  ///
+  /// @param configuration Anything else that changes the output, like the
+  ///   version of the tool and the enabled modules.
+  template <class P>
+  static uint64_t fingerprint(const Dyld::Context &dCtx,
+                              const Macho::Context<false, P> &mCtx,
+                              std::string_view configuration);
+
+private:
+  mutable std::mutex imagesMutex;
+  std::unordered_map<std::string, uint64_t> images;
+};
+
+} // namespace DyldExtractor::Provider
+
+#endif // __PROVIDER_IMAGEMANIFEST__
@@ -0,0 +1,107 @@
+#include "ImageScheduler.h"
+
+#include <Utils/Architectures.h>
+#include <numeric>
+
+using namespace DyldExtractor;
+using namespace Provider;
+
+template <class P>
+ImageScheduler<P>::ImageScheduler(const Dyld::Context &dCtx,
+                                  Accelerator<P> &accelerator)
+    : dCtx(dCtx), accelerator(accelerator) {
+  std::call_once(accelerator.pathToImageOnce, [this]() {
+    for (auto image : this->dCtx.images) {
+      std::string path((char *)(this->dCtx.file + image->pathFileOffset));
+      this->accelerator.pathToImage[path] = image;
+    }
+  });
+
+  for (uint32_t i = 0; i < dCtx.images.size(); i++) {
+    imageIndices.emplace(dCtx.images[i], i);
+  }
+}
+
+template <class P>
+std::vector<uint32_t>
+ImageScheduler<P>::assign(const std::vector<uint32_t> &images,
+                          const std::vector<uint64_t> &costs,
+                          unsigned int workers) const {
+  workers = std::max(workers, 1u);
+  std::vector<uint32_t> assigned(images.size(), 0);
+  if (workers == 1) {
+    return assigned;
+  }
+
+  // Allow a worker a little over an even share, so that it can take an image
+  // that it has the dependencies of.
+  const uint64_t totalCost =
+      std::accumulate(costs.begin(), costs.end(), (uint64_t)0);
+  const uint64_t share = totalCost / workers + totalCost / workers / 10 + 1;
+
+  std::vector<uint64_t> loads(workers, 0);
+  // The images each worker has read, indexed by worker then image
+  std::vector<std::vector<bool>> seen(
+      workers, std::vector<bool>(dCtx.images.size(), false));
+  for (std::size_t i = 0; i < images.size(); i++) {
+    const auto dependencies = getDependencies(images[i]);
+
+    uint32_t best = 0;
+    std::size_t bestShared = 0;
+    bool bestFits = false;
+    for (uint32_t w = 0; w < workers; w++) {
+      const bool fits = loads[w] + costs[i] <= share;
+      std::size_t shared = 0;
+      for (const auto dep : dependencies) {
+        shared += seen[w][dep];
+      }
+
+      // Prefer fitting, then more shared dependencies, then less load
+      if (w == 0 || (fits && !bestFits) ||
+          (fits == bestFits &&
+           (shared > bestShared ||
+            (shared == bestShared && loads[w] < loads[best])))) {
+        best = w;
+        bestShared = shared;
+        bestFits = fits;
+      }
+    }
+
+    // Without a fitting worker, balance the load instead
+    if (!bestFits) {
+      best = (uint32_t)std::distance(
+          loads.begin(), std::min_element(loads.begin(), loads.end()));
+    }
+
+    assigned[i] = best;
+    loads[best] += costs[i];
+    seen[best][images[i]] = true;
+    for (const auto dep : dependencies) {
+      seen[best][dep] = true;
+    }
+  }
+
+  return assigned;
+}
+
+template <class P>
+std::vector<uint32_t> ImageScheduler<P>::getDependencies(uint32_t image) const {
+  std::vector<uint32_t> dependencies;
+  auto mCtx = dCtx.createMachoCtx<true, P>(dCtx.images[image]);
+  for (const auto dylib :
+       mCtx.template getAllLCs<Macho::Loader::dylib_command>()) {
+    if (dylib->cmd == LC_ID_DYLIB) {
+      continue;
+    }
+
+    std::string dylibPath((const char *)dylib + dylib->dylib.name.offset);
+    if (auto it = accelerator.pathToImage.find(dylibPath);
+        it != accelerator.pathToImage.end()) {
+      dependencies.push_back(imageIndices.at(it->second));
+    }
+  }
+  return dependencies;
+}
+
+template class DyldExtractor::Provider::ImageScheduler<Utils::Arch::Pointer32>;
+template class DyldExtractor::Provider::ImageScheduler<Utils::Arch::Pointer64>;
@@ -0,0 +1,47 @@
+#ifndef __PROVIDER_IMAGESCHEDULER__
+#define __PROVIDER_IMAGESCHEDULER__
+
+#include <Dyld/DyldContext.h>
+#include <Provider/Accelerator.h>
+#include <map>
+#include <vector>
+
+namespace DyldExtractor::Provider {
+
+/// @brief Assigns images to workers by their dependencies.
+///
+/// A worker keeps the exports and stub chains of the dylibs it has read in
+/// its accelerator, so images that load the same dylibs are given to the
+/// same worker, which then reads those dylibs once.
+template <class P> class ImageScheduler {
+public:
+  ImageScheduler(const Dyld::Context &dCtx, Accelerator<P> &accelerator);
+
+  /// @brief Assign images to workers.
+  ///
+  /// Images are assigned in order, each to the worker that has already seen
+  /// the most of its dylib load commands, among the workers that would stay
+  /// near an even share of the total cost. Ties go to the least loaded
+  /// worker, so the first images are spread out.
+  ///
+  /// @param images The indices of the images, in the order they are handed
+  ///   out.
+  /// @param costs The estimated cost of each image.
+  /// @param workers The number of workers.
+  /// @returns The worker of each image.
+  std::vector<uint32_t> assign(const std::vector<uint32_t> &images,
+                               const std::vector<uint64_t> &costs,
+                               unsigned int workers) const;
+
+private:
+  const Dyld::Context &dCtx;
+  Accelerator<P> &accelerator;
+  std::map<const dyld_cache_image_info *, uint32_t> imageIndices;
+
+  /// @brief Get the images that an image loads.
+  std::vector<uint32_t> getDependencies(uint32_t image) const;
+};
+
+} // namespace DyldExtractor::Provider
+
+#endif // __PROVIDER_IMAGESCHEDULER__
@@ -0,0 +1,170 @@
+#include "ImageSelector.h"
+
+#include <Utils/Architectures.h>
+
+using namespace DyldExtractor;
+using namespace Provider;
+
+template <class P>
+ImageSelector<P>::ImageSelector(const Dyld::Context &dCtx,
+                                Accelerator<P> &accelerator)
+    : dCtx(dCtx), accelerator(accelerator) {}
+
+template <class P> void ImageSelector<P>::addGlob(std::string pattern) {
+  globs.push_back(std::move(pattern));
+}
+
+template <class P> void ImageSelector<P>::addRegex(const std::string &pattern) {
+  regexes.emplace_back(pattern, std::regex::ECMAScript | std::regex::optimize);
+}
+
+template <class P> bool ImageSelector<P>::empty() const {
+  return globs.empty() && regexes.empty();
+}
+
+template <class P>
+std::vector<uint32_t> ImageSelector<P>::select(bool withDependencies) const {
+  std::vector<bool> selected(dCtx.images.size(), empty());
+  auto getPath = [this](uint32_t i) {
+    return (const char *)(dCtx.file + dCtx.images[i]->pathFileOffset);
+  };
+
+  std::vector<uint32_t> pending;
+  if (!empty()) {
+    for (uint32_t i = 0; i < dCtx.images.size(); i++) {
+      const std::string_view path = getPath(i);
+      bool matched =
+          std::any_of(globs.begin(), globs.end(), [&](const auto &glob) {
+            return globMatch(glob, path);
+          });
+      matched = matched || std::any_of(regexes.begin(), regexes.end(),
+                                       [&](const auto &regex) {
+                                         return std::regex_search(
+                                             path.begin(), path.end(), regex);
+                                       });
+      if (matched) {
+        selected[i] = true;
+        pending.push_back(i);
+      }
+    }
+  }
+
+  if (withDependencies && !pending.empty()) {
+    std::call_once(accelerator.pathToImageOnce, [this]() {
+      for (auto image : dCtx.images) {
+        std::string path((char *)(dCtx.file + image->pathFileOffset));
+        accelerator.pathToImage[path] = image;
+      }
+    });
+
+    std::map<const dyld_cache_image_info *, uint32_t> imageIndices;
+    for (uint32_t i = 0; i < dCtx.images.size(); i++) {
+      imageIndices.emplace(dCtx.images[i], i);
+    }
+
+    // Follow the dylib load commands of every selected image
+    while (!pending.empty()) {
+      const auto i = pending.back();
+      pending.pop_back();
+
+      auto mCtx = dCtx.createMachoCtx<true, P>(dCtx.images[i]);
+      for (const auto dylib :
+           mCtx.template getAllLCs<Macho::Loader::dylib_command>()) {
+        if (dylib->cmd == LC_ID_DYLIB) {
+          continue;
+        }
+
+        std::string dylibPath((const char *)dylib + dylib->dylib.name.offset);
+        auto it = accelerator.pathToImage.find(dylibPath);
+        if (it == accelerator.pathToImage.end()) {
+          continue;
+        }
+        const auto depI = imageIndices.at(it->second);
+        if (!selected[depI]) {
+          selected[depI] = true;
+          pending.push_back(depI);
+        }
+      }
+    }
+  }
+
+  std::vector<uint32_t> indices;
+  for (uint32_t i = 0; i < selected.size(); i++) {
+    if (selected[i]) {
+      indices.push_back(i);
+    }
+  }
+  return indices;
+}
+
+template <class P>
+bool ImageSelector<P>::globMatch(std::string_view pattern,
+                                 std::string_view str) {
+  // Greedy matching, backtracking to the last star
+  std::size_t p = 0, s = 0;
+  std::size_t starP = std::string_view::npos, starS = 0;
+  while (s < str.size()) {
+    if (p < pattern.size() && pattern[p] == '*') {
+      starP = p++;
+      starS = s;
+      continue;
+    }
+
+    bool matched = false;
+    std::size_t nextP = p + 1;
+    if (p < pattern.size()) {
+      if (pattern[p] == '?') {
+        matched = true;
+      } else if (pattern[p] == '[') {
+        // Character set
+        std::size_t end = p + 1;
+        const bool negate =
+            end < pattern.size() && (pattern[end] == '!' || pattern[end] == '^');
+        if (negate) {
+          end++;
+        }
+        bool inSet = false;
+        for (bool first = true; end < pattern.size() &&
+                                (first || pattern[end] != ']');
+             first = false) {
+          if (end + 2 < pattern.size() && pattern[end + 1] == '-' &&
+              pattern[end + 2] != ']') {
+            inSet = inSet ||
+                    (str[s] >= pattern[end] && str[s] <= pattern[end + 2]);
+            end += 3;
+          } else {
+            inSet = inSet || str[s] == pattern[end];
+            end++;
+          }
+        }
+        if (end < pattern.size()) {
+          matched = inSet != negate;
+          nextP = end + 1;
+        } else {
+          // Unterminated, match it literally
+          matched = str[s] == '[';
+        }
+      } else {
+        matched = pattern[p] == str[s];
+      }
+    }
+
+    if (matched) {
+      p = nextP;
+      s++;
+    } else if (starP != std::string_view::npos) {
+      p = starP + 1;
+      s = ++starS;
+    } else {
+      return false;
+    }
+  }
+
+  while (p < pattern.size() && pattern[p] == '*') {
+    p++;
+  }
+  return p == pattern.size();
+}
+
+template class DyldExtractor::Provider::ImageSelector<Utils::Arch::Pointer32>;
+template class DyldExtractor::Provider::ImageSelector<Utils::Arch::Pointer64>;
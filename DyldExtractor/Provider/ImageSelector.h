@@ -0,0 +1,49 @@
+#ifndef __PROVIDER_IMAGESELECTOR__
+#define __PROVIDER_IMAGESELECTOR__
+
+#include <Dyld/DyldContext.h>
+#include <Provider/Accelerator.h>
+#include <regex>
+#include <string>
+#include <vector>
+
+namespace DyldExtractor::Provider {
+
+/// @brief Selects the images of a cache to process with path patterns, and
+/// optionally their dependencies.
+template <class P> class ImageSelector {
+public:
+  ImageSelector(const Dyld::Context &dCtx, Accelerator<P> &accelerator);
+
+  /// @brief Select images whose path matches a glob pattern.
+  ///
+  /// `*` matches any characters including `/`, `?` matches one character,
+  /// and `[...]` matches a set of characters, like `[a-z]` or `[!0-9]`.
+  void addGlob(std::string pattern);
+
+  /// @brief Select images whose path contains a match of a regex.
+  void addRegex(const std::string &pattern);
+
+  /// @brief If there are no patterns, which selects every image.
+  bool empty() const;
+
+  /// @brief Get the selected images.
+  /// @param withDependencies Also select the transitive dependencies of the
+  ///   matched images, from their dylib load commands.
+  /// @returns The indices of the images in the cache, in cache order.
+  std::vector<uint32_t> select(bool withDependencies) const;
+
+  /// @brief Match a glob pattern against the whole string.
+  static bool globMatch(std::string_view pattern, std::string_view str);
+
+private:
+  const Dyld::Context &dCtx;
+  Accelerator<P> &accelerator;
+
+  std::vector<std::string> globs;
+  std::vector<std::regex> regexes;
+};
+
+} // namespace DyldExtractor::Provider
+
+#endif // __PROVIDER_IMAGESELECTOR__
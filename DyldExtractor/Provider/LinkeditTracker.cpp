@@ -2,6 +2,8 @@
 
 #include <Utils/Utils.h>
 
+#include <algorithm>
+
 using namespace DyldExtractor;
 using namespace Provider;
 
@@ -172,11 +174,7 @@ LinkeditTracker<P>::addData(Metadata meta, const uint8_t *const data,
     throw std::invalid_argument(
         "Copy size must be less than or equal to the new data region size.");
   }
-  if ((uint8_t *)meta.offsetField < cmdsData ||
-      (uint8_t *)meta.offsetField + sizeof(uint32_t) > cmdsDataEnd) {
-    throw std::invalid_argument(
-        "Data offset field is outside the load command region.");
-  }
+  checkOffsetField(meta);
 
   // Get insert position
   auto pos = std::lower_bound(
@@ -244,6 +242,102 @@ template <class P> void LinkeditTracker<P>::removeData(MetadataIt pos) {
   metadata.erase(pos);
 }
 
+template <class P>
+typename LinkeditTracker<P>::Builder LinkeditTracker<P>::builder() {
+  return Builder(*this);
+}
+
+template <class P>
+LinkeditTracker<P>::Builder::Builder(LinkeditTracker<P> &tracker)
+    : tracker(&tracker) {}
+
+template <class P>
+void LinkeditTracker<P>::Builder::addData(Metadata meta,
+                                          const uint8_t *const data,
+                                          uint32_t copySize) {
+  // Validate
+  if (meta.dataSize % sizeof(PtrT)) {
+    throw std::invalid_argument(
+        "Data size for the new data region must be pointer aligned.");
+  }
+  if (copySize > meta.dataSize) {
+    throw std::invalid_argument(
+        "Copy size must be less than or equal to the new data region size.");
+  }
+  tracker->checkOffsetField(meta);
+
+  std::erase_if(added, [&meta](const Region &r) {
+    return r.meta.tag == meta.tag;
+  });
+  added.push_back({meta, data, copySize});
+}
+
+template <class P> void LinkeditTracker<P>::Builder::removeData(Tag tag) {
+  std::erase_if(added, [tag](const Region &r) { return r.meta.tag == tag; });
+  removed.push_back(tag);
+}
+
+template <class P> bool LinkeditTracker<P>::Builder::commit() {
+  auto &metadata = tracker->metadata;
+  const auto isReplaced = [this](Tag tag) {
+    return std::find(removed.begin(), removed.end(), tag) != removed.end() ||
+           std::any_of(added.begin(), added.end(),
+                       [tag](const Region &r) { return r.meta.tag == tag; });
+  };
+
+  // Plan the layout, kept data and new data ordered by tag
+  std::vector<Region> regions;
+  regions.reserve(metadata.size() + added.size());
+  for (const auto &meta : metadata) {
+    if (!isReplaced(meta.tag)) {
+      regions.push_back({meta, meta.data, meta.dataSize});
+    }
+  }
+  regions.insert(regions.end(), added.begin(), added.end());
+  std::stable_sort(regions.begin(), regions.end(),
+                   [](const Region &a, const Region &b) {
+                     return a.meta.tag < b.meta.tag;
+                   });
+
+  uint64_t newSize = 0;
+  for (const auto &region : regions) {
+    newSize += region.meta.dataSize;
+  }
+  if (tracker->leData + newSize > tracker->leDataEnd) {
+    return false;
+  }
+
+  // Sources can be in the linkedit, so write everything to a buffer first
+  std::vector<uint8_t> buffer(newSize, 0x0);
+  uint32_t offset = 0;
+  for (auto &region : regions) {
+    memcpy(buffer.data() + offset, region.source, region.copySize);
+    region.meta.data = tracker->leData + offset;
+    offset += region.meta.dataSize;
+  }
+
+  const uint64_t oldSize =
+      metadata.size() ? metadata.crbegin()->end() - tracker->leData : 0;
+  memcpy(tracker->leData, buffer.data(), newSize);
+  if (oldSize > newSize) {
+    memset(tracker->leData + newSize, 0, oldSize - newSize);
+  }
+
+  // Update tracked metadata and segment
+  metadata.clear();
+  for (auto &region : regions) {
+    *region.meta.offsetField =
+        (uint32_t)(tracker->leOffset + (region.meta.data - tracker->leData));
+    metadata.push_back(region.meta);
+  }
+  tracker->leSeg->vmsize += newSize - oldSize;
+  tracker->leSeg->filesize += newSize - oldSize;
+
+  added.clear();
+  removed.clear();
+  return true;
+}
+
 template <class P>
 std::pair<Macho::Loader::load_command *, bool>
 LinkeditTracker<P>::insertLC(Macho::Loader::load_command *pos,
@@ -343,6 +437,15 @@ template <class P> void LinkeditTracker<P>::changeOffset(uint32_t offset) {
   leSeg->fileoff = offset;
 }
 
+template <class P>
+void LinkeditTracker<P>::checkOffsetField(const Metadata &meta) const {
+  if ((uint8_t *)meta.offsetField < cmdsData ||
+      (uint8_t *)meta.offsetField + sizeof(uint32_t) > cmdsDataEnd) {
+    throw std::invalid_argument(
+        "Data offset field is outside the load command region.");
+  }
+}
+
 template <class P> uint32_t LinkeditTracker<P>::lcOffsetForTag(Tag tag) {
   switch (tag) {
   case Tag::rebase:
@@ -40,6 +40,43 @@ public:
 
   using MetadataIt = std::vector<Metadata>::iterator;
 
+  /// @brief Plans several edits to the linkedit and applies them at once.
+  ///
+  /// Each call to resizeData, addData, or removeData shifts everything after
+  /// the edited region. The builder instead collects the regions, computes
+  /// the final layout, and writes each region once. Load commands must not be
+  /// inserted or removed while edits are pending.
+  class Builder {
+  public:
+    Builder(LinkeditTracker<P> &tracker);
+
+    /// @brief Add data, replacing any tracked data with the same tag.
+    /// @param meta The metadata for the data, the data size must be pointer
+    ///   aligned. Data pointer and offset field does not have to be valid.
+    /// @param data Pointer to the source of data, must be valid until commit.
+    /// @param copySize The size of data to copy into the region. Must be less
+    ///   than or equal to size in data.
+    void addData(Metadata meta, const uint8_t *const data, uint32_t copySize);
+
+    /// @brief Remove tracked data, and any pending data with the same tag.
+    void removeData(Tag tag);
+
+    /// @brief Write the planned layout into the linkedit.
+    /// @returns If there was enough space, the linkedit is unchanged if not.
+    bool commit();
+
+  private:
+    struct Region {
+      Metadata meta;
+      const uint8_t *source;
+      uint32_t copySize;
+    };
+
+    LinkeditTracker<P> *tracker;
+    std::vector<Region> added;
+    std::vector<Tag> removed;
+  };
+
   /// @brief Create a tracker with a set of tracked data
   ///
   /// Throws an exception in any of the following cases.
@@ -91,6 +128,9 @@ public:
   /// @param pos The data to remove.
   void removeData(MetadataIt pos);
 
+  /// @brief Start planning a set of edits, see Builder.
+  Builder builder();
+
   /// @brief Insert a load command into the header, triggers a reload on the
   ///   MachOContext.
   /// @param pos The position of the new load command.
@@ -127,6 +167,7 @@ private:
   uint8_t *cmdsDataEnd; // pointer to the past the end load command
   uint64_t cmdsMaxSize; // Maximum space allowed for load commands
 
+  void checkOffsetField(const Metadata &meta) const;
   static uint32_t lcOffsetForTag(Tag tag);
 };
 
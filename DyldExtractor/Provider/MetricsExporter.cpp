@@ -0,0 +1,208 @@
+#include "MetricsExporter.h"
+
+#include <fmt/format.h>
+#include <fstream>
+
+#ifdef __APPLE__
+#include <mach/mach.h>
+#elif !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+using namespace DyldExtractor;
+using namespace Provider;
+
+MetricsExporter::MetricsExporter(std::filesystem::path _path,
+                                 std::chrono::milliseconds interval)
+    : path(std::move(_path)), prometheus(path.extension() == ".prom"),
+      startTime(std::chrono::steady_clock::now()) {
+  thread = std::thread([this, interval]() {
+    std::unique_lock lock(stopMutex);
+    while (!stopCondition.wait_for(lock, interval,
+                                   [this]() { return stopping; })) {
+      lock.unlock();
+      write();
+      lock.lock();
+    }
+  });
+}
+
+MetricsExporter::~MetricsExporter() {
+  {
+    std::scoped_lock lock(stopMutex);
+    stopping = true;
+  }
+  stopCondition.notify_all();
+  thread.join();
+
+  // Leave the final state
+  write();
+}
+
+void MetricsExporter::imageDone(bool failed) {
+  if (failed) {
+    imagesFailed++;
+  } else {
+    imagesCompleted++;
+  }
+}
+
+void MetricsExporter::recordStage(const std::string &stage, double seconds) {
+  std::size_t bucket = 0;
+  while (bucket < LATENCY_BUCKETS.size() && seconds > LATENCY_BUCKETS[bucket]) {
+    bucket++;
+  }
+
+  std::scoped_lock lock(stagesMutex);
+  auto &histogram = stages[stage];
+  histogram.counts[bucket]++;
+  histogram.count++;
+  histogram.sum += seconds;
+}
+
+void MetricsExporter::setQueueDepth(uint64_t depth, std::size_t queue) {
+  std::scoped_lock lock(queuesMutex);
+  queueDepths[queue] = depth;
+}
+
+uint64_t MetricsExporter::getQueueDepth() {
+  std::scoped_lock lock(queuesMutex);
+  uint64_t depth = 0;
+  for (const auto &[queue, queueDepth] : queueDepths) {
+    depth += queueDepth;
+  }
+  return depth;
+}
+
+bool MetricsExporter::write() {
+  std::map<std::string, Histogram> stagesCopy;
+  {
+    std::scoped_lock lock(stagesMutex);
+    stagesCopy = stages;
+  }
+
+  std::scoped_lock lock(writeMutex);
+  auto tempPath = path;
+  tempPath += ".tmp";
+  {
+    std::ofstream file(tempPath, std::ios_base::trunc);
+    if (!file.good()) {
+      return false;
+    }
+
+    if (prometheus) {
+      writePrometheus(file, stagesCopy);
+    } else {
+      writeJson(file, stagesCopy);
+    }
+    if (!file.good()) {
+      return false;
+    }
+  }
+
+  std::error_code ec;
+  std::filesystem::rename(tempPath, path, ec);
+  return !ec;
+}
+
+uint64_t MetricsExporter::residentSetSize() {
+#ifdef __APPLE__
+  mach_task_basic_info_data_t info;
+  mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+  if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info,
+                &count) != KERN_SUCCESS) {
+    return 0;
+  }
+  return info.resident_size;
+#elif !defined(_WIN32)
+  // The second field is the resident pages
+  std::ifstream statm("/proc/self/statm");
+  uint64_t size, resident;
+  if (!(statm >> size >> resident)) {
+    return 0;
+  }
+  return resident * (uint64_t)sysconf(_SC_PAGESIZE);
+#else
+  return 0;
+#endif
+}
+
+void MetricsExporter::writePrometheus(
+    std::ostream &stream, const std::map<std::string, Histogram> &stages) {
+  const std::chrono::duration<double> uptime =
+      std::chrono::steady_clock::now() - startTime;
+
+  auto metric = [&](const char *name, const char *type, const char *help,
+                    auto value) {
+    stream << fmt::format("# HELP {0} {1}\n# TYPE {0} {2}\n{0} {3}\n", name,
+                          help, type, value);
+  };
+  metric("dyldex_images", "gauge", "Images in the run.", totalImages.load());
+  metric("dyldex_images_completed_total", "counter",
+         "Images that were processed.", imagesCompleted.load());
+  metric("dyldex_images_failed_total", "counter", "Images that failed.",
+         imagesFailed.load());
+  metric("dyldex_bytes_written_total", "counter", "Bytes of output written.",
+         bytesWritten.load());
+  metric("dyldex_queue_depth", "gauge", "Images waiting to be processed.",
+         getQueueDepth());
+  metric("dyldex_resident_memory_bytes", "gauge",
+         "Resident set size of the process.", residentSetSize());
+  metric("dyldex_uptime_seconds", "gauge", "Time since the run started.",
+         uptime.count());
+
+  stream << "# HELP dyldex_stage_duration_seconds Latency of each stage.\n"
+            "# TYPE dyldex_stage_duration_seconds histogram\n";
+  for (const auto &[stage, histogram] : stages) {
+    // Buckets are cumulative
+    uint64_t count = 0;
+    for (std::size_t i = 0; i < histogram.counts.size(); i++) {
+      count += histogram.counts[i];
+      stream << fmt::format(
+          "dyldex_stage_duration_seconds_bucket{{stage=\"{}\",le=\"{}\"}} {}\n",
+          stage,
+          i < LATENCY_BUCKETS.size() ? fmt::format("{}", LATENCY_BUCKETS[i])
+                                     : "+Inf",
+          count);
+    }
+    stream << fmt::format(
+        "dyldex_stage_duration_seconds_sum{{stage=\"{0}\"}} {1}\n"
+        "dyldex_stage_duration_seconds_count{{stage=\"{0}\"}} {2}\n",
+        stage, histogram.sum, histogram.count);
+  }
+}
+
+void MetricsExporter::writeJson(
+    std::ostream &stream, const std::map<std::string, Histogram> &stages) {
+  const std::chrono::duration<double> uptime =
+      std::chrono::steady_clock::now() - startTime;
+
+  stream << fmt::format(
+      "{{\n  \"images\": {},\n  \"imagesCompleted\": {},\n"
+      "  \"imagesFailed\": {},\n  \"bytesWritten\": {},\n"
+      "  \"queueDepth\": {},\n  \"residentBytes\": {},\n"
+      "  \"uptime\": {},\n  \"stages\": [",
+      totalImages.load(), imagesCompleted.load(), imagesFailed.load(),
+      bytesWritten.load(), getQueueDepth(), residentSetSize(),
+      uptime.count());
+
+  // Stage names are identifiers, they don't need escaping
+  bool first = true;
+  for (const auto &[stage, histogram] : stages) {
+    std::string buckets;
+    for (std::size_t i = 0; i < histogram.counts.size(); i++) {
+      buckets += fmt::format(
+          "{}{{\"le\": {}, \"count\": {}}}", i ? ", " : "",
+          i < LATENCY_BUCKETS.size() ? fmt::format("{}", LATENCY_BUCKETS[i])
+                                     : "null",
+          histogram.counts[i]);
+    }
+
+    stream << (first ? "\n" : ",\n");
+    stream << fmt::format("    {{\"stage\": \"{}\", \"count\": {}, "
+                          "\"sum\": {}, \"buckets\": [{}]}}",
+                          stage, histogram.count, histogram.sum, buckets);
+    first = false;
+  }
+  stream << "\n  ]\n}\n";
+}
@@ -0,0 +1,105 @@
+#ifndef __PROVIDER_METRICSEXPORTER__
+#define __PROVIDER_METRICSEXPORTER__
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+
+namespace DyldExtractor::Provider {
+
+/// @brief Periodically writes the progress of a run to a status file.
+///
+/// The file is rewritten every interval and when the exporter is destroyed.
+/// It is written to a temporary file and renamed, so readers never see a
+/// partial file. A path ending in .prom gets the Prometheus text format, which
+/// can be picked up by the node exporter's textfile collector, anything else
+/// gets JSON. Metrics can be updated from multiple threads.
+class MetricsExporter {
+public:
+  /// Upper bounds of the stage latency buckets in seconds, the last bucket
+  /// is unbounded.
+  static constexpr std::array<double, 11> LATENCY_BUCKETS = {
+      0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1, 5, 10, 30, 60};
+
+  /// @brief Start writing the status file.
+  /// @param path The status file.
+  /// @param interval The time between writes.
+  MetricsExporter(std::filesystem::path path,
+                  std::chrono::milliseconds interval);
+  ~MetricsExporter();
+  MetricsExporter(const MetricsExporter &) = delete;
+  MetricsExporter &operator=(const MetricsExporter &) = delete;
+
+  /// @brief Add images to the number of images in the run.
+  void addImages(uint64_t count) { totalImages += count; }
+
+  /// @brief Count an image that was processed.
+  /// @param failed If the image failed.
+  void imageDone(bool failed);
+
+  /// @brief Add the latency of a stage to its histogram.
+  void recordStage(const std::string &stage, double seconds);
+
+  /// @brief Count bytes of output that were written.
+  void addBytesWritten(uint64_t bytes) { bytesWritten += bytes; }
+
+  /// @brief Set the number of images waiting to be processed.
+  /// @param queue Which queue the depth is for. The reported depth is the
+  ///   sum of all queues, like the caches of a batch.
+  void setQueueDepth(uint64_t depth, std::size_t queue = 0);
+
+  /// @brief Write the status file now.
+  /// @returns If the file was written.
+  bool write();
+
+  /// @brief Get the resident set size of this process in bytes.
+  /// @returns The size, or 0 if it is not available on this platform.
+  static uint64_t residentSetSize();
+
+private:
+  struct Histogram {
+    std::array<uint64_t, LATENCY_BUCKETS.size() + 1> counts{};
+    uint64_t count = 0;
+    double sum = 0;
+  };
+
+  const std::filesystem::path path;
+  const bool prometheus;
+  const std::chrono::steady_clock::time_point startTime;
+
+  std::atomic_uint64_t totalImages = 0;
+  std::atomic_uint64_t imagesCompleted = 0;
+  std::atomic_uint64_t imagesFailed = 0;
+  std::atomic_uint64_t bytesWritten = 0;
+
+  std::mutex queuesMutex;
+  std::map<std::size_t, uint64_t> queueDepths;
+
+  std::mutex stagesMutex;
+  std::map<std::string, Histogram> stages;
+
+  // Serializes writes of the file
+  std::mutex writeMutex;
+
+  std::mutex stopMutex;
+  std::condition_variable stopCondition;
+  bool stopping = false;
+  std::thread thread;
+
+  uint64_t getQueueDepth();
+  void writePrometheus(std::ostream &stream,
+                       const std::map<std::string, Histogram> &stages);
+  void writeJson(std::ostream &stream,
+                 const std::map<std::string, Histogram> &stages);
+};
+
+} // namespace DyldExtractor::Provider
+
+#endif // __PROVIDER_METRICSEXPORTER__
@@ -1,6 +1,8 @@
 #include "PointerTracker.h"
 
 #include <Utils/ExtractionContext.h>
+#include <algorithm>
+#include <bit>
 
 using namespace DyldExtractor;
 using namespace Provider;
@@ -33,6 +35,20 @@ PointerTracker<P>::PtrT PointerTracker<P>::slideP(const PtrT addr) const {
     }
     auto ptr = map.convertAddr(addr);
 
+    if (lazySliding && map.slideInfoVersion >= 2) {
+      const auto pageSize = reinterpret_cast<const uint32_t *>(map.slideInfo)[1];
+      const auto pageIndex = (addr - map.address) / pageSize;
+      const auto offset = (uint32_t)((addr - map.address) % pageSize);
+
+      const auto &page = getSlidPage(map, pageIndex);
+      auto it = std::lower_bound(page.offsets.begin(), page.offsets.end(),
+                                 offset);
+      if (it != page.offsets.end() && *it == offset) {
+        return page.targets[it - page.offsets.begin()];
+      }
+      // Not in the chain, decode it directly
+    }
+
     switch (map.slideInfoVersion) {
     case 1: {
       return *(PtrT *)ptr;
@@ -76,14 +92,272 @@ PointerTracker<P>::PtrT PointerTracker<P>::slideP(const PtrT addr) const {
   return 0;
 }
 
+template <class P>
+const typename PointerTracker<P>::MappingSlideInfo *
+PointerTracker<P>::findMapping(const uint64_t addr, const uint64_t size) const {
+  for (auto &map : mappings) {
+    if (map.containsAddr(addr)) {
+      return addr + size <= map.address + map.size ? &map : nullptr;
+    }
+  }
+  return nullptr;
+}
+
+template <class P>
+void PointerTracker<P>::slideStrided(const MappingSlideInfo &map,
+                                     const uint8_t *src, uint8_t *dst,
+                                     const std::size_t stride,
+                                     const uint32_t count) const {
+  // Switch once and keep the loops free of branches on the format, so that
+  // the mask and add formats can be vectorized.
+  switch (map.slideInfoVersion) {
+  case 1: {
+    for (uint32_t i = 0; i < count; i++) {
+      *(PtrT *)(dst + i * stride) = *(const PtrT *)(src + i * stride);
+    }
+    break;
+  }
+  case 2: {
+    auto slideInfo = (const dyld_cache_slide_info2 *)map.slideInfo;
+    const PtrT mask = (PtrT)~slideInfo->delta_mask;
+    const PtrT valueAdd = (PtrT)slideInfo->value_add;
+    for (uint32_t i = 0; i < count; i++) {
+      const PtrT val = *(const PtrT *)(src + i * stride) & mask;
+      *(PtrT *)(dst + i * stride) = val ? val + valueAdd : 0;
+    }
+    break;
+  }
+  case 3: {
+    auto slideInfo = (const dyld_cache_slide_info3 *)map.slideInfo;
+    const PtrT authValueAdd = (PtrT)slideInfo->auth_value_add;
+    for (uint32_t i = 0; i < count; i++) {
+      auto ptrInfo = (const dyld_cache_slide_pointer3 *)(src + i * stride);
+      PtrT val;
+      if (ptrInfo->auth.authenticated) {
+        val = (PtrT)ptrInfo->auth.offsetFromSharedCacheBase + authValueAdd;
+      } else {
+        uint64_t value51 = ptrInfo->plain.pointerValue;
+        uint64_t top8Bits = value51 & 0x0007F80000000000ULL;
+        uint64_t bottom43Bits = value51 & 0x000007FFFFFFFFFFULL;
+        val = (PtrT)(top8Bits << 13) | (PtrT)bottom43Bits;
+      }
+      *(PtrT *)(dst + i * stride) = val;
+    }
+    break;
+  }
+  case 4: {
+    auto slideInfo = (const dyld_cache_slide_info4 *)map.slideInfo;
+    const uint32_t mask = (uint32_t)~slideInfo->delta_mask;
+    const PtrT valueAdd = (PtrT)slideInfo->value_add;
+    for (uint32_t i = 0; i < count; i++) {
+      *(PtrT *)(dst + i * stride) =
+          (PtrT)(*(const uint32_t *)(src + i * stride) & mask) + valueAdd;
+    }
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+template <class P>
+void PointerTracker<P>::reset(
+    std::optional<std::shared_ptr<spdlog::logger>> logger) {
+  this->logger = logger;
+  pointers.clear();
+  authData.clear();
+  bindData.clear();
+  bindAddends.clear();
+
+  std::scoped_lock lock(slidPagesMutex);
+  slidPages.clear();
+}
+
+template <class P> void PointerTracker<P>::enableLazySliding() {
+  lazySliding = true;
+}
+
+template <class P>
+const typename PointerTracker<P>::SlidPage &
+PointerTracker<P>::getSlidPage(const MappingSlideInfo &map,
+                               uint64_t pageIndex) const {
+  const auto pageSize = reinterpret_cast<const uint32_t *>(map.slideInfo)[1];
+  const uint64_t pageAddr = map.address + (pageIndex * pageSize);
+
+  {
+    std::scoped_lock lock(slidPagesMutex);
+    if (auto it = slidPages.find(pageAddr); it != slidPages.end()) {
+      return it->second;
+    }
+  }
+
+  // Decode without the lock, another thread may have the same page
+  auto page = decodePage(map, pageIndex);
+  std::scoped_lock lock(slidPagesMutex);
+  return slidPages.try_emplace(pageAddr, std::move(page)).first->second;
+}
+
+template <class P>
+typename PointerTracker<P>::SlidPage
+PointerTracker<P>::decodePage(const MappingSlideInfo &map,
+                              uint64_t pageIndex) const {
+  std::vector<std::pair<uint32_t, PtrT>> pointers;
+  const auto pageSize = reinterpret_cast<const uint32_t *>(map.slideInfo)[1];
+  const auto pageData = map.data + (pageIndex * pageSize);
+
+  switch (map.slideInfoVersion) {
+  case 2: {
+    const auto slideInfo = (const dyld_cache_slide_info2 *)map.slideInfo;
+    const auto pageStarts = (const uint16_t *)(map.slideInfo +
+                                               slideInfo->page_starts_offset);
+    const auto pageExtras = (const uint16_t *)(map.slideInfo +
+                                               slideInfo->page_extras_offset);
+    if (pageIndex >= slideInfo->page_starts_count) {
+      break;
+    }
+
+    const auto deltaMask = (PtrT)slideInfo->delta_mask;
+    const auto deltaShift = std::countr_zero((uint64_t)deltaMask) - 2;
+    auto walkChain = [&](uint32_t offset) {
+      uint32_t delta = 1;
+      while (delta != 0 && offset < pageSize) {
+        PtrT rawValue = *(const PtrT *)(pageData + offset);
+        delta = (uint32_t)((rawValue & deltaMask) >> deltaShift);
+        PtrT value = rawValue & ~deltaMask;
+        if (value != 0) {
+          value += (PtrT)slideInfo->value_add;
+        }
+        pointers.emplace_back(offset, value);
+        offset += delta;
+      }
+    };
+
+    const auto page = pageStarts[pageIndex];
+    if (page == DYLD_CACHE_SLIDE_PAGE_ATTR_NO_REBASE) {
+      break;
+    } else if (page & DYLD_CACHE_SLIDE_PAGE_ATTR_EXTRA) {
+      for (uint16_t chainI = page & 0x3FFF;; chainI++) {
+        const auto pInfo = pageExtras[chainI];
+        walkChain((pInfo & 0x3FFF) * 4);
+        if (pInfo & DYLD_CACHE_SLIDE_PAGE_ATTR_END) {
+          break;
+        }
+      }
+    } else {
+      walkChain(page * 4);
+    }
+    break;
+  }
+
+  case 3: {
+    const auto slideInfo = (const dyld_cache_slide_info3 *)map.slideInfo;
+    const auto pageStarts =
+        (const uint16_t *)(map.slideInfo +
+                           offsetof(dyld_cache_slide_info3, page_starts));
+    if (pageIndex >= slideInfo->page_starts_count) {
+      break;
+    }
+
+    const auto page = pageStarts[pageIndex];
+    if (page == DYLD_CACHE_SLIDE_V3_PAGE_ATTR_NO_REBASE) {
+      break;
+    }
+
+    uint64_t offset = page;
+    while (offset < pageSize) {
+      auto pLoc = (const dyld_cache_slide_pointer3 *)(pageData + offset);
+      uint64_t value;
+      if (pLoc->auth.authenticated) {
+        value = pLoc->auth.offsetFromSharedCacheBase + slideInfo->auth_value_add;
+      } else {
+        uint64_t value51 = pLoc->plain.pointerValue;
+        uint64_t top8Bits = value51 & 0x0007F80000000000ULL;
+        uint64_t bottom43Bits = value51 & 0x000007FFFFFFFFFFULL;
+        value = (top8Bits << 13) | bottom43Bits;
+      }
+      pointers.emplace_back((uint32_t)offset, (PtrT)value);
+
+      const uint64_t delta = pLoc->plain.offsetToNextPointer;
+      if (delta == 0) {
+        break;
+      }
+      offset += delta * sizeof(uint64_t);
+    }
+    break;
+  }
+
+  case 4: {
+    const auto slideInfo = (const dyld_cache_slide_info4 *)map.slideInfo;
+    const auto pageStarts = (const uint16_t *)(map.slideInfo +
+                                               slideInfo->page_starts_offset);
+    const auto pageExtras = (const uint16_t *)(map.slideInfo +
+                                               slideInfo->page_extras_offset);
+    if (pageIndex >= slideInfo->page_starts_count) {
+      break;
+    }
+
+    const auto deltaMask = (uint32_t)slideInfo->delta_mask;
+    const auto deltaShift = std::countr_zero(deltaMask) - 2;
+    auto walkChain = [&](uint32_t offset) {
+      uint32_t delta = 1;
+      while (delta != 0 && offset < pageSize) {
+        uint32_t rawValue = *(const uint32_t *)(pageData + offset);
+        delta = (rawValue & deltaMask) >> deltaShift;
+        uint32_t value = rawValue & ~deltaMask;
+        if ((value & 0xFFFF8000) == 0) {
+          // small positive non-pointer, use as-is
+        } else if ((value & 0x3FFF8000) == 0x3FFF8000) {
+          // small negative non-pointer
+          value |= 0xC0000000;
+        } else {
+          value += (uint32_t)slideInfo->value_add;
+        }
+        pointers.emplace_back(offset, (PtrT)value);
+        offset += delta;
+      }
+    };
+
+    const auto page = pageStarts[pageIndex];
+    if (page == DYLD_CACHE_SLIDE4_PAGE_NO_REBASE) {
+      break;
+    } else if (page & DYLD_CACHE_SLIDE4_PAGE_USE_EXTRA) {
+      for (auto extra = pageExtras + (page & DYLD_CACHE_SLIDE4_PAGE_INDEX);;
+           extra++) {
+        walkChain((*extra & DYLD_CACHE_SLIDE4_PAGE_INDEX) * 4);
+        if (*extra & DYLD_CACHE_SLIDE4_PAGE_EXTRA_END) {
+          break;
+        }
+      }
+    } else {
+      walkChain(page * 4);
+    }
+    break;
+  }
+
+  default:
+    break;
+  }
+
+  std::sort(pointers.begin(), pointers.end(),
+            [](const auto &a, const auto &b) { return a.first < b.first; });
+  SlidPage slidPage;
+  slidPage.offsets.reserve(pointers.size());
+  slidPage.targets.reserve(pointers.size());
+  for (const auto &[offset, target] : pointers) {
+    slidPage.offsets.push_back(offset);
+    slidPage.targets.push_back(target);
+  }
+  return slidPage;
+}
+
 template <class P>
 void PointerTracker<P>::add(const PtrT addr, const PtrT target) {
-  pointers[addr] = target;
+  pointers.assign(addr, target);
 }
 
 template <class P>
 void PointerTracker<P>::addAuth(const PtrT addr, AuthData data) {
-  authData[addr] = data;
+  authData.assign(addr, data);
 }
 
 template <class P>
@@ -106,15 +380,30 @@ void PointerTracker<P>::copyAuth(const PtrT addr, const PtrT sAddr) {
 template <class P>
 void PointerTracker<P>::removePointers(const PtrT start, const PtrT end) {
   // Remove from pointers, auth, and bind
-  pointers.erase(pointers.lower_bound(start), pointers.upper_bound(end));
-  authData.erase(authData.lower_bound(start), authData.upper_bound(end));
-  bindData.erase(bindData.lower_bound(start), bindData.upper_bound(end));
+  pointers.eraseRange(start, end);
+  authData.eraseRange(start, end);
+  bindData.eraseRange(start, end);
+  bindAddends.eraseRange(start, end);
 }
 
 template <class P>
 void PointerTracker<P>::addBind(const PtrT addr,
-                                std::shared_ptr<SymbolicInfo> data) {
-  bindData[addr] = data;
+                                const SymbolicInfoStore::Id symbol,
+                                const int64_t addend) {
+  bindData.assign(addr, symbol);
+  if (addend) {
+    bindAddends.assign(addr, addend);
+  } else {
+    // Rebinding without an addend, cheap while there are no addends
+    bindAddends.eraseRange(addr, addr);
+  }
+}
+
+template <class P> void PointerTracker<P>::freeze() {
+  pointers.freeze();
+  authData.freeze();
+  bindData.freeze();
+  bindAddends.freeze();
 }
 
 template <class P>
@@ -135,26 +424,32 @@ PointerTracker<P>::getSlideMappings() const {
 }
 
 template <class P>
-const std::map<typename PointerTracker<P>::PtrT,
-               typename PointerTracker<P>::PtrT> &
+const Utils::AddressMap<typename PointerTracker<P>::PtrT,
+                        typename PointerTracker<P>::PtrT> &
 PointerTracker<P>::getPointers() const {
   return pointers;
 }
 
 template <class P>
-const std::map<typename PointerTracker<P>::PtrT,
-               typename PointerTracker<P>::AuthData> &
+const Utils::AddressMap<typename PointerTracker<P>::PtrT,
+                        typename PointerTracker<P>::AuthData> &
 PointerTracker<P>::getAuths() const {
   return authData;
 }
 
 template <class P>
-const std::map<typename PointerTracker<P>::PtrT,
-               std::shared_ptr<SymbolicInfo>> &
+const Utils::AddressMap<typename PointerTracker<P>::PtrT,
+                        SymbolicInfoStore::Id> &
 PointerTracker<P>::getBinds() const {
   return bindData;
 }
 
+template <class P>
+const Utils::AddressMap<typename PointerTracker<P>::PtrT, int64_t> &
+PointerTracker<P>::getBindAddends() const {
+  return bindAddends;
+}
+
 template <class P> uint32_t PointerTracker<P>::getPageSize() const {
   const auto slideMaps = getSlideMappings();
   if (!slideMaps.size()) {
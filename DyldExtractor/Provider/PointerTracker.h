@@ -3,9 +3,13 @@
 
 #include "Symbolizer.h"
 #include <Dyld/DyldContext.h>
+#include <Utils/AddressMap.h>
 #include <map>
+#include <mutex>
 #include <spdlog/spdlog.h>
 #include <stdint.h>
+#include <string.h>
+#include <unordered_map>
 #include <vector>
 
 #include <stddef.h>
@@ -54,11 +58,27 @@ public:
     PointerTracker(const PointerTracker &) = delete;
     PointerTracker &operator=(const PointerTracker &) = delete;
     
+    /// @brief Remove all tracked data, for another image of the same cache.
+    ///
+    /// The mappings are kept, and the maps keep their space so the next
+    /// image fills them without growing them again.
+    ///
+    /// @param logger The new logger.
+    void reset(std::optional<std::shared_ptr<spdlog::logger>> logger);
+    
     /// @brief Slide the pointer at the address
     /// @param address The address of the pointer.
     /// @returns The slid pointer value.
     PtrT slideP(const PtrT addr) const;
     
+    /// @brief Decode slide info a page at a time in slideP.
+    ///
+    /// The first time a pointer in a page is slid, the page's whole chain is
+    /// decoded and memoized, so later lookups in the page are a search, and
+    /// values that are only known from the chain, like V4 non-pointers, are
+    /// correct. Useful for read only queries that don't process slide info.
+    void enableLazySliding();
+    
     /// @brief Slide the struct at the address.
     /// @tparam T The type of struct.
     /// @param address The address of the struct.
@@ -72,6 +92,57 @@ public:
         return data;
     }
     
+    /// @brief Slide a contiguous array of structs.
+    ///
+    /// The same as calling slideS for each entry. When the array is in one
+    /// mapping, the address is translated once and each pointer field is
+    /// decoded for all entries in a single loop.
+    ///
+    /// @tparam T The type of struct.
+    /// @param address The address of the first struct.
+    /// @param count The number of structs.
+    /// @returns The slid structs.
+    template <class T>
+    std::vector<T> slideArray(const PtrT address, const uint32_t count) const {
+        std::vector<T> data(count);
+        if (!count) {
+            return data;
+        }
+        
+        const uint64_t size = (uint64_t)count * sizeof(T);
+        const auto map = findMapping(address, size);
+        if (!map) {
+            // The array may cross mappings, which aren't contiguous in memory
+            for (uint32_t i = 0; i < count; i++) {
+                data[i] = slideS<T>(address + (PtrT)(i * sizeof(T)));
+            }
+            return data;
+        }
+        
+        const uint8_t *src = map->convertAddr(address);
+        memcpy(data.data(), src, size);
+        
+        if constexpr (T::PTRS().size() != 0) {
+            if (!(lazySliding && map->slideInfoVersion >= 2) &&
+                map->slideInfoVersion >= 1 && map->slideInfoVersion <= 4) {
+                for (auto offset : T::PTRS()) {
+                    slideStrided(*map, src + offset,
+                                 (uint8_t *)data.data() + offset, sizeof(T),
+                                 count);
+                }
+            } else {
+                for (uint32_t i = 0; i < count; i++) {
+                    const PtrT entryAddr = address + (PtrT)(i * sizeof(T));
+                    for (auto offset : T::PTRS()) {
+                        *(PtrT *)((uint8_t *)&data[i] + (PtrT)offset) =
+                        slideP(entryAddr + (PtrT)offset);
+                    }
+                }
+            }
+        }
+        return data;
+    }
+    
     /// @brief Add a pointer to tracking, overwriting if already added.
     /// @param addr Address of the pointer.
     /// @param target The target address.
@@ -128,8 +199,10 @@ public:
     
     /// @brief Add bind data for a pointer
     /// @param addr The address of the pointer
-    /// @param data Symbolic info for the bind
-    void addBind(const PtrT addr, std::shared_ptr<SymbolicInfo> data);
+    /// @param symbol The id of the bind's symbolic info in the symbol store
+    /// @param addend The bind's addend
+    void addBind(const PtrT addr, const SymbolicInfoStore::Id symbol,
+                 const int64_t addend = 0);
     
     /// @brief Get all mappings
     const std::vector<MappingSlideInfo> &getMappings() const;
@@ -137,17 +210,41 @@ public:
     /// @brief Get all mappings with slide info
     std::vector<const MappingSlideInfo *> getSlideMappings() const;
     
-    const std::map<PtrT, PtrT> &getPointers() const;
+    /// @brief Merge the pending changes of the pointer, auth, and bind maps.
+    /// Must be called before the maps below are read, after which they can
+    /// be read from multiple threads until the next change.
+    void freeze();
     
-    const std::map<PtrT, AuthData> &getAuths() const;
+    const Utils::AddressMap<PtrT, PtrT> &getPointers() const;
     
-    const std::map<PtrT, std::shared_ptr<SymbolicInfo>> &getBinds() const;
+    const Utils::AddressMap<PtrT, AuthData> &getAuths() const;
+    
+    const Utils::AddressMap<PtrT, SymbolicInfoStore::Id> &getBinds() const;
+    
+    /// @brief Get the addends of binds, only binds with an addend are included.
+    const Utils::AddressMap<PtrT, int64_t> &getBindAddends() const;
     
     /// @brief Get the page size.
     uint32_t getPageSize() const;
     
 private:
+    /// Decoded pointers in a page, sorted by offset
+    struct SlidPage {
+        std::vector<uint32_t> offsets;
+        std::vector<PtrT> targets;
+    };
+    
     void fillMappings();
+    /// Get the mapping that contains the whole range, nullptr if none do.
+    const MappingSlideInfo *findMapping(const uint64_t addr,
+                                        const uint64_t size) const;
+    /// Decode count pointers, stride bytes apart, that are all in the mapping.
+    void slideStrided(const MappingSlideInfo &map, const uint8_t *src,
+                      uint8_t *dst, const std::size_t stride,
+                      const uint32_t count) const;
+    const SlidPage &getSlidPage(const MappingSlideInfo &map,
+                                uint64_t pageIndex) const;
+    SlidPage decodePage(const MappingSlideInfo &map, uint64_t pageIndex) const;
     
     const Dyld::Context *dCtx;
     std::optional<std::shared_ptr<spdlog::logger>> logger;
@@ -156,9 +253,14 @@ private:
     std::vector<int> slideMappings;
     std::vector<int> authMappings;
     
-    std::map<PtrT, PtrT> pointers;
-    std::map<PtrT, AuthData> authData;
-    std::map<PtrT, std::shared_ptr<SymbolicInfo>> bindData;
+    Utils::AddressMap<PtrT, PtrT> pointers;
+    Utils::AddressMap<PtrT, AuthData> authData;
+    Utils::AddressMap<PtrT, SymbolicInfoStore::Id> bindData;
+    Utils::AddressMap<PtrT, int64_t> bindAddends;
+    
+    bool lazySliding = false;
+    mutable std::mutex slidPagesMutex;
+    mutable std::unordered_map<uint64_t, SlidPage> slidPages;
 };
 
 }; // namespace DyldExtractor::Provider
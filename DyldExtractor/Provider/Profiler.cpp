@@ -0,0 +1,257 @@
+#include "Profiler.h"
+
+#include <Provider/MetricsExporter.h>
+#include <algorithm>
+#include <cmath>
+#include <fmt/format.h>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+#ifndef _WIN32
+#include <time.h>
+#else
+#include <ctime>
+#endif
+
+using namespace DyldExtractor;
+using namespace Provider;
+
+void Profiler::add(Record record) {
+  if (metrics) {
+    metrics->recordStage(record.stage, record.wallTime);
+  }
+
+  std::scoped_lock lock(recordsMutex);
+  records.push_back(std::move(record));
+}
+
+std::vector<Profiler::Record> Profiler::getRecords() const {
+  std::scoped_lock lock(recordsMutex);
+  return records;
+}
+
+std::string Profiler::serialize() const {
+  // Tab separated, one record per line. Image and stage names don't contain
+  // tabs or new lines.
+  std::string data;
+  for (const auto &record : getRecords()) {
+    const auto &perf = record.perf;
+    data += fmt::format(
+        "{}\t{}\t{}\t{}\t{}\t{}\t{}\t{}\t{}\t{}\t{}\t{}\t{}\n", record.image,
+        record.stage, record.wallTime, record.cpuTime, record.bytes,
+        record.allocations, record.allocatedBytes, record.peakBytes,
+        perf.cycles, perf.instructions, perf.llcMisses, perf.branchMisses,
+        perf.dtlbMisses);
+  }
+  return data;
+}
+
+void Profiler::deserialize(const std::string &data) {
+  std::istringstream stream(data);
+  std::string line;
+  while (std::getline(stream, line)) {
+    std::istringstream lineStream(line);
+    Record record;
+    std::string wallTime, cpuTime, bytes;
+    if (std::getline(lineStream, record.image, '\t') &&
+        std::getline(lineStream, record.stage, '\t') &&
+        std::getline(lineStream, wallTime, '\t') &&
+        std::getline(lineStream, cpuTime, '\t') &&
+        std::getline(lineStream, bytes, '\t')) {
+      record.wallTime = std::stod(wallTime);
+      record.cpuTime = std::stod(cpuTime);
+      record.bytes = std::stoull(bytes);
+
+      // Allocation counts are optional
+      std::string allocations, allocatedBytes, peakBytes;
+      if (std::getline(lineStream, allocations, '\t') &&
+          std::getline(lineStream, allocatedBytes, '\t') &&
+          std::getline(lineStream, peakBytes, '\t')) {
+        record.allocations = std::stoull(allocations);
+        record.allocatedBytes = std::stoull(allocatedBytes);
+        record.peakBytes = std::stoull(peakBytes);
+      }
+
+      // So are hardware counters
+      std::string counters[5];
+      if (std::all_of(std::begin(counters), std::end(counters),
+                      [&](std::string &c) {
+                        return (bool)std::getline(lineStream, c, '\t');
+                      })) {
+        auto &perf = record.perf;
+        perf.cycles = std::stoull(counters[0]);
+        perf.instructions = std::stoull(counters[1]);
+        perf.llcMisses = std::stoull(counters[2]);
+        perf.branchMisses = std::stoull(counters[3]);
+        perf.dtlbMisses = std::stoull(counters[4]);
+      }
+      add(std::move(record));
+    }
+  }
+}
+
+/// @brief Format a double for JSON, which has no infinity or NaN.
+static std::string jsonNumber(double value) {
+  return std::isfinite(value) ? fmt::format("{}", value) : "null";
+}
+
+static std::string jsonEscape(const std::string &str) {
+  std::string escaped;
+  for (auto c : str) {
+    switch (c) {
+    case '"':
+      escaped += "\\\"";
+      break;
+    case '\\':
+      escaped += "\\\\";
+      break;
+    case '\n':
+      escaped += "\\n";
+      break;
+    default:
+      if ((unsigned char)c < 0x20) {
+        escaped += fmt::format("\\u{:04x}", (int)c);
+      } else {
+        escaped += c;
+      }
+      break;
+    }
+  }
+  return escaped;
+}
+
+/// @brief Format the hardware counters of a stage, with the instructions per
+///   cycle and the misses per KB processed.
+static std::string perfTotalJson(const Utils::PerfCounters::Counts &perf,
+                                 uint64_t bytes) {
+  if (!perf.cycles) {
+    return "";
+  }
+
+  const double kb = bytes / 1024.0;
+  auto perKB = [kb](uint64_t count) { return kb > 0 ? count / kb : 0.0; };
+  return fmt::format(
+      ", \"cycles\": {}, \"instructions\": {}, \"ipc\": {}, "
+      "\"llcMissesPerKB\": {}, \"branchMissesPerKB\": {}, "
+      "\"dtlbMissesPerKB\": {}",
+      perf.cycles, perf.instructions,
+      jsonNumber((double)perf.instructions / perf.cycles),
+      jsonNumber(perKB(perf.llcMisses)), jsonNumber(perKB(perf.branchMisses)),
+      jsonNumber(perKB(perf.dtlbMisses)));
+}
+
+void Profiler::writeJson(std::ostream &stream) const {
+  const auto allRecords = getRecords();
+
+  struct Total {
+    uint64_t count = 0;
+    double wallTime = 0;
+    double cpuTime = 0;
+    uint64_t bytes = 0;
+    uint64_t allocations = 0;
+    uint64_t allocatedBytes = 0;
+    uint64_t peakBytes = 0;
+    Utils::PerfCounters::Counts perf;
+  };
+  std::map<std::string, Total> totals;
+  for (const auto &record : allRecords) {
+    auto &total = totals[record.stage];
+    total.count++;
+    total.wallTime += record.wallTime;
+    total.cpuTime += record.cpuTime;
+    total.bytes += record.bytes;
+    total.allocations += record.allocations;
+    total.allocatedBytes += record.allocatedBytes;
+    total.peakBytes = std::max(total.peakBytes, record.peakBytes);
+    total.perf.cycles += record.perf.cycles;
+    total.perf.instructions += record.perf.instructions;
+    total.perf.llcMisses += record.perf.llcMisses;
+    total.perf.branchMisses += record.perf.branchMisses;
+    total.perf.dtlbMisses += record.perf.dtlbMisses;
+  }
+
+  stream << "{\n  \"stages\": [";
+  bool first = true;
+  for (const auto &[stage, total] : totals) {
+    stream << (first ? "\n" : ",\n");
+    stream << fmt::format(
+        "    {{\"stage\": \"{}\", \"count\": {}, \"wallTime\": {}, "
+        "\"cpuTime\": {}, \"bytes\": {}, \"throughput\": {}, "
+        "\"allocations\": {}, \"allocatedBytes\": {}, \"peakBytes\": {}{}}}",
+        jsonEscape(stage), total.count, jsonNumber(total.wallTime),
+        jsonNumber(total.cpuTime), total.bytes,
+        jsonNumber(total.wallTime > 0 ? total.bytes / total.wallTime : 0.0),
+        total.allocations, total.allocatedBytes, total.peakBytes,
+        perfTotalJson(total.perf, total.bytes));
+    first = false;
+  }
+  stream << "\n  ],\n  \"records\": [";
+
+  first = true;
+  for (const auto &record : allRecords) {
+    stream << (first ? "\n" : ",\n");
+    stream << fmt::format(
+        "    {{\"image\": \"{}\", \"stage\": \"{}\", \"wallTime\": {}, "
+        "\"cpuTime\": {}, \"bytes\": {}, \"allocations\": {}, "
+        "\"allocatedBytes\": {}, \"peakBytes\": {}, \"cycles\": {}, "
+        "\"instructions\": {}, \"llcMisses\": {}, \"branchMisses\": {}, "
+        "\"dtlbMisses\": {}}}",
+        jsonEscape(record.image), jsonEscape(record.stage),
+        jsonNumber(record.wallTime), jsonNumber(record.cpuTime), record.bytes,
+        record.allocations, record.allocatedBytes, record.peakBytes,
+        record.perf.cycles, record.perf.instructions, record.perf.llcMisses,
+        record.perf.branchMisses, record.perf.dtlbMisses);
+    first = false;
+  }
+  stream << "\n  ]\n}\n";
+}
+
+void Profiler::writeCsv(std::ostream &stream) const {
+  auto quote = [](const std::string &str) {
+    std::string quoted = "\"";
+    for (auto c : str) {
+      quoted += c;
+      if (c == '"') {
+        quoted += c;
+      }
+    }
+    return quoted + "\"";
+  };
+
+  stream << "image,stage,wallTime,cpuTime,bytes,allocations,allocatedBytes,"
+            "peakBytes,cycles,instructions,llcMisses,branchMisses,dtlbMisses\n";
+  for (const auto &record : getRecords()) {
+    const auto &perf = record.perf;
+    stream << fmt::format("{},{},{},{},{},{},{},{},{},{},{},{},{}\n",
+                          quote(record.image), quote(record.stage),
+                          record.wallTime, record.cpuTime, record.bytes,
+                          record.allocations, record.allocatedBytes,
+                          record.peakBytes, perf.cycles, perf.instructions,
+                          perf.llcMisses, perf.branchMisses, perf.dtlbMisses);
+  }
+}
+
+bool Profiler::writeReport(const std::filesystem::path &path) const {
+  std::ofstream file(path);
+  if (!file.good()) {
+    return false;
+  }
+
+  if (path.extension() == ".json") {
+    writeJson(file);
+  } else {
+    writeCsv(file);
+  }
+  return file.good();
+}
+
+double Profiler::threadCpuTime() {
+#ifndef _WIN32
+  timespec time;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+  return (double)time.tv_sec + (double)time.tv_nsec / 1e9;
+#else
+  return (double)std::clock() / CLOCKS_PER_SEC;
+#endif
+}
@@ -0,0 +1,129 @@
+#ifndef __PROVIDER_PROFILER__
+#define __PROVIDER_PROFILER__
+
+#include <Utils/AllocationCounter.h>
+#include <Utils/PerfCounters.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace DyldExtractor::Provider {
+
+class MetricsExporter;
+
+/// @brief Records the time spent in each stage of each image.
+///
+/// Records can be taken from multiple threads, and serialized to move them
+/// between processes.
+class Profiler {
+public:
+  struct Record {
+    std::string image;
+    std::string stage;
+    /// Wall time in seconds
+    double wallTime;
+    /// CPU time of the calling thread in seconds
+    double cpuTime;
+    /// Bytes processed by the stage
+    uint64_t bytes;
+    /// Allocations made by the calling thread, only counted with
+    /// DYLDEXTRACTORC_COUNT_ALLOCATIONS
+    uint64_t allocations = 0;
+    /// Bytes allocated by the calling thread
+    uint64_t allocatedBytes = 0;
+    /// Most bytes live at once on the calling thread during the stage
+    uint64_t peakBytes = 0;
+    /// Hardware counters of the calling thread, only counted when
+    /// Utils::PerfCounters is enabled
+    Utils::PerfCounters::Counts perf;
+  };
+
+  /// @brief Time a stage and record it.
+  /// @param image The name of the image.
+  /// @param stage The name of the stage.
+  /// @param bytes The number of bytes that the stage processes.
+  /// @param func The stage to run.
+  /// @param out Receives a copy of the record if not nullptr.
+  /// @returns The result of the stage.
+  template <class F>
+  auto measure(const std::string &image, const std::string &stage,
+               uint64_t bytes, F func, Record *out = nullptr) {
+    struct Recorder {
+      Profiler &profiler;
+      const std::string &image;
+      const std::string &stage;
+      uint64_t bytes;
+      Record *out;
+      std::chrono::steady_clock::time_point wallStart =
+          std::chrono::steady_clock::now();
+      double cpuStart = threadCpuTime();
+      Utils::AllocationCounter::Scope allocationScope;
+      Utils::PerfCounters::Scope perfScope;
+
+      ~Recorder() {
+        const auto perf = perfScope.counts();
+        std::chrono::duration<double> wall =
+            std::chrono::steady_clock::now() - wallStart;
+        const auto counts = allocationScope.counts();
+        Record record{image,
+                      stage,
+                      wall.count(),
+                      threadCpuTime() - cpuStart,
+                      bytes,
+                      counts.allocations,
+                      counts.bytes,
+                      (uint64_t)std::max<int64_t>(counts.peakLiveBytes, 0),
+                      perf};
+        if (out) {
+          *out = record;
+        }
+        profiler.add(std::move(record));
+      }
+    } recorder{*this, image, stage, bytes, out};
+
+    return func();
+  }
+
+  /// @brief Add a record.
+  void add(Record record);
+
+  /// @brief Also add the wall time of every record to a metrics exporter.
+  void setMetrics(MetricsExporter *exporter) { metrics = exporter; }
+
+  /// @brief Get a copy of all records.
+  std::vector<Record> getRecords() const;
+
+  /// @brief Serialize all records into a string for another process.
+  std::string serialize() const;
+
+  /// @brief Add records from a string created by serialize.
+  void deserialize(const std::string &data);
+
+  /// @brief Write all records as a JSON report, including per stage totals.
+  ///   The totals include the instructions per cycle and the misses per KB
+  ///   processed, when hardware counters were enabled.
+  void writeJson(std::ostream &stream) const;
+
+  /// @brief Write all records as a CSV report.
+  void writeCsv(std::ostream &stream) const;
+
+  /// @brief Write a report, JSON if the extension is .json, otherwise CSV.
+  /// @returns If the report was written.
+  bool writeReport(const std::filesystem::path &path) const;
+
+  /// @brief Get the CPU time used by the calling thread in seconds.
+  static double threadCpuTime();
+
+private:
+  mutable std::mutex recordsMutex;
+  std::vector<Record> records;
+  MetricsExporter *metrics = nullptr;
+};
+
+} // namespace DyldExtractor::Provider
+
+#endif // __PROVIDER_PROFILER__
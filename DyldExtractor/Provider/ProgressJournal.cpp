@@ -0,0 +1,121 @@
+#include "ProgressJournal.h"
+
+#include <fmt/format.h>
+#include <fstream>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace DyldExtractor;
+using namespace Provider;
+
+ProgressJournal::ProgressJournal(const std::filesystem::path &path,
+                                 const Dyld::Context &dCtx, bool resume) {
+  std::string header = "dyldex_journal ";
+  for (auto byte : dCtx.header->uuid) {
+    header += fmt::format("{:02x}", byte);
+  }
+  header += "\n";
+
+  const bool keep = resume && load(path, header);
+  if (!keep) {
+    results.clear();
+  }
+
+#ifndef _WIN32
+  fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | (keep ? 0 : O_TRUNC),
+            0644);
+  if (fd == -1) {
+    throw std::runtime_error(
+        fmt::format("Unable to open journal {}.", path.string()));
+  }
+#else
+  file.open(path, std::ios_base::binary |
+                      (keep ? std::ios_base::app : std::ios_base::trunc));
+  if (!file.good()) {
+    throw std::runtime_error(
+        fmt::format("Unable to open journal {}.", path.string()));
+  }
+#endif
+
+  if (!keep && !append(header)) {
+    throw std::runtime_error(
+        fmt::format("Unable to write journal {}.", path.string()));
+  }
+}
+
+ProgressJournal::~ProgressJournal() {
+#ifndef _WIN32
+  if (fd != -1) {
+    close(fd);
+  }
+#endif
+}
+
+bool ProgressJournal::record(uint32_t image, Result result) {
+  // One entry per line, c for completed or f for failed then the image index
+  const auto entry =
+      fmt::format("{} {}\n", result == Result::completed ? 'c' : 'f', image);
+
+  std::scoped_lock lock(mutex);
+  results[image] = result;
+  return append(entry);
+}
+
+std::optional<ProgressJournal::Result>
+ProgressJournal::getResult(uint32_t image) const {
+  std::scoped_lock lock(mutex);
+  if (auto it = results.find(image); it != results.end()) {
+    return it->second;
+  }
+  return std::nullopt;
+}
+
+bool ProgressJournal::load(const std::filesystem::path &path,
+                           std::string_view header) {
+  std::ifstream file(path, std::ios_base::binary);
+  if (!file.good()) {
+    return false;
+  }
+
+  std::string line;
+  if (!std::getline(file, line) ||
+      line != header.substr(0, header.size() - 1)) {
+    return false;
+  }
+
+  // The last line can be cut off if the run was killed while writing it.
+  while (std::getline(file, line)) {
+    if (file.eof() || line.size() < 3 || line[1] != ' ' ||
+        (line[0] != 'c' && line[0] != 'f') ||
+        line.find_first_not_of("0123456789", 2) != std::string::npos) {
+      continue;
+    }
+    results[(uint32_t)std::stoul(line.substr(2))] =
+        line[0] == 'c' ? Result::completed : Result::failed;
+  }
+  return true;
+}
+
+bool ProgressJournal::append(std::string_view data) {
+#ifndef _WIN32
+  while (!data.empty()) {
+    const auto written = write(fd, data.data(), data.size());
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data.remove_prefix(written);
+  }
+  return fsync(fd) == 0;
+#else
+  file.write(data.data(), data.size());
+  file.flush();
+  return file.good();
+#endif
+}
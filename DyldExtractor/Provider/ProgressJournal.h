@@ -0,0 +1,68 @@
+#ifndef __PROVIDER_PROGRESSJOURNAL__
+#define __PROVIDER_PROGRESSJOURNAL__
+
+#include <Dyld/DyldContext.h>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <stdint.h>
+#include <string_view>
+
+#ifdef _WIN32
+#include <fstream>
+#endif
+
+namespace DyldExtractor::Provider {
+
+/// @brief An append only record of the images that completed or failed.
+///
+/// Each result is appended and synced to disk as soon as it is recorded, so a
+/// run that is killed only loses the images it was processing. The journal
+/// starts with the UUID of the cache, a journal of another cache is discarded.
+/// Records can be made from multiple threads.
+class ProgressJournal {
+public:
+  enum class Result { completed, failed };
+
+  /// @brief Open a journal, throws if the file can't be opened.
+  /// @param path The journal file.
+  /// @param dCtx The cache the images are from.
+  /// @param resume Keep and read the existing entries, otherwise the journal
+  ///   is started again.
+  ProgressJournal(const std::filesystem::path &path, const Dyld::Context &dCtx,
+                  bool resume);
+  ~ProgressJournal();
+  ProgressJournal(const ProgressJournal &) = delete;
+  ProgressJournal &operator=(const ProgressJournal &) = delete;
+
+  /// @brief Append the result of an image.
+  /// @param image The index of the image in the cache.
+  /// @returns If the entry was written.
+  bool record(uint32_t image, Result result);
+
+  /// @brief Get the last result of an image.
+  std::optional<Result> getResult(uint32_t image) const;
+
+  /// @brief The last result of every image in the journal.
+  const std::map<uint32_t, Result> &getResults() const { return results; }
+
+private:
+  mutable std::mutex mutex;
+  std::map<uint32_t, Result> results;
+
+#ifndef _WIN32
+  int fd = -1;
+#else
+  std::ofstream file;
+#endif
+
+  /// @brief Read the entries of an existing journal.
+  /// @returns If the journal is of the same cache.
+  bool load(const std::filesystem::path &path, std::string_view header);
+  bool append(std::string_view data);
+};
+
+} // namespace DyldExtractor::Provider
+
+#endif // __PROVIDER_PROGRESSJOURNAL__
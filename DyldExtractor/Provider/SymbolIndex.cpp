@@ -0,0 +1,293 @@
+#include "SymbolIndex.h"
+
+#include <Dyld/ImageIndex.h>
+#include <Provider/Symbolizer.h>
+#include <algorithm>
+#include <fmt/format.h>
+#include <fstream>
+#include <numeric>
+#include <random>
+
+using namespace DyldExtractor;
+using namespace Provider;
+
+/// A symbol while building the table, the name points into the cache or the
+/// accelerator.
+struct SymbolSource {
+  uint64_t address;
+  // Lower is preferred
+  uint8_t priority;
+  std::string_view name;
+};
+
+constexpr uint8_t EXPORT_PRIORITY = 0;
+constexpr uint8_t SYMTAB_PRIORITY = 1;
+
+template <class P>
+static void addNlists(std::vector<SymbolSource> &symbols,
+                      const Macho::Loader::nlist<P> *nlists, uint32_t count,
+                      const char *strings) {
+  for (auto sym = nlists; sym < nlists + count; sym++) {
+    if ((sym->n_type & N_STAB) || (sym->n_type & N_TYPE) != N_SECT) {
+      continue;
+    }
+
+    std::string_view name(strings + sym->n_un.n_strx);
+    if (name.empty() || name == "<redacted>") {
+      continue;
+    }
+    symbols.push_back({sym->n_value, SYMTAB_PRIORITY, name});
+  }
+}
+
+template <class A>
+SymbolIndex
+SymbolIndex::build(const Dyld::Context &dCtx,
+                   Provider::Accelerator<typename A::P> &accelerator,
+                   std::shared_ptr<spdlog::logger> logger,
+                   unsigned int threads) {
+  using P = A::P;
+  using NlistT = Macho::Loader::nlist<P>;
+
+  std::vector<SymbolSource> symbols;
+
+  // Exports of every image
+  Provider::Symbolizer<A>::preloadExports(dCtx, accelerator, logger, threads);
+  {
+    std::shared_lock lock(accelerator.exportsMutex);
+    for (const auto &[path, exports] : accelerator.exportsCache) {
+      for (const auto &e : exports) {
+        symbols.push_back({e.address & -4, EXPORT_PRIORITY, e.entry.name});
+      }
+    }
+  }
+
+  // Symbol tables, and the local symbols of the symbols cache
+  const dyld_cache_local_symbols_info *localSymsInfo = nullptr;
+  if (auto symbolsCache = dCtx.getSymbolsCache();
+      symbolsCache && symbolsCache->header->localSymbolsOffset) {
+    localSymsInfo =
+        (const dyld_cache_local_symbols_info
+             *)(symbolsCache->file + symbolsCache->header->localSymbolsOffset);
+  }
+  const bool vmOffsets =
+      dCtx.headerContainsMember(offsetof(dyld_cache_header, symbolFileUUID));
+
+  for (const auto imageInfo : dCtx.images) {
+    auto mCtx = dCtx.createMachoCtx<true, P>(imageInfo);
+    auto symtab = mCtx.template getFirstLC<Macho::Loader::symtab_command>();
+    auto linkedit = mCtx.getSegment(SEG_LINKEDIT);
+    if (symtab && linkedit) {
+      auto leFile = mCtx.convertAddr(linkedit->command->vmaddr).second;
+      addNlists<P>(symbols, (const NlistT *)(leFile + symtab->symoff),
+                   symtab->nsyms, (const char *)leFile + symtab->stroff);
+    }
+
+    if (localSymsInfo) {
+      const uint64_t machoOffset =
+          vmOffsets ? imageInfo->address - dCtx.header->sharedRegionStart
+                    : dCtx.convertAddr(imageInfo->address).first;
+      if (auto entry = dCtx.findLocalSymbolsEntry(machoOffset)) {
+        auto nlists = (const NlistT *)((const uint8_t *)localSymsInfo +
+                                       localSymsInfo->nlistOffset) +
+                      entry->nlistStartIndex;
+        addNlists<P>(symbols, nlists, entry->nlistCount,
+                     (const char *)localSymsInfo +
+                         localSymsInfo->stringsOffset);
+      }
+    }
+  }
+
+  // One name for each address, the preferred one and then the first by name
+  std::sort(symbols.begin(), symbols.end(), [](const auto &a, const auto &b) {
+    if (a.address != b.address) {
+      return a.address < b.address;
+    }
+    if (a.priority != b.priority) {
+      return a.priority < b.priority;
+    }
+    return a.name < b.name;
+  });
+  symbols.erase(std::unique(symbols.begin(), symbols.end(),
+                            [](const auto &a, const auto &b) {
+                              return a.address == b.address;
+                            }),
+                symbols.end());
+
+  // Symbols end at the next symbol or the end of their segment, symbols
+  // outside of any image are dropped.
+  const auto imageIndex = Dyld::ImageIndex::build<P>(dCtx);
+  SymbolIndex index;
+  index.ownedEntries.reserve(symbols.size());
+  for (std::size_t i = 0; i < symbols.size(); i++) {
+    const auto &sym = symbols[i];
+    auto seg = imageIndex.find(sym.address);
+    if (!seg) {
+      continue;
+    }
+
+    uint64_t end = seg->end;
+    if (i + 1 < symbols.size()) {
+      end = std::min(end, symbols[i + 1].address);
+    }
+    if (index.ownedStrings.size() + sym.name.size() + 1 > UINT32_MAX) {
+      throw std::runtime_error("Symbol names are too large for the index.");
+    }
+
+    index.ownedEntries.push_back(
+        {sym.address, end, (uint32_t)index.ownedStrings.size(),
+         seg->imageIndex});
+    index.ownedStrings.insert(index.ownedStrings.end(), sym.name.begin(),
+                              sym.name.end());
+    index.ownedStrings.push_back('\0');
+  }
+
+  index.useOwned();
+  return index;
+}
+
+std::optional<SymbolIndex> SymbolIndex::load(const fs::path &path,
+                                             const Dyld::Context &dCtx) {
+  // Also rejects empty files, which can't be mapped
+  std::error_code ec;
+  const uint64_t fileSize = fs::file_size(path, ec);
+  if (ec || fileSize < sizeof(Header)) {
+    return std::nullopt;
+  }
+
+  auto file = std::make_shared<bio::mapped_file_source>(path.string());
+  const auto data = (const uint8_t *)file->data();
+
+  const auto header = (const Header *)data;
+  if (memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      header->version != VERSION ||
+      header->imagesCount != dCtx.images.size() ||
+      memcmp(header->uuid, dCtx.header->uuid, 16) != 0 ||
+      header->entriesCount > (fileSize - sizeof(Header)) / sizeof(Entry) ||
+      header->stringsSize != fileSize - sizeof(Header) -
+                                 header->entriesCount * sizeof(Entry)) {
+    return std::nullopt;
+  }
+
+  // Entries are used in place, only their bounds are checked
+  SymbolIndex index;
+  index.entries = (const Entry *)(data + sizeof(Header));
+  index.entriesCount = header->entriesCount;
+  index.strings = (const char *)(index.entries + index.entriesCount);
+  index.stringsSize = header->stringsSize;
+  if (index.stringsSize && index.strings[index.stringsSize - 1] != '\0') {
+    return std::nullopt;
+  }
+  for (std::size_t i = 0; i < index.entriesCount; i++) {
+    const auto &entry = index.entries[i];
+    if (entry.imageIndex >= header->imagesCount ||
+        entry.nameOffset >= index.stringsSize || entry.address >= entry.end ||
+        (i && index.entries[i - 1].end > entry.address)) {
+      return std::nullopt;
+    }
+  }
+
+  index.file = std::move(file);
+  return index;
+}
+
+void SymbolIndex::save(const fs::path &path, const Dyld::Context &dCtx) const {
+  Header header{};
+  memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.imagesCount = (uint32_t)dCtx.images.size();
+  memcpy(header.uuid, dCtx.header->uuid, 16);
+  header.entriesCount = entriesCount;
+  header.stringsSize = stringsSize;
+
+  // Write to a temporary file and replace the old one. The name is unique so
+  // that processes saving at the same time don't write to the same file.
+  auto tmpPath = path;
+  tmpPath += fmt::format(".{:08x}.tmp", std::random_device()());
+  std::ofstream outFile(tmpPath, std::ios_base::binary);
+  if (!outFile.good()) {
+    throw std::runtime_error("Unable to open symbol index file.");
+  }
+  outFile.write((const char *)&header, sizeof(Header));
+  outFile.write((const char *)entries, entriesCount * sizeof(Entry));
+  outFile.write(strings, stringsSize);
+  outFile.close();
+  if (!outFile) {
+    std::error_code ec;
+    fs::remove(tmpPath, ec);
+    throw std::runtime_error("Unable to write symbol index file.");
+  }
+
+  fs::rename(tmpPath, path);
+}
+
+fs::path SymbolIndex::getPath(const fs::path &dir, const Dyld::Context &dCtx) {
+  std::string name;
+  for (int i = 0; i < 16; i++) {
+    name += fmt::format("{:02X}", dCtx.header->uuid[i]);
+  }
+  return dir / (name + ".dyldex_symbols");
+}
+
+std::optional<SymbolIndex::Symbolication>
+SymbolIndex::lookup(uint64_t addr) const {
+  auto it = std::upper_bound(
+      entries, entries + entriesCount, addr,
+      [](uint64_t addr, const Entry &entry) { return addr < entry.address; });
+  if (it == entries) {
+    return std::nullopt;
+  }
+  return resolve(it - 1, addr);
+}
+
+void SymbolIndex::lookup(
+    const std::vector<uint64_t> &addrs,
+    std::vector<std::optional<Symbolication>> &results) const {
+  std::vector<std::size_t> order(addrs.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(),
+            [&](std::size_t a, std::size_t b) { return addrs[a] < addrs[b]; });
+
+  results.assign(addrs.size(), std::nullopt);
+  const Entry *it = entries;
+  const Entry *entriesEnd = entries + entriesCount;
+  for (const auto i : order) {
+    const auto addr = addrs[i];
+    it = std::upper_bound(
+        it, entriesEnd, addr,
+        [](uint64_t addr, const Entry &entry) { return addr < entry.address; });
+    if (it != entries) {
+      results[i] = resolve(it - 1, addr);
+    }
+  }
+}
+
+void SymbolIndex::useOwned() {
+  entries = ownedEntries.data();
+  entriesCount = ownedEntries.size();
+  strings = ownedStrings.data();
+  stringsSize = ownedStrings.size();
+}
+
+std::optional<SymbolIndex::Symbolication>
+SymbolIndex::resolve(const Entry *entry, uint64_t addr) const {
+  if (addr >= entry->end) {
+    return std::nullopt;
+  }
+  return Symbolication{entry->address,
+                       std::string_view(strings + entry->nameOffset),
+                       entry->imageIndex, addr - entry->address};
+}
+
+template SymbolIndex SymbolIndex::build<Utils::Arch::x86_64>(
+    const Dyld::Context &, Provider::Accelerator<Utils::Arch::Pointer64> &,
+    std::shared_ptr<spdlog::logger>, unsigned int);
+template SymbolIndex SymbolIndex::build<Utils::Arch::arm>(
+    const Dyld::Context &, Provider::Accelerator<Utils::Arch::Pointer32> &,
+    std::shared_ptr<spdlog::logger>, unsigned int);
+template SymbolIndex SymbolIndex::build<Utils::Arch::arm64>(
+    const Dyld::Context &, Provider::Accelerator<Utils::Arch::Pointer64> &,
+    std::shared_ptr<spdlog::logger>, unsigned int);
+template SymbolIndex SymbolIndex::build<Utils::Arch::arm64_32>(
+    const Dyld::Context &, Provider::Accelerator<Utils::Arch::Pointer32> &,
+    std::shared_ptr<spdlog::logger>, unsigned int);
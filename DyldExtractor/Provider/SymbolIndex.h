@@ -0,0 +1,122 @@
+#ifndef __PROVIDER_SYMBOLINDEX__
+#define __PROVIDER_SYMBOLINDEX__
+
+#include <Dyld/DyldContext.h>
+#include <Provider/Accelerator.h>
+#include <filesystem>
+#include <optional>
+#include <spdlog/logger.h>
+#include <string_view>
+#include <vector>
+
+namespace DyldExtractor::Provider {
+
+namespace bio = boost::iostreams;
+namespace fs = std::filesystem;
+
+/// @brief A sorted table of the symbols of all images in a cache, for
+/// symbolicating addresses.
+///
+/// The table combines the sources that the Symbolizer uses, the export tries
+/// and the symbol tables, including the local symbols of the symbols cache.
+/// Each address has one name, exports are preferred over local symbols. A
+/// symbol covers the addresses up to the next symbol or the end of its
+/// segment. The table can be saved to a sidecar file named with the UUID of
+/// the cache, which is memory mapped when loaded instead of being read.
+class SymbolIndex {
+public:
+  struct Entry {
+    uint64_t address;
+    /// The end of the addresses covered by the symbol.
+    uint64_t end;
+    /// The offset of the name in the strings.
+    uint32_t nameOffset;
+    uint32_t imageIndex;
+  };
+
+  /// The symbol that covers an address.
+  struct Symbolication {
+    uint64_t address;
+    std::string_view name;
+    uint32_t imageIndex;
+    /// The offset of the address from the symbol.
+    uint64_t offset;
+  };
+
+  static constexpr char MAGIC[8] = {'D', 'Y', 'E', 'X', 'S', 'Y', 'M', 'I'};
+  static constexpr uint32_t VERSION = 1;
+
+  SymbolIndex() = default;
+  SymbolIndex(const SymbolIndex &) = delete;
+  SymbolIndex &operator=(const SymbolIndex &) = delete;
+  SymbolIndex(SymbolIndex &&) = default;
+  SymbolIndex &operator=(SymbolIndex &&) = default;
+
+  /// @brief Build the table from the images of a cache.
+  /// @param accelerator Receives the exports of every image.
+  /// @param threads The maximum number of threads to parse export tries with.
+  template <class A>
+  static SymbolIndex build(const Dyld::Context &dCtx,
+                           Provider::Accelerator<typename A::P> &accelerator,
+                           std::shared_ptr<spdlog::logger> logger,
+                           unsigned int threads);
+
+  /// @brief Map a sidecar file.
+  /// @returns The table, or nullopt if the file doesn't exist or is not for
+  /// the cache.
+  static std::optional<SymbolIndex> load(const fs::path &path,
+                                         const Dyld::Context &dCtx);
+
+  /// @brief Save the table to a sidecar file, replacing the existing one.
+  void save(const fs::path &path, const Dyld::Context &dCtx) const;
+
+  /// @brief Get the path of the sidecar file for a cache.
+  /// @param dir The directory that contains the sidecar files.
+  static fs::path getPath(const fs::path &dir, const Dyld::Context &dCtx);
+
+  /// @brief Find the symbol that covers an address.
+  std::optional<Symbolication> lookup(uint64_t addr) const;
+
+  /// @brief Find the symbols that cover a batch of addresses.
+  ///
+  /// The addresses are visited in sorted order, so each search starts from
+  /// the last found symbol.
+  ///
+  /// @param addrs The addresses, in any order.
+  /// @param results Receives a result for each address, in the same order.
+  void lookup(const std::vector<uint64_t> &addrs,
+              std::vector<std::optional<Symbolication>> &results) const;
+
+  /// @brief The number of symbols in the table.
+  std::size_t size() const { return entriesCount; }
+
+private:
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t imagesCount;
+    uint8_t uuid[16];
+    uint64_t entriesCount;
+    uint64_t stringsSize;
+  };
+
+  // Owned data when the table is built, or the mapped sidecar file
+  std::vector<Entry> ownedEntries;
+  std::vector<char> ownedStrings;
+  std::shared_ptr<bio::mapped_file_source> file;
+
+  // Sorted and not overlapping
+  const Entry *entries = nullptr;
+  std::size_t entriesCount = 0;
+  const char *strings = nullptr;
+  std::size_t stringsSize = 0;
+
+  /// @brief Point to the owned data.
+  void useOwned();
+  std::optional<Symbolication> resolve(const Entry *entry,
+                                       uint64_t addr) const;
+};
+
+} // namespace DyldExtractor::Provider
+
+#endif // __PROVIDER_SYMBOLINDEX__
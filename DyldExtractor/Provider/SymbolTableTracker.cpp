@@ -6,15 +6,15 @@ using namespace DyldExtractor;
 using namespace Provider;
 
 template <class P>
-const std::string &SymbolTableTracker<P>::addString(const std::string &str) {
-  return *strings.insert(str).first;
+typename SymbolTableTracker<P>::StringId
+SymbolTableTracker<P>::addString(std::string_view str) {
+  return strings.add(str);
 }
 
 template <class P>
 SymbolTableTracker<P>::SymbolIndex
-SymbolTableTracker<P>::addSym(SymbolType type, const std::string &str,
+SymbolTableTracker<P>::addSym(SymbolType type, StringId it,
                               const Macho::Loader::nlist<P> &sym) {
-  auto it = strings.find(str);
   uint32_t index;
   switch (type) {
   case SymbolType::other:
@@ -41,8 +41,9 @@ SymbolTableTracker<P>::addSym(SymbolType type, const std::string &str,
 }
 
 template <class P>
-const std::pair<std::set<std::string>::const_iterator, Macho::Loader::nlist<P>>
-    &SymbolTableTracker<P>::getSymbol(const SymbolIndex &index) const {
+const std::pair<typename SymbolTableTracker<P>::StringId,
+                Macho::Loader::nlist<P>> &
+SymbolTableTracker<P>::getSymbol(const SymbolIndex &index) const {
   switch (index.first) {
   case SymbolType::other:
     return syms.other.at(index.second);
@@ -57,6 +58,11 @@ const std::pair<std::set<std::string>::const_iterator, Macho::Loader::nlist<P>>
   }
 }
 
+template <class P>
+std::string_view SymbolTableTracker<P>::getString(StringId id) const {
+  return strings.get(id);
+}
+
 template <class P>
 const typename SymbolTableTracker<P>::StringCache &
 SymbolTableTracker<P>::getStrings() const {
@@ -76,7 +82,7 @@ SymbolTableTracker<P>::getOrMakeRedactedSymIndex() {
     return *redactedSymIndex;
   }
 
-  auto &str = addString("<redacted>");
+  auto str = addString("<redacted>");
   Macho::Loader::nlist<P> sym = {0};
   sym.n_type = 1;
   return redactedSymIndex.emplace(addSym(SymbolType::other, str, sym));
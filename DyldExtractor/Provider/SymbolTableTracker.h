@@ -2,8 +2,8 @@
 #define __PROVIDER__SYMBOLTABLETRACKER__
 
 #include <Macho/Loader.h>
+#include <Utils/StringPool.h>
 #include <optional>
-#include <set>
 #include <string>
 #include <vector>
 
@@ -13,12 +13,13 @@ namespace DyldExtractor::Provider {
 template <class P> class SymbolTableTracker {
 public:
   enum class SymbolType { other, local, external, undefined };
-  using StringCache = std::set<std::string>;
+  using StringCache = Utils::StringPool;
+  using StringId = StringCache::Id;
   using SymbolIndex = std::pair<SymbolType, uint32_t>;
 
   struct SymbolCaches {
-    using SymbolCacheT = std::vector<
-        std::pair<StringCache::const_iterator, Macho::Loader::nlist<P>>>;
+    using SymbolCacheT =
+        std::vector<std::pair<StringId, Macho::Loader::nlist<P>>>;
     SymbolCacheT other;
     SymbolCacheT local;
     SymbolCacheT external;
@@ -32,19 +33,23 @@ public:
   SymbolTableTracker &operator=(SymbolTableTracker &&) = default;
 
   /// @brief Add a string
-  const std::string &addString(const std::string &str);
+  /// @returns The id of the string
+  StringId addString(std::string_view str);
 
   /// @brief Add a symbol
   /// @param type The type of symbol, string index does not have to be valid
-  /// @param str The string associated with the symbol, must already be added
+  /// @param str The id of the string associated with the symbol
   /// @param sym The symbol metadata
   /// @returns The symbol type and index pair.
-  SymbolIndex addSym(SymbolType type, const std::string &str,
+  SymbolIndex addSym(SymbolType type, StringId str,
                      const Macho::Loader::nlist<P> &sym);
 
-  const std::pair<StringCache::const_iterator, Macho::Loader::nlist<P>> &
+  const std::pair<StringId, Macho::Loader::nlist<P>> &
   getSymbol(const SymbolIndex &index) const;
 
+  /// @brief Get a tracked string
+  std::string_view getString(StringId id) const;
+
   /// @brief Get tracked strings
   const StringCache &getStrings() const;
 
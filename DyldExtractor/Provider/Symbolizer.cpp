@@ -1,11 +1,136 @@
 #include "Symbolizer.h"
 
+#include <Utils/Threading.h>
 #include <ranges>
 #include <spdlog/spdlog.h>
 
+/// Minimum number of images that an export parsing thread handles
+#define SYMBOLIZER_MIN_IMAGES_PER_THREAD 16
+
 using namespace DyldExtractor;
 using namespace Provider;
 
+namespace {
+
+/// @brief Parse an export trie without copying each name.
+///
+/// Names and import names are gathered into one block that is stored in the
+/// arena, and entries are in trie layout order like ExportInfoTrie::parseTrie.
+///
+/// @returns If the trie was valid.
+bool parseExportTrie(const uint8_t *start, const uint8_t *end,
+                     AcceleratorTypes::StringArena &arena,
+                     std::vector<AcceleratorTypes::ExportEntryView> &output) {
+  using InfoT = AcceleratorTypes::ExportEntryView::Info;
+  struct PendingEntry {
+    uint64_t nodeOffset;
+    std::size_t nameOffset;
+    std::size_t nameSize;
+    std::size_t importNameOffset;
+    std::size_t importNameSize;
+    InfoT info;
+  };
+  struct PendingNode {
+    const uint8_t *node;
+    std::size_t prefixSize;
+    const uint8_t *edge;
+    std::size_t edgeSize;
+  };
+
+  const auto trieSize = (std::size_t)(end - start);
+  std::vector<PendingEntry> entries;
+  entries.reserve(trieSize / 32);
+  std::string names;
+  names.reserve(trieSize);
+
+  // Depth first, the prefix is shared by all nodes below a node
+  std::string prefix;
+  std::vector<PendingNode> stack{{start, 0, nullptr, 0}};
+  std::size_t visited = 0;
+  while (!stack.empty()) {
+    const auto pending = stack.back();
+    stack.pop_back();
+    if (++visited > trieSize) {
+      return false; // looping trie
+    }
+    prefix.resize(pending.prefixSize);
+    prefix.append((const char *)pending.edge, pending.edgeSize);
+
+    const uint8_t *p = pending.node;
+    uint64_t terminalSize;
+    if (!TrieUtils::parse_uleb128(p, end, terminalSize) ||
+        terminalSize >= (uint64_t)(end - p)) {
+      return false;
+    }
+    const uint8_t *children = p + terminalSize;
+
+    if (terminalSize != 0) {
+      PendingEntry entry{(uint64_t)(p - start), names.size(), prefix.size(),
+                         0, 0, {}};
+      names.append(prefix);
+
+      auto &info = entry.info;
+      TrieUtils::parse_uleb128(p, children, info.flags);
+      if (info.flags & EXPORT_SYMBOL_FLAGS_REEXPORT) {
+        TrieUtils::parse_uleb128(p, children, info.other); // dylib ordinal
+        const auto importName = std::string_view(
+            (const char *)p, strnlen((const char *)p, children - p));
+        entry.importNameOffset = names.size();
+        entry.importNameSize = importName.size();
+        names.append(importName);
+      } else {
+        TrieUtils::parse_uleb128(p, children, info.address);
+        if (info.flags & EXPORT_SYMBOL_FLAGS_STUB_AND_RESOLVER) {
+          TrieUtils::parse_uleb128(p, children, info.other);
+        }
+      }
+      entries.push_back(entry);
+    }
+
+    const uint8_t childrenCount = *children++;
+    const uint8_t *s = children;
+    const auto firstChild = stack.size();
+    for (uint8_t i = 0; i < childrenCount; i++) {
+      const uint8_t *edge = s;
+      while (s < end && *s != '\0') {
+        s++;
+      }
+      if (s >= end) {
+        return false;
+      }
+      const std::size_t edgeSize = s++ - edge;
+
+      uint64_t childOffset;
+      if (!TrieUtils::parse_uleb128(s, end, childOffset) ||
+          childOffset >= trieSize) {
+        return false;
+      }
+      stack.push_back({start + childOffset, prefix.size(), edge, edgeSize});
+    }
+    // Visit children in order
+    std::reverse(stack.begin() + firstChild, stack.end());
+  }
+
+  // to preserve trie layout order, sort by node offset
+  std::sort(entries.begin(), entries.end(),
+            [](const PendingEntry &a, const PendingEntry &b) {
+              return a.nodeOffset < b.nodeOffset;
+            });
+
+  const char *block = arena.store(names.data(), names.size());
+  output.reserve(entries.size());
+  for (const auto &entry : entries) {
+    auto &view = output.emplace_back();
+    view.name = std::string_view(block + entry.nameOffset, entry.nameSize);
+    view.info = entry.info;
+    view.info.importName = std::string_view(block + entry.importNameOffset,
+                                            entry.importNameSize);
+  }
+  return true;
+}
+
+} // namespace
+
 #pragma region SymbolicInfo
 bool SymbolicInfo::Symbol::isReExport() const {
   if (exportFlags && *exportFlags & EXPORT_SYMBOL_FLAGS_REEXPORT) {
@@ -72,6 +197,40 @@ const SymbolicInfo::Symbol &SymbolicInfo::preferredSymbol() const {
 }
 #pragma endregion SymbolicInfo
 
+#pragma region SymbolicInfoStore
+SymbolicInfoStore::Id
+SymbolicInfoStore::intern(SymbolicInfo::Symbol sym,
+                          SymbolicInfo::Encoding encoding) {
+  if (auto it = interned.find({sym.name, sym.ordinal, encoding});
+      it != interned.end()) {
+    return it->second;
+  }
+
+  const auto info = emplace(std::move(sym), encoding);
+  const auto id = ref(info);
+  const auto &stored = *info->symbols.begin();
+  interned.emplace(std::make_tuple(std::string_view(stored.name),
+                                   stored.ordinal, encoding),
+                   id);
+  return id;
+}
+
+SymbolicInfoStore::Id SymbolicInfoStore::ref(const SymbolicInfo *info) {
+  auto [it, inserted] = ids.try_emplace(info, (Id)table.size());
+  if (inserted) {
+    table.push_back(info);
+  }
+  return it->second;
+}
+
+void SymbolicInfoStore::clear() {
+  interned.clear();
+  ids.clear();
+  table.clear();
+  infos.clear();
+}
+#pragma endregion SymbolicInfoStore
+
 #pragma region Symbolizer
 template <class A>
 Symbolizer<A>::Symbolizer(const Dyld::Context &dCtx,
@@ -79,70 +238,334 @@ Symbolizer<A>::Symbolizer(const Dyld::Context &dCtx,
                           Provider::Accelerator<P> &accelerator,
                           Provider::ActivityLogger &activity,
                           std::shared_ptr<spdlog::logger> logger,
-                          const Provider::SymbolTableTracker<P> &stTracker)
+                          const Provider::SymbolTableTracker<P> &stTracker,
+                          bool lazy)
     : dCtx(&dCtx), mCtx(&mCtx), accelerator(&accelerator), activity(&activity),
-      logger(logger), stTracker(&stTracker) {
-  activity.update(std::nullopt, "Enumerating Symbols");
-  enumerateExports();
-  enumerateSymbols();
+      logger(logger), stTracker(&stTracker), lazy(lazy) {
+  loadPathToImage(dCtx, accelerator);
+
+  // All dylibs including itself, the index is the ordinal.
+  dylibs = mCtx.template getAllLCs<Macho::Loader::dylib_command>();
+
+  if (lazy) {
+    activity.update(std::nullopt, "Indexing Symbols");
+    buildSourceIndex();
+  } else {
+    activity.update(std::nullopt, "Enumerating Symbols");
+    enumerateExports();
+    enumerateSymbols();
+  }
+}
+
+template <class A>
+void Symbolizer<A>::preloadExports(const Dyld::Context &dCtx,
+                                   Provider::Accelerator<P> &accelerator,
+                                   std::shared_ptr<spdlog::logger> logger,
+                                   unsigned int threads) {
+  loadPathToImage(dCtx, accelerator);
+
+  // Images without exports, some may come from an accelerator cache
+  std::vector<std::pair<std::string, const dyld_cache_image_info *>> images;
+  {
+    std::shared_lock lock(accelerator.exportsMutex);
+    for (const auto &[path, image] : accelerator.pathToImage) {
+      if (!accelerator.exportsCompleted.contains(path)) {
+        images.emplace_back(path, image);
+      }
+    }
+  }
+
+  // Parse the tries in parallel, which is most of the work
+  std::vector<std::vector<ExportEntryView>> parsed(images.size());
+  Utils::parallelChunks(
+      Utils::chunkCount(threads, images.size(),
+                        SYMBOLIZER_MIN_IMAGES_PER_THREAD),
+      images.size(), [&](std::size_t, std::size_t begin, std::size_t end) {
+        for (auto i = begin; i < end; i++) {
+          const auto &[path, image] = images[i];
+          parsed[i] = readExports(accelerator, logger, path,
+                                  dCtx.createMachoCtx<true, P>(image));
+        }
+      });
+  {
+    std::unique_lock lock(accelerator.exportsMutex);
+    for (std::size_t i = 0; i < images.size(); i++) {
+      accelerator.parsedExports.try_emplace(images[i].first,
+                                            std::move(parsed[i]));
+    }
+  }
+
+  // Resolve reexports, which takes the parsed tries
+  for (const auto &[path, image] : images) {
+    processDylib(dCtx, accelerator, logger, path, false);
+  }
+}
+
+template <class A>
+void Symbolizer<A>::loadPathToImage(const Dyld::Context &dCtx,
+                                    Provider::Accelerator<P> &accelerator) {
+  std::call_once(accelerator.pathToImageOnce, [&]() {
+    for (auto image : dCtx.images) {
+      std::string path((char *)(dCtx.file + image->pathFileOffset));
+      accelerator.pathToImage[path] = image;
+    }
+  });
 }
 
 template <class A>
 const SymbolicInfo *Symbolizer<A>::symbolizeAddr(PtrT addr) const {
-  if (symbols.contains(addr)) {
-    return symbols.at(addr).get();
+  std::unique_lock lock(lazyMutex, std::defer_lock);
+  if (lazy) {
+    lock.lock();
+    loadSources(addr);
+  }
+
+  if (auto it = symbols.find(addr); it != symbols.end()) {
+    return &it->second;
   } else {
     return nullptr;
   }
 }
 
 template <class A> bool Symbolizer<A>::containsAddr(PtrT addr) const {
+  std::unique_lock lock(lazyMutex, std::defer_lock);
+  if (lazy) {
+    lock.lock();
+    loadSources(addr);
+  }
+
   return symbols.contains(addr);
 }
 
 template <class A>
-std::shared_ptr<SymbolicInfo> Symbolizer<A>::shareInfo(PtrT addr) const {
-  return symbols.at(addr);
-}
-
-template <class A> void Symbolizer<A>::enumerateExports() {
-  // Populate accelerator's pathToImage if needed
-  if (accelerator->pathToImage.empty()) {
-    for (auto image : dCtx->images) {
-      std::string path((char *)(dCtx->file + image->pathFileOffset));
-      accelerator->pathToImage[path] = image;
-    }
+const SymbolicInfo *Symbolizer<A>::shareInfo(PtrT addr) const {
+  std::unique_lock lock(lazyMutex, std::defer_lock);
+  if (lazy) {
+    lock.lock();
+    loadSources(addr);
   }
 
+  return &symbols.at(addr);
+}
+
+template <class A> void Symbolizer<A>::enumerateExports() const {
   // Process all dylibs including itself.
-    auto dylibs = mCtx->template getAllLCs<Macho::Loader::dylib_command>();
   for (uint64_t i = 0; i < dylibs.size(); i++) {
     activity->update();
+    addExports(i, processDylibCmd(dylibs[i]));
+  }
+}
 
-    const auto &exports = processDylibCmd(dylibs[i]);
-    for (const auto &e : exports) {
-      PtrT addr = e.address & -4;
-
-      if (symbols.contains(addr)) {
-        symbols.at(addr)->addSymbol({e.entry.name, i, e.entry.info.flags});
+template <class A>
+void Symbolizer<A>::addExports(uint64_t ordinal,
+                               const EntryMapT &exports) const {
+  for (const auto &e : exports) {
+    PtrT addr = e.address & -4;
+
+    if (auto it = symbols.find(addr); it != symbols.end()) {
+      it->second.addSymbol(
+          {std::string(e.entry.name), ordinal, e.entry.info.flags});
+    } else {
+      SymbolicInfo::Encoding enc;
+      if constexpr (std::is_same_v<A, Utils::Arch::arm>) {
+        enc = static_cast<SymbolicInfo::Encoding>(e.address & 3);
       } else {
-        SymbolicInfo::Encoding enc;
-        if constexpr (std::is_same_v<A, Utils::Arch::arm>) {
-          enc = static_cast<SymbolicInfo::Encoding>(e.address & 3);
-        } else {
-          enc = SymbolicInfo::Encoding::None;
+        enc = SymbolicInfo::Encoding::None;
+      }
+
+      symbols.emplace(
+          addr, SymbolicInfo(SymbolicInfo::Symbol{std::string(e.entry.name),
+                                                  ordinal, e.entry.info.flags},
+                             enc));
+    }
+  }
+}
+
+template <class A> void Symbolizer<A>::buildSourceIndex() {
+  struct Entry {
+    PtrT start;
+    PtrT end;
+    std::size_t source;
+  };
+  std::vector<Entry> entries;
+
+  // A dylib can have exports in its own image and in every image of its
+  // reexport chain.
+  for (std::size_t i = 0; i < dylibs.size(); i++) {
+    const std::string dylibPath(
+        (char *)((uint8_t *)dylibs[i] + dylibs[i]->dylib.name.offset));
+    if (!accelerator->pathToImage.contains(dylibPath)) {
+      continue; // Won't have exports
+    }
+
+    std::set<std::string> visited{dylibPath};
+    std::vector<std::string> pending{dylibPath};
+    while (!pending.empty()) {
+      const auto imagePath = std::move(pending.back());
+      pending.pop_back();
+
+      const auto &links = getImageLinks(imagePath);
+      for (const auto &[start, end] : links.segments) {
+        entries.push_back({(PtrT)start, (PtrT)end, i});
+      }
+      for (const auto &reExport : links.reExports) {
+        if (accelerator->pathToImage.contains(reExport) &&
+            visited.insert(reExport).second) {
+          pending.push_back(reExport);
         }
+      }
+    }
+  }
+
+  // The image's own symbols, read after its exports like in eager mode.
+  localSource = dylibs.size();
+  for (const auto &seg : mCtx->segments) {
+    if (strncmp(seg.command->segname, SEG_LINKEDIT, 16) == 0) {
+      continue;
+    }
+    entries.push_back({seg.command->vmaddr,
+                       seg.command->vmaddr + seg.command->vmsize, localSource});
+  }
+  loadedSources.assign(localSource + 1, false);
+
+  // Split overlapping entries into ranges that each have one set of sources
+  std::vector<PtrT> bounds;
+  bounds.reserve(entries.size() * 2);
+  for (const auto &entry : entries) {
+    bounds.push_back(entry.start);
+    bounds.push_back(entry.end);
+  }
+  std::sort(bounds.begin(), bounds.end());
+  bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry &a, const Entry &b) { return a.start < b.start; });
+
+  std::vector<const Entry *> active;
+  std::size_t next = 0;
+  for (std::size_t i = 0; i + 1 < bounds.size(); i++) {
+    const auto start = bounds[i];
+    const auto end = bounds[i + 1];
+    std::erase_if(active, [start](const Entry *e) { return e->end <= start; });
+    while (next < entries.size() && entries[next].start <= start) {
+      active.push_back(&entries[next++]);
+    }
+    if (active.empty()) {
+      continue;
+    }
 
-        symbols.emplace(
-            addr, std::make_shared<SymbolicInfo>(
-                      SymbolicInfo::Symbol{e.entry.name, i, e.entry.info.flags},
-                      enc));
+    const auto sourcesBegin = rangeSources.size();
+    for (const auto entry : active) {
+      rangeSources.push_back(entry->source);
+    }
+    std::sort(rangeSources.begin() + sourcesBegin, rangeSources.end());
+    rangeSources.erase(
+        std::unique(rangeSources.begin() + sourcesBegin, rangeSources.end()),
+        rangeSources.end());
+
+    // Extend the last range if it has the same sources
+    if (!sourceRanges.empty()) {
+      auto &last = sourceRanges.back();
+      if (last.end == start &&
+          std::equal(rangeSources.begin() + last.sourcesBegin,
+                     rangeSources.begin() + last.sourcesEnd,
+                     rangeSources.begin() + sourcesBegin,
+                     rangeSources.end())) {
+        last.end = end;
+        rangeSources.resize(sourcesBegin);
+        continue;
       }
     }
+    sourceRanges.push_back({start, end, sourcesBegin, rangeSources.size()});
+  }
+}
+
+template <class A> void Symbolizer<A>::loadSources(PtrT addr) const {
+  auto it = std::upper_bound(
+      sourceRanges.begin(), sourceRanges.end(), addr,
+      [](PtrT a, const SourceRange &range) { return a < range.start; });
+  if (it == sourceRanges.begin() || addr >= (--it)->end) {
+    return;
+  }
+
+  // Sources are sorted, so the image's own symbols are read last
+  for (auto i = it->sourcesBegin; i < it->sourcesEnd; i++) {
+    const auto source = rangeSources[i];
+    if (loadedSources[source]) {
+      continue;
+    }
+    loadedSources[source] = true;
+
+    activity->update();
+    if (source == localSource) {
+      enumerateSymbols();
+    } else {
+      addExports(source, processDylibCmd(dylibs[source]));
+    }
+  }
+}
+
+template <class A>
+const AcceleratorTypes::SymbolizerImageLinks &
+Symbolizer<A>::getImageLinks(const std::string &imagePath) const {
+  {
+    std::shared_lock lock(accelerator->imageLinksMutex);
+    if (auto it = accelerator->imageLinks.find(imagePath);
+        it != accelerator->imageLinks.end()) {
+      return it->second;
+    }
+  }
+
+  AcceleratorTypes::SymbolizerImageLinks links;
+  const auto imageCtx =
+      dCtx->createMachoCtx<true, P>(accelerator->pathToImage.at(imagePath));
+  for (const auto &seg : imageCtx.segments) {
+    if (strncmp(seg.command->segname, SEG_LINKEDIT, 16) == 0) {
+      continue;
+    }
+    links.segments.emplace_back(seg.command->vmaddr,
+                                seg.command->vmaddr + seg.command->vmsize);
+  }
+  auto deps = imageCtx.template getAllLCs<Macho::Loader::dylib_command>();
+  deps.erase(std::remove_if(deps.begin(), deps.end(),
+                            [](auto d) { return d->cmd == LC_ID_DYLIB; }),
+             deps.end());
+  for (const auto dep : deps) {
+    if (dep->cmd == LC_REEXPORT_DYLIB) {
+      links.reExports.emplace_back(
+          (char *)((uint8_t *)dep + dep->dylib.name.offset));
+    }
+  }
+
+  // Individual reexports resolve to an export of their dependency
+  auto exports = readExports(*accelerator, logger, imagePath, imageCtx);
+  std::set<uint64_t> ordinals;
+  for (const auto &e : exports) {
+    if (e.info.flags & EXPORT_SYMBOL_FLAGS_REEXPORT) {
+      ordinals.insert(e.info.other);
+    }
+  }
+  for (const auto ordinal : ordinals) {
+    if (ordinal && ordinal <= deps.size() &&
+        deps[ordinal - 1]->cmd != LC_REEXPORT_DYLIB) {
+      const auto dep = deps[ordinal - 1];
+      links.reExports.emplace_back(
+          (char *)((uint8_t *)dep + dep->dylib.name.offset));
+    }
+  }
+  {
+    // Keep the parsed trie for building the exports, unless that started
+    std::unique_lock lock(accelerator->exportsMutex);
+    if (!accelerator->exportsCache.contains(imagePath)) {
+      accelerator->parsedExports.try_emplace(imagePath, std::move(exports));
+    }
   }
+
+  std::unique_lock lock(accelerator->imageLinksMutex);
+  return accelerator->imageLinks.try_emplace(imagePath, std::move(links))
+      .first->second;
 }
 
-template <class A> void Symbolizer<A>::enumerateSymbols() {
+template <class A> void Symbolizer<A>::enumerateSymbols() const {
   const auto symCaches = stTracker->getSymbolCaches();
   processSymbolCache(symCaches.other);
   processSymbolCache(symCaches.external);
@@ -151,15 +574,16 @@ template <class A> void Symbolizer<A>::enumerateSymbols() {
 template <class A>
 void Symbolizer<A>::processSymbolCache(
     const typename Provider::SymbolTableTracker<P>::SymbolCaches::SymbolCacheT
-        &symCache) {
-  for (const auto &[strIt, sym] : symCache) {
+        &symCache) const {
+  for (const auto &[strId, sym] : symCache) {
     if ((sym.n_type & N_TYPE) != N_SECT) {
       continue;
     }
 
     auto addr = sym.n_value;
-    if (symbols.contains(addr)) {
-      symbols.at(addr)->addSymbol({*strIt, SELF_LIBRARY_ORDINAL, std::nullopt});
+    if (auto it = symbols.find(addr); it != symbols.end()) {
+      it->second.addSymbol({std::string(stTracker->getString(strId)),
+                            SELF_LIBRARY_ORDINAL, std::nullopt});
     } else {
       SymbolicInfo::Encoding enc;
       if constexpr (std::is_same_v<A, Utils::Arch::arm>) {
@@ -168,10 +592,11 @@ void Symbolizer<A>::processSymbolCache(
         enc = SymbolicInfo::Encoding::None;
       }
 
-      symbols.emplace(addr, std::make_shared<SymbolicInfo>(
-                                SymbolicInfo::Symbol{
-                                    *strIt, SELF_LIBRARY_ORDINAL, std::nullopt},
-                                enc));
+      symbols.emplace(
+          addr, SymbolicInfo(
+                    SymbolicInfo::Symbol{std::string(stTracker->getString(strId)),
+                                         SELF_LIBRARY_ORDINAL, std::nullopt},
+                    enc));
     }
 
     activity->update();
@@ -183,28 +608,86 @@ typename Symbolizer<A>::EntryMapT &Symbolizer<A>::processDylibCmd(
     const Macho::Loader::dylib_command *dylibCmd) const {
   const std::string dylibPath(
       (char *)((uint8_t *)dylibCmd + dylibCmd->dylib.name.offset));
-  if (accelerator->exportsCache.contains(dylibPath)) {
-    return accelerator->exportsCache[dylibPath];
+  return processDylib(*dCtx, *accelerator, logger, dylibPath,
+                      dylibCmd->cmd == LC_LOAD_WEAK_DYLIB);
+}
+
+template <class A>
+typename Symbolizer<A>::EntryMapT &Symbolizer<A>::processDylib(
+    const Dyld::Context &dCtx, Provider::Accelerator<P> &accelerator,
+    const std::shared_ptr<spdlog::logger> &logger, const std::string &dylibPath,
+    bool weak) {
+  {
+    std::shared_lock lock(accelerator.exportsMutex);
+    if (accelerator.exportsCompleted.contains(dylibPath)) {
+      return accelerator.exportsCache.at(dylibPath);
+    }
   }
-  if (!accelerator->pathToImage.contains(dylibPath)) {
-    if (dylibCmd->cmd != LC_LOAD_WEAK_DYLIB) {
+
+  if (!accelerator.pathToImage.contains(dylibPath)) {
+    if (!weak) {
       /// It may refer to images outside the cache, but it doesn't seem to
       /// affect anything
       SPDLOG_LOGGER_DEBUG(logger, "Unable to find image with path {}.",
                           dylibPath);
     }
 
-    return accelerator->exportsCache[dylibPath]; // Empty map
+    std::unique_lock lock(accelerator.exportsMutex);
+    accelerator.exportsCompleted.insert(dylibPath);
+    return accelerator.exportsCache[dylibPath]; // Empty map
   }
 
-  // dequeue empty map to fill
-  auto &exportsMap = accelerator->exportsCache[dylibPath];
+  // Each entry is built by one thread, and different entries are built at the
+  // same time. If the entry is being built by another thread, wait for it,
+  // unless that thread is waiting for this one because reexports are cyclic.
+  // Then the partial entry is used, which doesn't change while its builder
+  // waits. This thread may also be building it already.
+  const auto thisThread = std::this_thread::get_id();
+  EntryMapT *exportsMapPtr;
+  {
+    std::unique_lock lock(accelerator.exportsMutex);
+    while (true) {
+      if (accelerator.exportsCompleted.contains(dylibPath)) {
+        return accelerator.exportsCache.at(dylibPath);
+      }
+      auto building = accelerator.exportsBuilding.find(dylibPath);
+      if (building == accelerator.exportsBuilding.end()) {
+        break;
+      }
+      if (waitsForThread(accelerator, building->second, thisThread)) {
+        return accelerator.exportsCache.at(dylibPath);
+      }
+
+      accelerator.exportsWaiting[thisThread] = dylibPath;
+      accelerator.exportsBuilt.wait(lock);
+      accelerator.exportsWaiting.erase(thisThread);
+    }
+
+    accelerator.exportsBuilding[dylibPath] = thisThread;
+    exportsMapPtr = &accelerator.exportsCache[dylibPath];
+  }
+  auto &exportsMap = *exportsMapPtr;
+
+  // Complete the entry when leaving, also by an exception, so waiting threads
+  // continue
+  struct Completer {
+    Provider::Accelerator<P> &accelerator;
+    const std::string &dylibPath;
+    ~Completer() {
+      std::unique_lock lock(accelerator.exportsMutex);
+      accelerator.exportsCompleted.insert(dylibPath);
+      accelerator.exportsBuilding.erase(dylibPath);
+      accelerator.exportsBuilt.notify_all();
+    }
+  } completer{accelerator, dylibPath};
 
   // process exports
-  const auto imageInfo = accelerator->pathToImage.at(dylibPath);
-  const auto dylibCtx = dCtx->createMachoCtx<true, P>(imageInfo);
-  const auto rawExports = readExports(dylibPath, dylibCtx);
-  std::map<uint64_t, std::vector<ExportInfoTrie::Entry>> reExports;
+  const auto imageInfo = accelerator.pathToImage.at(dylibPath);
+  const auto dylibCtx = dCtx.createMachoCtx<true, P>(imageInfo);
+  const auto rawExports =
+      readExports(accelerator, logger, dylibPath, dylibCtx);
+  exportsMap.reserve(rawExports.size());
+  std::map<uint64_t, std::vector<ExportEntryView>> reExports;
   for (const auto &e : rawExports) {
     if (e.info.flags & EXPORT_SYMBOL_FLAGS_REEXPORT) {
       reExports[e.info.other].push_back(e);
@@ -232,7 +715,10 @@ typename Symbolizer<A>::EntryMapT &Symbolizer<A>::processDylibCmd(
                   dylibDeps.end());
   for (const auto &[ordinal, exports] : reExports) {
     const auto ordinalCmd = dylibDeps[ordinal - 1];
-    const auto &ordinalExports = processDylibCmd(ordinalCmd);
+    const auto &ordinalExports = processDylib(
+        dCtx, accelerator, logger,
+        (char *)((uint8_t *)ordinalCmd + ordinalCmd->dylib.name.offset),
+        ordinalCmd->cmd == LC_LOAD_WEAK_DYLIB);
     if (!ordinalExports.size()) {
       // In case the image was not found or if it didn't have any exports.
       continue;
@@ -260,7 +746,9 @@ typename Symbolizer<A>::EntryMapT &Symbolizer<A>::processDylibCmd(
   for (const auto &dep : dylibDeps) {
     if (dep->cmd == LC_REEXPORT_DYLIB) {
       // Use parent ordinal because symbols are reexported.
-      const auto reExports = processDylibCmd(dep);
+      const auto reExports = processDylib(
+          dCtx, accelerator, logger,
+          (char *)((uint8_t *)dep + dep->dylib.name.offset), false);
       exportsMap.insert(reExports.begin(), reExports.end());
     }
   }
@@ -269,11 +757,49 @@ typename Symbolizer<A>::EntryMapT &Symbolizer<A>::processDylibCmd(
 }
 
 template <class A>
-std::vector<ExportInfoTrie::Entry>
-Symbolizer<A>::readExports(const std::string &dylibPath,
-                           const Macho::Context<true, P> &dylibCtx) const {
+bool Symbolizer<A>::waitsForThread(const Provider::Accelerator<P> &accelerator,
+                                   std::thread::id builder,
+                                   std::thread::id thread) {
+  // Follow the chain of builders that are waiting for other entries. Waiting
+  // threads never form a cycle among themselves, so the chain has at most one
+  // step per waiting thread.
+  for (std::size_t i = 0; i <= accelerator.exportsWaiting.size(); i++) {
+    if (builder == thread) {
+      return true;
+    }
+
+    const auto waiting = accelerator.exportsWaiting.find(builder);
+    if (waiting == accelerator.exportsWaiting.end()) {
+      return false;
+    }
+    const auto next = accelerator.exportsBuilding.find(waiting->second);
+    if (next == accelerator.exportsBuilding.end()) {
+      return false;
+    }
+    builder = next->second;
+  }
+  return false;
+}
+
+template <class A>
+std::vector<AcceleratorTypes::ExportEntryView>
+Symbolizer<A>::readExports(Provider::Accelerator<P> &accelerator,
+                           const std::shared_ptr<spdlog::logger> &logger,
+                           const std::string &dylibPath,
+                           const Macho::Context<true, P> &dylibCtx) {
+  // Use the trie if it was already parsed
+  {
+    std::unique_lock lock(accelerator.exportsMutex);
+    if (auto it = accelerator.parsedExports.find(dylibPath);
+        it != accelerator.parsedExports.end()) {
+      auto exports = std::move(it->second);
+      accelerator.parsedExports.erase(it);
+      return exports;
+    }
+  }
+
   // read exports
-  std::vector<ExportInfoTrie::Entry> exports;
+  std::vector<AcceleratorTypes::ExportEntryView> exports;
   const uint8_t *exportsStart;
   const uint8_t *exportsEnd;
   const auto linkeditFile =
@@ -296,7 +822,8 @@ Symbolizer<A>::readExports(const std::string &dylibPath,
 
   if (exportsStart == exportsEnd) {
     // Some images like UIKIT don't have exports.
-  } else if (!ExportInfoTrie::parseTrie(exportsStart, exportsEnd, exports)) {
+  } else if (!parseExportTrie(exportsStart, exportsEnd,
+                              accelerator.exportStrings, exports)) {
     SPDLOG_LOGGER_ERROR(logger, "Unable to read exports for '{}'.", dylibPath);
   }
 
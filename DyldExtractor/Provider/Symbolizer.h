@@ -6,7 +6,13 @@
 #include <Dyld/DyldContext.h>
 #include <Macho/MachoContext.h>
 #include <Provider/Accelerator.h>
+#include <deque>
 #include <fmt/format.h>
+#include <map>
+#include <mutex>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
 
 namespace DyldExtractor::Provider {
 
@@ -55,19 +61,87 @@ public:
   Encoding encoding;
 };
 
+/// @brief Owns symbolic info for an extraction.
+///
+/// Infos are never moved or freed before the store, so they can be shared by
+/// pointer between the trackers and converters. Binds refer to infos by a
+/// 32 bit id, which also covers infos owned by a symbolizer. Not thread safe.
+class SymbolicInfoStore {
+public:
+  using Id = uint32_t;
+
+  /// @brief Construct a symbolic info in the store.
+  /// @returns A pointer that is valid for the lifetime of the store.
+  template <class... Args> const SymbolicInfo *emplace(Args &&...args) {
+    return &infos.emplace_back(std::forward<Args>(args)...);
+  }
+
+  /// @brief Construct a symbolic info in the store, and give it an id.
+  template <class... Args> Id add(Args &&...args) {
+    return ref(emplace(std::forward<Args>(args)...));
+  }
+
+  /// @brief Get the id of a single symbol info, infos with the same name,
+  ///   ordinal, and encoding share one id.
+  Id intern(SymbolicInfo::Symbol sym, SymbolicInfo::Encoding encoding);
+
+  /// @brief Get the id of an info, giving it one if it doesn't have one.
+  /// @param info An info that outlives the store's use, it does not need to
+  ///   be owned by the store.
+  Id ref(const SymbolicInfo *info);
+
+  /// @brief Get the info of an id.
+  const SymbolicInfo &get(Id id) const { return *table[id]; }
+
+  /// @brief The number of infos in the store.
+  std::size_t size() const { return infos.size(); }
+
+  /// @brief Destroy all infos, pointers to them and ids are invalidated.
+  void clear();
+
+private:
+  std::deque<SymbolicInfo> infos;
+  std::vector<const SymbolicInfo *> table;
+  std::unordered_map<const SymbolicInfo *, Id> ids;
+  // Names are views of the interned infos' symbols
+  std::map<std::tuple<std::string_view, uint64_t, SymbolicInfo::Encoding>, Id>
+      interned;
+};
+
 template <class A> class Symbolizer {
   using P = A::P;
   using PtrT = P::PtrT;
 
 public:
+  /// @brief Create a symbolizer for an image.
+  /// @param lazy If exports and symbols are read on demand. Instead of
+  ///   reading every dependency up front, a lookup only reads the
+  ///   dependencies whose image, or an image that they reexport from,
+  ///   contains the address. A lookup can then add symbols to an info that
+  ///   another thread is reading, so a lazy symbolizer must only be used
+  ///   from one thread at a time.
   Symbolizer(const Dyld::Context &dCtx, Macho::Context<false, P> &mCtx,
              Provider::Accelerator<P> &accelerator,
              Provider::ActivityLogger &activity,
              std::shared_ptr<spdlog::logger> logger,
-             const Provider::SymbolTableTracker<P> &stTracker);
+             const Provider::SymbolTableTracker<P> &stTracker,
+             bool lazy = false);
   Symbolizer(const Symbolizer &) = delete;
   Symbolizer &operator=(const Symbolizer &) = delete;
 
+  /// @brief Build the exports of every image in the cache up front.
+  ///
+  /// The export tries are parsed in parallel, then reexports are resolved.
+  /// Afterwards the accelerator has the exports of every image and they are
+  /// read only, so symbolizers only look them up, and saving the accelerator
+  /// gives a complete export index.
+  ///
+  /// @param threads The maximum number of threads to parse tries with.
+  static void preloadExports(const Dyld::Context &dCtx,
+                             Provider::Accelerator<P> &accelerator,
+                             std::shared_ptr<spdlog::logger> logger,
+                             unsigned int threads);
+
   /// @brief Look for a symbol
   /// @param addr The address of the symbol. Without instruction bits.
   /// @return A pointer to the symbolic info or a nullptr
@@ -78,25 +152,56 @@ public:
   /// @return If there is symbolic info
   bool containsAddr(PtrT addr) const;
 
-  /// @brief Get a shared pointer for a symbolic info
-  /// @param addr The address without instruction bits
-  /// @return A new shared pointer
-  std::shared_ptr<SymbolicInfo> shareInfo(PtrT addr) const;
+  /// @brief Get a symbolic info that can be shared
+  /// @param addr The address without instruction bits, must have info
+  /// @return A pointer that is valid for the lifetime of the symbolizer
+  const SymbolicInfo *shareInfo(PtrT addr) const;
 
 private:
-  void enumerateExports();
-  void enumerateSymbols();
+  void enumerateExports() const;
+  void enumerateSymbols() const;
   void processSymbolCache(
       const typename Provider::SymbolTableTracker<P>::SymbolCaches::SymbolCacheT
-          &symCache);
+          &symCache) const;
+
+  /// An address range and the sources that could have symbols in it. A
+  /// source is the ordinal of a dylib command, or localSource for the
+  /// image's own symbol table.
+  struct SourceRange {
+    PtrT start;
+    PtrT end;
+    std::size_t sourcesBegin;
+    std::size_t sourcesEnd;
+  };
+
+  /// @brief Build the source ranges for lazy mode.
+  void buildSourceIndex();
+  /// @brief Read every source that could have symbols at the address.
+  void loadSources(PtrT addr) const;
+  const AcceleratorTypes::SymbolizerImageLinks &
+  getImageLinks(const std::string &imagePath) const;
 
   using ExportEntry = Provider::AcceleratorTypes::SymbolizerExportEntry;
   using EntryMapT = Provider::AcceleratorTypes::SymbolizerExportEntryMapT;
+  using ExportEntryView = Provider::AcceleratorTypes::ExportEntryView;
   EntryMapT &
   processDylibCmd(const Macho::Loader::dylib_command *dylibCmd) const;
-  std::vector<ExportInfoTrie::Entry>
-  readExports(const std::string &dylibPath,
-              const Macho::Context<true, P> &dylibCtx) const;
+  static EntryMapT &processDylib(const Dyld::Context &dCtx,
+                                 Provider::Accelerator<P> &accelerator,
+                                 const std::shared_ptr<spdlog::logger> &logger,
+                                 const std::string &dylibPath, bool weak);
+  /// @brief If the builder of an exports entry waits, through the builders
+  ///   of other entries, for a thread. Needs exportsMutex.
+  static bool waitsForThread(const Provider::Accelerator<P> &accelerator,
+                             std::thread::id builder, std::thread::id thread);
+  static std::vector<ExportEntryView>
+  readExports(Provider::Accelerator<P> &accelerator,
+              const std::shared_ptr<spdlog::logger> &logger,
+              const std::string &dylibPath,
+              const Macho::Context<true, P> &dylibCtx);
+  static void loadPathToImage(const Dyld::Context &dCtx,
+                              Provider::Accelerator<P> &accelerator);
+  void addExports(uint64_t ordinal, const EntryMapT &exports) const;
 
   const Dyld::Context *dCtx;
   Macho::Context<false, P> *mCtx;
@@ -105,9 +210,20 @@ private:
   std::shared_ptr<spdlog::logger> logger;
   const Provider::SymbolTableTracker<P> *stTracker;
 
-  std::map<PtrT, std::shared_ptr<SymbolicInfo>> symbols;
+  /// Filled on demand by lookups in lazy mode.
+  mutable std::map<PtrT, SymbolicInfo> symbols;
 
   bool dataLoaded = false;
+
+  bool lazy;
+  /// Guards symbols and loadedSources in lazy mode.
+  mutable std::mutex lazyMutex;
+  std::vector<Macho::Loader::dylib_command *> dylibs;
+  std::size_t localSource = 0;
+  /// Sorted, non overlapping ranges.
+  std::vector<SourceRange> sourceRanges;
+  std::vector<std::size_t> rangeSources;
+  mutable std::vector<bool> loadedSources;
 };
 
 } // namespace DyldExtractor::Provider
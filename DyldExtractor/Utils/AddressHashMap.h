@@ -0,0 +1,221 @@
+#ifndef __UTILS_ADDRESSHASHMAP__
+#define __UTILS_ADDRESSHASHMAP__
+
+#include <algorithm>
+#include <deque>
+#include <stdexcept>
+#include <stdint.h>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace DyldExtractor::Utils {
+
+/// @brief An open addressing index of entries keyed by address.
+///
+/// Only pointers are stored, the entries are owned elsewhere and must not
+/// move while they are indexed. Slots are found with Fibonacci hashing and
+/// linear probing, and the load factor is kept under a half.
+///
+/// @tparam K The key type, an address.
+/// @tparam E The entry type, with the key in its first member.
+template <class K, class E> class AddressIndex {
+public:
+  /// @brief Size the index for a number of entries.
+  void reserve(std::size_t count) {
+    if (count * 2 > slots.size()) {
+      auto newBits = std::max(bits, MIN_BITS);
+      while ((std::size_t(1) << newBits) < count * 2) {
+        newBits++;
+      }
+      rebuild(newBits);
+    }
+  }
+
+  /// @brief Find an entry.
+  /// @returns The entry, or nullptr.
+  E *find(const K key) const {
+    if (slots.empty()) {
+      return nullptr;
+    }
+
+    const auto mask = slots.size() - 1;
+    for (auto slot = slotFor(key);; slot = (slot + 1) & mask) {
+      const auto entry = slots[slot];
+      if (!entry || entry->first == key) {
+        return entry;
+      }
+    }
+  }
+
+  /// @brief Add an entry, its key must not be in the index.
+  void insert(E *entry) {
+    if ((count + 1) * 2 > slots.size()) {
+      rebuild(std::max(bits + 1, MIN_BITS));
+    }
+    place(entry);
+    count++;
+  }
+
+  /// @brief Remove the entry of a key, if there is one.
+  void erase(const K key) {
+    if (!find(key)) {
+      return;
+    }
+
+    const auto mask = slots.size() - 1;
+    auto slot = slotFor(key);
+    while (slots[slot]->first != key) {
+      slot = (slot + 1) & mask;
+    }
+
+    // Shift back later entries in the probe sequence
+    for (auto next = (slot + 1) & mask; slots[next];
+         next = (next + 1) & mask) {
+      const auto home = slotFor(slots[next]->first);
+      if (((next - home) & mask) >= ((next - slot) & mask)) {
+        slots[slot] = slots[next];
+        slot = next;
+      }
+    }
+    slots[slot] = nullptr;
+    count--;
+  }
+
+  std::size_t size() const { return count; }
+
+private:
+  static constexpr unsigned int MIN_BITS = 6;
+
+  /// Entries or nullptr for empty slots. The size is a power of 2.
+  std::vector<E *> slots;
+  unsigned int bits = 0;
+  std::size_t count = 0;
+
+  std::size_t slotFor(const K key) const {
+    // Fibonacci hashing, addresses are aligned so the high bits are used
+    return (std::size_t)(((uint64_t)key * 0x9E3779B97F4A7C15ULL) >>
+                         (64 - bits));
+  }
+
+  void place(E *entry) {
+    const auto mask = slots.size() - 1;
+    auto slot = slotFor(entry->first);
+    while (slots[slot]) {
+      slot = (slot + 1) & mask;
+    }
+    slots[slot] = entry;
+  }
+
+  void rebuild(unsigned int newBits) {
+    std::vector<E *> oldSlots(std::size_t(1) << newBits, nullptr);
+    oldSlots.swap(slots);
+    bits = newBits;
+    for (const auto entry : oldSlots) {
+      if (entry) {
+        place(entry);
+      }
+    }
+  }
+};
+
+/// @brief An open addressing hash map for addresses.
+///
+/// Values are stored in insertion order and never move, so references to
+/// them stay valid. Size the map with reserve when the number of keys is
+/// known, like the number of pointers in a section, so it doesn't rehash.
+///
+/// @tparam K The key type, an address.
+/// @tparam V The value type.
+template <class K, class V> class AddressHashMap {
+public:
+  using value_type = std::pair<const K, V>;
+  using iterator = std::deque<value_type>::iterator;
+  using const_iterator = std::deque<value_type>::const_iterator;
+
+  AddressHashMap() = default;
+  // The index points into entries, so a copy would point into the original.
+  // Moving a deque keeps its elements in place.
+  AddressHashMap(const AddressHashMap &) = delete;
+  AddressHashMap &operator=(const AddressHashMap &) = delete;
+  AddressHashMap(AddressHashMap &&) = default;
+  AddressHashMap &operator=(AddressHashMap &&) = default;
+
+  /// @brief Size the index for a number of keys.
+  void reserve(std::size_t count) { index.reserve(count); }
+
+  /// @brief Find a value.
+  /// @returns A pointer to the value, or nullptr.
+  V *find(const K key) {
+    const auto entry = index.find(key);
+    return entry ? &entry->second : nullptr;
+  }
+  const V *find(const K key) const {
+    const auto entry = index.find(key);
+    return entry ? &entry->second : nullptr;
+  }
+
+  bool contains(const K key) const { return index.find(key) != nullptr; }
+
+  V &at(const K key) {
+    if (auto value = find(key); value) {
+      return *value;
+    }
+    throw std::out_of_range("AddressHashMap::at");
+  }
+  const V &at(const K key) const {
+    if (auto value = find(key); value) {
+      return *value;
+    }
+    throw std::out_of_range("AddressHashMap::at");
+  }
+
+  /// @brief Construct a value if the key doesn't exist.
+  /// @returns The value and if it was constructed.
+  template <class... Args>
+  std::pair<V *, bool> try_emplace(const K key, Args &&...args) {
+    if (auto value = find(key); value) {
+      return std::make_pair(value, false);
+    }
+
+    entries.emplace_back(std::piecewise_construct, std::forward_as_tuple(key),
+                         std::forward_as_tuple(std::forward<Args>(args)...));
+    index.insert(&entries.back());
+    return std::make_pair(&entries.back().second, true);
+  }
+
+  std::size_t size() const { return entries.size(); }
+  bool empty() const { return entries.empty(); }
+
+  /// @brief Iterate in insertion order.
+  iterator begin() { return entries.begin(); }
+  iterator end() { return entries.end(); }
+  const_iterator begin() const { return entries.begin(); }
+  const_iterator end() const { return entries.end(); }
+
+private:
+  // A deque, so entries don't move when more are added
+  std::deque<value_type> entries;
+  AddressIndex<K, value_type> index;
+};
+
+/// @brief An open addressing hash set for addresses.
+template <class K> class AddressHashSet {
+public:
+  void reserve(std::size_t count) { map.reserve(count); }
+
+  /// @returns If the key was inserted.
+  bool insert(const K key) { return map.try_emplace(key).second; }
+  bool contains(const K key) const { return map.contains(key); }
+
+  std::size_t size() const { return map.size(); }
+  bool empty() const { return map.empty(); }
+
+private:
+  struct Empty {};
+  AddressHashMap<K, Empty> map;
+};
+
+} // namespace DyldExtractor::Utils
+
+#endif // __UTILS_ADDRESSHASHMAP__
@@ -0,0 +1,250 @@
+#ifndef __UTILS_ADDRESSMAP__
+#define __UTILS_ADDRESSMAP__
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace DyldExtractor::Utils {
+
+/// @brief A flat ordered map for addresses.
+///
+/// Keys and values are stored in separate sorted arrays. Assignments are
+/// appended to a pending list, and merged in a single sort by freeze, so
+/// filling the map does not allocate per element. The map must be frozen
+/// before it is read, after which it can be read from multiple threads.
+///
+/// @tparam K The key type, an address.
+/// @tparam V The value type.
+template <class K, class V> class AddressMap {
+public:
+  using key_type = K;
+  using mapped_type = V;
+  using size_type = std::size_t;
+
+  class Iterator {
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = std::pair<K, V>;
+    using difference_type = std::ptrdiff_t;
+    using reference = std::pair<K, const V &>;
+
+    struct Arrow {
+      reference ref;
+      const reference *operator->() const { return &ref; }
+    };
+    using pointer = Arrow;
+
+    Iterator() = default;
+    Iterator(const AddressMap *map, std::size_t index)
+        : map(map), index(index) {}
+
+    reference operator*() const {
+      return {map->keys[index], map->values[index]};
+    }
+    Arrow operator->() const { return {**this}; }
+    reference operator[](difference_type n) const { return *(*this + n); }
+
+    Iterator &operator++() {
+      index++;
+      return *this;
+    }
+    Iterator operator++(int) {
+      auto tmp = *this;
+      index++;
+      return tmp;
+    }
+    Iterator &operator--() {
+      index--;
+      return *this;
+    }
+    Iterator operator--(int) {
+      auto tmp = *this;
+      index--;
+      return tmp;
+    }
+    Iterator &operator+=(difference_type n) {
+      index += n;
+      return *this;
+    }
+    Iterator &operator-=(difference_type n) {
+      index -= n;
+      return *this;
+    }
+    Iterator operator+(difference_type n) const {
+      return Iterator(map, index + n);
+    }
+    Iterator operator-(difference_type n) const {
+      return Iterator(map, index - n);
+    }
+    difference_type operator-(const Iterator &rhs) const {
+      return (difference_type)index - (difference_type)rhs.index;
+    }
+
+    bool operator==(const Iterator &rhs) const { return index == rhs.index; }
+    auto operator<=>(const Iterator &rhs) const { return index <=> rhs.index; }
+
+    /// @brief The position of the iterator in the map.
+    std::size_t getIndex() const { return index; }
+
+  private:
+    const AddressMap *map = nullptr;
+    std::size_t index = 0;
+  };
+
+  using const_iterator = Iterator;
+
+  /// @brief Insert or overwrite a value.
+  void assign(K key, V value) {
+    pending.emplace_back(key, std::move(value));
+  }
+
+  /// @brief Reserve space for assignments.
+  void reserve(std::size_t count) { pending.reserve(count); }
+
+  /// @brief Merge pending assignments, later assignments win.
+  void freeze() {
+    if (pending.empty()) {
+      return;
+    }
+
+    std::stable_sort(
+        pending.begin(), pending.end(),
+        [](const auto &a, const auto &b) { return a.first < b.first; });
+
+    // Keep the last assignment of each key
+    std::size_t unique = 0;
+    for (std::size_t i = 0; i < pending.size(); i++) {
+      if (i + 1 < pending.size() && pending[i].first == pending[i + 1].first) {
+        continue;
+      }
+      if (unique != i) {
+        pending[unique] = std::move(pending[i]);
+      }
+      unique++;
+    }
+    pending.resize(unique);
+
+    if (keys.empty() || keys.back() < pending.front().first) {
+      // Fast path, everything is after the existing keys
+      keys.reserve(keys.size() + pending.size());
+      values.reserve(values.size() + pending.size());
+      for (auto &[key, value] : pending) {
+        keys.push_back(key);
+        values.push_back(std::move(value));
+      }
+    } else {
+      std::vector<K> newKeys;
+      std::vector<V> newValues;
+      newKeys.reserve(keys.size() + pending.size());
+      newValues.reserve(keys.size() + pending.size());
+
+      std::size_t i = 0;
+      auto pendingIt = pending.begin();
+      while (i < keys.size() || pendingIt != pending.end()) {
+        if (pendingIt == pending.end() ||
+            (i < keys.size() && keys[i] < pendingIt->first)) {
+          newKeys.push_back(keys[i]);
+          newValues.push_back(std::move(values[i]));
+          i++;
+        } else {
+          if (i < keys.size() && keys[i] == pendingIt->first) {
+            i++; // Overwritten
+          }
+          newKeys.push_back(pendingIt->first);
+          newValues.push_back(std::move(pendingIt->second));
+          pendingIt++;
+        }
+      }
+
+      keys = std::move(newKeys);
+      values = std::move(newValues);
+    }
+
+    pending.clear();
+  }
+
+  /// @brief Remove all keys in a range.
+  /// @param start The first key to remove.
+  /// @param end The last key to remove, inclusive.
+  void eraseRange(K start, K end) {
+    freeze();
+    auto first = lowerIndex(start);
+    auto last = upperIndex(end);
+    if (first < last) {
+      keys.erase(keys.begin() + first, keys.begin() + last);
+      values.erase(values.begin() + first, values.begin() + last);
+    }
+  }
+
+  Iterator begin() const {
+    checkFrozen();
+    return Iterator(this, 0);
+  }
+  Iterator end() const {
+    checkFrozen();
+    return Iterator(this, keys.size());
+  }
+
+  Iterator lower_bound(K key) const {
+    checkFrozen();
+    return Iterator(this, lowerIndex(key));
+  }
+  Iterator upper_bound(K key) const {
+    checkFrozen();
+    return Iterator(this, upperIndex(key));
+  }
+
+  Iterator find(K key) const {
+    checkFrozen();
+    auto i = lowerIndex(key);
+    return Iterator(this, i < keys.size() && keys[i] == key ? i : keys.size());
+  }
+
+  bool contains(K key) const { return find(key) != end(); }
+
+  const V &at(K key) const {
+    auto it = find(key);
+    if (it == end()) {
+      throw std::out_of_range("AddressMap::at");
+    }
+    return values[it.getIndex()];
+  }
+
+  std::size_t size() const {
+    checkFrozen();
+    return keys.size();
+  }
+
+  bool empty() const { return size() == 0; }
+
+  /// @brief Remove all keys, keeping the allocated space.
+  void clear() {
+    keys.clear();
+    values.clear();
+    pending.clear();
+  }
+
+private:
+  std::vector<K> keys;
+  std::vector<V> values;
+  std::vector<std::pair<K, V>> pending;
+
+  std::size_t lowerIndex(K key) const {
+    return std::lower_bound(keys.begin(), keys.end(), key) - keys.begin();
+  }
+  std::size_t upperIndex(K key) const {
+    return std::upper_bound(keys.begin(), keys.end(), key) - keys.begin();
+  }
+
+  void checkFrozen() const {
+    assert(pending.empty() && "AddressMap read before freeze");
+  }
+};
+
+} // namespace DyldExtractor::Utils
+
+#endif // __UTILS_ADDRESSMAP__
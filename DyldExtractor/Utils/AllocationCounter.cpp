@@ -0,0 +1,132 @@
+#include "AllocationCounter.h"
+
+#ifdef DYLDEXTRACTORC_COUNT_ALLOCATIONS
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+#endif
+
+using namespace DyldExtractor;
+using namespace Utils;
+
+#ifdef DYLDEXTRACTORC_COUNT_ALLOCATIONS
+
+static thread_local AllocationCounter::Counts threadCounts;
+
+bool AllocationCounter::enabled() { return true; }
+AllocationCounter::Counts AllocationCounter::get() { return threadCounts; }
+void AllocationCounter::setPeak(int64_t peakLiveBytes) {
+  threadCounts.peakLiveBytes = peakLiveBytes;
+}
+
+/// Every block starts with a header that holds its size, padded to the
+/// alignment of the block.
+static std::size_t headerSize(std::size_t alignment) {
+  return std::max<std::size_t>(alignment, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+static void *countedAllocate(std::size_t size, std::size_t alignment) {
+  const auto header = headerSize(alignment);
+  void *block;
+#ifndef _WIN32
+  if (alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+    block = std::malloc(header + size);
+  } else if (posix_memalign(&block, alignment, header + size)) {
+    block = nullptr;
+  }
+#else
+  block = _aligned_malloc(header + size, header);
+#endif
+  if (!block) {
+    return nullptr;
+  }
+
+  auto data = (uint8_t *)block + header;
+  ((std::size_t *)data)[-1] = size;
+
+  auto &counts = threadCounts;
+  counts.allocations++;
+  counts.bytes += size;
+  counts.liveBytes += size;
+  counts.peakLiveBytes = std::max(counts.peakLiveBytes, counts.liveBytes);
+  return data;
+}
+
+static void countedFree(void *data, std::size_t alignment) {
+  if (!data) {
+    return;
+  }
+
+  threadCounts.liveBytes -= ((std::size_t *)data)[-1];
+  void *block = (uint8_t *)data - headerSize(alignment);
+#ifndef _WIN32
+  std::free(block);
+#else
+  _aligned_free(block);
+#endif
+}
+
+static void *throwingAllocate(std::size_t size, std::size_t alignment) {
+  if (auto data = countedAllocate(size, alignment)) {
+    return data;
+  }
+  throw std::bad_alloc();
+}
+
+void *operator new(std::size_t size) {
+  return throwingAllocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+void *operator new[](std::size_t size) {
+  return throwingAllocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+void *operator new(std::size_t size, std::align_val_t alignment) {
+  return throwingAllocate(size, (std::size_t)alignment);
+}
+void *operator new[](std::size_t size, std::align_val_t alignment) {
+  return throwingAllocate(size, (std::size_t)alignment);
+}
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  return countedAllocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+  return countedAllocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void operator delete(void *data) noexcept {
+  countedFree(data, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+void operator delete[](void *data) noexcept {
+  countedFree(data, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+void operator delete(void *data, std::size_t) noexcept {
+  countedFree(data, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+void operator delete[](void *data, std::size_t) noexcept {
+  countedFree(data, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+void operator delete(void *data, std::align_val_t alignment) noexcept {
+  countedFree(data, (std::size_t)alignment);
+}
+void operator delete[](void *data, std::align_val_t alignment) noexcept {
+  countedFree(data, (std::size_t)alignment);
+}
+void operator delete(void *data, std::size_t,
+                     std::align_val_t alignment) noexcept {
+  countedFree(data, (std::size_t)alignment);
+}
+void operator delete[](void *data, std::size_t,
+                       std::align_val_t alignment) noexcept {
+  countedFree(data, (std::size_t)alignment);
+}
+
+#else
+
+bool AllocationCounter::enabled() { return false; }
+AllocationCounter::Counts AllocationCounter::get() { return {}; }
+void AllocationCounter::setPeak(int64_t) {}
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef __UTILS_ALLOCATIONCOUNTER__
+#define __UTILS_ALLOCATIONCOUNTER__
+
+#include <stdint.h>
+
+/// Counts the allocations made through the global operator new of each
+/// thread. The counting operators are only built with the
+/// DYLDEXTRACTORC_COUNT_ALLOCATIONS option, otherwise all counts are 0.
+namespace DyldExtractor::Utils::AllocationCounter {
+
+struct Counts {
+  /// The number of allocations
+  uint64_t allocations = 0;
+  /// The total size of all allocations
+  uint64_t bytes = 0;
+  /// The size of the allocations that are not freed yet. Memory can be freed
+  /// by another thread, so this can be negative.
+  int64_t liveBytes = 0;
+  /// The highest liveBytes since the last resetPeak
+  int64_t peakLiveBytes = 0;
+};
+
+/// @brief If the counting operators are built.
+bool enabled();
+
+/// @brief Get the counts of the calling thread.
+Counts get();
+
+/// @brief Set the peak of the calling thread.
+void setPeak(int64_t peakLiveBytes);
+
+/// @brief Measures the allocations of the calling thread in a scope.
+class Scope {
+public:
+  Scope() : start(get()) { setPeak(start.liveBytes); }
+  Scope(const Scope &) = delete;
+  Scope &operator=(const Scope &) = delete;
+
+  /// Restores the peak of an enclosing scope.
+  ~Scope() {
+    const auto current = get();
+    if (current.peakLiveBytes < start.peakLiveBytes) {
+      setPeak(start.peakLiveBytes);
+    }
+  }
+
+  /// @brief Get the counts since the scope started. The peak is the most
+  ///   memory that was live at once on top of the memory at the start.
+  Counts counts() const {
+    const auto current = get();
+    return {current.allocations - start.allocations,
+            current.bytes - start.bytes, current.liveBytes - start.liveBytes,
+            current.peakLiveBytes - start.liveBytes};
+  }
+
+private:
+  Counts start;
+};
+
+} // namespace DyldExtractor::Utils::AllocationCounter
+
+#endif // __UTILS_ALLOCATIONCOUNTER__
@@ -14,6 +14,25 @@ ExtractionContext<A>::ExtractionContext(const Dyld::Context &dCtx,
       disasm(mCtx, activity, logger, funcTracker),
       funcTracker(mCtx, logger), ptrTracker(dCtx, logger) {}
 
+template <class A>
+void ExtractionContext<A>::reset(Macho::Context<false, P> &mCtx,
+                                 Provider::ActivityLogger &activity) {
+  // Stage providers may refer to the others, destroy them first
+  exObjc.reset();
+  symbolizer.reset();
+  stTracker.reset();
+  leTracker.reset();
+
+  this->mCtx = &mCtx;
+  this->activity = &activity;
+  logger = activity.getLogger();
+  bindInfo.reset(mCtx, activity);
+  funcTracker.reset(mCtx, logger);
+  disasm.reset(mCtx, activity, logger);
+  ptrTracker.reset(logger);
+  symbolStore.clear();
+}
+
 template class DyldExtractor::Utils::ExtractionContext<Arch::x86_64>;
 template class DyldExtractor::Utils::ExtractionContext<Arch::arm>;
 template class DyldExtractor::Utils::ExtractionContext<Arch::arm64>;
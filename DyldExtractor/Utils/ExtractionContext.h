@@ -31,12 +31,22 @@ public:
   Provider::Disassembler<A> disasm;
   Provider::FunctionTracker<P> funcTracker;
   Provider::PointerTracker<P> ptrTracker;
+  /// Owns symbolic info that isn't owned by a provider, like binds.
+  Provider::SymbolicInfoStore symbolStore;
 
   std::optional<Provider::Symbolizer<A>> symbolizer;
   std::optional<Provider::LinkeditTracker<P>> leTracker;
   std::optional<Provider::SymbolTableTracker<P>> stTracker;
   std::optional<Provider::ExtraData<P>> exObjc;
 
+  /// The number of threads that a stage may use within this image.
+  unsigned int threads = 1;
+  /// If the symbolizer reads symbols as they are looked up. Lookups then
+  /// change the symbols that other stages read, so this needs one thread.
+  bool lazySymbols = false;
+  /// If the rebase and bind opcodes are picked for the smallest size.
+  bool optimizeOpcodes = false;
+
   ExtractionContext(const Dyld::Context &dCtx, Macho::Context<false, P> &mCtx,
                     Provider::Accelerator<P> &accelerator,
                     Provider::ActivityLogger &activity);
@@ -44,6 +54,18 @@ public:
   ExtractionContext &operator=(const ExtractionContext<A> &other) = delete;
   ExtractionContext(ExtractionContext<A> &&other) = delete;
   ExtractionContext &operator=(ExtractionContext<A> &&other) = delete;
+
+  /// @brief Reuse the context for another image of the same cache.
+  ///
+  /// The providers are reset instead of being made again, so they keep
+  /// their space and the disassembler keeps its capstone handle. Providers
+  /// that are made by the stages are destroyed. Everything from the old
+  /// image is invalidated, including the symbolic info store.
+  ///
+  /// @param mCtx The new macho context.
+  /// @param activity The new activity logger.
+  void reset(Macho::Context<false, P> &mCtx,
+             Provider::ActivityLogger &activity);
 };
 
 };     // namespace DyldExtractor::Utils
@@ -0,0 +1,60 @@
+#ifndef __UTILS_HASH__
+#define __UTILS_HASH__
+
+#include <bit>
+#include <cstring>
+#include <stdint.h>
+
+namespace DyldExtractor::Utils {
+
+/// @brief A fast non cryptographic 64 bit hash, for fingerprinting large
+/// inputs.
+///
+/// Data is mixed a word at a time. The hash depends on how the data is split
+/// between calls to update, so hash the same data the same way.
+class Hasher64 {
+public:
+  Hasher64(uint64_t seed = 0) : state(seed ^ 0x9E3779B97F4A7C15ULL) {}
+
+  void update(const void *data, std::size_t size) {
+    auto p = (const uint8_t *)data;
+    length += size;
+    for (; size >= 8; p += 8, size -= 8) {
+      uint64_t word;
+      memcpy(&word, p, sizeof(word));
+      mix(word);
+    }
+    if (size) {
+      uint64_t word = 0;
+      memcpy(&word, p, size);
+      mix(word ^ ((uint64_t)size << 56));
+    }
+  }
+
+  uint64_t digest() const {
+    // Finalizer from MurmurHash3
+    uint64_t h = state ^ length;
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+  }
+
+private:
+  uint64_t state;
+  uint64_t length = 0;
+
+  void mix(uint64_t word) {
+    word *= 0x87C37B91114253D5ULL;
+    word = std::rotl(word, 31);
+    word *= 0x4CF5AD432745937FULL;
+    state ^= word;
+    state = std::rotl(state, 27) * 5 + 0x52DCE729;
+  }
+};
+
+} // namespace DyldExtractor::Utils
+
+#endif // __UTILS_HASH__
@@ -1,10 +1,50 @@
 #include "Leb128.h"
 
+#include <bit>
+#include <cstring>
 #include <stdexcept>
 
 using namespace DyldExtractor;
 
-uint64_t Utils::readUleb128(const uint8_t *&p, const uint8_t *end) {
+namespace {
+
+constexpr uint64_t CONTINUATION_BITS = 0x8080808080808080ULL;
+
+/// @brief Load 8 bytes, the caller must check that they are available.
+inline uint64_t loadWord(const uint8_t *p) {
+  uint64_t word;
+  std::memcpy(&word, p, sizeof(word));
+  if constexpr (std::endian::native == std::endian::big) {
+    word = __builtin_bswap64(word);
+  }
+  return word;
+}
+
+/// @brief Decode a leb of up to 8 bytes from a word without branching.
+/// @param word The little endian word containing the leb.
+/// @param size Set to the size of the leb, or 0 if it's longer than 8 bytes.
+inline uint64_t decodeWord(uint64_t word, unsigned &size) {
+  // The first byte without a continuation bit ends the leb
+  const uint64_t stops = ~word & CONTINUATION_BITS;
+  if (!stops) {
+    size = 0;
+    return 0;
+  }
+  const unsigned stopBit = (unsigned)std::countr_zero(stops);
+  size = (stopBit >> 3) + 1;
+
+  // Keep only the bytes in the leb, and compact the 7 bit groups
+  word &= (~0ULL >> (63 - stopBit)) & ~CONTINUATION_BITS;
+  word = (word & 0x007F007F007F007FULL) |
+         ((word & 0x7F007F007F007F00ULL) >> 1);
+  word = (word & 0x00003FFF00003FFFULL) |
+         ((word & 0x3FFF00003FFF0000ULL) >> 2);
+  word = (word & 0x000000000FFFFFFFULL) |
+         ((word & 0x0FFFFFFF00000000ULL) >> 4);
+  return word;
+}
+
+uint64_t readUleb128Slow(const uint8_t *&p, const uint8_t *end) {
   uint64_t result = 0;
   int bit = 0;
   do {
@@ -23,7 +63,7 @@ uint64_t Utils::readUleb128(const uint8_t *&p, const uint8_t *end) {
   return result;
 }
 
-int64_t Utils::readSleb128(const uint8_t *&p, const uint8_t *end) {
+int64_t readSleb128Slow(const uint8_t *&p, const uint8_t *end) {
   int64_t result = 0;
   int bit = 0;
   uint8_t byte = 0;
@@ -41,6 +81,70 @@ int64_t Utils::readSleb128(const uint8_t *&p, const uint8_t *end) {
   return result;
 }
 
+} // namespace
+
+uint64_t Utils::readUleb128(const uint8_t *&p, const uint8_t *end) {
+  // Most values are a single byte
+  if (p != end && !(*p & 0x80)) {
+    return *p++;
+  }
+
+  if (end - p >= 8) {
+    unsigned size;
+    const auto value = decodeWord(loadWord(p), size);
+    if (size) {
+      p += size;
+      return value;
+    }
+  }
+  return readUleb128Slow(p, end);
+}
+
+int64_t Utils::readSleb128(const uint8_t *&p, const uint8_t *end) {
+  if (end - p >= 8) {
+    unsigned size;
+    const auto value = decodeWord(loadWord(p), size);
+    if (size) {
+      p += size;
+      // sign extend from the last group, at most 56 bits are used
+      const unsigned shift = 64 - (size * 7);
+      return (int64_t)(value << shift) >> shift;
+    }
+  }
+  return readSleb128Slow(p, end);
+}
+
+std::size_t Utils::readUleb128Stream(const uint8_t *&p, const uint8_t *end,
+                                     std::vector<uint64_t> &out) {
+  const auto startSize = out.size();
+  while (p != end && *p) {
+    if (end - p >= 8) {
+      const auto word = loadWord(p);
+
+      // A run of 8 single byte values without a terminator
+      const bool hasZero =
+          ((word - 0x0101010101010101ULL) & ~word & CONTINUATION_BITS) != 0;
+      if (!(word & CONTINUATION_BITS) && !hasZero) {
+        for (int i = 0; i < 8; i++) {
+          out.push_back(p[i]);
+        }
+        p += 8;
+        continue;
+      }
+
+      unsigned size;
+      const auto value = decodeWord(word, size);
+      if (size) {
+        out.push_back(value);
+        p += size;
+        continue;
+      }
+    }
+    out.push_back(readUleb128Slow(p, end));
+  }
+  return out.size() - startSize;
+}
+
 void Utils::appendUleb128(std::vector<uint8_t> &out, uint64_t value) {
   uint8_t byte;
   do {
@@ -53,6 +157,14 @@ void Utils::appendUleb128(std::vector<uint8_t> &out, uint64_t value) {
   } while (byte >= 0x80);
 }
 
+std::size_t Utils::uleb128Size(uint64_t value) {
+  std::size_t size = 1;
+  while (value >>= 7) {
+    size++;
+  }
+  return size;
+}
+
 void Utils::appendSleb128(std::vector<uint8_t> &out, int64_t value) {
   bool isNeg = (value < 0);
   uint8_t byte;
@@ -8,7 +8,19 @@ namespace DyldExtractor::Utils {
 
 uint64_t readUleb128(const uint8_t *&p, const uint8_t *end);
 int64_t readSleb128(const uint8_t *&p, const uint8_t *end);
+
+/// @brief Read a packed stream of ulebs, like LC_FUNCTION_STARTS.
+/// @param p The start of the stream, updated to the end of the last value.
+/// @param end The end of the data.
+/// @param out The decoded values are appended to this.
+/// @returns The number of values decoded. Stops at the end of the data or on
+///   a zero byte, which is not consumed.
+std::size_t readUleb128Stream(const uint8_t *&p, const uint8_t *end,
+                              std::vector<uint64_t> &out);
+
 void appendUleb128(std::vector<uint8_t> &out, uint64_t value);
+/// @brief Get the number of bytes that a value takes as a uleb.
+std::size_t uleb128Size(uint64_t value);
 void appendSleb128(std::vector<uint8_t> &out, int64_t value);
 
 } // namespace DyldExtractor::Utils
@@ -0,0 +1,114 @@
+#include "PerfCounters.h"
+
+#include <atomic>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace DyldExtractor;
+using namespace Utils;
+
+static std::atomic_bool countingEnabled = false;
+
+bool PerfCounters::enabled() { return countingEnabled; }
+
+#ifdef __linux__
+
+namespace {
+
+/// The counters of one thread, in the order of Counts.
+class ThreadCounters {
+public:
+  static constexpr int COUNTERS = 5;
+
+  ThreadCounters() {
+    auto cacheEvent = [](uint64_t cache) {
+      return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+             (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    };
+
+    fds[0] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    fds[1] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    fds[2] = open(PERF_TYPE_HW_CACHE, cacheEvent(PERF_COUNT_HW_CACHE_LL));
+    fds[3] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    fds[4] = open(PERF_TYPE_HW_CACHE, cacheEvent(PERF_COUNT_HW_CACHE_DTLB));
+  }
+
+  ~ThreadCounters() {
+    for (auto fd : fds) {
+      if (fd != -1) {
+        close(fd);
+      }
+    }
+  }
+
+  ThreadCounters(const ThreadCounters &) = delete;
+  ThreadCounters &operator=(const ThreadCounters &) = delete;
+
+  PerfCounters::Counts read() const {
+    return {read(fds[0]), read(fds[1]), read(fds[2]), read(fds[3]),
+            read(fds[4])};
+  }
+
+private:
+  int fds[COUNTERS];
+
+  /// @brief Open a counter of the calling thread in user space. Threads it
+  ///   starts inherit the counter, and add to it when they exit.
+  /// @returns The file descriptor, or -1 if the counter isn't available.
+  static int open(uint32_t type, uint64_t config) {
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format =
+        PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+  }
+
+  /// @brief Read a counter, scaled up if it shared the hardware with other
+  ///   counters.
+  static uint64_t read(int fd) {
+    if (fd == -1) {
+      return 0;
+    }
+
+    uint64_t values[3];
+    if (::read(fd, values, sizeof(values)) != sizeof(values) || !values[2]) {
+      return 0;
+    }
+    if (values[1] == values[2]) {
+      return values[0];
+    }
+    return (uint64_t)((double)values[0] * values[1] / values[2]);
+  }
+};
+
+} // namespace
+
+bool PerfCounters::supported() { return true; }
+
+void PerfCounters::enable() { countingEnabled = true; }
+
+PerfCounters::Counts PerfCounters::get() {
+  if (!countingEnabled) {
+    return {};
+  }
+
+  static thread_local ThreadCounters counters;
+  return counters.read();
+}
+
+#else
+
+bool PerfCounters::supported() { return false; }
+void PerfCounters::enable() {}
+PerfCounters::Counts PerfCounters::get() { return {}; }
+
+#endif
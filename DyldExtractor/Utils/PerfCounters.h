@@ -0,0 +1,60 @@
+#ifndef __UTILS_PERFCOUNTERS__
+#define __UTILS_PERFCOUNTERS__
+
+#include <stdint.h>
+
+/// Reads hardware performance counters of each thread. Counting is opt in
+/// with enable, and only supported on Linux through perf_event_open,
+/// otherwise all counts are 0.
+namespace DyldExtractor::Utils::PerfCounters {
+
+struct Counts {
+  uint64_t cycles = 0;
+  uint64_t instructions = 0;
+  /// Last level cache read misses
+  uint64_t llcMisses = 0;
+  uint64_t branchMisses = 0;
+  /// Data TLB read misses
+  uint64_t dtlbMisses = 0;
+};
+
+/// @brief If counters can be read on this platform.
+bool supported();
+
+/// @brief Start counting on every thread, counters are opened by each thread
+///   when it first reads them. Counters that the system doesn't allow stay 0.
+void enable();
+
+/// @brief If counting was enabled.
+bool enabled();
+
+/// @brief Get the counts of the calling thread since its counters were
+///   opened. Threads it started after that, like the chunks of
+///   parallelChunks, are included once they exit.
+Counts get();
+
+/// @brief Measures the counters of the calling thread and the threads it
+///   joins in a scope.
+class Scope {
+public:
+  Scope() : start(get()) {}
+  Scope(const Scope &) = delete;
+  Scope &operator=(const Scope &) = delete;
+
+  /// @brief Get the counts since the scope started.
+  Counts counts() const {
+    const auto current = get();
+    return {current.cycles - start.cycles,
+            current.instructions - start.instructions,
+            current.llcMisses - start.llcMisses,
+            current.branchMisses - start.branchMisses,
+            current.dtlbMisses - start.dtlbMisses};
+  }
+
+private:
+  Counts start;
+};
+
+} // namespace DyldExtractor::Utils::PerfCounters
+
+#endif // __UTILS_PERFCOUNTERS__
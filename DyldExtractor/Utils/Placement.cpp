@@ -0,0 +1,148 @@
+#include "Placement.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+using namespace DyldExtractor;
+using namespace Utils;
+
+std::optional<Placement::Policy>
+Placement::parsePolicy(std::string_view name) {
+  if (name == "none") {
+    return Policy::None;
+  } else if (name == "core") {
+    return Policy::Core;
+  } else if (name == "node") {
+    return Policy::Node;
+  }
+  return std::nullopt;
+}
+
+#ifdef __linux__
+
+/// @brief Parse a sysfs CPU list, like "0-3,8-11".
+static std::vector<unsigned int> parseCpuList(const std::string &list) {
+  std::vector<unsigned int> cpus;
+  std::istringstream stream(list);
+  std::string range;
+  while (std::getline(stream, range, ',')) {
+    try {
+      const auto dash = range.find('-');
+      const auto first = (unsigned int)std::stoul(range.substr(0, dash));
+      const auto last = dash == std::string::npos
+                            ? first
+                            : (unsigned int)std::stoul(range.substr(dash + 1));
+      for (auto cpu = first; cpu <= last; cpu++) {
+        cpus.push_back(cpu);
+      }
+    } catch (const std::logic_error &) {
+      // Trailing new line or malformed range
+    }
+  }
+  return cpus;
+}
+
+std::vector<std::vector<unsigned int>> Placement::getNodes() {
+  namespace fs = std::filesystem;
+
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  const bool haveAllowed =
+      sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+  auto isAllowed = [&](unsigned int cpu) {
+    return !haveAllowed || (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed));
+  };
+
+  // Nodes ordered by their number
+  std::vector<std::pair<unsigned int, std::vector<unsigned int>>> numbered;
+  std::error_code ec;
+  for (const auto &entry :
+       fs::directory_iterator("/sys/devices/system/node", ec)) {
+    const auto name = entry.path().filename().string();
+    if (name.rfind("node", 0) != 0 || name.size() == 4 ||
+        !std::all_of(name.begin() + 4, name.end(), ::isdigit)) {
+      continue;
+    }
+
+    std::ifstream file(entry.path() / "cpulist");
+    std::string list;
+    std::getline(file, list);
+    auto cpus = parseCpuList(list);
+    std::erase_if(cpus, [&](unsigned int cpu) { return !isAllowed(cpu); });
+    if (!cpus.empty()) {
+      numbered.emplace_back(std::stoul(name.substr(4)), std::move(cpus));
+    }
+  }
+  std::sort(numbered.begin(), numbered.end());
+
+  std::vector<std::vector<unsigned int>> nodes;
+  for (auto &[number, cpus] : numbered) {
+    nodes.push_back(std::move(cpus));
+  }
+  if (nodes.empty()) {
+    std::vector<unsigned int> cpus;
+    for (unsigned int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (haveAllowed ? CPU_ISSET(cpu, &allowed)
+                      : cpu < std::thread::hardware_concurrency()) {
+        cpus.push_back(cpu);
+      }
+    }
+    nodes.push_back(std::move(cpus));
+  }
+  return nodes;
+}
+
+bool Placement::pinWorker(const std::vector<std::vector<unsigned int>> &nodes,
+                          Policy policy, unsigned int worker,
+                          unsigned int threads) {
+  if (policy == Policy::None || nodes.empty()) {
+    return false;
+  }
+
+  const auto &cpus = nodes[worker % nodes.size()];
+  if (cpus.empty()) {
+    return false;
+  }
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (policy == Policy::Core) {
+    // The worker's threads inherit the set, so give each one a CPU
+    const auto blockSize = std::clamp<std::size_t>(threads, 1, cpus.size());
+    const auto start = (worker / nodes.size()) * blockSize;
+    for (std::size_t i = 0; i < blockSize; i++) {
+      CPU_SET(cpus[(start + i) % cpus.size()], &set);
+    }
+  } else {
+    for (const auto cpu : cpus) {
+      CPU_SET(cpu, &set);
+    }
+  }
+  return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+#else
+
+std::vector<std::vector<unsigned int>> Placement::getNodes() {
+  std::vector<unsigned int> cpus;
+  for (unsigned int cpu = 0; cpu < std::thread::hardware_concurrency();
+       cpu++) {
+    cpus.push_back(cpu);
+  }
+  return {cpus};
+}
+
+bool Placement::pinWorker(const std::vector<std::vector<unsigned int>> &,
+                          Policy, unsigned int, unsigned int) {
+  return false;
+}
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef __UTILS_PLACEMENT__
+#define __UTILS_PLACEMENT__
+
+#include <optional>
+#include <string_view>
+#include <vector>
+
+/// Pins workers to cores or NUMA nodes. Pinning is only supported on Linux,
+/// elsewhere it does nothing.
+namespace DyldExtractor::Utils::Placement {
+
+enum class Policy {
+  /// Workers can run on any CPU.
+  None,
+  /// Each worker runs on its own CPUs, one for each of its threads.
+  Core,
+  /// Each worker runs on the CPUs of one node.
+  Node,
+};
+
+/// @brief Parse a policy name, "none", "core", or "node".
+std::optional<Policy> parsePolicy(std::string_view name);
+
+/// @brief Get the CPUs of each NUMA node that the process can run on.
+///
+/// Nodes are read from sysfs. Without NUMA information all CPUs are one node.
+std::vector<std::vector<unsigned int>> getNodes();
+
+/// @brief Pin the calling thread for a worker.
+///
+/// Workers are spread over the nodes in turn, so worker i is on node
+/// i % nodes. With the Core policy, the workers of a node take blocks of its
+/// CPUs in turn. Threads created afterwards by the calling thread inherit the
+/// pinning, and memory it touches first is allocated on its node.
+///
+/// @param nodes The nodes from getNodes.
+/// @param worker The index of the worker.
+/// @param threads The number of threads the worker runs, which is the size
+///   of its block of CPUs with the Core policy.
+/// @returns If the thread was pinned.
+bool pinWorker(const std::vector<std::vector<unsigned int>> &nodes,
+               Policy policy, unsigned int worker, unsigned int threads = 1);
+
+} // namespace DyldExtractor::Utils::Placement
+
+#endif // __UTILS_PLACEMENT__
@@ -0,0 +1,87 @@
+#ifndef __UTILS_SCRATCHPOOL__
+#define __UTILS_SCRATCHPOOL__
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace DyldExtractor::Utils {
+
+/// @brief Reusable vectors for temporary data, one pool per thread.
+///
+/// A borrowed vector is empty but keeps the capacity it had when it was
+/// given back, so code that runs for every image, like the linkedit
+/// encoders, stops allocating once the buffers have grown to fit the
+/// largest image. Vectors that grew past the limit are freed instead of
+/// kept, so one large image doesn't hold onto memory.
+///
+/// @tparam T The element type.
+template <class T> class ScratchPool {
+public:
+  /// Buffers larger than this, in bytes, are not kept.
+  static constexpr std::size_t MAX_KEPT_SIZE = 64 * 1024 * 1024;
+
+  /// @brief A borrowed vector, given back to its pool when destroyed.
+  class Lease {
+  public:
+    Lease(ScratchPool &pool, std::vector<T> &&buffer)
+        : pool(&pool), buffer(std::move(buffer)) {}
+    Lease(const Lease &) = delete;
+    Lease &operator=(const Lease &) = delete;
+    Lease(Lease &&other)
+        : pool(std::exchange(other.pool, nullptr)),
+          buffer(std::move(other.buffer)) {}
+    Lease &operator=(Lease &&other) = delete;
+    ~Lease() {
+      if (pool) {
+        pool->giveBack(std::move(buffer));
+      }
+    }
+
+    std::vector<T> &operator*() { return buffer; }
+    std::vector<T> *operator->() { return &buffer; }
+
+  private:
+    ScratchPool *pool;
+    std::vector<T> buffer;
+  };
+
+  ScratchPool() = default;
+  ScratchPool(const ScratchPool &) = delete;
+  ScratchPool &operator=(const ScratchPool &) = delete;
+
+  /// @brief Get the pool of the calling thread.
+  static ScratchPool &local() {
+    static thread_local ScratchPool pool;
+    return pool;
+  }
+
+  /// @brief Borrow an empty vector.
+  Lease borrow() {
+    if (free.empty()) {
+      return Lease(*this, std::vector<T>());
+    }
+
+    auto buffer = std::move(free.back());
+    free.pop_back();
+    return Lease(*this, std::move(buffer));
+  }
+
+  /// @brief Free all vectors that are not borrowed.
+  void release() { free.clear(); }
+
+private:
+  void giveBack(std::vector<T> &&buffer) {
+    if (buffer.capacity() * sizeof(T) > MAX_KEPT_SIZE) {
+      return;
+    }
+    buffer.clear();
+    free.push_back(std::move(buffer));
+  }
+
+  std::vector<std::vector<T>> free;
+};
+
+} // namespace DyldExtractor::Utils
+
+#endif // __UTILS_SCRATCHPOOL__
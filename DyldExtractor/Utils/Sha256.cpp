@@ -0,0 +1,139 @@
+#include "Sha256.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+using namespace DyldExtractor;
+using namespace Utils;
+
+namespace {
+
+constexpr uint32_t ROUND_CONSTANTS[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+inline uint32_t loadBigEndian(const uint8_t *p) {
+  return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 |
+         (uint32_t)p[3];
+}
+
+} // namespace
+
+Sha256::Sha256()
+    : state({0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f,
+             0x9b05688c, 0x1f83d9ab, 0x5be0cd19}) {}
+
+void Sha256::update(const void *data, std::size_t size) {
+  auto p = (const uint8_t *)data;
+  totalSize += size;
+
+  if (blockUsed) {
+    const auto count = std::min(size, block.size() - blockUsed);
+    memcpy(block.data() + blockUsed, p, count);
+    blockUsed += count;
+    p += count;
+    size -= count;
+    if (blockUsed < block.size()) {
+      return;
+    }
+    processBlock(block.data());
+    blockUsed = 0;
+  }
+
+  // Hash whole blocks in place
+  for (; size >= block.size(); p += block.size(), size -= block.size()) {
+    processBlock(p);
+  }
+  memcpy(block.data(), p, size);
+  blockUsed = size;
+}
+
+Sha256::Digest Sha256::digest() {
+  const uint64_t bitSize = totalSize * 8;
+
+  // Pad with a 1 bit, zeros, then the size in bits
+  block[blockUsed++] = 0x80;
+  if (blockUsed > block.size() - 8) {
+    memset(block.data() + blockUsed, 0, block.size() - blockUsed);
+    processBlock(block.data());
+    blockUsed = 0;
+  }
+  memset(block.data() + blockUsed, 0, block.size() - 8 - blockUsed);
+  for (int i = 0; i < 8; i++) {
+    block[block.size() - 1 - i] = (uint8_t)(bitSize >> (i * 8));
+  }
+  processBlock(block.data());
+  blockUsed = 0;
+
+  Digest result;
+  for (int i = 0; i < 8; i++) {
+    result[i * 4] = (uint8_t)(state[i] >> 24);
+    result[i * 4 + 1] = (uint8_t)(state[i] >> 16);
+    result[i * 4 + 2] = (uint8_t)(state[i] >> 8);
+    result[i * 4 + 3] = (uint8_t)state[i];
+  }
+  return result;
+}
+
+std::string Sha256::toHex(const Digest &digest) {
+  constexpr char HEX[] = "0123456789abcdef";
+  std::string hex;
+  hex.reserve(digest.size() * 2);
+  for (const auto byte : digest) {
+    hex.push_back(HEX[byte >> 4]);
+    hex.push_back(HEX[byte & 0xF]);
+  }
+  return hex;
+}
+
+void Sha256::processBlock(const uint8_t *data) {
+  uint32_t w[64];
+  for (int i = 0; i < 16; i++) {
+    w[i] = loadBigEndian(data + i * 4);
+  }
+  for (int i = 16; i < 64; i++) {
+    const auto s0 = std::rotr(w[i - 15], 7) ^ std::rotr(w[i - 15], 18) ^
+                    (w[i - 15] >> 3);
+    const auto s1 = std::rotr(w[i - 2], 17) ^ std::rotr(w[i - 2], 19) ^
+                    (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+
+  auto [a, b, c, d, e, f, g, h] = state;
+  for (int i = 0; i < 64; i++) {
+    const auto s1 = std::rotr(e, 6) ^ std::rotr(e, 11) ^ std::rotr(e, 25);
+    const auto ch = (e & f) ^ (~e & g);
+    const auto temp1 = h + s1 + ch + ROUND_CONSTANTS[i] + w[i];
+    const auto s0 = std::rotr(a, 2) ^ std::rotr(a, 13) ^ std::rotr(a, 22);
+    const auto maj = (a & b) ^ (a & c) ^ (b & c);
+    const auto temp2 = s0 + maj;
+
+    h = g;
+    g = f;
+    f = e;
+    e = d + temp1;
+    d = c;
+    c = b;
+    b = a;
+    a = temp1 + temp2;
+  }
+
+  state[0] += a;
+  state[1] += b;
+  state[2] += c;
+  state[3] += d;
+  state[4] += e;
+  state[5] += f;
+  state[6] += g;
+  state[7] += h;
+}
@@ -0,0 +1,37 @@
+#ifndef __UTILS_SHA256__
+#define __UTILS_SHA256__
+
+#include <array>
+#include <stdint.h>
+#include <string>
+
+namespace DyldExtractor::Utils {
+
+/// @brief An incremental SHA-256 hash, for content addressing output files.
+class Sha256 {
+public:
+  using Digest = std::array<uint8_t, 32>;
+
+  Sha256();
+
+  /// @brief Add data to the hash.
+  void update(const void *data, std::size_t size);
+
+  /// @brief Finish the hash, no more data can be added.
+  Digest digest();
+
+  /// @brief Format a digest as lowercase hex.
+  static std::string toHex(const Digest &digest);
+
+private:
+  std::array<uint32_t, 8> state;
+  std::array<uint8_t, 64> block;
+  std::size_t blockUsed = 0;
+  uint64_t totalSize = 0;
+
+  void processBlock(const uint8_t *data);
+};
+
+} // namespace DyldExtractor::Utils
+
+#endif // __UTILS_SHA256__
@@ -0,0 +1,110 @@
+#ifndef __UTILS_STRINGPOOL__
+#define __UTILS_STRINGPOOL__
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <stdint.h>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace DyldExtractor::Utils {
+
+/// @brief A pool of unique strings with stable ids.
+///
+/// Strings are copied into large blocks, and are found with a hash map, so
+/// adding a string doesn't allocate per string. Ids are given in the order
+/// that strings are added, use sortedIds for a deterministic order.
+class StringPool {
+public:
+  using Id = uint32_t;
+
+  StringPool() = default;
+  StringPool(const StringPool &) = delete;
+  StringPool(StringPool &&) = default;
+  StringPool &operator=(const StringPool &) = delete;
+  StringPool &operator=(StringPool &&) = default;
+
+  /// @brief Add a string if it's not already in the pool.
+  /// @returns The id of the string.
+  Id add(std::string_view str) {
+    if (auto it = index.find(str); it != index.end()) {
+      return it->second;
+    }
+
+    const auto id = (Id)strings.size();
+    const auto stored = store(str);
+    strings.push_back(stored);
+    index.emplace(stored, id);
+    return id;
+  }
+
+  /// @brief Find the id of a string.
+  std::optional<Id> find(std::string_view str) const {
+    if (auto it = index.find(str); it != index.end()) {
+      return it->second;
+    }
+    return std::nullopt;
+  }
+
+  bool contains(std::string_view str) const { return index.contains(str); }
+
+  /// @brief Get a string, the view is valid for the lifetime of the pool.
+  std::string_view get(Id id) const { return strings[id]; }
+
+  /// @brief The number of strings.
+  std::size_t size() const { return strings.size(); }
+
+  /// @brief The total size of all strings, without null terminators.
+  std::size_t dataSize() const { return totalSize; }
+
+  /// @brief Get all ids ordered by their strings.
+  std::vector<Id> sortedIds() const {
+    std::vector<Id> ids(strings.size());
+    for (Id i = 0; i < ids.size(); i++) {
+      ids[i] = i;
+    }
+    std::sort(ids.begin(), ids.end(),
+              [this](Id a, Id b) { return strings[a] < strings[b]; });
+    return ids;
+  }
+
+private:
+  static constexpr std::size_t BLOCK_SIZE = 0x10000;
+
+  std::vector<std::unique_ptr<char[]>> blocks;
+  std::vector<std::unique_ptr<char[]>> largeBlocks;
+  std::size_t blockUsed = BLOCK_SIZE;
+  std::size_t totalSize = 0;
+
+  std::vector<std::string_view> strings;
+  std::unordered_map<std::string_view, Id> index;
+
+  /// @brief Copy a string into a block, null terminated.
+  std::string_view store(std::string_view str) {
+    const auto size = str.size() + 1;
+    char *dest;
+    if (size > BLOCK_SIZE / 4) {
+      // Large strings get their own block, so the current block is kept
+      dest = largeBlocks.emplace_back(std::make_unique<char[]>(size)).get();
+    } else {
+      if (blockUsed + size > BLOCK_SIZE) {
+        blocks.push_back(std::make_unique<char[]>(BLOCK_SIZE));
+        blockUsed = 0;
+      }
+      dest = blocks.back().get() + blockUsed;
+      blockUsed += size;
+    }
+
+    std::memcpy(dest, str.data(), str.size());
+    dest[str.size()] = '\0';
+    totalSize += str.size();
+    return std::string_view(dest, str.size());
+  }
+};
+
+} // namespace DyldExtractor::Utils
+
+#endif // __UTILS_STRINGPOOL__
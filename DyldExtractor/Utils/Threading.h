@@ -0,0 +1,127 @@
+#ifndef __UTILS_THREADING__
+#define __UTILS_THREADING__
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace DyldExtractor::Utils {
+
+/// @brief Get the number of chunks to split a range into.
+/// @param threads The maximum number of threads.
+/// @param count The number of items in the range.
+/// @param minChunk The minimum number of items per chunk.
+/// @returns The number of chunks, at least 1.
+inline std::size_t chunkCount(unsigned int threads, std::size_t count,
+                              std::size_t minChunk) {
+  if (!minChunk) {
+    minChunk = 1;
+  }
+  return std::max<std::size_t>(
+      1, std::min<std::size_t>(std::max(threads, 1u), count / minChunk));
+}
+
+/// @brief Split a range into chunks and process each chunk on its own thread.
+///
+/// The first chunk is processed on the calling thread, and the first
+/// exception thrown by any chunk is rethrown after all threads finish.
+///
+/// @param chunks The number of chunks, from chunkCount.
+/// @param count The number of items in the range.
+/// @param func Called with the chunk index, and the start and end of the
+///   chunk.
+template <class F>
+void parallelChunks(std::size_t chunks, std::size_t count, F func) {
+  if (chunks <= 1) {
+    func((std::size_t)0, (std::size_t)0, count);
+    return;
+  }
+
+  std::vector<std::exception_ptr> errors(chunks);
+  auto runChunk = [&](std::size_t chunkI) {
+    try {
+      func(chunkI, count * chunkI / chunks, count * (chunkI + 1) / chunks);
+    } catch (...) {
+      errors[chunkI] = std::current_exception();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(chunks - 1);
+  for (std::size_t i = 1; i < chunks; i++) {
+    threads.emplace_back(runChunk, i);
+  }
+  runChunk(0);
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  for (auto &error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+}
+
+/// @brief Limits the number of threads in each stage of a pipeline.
+///
+/// Threads working on different items can be in different stages at once,
+/// like one image being written while another is sliding, and a limit keeps
+/// a stage from being run by too many of them. Limits must be set before any
+/// stage is run, stages without a limit are run directly.
+class StageLimiter {
+public:
+  /// @brief Set the maximum number of threads in a stage, 0 is unlimited.
+  void setLimit(std::string_view stage, unsigned int limit) {
+    stages[std::string(stage)].limit = limit;
+  }
+
+  /// @brief Run a function once there is room in its stage.
+  /// @returns The result of the function.
+  template <class F> decltype(auto) run(std::string_view stage, F func) {
+    auto it = stages.find(stage);
+    if (it == stages.end() || !it->second.limit) {
+      return func();
+    }
+
+    auto &slot = it->second;
+    {
+      std::unique_lock lock(mutex);
+      slot.freed.wait(lock, [&slot] { return slot.running < slot.limit; });
+      slot.running++;
+    }
+
+    struct Release {
+      std::mutex &mutex;
+      Stage &slot;
+      ~Release() {
+        {
+          std::scoped_lock lock(mutex);
+          slot.running--;
+        }
+        slot.freed.notify_one();
+      }
+    } release{mutex, slot};
+    return func();
+  }
+
+private:
+  struct Stage {
+    unsigned int limit = 0;
+    unsigned int running = 0;
+    std::condition_variable freed;
+  };
+
+  std::mutex mutex;
+  std::map<std::string, Stage, std::less<>> stages;
+};
+
+} // namespace DyldExtractor::Utils
+
+#endif // __UTILS_THREADING__